@@ -34,6 +34,8 @@
 #include "platform.h"
 #include "platform_config.h"
 #include "CheckSumUtils.h"
+#include "ota_lz.h"
+#include "ota_delta.h"
 
 typedef int Log_Status;					
 #define Log_NotExist				    (1)
@@ -50,51 +52,11 @@ typedef int Log_Status;
 
 static uint8_t data[SizePerRW];
 static uint8_t newData[SizePerRW];
-uint8_t paraSaveInRam[16*1024];
+uint8_t paraSaveInRam[16*1024];   /* Also the work area of ota_delta_apply() */
 
 #define update_log(M, ...) custom_log("UPDATE", M, ##__VA_ARGS__)
 #define update_log_trace() custom_log_trace("UPDATE")
 
-static OSStatus checkcrc(uint16_t crc_in, int partition_type, int total_len)
-{
-    uint16_t crc = 0;
-    mico_logic_partition_t* part;
-    int len;
-    OSStatus err = kNoErr;
-    uint32_t update_data_offset = 0x0;
-    CRC16_Context contex;
-
-    CRC16_Init( &contex );
-    
-    if (crc_in == 0xFFFF)
-        goto exit;
-
-    part = MicoFlashGetInfo((mico_partition_t)partition_type);
-    if (part == NULL)
-        goto exit;
-
-    while(total_len > 0){
-      if( SizePerRW < total_len ){
-        len = SizePerRW;
-      } else {
-        len = total_len;
-      }
-      err = MicoFlashRead( MICO_PARTITION_OTA_TEMP, &update_data_offset, data , len);
-      require_noerr(err, exit);
-
-      total_len -= len;
-
-      CRC16_Update( &contex, data, len );
-    }
-
-  CRC16_Final( &contex, &crc );
-    if (crc == crc_in)
-        err = kNoErr;
-exit:
-    update_log("CRC check return %d, got crc %x, calcuated crc %x", err, crc_in, crc);
-    return err;
-}
-
 Log_Status updateLogCheck(boot_table_t *updateLog, mico_partition_t *dest_partition_type)
 {
   uint32_t i;
@@ -124,16 +86,207 @@ Log_Status updateLogCheck(boot_table_t *updateLog, mico_partition_t *dest_partit
   if( updateLog->length > MicoFlashGetInfo(*dest_partition_type)->partition_length )
     return Log_dataLengthOverFlow;
 
-  if (checkcrc(updateLog->crc, *dest_partition_type, updateLog->length) != kNoErr)
-    return Log_CRCERROR;
-  
+  /* The CRC is checked by update(), before the destination is erased */
   return Log_NeedUpdate;
 }
 
 
+static bool isBlank(const uint8_t *buf, uint32_t len)
+{
+  while(len--){
+    if(*buf++ != 0xFF)
+      return false;
+  }
+  return true;
+}
+
+/* Expand a compressed image, a block at a time from data into newData. Without
+   a destination the image is only checked, so that a bad one is found before
+   the destination is erased */
+static OSStatus expandUpdateData(const ota_lz_header_t *header, uint32_t length, mico_partition_t *dest_partition)
+{
+  uint32_t update_data_offset = sizeof(ota_lz_header_t);
+  uint32_t dest_offset = 0x0;
+  uint32_t left = header->length;
+  uint32_t copyLength, expandLength;
+  uint16_t blockSize, crc;
+  CRC16_Context contex;
+  OSStatus err = kNoErr;
+
+  CRC16_Init( &contex );
+
+  while(left > 0){
+    expandLength = ( left < header->block_size ) ? left : header->block_size;
+    require_action( update_data_offset + sizeof(blockSize) <= length, exit, err = kMalformedErr );
+    err = MicoFlashRead( MICO_PARTITION_OTA_TEMP, &update_data_offset, (uint8_t *)&blockSize, sizeof(blockSize) );
+    require_noerr(err, exit);
+    copyLength = blockSize & OTA_LZ_BLOCK_SIZE_MASK;
+    require_action( copyLength <= SizePerRW && update_data_offset + copyLength <= length, exit, err = kMalformedErr );
+
+    if(blockSize & OTA_LZ_BLOCK_STORED){
+      require_action( copyLength == expandLength, exit, err = kMalformedErr );
+      err = MicoFlashRead( MICO_PARTITION_OTA_TEMP, &update_data_offset, newData, copyLength );
+      require_noerr(err, exit);
+    }else{
+      err = MicoFlashRead( MICO_PARTITION_OTA_TEMP, &update_data_offset, data, copyLength );
+      require_noerr(err, exit);
+      err = ota_lz_expand( data, copyLength, newData, expandLength );
+      require_noerr(err, exit);
+    }
+    CRC16_Update( &contex, newData, expandLength );
+
+    if(dest_partition){
+      err = MicoFlashWrite( *dest_partition, &dest_offset, newData, expandLength );
+      require_noerr(err, exit);
+      dest_offset -= expandLength;
+      err = MicoFlashRead( *dest_partition, &dest_offset, data, expandLength );
+      require_noerr(err, exit);
+      err = memcmp(data, newData, expandLength);
+      require_noerr_action(err, exit, err = kWriteErr);
+    }
+    left -= expandLength;
+  }
+
+  CRC16_Final( &contex, &crc );
+  require_action( crc == header->crc, exit, err = kChecksumErr );
+
+exit:
+  if(err != kNoErr) update_log("Compressed image error %d at offset %d", err, update_data_offset);
+  return err;
+}
+
+/* Check the CRC of an image stored as it is in the OTA temporary partition,
+   reading it only, so that a bad one is found before the destination is
+   erased. 0xFFFF: no CRC given */
+static OSStatus checkUpdateData(uint32_t update_data_offset, uint32_t length, uint16_t imageCrc)
+{
+  uint32_t copyLength;
+  uint16_t crc;
+  CRC16_Context contex;
+  OSStatus err = kNoErr;
+
+  if(imageCrc == 0xFFFF)
+    goto exit;
+
+  CRC16_Init( &contex );
+  while(length > 0){
+    copyLength = ( length < SizePerRW ) ? length : SizePerRW;
+    err = MicoFlashRead( MICO_PARTITION_OTA_TEMP, &update_data_offset, data, copyLength );
+    require_noerr(err, exit);
+    CRC16_Update( &contex, data, copyLength );
+    length -= copyLength;
+  }
+  CRC16_Final( &contex, &crc );
+  update_log("CRC %x, expected %x", crc, imageCrc);
+  require_action( crc == imageCrc, exit, err = kChecksumErr );
+
+exit:
+  return err;
+}
+
+/* The update data can never give a good image, trying it again at every boot
+   would not change that */
+static bool isBadUpdateData(OSStatus err)
+{
+  return err == kChecksumErr || err == kMalformedErr || err == kSizeErr || err == kUnsupportedErr;
+}
+
+/* Erase the destination as far as the new image goes, and past it only as far
+   as something was written: the rest stays blank, as the RF driver loader
+   expects, without erasing sectors that no image reached. Erased in one go,
+   so that no sector is erased twice */
+static OSStatus eraseDestination(mico_partition_t dest_partition, uint32_t imageLength)
+{
+  mico_logic_partition_t *dest_partition_info = MicoFlashGetInfo(dest_partition);
+  uint32_t end = dest_partition_info->partition_length;
+  uint32_t offset, len;
+  OSStatus err = kNoErr;
+
+  while(end > imageLength){
+    len = ( end - imageLength < SizePerRW ) ? end - imageLength : SizePerRW;
+    offset = end - len;
+    err = MicoFlashRead( dest_partition, &offset, data, len );
+    require_noerr(err, exit);
+    if(!isBlank(data, len))
+      break;
+    end -= len;
+  }
+  update_log("Erase destination, %d bytes", end);
+
+  err = MicoFlashDisableSecurity( dest_partition, 0x0, dest_partition_info->partition_length );
+  require_noerr(err, exit);
+  err = MicoFlashErase( dest_partition, 0x0, end );
+  require_noerr(err, exit);
+
+exit:
+  return err;
+}
+
+/* Erase what the application wrote to the OTA temporary partition, only as far
+   as the state says it wrote, and record it */
+static OSStatus eraseUpdateData(ota_state_t *otaState)
+{
+  mico_logic_partition_t *ota_partition_info = MicoFlashGetInfo(MICO_PARTITION_OTA_TEMP);
+  uint32_t length = ota_partition_info->partition_length;
+  uint32_t state_offset = OTA_STATE_OFFSET + offsetof(ota_state_t, erased);
+  uint8_t erased = 0x0;
+  OSStatus err = kNoErr;
+
+  if(otaState->dirty_end != 0x0 && otaState->dirty_end < length)
+    length = otaState->dirty_end;
+  update_log("Erase update data, %d bytes", length);
+
+  err = MicoFlashDisableSecurity( MICO_PARTITION_OTA_TEMP, 0x0, length );
+  require_noerr(err, exit);
+  err = MicoFlashErase( MICO_PARTITION_OTA_TEMP, 0x0, length );
+  require_noerr(err, exit);
+  err = MicoFlashWrite( MICO_PARTITION_PARAMETER_1, &state_offset, &erased, 1 );
+  require_noerr(err, exit);
+  otaState->erased = erased;
+
+exit:
+  return err;
+}
+
+/* A delta image is built behind the patch, past what the application wrote,
+   so the state has to cover all the partition first */
+static OSStatus widenUpdateData(ota_state_t *otaState)
+{
+  uint32_t state_offset;
+  uint32_t dirty_end = 0x0;
+  uint8_t dirty = 0x0;
+  OSStatus err = kNoErr;
+
+  if(otaState->magic != OTA_STATE_MAGIC || otaState->erased == 0x0)
+    goto exit;
+
+  if(otaState->dirty != 0x0){
+    state_offset = OTA_STATE_OFFSET + offsetof(ota_state_t, dirty);
+    err = MicoFlashWrite( MICO_PARTITION_PARAMETER_1, &state_offset, &dirty, 1 );
+    require_noerr(err, exit);
+    otaState->dirty = dirty;
+  }
+  if(otaState->dirty_end != 0x0 && otaState->dirty_end != 0xFFFFFFFF){
+    state_offset = OTA_STATE_OFFSET + offsetof(ota_state_t, dirty_end);
+    err = MicoFlashWrite( MICO_PARTITION_PARAMETER_1, &state_offset, (uint8_t *)&dirty_end, sizeof(dirty_end) );
+    require_noerr(err, exit);
+    otaState->dirty_end = dirty_end;
+  }
+
+exit:
+  return err;
+}
+
 OSStatus update(void)
 {
   boot_table_t updateLog;
+  ota_lz_header_t lzHeader;
+  ota_delta_header_t deltaHeader;
+  bool compressed, delta;
+  uint32_t imageLength, usedLength, dirtyEnd = 0x0;
+  uint16_t imageCrc;
+  uint32_t startTime;
+  ota_state_t otaState, *savedState;
   uint32_t i, j, size;
   uint32_t update_data_offset = 0x0;
   uint32_t dest_offset;
@@ -143,7 +296,7 @@ OSStatus update(void)
   //uint8_t *paraSaveInRam = NULL;
   mico_logic_partition_t *ota_partition_info, *dest_partition_info, *para_partition_info;
   mico_partition_t dest_partition;
-  OSStatus err = kNoErr;
+  OSStatus err = kNoErr, rejected = kNoErr;
 
   ota_partition_info = MicoFlashGetInfo(MICO_PARTITION_OTA_TEMP);
   require_action( ota_partition_info->partition_owner != MICO_FLASH_NONE, exit, err = kUnsupportedErr );
@@ -160,9 +313,26 @@ OSStatus update(void)
     
   err = MicoFlashRead( MICO_PARTITION_PARAMETER_1, &boot_table_offset, (uint8_t *)&updateLog, sizeof(boot_table_t));
   require_noerr(err, exit);
+  err = MicoFlashRead( MICO_PARTITION_PARAMETER_1, &boot_table_offset, (uint8_t *)&otaState, sizeof(ota_state_t));
+  require_noerr(err, exit);
 
   /*Not a correct record*/
   if(updateLogCheck( &updateLog, &dest_partition) != Log_NeedUpdate){
+    /* A download in progress goes on from what it wrote after the reboot */
+    if(updateLog.upgrade_type == 'R' &&
+       updateLog.start_address == ota_partition_info->partition_start_addr){
+      update_log("Download in progress, update data kept");
+      goto exit;
+    }
+
+    /* The state tells whether the update data is blank, no need to read it */
+    if(otaState.magic == OTA_STATE_MAGIC){
+      if(otaState.dirty == 0x0 && otaState.erased != 0x0)
+        err = eraseUpdateData( &otaState );
+      goto exit;
+    }
+
+    /* No state: first boot, or PARAMETER_1 was erased, check the whole partition */
     size = ( ota_partition_info->partition_length )/SizePerRW;
     for(i = 0; i <= size; i++){
       if( i==size ){
@@ -181,10 +351,19 @@ OSStatus update(void)
           require_noerr(err, exit);
           err = MicoFlashErase( MICO_PARTITION_OTA_TEMP, 0x0, ota_partition_info->partition_length );
           require_noerr(err, exit);
-          goto exit;
+          goto blank;
         }
       }
     }
+
+blank:
+    /* Unless the place holds something else, such as settings in the old layout */
+    if(isBlank( (uint8_t *)&otaState, sizeof(ota_state_t) )){
+      boot_table_offset = OTA_STATE_OFFSET;
+      otaState.magic = OTA_STATE_MAGIC;
+      err = MicoFlashWrite( MICO_PARTITION_PARAMETER_1, &boot_table_offset, (uint8_t *)&otaState.magic, sizeof(otaState.magic) );
+      require_noerr(err, exit);
+    }
     goto exit;
   }
 
@@ -194,34 +373,90 @@ OSStatus update(void)
   update_log("Write OTA data to partition: %s, length %d", 
     dest_partition_info->partition_description, updateLog.length);
   
+  startTime = mico_get_time();
   dest_offset = 0x0;
   update_data_offset = 0x0;
-  
-  err = MicoFlashDisableSecurity( dest_partition, 0x0, dest_partition_info->partition_length );
-  require_noerr(err, exit);
-  err = MicoFlashErase( dest_partition, 0x0, dest_partition_info->partition_length );
+
+  /* Images made by ota_compress.py start with a header, they are checked in
+     full before the destination is erased, as other images are. Patches made
+     by ota_delta.py are applied to the image in the destination, the new
+     image is then copied from where ota_delta_apply() built it. A bad image
+     is rejected with the destination left as it is */
+  err = MicoFlashRead( MICO_PARTITION_OTA_TEMP, &update_data_offset, (uint8_t *)&deltaHeader, sizeof(ota_delta_header_t) );
   require_noerr(err, exit);
-  size = (updateLog.length)/SizePerRW;
-  
-  for(i = 0; i <= size; i++){
-    if( i == size ){
-      if( (updateLog.length)%SizePerRW )
-        copyLength = (updateLog.length)%SizePerRW;
-      else
-        break;
-    }else{
-      copyLength = SizePerRW;
-    }
-    err = MicoFlashRead( MICO_PARTITION_OTA_TEMP, &update_data_offset, data , copyLength);
-    require_noerr(err, exit);
-    err = MicoFlashWrite( dest_partition, &dest_offset, data, copyLength);
+  memcpy(&lzHeader, &deltaHeader, sizeof(ota_lz_header_t));
+  update_data_offset = 0x0;
+  imageLength = updateLog.length;
+  imageCrc = updateLog.crc;
+  usedLength = updateLog.length;
+  compressed = ( updateLog.length >= sizeof(ota_lz_header_t) && lzHeader.magic == OTA_LZ_MAGIC );
+  delta = ( updateLog.length >= sizeof(ota_delta_header_t) && deltaHeader.magic == OTA_DELTA_MAGIC );
+  if(compressed){
+    update_log("Compressed image, length %d", lzHeader.length);
+    require_action( lzHeader.length <= dest_partition_info->partition_length, reject, err = kSizeErr );
+    require_action( lzHeader.block_size > 0 && lzHeader.block_size <= SizePerRW, reject, err = kMalformedErr );
+    err = expandUpdateData( &lzHeader, updateLog.length, NULL );
+    require_noerr(err, reject);
+    imageLength = lzHeader.length;
+  }else if(delta){
+    update_log("Delta image, length %d", deltaHeader.new_length);
+    if(otaState.magic == OTA_STATE_MAGIC && otaState.dirty == 0x0 && otaState.erased != 0x0)
+      dirtyEnd = otaState.dirty_end;
+    err = widenUpdateData( &otaState );
     require_noerr(err, exit);
-    dest_offset -= copyLength;
-    err = MicoFlashRead( dest_partition, &dest_offset, newData , copyLength);
+    err = ota_delta_apply( &deltaHeader, updateLog.length, dest_partition, &update_data_offset, paraSaveInRam );
+    require_noerr(err, reject);
+    imageLength = deltaHeader.new_length;
+    imageCrc = deltaHeader.new_crc;
+    usedLength = update_data_offset + imageLength;
+  }
+  if(!compressed){
+    err = checkUpdateData( update_data_offset, imageLength, imageCrc );
+    require_noerr(err, reject);
+  }
+  
+  err = eraseDestination( dest_partition, imageLength );
+  require_noerr(err, exit);
+
+  if(compressed){
+    err = expandUpdateData( &lzHeader, updateLog.length, &dest_partition );
     require_noerr(err, exit);
-    err = memcmp(data, newData, copyLength);
-    require_noerr_action(err, exit, err = kWriteErr); 
- }
+  }else{
+    size = imageLength/SizePerRW;
+    
+    for(i = 0; i <= size; i++){
+      if( i == size ){
+        if( imageLength%SizePerRW )
+          copyLength = imageLength%SizePerRW;
+        else
+          break;
+      }else{
+        copyLength = SizePerRW;
+      }
+      err = MicoFlashRead( MICO_PARTITION_OTA_TEMP, &update_data_offset, data , copyLength);
+      require_noerr(err, exit);
+      err = MicoFlashWrite( dest_partition, &dest_offset, data, copyLength);
+      require_noerr(err, exit);
+      dest_offset -= copyLength;
+      err = MicoFlashRead( dest_partition, &dest_offset, newData , copyLength);
+      require_noerr(err, exit);
+      err = memcmp(data, newData, copyLength);
+      require_noerr_action(err, exit, err = kWriteErr); 
+    }
+  }
+  update_log("Image written in %d ms", mico_get_time() - startTime);
+  UNUSED_VARIABLE( startTime ); /* update_log is empty when DEBUG is 0 */
+
+reject:
+  /* A bad image, found before the destination was erased, is not tried again
+     at every boot: its update data is cleared as after an update. Any other
+     error leaves the update to be done again at the next boot */
+  if(err != kNoErr){
+    require( isBadUpdateData( err ), exit );
+    update_log("Bad update data, err = %d, not updated", err);
+    rejected = err;
+    dirtyEnd = 0x0;
+  }
 
   update_log("Update start to clear data...");
     
@@ -231,18 +466,40 @@ OSStatus update(void)
   err = MicoFlashRead( MICO_PARTITION_PARAMETER_1, &para_offset, paraSaveInRam, para_partition_info->partition_length );
   require_noerr(err, exit);
   memset(paraSaveInRam, 0xff, sizeof(boot_table_t));
+
+  /* Keep the update data dirty in the state until it is erased below, so that
+     it is erased at the next boot should this one be interrupted */
+  savedState = (ota_state_t *)&paraSaveInRam[OTA_STATE_OFFSET];
+  if(savedState->magic == OTA_STATE_MAGIC || isBlank( (uint8_t *)savedState, sizeof(ota_state_t) )){
+    if(savedState->magic != OTA_STATE_MAGIC || savedState->dirty != 0x0 || savedState->erased == 0x0 ||
+       (savedState->dirty_end != 0x0 && savedState->dirty_end < usedLength))
+      savedState->dirty_end = 0x0;
+    /* Erase only what the application and the delta update wrote */
+    if(delta && dirtyEnd != 0x0 && dirtyEnd != 0xFFFFFFFF)
+      savedState->dirty_end = ( dirtyEnd > usedLength ) ? dirtyEnd : usedLength;
+    savedState->magic = OTA_STATE_MAGIC;
+    savedState->dirty = 0x0;
+    savedState->erased = 0xFF;
+  }
+  memcpy(&otaState, savedState, sizeof(ota_state_t));
+
   err = MicoFlashErase( MICO_PARTITION_PARAMETER_1, 0x0, para_partition_info->partition_length );
   require_noerr(err, exit);
   para_offset = 0x0;
   err = MicoFlashWrite( MICO_PARTITION_PARAMETER_1, &para_offset, paraSaveInRam, para_partition_info->partition_length );
   require_noerr(err, exit);
   
-
-  err = MicoFlashDisableSecurity( MICO_PARTITION_OTA_TEMP, 0x0, ota_partition_info->partition_length );
-  require_noerr(err, exit);  
-  err = MicoFlashErase( MICO_PARTITION_OTA_TEMP, 0x0, ota_partition_info->partition_length );
-  require_noerr(err, exit);
-  update_log("Update success");
+  if(otaState.magic == OTA_STATE_MAGIC){
+    err = eraseUpdateData( &otaState );
+    require_noerr(err, exit);
+  }else{
+    err = MicoFlashDisableSecurity( MICO_PARTITION_OTA_TEMP, 0x0, ota_partition_info->partition_length );
+    require_noerr(err, exit);  
+    err = MicoFlashErase( MICO_PARTITION_OTA_TEMP, 0x0, ota_partition_info->partition_length );
+    require_noerr(err, exit);
+  }
+  err = rejected;
+  if(err == kNoErr) update_log("Update success");
   
 exit:
   if(err != kNoErr) update_log("Update exit with err = %d", err);
@@ -0,0 +1,545 @@
+/**
+******************************************************************************
+* @file    Update_for_OTA_test.c
+* @version V1.0.0
+* @date    17-Oct-2026
+* @brief   Boot test of update() against simulated flash: the application,
+*          OTA temporary and parameter partitions in RAM, with the reads and
+*          erases of each counted and the power cut at random writes and
+*          erases. Checks that a normal boot reads nothing of the OTA
+*          temporary partition once the state is in PARAMETER_1, that an
+*          aborted download, an update or a bad image, refused before the
+*          application is erased, leaves it blank, that settings in
+*          the legacy layout fall back to the full check, and that after any
+*          power cut it is blank again by the end of the next boot. A
+*          compressed image, Bootloader/ota_lz_test.ota made by
+*          ota_compress.py (see ota_lz_test.c), must expand to the RF driver
+*          it was made from, and refused when corrupt. Last, updates between
+*          the RF drivers of the tree are timed on a model of the flash of
+*          MiCOKit-3165, which mico_get_time() reads, and checked against the
+*          least time the flash allows. Built on the host on its own, it
+*          includes mico_system_para_storage.c for the application side and
+*          Update_for_OTA.c; CheckSumUtils.c provides the CRC, ota_lz.c and
+*          ota_delta.c the other image formats. Run from the repository
+*          root, or with OTA_TEST_ROOT set to it. Not part of the default
+*          build.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mico_system_para_storage.c"
+#include "Update_for_OTA.c"
+#include "bootloader.h"
+
+#define UPDATE_TEST_SECTOR      ( 4096 )
+#define UPDATE_TEST_USER_SIZE   ( 200 )
+#define UPDATE_TEST_RUNS        ( 300 )
+#define UPDATE_TEST_MAX_CUT     ( 300000 )  /* Flash operations before a power cut, at most */
+
+#ifndef OTA_TEST_ROOT
+#define OTA_TEST_ROOT           "."
+#endif
+#define UPDATE_TEST_PACKED      OTA_TEST_ROOT "/Bootloader/ota_lz_test.ota"
+#define UPDATE_TEST_RF_DRIVER   OTA_TEST_ROOT "/MICO/core/RF driver/BCM43362-5.90.230.12.bin"
+#define UPDATE_TEST_RF_OLD      OTA_TEST_ROOT "/MICO/core/RF driver/BCM43362-5.90.230.10.bin"
+#define UPDATE_TEST_SLOWER      ( 1.05 )    /* Timed update against the least it can take, at most */
+
+enum { UPDATE_TEST_APP, UPDATE_TEST_OTA, UPDATE_TEST_PARA1, UPDATE_TEST_PARA2, UPDATE_TEST_BANKS };
+
+static mico_logic_partition_t update_test_partitions[UPDATE_TEST_BANKS] = {
+  { MICO_FLASH_EMBEDDED, "Application", 0x13000, 0x70000, 0 },
+  { MICO_FLASH_EMBEDDED, "OTA Storage", 0x83000, 0x70000, 0 },
+  { MICO_FLASH_EMBEDDED, "PARAMETER1", 0x0, 0x1000, 0 },
+  { MICO_FLASH_EMBEDDED, "PARAMETER2", 0x1000, 0x1000, 0 },
+};
+static uint8_t *update_test_flash[UPDATE_TEST_BANKS];
+static unsigned long update_test_reads[UPDATE_TEST_BANKS], update_test_erases[UPDATE_TEST_BANKS];
+static unsigned long update_test_reprogrammed;
+static long update_test_cut = -1;   /* Flash operations left before the power fails */
+static jmp_buf update_test_power_cut;
+static uint32_t update_test_seed = 1;
+static mico_Context_t *update_test_context;
+static uint8_t update_test_image[0x70000];
+static int update_test_print;
+static double update_test_time;     /* Seconds on the flash of MiCOKit-3165, see update_test_timed() */
+
+static uint32_t update_test_rand( uint32_t n )
+{
+  update_test_seed = update_test_seed * 1103515245 + 12345;
+  return ( update_test_seed >> 8 ) % n;
+}
+
+static int update_test_bank( mico_partition_t partition )
+{
+  switch( partition ) {
+    case MICO_PARTITION_APPLICATION:  return UPDATE_TEST_APP;
+    case MICO_PARTITION_OTA_TEMP:     return UPDATE_TEST_OTA;
+    case MICO_PARTITION_PARAMETER_1:  return UPDATE_TEST_PARA1;
+    default:                          return UPDATE_TEST_PARA2;
+  }
+}
+
+static uint32_t update_test_length( int bank )
+{
+  return update_test_partitions[bank].partition_length;
+}
+
+mico_logic_partition_t *MicoFlashGetInfo( mico_partition_t inPartition )
+{
+  return &update_test_partitions[update_test_bank( inPartition )];
+}
+
+OSStatus MicoFlashDisableSecurity( mico_partition_t partition, uint32_t off_set, uint32_t size )
+{
+  return kNoErr;
+}
+
+/* Time taken to erase the application from start to end. On MiCOKit-3165 it
+   starts in the last 16 KB sector of the STM32F411, followed by one of 64 KB
+   and then 128 KB ones, each erased in one go */
+static double update_test_app_erase_time( uint32_t start, uint32_t end )
+{
+  uint32_t sector = 0, length;
+  double time = 0.0, sector_time;
+
+  for( ; sector < end; sector += length ) {
+    if( sector < 0x4000 ) { length = 0x4000; sector_time = 0.25; }
+    else if( sector < 0x14000 ) { length = 0x10000; sector_time = 0.55; }
+    else { length = 0x20000; sector_time = 1.0; }
+    if( sector + length > start ) time += sector_time;
+  }
+  return time;
+}
+
+/* Erases whole sectors, an interrupted one is left partly erased. Erasing
+   takes 45 ms per 4 KB sector of SPI flash, where the other partitions are */
+OSStatus MicoFlashErase( mico_partition_t inPartition, uint32_t off_set, uint32_t size )
+{
+  int bank = update_test_bank( inPartition );
+  uint8_t *flash = update_test_flash[bank];
+  uint32_t start = off_set - off_set % UPDATE_TEST_SECTOR, end = off_set + size, i;
+
+  if( size == 0 ) return kNoErr;
+  end += ( UPDATE_TEST_SECTOR - end % UPDATE_TEST_SECTOR ) % UPDATE_TEST_SECTOR;
+  if( end > update_test_length( bank ) ) return kParamErr;
+  if( bank == UPDATE_TEST_APP ) update_test_time += update_test_app_erase_time( start, end );
+  for( ; start < end; start += UPDATE_TEST_SECTOR ) {
+    update_test_erases[bank]++;
+    if( bank != UPDATE_TEST_APP ) update_test_time += 45e-3;
+    if( update_test_cut > 0 && --update_test_cut == 0 ) {
+      for( i = start; i < start + UPDATE_TEST_SECTOR; i++ )
+        flash[i] = update_test_rand( 2 ) ? 0xFF : flash[i] & update_test_rand( 256 );
+      longjmp( update_test_power_cut, 1 );
+    }
+    memset( &flash[start], 0xFF, UPDATE_TEST_SECTOR );
+  }
+  return kNoErr;
+}
+
+OSStatus MicoFlashWrite( mico_partition_t inPartition, volatile uint32_t* off_set, uint8_t* inBuffer, uint32_t inBufferLength )
+{
+  int bank = update_test_bank( inPartition );
+  uint8_t *flash = update_test_flash[bank];
+  uint32_t i;
+
+  if( *off_set + inBufferLength > update_test_length( bank ) ) return kParamErr;
+  /* 16 us a word on the STM32F411, 0.7 ms a 256 byte page on SPI flash */
+  update_test_time += ( bank == UPDATE_TEST_APP ) ? inBufferLength / 4 * 16e-6 : inBufferLength / 256.0 * 0.7e-3;
+  for( i = 0; i < inBufferLength; i++, (*off_set)++ ) {
+    if( update_test_cut > 0 && --update_test_cut == 0 ) longjmp( update_test_power_cut, 1 );
+    /* Programming can only clear bits */
+    if( ( flash[*off_set] & inBuffer[i] ) != inBuffer[i] ) update_test_reprogrammed++;
+    flash[*off_set] &= inBuffer[i];
+  }
+  return kNoErr;
+}
+
+OSStatus MicoFlashRead( mico_partition_t inPartition, volatile uint32_t* off_set, uint8_t* outBuffer, uint32_t inBufferLength )
+{
+  int bank = update_test_bank( inPartition );
+
+  if( *off_set + inBufferLength > update_test_length( bank ) ) return kParamErr;
+  /* SPI flash at 3 MB/s with 10 us a call, the STM32F411 at 50 MB/s */
+  update_test_time += ( bank == UPDATE_TEST_APP ) ? inBufferLength / 50e6 : inBufferLength / 3e6 + 10e-6;
+  update_test_reads[bank] += inBufferLength;
+  memcpy( outBuffer, &update_test_flash[bank][*off_set], inBufferLength );
+  *off_set += inBufferLength;
+  return kNoErr;
+}
+
+mico_Context_t *mico_system_context_get( void )
+{
+  return update_test_context;
+}
+
+uint32_t mico_get_time( void )
+{
+  return (uint32_t)( update_test_time * 1000 );
+}
+
+/* The application starts: forget everything held in RAM and read the
+   settings back */
+static OSStatus update_test_app_boot( void )
+{
+  if( para_store.index ) free( para_store.index );
+  memset( &para_store, 0x0, sizeof(para_store) );
+  para_store.active = -1;
+  seedNum = 0;
+
+  memset( &update_test_context->flashContentInRam, 0x0, sizeof(flash_content_t) );
+  memset( update_test_context->user_config_data, 0x0, UPDATE_TEST_USER_SIZE );
+  return MICOReadConfiguration( update_test_context );
+}
+
+/* The bootloader starts, with the counts of this boot only */
+static OSStatus update_test_boot( const char *name )
+{
+  OSStatus err;
+
+  memset( update_test_reads, 0x0, sizeof(update_test_reads) );
+  memset( update_test_erases, 0x0, sizeof(update_test_erases) );
+  err = update( );
+  if( update_test_print && name )
+    printf( "%-36s OTA read %7lu bytes, %3lu erases; PARAMETER1 read %5lu bytes, %lu erases\r\n", name,
+            update_test_reads[UPDATE_TEST_OTA], update_test_erases[UPDATE_TEST_OTA],
+            update_test_reads[UPDATE_TEST_PARA1], update_test_erases[UPDATE_TEST_PARA1] );
+  return err;
+}
+
+static bool update_test_blank( int bank, uint32_t offset, uint32_t length )
+{
+  while( length-- )
+    if( update_test_flash[bank][offset++] != 0xFF ) return false;
+  return true;
+}
+
+/* What a download writes to the OTA temporary partition */
+static void update_test_download( uint32_t length, uint8_t seed )
+{
+  uint32_t offset = 0, i;
+
+  for( i = 0; i < length; i++ )
+    update_test_image[i] = (uint8_t)( seed + i * 7 ) | 0x01;
+  MicoFlashWrite( MICO_PARTITION_OTA_TEMP, &offset, update_test_image, length );
+}
+
+/* Reads a file of the repository, returns its length, 0 if not found */
+static uint32_t update_test_file( const char *name, uint8_t *buf, uint32_t size )
+{
+  FILE *f = fopen( name, "rb" );
+  uint32_t length;
+
+  if( f == NULL ) return 0;
+  length = fread( buf, 1, size, f );
+  fclose( f );
+  return length;
+}
+
+/* A download of the compressed image */
+static uint32_t update_test_download_packed( void )
+{
+  uint32_t offset = 0, length;
+
+  length = update_test_file( UPDATE_TEST_PACKED, update_test_image, sizeof(update_test_image) );
+  MicoFlashWrite( MICO_PARTITION_OTA_TEMP, &offset, update_test_image, length );
+  return length;
+}
+
+/* A complete download asks the bootloader for the update */
+static void update_test_stage( uint32_t length )
+{
+  boot_table_t *table = &update_test_context->flashContentInRam.bootTable;
+  CRC16_Context crc_context;
+
+  memset( table, 0x0, sizeof(boot_table_t) );
+  table->start_address = update_test_partitions[UPDATE_TEST_OTA].partition_start_addr;
+  table->length = length;
+  table->type = 'A';
+  table->upgrade_type = 'U';
+  CRC16_Init( &crc_context );
+  CRC16_Update( &crc_context, update_test_image, length );
+  CRC16_Final( &crc_context, &table->crc );
+  mico_system_context_update( update_test_context );
+}
+
+static void update_test_set_name( const char *name )
+{
+  strcpy( update_test_context->flashContentInRam.micoSystemConfig.name, name );
+  mico_system_context_update( update_test_context );
+}
+
+static bool update_test_name_is( const char *name )
+{
+  return strcmp( update_test_context->flashContentInRam.micoSystemConfig.name, name ) == 0;
+}
+
+static void update_test_erase_all( void )
+{
+  int bank;
+
+  for( bank = 0; bank < UPDATE_TEST_BANKS; bank++ )
+    memset( update_test_flash[bank], 0xFF, update_test_length( bank ) );
+}
+
+static int update_test_check( bool ok, const char *what )
+{
+  if( !ok && update_test_print ) printf( "Update_for_OTA_test: %s\r\n", what );
+  return ok ? 0 : 1;
+}
+
+/* First boot, normal boots, an aborted download, updates with and without
+   the state marked dirty, a compressed image, and settings in the legacy
+   layout */
+static int update_test_scenario( void )
+{
+  static uint8_t installed[50000], expanded[0x40000];
+  uint32_t ota_length = update_test_length( UPDATE_TEST_OTA );
+  uint32_t length, packed;
+  ota_lz_header_t header;
+  OSStatus err;
+  int bad = 0;
+
+  update_test_erase_all( );
+  bad += update_test_check( update_test_boot( "First boot, blank flash" ) == kNoErr, "first boot failed" );
+  bad += update_test_check( update_test_reads[UPDATE_TEST_OTA] == ota_length, "first boot did not check the partition" );
+  update_test_app_boot( );
+  update_test_set_name( "kept" );
+  bad += update_test_check( update_test_boot( "Normal boot" ) == kNoErr, "normal boot failed" );
+  bad += update_test_check( update_test_reads[UPDATE_TEST_OTA] == 0 && update_test_erases[UPDATE_TEST_OTA] == 0,
+                            "normal boot read the partition" );
+
+  /* A download of 100000 bytes stops half way */
+  mico_system_ota_partition_dirty( update_test_context, 100000 );
+  update_test_download( 50000, 1 );
+  bad += update_test_check( update_test_boot( "Download aborted at 50000 bytes" ) == kNoErr, "boot after abort failed" );
+  bad += update_test_check( update_test_blank( UPDATE_TEST_OTA, 0, ota_length ), "partition not blank after abort" );
+  bad += update_test_check( update_test_erases[UPDATE_TEST_OTA] <= 100000 / UPDATE_TEST_SECTOR + 1, "erased past the download" );
+  bad += update_test_check( update_test_boot( "Normal boot" ) == kNoErr && update_test_reads[UPDATE_TEST_OTA] == 0 &&
+                            update_test_erases[UPDATE_TEST_OTA] == 0, "normal boot after abort read the partition" );
+
+  /* An update of 50000 bytes */
+  update_test_app_boot( );
+  bad += update_test_check( update_test_name_is( "kept" ), "settings lost" );
+  mico_system_ota_partition_dirty( update_test_context, 50000 );
+  update_test_download( 50000, 2 );
+  update_test_stage( 50000 );
+  bad += update_test_check( update_test_boot( "Update staged, 50000 bytes" ) == kNoErr, "update failed" );
+  bad += update_test_check( memcmp( update_test_flash[UPDATE_TEST_APP], update_test_image, 50000 ) == 0, "image not copied" );
+  bad += update_test_check( update_test_blank( UPDATE_TEST_OTA, 0, ota_length ), "partition not blank after update" );
+  bad += update_test_check( update_test_blank( UPDATE_TEST_PARA1, 0, sizeof(boot_table_t) ), "boot table not cleared" );
+  bad += update_test_check( update_test_boot( "Normal boot" ) == kNoErr && update_test_reads[UPDATE_TEST_OTA] == 0,
+                            "normal boot after update read the partition" );
+  update_test_app_boot( );
+  bad += update_test_check( update_test_name_is( "kept" ), "settings lost by the update" );
+
+  /* A compressed image made by ota_compress.py, expanded into the application */
+  length = update_test_file( UPDATE_TEST_RF_DRIVER, expanded, sizeof(expanded) );
+  mico_system_ota_partition_dirty( update_test_context, 0 );
+  packed = update_test_download_packed( );
+  bad += update_test_check( packed > sizeof(ota_lz_header_t) && length > 0, "compressed image not found, run from the repository root" );
+  memcpy( &header, update_test_image, sizeof(header) );
+  update_test_stage( packed );
+  bad += update_test_check( update_test_boot( "Update staged, compressed" ) == kNoErr, "compressed update failed" );
+  bad += update_test_check( header.length <= length && memcmp( update_test_flash[UPDATE_TEST_APP], expanded, header.length ) == 0,
+                            "compressed image not expanded" );
+  bad += update_test_check( update_test_blank( UPDATE_TEST_OTA, 0, ota_length ), "partition not blank after compressed update" );
+  memcpy( installed, update_test_flash[UPDATE_TEST_APP], sizeof(installed) );
+
+  /* Corrupt in flash, refused before the application is erased */
+  mico_system_ota_partition_dirty( update_test_context, packed );
+  update_test_download_packed( );
+  update_test_stage( packed );
+  update_test_flash[UPDATE_TEST_OTA][packed / 2] ^= 0x10;
+  err = update_test_boot( "Update staged, corrupt compressed" );
+  bad += update_test_check( ( err == kChecksumErr || err == kMalformedErr ) && update_test_erases[UPDATE_TEST_APP] == 0 &&
+                            memcmp( update_test_flash[UPDATE_TEST_APP], installed, sizeof(installed) ) == 0,
+                            "corrupt compressed image not refused" );
+  bad += update_test_check( update_test_blank( UPDATE_TEST_OTA, 0, ota_length ), "partition not blank after a corrupt compressed image" );
+  update_test_app_boot( );
+  bad += update_test_check( update_test_name_is( "kept" ), "settings lost by a compressed image" );
+
+  /* A download corrupted in flash: refused before the application is erased,
+     and not tried again */
+  memcpy( installed, update_test_flash[UPDATE_TEST_APP], sizeof(installed) );
+  mico_system_ota_partition_dirty( update_test_context, 40000 );
+  update_test_download( 40000, 4 );
+  update_test_stage( 40000 );
+  update_test_flash[UPDATE_TEST_OTA][30000] &= 0xFE;
+  bad += update_test_check( update_test_boot( "Update staged, bad CRC" ) == kChecksumErr, "bad image not refused" );
+  bad += update_test_check( update_test_reads[UPDATE_TEST_OTA] <= 40000 + sizeof(ota_delta_header_t) &&
+                            update_test_erases[UPDATE_TEST_APP] == 0,
+                            "bad image not checked before the application was erased" );
+  bad += update_test_check( memcmp( update_test_flash[UPDATE_TEST_APP], installed, sizeof(installed) ) == 0, "application changed by a bad image" );
+  bad += update_test_check( update_test_blank( UPDATE_TEST_OTA, 0, ota_length ), "partition not blank after a bad image" );
+  bad += update_test_check( update_test_blank( UPDATE_TEST_PARA1, 0, sizeof(boot_table_t) ), "bad image left in the boot table" );
+  bad += update_test_check( update_test_boot( "Normal boot" ) == kNoErr && update_test_reads[UPDATE_TEST_OTA] == 0 &&
+                            update_test_erases[UPDATE_TEST_APP] == 0, "bad image tried again" );
+  update_test_app_boot( );
+  bad += update_test_check( update_test_name_is( "kept" ), "settings lost by a bad image" );
+
+  /* An application built before the state stages without marking it dirty */
+  update_test_download( 30000, 3 );
+  update_test_stage( 30000 );
+  bad += update_test_check( update_test_boot( "Update staged, not marked dirty" ) == kNoErr, "unmarked update failed" );
+  bad += update_test_check( update_test_blank( UPDATE_TEST_OTA, 0, ota_length ), "partition not blank after unmarked update" );
+  bad += update_test_check( update_test_boot( "Normal boot" ) == kNoErr && update_test_reads[UPDATE_TEST_OTA] == 0,
+                            "normal boot after unmarked update read the partition" );
+
+  /* Settings in the legacy layout where the state goes: checked in full at
+     every boot, and nothing written over them */
+  memset( &update_test_flash[UPDATE_TEST_PARA1][OTA_STATE_OFFSET], 0x41, sizeof(ota_state_t) );
+  update_test_flash[UPDATE_TEST_OTA][ota_length - 1] = 0x0;
+  bad += update_test_check( update_test_boot( "Settings in the legacy layout" ) == kNoErr, "legacy boot failed" );
+  bad += update_test_check( update_test_blank( UPDATE_TEST_OTA, 0, ota_length ), "partition not blank with legacy settings" );
+  bad += update_test_check( update_test_boot( "Settings in the legacy layout" ) == kNoErr &&
+                            update_test_reads[UPDATE_TEST_OTA] == ota_length &&
+                            update_test_flash[UPDATE_TEST_PARA1][OTA_STATE_OFFSET] == 0x41, "legacy settings overwritten" );
+  return bad;
+}
+
+/* Downloads, aborts, an update and a bad image, with the power cut at a
+   random flash operation; the boot that follows and the one after it must
+   complete, and leave the partition blank and the state good for the fast
+   path */
+static int update_test_power_cuts( void )
+{
+  uint32_t ota_length = update_test_length( UPDATE_TEST_OTA );
+  uint32_t length;
+  int run, k, bad = 0;
+
+  for( run = 0; run < UPDATE_TEST_RUNS && !bad; run++ ) {
+    update_test_erase_all( );
+    update_test_cut = -1;
+    update_test_boot( NULL );
+    update_test_app_boot( );
+    update_test_set_name( "kept" );
+
+    update_test_cut = 1 + update_test_rand( UPDATE_TEST_MAX_CUT );
+    if( setjmp( update_test_power_cut ) == 0 ) {
+      for( k = 0; k < 4; k++ ) {
+        length = 4096 + update_test_rand( 200000 );
+        mico_system_ota_partition_dirty( update_test_context, ( k & 1 ) ? 0 : length );
+        update_test_download( length, (uint8_t)( run + k ) );
+        if( k >= 2 ) update_test_stage( length );
+        if( k == 3 ) update_test_flash[UPDATE_TEST_OTA][update_test_rand( length )] = 0x0;
+        update_test_boot( NULL );
+        update_test_app_boot( );
+      }
+    }
+    update_test_cut = -1;
+
+    /* The first boot may finish an interrupted update */
+    bad += update_test_check( update_test_boot( NULL ) == kNoErr, "boot after power cut failed" );
+    bad += update_test_check( update_test_boot( NULL ) == kNoErr, "second boot after power cut failed" );
+    bad += update_test_check( update_test_blank( UPDATE_TEST_OTA, 0, ota_length ), "partition not blank after power cut" );
+    update_test_app_boot( );
+    bad += update_test_check( update_test_name_is( "kept" ) || update_test_name_is( DEFAULT_NAME ),
+                              "settings lost after power cut" );
+    update_test_boot( NULL );
+    bad += update_test_check( update_test_reads[UPDATE_TEST_OTA] == 0, "no fast path after power cut" );
+    if( bad && update_test_print ) printf( "Update_for_OTA_test: power cut run %d\r\n", run );
+  }
+  if( !bad && update_test_print ) printf( "%d power cut runs\r\n", run );
+  return bad;
+}
+
+/* Updates from blank and between the two RF drivers of the tree, installed as
+   applications, on the flash of MiCOKit-3165. Each must take at most
+   UPDATE_TEST_SLOWER times the least it can: erasing the sectors that the
+   old and new images reach, programming the new one and erasing the
+   download */
+static int update_test_timed( void )
+{
+  static uint8_t images[2][0x40000];
+  static const struct { int from, to; const char *name; } runs[] = {
+    { -1, 1, "Timed update, blank -> .12" },
+    { 0,  1, "Timed update, .10 -> .12" },
+    { 1,  0, "Timed update, .12 -> .10" },
+  };
+  uint32_t lengths[2], length, old, offset;
+  double least;
+  OSStatus err;
+  int r, bad = 0;
+
+  lengths[0] = update_test_file( UPDATE_TEST_RF_OLD, images[0], sizeof(images[0]) );
+  lengths[1] = update_test_file( UPDATE_TEST_RF_DRIVER, images[1], sizeof(images[1]) );
+  if( lengths[0] == 0 || lengths[1] == 0 )
+    return update_test_check( false, "RF drivers not found, run from the repository root" );
+
+  for( r = 0; r < (int)( sizeof(runs) / sizeof(runs[0]) ); r++ ) {
+    update_test_erase_all( );
+    update_test_boot( NULL );
+    update_test_app_boot( );
+    old = ( runs[r].from < 0 ) ? 0 : lengths[runs[r].from];
+    if( old ) memcpy( update_test_flash[UPDATE_TEST_APP], images[runs[r].from], old );
+    length = lengths[runs[r].to];
+    mico_system_ota_partition_dirty( update_test_context, length );
+    memcpy( update_test_image, images[runs[r].to], length );
+    offset = 0;
+    MicoFlashWrite( MICO_PARTITION_OTA_TEMP, &offset, update_test_image, length );
+    update_test_stage( length );
+
+    update_test_time = 0.0;
+    err = update_test_boot( NULL );
+    least = update_test_app_erase_time( 0, ( old > length ) ? old : length ) + length / 4 * 16e-6 +
+            ( length + UPDATE_TEST_SECTOR - 1 ) / UPDATE_TEST_SECTOR * 45e-3;
+    if( update_test_print )
+      printf( "%-36s %.2f s, at least %.2f s; OTA read %lu bytes\r\n", runs[r].name, update_test_time, least,
+              update_test_reads[UPDATE_TEST_OTA] );
+    bad += update_test_check( err == kNoErr && memcmp( update_test_flash[UPDATE_TEST_APP], update_test_image, length ) == 0 &&
+                              update_test_blank( UPDATE_TEST_APP, length, update_test_length( UPDATE_TEST_APP ) - length ),
+                              "timed update failed" );
+    bad += update_test_check( update_test_time <= least * UPDATE_TEST_SLOWER, "update slower than the flash allows" );
+  }
+  return bad;
+}
+
+OSStatus Update_for_OTA_test( int print )
+{
+  int bank, bad;
+
+  update_test_print = print;
+  for( bank = 0; bank < UPDATE_TEST_BANKS; bank++ )
+    update_test_flash[bank] = malloc( update_test_length( bank ) );
+  update_test_context = calloc( 1, sizeof(mico_Context_t) );
+  update_test_context->user_config_data = calloc( 1, UPDATE_TEST_USER_SIZE );
+  update_test_context->user_config_data_size = UPDATE_TEST_USER_SIZE;
+
+  bad = update_test_scenario( );
+  bad += update_test_power_cuts( );
+  bad += update_test_timed( );
+  bad += update_test_check( update_test_reprogrammed == 0, "programmed a byte that was not erased" );
+
+  free( update_test_context->user_config_data );
+  free( update_test_context );
+  for( bank = 0; bank < UPDATE_TEST_BANKS; bank++ )
+    free( update_test_flash[bank] );
+
+  if( print ) printf( "Update_for_OTA_test: %s\r\n", bad ? "FAILED" : "PASSED" );
+  return bad ? kGeneralErr : kNoErr;
+}
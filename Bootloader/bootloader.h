@@ -40,6 +40,9 @@ extern "C" {
   
 void bootloader_start_app( uint32_t app_addr );
 
+/* Boot test of update() on simulated flash, see Update_for_OTA_test.c */
+OSStatus Update_for_OTA_test( int print );
+
 
 #ifdef __cplusplus
 } /*extern "C" */
@@ -0,0 +1,174 @@
+#!/usr/bin/env python
+"""Compress a firmware image for OTA.
+
+The output is the container described in Bootloader/ota_lz.h: a 16 byte
+header and the image in blocks of at most 4096 bytes, each compressed on its
+own with LZ4 sequences, or stored when that does not make it smaller. Send it
+instead of the raw image, through the config server or TFTP; the bootloader
+recognises the header and expands the image while it copies it.
+
+usage: ota_compress.py [-b block_size] image.bin [image.ota]
+       (writes image.bin.ota without a second argument)
+"""
+
+import binascii
+import getopt
+import struct
+import sys
+
+MAGIC = 0x315A544F          # "OTZ1"
+HEADER = struct.Struct('<IIHHI')
+BLOCK_STORED = 0x8000
+BLOCK_SIZE_MAX = 4096       # SizePerRW in Update_for_OTA.c
+MIN_MATCH = 4
+MAX_CHAIN = 64              # Earlier positions tried for each match
+
+
+def crc16(data):
+    """CRC16_Update and CRC16_Final of CheckSumUtils.c."""
+    return binascii.crc_hqx(data, 0)
+
+
+def _length(out, n):
+    while n >= 255:
+        out.append(255)
+        n -= 255
+    out.append(n)
+
+
+def _sequence(out, literals, match_len, distance):
+    lit = len(literals)
+    token = min(lit, 15) << 4
+    if match_len:
+        token |= min(match_len - MIN_MATCH, 15)
+    out.append(token)
+    if lit >= 15:
+        _length(out, lit - 15)
+    out += literals
+    if match_len:
+        out += struct.pack('<H', distance)
+        if match_len - MIN_MATCH >= 15:
+            _length(out, match_len - MIN_MATCH - 15)
+
+
+def _match(src, chains, i):
+    """Longest earlier match at i, as (length, distance)."""
+    best_len, best_dist = 0, 0
+    n = len(src)
+    for j in reversed(chains.get(bytes(src[i:i + MIN_MATCH]), ())[-MAX_CHAIN:]):
+        k = MIN_MATCH
+        while i + k < n and src[j + k] == src[i + k]:
+            k += 1
+        if k > best_len:
+            best_len, best_dist = k, i - j
+            if i + k == n:
+                break
+    return best_len, best_dist
+
+
+def compress_block(src):
+    """LZ4 sequences for one block, greedy with one step of lazy matching."""
+    out = bytearray()
+    chains = {}
+    n = len(src)
+    last = n - MIN_MATCH
+    anchor = i = 0
+
+    def insert(k):
+        chains.setdefault(bytes(src[k:k + MIN_MATCH]), []).append(k)
+
+    while i <= last:
+        length, distance = _match(src, chains, i)
+        if length and i + 1 <= last:
+            insert(i)
+            next_length, next_distance = _match(src, chains, i + 1)
+            if next_length > length + 1:
+                i += 1
+                length, distance = next_length, next_distance
+        elif not length:
+            insert(i)
+            i += 1
+            continue
+        else:
+            insert(i)
+        _sequence(out, src[anchor:i], length, distance)
+        for k in range(i + 1, min(i + length, last + 1)):
+            insert(k)
+        i += length
+        anchor = i
+    if anchor < n:
+        _sequence(out, src[anchor:], 0, 0)
+    return bytes(out)
+
+
+def expand_block(src, size):
+    """ota_lz_expand, to check the output."""
+    out = bytearray()
+    i = 0
+    while i < len(src):
+        token = src[i]
+        i += 1
+        lit = token >> 4
+        if lit == 15:
+            while True:
+                lit += src[i]
+                i += 1
+                if src[i - 1] != 255:
+                    break
+        out += src[i:i + lit]
+        i += lit
+        if i == len(src):
+            break
+        distance, = struct.unpack_from('<H', src, i)
+        i += 2
+        length = token & 15
+        if length == 15:
+            while True:
+                length += src[i]
+                i += 1
+                if src[i - 1] != 255:
+                    break
+        for _ in range(length + MIN_MATCH):
+            out.append(out[-distance])
+    if len(out) != size:
+        raise ValueError('block expands to %d bytes instead of %d' % (len(out), size))
+    return bytes(out)
+
+
+def compress(image, block_size=BLOCK_SIZE_MAX):
+    out = bytearray(HEADER.pack(MAGIC, len(image), block_size, crc16(image), 0))
+    for pos in range(0, len(image), block_size):
+        block = image[pos:pos + block_size]
+        packed = compress_block(block)
+        if len(packed) < len(block):
+            if expand_block(packed, len(block)) != block:
+                raise ValueError('block at %d does not expand back' % pos)
+            out += struct.pack('<H', len(packed)) + packed
+        else:
+            out += struct.pack('<H', len(block) | BLOCK_STORED) + block
+    return bytes(out)
+
+
+def main(argv):
+    block_size = BLOCK_SIZE_MAX
+    opts, args = getopt.getopt(argv[1:], 'b:')
+    for opt, value in opts:
+        if opt == '-b':
+            block_size = int(value, 0)
+    if not 1 <= len(args) <= 2 or not 0 < block_size <= BLOCK_SIZE_MAX:
+        sys.stderr.write(__doc__)
+        return 2
+
+    with open(args[0], 'rb') as f:
+        image = f.read()
+    packed = compress(image, block_size)
+    out_path = args[1] if len(args) > 1 else args[0] + '.ota'
+    with open(out_path, 'wb') as f:
+        f.write(packed)
+    print('%s: %d bytes, %d compressed (%.1f%%), CRC %04x' % (
+        out_path, len(image), len(packed), 100.0 * len(packed) / max(len(image), 1), crc16(packed)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -0,0 +1,476 @@
+/**
+******************************************************************************
+* @file    ota_delta.c
+* @version V1.0.0
+* @date    17-Oct-2026
+* @brief   Applies a delta OTA patch with checkpoints, see ota_delta.h for the
+*          format.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+
+#include "mico.h"
+#include "CheckSumUtils.h"
+#include "ota_delta.h"
+#include "ota_lz.h"
+
+#define delta_log(M, ...) custom_log("DELTA", M, ##__VA_ARGS__)
+
+#define BLOCK_SIZE          OTA_DELTA_BLOCK_SIZE
+#define CHECKPOINT_SLOTS    ( BLOCK_SIZE / sizeof(ota_delta_checkpoint_t) )
+
+/* Checkpoints rely on erasing a block of the new image at a time, which the
+   sectors of the internal flash are too large for */
+#ifdef USE_MICO_SPI_FLASH
+#define IS_SPI_FLASH( info )  ( (info)->partition_owner == MICO_FLASH_SPI )
+#else
+#define IS_SPI_FLASH( info )  ( false )
+#endif
+
+typedef struct {
+  const ota_delta_header_t *header;
+  uint32_t length;              // Patch length
+  mico_partition_t partition;   // Old image
+  uint32_t checkpointOffset;    // Checkpoint sector in OTA_TEMP
+  uint32_t checkpointSlot;      // Next free slot in it
+  uint32_t checkpointEvery;     // Blocks of the new image between checkpoints
+  uint32_t imageOffset;         // New image in OTA_TEMP
+
+  uint8_t *in;                  // A compressed block of operations
+  uint8_t *ops;                 // The expanded block of operations
+  uint32_t opsNext;             // OTA_TEMP offset of the block after it
+  uint32_t opsStart;            // Offset of ops[0] in the operations
+  uint32_t opsLength;           // Bytes in ops
+
+  uint8_t *old;                 // A window on the old image, also used to read back
+  uint32_t oldStart;
+  uint32_t oldLength;
+
+  uint8_t *out;                 // The block of the new image being built
+  ota_delta_checkpoint_t state;
+} ota_delta_t;
+
+static bool is_blank( const uint8_t *buf, uint32_t len )
+{
+  while( len-- ){
+    if( *buf++ != 0xFF )
+      return false;
+  }
+  return true;
+}
+
+/* Expanded length of the block of operations starting at offset */
+static uint32_t ops_block_length( const ota_delta_t *d, uint32_t offset )
+{
+  uint32_t left = d->header->ops_length - offset;
+  return ( left < d->header->block_size ) ? left : d->header->block_size;
+}
+
+/* Moves on to the next block of operations, expanding it into ops only if
+   load is set */
+static OSStatus ops_next_block( ota_delta_t *d, bool load )
+{
+  uint32_t copyLength, expandLength;
+  uint16_t blockSize;
+  OSStatus err = kNoErr;
+
+  d->opsStart += d->opsLength;
+  d->opsLength = 0;
+  require_action( d->opsStart < d->header->ops_length, exit, err = kMalformedErr );
+  expandLength = ops_block_length( d, d->opsStart );
+
+  require_action( d->opsNext + sizeof(blockSize) <= d->length, exit, err = kMalformedErr );
+  err = MicoFlashRead( MICO_PARTITION_OTA_TEMP, &d->opsNext, (uint8_t *)&blockSize, sizeof(blockSize) );
+  require_noerr(err, exit);
+  copyLength = blockSize & OTA_LZ_BLOCK_SIZE_MASK;
+  require_action( copyLength <= BLOCK_SIZE && d->opsNext + copyLength <= d->length, exit, err = kMalformedErr );
+
+  if( !load ){
+    d->opsNext += copyLength;
+  }else if( blockSize & OTA_LZ_BLOCK_STORED ){
+    require_action( copyLength == expandLength, exit, err = kMalformedErr );
+    err = MicoFlashRead( MICO_PARTITION_OTA_TEMP, &d->opsNext, d->ops, copyLength );
+    require_noerr(err, exit);
+  }else{
+    err = MicoFlashRead( MICO_PARTITION_OTA_TEMP, &d->opsNext, d->in, copyLength );
+    require_noerr(err, exit);
+    err = ota_lz_expand( d->in, copyLength, d->ops, expandLength );
+    require_noerr(err, exit);
+  }
+  d->opsLength = expandLength;
+
+exit:
+  return err;
+}
+
+/* Loads the block of operations holding offset, skipping those before it */
+static OSStatus ops_seek( ota_delta_t *d, uint32_t offset )
+{
+  uint32_t next;
+  OSStatus err = kNoErr;
+
+  d->opsNext = sizeof(ota_delta_header_t);
+  d->opsStart = 0;
+  d->opsLength = 0;
+  while( d->opsStart + d->opsLength <= offset && d->opsStart + d->opsLength < d->header->ops_length ){
+    next = d->opsStart + d->opsLength;
+    err = ops_next_block( d, next + ops_block_length( d, next ) > offset );
+    require_noerr(err, exit);
+  }
+
+exit:
+  return err;
+}
+
+/* Operations available from the current one on, in the block holding it */
+static OSStatus ops_avail( ota_delta_t *d, uint8_t **ops, uint32_t *avail )
+{
+  OSStatus err = kNoErr;
+
+  if( d->state.ops_offset == d->opsStart + d->opsLength ){
+    err = ops_next_block( d, true );
+    require_noerr(err, exit);
+  }
+  *ops = d->ops + ( d->state.ops_offset - d->opsStart );
+  *avail = d->opsStart + d->opsLength - d->state.ops_offset;
+
+exit:
+  return err;
+}
+
+static OSStatus ops_read( ota_delta_t *d, uint8_t *buf, uint32_t len )
+{
+  uint8_t *ops;
+  uint32_t avail;
+  OSStatus err = kNoErr;
+
+  while( len > 0 ){
+    err = ops_avail( d, &ops, &avail );
+    require_noerr(err, exit);
+    if( avail > len ) avail = len;
+    memcpy( buf, ops, avail );
+    buf += avail;
+    len -= avail;
+    d->state.ops_offset += avail;
+  }
+
+exit:
+  return err;
+}
+
+/* Bytes of the old image available from the current position on, reading a
+   new window when it leaves the one in old */
+static OSStatus old_avail( ota_delta_t *d, uint8_t **old, uint32_t *avail )
+{
+  uint32_t offset = d->state.old_offset;
+  OSStatus err = kNoErr;
+
+  require_action( offset < d->header->old_length, exit, err = kMalformedErr );
+  if( offset < d->oldStart || offset >= d->oldStart + d->oldLength ){
+    d->oldStart = offset;
+    d->oldLength = d->header->old_length - offset;
+    if( d->oldLength > BLOCK_SIZE ) d->oldLength = BLOCK_SIZE;
+    err = MicoFlashRead( d->partition, &offset, d->old, d->oldLength );
+    require_noerr_action(err, exit, d->oldLength = 0);
+  }
+  *old = d->old + ( d->state.old_offset - d->oldStart );
+  *avail = d->oldStart + d->oldLength - d->state.old_offset;
+
+exit:
+  return err;
+}
+
+/* The patch is only applied to the image it was made against */
+static OSStatus old_check( ota_delta_t *d )
+{
+  uint32_t offset = 0x0;
+  uint32_t left = d->header->old_length;
+  uint32_t len;
+  uint16_t crc;
+  CRC16_Context contex;
+  OSStatus err = kNoErr;
+
+  CRC16_Init( &contex );
+  d->oldLength = 0;
+  while( left > 0 ){
+    len = ( left < BLOCK_SIZE ) ? left : BLOCK_SIZE;
+    err = MicoFlashRead( d->partition, &offset, d->old, len );
+    require_noerr(err, exit);
+    CRC16_Update( &contex, d->old, len );
+    left -= len;
+  }
+  CRC16_Final( &contex, &crc );
+  require_action( crc == d->header->old_crc, exit, err = kChecksumErr );
+
+exit:
+  return err;
+}
+
+/* Erases the sectors from start to end that are not blank, usually none */
+static OSStatus erase_dirty( ota_delta_t *d, uint32_t start, uint32_t end )
+{
+  uint32_t offset;
+  OSStatus err = kNoErr;
+
+  d->oldLength = 0;
+  for( ; start < end; start += BLOCK_SIZE ){
+    offset = start;
+    err = MicoFlashRead( MICO_PARTITION_OTA_TEMP, &offset, d->old, BLOCK_SIZE );
+    require_noerr(err, exit);
+    if( is_blank( d->old, BLOCK_SIZE ) )
+      continue;
+    err = MicoFlashDisableSecurity( MICO_PARTITION_OTA_TEMP, start, BLOCK_SIZE );
+    require_noerr(err, exit);
+    err = MicoFlashErase( MICO_PARTITION_OTA_TEMP, start, BLOCK_SIZE );
+    require_noerr(err, exit);
+  }
+
+exit:
+  return err;
+}
+
+/* Checkpoints of another patch, or torn by a reset, do not check */
+static uint16_t checkpoint_check( const ota_delta_header_t *header, const ota_delta_checkpoint_t *checkpoint )
+{
+  uint16_t crc;
+  CRC16_Context contex;
+
+  CRC16_Init( &contex );
+  CRC16_Update( &contex, header, sizeof(ota_delta_header_t) );
+  CRC16_Update( &contex, checkpoint, offsetof(ota_delta_checkpoint_t, check) );
+  CRC16_Final( &contex, &crc );
+  return crc;
+}
+
+/* Takes the state from the last checkpoint that checks, and finds the slot
+   after the last one written */
+static OSStatus checkpoint_load( ota_delta_t *d, bool *found )
+{
+  ota_delta_checkpoint_t checkpoint;
+  uint32_t offset = d->checkpointOffset;
+  uint32_t i;
+  OSStatus err = kNoErr;
+
+  *found = false;
+  d->checkpointSlot = 0;
+  d->oldLength = 0;
+  err = MicoFlashRead( MICO_PARTITION_OTA_TEMP, &offset, d->old, BLOCK_SIZE );
+  require_noerr(err, exit);
+
+  for( i = 0; i < CHECKPOINT_SLOTS; i++ ){
+    memcpy( &checkpoint, d->old + i * sizeof(ota_delta_checkpoint_t), sizeof(ota_delta_checkpoint_t) );
+    if( is_blank( (uint8_t *)&checkpoint, sizeof(ota_delta_checkpoint_t) ) )
+      continue;
+    d->checkpointSlot = i + 1;
+    if( checkpoint.check != checkpoint_check( d->header, &checkpoint ) || checkpoint.out_length > d->header->new_length )
+      continue;
+    memcpy( &d->state, &checkpoint, sizeof(ota_delta_checkpoint_t) );
+    *found = true;
+  }
+
+exit:
+  return err;
+}
+
+static OSStatus checkpoint_save( ota_delta_t *d )
+{
+  uint32_t offset;
+  OSStatus err = kNoErr;
+
+  /* Out of slots, after many resets: start the sector again, a reset before
+     the first checkpoint is written only costs starting the image again */
+  if( d->checkpointSlot >= CHECKPOINT_SLOTS ){
+    err = MicoFlashDisableSecurity( MICO_PARTITION_OTA_TEMP, d->checkpointOffset, BLOCK_SIZE );
+    require_noerr(err, exit);
+    err = MicoFlashErase( MICO_PARTITION_OTA_TEMP, d->checkpointOffset, BLOCK_SIZE );
+    require_noerr(err, exit);
+    d->checkpointSlot = 0;
+  }
+
+  d->state.reserved = 0x0;
+  d->state.check = checkpoint_check( d->header, &d->state );
+  offset = d->checkpointOffset + d->checkpointSlot++ * sizeof(ota_delta_checkpoint_t);
+  err = MicoFlashWrite( MICO_PARTITION_OTA_TEMP, &offset, (uint8_t *)&d->state, sizeof(ota_delta_checkpoint_t) );
+
+exit:
+  return err;
+}
+
+/* Writes the block built in out and reads it back, then checkpoints every few
+   blocks, and once the image is complete and its CRC checks */
+static OSStatus flush_block( ota_delta_t *d, CRC16_Context *contex )
+{
+  uint32_t length = d->state.out_length % BLOCK_SIZE;
+  uint32_t offset;
+  uint16_t crc;
+  CRC16_Context final;
+  OSStatus err = kNoErr;
+
+  if( length == 0 ) length = BLOCK_SIZE;
+  offset = d->imageOffset + d->state.out_length - length;
+  err = MicoFlashWrite( MICO_PARTITION_OTA_TEMP, &offset, d->out, length );
+  require_noerr(err, exit);
+  offset -= length;
+  d->oldLength = 0;
+  err = MicoFlashRead( MICO_PARTITION_OTA_TEMP, &offset, d->old, length );
+  require_noerr(err, exit);
+  err = memcmp( d->old, d->out, length );
+  require_noerr_action(err, exit, err = kWriteErr);
+
+  CRC16_Update( contex, d->out, length );
+  d->state.crc = contex->crc;
+
+  if( d->state.out_length == d->header->new_length ){
+    memcpy( &final, contex, sizeof(CRC16_Context) );
+    CRC16_Final( &final, &crc );
+    require_action( crc == d->header->new_crc, exit, err = kChecksumErr );
+    err = checkpoint_save( d );
+  }else if( ( d->state.out_length / BLOCK_SIZE ) % d->checkpointEvery == 0 ){
+    err = checkpoint_save( d );
+  }
+
+exit:
+  return err;
+}
+
+OSStatus ota_delta_apply( const ota_delta_header_t *header, uint32_t length, mico_partition_t partition,
+                          uint32_t *imageOffset, uint8_t *work )
+{
+  mico_logic_partition_t *ota_partition_info = MicoFlashGetInfo( MICO_PARTITION_OTA_TEMP );
+  mico_logic_partition_t *partition_info = MicoFlashGetInfo( partition );
+  ota_delta_t delta, *d = &delta;
+  CRC16_Context contex;
+  uint32_t op[OTA_DELTA_OP_SIZE / sizeof(uint32_t)];
+  uint32_t blocks, left, n, k;
+  uint32_t opsAvail, oldAvail;
+  uint8_t *ops, *old, *out;
+  bool resumed;
+  OSStatus err = kNoErr;
+
+  memset( d, 0x0, sizeof(ota_delta_t) );
+  d->header = header;
+  d->length = length;
+  d->partition = partition;
+  d->in = work;
+  d->ops = work + BLOCK_SIZE;
+  d->old = work + 2 * BLOCK_SIZE;
+  d->out = work + 3 * BLOCK_SIZE;
+
+  require_action( IS_SPI_FLASH( ota_partition_info ), exit, err = kUnsupportedErr );
+  require_action( length >= sizeof(ota_delta_header_t), exit, err = kMalformedErr );
+  require_action( header->block_size > 0 && header->block_size <= BLOCK_SIZE, exit, err = kMalformedErr );
+  require_action( header->old_length <= partition_info->partition_length, exit, err = kChecksumErr );
+  require_action( header->new_length > 0 && header->new_length <= partition_info->partition_length, exit, err = kSizeErr );
+
+  d->checkpointOffset = ( length + BLOCK_SIZE - 1 ) / BLOCK_SIZE * BLOCK_SIZE;
+  d->imageOffset = d->checkpointOffset + BLOCK_SIZE;
+  blocks = ( header->new_length + BLOCK_SIZE - 1 ) / BLOCK_SIZE;
+  require_action( d->imageOffset + blocks * BLOCK_SIZE <= ota_partition_info->partition_length, exit, err = kSizeErr );
+  /* One slot spare for a checkpoint torn by a reset */
+  d->checkpointEvery = ( blocks + CHECKPOINT_SLOTS - 2 ) / ( CHECKPOINT_SLOTS - 1 );
+
+  /* Once the new image is complete, the old one may already be overwritten by
+     a copy cut by a reset */
+  err = checkpoint_load( d, &resumed );
+  require_noerr(err, exit);
+  if( resumed && d->state.out_length == header->new_length ){
+    delta_log("New image already built");
+    goto done;
+  }
+
+  /* Checked again when going on after a reset, the old image is still read */
+  err = old_check( d );
+  require_noerr(err, exit);
+
+  if( resumed ){
+    delta_log("Go on from %d of %d bytes", d->state.out_length, header->new_length);
+    err = erase_dirty( d, d->imageOffset + d->state.out_length, d->imageOffset + blocks * BLOCK_SIZE );
+    require_noerr(err, exit);
+  }else{
+    memset( &d->state, 0x0, sizeof(ota_delta_checkpoint_t) );
+    d->checkpointSlot = 0;
+    err = erase_dirty( d, d->checkpointOffset, d->imageOffset + blocks * BLOCK_SIZE );
+    require_noerr(err, exit);
+  }
+
+  CRC16_Init( &contex );
+  contex.crc = d->state.crc;
+  err = ops_seek( d, d->state.ops_offset );
+  require_noerr(err, exit);
+
+  while( d->state.out_length < header->new_length ){
+    if( d->state.diff_left == 0 && d->state.extra_left == 0 ){
+      err = ops_read( d, (uint8_t *)op, OTA_DELTA_OP_SIZE );
+      require_noerr(err, exit);
+      left = header->new_length - d->state.out_length;
+      require_action( op[0] <= left && op[1] <= left - op[0], exit, err = kMalformedErr );
+      d->state.diff_left = op[0];
+      d->state.extra_left = op[1];
+      d->state.seek = (int32_t)op[2];
+    }
+
+    out = d->out + d->state.out_length % BLOCK_SIZE;
+    n = BLOCK_SIZE - d->state.out_length % BLOCK_SIZE;
+    if( d->state.diff_left ){
+      err = ops_avail( d, &ops, &opsAvail );
+      require_noerr(err, exit);
+      err = old_avail( d, &old, &oldAvail );
+      require_noerr(err, exit);
+      if( n > d->state.diff_left ) n = d->state.diff_left;
+      if( n > opsAvail ) n = opsAvail;
+      if( n > oldAvail ) n = oldAvail;
+      for( k = 0; k < n; k++ )
+        out[k] = ops[k] + old[k];
+      d->state.diff_left -= n;
+      d->state.old_offset += n;
+    }else if( d->state.extra_left ){
+      err = ops_avail( d, &ops, &opsAvail );
+      require_noerr(err, exit);
+      if( n > d->state.extra_left ) n = d->state.extra_left;
+      if( n > opsAvail ) n = opsAvail;
+      memcpy( out, ops, n );
+      d->state.extra_left -= n;
+    }else{
+      n = 0;
+    }
+    d->state.ops_offset += n;
+    d->state.out_length += n;
+
+    if( d->state.diff_left == 0 && d->state.extra_left == 0 ){
+      d->state.old_offset += d->state.seek;
+      d->state.seek = 0;
+    }
+    if( n && ( d->state.out_length % BLOCK_SIZE == 0 || d->state.out_length == header->new_length ) ){
+      err = flush_block( d, &contex );
+      require_noerr(err, exit);
+    }
+  }
+
+done:
+  *imageOffset = d->imageOffset;
+
+exit:
+  if(err != kNoErr) delta_log("Delta update error %d at %d bytes", err, d->state.out_length);
+  return err;
+}
@@ -0,0 +1,105 @@
+/**
+******************************************************************************
+* @file    ota_delta.h
+* @version V1.0.0
+* @date    17-Oct-2026
+* @brief   Delta OTA patch, made by ota_delta.py against the installed image
+*          and applied by the bootloader.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+
+#ifndef __OTA_DELTA_H__
+#define __OTA_DELTA_H__
+
+#include "Common.h"
+#include "MicoDrivers/MICODriverFlash.h"
+
+/*
+ * The patch is a header followed by a stream of operations, cut into blocks
+ * compressed as in ota_lz.h. An operation is three 32 bit little endian
+ * words, diff_len, extra_len and seek, then diff_len bytes added to as many
+ * bytes of the old image to give the new one, then extra_len bytes copied as
+ * they are; the position in the old image moves on past the bytes added,
+ * then by seek, which may be negative.
+ *
+ * The new image is built in MICO_PARTITION_OTA_TEMP behind the patch, from
+ * the first 4 KB boundary after it: one sector of checkpoints, then the image.
+ * A checkpoint is written after every few blocks of the new image, so that
+ * an update cut by a reset goes on from the last one.
+ */
+
+#define OTA_DELTA_MAGIC         ( 0x3144544F )  /* "OTD1" */
+#define OTA_DELTA_OP_SIZE       ( 12 )
+#define OTA_DELTA_BLOCK_SIZE    ( 4096 )        /* New image between checkpoints, and OTA_TEMP sector */
+#define OTA_DELTA_WORK_SIZE     ( 4 * OTA_DELTA_BLOCK_SIZE )
+
+typedef struct _ota_delta_header_t {
+  uint32_t magic;       // OTA_DELTA_MAGIC
+  uint32_t old_length;  // Length of the image the patch applies to
+  uint32_t new_length;  // Length of the image it gives
+  uint16_t old_crc;     // CRC16 of the image the patch applies to
+  uint16_t new_crc;     // CRC16 of the image it gives
+  uint32_t ops_length;  // Length of the operations once expanded
+  uint16_t block_size;  // Expanded bytes per block of operations
+  uint16_t reserved;
+} ota_delta_header_t;
+
+typedef struct _ota_delta_checkpoint_t {
+  uint32_t out_length;  // Bytes of the new image written and read back
+  uint32_t ops_offset;  // Bytes of operations done
+  uint32_t old_offset;  // Position in the old image
+  uint32_t diff_left;   // Rest of the current operation
+  uint32_t extra_left;
+  int32_t  seek;
+  uint16_t crc;         // CRC16 of the new image so far, before CRC16_Final
+  uint16_t check;       // CRC16 of the header and the fields above
+  uint32_t reserved;
+} ota_delta_checkpoint_t;
+
+/**
+ * @brief  Builds the new image from a patch in MICO_PARTITION_OTA_TEMP and
+ *         the image in a partition, or goes on with it after a reset.
+ *
+ * @param  header: The header at the start of MICO_PARTITION_OTA_TEMP.
+ * @param  length: Length of the patch, header included.
+ * @param  partition: Partition holding the image the patch applies to, left
+ *         untouched.
+ * @param  imageOffset: Receives where the new image is in
+ *         MICO_PARTITION_OTA_TEMP.
+ * @param  work: OTA_DELTA_WORK_SIZE bytes of RAM.
+ *
+ * @return kNoErr once the new image is complete and its CRC checked,
+ *         kChecksumErr if the partition does not hold the image the patch was
+ *         made against or the result is wrong, kSizeErr if the new image does
+ *         not fit behind the patch, kUnsupportedErr if MICO_PARTITION_OTA_TEMP
+ *         is not on SPI flash, kMalformedErr for a corrupt patch.
+ */
+OSStatus ota_delta_apply( const ota_delta_header_t *header, uint32_t length, mico_partition_t partition,
+                          uint32_t *imageOffset, uint8_t *work );
+
+/* Host test of ota_delta_apply() with power cuts, see ota_delta_test.c */
+OSStatus ota_delta_test( int print );
+
+#endif
@@ -0,0 +1,208 @@
+#!/usr/bin/env python
+"""Make a delta OTA patch from the installed image to a new one.
+
+The output is the patch described in Bootloader/ota_delta.h: a 24 byte header
+and a stream of operations, each adding bytes to a stretch of the old image,
+mostly zeros where code only moved, or carrying new bytes as they are. The
+stream is compressed in blocks as ota_compress.py does. Send it instead of the
+new image; the bootloader checks that the installed image is the old one,
+builds the new image behind the patch in the OTA partition and copies it.
+
+usage: ota_delta.py [-b block_size] old.bin new.bin [patch.otd]
+       (writes new.bin.otd without a third argument)
+       ota_delta.py -a old.bin patch.otd new.bin
+       (applies the patch, to check it)
+"""
+
+import getopt
+import struct
+import sys
+
+from ota_compress import BLOCK_SIZE_MAX, BLOCK_STORED, compress_block, expand_block, crc16
+
+MAGIC = 0x3144544F          # "OTD1"
+HEADER = struct.Struct('<IIIHHIHH')
+OP = struct.Struct('<IIi')
+BLOCK_SIZE_MASK = 0x7FFF
+KEY = 8                     # Bytes hashed to find a match
+MAX_CANDIDATES = 16         # Positions of the old image tried for each match
+MAX_MISS = 128              # Bytes past the last gain before a match ends
+
+
+def _index(old):
+    index = {}
+    for i in range(len(old) - KEY + 1):
+        positions = index.setdefault(old[i:i + KEY], [])
+        if len(positions) < MAX_CANDIDATES:
+            positions.append(i)
+    return index
+
+
+def _exact(old, new, j, i):
+    k = 0
+    n = min(len(old) - j, len(new) - i)
+    while k < n and old[j + k] == new[i + k]:
+        k += 1
+    return k
+
+
+def _forward(old, new, j, i):
+    """Length of the stretch from (j, i) where the bytes that differ, which
+    cost a diff byte each, are outweighed by those that match."""
+    score = best = best_len = 0
+    n = min(len(old) - j, len(new) - i)
+    k = 0
+    while k < n and k - best_len <= MAX_MISS:
+        score += 1 if old[j + k] == new[i + k] else -1
+        k += 1
+        if score > best:
+            best, best_len = score, k
+    return best_len
+
+
+def _backward(old, new, j, i, limit):
+    """Length to extend the stretch at (j, i) back by, over at most limit
+    bytes that would otherwise go as they are."""
+    score = best = best_len = 0
+    limit = min(limit, j)
+    k = 0
+    while k < limit and k - best_len <= MAX_MISS:
+        k += 1
+        score += 1 if old[j - k] == new[i - k] else -1
+        if score > best:
+            best, best_len = score, k
+    return best_len
+
+
+def regions(old, new):
+    """Stretches of the new image made from the old one, as (new position,
+    old position, length), in order and apart."""
+    index = _index(old)
+    found = []
+    i = 0
+    shift = None
+    while i + KEY <= len(new):
+        key = new[i:i + KEY]
+        best_j, best_len = None, 0
+        # Code that only moved keeps the shift of the stretch before
+        if shift is not None and 0 <= i + shift <= len(old) - KEY and old[i + shift:i + shift + KEY] == key:
+            best_j, best_len = i + shift, _exact(old, new, i + shift, i)
+        for j in index.get(key, ()):
+            if best_len >= 256:
+                break
+            k = _exact(old, new, j, i)
+            if k > best_len:
+                best_j, best_len = j, k
+        if best_j is None:
+            i += 1
+            continue
+
+        length = max(best_len, _forward(old, new, best_j, i))
+        gap_start = found[-1][0] + found[-1][2] if found else 0
+        back = _backward(old, new, best_j, i, i - gap_start)
+        found.append((i - back, best_j - back, length + back))
+        shift = best_j - i
+        i += length
+    return found
+
+
+def operations(old, new):
+    out = bytearray()
+    found = regions(old, new)
+    if not found or found[0][0] > 0:
+        first = found[0] if found else (len(new), 0, 0)
+        out += OP.pack(0, first[0], first[1]) + new[:first[0]]
+    for n, (pos, old_pos, length) in enumerate(found):
+        end = pos + length
+        if n + 1 < len(found):
+            next_pos, next_old = found[n + 1][0], found[n + 1][1]
+        else:
+            next_pos, next_old = len(new), old_pos + length
+        out += OP.pack(length, next_pos - end, next_old - (old_pos + length))
+        out += bytes((new[pos + k] - old[old_pos + k]) & 0xFF for k in range(length))
+        out += new[end:next_pos]
+    return bytes(out)
+
+
+def make(old, new, block_size=BLOCK_SIZE_MAX):
+    ops = operations(old, new)
+    out = bytearray(HEADER.pack(MAGIC, len(old), len(new), crc16(old), crc16(new), len(ops), block_size, 0))
+    for pos in range(0, len(ops), block_size):
+        block = ops[pos:pos + block_size]
+        packed = compress_block(block)
+        if len(packed) < len(block):
+            out += struct.pack('<H', len(packed)) + packed
+        else:
+            out += struct.pack('<H', len(block) | BLOCK_STORED) + block
+    return bytes(out)
+
+
+def apply(old, patch):
+    """ota_delta_apply, without the checkpoints."""
+    magic, old_len, new_len, old_crc, new_crc, ops_len, block_size, _ = HEADER.unpack_from(patch)
+    if magic != MAGIC:
+        raise ValueError('not a delta patch')
+    if old_len > len(old) or crc16(old[:old_len]) != old_crc:
+        raise ValueError('patch made against another image')
+    ops = bytearray()
+    pos = HEADER.size
+    while len(ops) < ops_len:
+        size, = struct.unpack_from('<H', patch, pos)
+        block = patch[pos + 2:pos + 2 + (size & BLOCK_SIZE_MASK)]
+        pos += 2 + (size & BLOCK_SIZE_MASK)
+        expand = min(block_size, ops_len - len(ops))
+        ops += block if size & BLOCK_STORED else expand_block(block, expand)
+
+    new = bytearray()
+    pos = old_pos = 0
+    while len(new) < new_len:
+        diff, extra, seek = OP.unpack_from(ops, pos)
+        pos += OP.size
+        new += bytes((ops[pos + k] + old[old_pos + k]) & 0xFF for k in range(diff))
+        pos += diff
+        old_pos += diff
+        new += ops[pos:pos + extra]
+        pos += extra
+        old_pos += seek
+    if len(new) != new_len or crc16(bytes(new)) != new_crc:
+        raise ValueError('patch gives a wrong image')
+    return bytes(new)
+
+
+def main(argv):
+    block_size = BLOCK_SIZE_MAX
+    check = False
+    opts, args = getopt.getopt(argv[1:], 'ab:')
+    for opt, value in opts:
+        if opt == '-b':
+            block_size = int(value, 0)
+        elif opt == '-a':
+            check = True
+    if not (len(args) == 3 if check else 2 <= len(args) <= 3) or not 0 < block_size <= BLOCK_SIZE_MAX:
+        sys.stderr.write(__doc__)
+        return 2
+
+    with open(args[0], 'rb') as f:
+        old = f.read()
+    with open(args[1], 'rb') as f:
+        second = f.read()
+    if check:
+        new = apply(old, second)
+        with open(args[2], 'wb') as f:
+            f.write(new)
+        print('%s: %d bytes, CRC %04x' % (args[2], len(new), crc16(new)))
+        return 0
+
+    patch = make(old, second, block_size)
+    if apply(old, patch) != second:
+        raise ValueError('patch does not apply back')
+    out_path = args[2] if len(args) > 2 else args[1] + '.otd'
+    with open(out_path, 'wb') as f:
+        f.write(patch)
+    print('%s: %d bytes against %d, patch %d bytes (%.1f%%), CRC %04x' % (
+        out_path, len(second), len(old), len(patch), 100.0 * len(patch) / max(len(second), 1), crc16(patch)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
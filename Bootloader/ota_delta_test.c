@@ -0,0 +1,533 @@
+/**
+******************************************************************************
+* @file    ota_delta_test.c
+* @version V1.0.0
+* @date    17-Oct-2026
+* @brief   Host test of ota_delta_apply(). Patches are made here, with inserted,
+*          deleted and moved stretches and blocks of operations both stored
+*          and compressed, and applied against the application partition into
+*          a simulated SPI flash OTA partition. Checks the new image, that the
+*          patch is refused against another image, that corrupt patches never
+*          give a wrong image, and, with the power cut at random writes and
+*          erases, that every boot goes on from the last checkpoint, also once
+*          the checkpoint sector is full and after checkpoints of another
+*          patch. Then applies ota_delta_test.otd, made by
+*            ota_delta.py BCM43362-5.90.230.10.bin BCM43362-5.90.230.12.bin
+*          from the RF drivers in MICO/core/RF driver, to the first of them,
+*          with and without power cuts. Built on the host on its own, it
+*          includes ota_delta.c; ota_lz.c and CheckSumUtils.c are needed too.
+*          Run from the repository root, or with OTA_TEST_ROOT set to it. Not
+*          part of the default build.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Checkpoints are only written on SPI flash */
+#ifndef USE_MICO_SPI_FLASH
+#define USE_MICO_SPI_FLASH
+#endif
+
+#include "ota_delta.c"
+
+#define DELTA_TEST_APP_SIZE     ( 0x80000 )
+#define DELTA_TEST_OTA_SIZE     ( 0x100000 )
+#define DELTA_TEST_OLD_LENGTH   ( 400000 )
+#define DELTA_TEST_PATCH_SIZE   ( 0x20000 )
+#define DELTA_TEST_FUZZ         ( 400 )
+#define DELTA_TEST_RUNS         ( 150 )
+#define DELTA_TEST_FILE_RUNS    ( 30 )
+
+#ifndef OTA_TEST_ROOT
+#define OTA_TEST_ROOT           "."
+#endif
+#define DELTA_TEST_FILE_OLD     OTA_TEST_ROOT "/MICO/core/RF driver/BCM43362-5.90.230.10.bin"
+#define DELTA_TEST_FILE_NEW     OTA_TEST_ROOT "/MICO/core/RF driver/BCM43362-5.90.230.12.bin"
+#define DELTA_TEST_FILE_PATCH   OTA_TEST_ROOT "/Bootloader/ota_delta_test.otd"
+
+/* The new image from stretches of the old one, each followed by new bytes;
+   the position in the old image skips deleted bytes and goes back for a
+   moved stretch */
+typedef struct {
+  uint32_t old_offset;
+  uint32_t length;
+  uint32_t extra;
+} delta_test_piece_t;
+
+static const delta_test_piece_t delta_test_pieces[] = {
+  { 0,      120000, 0     },
+  { 120000, 40000,  6000  },  /* Inserted code */
+  { 164000, 60000,  0     },  /* 4000 bytes deleted */
+  { 80000,  20000,  1000  },  /* Moved, the old position goes back */
+  { 224000, 0,      3000  },  /* New bytes only */
+  { 224000, 176000, 40000 },  /* Grown at the end */
+};
+
+static uint8_t *delta_test_flash[2];   /* Application, OTA temporary */
+static uint32_t delta_test_size[2] = { DELTA_TEST_APP_SIZE, DELTA_TEST_OTA_SIZE };
+static mico_logic_partition_t delta_test_partitions[2] = {
+  { MICO_FLASH_EMBEDDED, "Application", 0x13000, DELTA_TEST_APP_SIZE, 0 },
+  { MICO_FLASH_SPI, "OTA Storage", 0x0, DELTA_TEST_OTA_SIZE, 0 },
+};
+static long delta_test_ops, delta_test_cut = -1;   /* Writes and erases, and the one the power fails at */
+static unsigned long delta_test_read[2], delta_test_written[2], delta_test_erased[2], delta_test_reprogrammed;
+static uint32_t delta_test_image_offset;           /* Bytes written from there on are counted apart */
+static unsigned long delta_test_image_written, delta_test_checkpoint_erases;
+static jmp_buf delta_test_power_cut;
+static uint32_t delta_test_seed = 1;
+static uint8_t delta_test_work[OTA_DELTA_WORK_SIZE];
+
+static uint32_t delta_test_rand( uint32_t n )
+{
+  delta_test_seed = delta_test_seed * 1103515245 + 12345;
+  return ( delta_test_seed >> 8 ) % n;
+}
+
+static int delta_test_bank( mico_partition_t partition )
+{
+  return ( partition == MICO_PARTITION_OTA_TEMP ) ? 1 : 0;
+}
+
+mico_logic_partition_t *MicoFlashGetInfo( mico_partition_t inPartition )
+{
+  return &delta_test_partitions[delta_test_bank( inPartition )];
+}
+
+OSStatus MicoFlashDisableSecurity( mico_partition_t partition, uint32_t off_set, uint32_t size )
+{
+  return kNoErr;
+}
+
+/* Erases 4 KB sectors, one cut by the power is left partly erased */
+OSStatus MicoFlashErase( mico_partition_t inPartition, uint32_t off_set, uint32_t size )
+{
+  int bank = delta_test_bank( inPartition );
+  uint8_t *flash = delta_test_flash[bank];
+  uint32_t start = off_set / BLOCK_SIZE * BLOCK_SIZE, end = ( off_set + size + BLOCK_SIZE - 1 ) / BLOCK_SIZE * BLOCK_SIZE, i;
+
+  if( end > delta_test_size[bank] ) return kParamErr;
+  for( ; start < end; start += BLOCK_SIZE ) {
+    if( ++delta_test_ops == delta_test_cut ) {
+      for( i = start; i < start + BLOCK_SIZE; i++ )
+        if( delta_test_rand( 2 ) ) flash[i] = 0xFF;
+      longjmp( delta_test_power_cut, 1 );
+    }
+    memset( &flash[start], 0xFF, BLOCK_SIZE );
+    delta_test_erased[bank]++;
+    if( bank == 1 && start + BLOCK_SIZE == delta_test_image_offset ) delta_test_checkpoint_erases++;
+  }
+  return kNoErr;
+}
+
+/* A write cut by the power programs only the bytes before the cut */
+OSStatus MicoFlashWrite( mico_partition_t inPartition, volatile uint32_t* off_set, uint8_t* inBuffer, uint32_t inBufferLength )
+{
+  int bank = delta_test_bank( inPartition );
+  uint8_t *flash = delta_test_flash[bank];
+  uint32_t length = inBufferLength, i;
+  bool cut;
+
+  if( *off_set + inBufferLength > delta_test_size[bank] ) return kParamErr;
+  cut = ( ++delta_test_ops == delta_test_cut );
+  if( cut ) length = delta_test_rand( inBufferLength + 1 );
+  if( bank == 1 && *off_set >= delta_test_image_offset ) delta_test_image_written += length;
+  for( i = 0; i < length; i++, (*off_set)++ ) {
+    if( ( flash[*off_set] & inBuffer[i] ) != inBuffer[i] ) delta_test_reprogrammed++;
+    flash[*off_set] &= inBuffer[i];
+  }
+  if( cut ) longjmp( delta_test_power_cut, 1 );
+  delta_test_written[bank] += length;
+  return kNoErr;
+}
+
+OSStatus MicoFlashRead( mico_partition_t inPartition, volatile uint32_t* off_set, uint8_t* outBuffer, uint32_t inBufferLength )
+{
+  int bank = delta_test_bank( inPartition );
+
+  if( *off_set + inBufferLength > delta_test_size[bank] ) return kParamErr;
+  delta_test_read[bank] += inBufferLength;
+  memcpy( outBuffer, &delta_test_flash[bank][*off_set], inBufferLength );
+  *off_set += inBufferLength;
+  return kNoErr;
+}
+
+uint32_t mico_get_time( void )
+{
+  return 0;
+}
+
+static uint16_t delta_test_crc( const uint8_t *data, uint32_t length )
+{
+  CRC16_Context contex;
+  uint16_t crc;
+
+  CRC16_Init( &contex );
+  CRC16_Update( &contex, data, length );
+  CRC16_Final( &contex, &crc );
+  return crc;
+}
+
+/* Some code to patch: short runs of repeated bytes among random ones */
+static void delta_test_old_image( uint8_t *old, uint32_t length )
+{
+  uint32_t i = 0, run;
+
+  while( i < length ) {
+    run = delta_test_rand( 4 ) ? 1 : 2 + delta_test_rand( 12 );
+    old[i] = delta_test_rand( 256 );
+    for( i++; --run && i < length; i++ ) old[i] = old[i - 1];
+  }
+}
+
+/* The new image, with every so many bytes changed in the stretches taken from
+   the old one, as addresses are when code moves */
+static uint32_t delta_test_new_image( const uint8_t *old, uint8_t *new, uint8_t variant )
+{
+  const delta_test_piece_t *piece;
+  uint32_t length = 0, i;
+
+  for( piece = delta_test_pieces; piece < delta_test_pieces + sizeof(delta_test_pieces) / sizeof(delta_test_pieces[0]); piece++ ) {
+    for( i = 0; i < piece->length; i++ )
+      new[length + i] = old[piece->old_offset + i] + ( ( ( piece->old_offset + i ) % 251 < 4 ) ? variant : 0 );
+    length += piece->length;
+    for( i = 0; i < piece->extra; i++ )
+      new[length++] = delta_test_rand( 256 );
+  }
+  return length;
+}
+
+static void delta_test_put32( uint8_t *p, uint32_t value )
+{
+  p[0] = value; p[1] = value >> 8; p[2] = value >> 16; p[3] = value >> 24;
+}
+
+static uint8_t *delta_test_put_length( uint8_t *p, uint32_t length )
+{
+  for( length -= 15; length >= 255; length -= 255 ) *p++ = 255;
+  *p++ = length;
+  return p;
+}
+
+/* One sequence of literals, then a match at distance 1 of length match, none
+   if 0, as ota_compress.py would for a run */
+static uint8_t *delta_test_sequence( uint8_t *p, const uint8_t *literals, uint32_t count, uint32_t match )
+{
+  uint8_t *token = p++;
+
+  *token = ( ( count < 15 ) ? count : 15 ) << 4;
+  if( count >= 15 ) p = delta_test_put_length( p, count );
+  memcpy( p, literals, count );
+  p += count;
+  if( match ) {
+    *p++ = 1;
+    *p++ = 0;
+    match -= OTA_LZ_MIN_MATCH;
+    *token |= ( match < 15 ) ? match : 15;
+    if( match >= 15 ) p = delta_test_put_length( p, match );
+  }
+  return p;
+}
+
+/* Compresses runs of a byte only, which the operations are full of */
+static uint32_t delta_test_compress( const uint8_t *in, uint32_t length, uint8_t *out )
+{
+  uint8_t *p = out;
+  uint32_t start = 0, i = 0, run;
+
+  while( i < length ) {
+    for( run = 1; i + run < length && in[i + run] == in[i]; run++ );
+    if( run > 8 ) {
+      p = delta_test_sequence( p, in + start, i + 1 - start, run - 1 );
+      start = i + run;
+    }
+    i += run;
+  }
+  p = delta_test_sequence( p, in + start, length - start, 0 );
+  return p - out;
+}
+
+/* Makes the patch from old to new, its operations cut into blocks of
+   block_size, each compressed unless that makes it larger */
+static uint32_t delta_test_patch( const uint8_t *old, const uint8_t *new, uint32_t new_length,
+                                  uint16_t block_size, uint8_t *patch )
+{
+  static uint8_t ops[DELTA_TEST_APP_SIZE], block[2 * BLOCK_SIZE];
+  const delta_test_piece_t *piece, *end = delta_test_pieces + sizeof(delta_test_pieces) / sizeof(delta_test_pieces[0]);
+  uint32_t ops_length = 0, out = 0, length, offset, i;
+  ota_delta_header_t header;
+
+  for( piece = delta_test_pieces; piece < end; piece++ ) {
+    delta_test_put32( &ops[ops_length], piece->length );
+    delta_test_put32( &ops[ops_length + 4], piece->extra );
+    delta_test_put32( &ops[ops_length + 8], ( piece + 1 < end ) ? ( piece + 1 )->old_offset - piece->old_offset - piece->length : 0 );
+    ops_length += OTA_DELTA_OP_SIZE;
+    for( i = 0; i < piece->length; i++ )
+      ops[ops_length++] = new[out + i] - old[piece->old_offset + i];
+    memcpy( &ops[ops_length], &new[out + piece->length], piece->extra );
+    ops_length += piece->extra;
+    out += piece->length + piece->extra;
+  }
+
+  header.magic = OTA_DELTA_MAGIC;
+  header.old_length = DELTA_TEST_OLD_LENGTH;
+  header.new_length = new_length;
+  header.old_crc = delta_test_crc( old, DELTA_TEST_OLD_LENGTH );
+  header.new_crc = delta_test_crc( new, new_length );
+  header.ops_length = ops_length;
+  header.block_size = block_size;
+  header.reserved = 0;
+  memcpy( patch, &header, sizeof(header) );
+  length = sizeof(header);
+
+  for( offset = 0; offset < ops_length; offset += i ) {
+    i = ( ops_length - offset < block_size ) ? ops_length - offset : block_size;
+    out = delta_test_compress( &ops[offset], i, block );
+    if( out < i ) {
+      patch[length++] = out;
+      patch[length++] = out >> 8;
+      memcpy( &patch[length], block, out );
+      length += out;
+    } else {
+      patch[length++] = i;
+      patch[length++] = ( i | OTA_LZ_BLOCK_STORED ) >> 8;
+      memcpy( &patch[length], &ops[offset], i );
+      length += i;
+    }
+  }
+  return length;
+}
+
+/* The update data as the bootloader finds it: the old image installed, the
+   patch downloaded and the rest of the partition blank */
+static void delta_test_setup( const uint8_t *old, uint32_t old_length, const uint8_t *patch, uint32_t length )
+{
+  memset( delta_test_flash[0], 0xFF, DELTA_TEST_APP_SIZE );
+  memset( delta_test_flash[1], 0xFF, DELTA_TEST_OTA_SIZE );
+  memcpy( delta_test_flash[0], old, old_length );
+  memcpy( delta_test_flash[1], patch, length );
+  delta_test_image_offset = ( length + BLOCK_SIZE - 1 ) / BLOCK_SIZE * BLOCK_SIZE + BLOCK_SIZE;
+}
+
+static OSStatus delta_test_apply( uint32_t length, uint32_t *image_offset )
+{
+  ota_delta_header_t header;
+
+  memcpy( &header, delta_test_flash[1], sizeof(header) );
+  memset( delta_test_read, 0x0, sizeof(delta_test_read) );
+  memset( delta_test_written, 0x0, sizeof(delta_test_written) );
+  memset( delta_test_erased, 0x0, sizeof(delta_test_erased) );
+  delta_test_ops = 0;
+  return ota_delta_apply( &header, length, MICO_PARTITION_APPLICATION, image_offset, delta_test_work );
+}
+
+static bool delta_test_built( const uint8_t *new, uint32_t new_length, uint32_t image_offset )
+{
+  return image_offset == delta_test_image_offset &&
+         memcmp( &delta_test_flash[1][image_offset], new, new_length ) == 0;
+}
+
+static int delta_test_check( bool ok, const char *what, int print )
+{
+  if( !ok && print ) printf( "ota_delta_test: %s\r\n", what );
+  return ok ? 0 : 1;
+}
+
+/* Boots until the patch is applied, the power cut at one of the first max_cut
+   writes and erases of all boots but one in uncut. Returns the boots it took,
+   0 on error */
+static int delta_test_boots( const uint8_t *new, uint32_t new_length, uint32_t length, long max_cut, uint32_t uncut, int print )
+{
+  uint32_t image_offset = 0;
+  volatile int boots = 0;
+  OSStatus err;
+
+  delta_test_image_written = 0;
+  for( ;; ) {
+    boots++;
+    delta_test_cut = delta_test_rand( uncut ) ? 1 + delta_test_rand( max_cut ) : -1;
+    if( setjmp( delta_test_power_cut ) ) continue;
+    err = delta_test_apply( length, &image_offset );
+    delta_test_cut = -1;
+    if( err != kNoErr || !delta_test_built( new, new_length, image_offset ) ) {
+      if( print ) printf( "ota_delta_test: error %d after %d boots\r\n", err, boots );
+      return 0;
+    }
+    return boots;
+  }
+}
+
+static uint32_t delta_test_file( const char *name, uint8_t *buf, uint32_t size )
+{
+  FILE *f = fopen( name, "rb" );
+  uint32_t length;
+
+  if( f == NULL ) return 0;
+  length = fread( buf, 1, size, f );
+  fclose( f );
+  return length;
+}
+
+/* The patch ota_delta.py made from one RF driver in the tree to the next:
+   applied straight through, then with power cuts */
+static int delta_test_files( int print )
+{
+  static uint8_t old[DELTA_TEST_APP_SIZE], new[DELTA_TEST_APP_SIZE], patch[DELTA_TEST_PATCH_SIZE];
+  uint32_t old_length, new_length, length, image_offset;
+  unsigned long total, boots = 0;
+  int bad_count = 0, n, r;
+  OSStatus err;
+
+  old_length = delta_test_file( DELTA_TEST_FILE_OLD, old, sizeof(old) );
+  new_length = delta_test_file( DELTA_TEST_FILE_NEW, new, sizeof(new) );
+  length = delta_test_file( DELTA_TEST_FILE_PATCH, patch, sizeof(patch) );
+  if( old_length == 0 || new_length == 0 || length == 0 )
+    return delta_test_check( false, "RF drivers or ota_delta_test.otd not found, run from the repository root", print );
+
+  delta_test_setup( old, old_length, patch, length );
+  err = delta_test_apply( length, &image_offset );
+  total = delta_test_ops;
+  bad_count += delta_test_check( err == kNoErr && delta_test_built( new, new_length, image_offset ), "ota_delta.py patch not applied", print );
+  if( print )
+    printf( "ota_delta.py patch of %lu bytes from %lu to %lu bytes: read %lu bytes of the old image and %lu of OTA, %lu writes and erases\r\n",
+            (unsigned long)length, (unsigned long)old_length, (unsigned long)new_length, delta_test_read[0], delta_test_read[1], total );
+
+  for( r = 0; r < DELTA_TEST_FILE_RUNS && !bad_count; r++ ) {
+    delta_test_setup( old, old_length, patch, length );
+    n = delta_test_boots( new, new_length, length, total + 10, 3, print );
+    bad_count += delta_test_check( n > 0, "ota_delta.py patch power cut run failed", print );
+    boots += n;
+  }
+  if( print ) printf( "%d power cut runs of the ota_delta.py patch, %lu boots\r\n", r, boots );
+  return bad_count;
+}
+
+OSStatus ota_delta_test( int print )
+{
+  static uint8_t old[DELTA_TEST_OLD_LENGTH], new[DELTA_TEST_APP_SIZE], other[DELTA_TEST_APP_SIZE];
+  static uint8_t patch[DELTA_TEST_PATCH_SIZE], bad[DELTA_TEST_PATCH_SIZE];
+  uint32_t new_length, other_length, length, other_patch_length, image_offset, offset, i;
+  unsigned long total, boots = 0, max_boots = 0, refused = 0, waste, max_waste = 0;
+  uint16_t block_size;
+  OSStatus err;
+  int bad_count = 0, n, r;
+
+  delta_test_flash[0] = malloc( DELTA_TEST_APP_SIZE );
+  delta_test_flash[1] = malloc( DELTA_TEST_OTA_SIZE );
+  delta_test_old_image( old, DELTA_TEST_OLD_LENGTH );
+  new_length = delta_test_new_image( old, new, 1 );
+  length = delta_test_patch( old, new, new_length, BLOCK_SIZE, patch );
+
+  /* Straight through, then again once built, when only the checkpoints are read */
+  delta_test_setup( old, DELTA_TEST_OLD_LENGTH, patch, length );
+  err = delta_test_apply( length, &image_offset );
+  total = delta_test_ops;
+  bad_count += delta_test_check( err == kNoErr && delta_test_built( new, new_length, image_offset ), "patch not applied", print );
+  if( print )
+    printf( "Patch of %lu bytes to a %lu byte image: read %lu bytes of the old image and %lu of OTA, %lu writes and erases\r\n",
+            (unsigned long)length, (unsigned long)new_length, delta_test_read[0], delta_test_read[1], total );
+  err = delta_test_apply( length, &image_offset );
+  bad_count += delta_test_check( err == kNoErr && delta_test_built( new, new_length, image_offset ) &&
+                                 delta_test_read[0] == 0 && delta_test_ops == 0, "built image not kept", print );
+
+  /* The old image may be gone once the new one is built */
+  memset( delta_test_flash[0], 0xFF, DELTA_TEST_APP_SIZE );
+  err = delta_test_apply( length, &image_offset );
+  bad_count += delta_test_check( err == kNoErr && delta_test_built( new, new_length, image_offset ), "built image lost with the old one", print );
+
+  /* Against another image: refused before anything is written */
+  delta_test_setup( new, DELTA_TEST_OLD_LENGTH, patch, length );
+  err = delta_test_apply( length, &image_offset );
+  bad_count += delta_test_check( err == kChecksumErr && delta_test_ops == 0, "wrong old image not refused", print );
+
+  /* Smaller blocks of operations, which an operation spans */
+  for( block_size = 1000; block_size <= 3000; block_size += 2000 ) {
+    i = delta_test_patch( old, new, new_length, block_size, bad );
+    delta_test_setup( old, DELTA_TEST_OLD_LENGTH, bad, i );
+    err = delta_test_apply( i, &image_offset );
+    bad_count += delta_test_check( err == kNoErr && delta_test_built( new, new_length, image_offset ), "small blocks not applied", print );
+  }
+
+  /* Corrupt patches: refused, or still giving the new image, the old one untouched */
+  for( r = 0; r < DELTA_TEST_FUZZ && !bad_count; r++ ) {
+    memcpy( bad, patch, length );
+    offset = ( r % 4 ) ? sizeof(ota_delta_header_t) : 0;
+    for( n = 1 + delta_test_rand( 3 ); n; n-- )
+      bad[offset + delta_test_rand( length - offset )] ^= 1 << delta_test_rand( 8 );
+    delta_test_setup( old, DELTA_TEST_OLD_LENGTH, bad, length );
+    err = delta_test_apply( length, &image_offset );
+    bad_count += delta_test_check( ( err != kNoErr || delta_test_built( new, new_length, image_offset ) ) &&
+                                   memcmp( delta_test_flash[0], old, DELTA_TEST_OLD_LENGTH ) == 0, "corrupt patch applied", print );
+    refused += ( err != kNoErr );
+  }
+  if( print ) printf( "%d corrupt patches, %lu refused, the others gave the new image\r\n", r, refused );
+
+  /* Power cuts: each boot goes on from the last checkpoint, so a cut costs
+     at most the block it was writing and the one before its checkpoint */
+  for( r = 0; r < DELTA_TEST_RUNS && !bad_count; r++ ) {
+    delta_test_setup( old, DELTA_TEST_OLD_LENGTH, patch, length );
+    n = delta_test_boots( new, new_length, length, total + 10, 3, print );
+    bad_count += delta_test_check( n > 0, "power cut run failed", print );
+    waste = delta_test_image_written - new_length;
+    if( waste > max_waste ) max_waste = waste;
+    bad_count += delta_test_check( waste <= ( n - 1 ) * 2 * BLOCK_SIZE, "not resumed from the checkpoint", print );
+    boots += n;
+    if( (unsigned long)n > max_boots ) max_boots = n;
+  }
+  if( print )
+    printf( "%d power cut runs, %.1f boots each, at most %lu; at most %lu bytes written again\r\n",
+            r, r ? (double)boots / r : 0.0, max_boots, max_waste );
+
+  /* A cut at one of the first few writes and erases of nearly every boot:
+     more checkpoints than the sector holds, which is erased to go on */
+  delta_test_setup( old, DELTA_TEST_OLD_LENGTH, patch, length );
+  delta_test_checkpoint_erases = 0;
+  n = delta_test_boots( new, new_length, length, 8, 1000, print );
+  bad_count += delta_test_check( n > 0 && delta_test_checkpoint_erases > 0, "checkpoint sector not filled", print );
+  if( print ) printf( "Cut early at every boot: %d boots, checkpoint sector erased %lu times\r\n", n, delta_test_checkpoint_erases );
+
+  /* Checkpoints of another patch, left in the same sector, are not taken */
+  other_length = delta_test_new_image( old, other, 2 );
+  i = delta_test_patch( old, other, other_length, BLOCK_SIZE, bad );
+  other_patch_length = ( i > length ) ? i : length;
+  bad_count += delta_test_check( ( other_patch_length + BLOCK_SIZE - 1 ) / BLOCK_SIZE == ( length + BLOCK_SIZE - 1 ) / BLOCK_SIZE,
+                                 "patches end in different sectors", print );
+  delta_test_setup( old, DELTA_TEST_OLD_LENGTH, patch, length );
+  err = delta_test_apply( other_patch_length, &image_offset );
+  bad_count += delta_test_check( err == kNoErr && delta_test_built( new, new_length, image_offset ), "first patch not applied", print );
+  MicoFlashErase( MICO_PARTITION_OTA_TEMP, 0x0, length );
+  offset = 0;
+  MicoFlashWrite( MICO_PARTITION_OTA_TEMP, &offset, bad, i );
+  err = delta_test_apply( other_patch_length, &image_offset );
+  bad_count += delta_test_check( err == kNoErr && delta_test_built( other, other_length, image_offset ), "checkpoint of another patch taken", print );
+  bad_count += delta_test_files( print );
+  bad_count += delta_test_check( delta_test_reprogrammed == 0, "programmed a byte that was not erased", print );
+
+  free( delta_test_flash[0] );
+  free( delta_test_flash[1] );
+  if( print ) printf( "ota_delta_test: %s\r\n", bad_count ? "FAILED" : "PASSED" );
+  return bad_count ? kGeneralErr : kNoErr;
+}
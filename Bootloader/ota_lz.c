@@ -0,0 +1,85 @@
+/**
+******************************************************************************
+* @file    ota_lz.c
+* @version V1.0.0
+* @date    17-Oct-2026
+* @brief   Expands the blocks of a compressed OTA image, see ota_lz.h for the
+*          format.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#include "ota_lz.h"
+
+/* Adds the bytes extending a length of 15 */
+static bool read_length( const uint8_t **in, const uint8_t *inEnd, uint32_t *length )
+{
+  uint8_t byte;
+
+  do {
+    if( *in >= inEnd ) return false;
+    byte = *(*in)++;
+    *length += byte;
+  } while( byte == 255 );
+  return true;
+}
+
+OSStatus ota_lz_expand( const uint8_t *in, uint32_t inLen, uint8_t *out, uint32_t outLen )
+{
+  const uint8_t *inEnd = in + inLen;
+  const uint8_t *match;
+  uint8_t *op = out;
+  uint8_t *outEnd = out + outLen;
+  uint32_t length, distance;
+  uint8_t token;
+
+  while( in < inEnd ) {
+    token = *in++;
+
+    length = token >> 4;
+    if( length == 15 && !read_length( &in, inEnd, &length ) ) return kMalformedErr;
+    if( length > (uint32_t)( inEnd - in ) || length > (uint32_t)( outEnd - op ) ) return kMalformedErr;
+    memcpy( op, in, length );
+    op += length;
+    in += length;
+
+    /* Only the last sequence of a block ends after its literals */
+    if( in == inEnd ) break;
+
+    if( inEnd - in < 2 ) return kMalformedErr;
+    distance = in[0] | ( (uint32_t)in[1] << 8 );
+    in += 2;
+    if( distance == 0 || distance > (uint32_t)( op - out ) ) return kMalformedErr;
+
+    length = token & 0x0F;
+    if( length == 15 && !read_length( &in, inEnd, &length ) ) return kMalformedErr;
+    length += OTA_LZ_MIN_MATCH;
+    if( length > (uint32_t)( outEnd - op ) ) return kMalformedErr;
+
+    /* Byte by byte, a match may overlap the bytes it produces */
+    match = op - distance;
+    while( length-- ) *op++ = *match++;
+  }
+
+  return ( op == outEnd ) ? kNoErr : kMalformedErr;
+}
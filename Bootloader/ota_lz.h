@@ -0,0 +1,79 @@
+/**
+******************************************************************************
+* @file    ota_lz.h
+* @version V1.0.0
+* @date    17-Oct-2026
+* @brief   Compressed OTA image container, written by ota_compress.py and
+*          expanded by the bootloader while it copies the image.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#ifndef __OTA_LZ_H__
+#define __OTA_LZ_H__
+
+#include "Common.h"
+
+/*
+ * The image is cut into blocks of block_size bytes, the last one shorter,
+ * each compressed on its own so that it is expanded with one input and one
+ * output buffer of block_size bytes. A block is a 16 bit little endian size,
+ * bit 15 set if the data is stored as is, followed by that many bytes.
+ *
+ * Compressed blocks are LZ4 sequences: a token, its high nibble the number of
+ * literals and its low nibble the match length less 4, either being followed
+ * by bytes of 255 and one below when 15; the literals; then, except for the
+ * last sequence of the block, the 16 bit little endian distance back to the
+ * match in the block.
+ */
+
+#define OTA_LZ_MAGIC            ( 0x315A544F )  /* "OTZ1" */
+#define OTA_LZ_BLOCK_STORED     ( 0x8000 )
+#define OTA_LZ_BLOCK_SIZE_MASK  ( 0x7FFF )
+#define OTA_LZ_MIN_MATCH        ( 4 )
+
+typedef struct _ota_lz_header_t {
+  uint32_t magic;       // OTA_LZ_MAGIC
+  uint32_t length;      // Length of the image once expanded
+  uint16_t block_size;  // Expanded bytes per block
+  uint16_t crc;         // CRC16 of the expanded image
+  uint32_t reserved;
+} ota_lz_header_t;
+
+/**
+ * @brief  Expands one compressed block.
+ *
+ * @param  in: The compressed block, without its size.
+ * @param  inLen: Its size.
+ * @param  out: Buffer for the expanded data.
+ * @param  outLen: Bytes the block expands to, at most block_size.
+ *
+ * @return kNoErr, or kMalformedErr if the block does not expand to exactly
+ *         outLen bytes.
+ */
+OSStatus ota_lz_expand( const uint8_t *in, uint32_t inLen, uint8_t *out, uint32_t outLen );
+
+/* Host test of ota_lz_expand() on an image made by ota_compress.py, see ota_lz_test.c */
+OSStatus ota_lz_test( int print );
+
+#endif
@@ -0,0 +1,176 @@
+/**
+******************************************************************************
+* @file    ota_lz_test.c
+* @version V1.0.0
+* @date    17-Oct-2026
+* @brief   Host test of ota_lz_expand() on an image made by ota_compress.py.
+*          ota_lz_test.ota is the first 40000 bytes of
+*          MICO/core/RF driver/BCM43362-5.90.230.12.bin, made with
+*            head -c 40000 BCM43362-5.90.230.12.bin > prefix.bin
+*            ota_compress.py prefix.bin Bootloader/ota_lz_test.ota
+*          and holds compressed blocks, a stored one and a short last one.
+*          Each block must expand to the bytes of the image, the whole to
+*          the CRC in the header, and a block cut short or given the wrong
+*          length must be refused. Then reports the compression and how fast
+*          the image expands. Built on the host on its own, with ota_lz.c and
+*          CheckSumUtils.c, and run from the repository root, or with
+*          OTA_TEST_ROOT set to it. Not part of the default build.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ota_lz.h"
+#include "CheckSumUtils.h"
+
+#ifndef OTA_TEST_ROOT
+#define OTA_TEST_ROOT           "."
+#endif
+
+#define LZ_TEST_PACKED          OTA_TEST_ROOT "/Bootloader/ota_lz_test.ota"
+#define LZ_TEST_IMAGE           OTA_TEST_ROOT "/MICO/core/RF driver/BCM43362-5.90.230.12.bin"
+#define LZ_TEST_MAX             ( 0x40000 )
+#define LZ_TEST_BLOCK_MAX       ( 4096 )    /* SizePerRW in Update_for_OTA.c */
+#define LZ_TEST_SECONDS         ( 1 )       /* Time spent expanding for the rate */
+
+static uint8_t lz_test_packed[LZ_TEST_MAX], lz_test_image[LZ_TEST_MAX], lz_test_out[LZ_TEST_MAX];
+static uint8_t lz_test_scratch[LZ_TEST_BLOCK_MAX + 1];
+
+static uint32_t lz_test_load( const char *name, uint8_t *buf )
+{
+  FILE *f = fopen( name, "rb" );
+  size_t length;
+
+  if( f == NULL ) return 0;
+  length = fread( buf, 1, LZ_TEST_MAX, f );
+  fclose( f );
+  return length;
+}
+
+static int lz_test_check( bool ok, const char *what, int print )
+{
+  if( !ok && print ) printf( "ota_lz_test: %s\r\n", what );
+  return ok ? 0 : 1;
+}
+
+/* Expands the whole image into lz_test_out, checking each block as it goes
+   when check is set. Counts the blocks of either kind */
+static OSStatus lz_test_expand( const ota_lz_header_t *header, uint32_t length, bool check,
+                                int *compressed, int *stored, int print )
+{
+  uint32_t offset = sizeof(ota_lz_header_t), out = 0, expand, size;
+  uint16_t block;
+  OSStatus err;
+
+  *compressed = *stored = 0;
+  while( out < header->length ) {
+    expand = ( header->length - out < header->block_size ) ? header->length - out : header->block_size;
+    if( offset + 2 > length ) return kMalformedErr;
+    block = lz_test_packed[offset] | ( lz_test_packed[offset + 1] << 8 );
+    offset += 2;
+    size = block & OTA_LZ_BLOCK_SIZE_MASK;
+    if( offset + size > length ) return kMalformedErr;
+
+    if( block & OTA_LZ_BLOCK_STORED ) {
+      if( size != expand ) return kMalformedErr;
+      memcpy( &lz_test_out[out], &lz_test_packed[offset], size );
+      ( *stored )++;
+    } else {
+      err = ota_lz_expand( &lz_test_packed[offset], size, &lz_test_out[out], expand );
+      if( err != kNoErr ) return err;
+      ( *compressed )++;
+
+      /* Cut short or expanded to another length, the block is refused */
+      if( check && ( ota_lz_expand( &lz_test_packed[offset], size - 1, lz_test_scratch, expand ) == kNoErr ||
+                     ota_lz_expand( &lz_test_packed[offset], size, lz_test_scratch, expand + 1 ) == kNoErr ||
+                     ota_lz_expand( &lz_test_packed[offset], size, lz_test_scratch, expand - 1 ) == kNoErr ) ) {
+        if( print ) printf( "ota_lz_test: block at %lu not refused when cut\r\n", (unsigned long)out );
+        return kGeneralErr;
+      }
+    }
+    if( check && memcmp( &lz_test_out[out], &lz_test_image[out], expand ) != 0 ) {
+      if( print ) printf( "ota_lz_test: block at %lu expands wrong\r\n", (unsigned long)out );
+      return kGeneralErr;
+    }
+    offset += size;
+    out += expand;
+  }
+  return ( offset == length ) ? kNoErr : kMalformedErr;
+}
+
+OSStatus ota_lz_test( int print )
+{
+  ota_lz_header_t header;
+  CRC16_Context contex;
+  uint32_t length, image_length;
+  unsigned long runs = 0;
+  clock_t start, elapsed;
+  int compressed, stored, bad = 0;
+  uint16_t crc;
+  OSStatus err;
+
+  length = lz_test_load( LZ_TEST_PACKED, lz_test_packed );
+  image_length = lz_test_load( LZ_TEST_IMAGE, lz_test_image );
+  if( length < sizeof(header) || image_length == 0 ) {
+    if( print ) printf( "ota_lz_test: %s or %s not found, run from the repository root\r\nota_lz_test: FAILED\r\n",
+                        LZ_TEST_PACKED, LZ_TEST_IMAGE );
+    return kNotFoundErr;
+  }
+  memcpy( &header, lz_test_packed, sizeof(header) );
+  bad += lz_test_check( header.magic == OTA_LZ_MAGIC && header.length <= image_length && header.length <= LZ_TEST_MAX &&
+                        header.block_size > 0 && header.block_size <= LZ_TEST_BLOCK_MAX, "bad header", print );
+  if( bad ) goto exit;
+
+  /* The image made by ota_compress.py expands block by block to the original */
+  err = lz_test_expand( &header, length, true, &compressed, &stored, print );
+  bad += lz_test_check( err == kNoErr, "image not expanded", print );
+  CRC16_Init( &contex );
+  CRC16_Update( &contex, lz_test_out, header.length );
+  CRC16_Final( &contex, &crc );
+  bad += lz_test_check( crc == header.crc, "CRC of the expanded image differs", print );
+  bad += lz_test_check( compressed > 0 && stored > 0 && header.length % header.block_size != 0,
+                        "fixture lacks a compressed, stored or short block", print );
+  if( print )
+    printf( "%lu bytes of %s in %lu bytes (%.1f%%): %d blocks compressed, %d stored\r\n",
+            (unsigned long)header.length, strrchr( LZ_TEST_IMAGE, '/' ) + 1, (unsigned long)length,
+            100.0 * length / header.length, compressed, stored );
+
+  /* The rate, expanding the whole image again and again */
+  start = clock( );
+  do {
+    err = lz_test_expand( &header, length, false, &compressed, &stored, print );
+    runs++;
+    elapsed = clock( ) - start;
+  } while( err == kNoErr && elapsed < LZ_TEST_SECONDS * CLOCKS_PER_SEC );
+  bad += lz_test_check( err == kNoErr, "image not expanded again", print );
+  if( print && elapsed > 0 )
+    printf( "Expanded %lu times, %.1f MB/s out\r\n", runs, (double)runs * header.length * CLOCKS_PER_SEC / elapsed / 1e6 );
+
+exit:
+  if( print ) printf( "ota_lz_test: %s\r\n", bad ? "FAILED" : "PASSED" );
+  return bad ? kGeneralErr : kNoErr;
+}
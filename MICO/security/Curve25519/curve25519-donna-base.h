@@ -0,0 +1,358 @@
+/*
+	File:    curve25519-donna-base.h
+	
+	Precomputed table for the fixed-base path of curve25519-donna.c, included only from there.
+	
+	The table is a signed comb on edwards25519 (the Edwards form of Curve25519, base point y = 4/5, which maps to
+	u = 9) with CURVE25519_COMB_COMBS combs of CURVE25519_COMB_TEETH teeth spaced CURVE25519_COMB_SPACING bits
+	apart. Entry v of comb j holds, for B the base point, t = CURVE25519_COMB_TEETH and s = CURVE25519_COMB_SPACING:
+	
+		2^(s*(t-1+t*j)) * B  +  sum over k < t-1 of  (bit k of v ? +1 : -1) * 2^(s*(k+t*j)) * B
+	
+	as ( y+x, y-x, 2*d*x*y ) in affine coordinates, each field element in the 26/25 bit limb form used by the
+	field code. kCurve25519BaseNeg is -B in the same form.
+*/
+
+#define	CURVE25519_COMB_COMBS		4
+#define	CURVE25519_COMB_TEETH		5
+#define	CURVE25519_COMB_SPACING		13
+#define	CURVE25519_COMB_ENTRIES		( 1 << ( CURVE25519_COMB_TEETH - 1 ) )
+
+static const s32		kCurve25519BaseComb[ CURVE25519_COMB_COMBS ][ CURVE25519_COMB_ENTRIES ][ 3 ][ 10 ] =
+{
+	{
+		{
+			{ 0x1f2ae99, 0x0191ff3, 0x2950159, 0x1d37372, 0x2821227, 0x0f5938e, 0x28d5243, 0x018d418, 0x1f22fcb, 0x0a03ea1 },
+			{ 0x1d9f931, 0x019f7a4, 0x1bdb79e, 0x1df9148, 0x31e79cc, 0x03db1b0, 0x02eda16, 0x18f02d0, 0x3cb6157, 0x046782f },
+			{ 0x0f4e03c, 0x166e586, 0x2232402, 0x0860516, 0x309fd15, 0x0eb74cb, 0x04b44e7, 0x09d6670, 0x28c31cd, 0x1073b10 }
+		},
+		{
+			{ 0x0e709f7, 0x120e385, 0x2737412, 0x073a964, 0x2dea182, 0x0b02b17, 0x011aae4, 0x1c0b6e0, 0x3060b58, 0x11674a5 },
+			{ 0x2a19e82, 0x1e31e70, 0x09f181c, 0x17a1711, 0x178b878, 0x13bc83d, 0x1c4f4c3, 0x159d6ea, 0x11b8e28, 0x007b66f },
+			{ 0x276655a, 0x071fa76, 0x3a1d321, 0x1ee4082, 0x3c5b592, 0x041d3b3, 0x2cf99ef, 0x0c021aa, 0x1ba0335, 0x1e50913 }
+		},
+		{
+			{ 0x3f59f92, 0x04c01e8, 0x3f5deaa, 0x081bcad, 0x2222967, 0x0e4f249, 0x05d9074, 0x066f1b6, 0x15cb9fb, 0x192ba8d },
+			{ 0x2550d9a, 0x19cd65c, 0x169f8da, 0x007ba02, 0x2338814, 0x014a064, 0x1586121, 0x058801a, 0x2a2fde1, 0x1f53a2d },
+			{ 0x3b3ce24, 0x02b16a4, 0x04cef31, 0x0c5b7ed, 0x3429ebb, 0x19d1186, 0x3c5d166, 0x0103b82, 0x246ac93, 0x1ce1823 }
+		},
+		{
+			{ 0x1341491, 0x14a6a7b, 0x0c3b4bc, 0x10cbcea, 0x3b9a8ad, 0x036a51e, 0x30a3c64, 0x1fbe17e, 0x0d41abf, 0x07a8749 },
+			{ 0x188f4cb, 0x0116894, 0x0bc23ef, 0x13c797a, 0x330686c, 0x1f86e9e, 0x0f87479, 0x162cd9f, 0x27cf928, 0x09b5257 },
+			{ 0x1cec358, 0x104b780, 0x0da223f, 0x16ee140, 0x148b418, 0x07ff562, 0x3e0ea0b, 0x0d1d1a6, 0x379505f, 0x0de3469 }
+		},
+		{
+			{ 0x08c15d0, 0x12cc3a2, 0x2a575aa, 0x1a5c5a3, 0x2655a8b, 0x04faa50, 0x042d30a, 0x16d1049, 0x3f1d782, 0x07a87fb },
+			{ 0x11cd34c, 0x04889ab, 0x0635413, 0x0341fbb, 0x3eb7d86, 0x1854f48, 0x011a9fd, 0x1e9e07c, 0x3cb4fbd, 0x03c57cf },
+			{ 0x0ed4962, 0x18026af, 0x3088add, 0x13b186a, 0x2014e17, 0x0eef99f, 0x287dd0b, 0x1440c90, 0x0e36ef4, 0x15fa066 }
+		},
+		{
+			{ 0x3892aae, 0x1533af9, 0x0a48546, 0x13c6b9b, 0x3e9dfe7, 0x144d5f2, 0x3cb6b28, 0x10a3496, 0x3a030cc, 0x0557b91 },
+			{ 0x3ace6a6, 0x03f1320, 0x2aeeffd, 0x0d5d7b3, 0x1bf414d, 0x0f354a9, 0x2212432, 0x028c91d, 0x2d28b51, 0x03de117 },
+			{ 0x283ccd1, 0x1dde8e5, 0x39adc1a, 0x0699b00, 0x161f1c1, 0x151c94d, 0x1382280, 0x05588de, 0x0c37ac2, 0x003d486 }
+		},
+		{
+			{ 0x3dc9686, 0x16fd14f, 0x2846b84, 0x115df91, 0x3de4af8, 0x053b6f1, 0x01ae929, 0x0ff9b44, 0x1b90cfe, 0x1a2ce61 },
+			{ 0x19a1f96, 0x03cdaa5, 0x114d0c0, 0x09e7d98, 0x2afac66, 0x1f9a8ff, 0x0049fa8, 0x0407171, 0x0ba73f6, 0x1271752 },
+			{ 0x1a2d532, 0x0173889, 0x158633b, 0x03ef98f, 0x06ce98a, 0x153acea, 0x233d277, 0x009b7ca, 0x0f0cb08, 0x109f2f6 }
+		},
+		{
+			{ 0x2066394, 0x1cd9f70, 0x1ccb7e7, 0x0dbe27a, 0x0711a17, 0x0356551, 0x3267158, 0x085f999, 0x3856f46, 0x0b506fd },
+			{ 0x2e9bb6d, 0x0a62cf7, 0x029c17e, 0x1a6f5b1, 0x34f283a, 0x1f0a88a, 0x1808aa7, 0x18bb8ec, 0x2b421d3, 0x0d19a86 },
+			{ 0x0824f4f, 0x07111f1, 0x3dd81c6, 0x0a34d26, 0x30e51d9, 0x1879a8d, 0x0a4cf7e, 0x1df6440, 0x1b017ad, 0x0c6dfaf }
+		},
+		{
+			{ 0x17b7fa6, 0x0e08cfb, 0x052b481, 0x1b827d0, 0x2c5c89b, 0x169f7e5, 0x0a41e89, 0x1277d52, 0x046ba40, 0x155250e },
+			{ 0x3712e06, 0x1436e63, 0x383e927, 0x119e8a2, 0x1e8a12e, 0x100df38, 0x2f2a597, 0x17eb89e, 0x1ad3fc2, 0x1b9e65a },
+			{ 0x2e1f05a, 0x0bf1824, 0x25610a2, 0x0bf35ef, 0x32e60fd, 0x0cbc921, 0x0fbd3ab, 0x0b42b91, 0x1fd8c20, 0x0de48ae }
+		},
+		{
+			{ 0x2f14186, 0x0ab6919, 0x3f183e7, 0x128bf20, 0x019274a, 0x0d6ba3e, 0x17b114b, 0x1120471, 0x3d12054, 0x1c190dd },
+			{ 0x0753972, 0x134fbc7, 0x0c396e0, 0x16842e8, 0x06475b5, 0x0cd8405, 0x16e4e6c, 0x1e4eae8, 0x1d5bcf1, 0x1cd764d },
+			{ 0x33a1bb2, 0x1698b4f, 0x11b8c3c, 0x072f926, 0x341aef0, 0x1cf1f7a, 0x039a3f5, 0x0a24017, 0x2d9ddcd, 0x1a78f75 }
+		},
+		{
+			{ 0x0f8cfad, 0x10cc8d3, 0x3c61bb1, 0x17adcdc, 0x3b29f4c, 0x0e9f4d9, 0x22cfd51, 0x1da4c9f, 0x307c821, 0x010ce52 },
+			{ 0x16d10ab, 0x07554f1, 0x206c6cf, 0x0b4797c, 0x27e9de5, 0x1d9738b, 0x1394018, 0x0759b19, 0x01329dc, 0x1b4f62e },
+			{ 0x17596c1, 0x16d784b, 0x394021c, 0x04ee672, 0x28c2d90, 0x03d9ae0, 0x162983d, 0x1db628d, 0x25897a8, 0x144b6db }
+		},
+		{
+			{ 0x2aa25d5, 0x1720cd4, 0x0ddffa2, 0x17f37b4, 0x1218d1c, 0x00b18ee, 0x3018552, 0x17064fc, 0x12bdece, 0x0d44b37 },
+			{ 0x3cc8a98, 0x0a9f27e, 0x2e22110, 0x17e0bb7, 0x260f1d7, 0x0d1f725, 0x2174208, 0x0b301f5, 0x3acf5d2, 0x1ab9d82 },
+			{ 0x03f9cee, 0x00ae5e1, 0x07ee816, 0x0256204, 0x2e39509, 0x1ecc2f6, 0x2ec8e6b, 0x0d4f060, 0x22ad52b, 0x11056d7 }
+		},
+		{
+			{ 0x3afa92d, 0x0e6283a, 0x0a5baf7, 0x1b43684, 0x24b0d32, 0x1017e6a, 0x2c58001, 0x0c1f3a4, 0x2d33362, 0x1ded86c },
+			{ 0x1265c18, 0x1090895, 0x0cd0e35, 0x14aa5ef, 0x2f37fed, 0x0093f14, 0x225db3f, 0x09e95bf, 0x2c4a6f9, 0x019d6a5 },
+			{ 0x3bb2377, 0x08697c0, 0x068bf13, 0x0935620, 0x163769d, 0x0684b58, 0x1ffc387, 0x09c3a0a, 0x3d004e0, 0x0a84b08 }
+		},
+		{
+			{ 0x0d304d5, 0x05040b7, 0x1d403da, 0x1df988a, 0x23cdc67, 0x1e72be2, 0x1c1ae67, 0x02f5170, 0x1743f6d, 0x0ed0e35 },
+			{ 0x1150397, 0x13b272b, 0x21a6244, 0x06a23ae, 0x3adb294, 0x07c6ca7, 0x3a0b45b, 0x198c3cb, 0x0305c00, 0x0de6ede },
+			{ 0x2b13c99, 0x19a43a4, 0x2b55ac2, 0x191ceac, 0x038a771, 0x181d894, 0x1ff5b31, 0x16ab2d7, 0x3b1fabc, 0x03a9f97 }
+		},
+		{
+			{ 0x21c0af4, 0x1564483, 0x0bfca37, 0x0849a22, 0x11dd15f, 0x102482b, 0x3188961, 0x1f022ad, 0x05ed009, 0x1fcfd9c },
+			{ 0x0b1f65f, 0x0d4c366, 0x2622132, 0x16e5ca8, 0x1e4130a, 0x08b729e, 0x1d344f0, 0x15ed8d7, 0x0c3073b, 0x1f7954f },
+			{ 0x027339d, 0x08ad058, 0x39d344d, 0x07d8bcf, 0x29b4cf9, 0x0c2362f, 0x0203105, 0x15d0e54, 0x3a3d6b0, 0x1b44f9e }
+		},
+		{
+			{ 0x1b7f4d1, 0x03c2381, 0x28a2763, 0x1a2e256, 0x224b384, 0x08ff55a, 0x227cb64, 0x1606372, 0x29999b3, 0x0557a3c },
+			{ 0x1d30c7d, 0x005eeac, 0x23ee49d, 0x0ac394e, 0x2910baf, 0x160fb37, 0x1d79536, 0x15ea6a6, 0x2fd32b6, 0x0e23310 },
+			{ 0x102faab, 0x10c2e26, 0x2249504, 0x11f1320, 0x281e5c8, 0x1b4dd65, 0x1dac85d, 0x1763f81, 0x39c59d8, 0x0f369bc }
+		}
+	},
+	{
+		{
+			{ 0x0fb1aeb, 0x1eba2fe, 0x1e0d17f, 0x0323d3e, 0x3704c57, 0x077e455, 0x3734963, 0x0657181, 0x27c308e, 0x1e3d8ee },
+			{ 0x38d6096, 0x186bdf1, 0x120d266, 0x03ef139, 0x3b659b5, 0x18a47e7, 0x17ca1bf, 0x0a5f01c, 0x18f6b00, 0x07e0b51 },
+			{ 0x39fa4a9, 0x032ea5e, 0x0c65dfe, 0x1e196e4, 0x3c2327b, 0x180a6cf, 0x0169add, 0x1030ef0, 0x1f85af9, 0x0ead918 }
+		},
+		{
+			{ 0x0ac19ae, 0x188cecf, 0x05622cf, 0x0979e11, 0x06172f4, 0x0d03265, 0x2fccd97, 0x0f786ae, 0x21d8a64, 0x102d195 },
+			{ 0x2995dc7, 0x09de814, 0x064c54b, 0x1711358, 0x0c59831, 0x1346ef6, 0x0254653, 0x0174c79, 0x18ca1d8, 0x1c6599b },
+			{ 0x059e5eb, 0x08f710f, 0x195ae8d, 0x1dce585, 0x12be3af, 0x1bf14e9, 0x3011337, 0x0cb4db5, 0x086123c, 0x0a7b73f }
+		},
+		{
+			{ 0x1ffa031, 0x17286bf, 0x2dbbc96, 0x1f29c63, 0x2c199b5, 0x0760bcf, 0x2816ed5, 0x1691519, 0x2091e4b, 0x03d3908 },
+			{ 0x297f032, 0x1767833, 0x1b9695a, 0x16653d7, 0x36167f9, 0x16f7b5b, 0x1ad7f9f, 0x0ce8224, 0x132bc0d, 0x1043444 },
+			{ 0x36f7da7, 0x081a222, 0x2258d92, 0x1b0ee5f, 0x1ddcc6b, 0x1b55dc6, 0x0e9f123, 0x0e22e86, 0x222379c, 0x0acdd5a }
+		},
+		{
+			{ 0x25e4a6d, 0x1a02268, 0x2c10b0a, 0x18d04d3, 0x237d759, 0x0db71dd, 0x231c22a, 0x0e1aee7, 0x0896c83, 0x0d33257 },
+			{ 0x1bb4851, 0x057a976, 0x1313380, 0x1bd78fb, 0x25171b9, 0x1f923cf, 0x16ef41f, 0x0572283, 0x263b747, 0x144f103 },
+			{ 0x0783884, 0x1a96e77, 0x3c1eb9e, 0x0c547a4, 0x364f96f, 0x16b3585, 0x1f68afe, 0x1266add, 0x2100586, 0x1b7d74b }
+		},
+		{
+			{ 0x27892d2, 0x00427e3, 0x216329d, 0x18469fc, 0x34c98bc, 0x1044bb3, 0x0c77d34, 0x18848e6, 0x06a3b32, 0x0713762 },
+			{ 0x1fac7ed, 0x13d92ea, 0x0be2431, 0x12a9e30, 0x2f42165, 0x03cb5d5, 0x2f3114e, 0x1f3cf1f, 0x1b76a18, 0x16c495c },
+			{ 0x1d79a9c, 0x189877d, 0x1eb0683, 0x0ea87b2, 0x3912ba7, 0x0d2c637, 0x235361f, 0x1c5dc3c, 0x026ac7e, 0x01e1c98 }
+		},
+		{
+			{ 0x08cb5fc, 0x1828a4e, 0x0f0935a, 0x1ead89c, 0x394fd9e, 0x08c138c, 0x22c29ca, 0x0cbe9c9, 0x2ed26eb, 0x15e4cae },
+			{ 0x099eb7f, 0x1debf42, 0x1b314dd, 0x1aa1568, 0x28152b1, 0x1a9763b, 0x25880ed, 0x10c75a0, 0x1315416, 0x0cb8a85 },
+			{ 0x17ea22d, 0x1410fc3, 0x283eb6e, 0x0635c7d, 0x182ed97, 0x1ed5236, 0x3062c64, 0x198b1c2, 0x353dee0, 0x0893964 }
+		},
+		{
+			{ 0x017534f, 0x07b86ba, 0x2d6fde3, 0x0cb57af, 0x115aea5, 0x1739d98, 0x1e10faf, 0x0409fb0, 0x3469aed, 0x189340f },
+			{ 0x10dbca9, 0x1587263, 0x3517281, 0x0d9142e, 0x0c958b2, 0x07c691f, 0x054488c, 0x1a99b41, 0x200ce95, 0x049c0e8 },
+			{ 0x03385e8, 0x04a4a66, 0x045988b, 0x187124c, 0x2a04132, 0x17d2567, 0x3567c37, 0x06d42f2, 0x1a2352f, 0x1506b2b }
+		},
+		{
+			{ 0x191a190, 0x0669c5d, 0x161b98a, 0x1cd2ca9, 0x10f0298, 0x0350ff6, 0x11ed5b0, 0x05a8892, 0x013c85a, 0x1f6fbe6 },
+			{ 0x2cdf2b1, 0x0cb9a3d, 0x28d481a, 0x145a3da, 0x2adf771, 0x024f467, 0x02734f9, 0x0f7e7c9, 0x166bbac, 0x1a90d25 },
+			{ 0x0a16071, 0x065d9b3, 0x2eb9dae, 0x1479cec, 0x2d6663e, 0x148c152, 0x2725fe6, 0x0b2cc13, 0x2f65ce5, 0x0ddee24 }
+		},
+		{
+			{ 0x07557b2, 0x0d1ba18, 0x1abd7fe, 0x0609f92, 0x2bfb44c, 0x05636f6, 0x206c537, 0x1a46dd2, 0x3aa54b6, 0x0d8bd76 },
+			{ 0x140bf92, 0x1ecff08, 0x21512b6, 0x0f08bd9, 0x0603eac, 0x1a232b7, 0x16002d5, 0x0bffc90, 0x35b97ed, 0x11f6571 },
+			{ 0x0eaa982, 0x0240c9f, 0x26bb292, 0x0506843, 0x0063cda, 0x0f87ef7, 0x03ad93b, 0x0d4d6f6, 0x12321df, 0x149177b }
+		},
+		{
+			{ 0x32cec0f, 0x0a4e980, 0x1f03d3f, 0x17a66ee, 0x332b5dd, 0x16beddc, 0x3a30713, 0x058c916, 0x346efae, 0x1a0ba3d },
+			{ 0x1aefef8, 0x14eacca, 0x21faf81, 0x0e61f24, 0x1f06d1b, 0x18e49a1, 0x27259a4, 0x163a29b, 0x1a332d6, 0x0c32443 },
+			{ 0x1a7d36f, 0x0c763e1, 0x3cbc118, 0x02e74f0, 0x18d7514, 0x0fd23e8, 0x302aba7, 0x135f8f4, 0x39222c3, 0x0091010 }
+		},
+		{
+			{ 0x00f91cc, 0x0f48fa9, 0x1c4b884, 0x1bb978e, 0x261e4cc, 0x1fc94da, 0x29cccd5, 0x1f7127c, 0x2523feb, 0x16e2067 },
+			{ 0x0ff9bc0, 0x1db33ed, 0x361714d, 0x1fc5815, 0x2f9b58b, 0x0c8d15a, 0x155d4db, 0x0adee2c, 0x3240486, 0x01f02d8 },
+			{ 0x3a330d4, 0x0dfc47f, 0x052bf76, 0x0810636, 0x13ad1cf, 0x053b9ec, 0x0fbd2a5, 0x059762b, 0x053e717, 0x18e1ced }
+		},
+		{
+			{ 0x35088df, 0x16d2746, 0x0ae5fe0, 0x1d78567, 0x1e38867, 0x0890c2b, 0x1369467, 0x05926e5, 0x255bf3f, 0x0a6c2c8 },
+			{ 0x2fa3c27, 0x1d3079e, 0x06907de, 0x1b631ab, 0x001c994, 0x0235962, 0x18abb3d, 0x0edf058, 0x13cbff0, 0x0b2913d },
+			{ 0x37e1fb6, 0x024dcf0, 0x2d354a8, 0x001a472, 0x291438d, 0x1a4c304, 0x106c98f, 0x04e0708, 0x1c9774a, 0x1a89415 }
+		},
+		{
+			{ 0x2f9ad8d, 0x1b1396a, 0x068778d, 0x00cf770, 0x202b20f, 0x17c3992, 0x1fab260, 0x199a937, 0x0a98e38, 0x187aba7 },
+			{ 0x041212e, 0x12d6abf, 0x3cd401b, 0x06811b0, 0x285bd54, 0x10d2df3, 0x2ebc376, 0x17b1c61, 0x3e9777a, 0x131b7e4 },
+			{ 0x014062d, 0x1630da9, 0x37d0a86, 0x00c8492, 0x31c9118, 0x1dec84a, 0x1cb9c1c, 0x112f0a1, 0x0b91300, 0x194f197 }
+		},
+		{
+			{ 0x13f4c6c, 0x073c85b, 0x2877f56, 0x16cc0de, 0x25e677e, 0x13f6d61, 0x3d4f365, 0x0564630, 0x1b4974c, 0x05e2bff },
+			{ 0x13c080e, 0x0e2a43a, 0x2407d7d, 0x17e0215, 0x15d2a54, 0x1535db2, 0x112988d, 0x0000ae4, 0x08a7ee1, 0x1255cb3 },
+			{ 0x28661ea, 0x02fd35e, 0x0d6cad5, 0x0022991, 0x2f62656, 0x03cc13e, 0x265ab5c, 0x102f7f7, 0x0d4afdb, 0x0517335 }
+		},
+		{
+			{ 0x322cdae, 0x0d95ba2, 0x2881223, 0x0fc60b4, 0x39f9951, 0x0099cba, 0x310f783, 0x1ebcc24, 0x141c500, 0x019669d },
+			{ 0x349d389, 0x1f06f51, 0x09b97ca, 0x0668309, 0x249e805, 0x07e090b, 0x046e1c3, 0x093e042, 0x00f21b6, 0x1ed3fb5 },
+			{ 0x168a77a, 0x0b90549, 0x23f5e2b, 0x0585556, 0x0820c06, 0x1b16ec8, 0x35909b0, 0x1453b6a, 0x3998610, 0x13c183e }
+		},
+		{
+			{ 0x1295d0e, 0x1c18a5e, 0x071095c, 0x073b97c, 0x01563af, 0x1f1b214, 0x3122afc, 0x090fdd5, 0x34df582, 0x12b873d },
+			{ 0x0aa3bc8, 0x03c260a, 0x2312fd5, 0x0016ed4, 0x00dc81a, 0x0917757, 0x2c759cd, 0x1ac0902, 0x337e1c8, 0x08e56f1 },
+			{ 0x2ea716e, 0x1683053, 0x2cf9a59, 0x0582cb2, 0x36b87d7, 0x04a4024, 0x0282f40, 0x1f0edd4, 0x21ec37e, 0x1bf255f }
+		}
+	},
+	{
+		{
+			{ 0x1ec29ff, 0x1d311a4, 0x0ffa5fb, 0x014647d, 0x37b1748, 0x0ac1508, 0x32ce305, 0x1dd59a7, 0x386b3b7, 0x150389b },
+			{ 0x07383b8, 0x088544b, 0x24531f9, 0x1245064, 0x2a123df, 0x0b240e1, 0x1aa110d, 0x1c425cd, 0x060a033, 0x0a85646 },
+			{ 0x3e00ebf, 0x0c55608, 0x3c47616, 0x040a501, 0x366a33e, 0x0bd9a0c, 0x2709bcb, 0x00e2648, 0x2165b1a, 0x11bf50b }
+		},
+		{
+			{ 0x1f88d50, 0x166d216, 0x1ee17db, 0x1c2410b, 0x2021526, 0x06b96ff, 0x3241121, 0x0d431b5, 0x29665d4, 0x0a76a26 },
+			{ 0x0668e61, 0x0461247, 0x2f1d586, 0x1cef211, 0x39f00d7, 0x06960c5, 0x2fdddea, 0x0f4b990, 0x1bb2290, 0x1586298 },
+			{ 0x3f8b72a, 0x053e3b0, 0x152cdac, 0x025289c, 0x11718da, 0x0d7ef99, 0x0ad6151, 0x15f7171, 0x370517c, 0x1119596 }
+		},
+		{
+			{ 0x343f48b, 0x15548f4, 0x38e04c8, 0x00e029f, 0x2ee9fa4, 0x1612775, 0x32e16ce, 0x1c588f9, 0x186d927, 0x1f74946 },
+			{ 0x1c43b3c, 0x1a0e533, 0x23ccca5, 0x04755c8, 0x3ad6418, 0x075ddd8, 0x0c3497a, 0x14fcde9, 0x398bb64, 0x0793ac8 },
+			{ 0x05a3aec, 0x0fd021c, 0x35ef8e8, 0x10e7c2f, 0x359c7dc, 0x16fbc38, 0x203a8ee, 0x0bb10df, 0x3891df5, 0x068b8ef }
+		},
+		{
+			{ 0x2b5e0d0, 0x03fcf7d, 0x2cb4450, 0x0d912f2, 0x3cd23c8, 0x14d7d50, 0x1ec9b5c, 0x03e8f81, 0x0ce869e, 0x12414e5 },
+			{ 0x049686d, 0x0327c56, 0x11efdc5, 0x089456b, 0x0b8276b, 0x026cdfa, 0x2b86fb9, 0x0f33b53, 0x15ee42d, 0x164a44c },
+			{ 0x384dda5, 0x0a33f61, 0x079c903, 0x078f0b2, 0x3837906, 0x123dab0, 0x114d0d7, 0x0938ea7, 0x2e55edb, 0x1cb0706 }
+		},
+		{
+			{ 0x3177103, 0x0512ac4, 0x16ba45b, 0x1759e8b, 0x170af79, 0x1ddd776, 0x2961479, 0x0fa02aa, 0x2ecf58f, 0x1ea30f5 },
+			{ 0x3b8f5db, 0x1149500, 0x28507cb, 0x198f58e, 0x3d23237, 0x0cdae69, 0x20d0892, 0x04f3459, 0x3e14c16, 0x1be41d5 },
+			{ 0x33e7aa3, 0x0c71599, 0x1fb5dda, 0x19af38f, 0x3c7e71f, 0x19c4fa9, 0x0c9caad, 0x1fec8bd, 0x24ac8e6, 0x1358543 }
+		},
+		{
+			{ 0x20912c2, 0x0a72515, 0x3b45f3a, 0x190e9df, 0x320cebd, 0x119cc22, 0x10f02d3, 0x11ecdb5, 0x2b2dd9b, 0x1af2456 },
+			{ 0x0a50a83, 0x0fa3fef, 0x36cd1c3, 0x0f19f15, 0x01c9757, 0x0135ad2, 0x21f4065, 0x0e3e084, 0x3dcdfe8, 0x0796b9f },
+			{ 0x2f4204e, 0x13a1d61, 0x1533242, 0x001941c, 0x34a349f, 0x1d95381, 0x104eab4, 0x0e6aa4f, 0x1afb7d7, 0x0291994 }
+		},
+		{
+			{ 0x1e636e5, 0x04bee51, 0x1230b53, 0x14865f6, 0x37a102f, 0x13729f0, 0x3d2b043, 0x19b8791, 0x2a2e055, 0x0816147 },
+			{ 0x0e75229, 0x1dad3b4, 0x3a4f226, 0x0d730a5, 0x21626d6, 0x08515a7, 0x1cf468f, 0x09ab512, 0x08da2dc, 0x10bda1b },
+			{ 0x2ce9a39, 0x0ae8f52, 0x07d5258, 0x0a1d58e, 0x33ef288, 0x03e1ace, 0x3a7431e, 0x0f017b4, 0x16274ec, 0x18839e7 }
+		},
+		{
+			{ 0x270288b, 0x0854045, 0x2366c7f, 0x19ea726, 0x0342b08, 0x1b92f98, 0x032c475, 0x0bb39df, 0x1501e98, 0x1895574 },
+			{ 0x0af1348, 0x06dd563, 0x09fe470, 0x0b40544, 0x13c8a0a, 0x1e44e5b, 0x1d25d5a, 0x0f3ab09, 0x1318e8c, 0x08681e6 },
+			{ 0x269f389, 0x0db8844, 0x269fe09, 0x0151411, 0x3f877b1, 0x0b94ce0, 0x252a6e0, 0x00e228a, 0x06c249d, 0x035ec63 }
+		},
+		{
+			{ 0x1672534, 0x04c0264, 0x1a13ba3, 0x089a519, 0x214128c, 0x0031612, 0x0e337ed, 0x1329e5f, 0x35437f2, 0x0bd05db },
+			{ 0x1ef9a0c, 0x17b20b8, 0x10a5a88, 0x182f6be, 0x3546c9a, 0x18a8e67, 0x093343b, 0x10db2d4, 0x02d38bd, 0x12c6793 },
+			{ 0x3770b69, 0x15c2d9e, 0x197caf8, 0x080443d, 0x36f67e4, 0x135df3f, 0x206c65a, 0x1f42946, 0x221d951, 0x0e9825f }
+		},
+		{
+			{ 0x3f25330, 0x022e9ef, 0x2f90b6e, 0x1b2f466, 0x12bb345, 0x1e1db23, 0x3c85f58, 0x06b1378, 0x07272c7, 0x13bc18e },
+			{ 0x1ea7bd1, 0x1df29fc, 0x10ca0b6, 0x18400c5, 0x00ba4c7, 0x1185748, 0x30f2198, 0x0fa6695, 0x1560e60, 0x11fdcf9 },
+			{ 0x3ea1807, 0x1510814, 0x21e61bf, 0x1aec0c3, 0x2b03ba5, 0x192a2eb, 0x1c8152c, 0x10a9d61, 0x1d8b529, 0x041e475 }
+		},
+		{
+			{ 0x31ceb59, 0x1f16b07, 0x0f96180, 0x0338938, 0x2b4f13f, 0x01d46df, 0x1b95611, 0x0190aa4, 0x338f0a6, 0x067c4be },
+			{ 0x122db93, 0x09f67b2, 0x0a0154d, 0x073c3eb, 0x134c8dc, 0x1a37e04, 0x3c5b914, 0x09905e3, 0x1abcf14, 0x1f4c101 },
+			{ 0x0d07d06, 0x0d47981, 0x14e61e6, 0x0c3de42, 0x202d2fd, 0x1311f4c, 0x23b5f22, 0x0a0a9e2, 0x21f104b, 0x0944fd0 }
+		},
+		{
+			{ 0x0a6c7d5, 0x0914616, 0x0d99b9c, 0x00f00d1, 0x0826ea8, 0x066f792, 0x154c6a5, 0x114eada, 0x1e43084, 0x0a40bfc },
+			{ 0x14befec, 0x17c982e, 0x11b117b, 0x0ed2ff7, 0x25b99d9, 0x02bb614, 0x1260985, 0x0dde91b, 0x01dbcb0, 0x01f321d },
+			{ 0x152ab8a, 0x15ce5b3, 0x016ad02, 0x1636047, 0x216bd93, 0x02448b7, 0x32c1c4a, 0x0a31c20, 0x13be5d4, 0x0ba8365 }
+		},
+		{
+			{ 0x1ccb0e8, 0x1fc40e0, 0x392a7ae, 0x10ce028, 0x0b71eea, 0x103953e, 0x0a7814f, 0x018bc06, 0x2ff2973, 0x12b3689 },
+			{ 0x0f4145c, 0x06c3beb, 0x00111a3, 0x083428d, 0x201bdb1, 0x0bd716d, 0x3acff90, 0x1b44dc5, 0x3464961, 0x0caf190 },
+			{ 0x0342c6d, 0x0ea2e4a, 0x34bcf8a, 0x0a44946, 0x0428a4f, 0x05e4436, 0x10f1ea4, 0x17ff4b1, 0x394d9e6, 0x09eca5f }
+		},
+		{
+			{ 0x0406620, 0x1de29ad, 0x14b15dc, 0x03bf38c, 0x00eb77c, 0x000e7cf, 0x17d4abc, 0x17b3d7c, 0x10d8836, 0x0bfc71f },
+			{ 0x35c3a73, 0x131fe40, 0x37555d0, 0x167b240, 0x2cf2064, 0x0aa69f8, 0x102e289, 0x0576367, 0x074c235, 0x09dff5e },
+			{ 0x270d5fd, 0x09738e0, 0x0df05b1, 0x1494649, 0x2896f77, 0x0712517, 0x130e185, 0x1f52ed8, 0x10699fa, 0x151cd7c }
+		},
+		{
+			{ 0x33593d1, 0x1cc2027, 0x0c51f8e, 0x05fd8ca, 0x3e41853, 0x1577e7e, 0x2040cd5, 0x01f7543, 0x3652797, 0x186c350 },
+			{ 0x07c6937, 0x1e21539, 0x1f082a1, 0x17387c2, 0x0b50be8, 0x104def7, 0x26eb0c3, 0x1762f40, 0x2129a18, 0x09ed32d },
+			{ 0x1b70958, 0x04e5237, 0x1dc8916, 0x0698e51, 0x260c1c9, 0x1ee70dd, 0x30616d4, 0x0297b29, 0x19a72f6, 0x0484b31 }
+		},
+		{
+			{ 0x14f9e7d, 0x124a0ab, 0x17e64e2, 0x0b4d759, 0x3da3218, 0x0a7e4e4, 0x242a182, 0x1fc3271, 0x2c6fac2, 0x164cf10 },
+			{ 0x363f77c, 0x1b9a07f, 0x2c85853, 0x00d4310, 0x2096c0e, 0x187264d, 0x1068ac0, 0x01b62ec, 0x0895ace, 0x095c9b3 },
+			{ 0x3ecf8bc, 0x09f6153, 0x3e08e8e, 0x17ee570, 0x2f48bd5, 0x04c3581, 0x2e5b53c, 0x1814dbb, 0x3dc95ea, 0x0c4ac73 }
+		}
+	},
+	{
+		{
+			{ 0x2ca61c4, 0x07ff112, 0x1f0d3dc, 0x09d071e, 0x3b0e17d, 0x1d6cf15, 0x302baca, 0x0b01dee, 0x16b6793, 0x052bfb0 },
+			{ 0x1557c0f, 0x0f6e130, 0x21c150a, 0x11a6b8f, 0x1b58ec6, 0x095d379, 0x2237bf8, 0x01ec4ae, 0x3142282, 0x01282a1 },
+			{ 0x366fcb1, 0x1d0ce0c, 0x010ff33, 0x17715e1, 0x0e83d5f, 0x19106ec, 0x0f984c7, 0x0c01b47, 0x309ff3c, 0x1e42625 }
+		},
+		{
+			{ 0x1169faa, 0x0980082, 0x2508ea2, 0x1061542, 0x1c31673, 0x030425e, 0x37dc3c9, 0x09ede2f, 0x21ba896, 0x1f575dc },
+			{ 0x1fc61b0, 0x0defaf7, 0x00269ee, 0x0b7f545, 0x1bc2322, 0x17b3699, 0x3a06c90, 0x1f4301e, 0x0db5d11, 0x075f483 },
+			{ 0x0ad2f8d, 0x023ad36, 0x35ebe9b, 0x0be5472, 0x34fc2e7, 0x083735c, 0x2f2dcd2, 0x01909eb, 0x148ae2b, 0x0158e6b }
+		},
+		{
+			{ 0x1f3091b, 0x02df90e, 0x098380a, 0x01fc20f, 0x103cde6, 0x06491ff, 0x1bac118, 0x1c7f537, 0x1a82899, 0x0cb600b },
+			{ 0x17ec60a, 0x18111ad, 0x01b8faa, 0x15120ef, 0x32a1a08, 0x01c53aa, 0x3ff393f, 0x0643401, 0x096986a, 0x09610f0 },
+			{ 0x15b7ddc, 0x11b5947, 0x2e01be3, 0x025759d, 0x092a916, 0x05e07d4, 0x03f3bde, 0x0eebd14, 0x17fce26, 0x0ad9e24 }
+		},
+		{
+			{ 0x1e1f9b3, 0x1fe658d, 0x00b5155, 0x13356cd, 0x2efe3cf, 0x1977dd1, 0x0cd60e9, 0x1d66b23, 0x01f9cde, 0x1630af6 },
+			{ 0x01490bb, 0x0347478, 0x1662bcc, 0x11c58d6, 0x16bbaac, 0x049dae8, 0x355e671, 0x0bc564b, 0x2f788ca, 0x11d28fb },
+			{ 0x3bee260, 0x0503e0e, 0x1e58266, 0x0561443, 0x0afa540, 0x0d24e30, 0x0a90cad, 0x0a75aa4, 0x19fa0e6, 0x19f2bb6 }
+		},
+		{
+			{ 0x07b4aa6, 0x1ff93b5, 0x14ff9a1, 0x07ddf2a, 0x27172f2, 0x0136060, 0x1dec448, 0x15c802e, 0x2f14699, 0x07f8129 },
+			{ 0x2e03d01, 0x177b358, 0x024b054, 0x196b397, 0x19046df, 0x06afa60, 0x2c7cd94, 0x15a3631, 0x0526fea, 0x10a3821 },
+			{ 0x3a3cee4, 0x006c0b5, 0x2780945, 0x0e6ee1c, 0x075b5d1, 0x1d81d2c, 0x358670b, 0x0bc2e38, 0x3609882, 0x0551f2e }
+		},
+		{
+			{ 0x098008c, 0x176d573, 0x09e4381, 0x1a5ac0a, 0x3f9e871, 0x0132576, 0x00f171c, 0x1c5d5b0, 0x3b1b7ed, 0x1b624ca },
+			{ 0x117efad, 0x1cbc906, 0x3788bd0, 0x0c75266, 0x191c911, 0x1238f66, 0x3706646, 0x160ecd9, 0x0f8c7b5, 0x100b309 },
+			{ 0x021aa37, 0x1d87e5e, 0x377cea0, 0x0d298c2, 0x0a862ce, 0x0c3e0a0, 0x393053c, 0x00aa469, 0x24a346c, 0x1900aea }
+		},
+		{
+			{ 0x23e73c7, 0x06b8dd1, 0x1fa87ce, 0x0a3f817, 0x097db38, 0x1e24ddc, 0x195cdeb, 0x19fef03, 0x053afff, 0x189dfbb },
+			{ 0x2c879b6, 0x1fbc175, 0x258717b, 0x0b9feae, 0x29541ee, 0x13df9c6, 0x13c8a41, 0x1e3907c, 0x3842c52, 0x082d1bc },
+			{ 0x2c1aabb, 0x162e826, 0x320a774, 0x0c1fbed, 0x1554b1c, 0x0ab750a, 0x1a165d7, 0x13003f7, 0x2786f61, 0x0dbff29 }
+		},
+		{
+			{ 0x3f62a50, 0x101748b, 0x08437d6, 0x00d8c85, 0x2f346fa, 0x0a63918, 0x177705e, 0x134e5f0, 0x1eca8ea, 0x193f484 },
+			{ 0x16b4cbc, 0x1a0c53a, 0x02fab55, 0x1a8cc40, 0x15ce27e, 0x1b30cc8, 0x22b23b1, 0x13e3187, 0x373b6cd, 0x185e6aa },
+			{ 0x1ead8cc, 0x04ede7e, 0x0e6e700, 0x175b189, 0x2705c3c, 0x01a71b2, 0x2d88d71, 0x0632fd2, 0x15b8bf9, 0x1ec606b }
+		},
+		{
+			{ 0x1465cf0, 0x17f6a4a, 0x14d9796, 0x0fc89f8, 0x33baec8, 0x18c3492, 0x09380bf, 0x02a05cc, 0x2565912, 0x11041b7 },
+			{ 0x13ea7d4, 0x1eaa93b, 0x077030a, 0x1092806, 0x2efa16c, 0x02b9f59, 0x15fce32, 0x0b6558c, 0x3adff21, 0x0315b7a },
+			{ 0x116407a, 0x0f588b2, 0x3c63edd, 0x1d08577, 0x28aa4e7, 0x121b21a, 0x1c5068c, 0x08d7013, 0x27c9bac, 0x107d24d }
+		},
+		{
+			{ 0x34a4729, 0x0f7dde8, 0x3c1823d, 0x0f37e30, 0x39decd8, 0x072a483, 0x14c20aa, 0x01a12ab, 0x1c8cde1, 0x0443baa },
+			{ 0x03796e5, 0x1c01f08, 0x38d1685, 0x0350b41, 0x38aeb71, 0x1ac201b, 0x12072d7, 0x1ee7653, 0x14b9fb9, 0x1a709af },
+			{ 0x1ec3936, 0x0320e49, 0x222ef3e, 0x053e833, 0x3dbb73c, 0x1944c60, 0x1b5eff1, 0x00d30d4, 0x1ffb0e5, 0x009c021 }
+		},
+		{
+			{ 0x0afab79, 0x1c9060d, 0x182f2ef, 0x1329ad7, 0x31d2d44, 0x1d7bec6, 0x0d9423a, 0x0ee291f, 0x0472889, 0x1d6cd37 },
+			{ 0x3d68ddd, 0x02d8932, 0x04d474e, 0x151e1b0, 0x3d686ce, 0x0a373c2, 0x31e51a8, 0x07e6544, 0x325457e, 0x12297f1 },
+			{ 0x1aef117, 0x11c7eb9, 0x1d801fe, 0x04bfabd, 0x334e622, 0x0e46163, 0x1c237d4, 0x06bd9b6, 0x2eba010, 0x00d08ad }
+		},
+		{
+			{ 0x250002e, 0x0c121ad, 0x2787361, 0x0d6d6f9, 0x0734c80, 0x122611e, 0x357535d, 0x062d77a, 0x069763a, 0x17f12af },
+			{ 0x1401113, 0x0c8d416, 0x189547b, 0x1134030, 0x3512e8a, 0x1ef3bb1, 0x0401ddd, 0x1f4eb29, 0x198e820, 0x0a6959d },
+			{ 0x1f71673, 0x02cc241, 0x079d9d5, 0x04f3428, 0x158ded5, 0x0d48fb2, 0x295c72f, 0x1b56677, 0x3bd4026, 0x0bc1119 }
+		},
+		{
+			{ 0x345d11d, 0x1d768e3, 0x0bf60eb, 0x174767d, 0x30e055b, 0x12eecd1, 0x1ef38eb, 0x10e14e5, 0x1a6b63b, 0x06213a1 },
+			{ 0x262f1a2, 0x0b21652, 0x09d27a3, 0x0629454, 0x1bc7a75, 0x035aad8, 0x0e05f17, 0x131fd13, 0x2aab0ef, 0x05f7c0c },
+			{ 0x0ea0c04, 0x0ae3c29, 0x2bae774, 0x0ed41b3, 0x09eec4f, 0x00d36fd, 0x3ac4046, 0x08c9cf9, 0x1bcf47b, 0x0e4fec3 }
+		},
+		{
+			{ 0x3e95937, 0x0a35030, 0x0675a1b, 0x1b88854, 0x2e393c2, 0x014e7c7, 0x1db48f6, 0x1d9655e, 0x35b819c, 0x0020ce8 },
+			{ 0x13df601, 0x16d4f3f, 0x3aadd96, 0x179ba76, 0x04d76fc, 0x10acf43, 0x3c91961, 0x0080bc0, 0x3b1b21b, 0x02a940b },
+			{ 0x2737bcf, 0x13f3d21, 0x0fb0754, 0x077c4d3, 0x21eaed0, 0x1eb374e, 0x0bdbbf3, 0x0bb2bc2, 0x0304aeb, 0x00a5510 }
+		},
+		{
+			{ 0x31aa348, 0x1743b27, 0x393b030, 0x06a568e, 0x1aa2002, 0x137350f, 0x128dab2, 0x06d7154, 0x390e25c, 0x129a1e7 },
+			{ 0x0643318, 0x164bffa, 0x251acb1, 0x160a77a, 0x265c4d7, 0x058182e, 0x30a8ef0, 0x1206853, 0x13481f8, 0x18cb44b },
+			{ 0x1529d65, 0x013e887, 0x37ae234, 0x004a07f, 0x13fbc2c, 0x0dcc61e, 0x2a91ce6, 0x179571c, 0x3836eca, 0x099a9db }
+		},
+		{
+			{ 0x11efd7b, 0x1495dec, 0x218bf17, 0x1275522, 0x0399f1c, 0x03f9edf, 0x2f4cc00, 0x10c9dfd, 0x318192d, 0x020614b },
+			{ 0x11091a0, 0x1ea56c6, 0x0b29053, 0x1d4d791, 0x3c00f6c, 0x1b70e2d, 0x1ec2dcb, 0x17e08dd, 0x19567a0, 0x17d63c8 },
+			{ 0x1e5dd09, 0x11aecfd, 0x2aeb112, 0x0dd7e59, 0x11a5b4f, 0x150902b, 0x2b8d826, 0x020efa1, 0x0c6a755, 0x19e3257 }
+		}
+	}
+};
+
+static const s32		kCurve25519BaseNeg[ 3 ][ 10 ] =
+{
+	{ 0x340913e, 0x00e4175, 0x3d673a2, 0x02e8a05, 0x3f4e67c, 0x08f8a09, 0x0c21a34, 0x04cf4b8, 0x1298f81, 0x113f4be },
+	{ 0x18c3b85, 0x124f1bd, 0x1c325f7, 0x037dc60, 0x33e4cb7, 0x03d42c2, 0x1a44c32, 0x14ca4e1, 0x3a33d4b, 0x01f3e74 },
+	{ 0x0855585, 0x1bb7e9e, 0x36c2a86, 0x0e19aa9, 0x364985f, 0x0bca673, 0x2411a11, 0x14af4bc, 0x1760f39, 0x043ba12 }
+};
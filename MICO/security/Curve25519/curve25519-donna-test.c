@@ -61,6 +61,8 @@
 
 OSStatus	curve25519_test( int print );
 int			curve25519_djb_test( int print );
+static OSStatus	curve25519_rfc7748_iterated_test( void );
+static OSStatus	curve25519_fixed_base_test( int print );
 
 //===========================================================================================================================
 //	Test Vectors
@@ -94,6 +96,15 @@ static const curve25519_test_vector		kCurve25519TestVectors[] =
 	{ "49af81190869fd742a33691b0e0824d57e0329f4dd2819f5f32d130f1296b500", "7b2bcc18dab6706a24f22e4ccf6c174dba91915c83e5f04e51dae5201353da2f", "05aec13f92286f3a781ccae98995a3b9e0544770bc7de853b38f9100489e3e79" }, 
 	{ "4faf81190869fd742a33691b0e0824d57e0329f4dd2819f5f32d130f1296b500", "05aec13f92286f3a781ccae98995a3b9e0544770bc7de853b38f9100489e3e79", "cd6e8269104eb5aaee886bd2071fba88bd13861475516bc2cd2b6e005e805064" }, 
 	
+	// RFC 7748 section 5.2 and the section 6.1 Alice and Bob keys (base point 9 takes the fixed-base path)
+	
+	{ "a546e36bf0527c9d3b16154b82465edd62144c0ac1fc5a18506a2244ba449ac4", "e6db6867583030db3594c1a424b15f7c726624ec26b3353b10a903a6d0ab1c4c", "c3da55379de9c6908e94ea4df28d084f32eccf03491c71f754b4075577a28552" }, 
+	{ "4b66e9d4d1b4673c5ad22691957d6af5c11b6421e0ea01d42ca4169e7918ba0d", "e5210f12786811d3f4b7959d0538ae2c31dbe7106fc03c3efc4cd549c715a493", "95cbde9476e8907d7aade45cb4b873f88b595a68799fa152e6f8f7647aac7957" }, 
+	{ "77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a", "0900000000000000000000000000000000000000000000000000000000000000", "8520f0098930a754748b7ddcb43ef75a0dbf3a0d26381af4eba4a98eaa9b4e6a" }, 
+	{ "5dab087e624a8a4b79e17f8b83800ee66f3bb1292618b6fd1c2f8b27ff88e0eb", "0900000000000000000000000000000000000000000000000000000000000000", "de9edb7d7b7dc1b4d35b61c2ece435373f8343c85b78674dadfc7e146f882b4f" }, 
+	{ "77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a", "de9edb7d7b7dc1b4d35b61c2ece435373f8343c85b78674dadfc7e146f882b4f", "4a5d9d5ba4ce2de1728e3bf480350f25e07e21c947d19e3376f09b3c1e161742" }, 
+	{ "5dab087e624a8a4b79e17f8b83800ee66f3bb1292618b6fd1c2f8b27ff88e0eb", "8520f0098930a754748b7ddcb43ef75a0dbf3a0d26381af4eba4a98eaa9b4e6a", "4a5d9d5ba4ce2de1728e3bf480350f25e07e21c947d19e3376f09b3c1e161742" }, 
+	
 	// Randomize tests
 	
 	{ "1c2b52c2b3c1e7f3f5b0caa1879c64c483503445f13411298e45705293ec31fa", "9414d5a5e714daae1df06a1226f2b327a9078c059aeb07bf3c761e702ce00b63", "1104c5480f67334864ca632ea7ea153ced82cbfab424f94de91323dba3127265" }, 
@@ -193,6 +204,12 @@ OSStatus	curve25519_test( int print )
 		}
 	}
 	
+	err = curve25519_rfc7748_iterated_test();
+	require_noerr( err, exit );
+	
+	err = curve25519_fixed_base_test( print );
+	require_noerr( err, exit );
+	
 	t = CFAbsoluteTimeGetCurrent();
 	err = curve25519_djb_test( print );
 	require_noerr( err, exit );
@@ -203,6 +220,88 @@ exit:
 	return( err );
 }
 
+//===========================================================================================================================
+//	curve25519_rfc7748_iterated_test
+//
+//	RFC 7748 section 5.2: k = u = 9, then repeatedly u = k, k = X25519( k, u ).
+//===========================================================================================================================
+
+static OSStatus	curve25519_rfc7748_iterated_test( void )
+{
+	static const uint8_t		kAfter1[ 32 ] = 
+	{
+		0x42, 0x2c, 0x8e, 0x7a, 0x62, 0x27, 0xd7, 0xbc, 0xa1, 0x35, 0x0b, 0x3e, 0x2b, 0xb7, 0x27, 0x9f, 
+		0x78, 0x97, 0xb8, 0x7b, 0xb6, 0x85, 0x4b, 0x78, 0x3c, 0x60, 0xe8, 0x03, 0x11, 0xae, 0x30, 0x79
+	};
+	static const uint8_t		kAfter1000[ 32 ] = 
+	{
+		0x68, 0x4c, 0xf5, 0x9b, 0xa8, 0x33, 0x09, 0x55, 0x28, 0x00, 0xef, 0x56, 0x6f, 0x2f, 0x4d, 0x3c, 
+		0x1c, 0x38, 0x87, 0xc4, 0x93, 0x60, 0xe3, 0x87, 0x5f, 0x2e, 0xb9, 0x4d, 0x99, 0x53, 0x2c, 0x51
+	};
+	OSStatus		err;
+	uint8_t			k[ 32 ] = { 9 };
+	uint8_t			u[ 32 ] = { 9 };
+	uint8_t			r[ 32 ];
+	int				i;
+	
+	for( i = 1; i <= 1000; ++i )
+	{
+		curve25519_donna( r, k, u );
+		memcpy( u, k, 32 );
+		memcpy( k, r, 32 );
+		if( i == 1 ) require_action( memcmp( k, kAfter1, 32 ) == 0, exit, err = kMismatchErr );
+	}
+	require_action( memcmp( k, kAfter1000, 32 ) == 0, exit, err = kMismatchErr );
+	err = kNoErr;
+	
+exit:
+	return( err );
+}
+
+//===========================================================================================================================
+//	curve25519_fixed_base_test
+//
+//	Checks the fixed-base path (NULL or 9 as the base point) against the ladder and times both. The ladder is forced with
+//	9 plus bit 255, which curve25519_donna masks off, so it is the same point.
+//===========================================================================================================================
+
+static OSStatus	curve25519_fixed_base_test( int print )
+{
+	OSStatus			err;
+	uint8_t				e[ 32 ], k[ 32 ], ek[ 32 ], ek2[ 32 ];
+	uint8_t				nine[ 32 ] = { 9 };
+	uint8_t				ladder[ 32 ] = { 9 };
+	int					i, j;
+	CFAbsoluteTime		tBase, tLadder;
+	
+	ladder[ 31 ] = 0x80;
+	memset( e, 0x5a, sizeof( e ) );
+	for( i = 0; i < 100; ++i )
+	{
+		curve25519_donna( ek, e, NULL );
+		curve25519_donna( k, e, nine );
+		curve25519_donna( ek2, e, ladder );
+		require_action( memcmp( ek, ek2, 32 ) == 0, exit, err = kMismatchErr );
+		require_action( memcmp( k, ek2, 32 ) == 0, exit, err = kMismatchErr );
+		
+		for( j = 0; j < 32; ++j ) e[ j ] ^= ek[ j ];
+	}
+	
+	tBase = CFAbsoluteTimeGetCurrent();
+	for( i = 0; i < 100; ++i ) curve25519_donna( ek, e, NULL );
+	tBase = CFAbsoluteTimeGetCurrent() - tBase;
+	
+	tLadder = CFAbsoluteTimeGetCurrent();
+	for( i = 0; i < 100; ++i ) curve25519_donna( ek2, e, ladder );
+	tLadder = CFAbsoluteTimeGetCurrent() - tLadder;
+	
+	if( print ) FPrintF( stdout, "curve25519 public key: fixed-base %f ms, ladder %f ms\n", tBase * 10, tLadder * 10 );
+	err = kNoErr;
+	
+exit:
+	return( err );
+}
+
 //===========================================================================================================================
 //	curve25519_djb_test
 //
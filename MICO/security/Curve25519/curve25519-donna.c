@@ -804,6 +804,172 @@ crecip(limb *out, const limb *z) {
   /* 2^255 - 21 */ fmul(out,t1,z11);
 }
 
+#if( !defined( CURVE25519_FIXED_BASE ) )
+	#define	CURVE25519_FIXED_BASE		1	// 0 drops the 7.5 KB comb table and always uses the ladder.
+#endif
+
+#if( CURVE25519_FIXED_BASE )
+// -----------------------------------------------------------------------------
+// Fixed-base scalar multiplication
+//
+// When the base point is 9, the multiple is computed on edwards25519 with the
+// signed comb in curve25519-donna-base.h (12 doublings and 53 additions) and
+// mapped back to u = (1 + y) / (1 - y). Table lookups read every entry, so
+// like the ladder it runs in time independent of the secret.
+// -----------------------------------------------------------------------------
+
+#include "curve25519-donna-base.h"
+
+#define	CURVE25519_COMB_BITS	( CURVE25519_COMB_COMBS * CURVE25519_COMB_TEETH * CURVE25519_COMB_SPACING )
+
+/* Field elements get an 11th limb for freduce_coefficients. */
+
+/* Extended coordinates: x = X/Z, y = Y/Z, T = XY/Z */
+typedef struct {
+  limb x[11], y[11], z[11], t[11];
+} ge_p3;
+
+/* Affine ( y+x, y-x, 2dxy ) */
+typedef struct {
+  limb ypx[11], ymx[11], xy2d[11];
+} ge_niels;
+
+typedef struct {
+  ge_p3 p;
+  ge_niels q;
+  limb a[11], b[11], c[11], e[11], f[11], g[11], h[11];
+} ge_work;
+
+static void fadd(limb *output, const limb *a, const limb *b) {
+  unsigned i;
+  for (i = 0; i < 10; ++i) output[i] = a[i] + b[i];
+}
+
+static void fsub(limb *output, const limb *a, const limb *b) {
+  unsigned i;
+  for (i = 0; i < 10; ++i) output[i] = a[i] - b[i];
+}
+
+/* p = p + q, q in niels form. Complete, so the identity and p == q are fine. */
+static void ge_madd(ge_work *w) {
+  ge_p3 *p = &w->p;
+  const ge_niels *q = &w->q;
+
+  fsub(w->a, p->y, p->x);
+  fmul(w->a, w->a, q->ymx);
+  fadd(w->b, p->y, p->x);
+  fmul(w->b, w->b, q->ypx);
+  fmul(w->c, p->t, q->xy2d);
+  fadd(w->h, p->z, p->z);
+  fsub(w->f, w->h, w->c);   /* F = 2Z - C */
+  freduce_coefficients(w->f);
+  fadd(w->g, w->h, w->c);   /* G = 2Z + C */
+  freduce_coefficients(w->g);
+  fsub(w->e, w->b, w->a);   /* E = B - A */
+  fadd(w->h, w->b, w->a);   /* H = B + A */
+  fmul(p->x, w->e, w->f);
+  fmul(p->y, w->g, w->h);
+  fmul(p->z, w->f, w->g);
+  fmul(p->t, w->e, w->h);
+}
+
+/* p = 2p */
+static void ge_dbl(ge_work *w) {
+  ge_p3 *p = &w->p;
+  unsigned i;
+
+  fsquare(w->a, p->x);
+  fsquare(w->b, p->y);
+  fsquare(w->c, p->z);
+  fadd(w->e, p->x, p->y);
+  fsquare(w->e, w->e);
+  fadd(w->h, w->a, w->b);
+  for (i = 0; i < 10; ++i) w->h[i] = -w->h[i];   /* H = -A - B */
+  fsub(w->g, w->b, w->a);                        /* G = B - A */
+  fsum(w->e, w->h);                              /* E = (X+Y)^2 - A - B */
+  freduce_coefficients(w->e);
+  fsum(w->c, w->c);
+  fsub(w->f, w->g, w->c);                        /* F = G - 2Z^2 */
+  freduce_coefficients(w->f);
+  fmul(p->x, w->e, w->f);
+  fmul(p->y, w->g, w->h);
+  fmul(p->z, w->f, w->g);
+  fmul(p->t, w->e, w->h);
+}
+
+/* q = entry v of comb j, negated if neg is 1. Reads the whole comb. */
+static void ge_select(ge_niels *q, unsigned j, unsigned v, s32 neg) {
+  s32 t[3][10] = {{0}};
+  unsigned i, k, n;
+
+  for (i = 0; i < CURVE25519_COMB_ENTRIES; ++i) {
+    const s32 mask = -(s32)(((uint32_t)(i ^ v) - 1) >> 31);
+    for (k = 0; k < 3; ++k)
+      for (n = 0; n < 10; ++n)
+        t[k][n] |= kCurve25519BaseComb[j][i][k][n] & mask;
+  }
+  /* -(x, y) = (-x, y) swaps y+x and y-x and negates 2dxy */
+  for (n = 0; n < 10; ++n) {
+    const s32 x = (t[0][n] ^ t[1][n]) & -neg;
+    q->ypx[n] = t[0][n] ^ x;
+    q->ymx[n] = t[1][n] ^ x;
+    q->xy2d[n] = t[2][n] ^ ((t[2][n] ^ -t[2][n]) & -neg);
+  }
+}
+
+/* Bit i of e/2 + 2^(CURVE25519_COMB_BITS-1). Its bits b give the digits
+ * 2b - 1 = +-1 of e + 1, which is odd as e is clamped to a multiple of 8. */
+static unsigned comb_bit(const u8 *e, unsigned i) {
+  if (i == CURVE25519_COMB_BITS - 1) return 1;
+  if (++i >= 256) return 0;
+  return (e[i >> 3] >> (i & 7)) & 1;
+}
+
+/* mypublic = e * 9 for a clamped e. Returns -1 if out of memory. */
+static int
+cmult_base(u8 *mypublic, const u8 *e) {
+  ge_work *w = calloc(1, sizeof(ge_work));
+  unsigned i, j, k, v, top;
+
+  if (w == NULL) return -1;
+
+  w->p.y[0] = 1;
+  w->p.z[0] = 1;
+  for (i = CURVE25519_COMB_SPACING; i-- > 0; ) {
+    if (i != CURVE25519_COMB_SPACING - 1) ge_dbl(w);
+    for (j = 0; j < CURVE25519_COMB_COMBS; ++j) {
+      /* Negate the whole column if its top digit is -1 */
+      top = comb_bit(e, i + CURVE25519_COMB_SPACING * (CURVE25519_COMB_TEETH - 1 + CURVE25519_COMB_TEETH * j));
+      v = 0;
+      for (k = 0; k < CURVE25519_COMB_TEETH - 1; ++k)
+        v |= (comb_bit(e, i + CURVE25519_COMB_SPACING * (k + CURVE25519_COMB_TEETH * j)) ^ top ^ 1) << k;
+      ge_select(&w->q, j, v, (s32)(top ^ 1));
+      ge_madd(w);
+    }
+  }
+
+  /* The comb gave (e + 1) * B */
+  for (i = 0; i < 10; ++i) {
+    w->q.ypx[i] = kCurve25519BaseNeg[0][i];
+    w->q.ymx[i] = kCurve25519BaseNeg[1][i];
+    w->q.xy2d[i] = kCurve25519BaseNeg[2][i];
+  }
+  ge_madd(w);
+
+  /* u = (1 + y) / (1 - y) = (Z + Y) / (Z - Y) */
+  fadd(w->a, w->p.z, w->p.y);
+  fsub(w->b, w->p.z, w->p.y);
+  crecip(w->c, w->b);
+  fmul(w->e, w->a, w->c);
+  freduce_coefficients(w->e);
+  fcontract(mypublic, w->e);
+
+  memset(w, 0, sizeof(*w));
+  free(w);
+  return 0;
+}
+#endif // CURVE25519_FIXED_BASE
+
 static const unsigned char		kCurve25519BasePoint[ 32 ] = { 9 };
 
 void
@@ -819,6 +985,12 @@ curve25519_donna(u8 *mypublic, const u8 *secret, const u8 *basepoint) {
   e[31] &= 127;
   e[31] |= 64;
 
+#if( CURVE25519_FIXED_BASE )
+  if (basepoint == kCurve25519BasePoint || memcmp(basepoint, kCurve25519BasePoint, 32) == 0) {
+    if (cmult_base(mypublic, e) == 0) return;
+  }
+#endif
+
   fexpand(bp, basepoint);
   cmult(x, z, e, bp);
   crecip(zmone, z);
@@ -0,0 +1,70 @@
+/*
+---------------------------------------------------------------------------
+ Build profiles for the table driven parts of AES (aesopt.h) and of the
+ GF(2^128) multiply used by GCM (gf128mul.h).
+
+ The AES round tables are compiled into flash (FIXED_TABLES), the GHASH
+ table lives in RAM inside every gcm_ctx, so the two are traded against
+ speed separately.  Set AES_PROFILE for a target in its project defines,
+ or set any of AES_ROUND_TABLES, AES_UNROLL and GCM_TABLE_SIZE directly
+ to override a single choice of the selected profile.
+
+   profile              round tables  unroll  GHASH table  AES tables  gcm_ctx
+   AES_PROFILE_SMALL    1 (1 KB)      none    256 bytes      5 KB      0.6 KB
+   AES_PROFILE_DEFAULT  4 (4 KB)      full    4 KB          20 KB      4.4 KB
+   AES_PROFILE_FAST     4 (4 KB)      full    8 KB          20 KB      8.4 KB
+
+ AES tables is the flash taken by aestab.c, gcm_ctx the RAM taken by each
+ GCM context.  AESUtils_Bench() reports the speed of the profile built.
+ GCM_TABLE_SIZE 65536 is also accepted but is too large for the MCU
+ targets.
+---------------------------------------------------------------------------
+*/
+
+#ifndef _AES_PROFILE_H
+#define _AES_PROFILE_H
+
+#define AES_PROFILE_SMALL       1
+#define AES_PROFILE_DEFAULT     2
+#define AES_PROFILE_FAST        3
+
+#if !defined( AES_PROFILE )
+#  define AES_PROFILE   AES_PROFILE_DEFAULT
+#endif
+
+#if AES_PROFILE == AES_PROFILE_SMALL
+#  define AES_PROFILE_ROUND_TABLES  1
+#  define AES_PROFILE_UNROLL        0
+#  define AES_PROFILE_GCM_TABLE     256
+#elif AES_PROFILE == AES_PROFILE_DEFAULT
+#  define AES_PROFILE_ROUND_TABLES  4
+#  define AES_PROFILE_UNROLL        2
+#  define AES_PROFILE_GCM_TABLE     4096
+#elif AES_PROFILE == AES_PROFILE_FAST
+#  define AES_PROFILE_ROUND_TABLES  4
+#  define AES_PROFILE_UNROLL        2
+#  define AES_PROFILE_GCM_TABLE     8192
+#else
+#  error AES_PROFILE is not one of the AES_PROFILE_* values
+#endif
+
+/*  Tables used by each AES round function (and the decryption key
+    schedule): 0, 1 or 4, as NO_TABLES, ONE_TABLE or FOUR_TABLES
+*/
+#if !defined( AES_ROUND_TABLES )
+#  define AES_ROUND_TABLES  AES_PROFILE_ROUND_TABLES
+#endif
+
+/*  Round loop unrolling for encryption and decryption: 0, 1 or 2, as
+    NONE, PARTIAL or FULL
+*/
+#if !defined( AES_UNROLL )
+#  define AES_UNROLL        AES_PROFILE_UNROLL
+#endif
+
+/*  Bytes of GHASH table per GCM context: 0, 256, 4096, 8192 or 65536 */
+#if !defined( GCM_TABLE_SIZE )
+#  define GCM_TABLE_SIZE    AES_PROFILE_GCM_TABLE
+#endif
+
+#endif
@@ -96,6 +96,7 @@ Issue Date: 20/12/2007
 /*  PLATFORM SPECIFIC INCLUDES */
 
 #include "brg_endian.h"
+#include "aes_profile.h"
 
 /*  CONFIGURATION - THE USE OF DEFINES
 
@@ -255,19 +256,20 @@ Issue Date: 20/12/2007
     There are also potential speed advantages in expanding two iterations in
     a loop with half the number of iterations, which is called partial loop
     unrolling.  The following options allow partial or full loop unrolling
-    to be set independently for encryption and decryption
+    to be set independently for encryption and decryption.  The default
+    comes from AES_UNROLL, see aes_profile.h.
 */
-#if 1
+#if AES_UNROLL == FULL
 #  define ENC_UNROLL  FULL
-#elif 0
+#elif AES_UNROLL == PARTIAL
 #  define ENC_UNROLL  PARTIAL
 #else
 #  define ENC_UNROLL  NONE
 #endif
 
-#if 1
+#if AES_UNROLL == FULL
 #  define DEC_UNROLL  FULL
-#elif 0
+#elif AES_UNROLL == PARTIAL
 #  define DEC_UNROLL  PARTIAL
 #else
 #  define DEC_UNROLL  NONE
@@ -362,36 +364,37 @@ Issue Date: 20/12/2007
          or 4 tables and table spaces of 0, 1024 or 4096 bytes each.
 
     Include or exclude the appropriate definitions below to set the number
-    of tables used by this implementation.
+    of tables used by this implementation.  The default comes from
+    AES_ROUND_TABLES, see aes_profile.h.
 */
 
-#if 1   /* set tables for the normal encryption round */
+#if AES_ROUND_TABLES == FOUR_TABLES   /* set tables for the normal encryption round */
 #  define ENC_ROUND   FOUR_TABLES
-#elif 0
+#elif AES_ROUND_TABLES == ONE_TABLE
 #  define ENC_ROUND   ONE_TABLE
 #else
 #  define ENC_ROUND   NO_TABLES
 #endif
 
-#if 1   /* set tables for the last encryption round */
+#if AES_ROUND_TABLES == FOUR_TABLES   /* set tables for the last encryption round */
 #  define LAST_ENC_ROUND  FOUR_TABLES
-#elif 0
+#elif AES_ROUND_TABLES == ONE_TABLE
 #  define LAST_ENC_ROUND  ONE_TABLE
 #else
 #  define LAST_ENC_ROUND  NO_TABLES
 #endif
 
-#if 1   /* set tables for the normal decryption round */
+#if AES_ROUND_TABLES == FOUR_TABLES   /* set tables for the normal decryption round */
 #  define DEC_ROUND   FOUR_TABLES
-#elif 0
+#elif AES_ROUND_TABLES == ONE_TABLE
 #  define DEC_ROUND   ONE_TABLE
 #else
 #  define DEC_ROUND   NO_TABLES
 #endif
 
-#if 1   /* set tables for the last decryption round */
+#if AES_ROUND_TABLES == FOUR_TABLES   /* set tables for the last decryption round */
 #  define LAST_DEC_ROUND  FOUR_TABLES
-#elif 0
+#elif AES_ROUND_TABLES == ONE_TABLE
 #  define LAST_DEC_ROUND  ONE_TABLE
 #else
 #  define LAST_DEC_ROUND  NO_TABLES
@@ -401,9 +404,9 @@ Issue Date: 20/12/2007
     way that the round functions can.  Include or exclude the following
     defines to set this requirement.
 */
-#if 1
+#if AES_ROUND_TABLES == FOUR_TABLES
 #  define KEY_SCHED   FOUR_TABLES
-#elif 0
+#elif AES_ROUND_TABLES == ONE_TABLE
 #  define KEY_SCHED   ONE_TABLE
 #else
 #  define KEY_SCHED   NO_TABLES
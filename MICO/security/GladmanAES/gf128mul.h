@@ -131,21 +131,23 @@ Issue Date: 11/01/2011
 #endif
 
 #include "brg_types.h"
+#include "aes_profile.h"
 
 /*  Table sizes for GF(128) Multiply.  Normally larger tables give 
     higher speed but cache loading might change this. Normally only 
-    one table size (or none at all) will be specified here
+    one table size (or none at all) will be specified here.  The
+    default comes from GCM_TABLE_SIZE, see aes_profile.h.
 */
-#if 0
+#if GCM_TABLE_SIZE == 65536
 #  define TABLES_64K
 #endif
-#if 0
+#if GCM_TABLE_SIZE == 8192
 #  define TABLES_8K
 #endif
-#if 1
+#if GCM_TABLE_SIZE == 4096
 #  define TABLES_4K
 #endif
-#if 0
+#if GCM_TABLE_SIZE == 256
 #  define TABLES_256
 #endif
 
@@ -183,7 +185,7 @@ typedef gf_t    gf_t64k_a[16][256];
 typedef gf_t    (*gf_t64k_t)[256];
 
 void init_64k_table(const gf_t g, gf_t64k_t t);
-void gf_mul_64k(gf_t a, const gf_t64k_t t, void *r);
+void gf_mul_64k(gf_t a, const gf_t64k_t t, gf_t r);
 
 /* types and calls for 8k table driven field multiplier        */
 
@@ -155,7 +155,8 @@ int hkdfExpand(SHAversion whichSha, const uint8_t prk[ ], int prk_len,
 {
   int hash_len, N;
   unsigned char T[USHAMaxHashSize];
-  int Tlen, where, i;
+  int Tlen, where, i, ret;
+  HMACKeyContext *keyContext;
 
   if (info == 0) {
     info = (const unsigned char *)"";
@@ -172,23 +173,31 @@ int hkdfExpand(SHAversion whichSha, const uint8_t prk[ ], int prk_len,
   if ((okm_len % hash_len) != 0) N++;
   if (N > 255) return shaBadParam;
 
+  /* every T(i) is a MAC with the PRK, so hash its pads only once */
+  keyContext = malloc(sizeof(HMACKeyContext));
+  if (keyContext == 0) return shaNull;
+  ret = hmacKeySetup(keyContext, whichSha, prk, prk_len);
+
   Tlen = 0;
   where = 0;
-  for (i = 1; i <= N; i++) {
+  for (i = 1; (ret == shaSuccess) && (i <= N); i++) {
     HMACContext context;
     unsigned char c = i;
-    int ret = hmacReset(&context, whichSha, prk, prk_len) ||
-              hmacInput(&context, T, Tlen) ||
-              hmacInput(&context, info, info_len) ||
-              hmacInput(&context, &c, 1) ||
-              hmacResult(&context, T);
-    if (ret != shaSuccess) return ret;
+    ret = hmacKeyedReset(&context, keyContext) ||
+          hmacInput(&context, T, Tlen) ||
+          hmacInput(&context, info, info_len) ||
+          hmacInput(&context, &c, 1) ||
+          hmacResult(&context, T);
+    if (ret != shaSuccess) break;
     memcpy(okm + where, T,
            (i != N) ? hash_len : (okm_len - where));
     where += hash_len;
     Tlen = hash_len;
   }
-  return shaSuccess;
+
+  memset(keyContext, 0, sizeof(HMACKeyContext));
+  free(keyContext);
+  return ret;
 }
 
 /*
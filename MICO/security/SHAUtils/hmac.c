@@ -12,6 +12,7 @@
  */
 
 #include "sha.h"
+#include <string.h>
 
 /*
  *  hmac
@@ -86,6 +87,7 @@ int hmacReset(HMACContext *context, enum SHAversion whichSha,
   unsigned char tempkey[USHAMaxHashSize];
 
   if (!context) return shaNull;
+  context->keyContext = 0;
   context->Computed = 0;
   context->Corrupted = shaSuccess;
 
@@ -227,17 +229,24 @@ int hmacResult(HMACContext *context, uint8_t *digest)
 
   /* finish up 1st pass */
   /* (Use digest here as a temporary buffer.) */
-  ret =
-    USHAResult(&context->shaContext, digest) ||
+  ret = USHAResult(&context->shaContext, digest);
 
-         /* perform outer SHA */
-         /* init context for 2nd pass */
-         USHAReset(&context->shaContext, context->whichSha) ||
+  if (ret == shaSuccess) {
+    if (context->keyContext) {
+      /* resume from the cached state after the outer pad */
+      context->shaContext = context->keyContext->outerContext;
+    } else {
+      /* perform outer SHA */
+      /* init context for 2nd pass */
+      ret = USHAReset(&context->shaContext, context->whichSha) ||
 
-         /* start with outer pad */
-         USHAInput(&context->shaContext, context->k_opad,
-                   context->blockSize) ||
+            /* start with outer pad */
+            USHAInput(&context->shaContext, context->k_opad,
+                      context->blockSize);
+    }
+  }
 
+  ret = ret ||
          /* then results of 1st hash */
          USHAInput(&context->shaContext, digest, context->hashSize) ||
          /* finish up 2nd pass */
@@ -247,3 +256,120 @@ int hmacResult(HMACContext *context, uint8_t *digest)
   return context->Corrupted = ret;
 }
 
+/*
+ *  hmacKeySetup
+ *
+ *  Description:
+ *      This function will hash the inner and outer pads of a key once
+ *      and keep the resulting SHA states in keyContext, for use by
+ *      hmacKeyedReset() and hmacKeyed().  This saves two SHA
+ *      compressions, plus hashing the key if it is longer than the
+ *      block size, for every MAC computed with the key afterwards.
+ *
+ *  Parameters:
+ *      keyContext: [out]
+ *          The key context to set up.  It holds key material, so
+ *          clear it when the key is no longer needed.
+ *      whichSha: [in]
+ *          One of SHA1, SHA224, SHA256, SHA384, SHA512
+ *      key[ ]: [in]
+ *          The secret shared key.
+ *      key_len: [in]
+ *          The length of the secret shared key.
+ *
+ *  Returns:
+ *      sha Error Code.
+ *
+ */
+int hmacKeySetup(HMACKeyContext *keyContext, enum SHAversion whichSha,
+    const unsigned char *key, int key_len)
+{
+  HMACContext context;
+  int ret;
+
+  if (!keyContext) return shaNull;
+
+  ret = hmacReset(&context, whichSha, key, key_len);
+  if (ret == shaSuccess) {
+    keyContext->whichSha = whichSha;
+    keyContext->hashSize = context.hashSize;
+    keyContext->blockSize = context.blockSize;
+    keyContext->innerContext = context.shaContext;
+    ret = USHAReset(&keyContext->outerContext, whichSha) ||
+          USHAInput(&keyContext->outerContext, context.k_opad,
+                    context.blockSize);
+  }
+
+  /* the pads are the key in disguise */
+  memset(&context, 0, sizeof(context));
+  return keyContext->Corrupted = ret;
+}
+
+/*
+ *  hmacKeyedReset
+ *
+ *  Description:
+ *      This function will initialize the hmacContext for a new HMAC
+ *      message digest with a key prepared by hmacKeySetup().  It may
+ *      be called again on the same context once hmacResult() has
+ *      returned, to MAC the next message.
+ *
+ *  Parameters:
+ *      context: [in/out]
+ *          The context to reset.
+ *      keyContext: [in]
+ *          The key to use.  It is referenced, not copied, and must
+ *          remain valid until hmacResult() has returned.
+ *
+ *  Returns:
+ *      sha Error Code.
+ *
+ */
+int hmacKeyedReset(HMACContext *context,
+    const HMACKeyContext *keyContext)
+{
+  if (!context) return shaNull;
+  if (!keyContext) return context->Corrupted = shaNull;
+  if (keyContext->Corrupted) return context->Corrupted = keyContext->Corrupted;
+
+  context->whichSha = keyContext->whichSha;
+  context->hashSize = keyContext->hashSize;
+  context->blockSize = keyContext->blockSize;
+  context->shaContext = keyContext->innerContext;
+  context->keyContext = keyContext;
+  context->Computed = 0;
+  return context->Corrupted = shaSuccess;
+}
+
+/*
+ *  hmacKeyed
+ *
+ *  Description:
+ *      This function will compute an HMAC message digest with a key
+ *      prepared by hmacKeySetup().
+ *
+ *  Parameters:
+ *      keyContext: [in]
+ *          The key to use.
+ *      text[ ]: [in]
+ *          An array of octets representing the message.
+ *      text_len: [in]
+ *          The length of the message in text.
+ *      digest[ ]: [out]
+ *          Where the digest is to be returned.
+ *          NOTE: The length of the digest is determined by
+ *              the SHA the key was set up with.
+ *
+ *  Returns:
+ *      sha Error Code.
+ *
+ */
+int hmacKeyed(const HMACKeyContext *keyContext,
+    const unsigned char *text, int text_len,
+    uint8_t digest[USHAMaxHashSize])
+{
+  HMACContext context;
+  return hmacKeyedReset(&context, keyContext) ||
+         hmacInput(&context, text, text_len) ||
+         hmacResult(&context, digest);
+}
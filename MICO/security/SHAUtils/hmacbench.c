@@ -0,0 +1,221 @@
+/************************** hmacbench.c ************************/
+
+/*
+ *  Description:
+ *      Throughput of HMAC-SHA256 for short and medium messages, with
+ *      the pads hashed for every MAC (hmac()) and with the key set up
+ *      once (hmacKeyed()), after checking the latter against the RFC
+ *      4231 test cases.  Built on the host, or on a target whose C
+ *      library implements clock(); not part of the default build.
+ */
+
+#include "sha.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define HMACBENCH_SECONDS   1     /* time spent on each measurement */
+
+static const int hmacBenchSizes[] = { 16, 64, 256, 1024 };
+
+/*
+ *  HMAC-SHA256 test cases 1 to 7 of RFC 4231.  A key or data of
+ *  NULL stands for len bytes of fill; case 5 checks 128 bits only.
+ */
+static const struct {
+  const char *key, *data;
+  unsigned char keyFill, dataFill;
+  int keyLen, dataLen, macLen;
+  const char *mac;
+} hmacBenchVectors[] = {
+  { NULL, "Hi There", 0x0b, 0, 20, 8, 32,
+    "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7" },
+  { "Jefe", "what do ya want for nothing?", 0, 0, 4, 28, 32,
+    "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843" },
+  { NULL, NULL, 0xaa, 0xdd, 20, 50, 32,
+    "773ea91e36800e46854db8ebd09181a72959098b3ef8c122d9635514ced565fe" },
+  { "\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f\x10"
+    "\x11\x12\x13\x14\x15\x16\x17\x18\x19", NULL, 0, 0xcd, 25, 50, 32,
+    "82558a389a443c0ea4cc819899f2083a85f0faa3e578f8077a2e3ff46729665b" },
+  { NULL, "Test With Truncation", 0x0c, 0, 20, 20, 16,
+    "a3b6167473100ee06e0c796c2955552b" },
+  { NULL, "Test Using Larger Than Block-Size Key - Hash Key First",
+    0xaa, 0, 131, 54, 32,
+    "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54" },
+  { NULL, "This is a test using a larger than block-size key and a larger "
+    "than block-size data. The key needs to be hashed before being used "
+    "by the HMAC algorithm.", 0xaa, 0, 131, 152, 32,
+    "9b09ffa71b942fcb27635fbcd5b0e944bfdc63644f0713938a7f51535c3a35e2" },
+};
+
+/*
+ *  hmacBenchCheck
+ *
+ *  Description:
+ *      This helper function checks hmacKeySetup() against the RFC 4231
+ *      test cases, through hmacKeyed() and through hmacKeyedReset()
+ *      with the data split over two hmacInput() calls, twice on the
+ *      same HMACContext to cover its reuse after hmacResult().
+ *
+ *  Returns:
+ *      sha Error Code, or shaBadParam if a MAC is wrong.
+ *
+ */
+static int hmacBenchCheck(void)
+{
+  unsigned char key[131], data[152], mac[SHA256HashSize];
+  uint8_t digest[USHAMaxHashSize];
+  HMACKeyContext keyContext;
+  HMACContext context;
+  unsigned int i, j, pass, byte;
+  int ret = shaSuccess;
+
+  for (i = 0; i < sizeof(hmacBenchVectors) / sizeof(hmacBenchVectors[0]) &&
+       ret == shaSuccess; i++) {
+    int keyLen = hmacBenchVectors[i].keyLen;
+    int dataLen = hmacBenchVectors[i].dataLen;
+    int macLen = hmacBenchVectors[i].macLen;
+
+    if (hmacBenchVectors[i].key)
+      memcpy(key, hmacBenchVectors[i].key, keyLen);
+    else
+      memset(key, hmacBenchVectors[i].keyFill, keyLen);
+    if (hmacBenchVectors[i].data)
+      memcpy(data, hmacBenchVectors[i].data, dataLen);
+    else
+      memset(data, hmacBenchVectors[i].dataFill, dataLen);
+    for (j = 0; j < (unsigned int)macLen; j++) {
+      sscanf(hmacBenchVectors[i].mac + 2 * j, "%2x", &byte);
+      mac[j] = (unsigned char)byte;
+    }
+
+    ret = hmacKeySetup(&keyContext, SHA256, key, keyLen) ||
+          hmacKeyed(&keyContext, data, dataLen, digest);
+    if (ret == shaSuccess && memcmp(digest, mac, macLen) != 0)
+      ret = shaBadParam;
+
+    for (pass = 0; pass < 2 && ret == shaSuccess; pass++) {
+      memset(digest, 0, sizeof(digest));
+      ret = hmacKeyedReset(&context, &keyContext) ||
+            hmacInput(&context, data, dataLen / 3) ||
+            hmacInput(&context, data + dataLen / 3, dataLen - dataLen / 3) ||
+            hmacResult(&context, digest);
+      if (ret == shaSuccess && memcmp(digest, mac, macLen) != 0)
+        ret = shaBadParam;
+    }
+  }
+
+  memset(&keyContext, 0, sizeof(keyContext));
+  return ret;
+}
+
+/*
+ *  hmacBenchRun
+ *
+ *  Description:
+ *      This helper function computes MACs of a message for about
+ *      HMACBENCH_SECONDS and returns the number of MACs per second.
+ *
+ *  Parameters:
+ *      keyContext: [in]
+ *          The key for hmacKeyed(), or NULL to call hmac() with key.
+ *      key[ ]: [in]
+ *          The key for hmac().
+ *      msg[ ], msg_len: [in]
+ *          The message.
+ *      rate: [out]
+ *          MACs per second.
+ *
+ *  Returns:
+ *      sha Error Code.
+ *
+ */
+static int hmacBenchRun(const HMACKeyContext *keyContext,
+    const unsigned char *key, const unsigned char *msg, int msg_len,
+    unsigned long *rate)
+{
+  uint8_t digest[USHAMaxHashSize];
+  unsigned long count = 0;
+  clock_t start = clock(), elapsed;
+  int ret;
+
+  do {
+    ret = keyContext ? hmacKeyed(keyContext, msg, msg_len, digest) :
+                       hmac(SHA256, msg, msg_len, key, SHA256HashSize,
+                            digest);
+    if (ret != shaSuccess) return ret;
+    count++;
+    elapsed = clock() - start;
+  } while (elapsed < HMACBENCH_SECONDS * CLOCKS_PER_SEC);
+
+  *rate = (unsigned long)((double)count * CLOCKS_PER_SEC / elapsed);
+  return shaSuccess;
+}
+
+/*
+ *  hmacBench
+ *
+ *  Description:
+ *      This function checks the keyed interface against RFC 4231, then
+ *      measures hmac() and hmacKeyed() with a 32 byte HMAC-SHA256 key
+ *      for each message size in hmacBenchSizes, and checks that both
+ *      give the same MAC.
+ *
+ *  Parameters:
+ *      print: [in]
+ *          Print MACs per second for each size to stdout if non-zero.
+ *
+ *  Returns:
+ *      sha Error Code, or shaBadParam if a test case fails or the two
+ *      MACs differ.
+ *
+ */
+int hmacBench(int print)
+{
+  static unsigned char msg[1024];
+  unsigned char key[SHA256HashSize];
+  uint8_t d1[USHAMaxHashSize], d2[USHAMaxHashSize];
+  HMACKeyContext keyContext;
+  unsigned long plain, keyed;
+  unsigned int i;
+  int ret;
+
+  ret = hmacBenchCheck();
+  if (print)
+    printf("HMAC-SHA256 RFC 4231 test cases: %s\n",
+           ret == shaSuccess ? "passed" : "FAILED");
+  if (ret != shaSuccess) return ret;
+
+  for (i = 0; i < sizeof(key); i++) key[i] = (unsigned char)(0x0b + i);
+  for (i = 0; i < sizeof(msg); i++) msg[i] = (unsigned char)i;
+
+  ret = hmacKeySetup(&keyContext, SHA256, key, sizeof(key));
+  if (ret != shaSuccess) return ret;
+
+  if (print)
+    printf("HMAC-SHA256   bytes     hmac/s  hmacKeyed/s\n");
+
+  for (i = 0; i < sizeof(hmacBenchSizes) / sizeof(hmacBenchSizes[0]);
+       i++) {
+    int len = hmacBenchSizes[i];
+
+    ret = hmac(SHA256, msg, len, key, sizeof(key), d1) ||
+          hmacKeyed(&keyContext, msg, len, d2);
+    if (ret != shaSuccess) break;
+    if (memcmp(d1, d2, SHA256HashSize) != 0) {
+      ret = shaBadParam;
+      break;
+    }
+
+    ret = hmacBenchRun(0, key, msg, len, &plain);
+    if (ret != shaSuccess) break;
+    ret = hmacBenchRun(&keyContext, key, msg, len, &keyed);
+    if (ret != shaSuccess) break;
+
+    if (print)
+      printf("            %7d %10lu %12lu\n", len, plain, keyed);
+  }
+
+  memset(&keyContext, 0, sizeof(keyContext));
+  return ret;
+}
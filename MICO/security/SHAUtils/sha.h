@@ -60,7 +60,7 @@
  *              SHA-512         64 byte / 512 bit
  *
  *  Compilation Note:
- *    These files may be compiled with two options:
+ *    These files may be compiled with three options:
  *        USE_32BIT_ONLY - use 32-bit arithmetic only, for systems
  *                         without 64-bit integers
  *
@@ -68,6 +68,10 @@
  *                         and SHA_Maj() macros that are equivalent
  *                         and potentially faster on many systems
  *
+ *        USE_SMALL_SHA256 - use the plain round loop for SHA-224 and
+ *                         SHA-256 instead of the unrolled one, to
+ *                         save code space
+ *
  */
 
 #include <stdint.h>
@@ -217,11 +221,28 @@ typedef struct HMACContext {
     USHAContext shaContext;     /* SHA context */
     unsigned char k_opad[USHA_Max_Message_Block_Size];
                         /* outer padding - key XORd with opad */
+    const struct HMACKeyContext *keyContext;
+                        /* key set by hmacKeyedReset, else NULL */
     int Computed;               /* Is the MAC computed? */
     int Corrupted;              /* Cumulative corruption code */
 
 } HMACContext;
 
+/*
+ *  This structure will hold an HMAC key as the SHA states after
+ *  hashing the inner and outer pads, so that each MAC computed with
+ *  it starts from those states instead of hashing both pads again.
+ *  It is as secret as the key itself.
+ */
+typedef struct HMACKeyContext {
+    SHAversion whichSha;        /* which SHA is being used */
+    int hashSize;               /* hash size of SHA being used */
+    int blockSize;              /* block size of SHA being used */
+    USHAContext innerContext;   /* SHA state after key XOR ipad */
+    USHAContext outerContext;   /* SHA state after key XOR opad */
+    int Corrupted;              /* Cumulative corruption code */
+} HMACKeyContext;
+
 /*
  *  This structure will hold context information for the HKDF
  *  extract-and-expand Key Derivation Functions.
@@ -328,6 +349,29 @@ extern int hmacFinalBits(HMACContext *context, uint8_t bits,
 extern int hmacResult(HMACContext *context,
                       uint8_t digest[USHAMaxHashSize]);
 
+/*
+ * HMAC with a key that is used for many messages, RFC 2104,
+ * for all SHAs.
+ * hmacKeySetup hashes the pads once; each MAC is then started with
+ * hmacKeyedReset, which may be called again on the same HMACContext
+ * after hmacResult, and continued with hmacInput and hmacResult.
+ * The HMACKeyContext must stay valid until hmacResult returns.
+ */
+extern int hmacKeySetup(HMACKeyContext *keyContext,
+                        enum SHAversion whichSha,
+                        const unsigned char *key, int key_len);
+extern int hmacKeyedReset(HMACContext *context,
+                          const HMACKeyContext *keyContext);
+extern int hmacKeyed(const HMACKeyContext *keyContext,
+                     const unsigned char *text, int text_len,
+                     uint8_t digest[USHAMaxHashSize]);
+
+/*
+ * Throughput of hmac() and hmacKeyed() with HMAC-SHA256 for 16 to
+ * 1024 byte messages (hmacbench.c, not built by default).
+ */
+extern int hmacBench(int print);
+
 /*
  * HKDF HMAC-based Extract-and-Expand Key Derivation Function,
  * RFC 5869, for all SHAs.
@@ -42,6 +42,7 @@
 
 #include "sha.h"
 #include "sha-private.h"
+#include <string.h>
 
 /* Define the SHA shift, rotate left, and rotate right macros */
 #define SHA256_SHR(bits,word)      ((word) >> (bits))
@@ -74,6 +75,8 @@ static uint32_t addTemp;
 /* Local Function Prototypes */
 static int SHA224_256Reset(SHA256Context *context, uint32_t *H0);
 static void SHA224_256ProcessMessageBlock(SHA256Context *context);
+static void SHA224_256ProcessBlock(uint32_t Intermediate_Hash[ ],
+  const uint8_t *Message_Block);
 static void SHA224_256Finalize(SHA256Context *context,
   uint8_t Pad_Byte);
 static void SHA224_256PadMessage(SHA256Context *context,
@@ -235,15 +238,33 @@ int SHA256Input(SHA256Context *context, const uint8_t *message_array,
   if (context->Computed) return context->Corrupted = shaStateError;
   if (context->Corrupted) return context->Corrupted;
 
-  while (length--) {
-    context->Message_Block[context->Message_Block_Index++] =
-            *message_array;
-
-    if ((SHA224_256AddLength(context, 8) == shaSuccess) &&
-      (context->Message_Block_Index == SHA256_Message_Block_Size))
+  while (length) {
+    unsigned int n;
+
+    /* whole blocks are hashed straight from the caller's buffer */
+    if ((context->Message_Block_Index == 0) &&
+        (length >= SHA256_Message_Block_Size)) {
+      if (SHA224_256AddLength(context, 8 * SHA256_Message_Block_Size)
+          != shaSuccess)
+        break;
+      SHA224_256ProcessBlock(context->Intermediate_Hash, message_array);
+      message_array += SHA256_Message_Block_Size;
+      length -= SHA256_Message_Block_Size;
+      continue;
+    }
+
+    n = SHA256_Message_Block_Size - context->Message_Block_Index;
+    if (n > length) n = length;
+    memcpy(&context->Message_Block[context->Message_Block_Index],
+           message_array, n);
+    context->Message_Block_Index += n;
+    message_array += n;
+    length -= n;
+
+    if (SHA224_256AddLength(context, 8 * n) != shaSuccess)
+      break;
+    if (context->Message_Block_Index == SHA256_Message_Block_Size)
       SHA224_256ProcessMessageBlock(context);
-
-    message_array++;
   }
 
   return context->Corrupted;
@@ -374,58 +395,124 @@ static int SHA224_256Reset(SHA256Context *context, uint32_t *H0)
  *
  * Returns:
  *   Nothing.
+ */
+static void SHA224_256ProcessMessageBlock(SHA256Context *context)
+{
+  SHA224_256ProcessBlock(context->Intermediate_Hash,
+                         context->Message_Block);
+  context->Message_Block_Index = 0;
+}
+
+/*
+ * SHA224_256ProcessBlock
+ *
+ * Description:
+ *   This helper function is the SHA-224/SHA-256 compression
+ *   function: it folds one 512-bit block into the intermediate hash.
+ *   The rounds are unrolled eight at a time and the message schedule
+ *   is kept in a rolling 16 word window, which suits the 16 register
+ *   Cortex-M cores.  Compile with USE_SMALL_SHA256 for the plain
+ *   loop of FIPS 180-3 section 6.2.2, which is smaller but slower.
+ *
+ * Parameters:
+ *   Intermediate_Hash[ ]: [in/out]
+ *     The eight word hash value to update.
+ *   Message_Block: [in]
+ *     The 64 octets to process.  Need not be aligned.
+ *
+ * Returns:
+ *   Nothing.
  *
  * Comments:
  *   Many of the variable names in this code, especially the
  *   single character names, were used because those were the
  *   names used in the Secure Hash Standard.
  */
-static void SHA224_256ProcessMessageBlock(SHA256Context *context)
+
+/* Constants defined in FIPS 180-3, section 4.2.2 */
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b,
+    0x59f111f1, 0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01,
+    0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7,
+    0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152,
+    0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
+    0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819,
+    0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116, 0x1e376c08,
+    0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f,
+    0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#ifndef USE_SMALL_SHA256
+/* Word t of the message schedule, t >= 16, in the 16 word window */
+#define SHA256_W(t)                                          \
+  (W[(t) & 15] += SHA256_sigma1(W[((t) - 2) & 15]) +         \
+                  W[((t) - 7) & 15] + SHA256_sigma0(W[((t) - 15) & 15]))
+
+/*
+ * One round, with the working variables renamed instead of moved:
+ * on return h holds the new A and d the new E.
+ */
+#define SHA256_ROUND(a,b,c,d,e,f,g,h,t,w)                    \
+  do {                                                       \
+    h += SHA256_SIGMA1(e) + SHA_Ch(e,f,g) + SHA256_K[t] + (w); \
+    d += h;                                                  \
+    h += SHA256_SIGMA0(a) + SHA_Maj(a,b,c);                  \
+  } while (0)
+
+#define SHA256_ROUNDS8(t,W0,W1,W2,W3,W4,W5,W6,W7)            \
+  do {                                                       \
+    SHA256_ROUND(A,B,C,D,E,F,G,H,(t)    ,W0);                \
+    SHA256_ROUND(H,A,B,C,D,E,F,G,(t) + 1,W1);                \
+    SHA256_ROUND(G,H,A,B,C,D,E,F,(t) + 2,W2);                \
+    SHA256_ROUND(F,G,H,A,B,C,D,E,(t) + 3,W3);                \
+    SHA256_ROUND(E,F,G,H,A,B,C,D,(t) + 4,W4);                \
+    SHA256_ROUND(D,E,F,G,H,A,B,C,(t) + 5,W5);                \
+    SHA256_ROUND(C,D,E,F,G,H,A,B,(t) + 6,W6);                \
+    SHA256_ROUND(B,C,D,E,F,G,H,A,(t) + 7,W7);                \
+  } while (0)
+#endif /* USE_SMALL_SHA256 */
+
+static void SHA224_256ProcessBlock(uint32_t Intermediate_Hash[ ],
+    const uint8_t *Message_Block)
 {
-  /* Constants defined in FIPS 180-3, section 4.2.2 */
-  static const uint32_t K[64] = {
-      0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b,
-      0x59f111f1, 0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01,
-      0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7,
-      0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
-      0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152,
-      0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
-      0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
-      0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
-      0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819,
-      0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116, 0x1e376c08,
-      0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f,
-      0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
-      0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
-  };
   int        t, t4;                   /* Loop counter */
+#ifdef USE_SMALL_SHA256
   uint32_t   temp1, temp2;            /* Temporary word value */
   uint32_t   W[64];                   /* Word sequence */
+#else /* !USE_SMALL_SHA256 */
+  uint32_t   W[16];                   /* Word sequence window */
+#endif /* USE_SMALL_SHA256 */
   uint32_t   A, B, C, D, E, F, G, H;  /* Word buffers */
 
   /*
    * Initialize the first 16 words in the array W
    */
   for (t = t4 = 0; t < 16; t++, t4 += 4)
-    W[t] = (((uint32_t)context->Message_Block[t4]) << 24) |
-           (((uint32_t)context->Message_Block[t4 + 1]) << 16) |
-           (((uint32_t)context->Message_Block[t4 + 2]) << 8) |
-           (((uint32_t)context->Message_Block[t4 + 3]));
+    W[t] = (((uint32_t)Message_Block[t4]) << 24) |
+           (((uint32_t)Message_Block[t4 + 1]) << 16) |
+           (((uint32_t)Message_Block[t4 + 2]) << 8) |
+           (((uint32_t)Message_Block[t4 + 3]));
+
+  A = Intermediate_Hash[0];
+  B = Intermediate_Hash[1];
+  C = Intermediate_Hash[2];
+  D = Intermediate_Hash[3];
+  E = Intermediate_Hash[4];
+  F = Intermediate_Hash[5];
+  G = Intermediate_Hash[6];
+  H = Intermediate_Hash[7];
+
+#ifdef USE_SMALL_SHA256
   for (t = 16; t < 64; t++)
     W[t] = SHA256_sigma1(W[t-2]) + W[t-7] +
         SHA256_sigma0(W[t-15]) + W[t-16];
 
-  A = context->Intermediate_Hash[0];
-  B = context->Intermediate_Hash[1];
-  C = context->Intermediate_Hash[2];
-  D = context->Intermediate_Hash[3];
-  E = context->Intermediate_Hash[4];
-  F = context->Intermediate_Hash[5];
-  G = context->Intermediate_Hash[6];
-  H = context->Intermediate_Hash[7];
-
   for (t = 0; t < 64; t++) {
-    temp1 = H + SHA256_SIGMA1(E) + SHA_Ch(E,F,G) + K[t] + W[t];
+    temp1 = H + SHA256_SIGMA1(E) + SHA_Ch(E,F,G) + SHA256_K[t] + W[t];
     temp2 = SHA256_SIGMA0(A) + SHA_Maj(A,B,C);
     H = G;
     G = F;
@@ -436,17 +523,23 @@ static void SHA224_256ProcessMessageBlock(SHA256Context *context)
     B = A;
     A = temp1 + temp2;
   }
-
-  context->Intermediate_Hash[0] += A;
-  context->Intermediate_Hash[1] += B;
-  context->Intermediate_Hash[2] += C;
-  context->Intermediate_Hash[3] += D;
-  context->Intermediate_Hash[4] += E;
-  context->Intermediate_Hash[5] += F;
-  context->Intermediate_Hash[6] += G;
-  context->Intermediate_Hash[7] += H;
-
-  context->Message_Block_Index = 0;
+#else /* !USE_SMALL_SHA256 */
+  SHA256_ROUNDS8(0, W[0], W[1], W[2], W[3], W[4], W[5], W[6], W[7]);
+  SHA256_ROUNDS8(8, W[8], W[9], W[10], W[11], W[12], W[13], W[14], W[15]);
+  for (t = 16; t < 64; t += 8)
+    SHA256_ROUNDS8(t, SHA256_W(t), SHA256_W(t + 1), SHA256_W(t + 2),
+                   SHA256_W(t + 3), SHA256_W(t + 4), SHA256_W(t + 5),
+                   SHA256_W(t + 6), SHA256_W(t + 7));
+#endif /* USE_SMALL_SHA256 */
+
+  Intermediate_Hash[0] += A;
+  Intermediate_Hash[1] += B;
+  Intermediate_Hash[2] += C;
+  Intermediate_Hash[3] += D;
+  Intermediate_Hash[4] += E;
+  Intermediate_Hash[5] += F;
+  Intermediate_Hash[6] += G;
+  Intermediate_Hash[7] += H;
 }
 
 /*
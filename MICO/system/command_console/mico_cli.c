@@ -373,6 +373,7 @@ static void tftp_Command(char *pcWriteBuffer, int xWriteBufferLen,int argc, char
     uint32_t ip;
     mico_partition_t parttype;
     mico_logic_partition_t *partition;
+    mico_Context_t *context;
     
     if (argc != 7) {
         goto WRONGCMD;
@@ -406,6 +407,12 @@ static void tftp_Command(char *pcWriteBuffer, int xWriteBufferLen,int argc, char
     } else { // get
         cmd_printf("tftp get from %s, filenmae %s. to %s flash, address 0x%x, len %d\r\n", argv[1], cmdinfo.filename,
             partition->partition_description, cmdinfo.flashaddr, cmdinfo.filelen);
+        if (parttype == MICO_PARTITION_OTA_TEMP) {
+            context = mico_system_context_get( );
+            mico_rtos_lock_mutex( &context->flashContentInRam_mutex );
+            mico_system_ota_partition_dirty( context, cmdinfo.flashaddr + cmdinfo.filelen );
+            mico_rtos_unlock_mutex( &context->flashContentInRam_mutex );
+        }
         tget(&cmdinfo, ip);
     }
     return;
@@ -628,10 +635,29 @@ static void micodebug_Command(char *pcWriteBuffer, int xWriteBufferLen,int argc,
     cmd_printf("Disable MICO debug\r\n");
     mico_debug_enabled = 0;
   }
+#if MICO_DEFERRED_LOG && !defined(MICO_DISABLE_STDIO)
+  else if (!strcasecmp(argv[1], "raw")) {
+    cmd_printf("MICO debug log sent as binary records\r\n");
+    mico_system_log_set_raw(true);
+  } else if (!strcasecmp(argv[1], "text")) {
+    cmd_printf("MICO debug log sent as text\r\n");
+    mico_system_log_set_raw(false);
+  } else if (!strcasecmp(argv[1], "stat")) {
+    mico_system_log_stats_t stats;
+    mico_system_log_get_stats(&stats);
+    cmd_printf("written %u, dropped %u, truncated %u, max used %u bytes\r\n",
+               (unsigned int)stats.written, (unsigned int)stats.dropped,
+               (unsigned int)stats.truncated, (unsigned int)stats.max_used);
+  }
+#endif
 }
 
 static const struct cli_command user_clis[1] = {
+#if MICO_DEFERRED_LOG && !defined(MICO_DISABLE_STDIO)
+  {"micodebug", "micodebug on/off/raw/text/stat", micodebug_Command},
+#else
   {"micodebug", "micodebug on/off", micodebug_Command},
+#endif
 };
 #endif
 
@@ -48,6 +48,16 @@
 
 #define kMIMEType_MXCHIP_OTA    "application/ota-stream"
 
+/* Block size of the arenas that hold the report and the received config */
+#ifndef CONFIG_SERVER_JSON_ARENA_SIZE
+#define CONFIG_SERVER_JSON_ARENA_SIZE   1024
+#endif
+
+/* The report is streamed to the socket through a buffer of this size */
+#ifndef CONFIG_SERVER_JSON_CHUNK_SIZE
+#define CONFIG_SERVER_JSON_CHUNK_SIZE   256
+#endif
+
 typedef struct _configContext_t{
   uint32_t offset;
   bool     isFlashLocked;
@@ -336,6 +346,8 @@ static OSStatus onReceivedData(struct _HTTPHeader_t * inHeader, uint32_t inPos,
        CRC16_Init( &context->crc16_contex );
        mico_rtos_lock_mutex(&Context->flashContentInRam_mutex); //We are write the Flash content, no other write is possible
        context->isFlashLocked = true;
+       err = mico_system_ota_partition_dirty( Context, (uint32_t)inHeader->contentLength );
+       require_noerr(err, flashErrExit);
        err = MicoFlashErase( MICO_PARTITION_OTA_TEMP, 0x0, ota_partition->partition_length);
        require_noerr(err, flashErrExit);
        err = MicoFlashWrite( MICO_PARTITION_OTA_TEMP, &context->offset, (uint8_t *)inData, inLen);
@@ -359,6 +371,11 @@ flashErrExit:
   return err;
 }
 
+static int _config_server_json_sink(void *ctx, const char *buf, int len)
+{
+  return SocketSend( *(int *)ctx, (const uint8_t *)buf, len );
+}
+
 static void onClearHTTPHeader(struct _HTTPHeader_t * inHeader, void * inUserContext )
 {
   UNUSED_PARAMETER(inHeader);
@@ -373,10 +390,12 @@ static void onClearHTTPHeader(struct _HTTPHeader_t * inHeader, void * inUserCont
 OSStatus _LocalConfigRespondInComingMessage(int fd, HTTPHeader_t* inHeader, mico_Context_t * const inContext)
 {
   OSStatus err = kUnknownErr;
-  const char *  json_str;
+  int json_len;
+  char *json_chunk = NULL;
   uint8_t *httpResponse = NULL;
   size_t httpResponseLen = 0;
   json_object* report = NULL, *config = NULL;
+  struct json_arena *arena;
   bool need_reboot = false;
   uint16_t crc;
   configContext_t *http_context = (configContext_t *)inHeader->userContext;
@@ -395,23 +414,27 @@ OSStatus _LocalConfigRespondInComingMessage(int fd, HTTPHeader_t* inHeader, mico
                                           inContext->micoStatus.mac[9],  inContext->micoStatus.mac[10], 
                                           inContext->micoStatus.mac[12], inContext->micoStatus.mac[13],
                                           inContext->micoStatus.mac[15], inContext->micoStatus.mac[16]);
-    report = json_object_new_object();
+    /* The whole report is built in one arena and released with its root */
+    arena = json_arena_new(CONFIG_SERVER_JSON_ARENA_SIZE);
+    report = json_object_new_object_in(arena);
+    if(!report) json_arena_free(arena);
     require_action(report, exit, err = kNoMemoryErr);
+    arena = json_object_get_arena(report);
 
-    sectors = json_object_new_array();
+    sectors = json_object_new_array_in(arena);
     require( sectors, exit );
 
-    json_object_object_add(report, "T", json_object_new_string("Current Configuration"));
-    json_object_object_add(report, "N", json_object_new_string(name));
+    json_object_object_add(report, "T", json_object_new_string_in(arena, "Current Configuration"));
+    json_object_object_add(report, "N", json_object_new_string_in(arena, name));
     json_object_object_add(report, "C", sectors);
 
-    json_object_object_add(report, "PO", json_object_new_string(PROTOCOL));
-    json_object_object_add(report, "HD", json_object_new_string(HARDWARE_REVISION));
-    json_object_object_add(report, "FW", json_object_new_string(FIRMWARE_REVISION));
-    json_object_object_add(report, "RF", json_object_new_string(inContext->micoStatus.rf_version));
+    json_object_object_add(report, "PO", json_object_new_string_in(arena, PROTOCOL));
+    json_object_object_add(report, "HD", json_object_new_string_in(arena, HARDWARE_REVISION));
+    json_object_object_add(report, "FW", json_object_new_string_in(arena, FIRMWARE_REVISION));
+    json_object_object_add(report, "RF", json_object_new_string_in(arena, inContext->micoStatus.rf_version));
 
     /*Sector 1*/
-    sector = json_object_new_array();
+    sector = json_object_new_array_in(arena);
     require( sector, exit );
     err = config_server_create_sector(sectors, "MICO SYSTEM",    sector);
     require_noerr(err, exit);
@@ -451,7 +474,7 @@ OSStatus _LocalConfigRespondInComingMessage(int fd, HTTPHeader_t* inHeader, mico
       require_noerr(err, exit);
 
     /*Sector 2*/
-    sector = json_object_new_array();
+    sector = json_object_new_array_in(arena);
     require( sector, exit );
     err = config_server_create_sector(sectors, "APPLICATION",    sector);
     require_noerr(err, exit);
@@ -460,15 +483,18 @@ OSStatus _LocalConfigRespondInComingMessage(int fd, HTTPHeader_t* inHeader, mico
 
     mico_rtos_unlock_mutex(&inContext->flashContentInRam_mutex);
 
-    json_str = json_object_to_json_string(report);
-    require_action( json_str, exit, err = kNoMemoryErr );
-    config_log("Send config object=%s", json_str);
-    err =  CreateSimpleHTTPMessageNoCopy( kMIMEType_JSON, strlen(json_str), &httpResponse, &httpResponseLen );
+    /* Stream the report instead of rendering it into one string first */
+    json_len = json_object_to_json_length(report);
+    require_action( json_len >= 0, exit, err = kNoMemoryErr );
+    json_chunk = malloc( CONFIG_SERVER_JSON_CHUNK_SIZE );
+    require_action( json_chunk, exit, err = kNoMemoryErr );
+    config_log("Send config object, %d bytes", json_len);
+    err =  CreateSimpleHTTPMessageNoCopy( kMIMEType_JSON, json_len, &httpResponse, &httpResponseLen );
     require_noerr( err, exit );
     require( httpResponse, exit );
     err = SocketSend( fd, httpResponse, httpResponseLen );
     require_noerr( err, exit );
-    err = SocketSend( fd, (uint8_t *)json_str, strlen(json_str) );
+    err = json_object_to_sink( report, json_chunk, CONFIG_SERVER_JSON_CHUNK_SIZE, _config_server_json_sink, &fd );
     require_noerr( err, exit );
     config_log("Current configuration sent");
     goto exit;
@@ -483,7 +509,7 @@ OSStatus _LocalConfigRespondInComingMessage(int fd, HTTPHeader_t* inHeader, mico
       err = SocketSend( fd, httpResponse, httpResponseLen );
       require_noerr( err, exit );
 
-      config = json_tokener_parse(inHeader->extraDataPtr);
+      config = json_tokener_parse_arena(inHeader->extraDataPtr, CONFIG_SERVER_JSON_ARENA_SIZE);
       require_action(config, exit, err = kUnknownErr);
       config_log("Recv config object=%s", json_object_to_json_string(config));
       mico_rtos_lock_mutex(&inContext->flashContentInRam_mutex);
@@ -534,6 +560,7 @@ OSStatus _LocalConfigRespondInComingMessage(int fd, HTTPHeader_t* inHeader, mico
       mico_rtos_unlock_mutex(&inContext->flashContentInRam_mutex);
 
       json_object_put(config);
+      config = NULL;
 
       inContext->flashContentInRam.micoSystemConfig.configured = allConfigured;
       mico_system_context_update( inContext );
@@ -593,6 +620,7 @@ OSStatus _LocalConfigRespondInComingMessage(int fd, HTTPHeader_t* inHeader, mico
   if(inHeader->persistent == false)  //Return an err to close socket and exit the current thread
     err = kConnectionErr;
   if(httpResponse)  free(httpResponse);
+  if(json_chunk)    free(json_chunk);
   if(report)        json_object_put(report);
   if(config)        json_object_put(config);
 
@@ -360,54 +360,79 @@ exit:
 OSStatus ConfigIncommingJsonMessageUAP( const uint8_t *input, size_t size )
 {
   OSStatus err = kNoErr;
-  json_object *new_obj;
-  char *input_str = NULL;
+  struct json_pull pull;
+  enum json_pull_event ev;
+  char key[16];
+  char value[maxKeyLen + 1];
+  mico_sys_config_t config;
+  uint32_t identifier = easylinkIndentifier;
   system_log_trace();
   mico_Context_t *inContext = mico_system_context_get();
   inContext->flashContentInRam.micoSystemConfig.easyLinkByPass = EASYLINK_BYPASS_NO;
 
-  input_str = calloc(size+1, sizeof(char));
-  require_action(input_str, exit, err = kNoMemoryErr);
+  system_log("Recv config object=%.*s", (int)size, input);
+
+  /* Values go to a copy of the config, which is only written back once the
+     whole message has parsed, so a malformed message changes nothing */
+  mico_rtos_lock_mutex(&inContext->flashContentInRam_mutex);
+  memcpy(&config, &inContext->flashContentInRam.micoSystemConfig, sizeof(config));
+  mico_rtos_unlock_mutex(&inContext->flashContentInRam_mutex);
+
+  /* Walk the top level keys in place, no copy of the input and no tree */
+  key[0] = 0x0;
+  json_pull_init( &pull );
+  json_pull_feed( &pull, (const char *)input, size );
+  while( ( ev = json_pull_next( &pull ) ) != json_pull_end ) {
+    if( ev == json_pull_need_more ) {
+      json_pull_feed( &pull, NULL, 0 );
+      continue;
+    }
+    require_action( ev != json_pull_error, exit, err = kUnknownErr );
+    if( json_pull_depth( &pull ) != 1 || ev < json_pull_key ) continue;
+    if( ev == json_pull_key ) {
+      json_pull_get_string( &pull, key, sizeof(key) );
+      continue;
+    }
+
+    if( ev == json_pull_string || ev == json_pull_number )
+      json_pull_get_string( &pull, value, sizeof(value) );
+    else
+      strcpy( value, ev == json_pull_true ? "true" : ev == json_pull_false ? "false" : "" );
 
-  memcpy(input_str, input, size);
-  system_log("Recv config object=%s", input_str);
-  new_obj = json_tokener_parse(input_str);
-  require_action(new_obj, exit, err = kUnknownErr);
-  
-  json_object_object_foreach(new_obj, key, val) {
     if(!strcmp(key, "SSID")){
-      strncpy(inContext->flashContentInRam.micoSystemConfig.ssid, json_object_get_string(val), maxSsidLen);
-      inContext->flashContentInRam.micoSystemConfig.channel = 0;
-      memset(inContext->flashContentInRam.micoSystemConfig.bssid, 0x0, 6);
-      inContext->flashContentInRam.micoSystemConfig.security = SECURITY_TYPE_AUTO;
-      memcpy(inContext->flashContentInRam.micoSystemConfig.key, inContext->flashContentInRam.micoSystemConfig.user_key, maxKeyLen);
-      inContext->flashContentInRam.micoSystemConfig.keyLength = inContext->flashContentInRam.micoSystemConfig.user_keyLength;
+      strncpy(config.ssid, value, maxSsidLen);
+      config.channel = 0;
+      memset(config.bssid, 0x0, 6);
+      config.security = SECURITY_TYPE_AUTO;
+      memcpy(config.key, config.user_key, maxKeyLen);
+      config.keyLength = config.user_keyLength;
     }else if(!strcmp(key, "PASSWORD")){
-      inContext->flashContentInRam.micoSystemConfig.security = SECURITY_TYPE_AUTO;
-      strncpy(inContext->flashContentInRam.micoSystemConfig.key, json_object_get_string(val), maxKeyLen);
-      strncpy(inContext->flashContentInRam.micoSystemConfig.user_key, json_object_get_string(val), maxKeyLen);
-      inContext->flashContentInRam.micoSystemConfig.keyLength = strlen(inContext->flashContentInRam.micoSystemConfig.key);
-      inContext->flashContentInRam.micoSystemConfig.user_keyLength = strlen(inContext->flashContentInRam.micoSystemConfig.key);
-      memcpy(inContext->flashContentInRam.micoSystemConfig.key, inContext->flashContentInRam.micoSystemConfig.user_key, maxKeyLen);
-      inContext->flashContentInRam.micoSystemConfig.keyLength = inContext->flashContentInRam.micoSystemConfig.user_keyLength;
+      config.security = SECURITY_TYPE_AUTO;
+      strncpy(config.key, value, maxKeyLen);
+      strncpy(config.user_key, value, maxKeyLen);
+      config.keyLength = strlen(value) < maxKeyLen ? strlen(value) : maxKeyLen;
+      config.user_keyLength = config.keyLength;
     }else if(!strcmp(key, "DHCP")){
-      inContext->flashContentInRam.micoSystemConfig.dhcpEnable   = json_object_get_boolean(val);
+      config.dhcpEnable   = json_pull_get_boolean(&pull);
     }else if(!strcmp(key, "IDENTIFIER")){
-      easylinkIndentifier = (uint32_t)json_object_get_int(val);
+      identifier = (uint32_t)json_pull_get_int64(&pull);
     }else if(!strcmp(key, "IP")){
-      strncpy(inContext->flashContentInRam.micoSystemConfig.localIp, json_object_get_string(val), maxIpLen);
+      strncpy(config.localIp, value, maxIpLen);
     }else if(!strcmp(key, "NETMASK")){
-      strncpy(inContext->flashContentInRam.micoSystemConfig.netMask, json_object_get_string(val), maxIpLen);
+      strncpy(config.netMask, value, maxIpLen);
     }else if(!strcmp(key, "GATEWAY")){
-      strncpy(inContext->flashContentInRam.micoSystemConfig.gateWay, json_object_get_string(val), maxIpLen);
+      strncpy(config.gateWay, value, maxIpLen);
     }else if(!strcmp(key, "DNS1")){
-      strncpy(inContext->flashContentInRam.micoSystemConfig.dnsServer, json_object_get_string(val), maxIpLen);
+      strncpy(config.dnsServer, value, maxIpLen);
     }
   }
-  json_object_put(new_obj);
+
+  mico_rtos_lock_mutex(&inContext->flashContentInRam_mutex);
+  memcpy(&inContext->flashContentInRam.micoSystemConfig, &config, sizeof(config));
+  mico_rtos_unlock_mutex(&inContext->flashContentInRam_mutex);
+  easylinkIndentifier = identifier;
 
 exit:
-  if(input_str) free(input_str);
   return err; 
 }
 
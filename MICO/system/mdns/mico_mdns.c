@@ -34,20 +34,6 @@ typedef enum{
   RECORD_NORMAL,
 } mdns_record_state_t;
 
-typedef struct
-{
-  char*               hostname;
-  char*               instance_name;
-  char*               service_name;
-  char*               txt_att;
-  char                instance_name_suffix[4];
-  WiFi_Interface      interface;
-  uint32_t            ttl;
-  uint16_t            port;
-  uint8_t             count_down;
-  mdns_record_state_t state;
-} dns_sd_service_record_t;
-
 #define APP_Available_Offset               0
 #define Support_TLV_Config_Offset          2
 
@@ -56,6 +42,25 @@ typedef struct
 
 
 #define SERVICE_QUERY_NAME             "_services._dns-sd._udp.local."
+#define SERVICE_QUERY_TTL              1500
+
+#define MDNS_PORT                      5353
+
+/* Largest response, answers that do not fit go into a second packet */
+#ifndef MDNS_MESSAGE_SIZE
+#define MDNS_MESSAGE_SIZE              1024
+#endif
+
+/* Names already in a message that later names may point to */
+#define MDNS_COMPRESS_MAX              24
+
+/* RFC 6762 6: a record is multicast at most once per second */
+#define MDNS_MULTICAST_INTERVAL        1000
+
+/* RFC 6762 6.7: TTL of answers to legacy unicast queries */
+#define MDNS_LEGACY_UNICAST_TTL        10
+
+#define MDNS_QU_BIT                    0x8000
 
 //#define mdns_utils_log(M, ...) custom_log("mDNS Utils", M, ##__VA_ARGS__)
 //#define mdns_utils_log_trace() custom_log_trace("mDNS Utils")
@@ -63,26 +68,49 @@ typedef struct
 #define mdns_utils_log(M, ...)
 #define mdns_utils_log_trace()
 
+/* The records each service contributes to a response */
+enum
+{
+  MDNS_RR_META,         /* _services._dns-sd._udp.local. PTR service */
+  MDNS_RR_PTR,          /* service PTR instance */
+  MDNS_RR_SRV,
+  MDNS_RR_TXT,
+  MDNS_RR_A,
+  MDNS_RR_KINDS
+};
+
+#define MDNS_RR_BIT(kind)              ( 1 << (kind) )
+
+typedef struct
+{
+  char*               hostname;
+  char*               instance_name;
+  char*               service_name;
+  char*               txt_att;
+  WiFi_Interface      interface;
+  uint32_t            ttl;
+  uint16_t            port;
+  uint8_t             count_down;
+  mdns_record_state_t state;
+  uint32_t            last_multicast[MDNS_RR_KINDS];
+} dns_sd_service_record_t;
+
+/* A response under construction */
+typedef struct
+{
+  dns_message_header_t* header;
+  uint8_t*              iter;
+  uint8_t*              end;
+  uint16_t              question_count;
+  uint16_t              answer_count;
+  uint16_t              additional_count;
+  uint16_t              names[MDNS_COMPRESS_MAX];
+  uint8_t               name_count;
+} mdns_message_t;
 
 static dns_sd_service_record_t   available_services[ MAX_RECORD_COUNT ];
 static uint8_t	available_service_count = MAX_RECORD_COUNT;
 
-static int dns_get_next_question( dns_message_iterator_t* iter, dns_question_t* q, dns_name_t* name );
-static int dns_compare_name_to_string( dns_name_t* name, const char* string );
-static int dns_create_message( dns_message_iterator_t* message, uint16_t size );
-static void dns_write_header( dns_message_iterator_t* iter, uint16_t id, uint16_t flags, uint16_t question_count, uint16_t answer_count, uint16_t authorative_count );
-static void dns_write_record( dns_message_iterator_t* iter, const char* name, uint16_t record_class, uint16_t record_type, uint32_t ttl, uint8_t* rdata );
-static void mdns_send_message(int fd, dns_message_iterator_t* message );
-static void dns_free_message( dns_message_iterator_t* message );
-static void mdns_process_query(int fd, dns_name_t* name, dns_question_t* question, dns_message_iterator_t* source );
-static void dns_write_record( dns_message_iterator_t* iter, const char* name, uint16_t record_class, uint16_t record_type, uint32_t ttl, uint8_t* rdata );
-static void dns_write_uint16( dns_message_iterator_t* iter, uint16_t data );
-static void dns_write_uint32( dns_message_iterator_t* iter, uint32_t data );
-static void dns_write_bytes( dns_message_iterator_t* iter, uint8_t* data, uint16_t length );
-static uint16_t dns_read_uint16( dns_message_iterator_t* iter );
-static void dns_skip_name( dns_message_iterator_t* iter );
-static void dns_write_name( dns_message_iterator_t* iter, const char* src );
-
 static OSStatus start_bonjour_service(void);
 
 static mico_mutex_t bonjour_mutex = NULL;
@@ -91,366 +119,1321 @@ static int update_state_fd = 0;
 static mico_thread_t mfi_bonjour_thread_handler;
 static void _bonjour_thread(void *arg);
 
-void process_dns_questions(int fd, dns_message_iterator_t* iter )
+static bool mdns_record_active( dns_sd_service_record_t *record )
+{
+  return record->state == RECORD_NORMAL || record->state == RECORD_UPDATE;
+}
+
+static uint32_t mdns_record_ip( dns_sd_service_record_t *record )
 {
-  dns_name_t name;
-  dns_question_t question;
-  dns_message_iterator_t response;
   IPStatusTypedef para;
-  int a = 0;
-  int question_processed;
   uint32_t myip;
-  
-  memset( &response, 0, sizeof(dns_message_iterator_t) );
-  
-  for ( a = 0; a < htons(iter->header->question_count); ++a )
+
+  micoWlanGetIPStatus(&para, record->interface);
+  myip = htonl(inet_addr(para.ip));
+  if( myip == 0xFFFFFFFF ) myip = 0;
+  return myip;
+}
+
+static uint16_t mdns_read_uint16( const uint8_t* p )
+{
+  return (uint16_t)( p[0] << 8 | p[1] );
+}
+
+static uint32_t mdns_read_uint32( const uint8_t* p )
+{
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+/* Returns the first byte behind the name at p, NULL if it is malformed */
+static const uint8_t* mdns_skip_name( const uint8_t* p, const uint8_t* end )
+{
+  while ( p < end )
   {
-    if (iter->iter > iter->end)
-      break;
-    if(dns_get_next_question( iter, &question, &name )==0)
-      break;
-    question_processed = 0;
-    switch ( question.question_type ){
-    case RR_TYPE_PTR:
-      if ( available_services != NULL ){
-        // Check if its a query for all available services  
-        if ( dns_compare_name_to_string( &name, SERVICE_QUERY_NAME ) ){
-          int b = 0;
-          if(dns_create_message( &response, 512 )) {
-            dns_write_header(&response, iter->header->id, 0x8400, 0, available_service_count, 0 );          
-            for ( b = 0; b < available_service_count; ++b ){
-              dns_write_record( &response, SERVICE_QUERY_NAME, RR_CLASS_IN, RR_TYPE_PTR, 1500, (uint8_t*) available_services[b].service_name );
-            }
-            mdns_send_message(fd, &response );
-            dns_free_message( &response );
-            question_processed = 1;
-          }
-        }
-        // else check if its one of our records
-        else {
-          int b = 0;
-          for ( b = 0; b < available_service_count; ++b ){
-            //printf("UDP multicast test: Recv a SERVICE Detail request: %s.\r\n", name);
-            if ( dns_compare_name_to_string( &name, available_services[b].service_name )){
-              
-              if( available_services[b].state != RECORD_NORMAL )
-                continue;
-
-              micoWlanGetIPStatus(&para, available_services[b].interface);
-              myip = htonl(inet_addr(para.ip));
-              if( myip == 0 || myip == 0xFFFFFFFF) continue;
-              
-              // Send the PTR, TXT, SRV and A records
-              if(dns_create_message( &response, 512 )){
-                dns_write_header( &response, iter->header->id, 0x8400, 0, 4, 0 );
-                //dns_write_record( &response, MFi_SERVICE_QUERY_NAME, RR_CLASS_IN, RR_TYPE_PTR, 1500, (u8*) available_services[b].service_name );
-                dns_write_record( &response, available_services[b].service_name, RR_CLASS_IN, RR_TYPE_PTR, available_services[b].ttl, (uint8_t*) available_services[b].instance_name );
-                dns_write_record( &response, available_services[b].instance_name, RR_CACHE_FLUSH|RR_CLASS_IN, RR_TYPE_TXT, available_services[b].ttl, (uint8_t*) available_services[b].txt_att );
-                dns_write_record( &response, available_services[b].instance_name, RR_CACHE_FLUSH|RR_CLASS_IN, RR_TYPE_SRV, available_services[b].ttl, (uint8_t*) &available_services[b]);
-                dns_write_record( &response, available_services[b].hostname, RR_CACHE_FLUSH|RR_CLASS_IN, RR_TYPE_A, available_services[b].ttl, (uint8_t*) &myip);
-                mdns_send_message(fd, &response );
-                dns_free_message( &response );
-                question_processed = 1;
-              }
-            }
-          }
-        }
+    if ( *p == 0 )
+      return p + 1;
+    if ( ( *p & 0xC0 ) == 0xC0 )
+      return ( p + 2 <= end ) ? p + 2 : NULL;
+    if ( *p & 0xC0 )
+      return NULL;
+    p += *p + 1;
+  }
+  return NULL;
+}
+
+/* Compare the (possibly compressed) name at p with label + name, case
+ * insensitive. label is one raw label, an instance name may hold dots, it
+ * can be NULL. name is dotted, the trailing dot is optional. */
+static bool mdns_name_equal( const uint8_t* start, const uint8_t* end, const uint8_t* p,
+                             const char* label, const char* name )
+{
+  const char* seg;
+  size_t seg_len;
+  uint8_t len;
+  int hops = 0;
+
+  while ( 1 )
+  {
+    if ( p >= end ) return false;
+    while ( ( *p & 0xC0 ) == 0xC0 )
+    {
+      if ( p + 1 >= end || ++hops > 16 ) return false;
+      p = start + ( ( ( p[0] & 0x3F ) << 8 ) | p[1] );
+      if ( p >= end ) return false;
+    }
+    len = *p++;
+
+    if ( label != NULL ) {
+      seg = label;
+      seg_len = strlen( label );
+      label = NULL;
+    } else {
+      if ( *name == '\0' ) return len == 0;
+      seg = name;
+      seg_len = strcspn( name, "." );
+      name += seg_len;
+      if ( *name == '.' ) name++;
+    }
+
+    if ( len == 0 || len != seg_len || p + len > end ) return false;
+    if ( strnicmp( (const char*) p, seg, len ) != 0 ) return false;
+    p += len;
+  }
+}
+
+/* Write label + name, pointing to the longest suffix already in the message */
+static bool mdns_write_name( mdns_message_t* msg, const char* label, const char* name )
+{
+  const uint8_t* start = (const uint8_t*) msg->header;
+  const char* seg;
+  size_t seg_len;
+  uint16_t offset;
+  int i;
+
+  while ( label != NULL || *name != '\0' )
+  {
+    for ( i = 0; i < msg->name_count; i++ ) {
+      if ( mdns_name_equal( start, msg->iter, start + msg->names[i], label, name ) ) {
+        if ( msg->iter + 2 > msg->end ) return false;
+        *msg->iter++ = 0xC0 | ( msg->names[i] >> 8 );
+        *msg->iter++ = msg->names[i] & 0xFF;
+        return true;
       }
-      break;
     }
-    if (!question_processed ){
-      mdns_process_query(fd, &name, &question, iter);
+
+    if ( label != NULL ) {
+      seg = label;
+      seg_len = strlen( label );
+      label = NULL;
+    } else {
+      seg = name;
+      seg_len = strcspn( name, "." );
+      name += seg_len;
+      if ( *name == '.' ) name++;
     }
+    if ( seg_len == 0 || seg_len > 63 || msg->iter + seg_len + 2 > msg->end ) return false;
+
+    offset = msg->iter - start;
+    if ( msg->name_count < MDNS_COMPRESS_MAX && offset < 0x3FFF )
+      msg->names[msg->name_count++] = offset;
+    *msg->iter++ = seg_len;
+    memcpy( msg->iter, seg, seg_len );
+    msg->iter += seg_len;
   }
+
+  if ( msg->iter >= msg->end ) return false;
+  *msg->iter++ = 0;
+  return true;
 }
 
-static void mdns_process_query(int fd, dns_name_t* name, 
-                               dns_question_t* question, dns_message_iterator_t* source )
+/* TXT strings are separated by '.', "/." is a literal dot, see mdns_init_t.
+ * Returns the encoded length, or -1 if it does not fit into size. */
+static int mdns_encode_txt( const char* src, uint8_t* out, int size )
 {
-  dns_message_iterator_t response;
-  IPStatusTypedef para;
-  uint32_t myip;
-  int b = 0;
-  
-  memset( &response, 0, sizeof(dns_message_iterator_t) );
-  
-  switch ( question->question_type )
+  int pos = 0, seg;
+
+  do
   {
-  case RR_QTYPE_ANY:
-  case RR_TYPE_A:
-    for ( b = 0; b < available_service_count; ++b ){
-      if ( dns_compare_name_to_string( name, available_services[b].hostname ) ){				
-
-        micoWlanGetIPStatus(&para, available_services[b].interface);
-        myip = htonl(inet_addr(para.ip));
-        if( myip == 0 || myip == 0xFFFFFFFF) continue;
-
-        if(dns_create_message( &response, 256 )){
-          dns_write_header( &response, source->header->id, 0x8400, 0, 1, 0 );
-          dns_write_record( &response, available_services[b].hostname, RR_CLASS_IN | RR_CACHE_FLUSH, RR_TYPE_A, available_services[b].ttl, (uint8_t *)&myip);
-          mdns_send_message(fd, &response );
-          dns_free_message( &response );
-          return;
+    if ( pos >= size ) return -1;
+    seg = pos++;
+    while ( *src != '.' && *src != '\0' )
+    {
+      if ( *src == '/' && src[1] != '\0' ) src++;
+      if ( pos >= size || pos - seg > 255 ) return -1;
+      out[pos++] = *src++;
+    }
+    out[seg] = pos - seg - 1;
+    if ( *src == '.' ) src++;
+  } while ( *src != '\0' );
+
+  /* Closing empty string, as always sent by this responder */
+  if ( pos >= size ) return -1;
+  out[pos++] = 0;
+  return pos;
+}
+
+static bool mdns_write_uint16( mdns_message_t* msg, uint16_t data )
+{
+  if ( msg->iter + 2 > msg->end ) return false;
+  msg->iter[0] = data >> 8;
+  msg->iter[1] = data & 0xFF;
+  msg->iter += 2;
+  return true;
+}
+
+static bool mdns_write_uint32( mdns_message_t* msg, uint32_t data )
+{
+  if ( msg->iter + 4 > msg->end ) return false;
+  msg->iter[0] = data >> 24;
+  msg->iter[1] = data >> 16;
+  msg->iter[2] = data >> 8;
+  msg->iter[3] = data & 0xFF;
+  msg->iter += 4;
+  return true;
+}
+
+static void mdns_record_type( int kind, uint16_t* type, uint16_t* record_class )
+{
+  static const uint16_t types[MDNS_RR_KINDS] = { RR_TYPE_PTR, RR_TYPE_PTR, RR_TYPE_SRV, RR_TYPE_TXT, RR_TYPE_A };
+
+  *type = types[kind];
+  /* Shared PTR records never carry the cache flush bit */
+  *record_class = ( kind == MDNS_RR_META || kind == MDNS_RR_PTR ) ? RR_CLASS_IN : ( RR_CLASS_IN | RR_CACHE_FLUSH );
+}
+
+/* Append one record of a service, nothing is left behind if it does not fit */
+static bool mdns_write_record( mdns_message_t* msg, dns_sd_service_record_t* record, int kind,
+                               uint32_t ttl, uint32_t myip, bool cache_flush )
+{
+  uint8_t* start = msg->iter;
+  uint8_t name_count = msg->name_count;
+  uint8_t* rd_length;
+  uint16_t type, record_class;
+  int len;
+  bool ok;
+
+  mdns_record_type( kind, &type, &record_class );
+  if ( !cache_flush ) record_class &= ~RR_CACHE_FLUSH;
+
+  switch ( kind ) {
+    case MDNS_RR_META:
+      ok = mdns_write_name( msg, NULL, SERVICE_QUERY_NAME );
+      break;
+    case MDNS_RR_PTR:
+      ok = mdns_write_name( msg, NULL, record->service_name );
+      break;
+    case MDNS_RR_A:
+      ok = mdns_write_name( msg, NULL, record->hostname );
+      break;
+    default:
+      ok = mdns_write_name( msg, record->instance_name, record->service_name );
+      break;
+  }
+  ok = ok && mdns_write_uint16( msg, type ) && mdns_write_uint16( msg, record_class )
+          && mdns_write_uint32( msg, ttl ) && mdns_write_uint16( msg, 0 );
+  rd_length = msg->iter;
+
+  if ( ok ) {
+    switch ( kind ) {
+      case MDNS_RR_META:
+        ok = mdns_write_name( msg, NULL, record->service_name );
+        break;
+      case MDNS_RR_PTR:
+        ok = mdns_write_name( msg, record->instance_name, record->service_name );
+        break;
+      case MDNS_RR_SRV:
+        /* Priority and weight 0, port, target host */
+        ok = mdns_write_uint16( msg, 0 ) && mdns_write_uint16( msg, 0 ) && mdns_write_uint16( msg, record->port )
+             && mdns_write_name( msg, NULL, record->hostname );
+        break;
+      case MDNS_RR_TXT:
+        len = mdns_encode_txt( record->txt_att, msg->iter, msg->end - msg->iter );
+        ok = ( len >= 0 );
+        if ( ok ) msg->iter += len;
+        break;
+      case MDNS_RR_A:
+        ok = ( msg->iter + 4 <= msg->end );
+        if ( ok ) {
+          memcpy( msg->iter, &myip, 4 );
+          msg->iter += 4;
         }
-      }
-    }    
-  default:
-   break;;
+        break;
+    }
+  }
+
+  if ( !ok ) {
+    msg->iter = start;
+    msg->name_count = name_count;
+    return false;
+  }
+  rd_length[-2] = ( msg->iter - rd_length ) >> 8;
+  rd_length[-1] = ( msg->iter - rd_length ) & 0xFF;
+  return true;
+}
+
+static bool mdns_create_message( mdns_message_t* msg, uint16_t id )
+{
+  memset( msg, 0, sizeof(mdns_message_t) );
+  msg->header = (dns_message_header_t*) malloc( MDNS_MESSAGE_SIZE );
+  if ( msg->header == NULL )
+    return false;
+  memset( msg->header, 0, sizeof(dns_message_header_t) );
+  msg->header->id = htons( id );
+  msg->header->flags = htons( DNS_MESSAGE_IS_A_RESPONSE | DNS_MESSAGE_AUTHORITATIVE );
+  msg->iter = (uint8_t*) msg->header + sizeof(dns_message_header_t);
+  msg->end = (uint8_t*) msg->header + MDNS_MESSAGE_SIZE;
+  return true;
+}
+
+/* Send to the querier, or multicast (and broadcast, for clients of the soft AP) if to is NULL */
+static void mdns_send_message( int fd, mdns_message_t* msg, struct sockaddr_t* to )
+{
+  struct sockaddr_t addr;
+  int len = msg->iter - (uint8_t*) msg->header;
+
+  msg->header->question_count = htons( msg->question_count );
+  msg->header->answer_count = htons( msg->answer_count );
+  msg->header->additional_record_count = htons( msg->additional_count );
+
+  if ( to != NULL ) {
+    sendto( fd, msg->header, len, 0, to, sizeof(struct sockaddr_t) );
+    return;
   }
+  addr.s_ip = inet_addr("224.0.0.251");
+  addr.s_port = MDNS_PORT;
+  sendto(fd, msg->header, len, 0, &addr, sizeof(addr));
+  addr.s_ip = inet_addr("255.255.255.255");
+  addr.s_port = MDNS_PORT;
+  sendto(fd, msg->header, len, 0, &addr, sizeof(addr));
 }
 
+static void mdns_free_message( mdns_message_t* msg )
+{
+  free( msg->header );
+  msg->header = NULL;
+}
 
-static int dns_get_next_question( dns_message_iterator_t* iter, dns_question_t* q, dns_name_t* name )
+static bool mdns_string_equal( const char* a, const char* b )
 {
-  // Set the name pointers and then skip it
-  name->start_of_name   = (uint8_t*) iter->iter;
-  name->start_of_packet = (uint8_t*) iter->header;
-  dns_skip_name( iter );
-  if (iter->iter > iter->end)
-    return 0;
-  
-  // Read the type and class
-  q->question_type  = dns_read_uint16( iter );
-  q->question_class = dns_read_uint16( iter );
-  return 1;
+  return strnicmp( a, b, strlen( a ) + 1 ) == 0;
 }
 
-static int dns_compare_name_to_string( dns_name_t* name, const char* string )
+static bool mdns_same_record( dns_sd_service_record_t* a, dns_sd_service_record_t* b, int kind, uint32_t ip_a, uint32_t ip_b )
 {
-  uint8_t section_length;
-  int finished = 0;
-  int result   = 1;
-  uint8_t* buffer 	  = name->start_of_name;
-  char *temp;
-  
-  while ( !finished )
+  if ( kind == MDNS_RR_A )
+    return ip_a == ip_b && mdns_string_equal( a->hostname, b->hostname );
+  if ( !mdns_string_equal( a->service_name, b->service_name ) )
+    return false;
+  if ( kind == MDNS_RR_META )
+    return true;
+  if ( !mdns_string_equal( a->instance_name, b->instance_name ) )
+    return false;
+  if ( kind == MDNS_RR_PTR )
+    return true;
+  return a->port == b->port && strcmp( a->hostname, b->hostname ) == 0 && strcmp( a->txt_att, b->txt_att ) == 0;
+}
+
+/* RFC 6762 7.1: is the answer in the query the same as our record, with at
+ * least half of our TTL left? */
+static bool mdns_known_answer( const uint8_t* start, const uint8_t* end, const uint8_t* name,
+                               const uint8_t* rr, dns_sd_service_record_t* record, int kind,
+                               uint32_t ttl, uint32_t myip )
+{
+  uint16_t type, record_class, rr_class, rd_length;
+  const uint8_t* rdata;
+  uint8_t* txt;
+  bool equal;
+  int len;
+
+  mdns_record_type( kind, &type, &record_class );
+  rr_class = mdns_read_uint16( rr + 2 ) & ~RR_CACHE_FLUSH;
+  rd_length = mdns_read_uint16( rr + 8 );
+  rdata = rr + 10;
+  if ( mdns_read_uint16( rr ) != type || rr_class != RR_CLASS_IN ) return false;
+  if ( mdns_read_uint32( rr + 4 ) < ttl / 2 ) return false;
+
+  switch ( kind ) {
+    case MDNS_RR_META:
+      return mdns_name_equal( start, end, name, NULL, SERVICE_QUERY_NAME )
+          && mdns_name_equal( start, end, rdata, NULL, record->service_name );
+    case MDNS_RR_PTR:
+      return mdns_name_equal( start, end, name, NULL, record->service_name )
+          && mdns_name_equal( start, end, rdata, record->instance_name, record->service_name );
+    case MDNS_RR_SRV:
+      return rd_length > 6
+          && mdns_name_equal( start, end, name, record->instance_name, record->service_name )
+          && mdns_read_uint16( rdata + 4 ) == record->port
+          && mdns_name_equal( start, end, rdata + 6, NULL, record->hostname );
+    case MDNS_RR_TXT:
+      if ( !mdns_name_equal( start, end, name, record->instance_name, record->service_name ) ) return false;
+      txt = malloc( rd_length + 1 );
+      if ( txt == NULL ) return false;
+      len = mdns_encode_txt( record->txt_att, txt, rd_length + 1 );
+      equal = ( len == rd_length && memcmp( txt, rdata, len ) == 0 );
+      free( txt );
+      return equal;
+    case MDNS_RR_A:
+      return rd_length == 4 && memcmp( rdata, &myip, 4 ) == 0
+          && mdns_name_equal( start, end, name, NULL, record->hostname );
+  }
+  return false;
+}
+
+/* Read a name back as a dotted string with a trailing dot */
+static bool mdns_read_name( const uint8_t* start, const uint8_t* end, const uint8_t* p, char* out, int size )
+{
+  int pos = 0, hops = 0;
+  uint8_t len;
+
+  while ( p < end )
   {
-    // Check if the name is compressed. If so, find the uncompressed version
-    while ( *buffer & 0xC0 )
-    {
-      uint16_t offset = ( *buffer++ ) << 8;
-      offset += *buffer;
-      offset &= 0x3FFF;
-      buffer = name->start_of_packet + offset;
+    while ( ( *p & 0xC0 ) == 0xC0 ) {
+      if ( p + 1 >= end || ++hops > 16 ) return false;
+      p = start + ( ( ( p[0] & 0x3F ) << 8 ) | p[1] );
+      if ( p >= end ) return false;
     }
-    
-    // Compare section
-    section_length = *( buffer++ );
-    temp = malloc(section_length+1);
-    temp[section_length] = 0;
-    memcpy(temp, buffer, section_length );
-    free(temp);
-    if ( strncmp( (char*) buffer, string, section_length ) )
-    {
-      result	 = 0;
-      finished = 1;
+    len = *p++;
+    if ( len == 0 ) {
+      out[pos] = '\0';
+      return true;
     }
-    string += section_length + 1;
-    buffer += section_length;
-    
-    // Check if we've finished comparing
-    if ( *buffer == 0 || *string == 0 )
+    if ( p + len > end || pos + len + 2 > size ) return false;
+    memcpy( out + pos, p, len );
+    pos += len;
+    out[pos++] = '.';
+    p += len;
+  }
+  return false;
+}
+
+static void mdns_process_query( int fd, dns_message_iterator_t* source, struct sockaddr_t* from )
+{
+  const uint8_t* start = (const uint8_t*) source->header;
+  const uint8_t* end = source->end;
+  const uint8_t* p = source->iter;
+  const uint8_t* questions = source->iter;
+  const uint8_t* name;
+  uint16_t question_count = ntohs( source->header->question_count );
+  uint16_t known_count = ntohs( source->header->answer_count );
+  uint8_t answers[MAX_RECORD_COUNT], additionals[MAX_RECORD_COUNT], known[MAX_RECORD_COUNT];
+  uint32_t ip[MAX_RECORD_COUNT], ttl;
+  uint16_t type, question_class;
+  mdns_message_t response;
+  dns_sd_service_record_t* record;
+  bool legacy = ( from != NULL && from->s_port != MDNS_PORT );
+  bool unicast = legacy;
+  bool qu = ( question_count > 0 );
+  bool pending = false;
+  uint32_t now = mico_get_time( );
+  char qname[128];
+  int a, b, c, kind, section;
+
+  memset( answers, 0, sizeof(answers) );
+  memset( known, 0, sizeof(known) );
+  for ( b = 0; b < available_service_count; b++ )
+    ip[b] = mdns_record_active( &available_services[b] ) ? mdns_record_ip( &available_services[b] ) : 0;
+
+  /* Which of our records answer the questions */
+  for ( a = 0; a < question_count; a++ )
+  {
+    name = p;
+    p = mdns_skip_name( p, end );
+    if ( p == NULL || p + 4 > end ) return;
+    type = mdns_read_uint16( p );
+    question_class = mdns_read_uint16( p + 2 );
+    p += 4;
+    if ( !( question_class & MDNS_QU_BIT ) ) qu = false;
+
+    for ( b = 0; b < available_service_count; b++ )
     {
-      finished = 1;
-      // Check if one of the strings has more data
-      if ( *buffer != 0 || *string != 0 )
-      {
-        result = 0;
+      record = &available_services[b];
+      if ( !mdns_record_active( record ) ) continue;
+
+      if ( type == RR_TYPE_PTR || type == RR_QTYPE_ANY ) {
+        if ( mdns_name_equal( start, end, name, NULL, SERVICE_QUERY_NAME ) )
+          answers[b] |= MDNS_RR_BIT( MDNS_RR_META );
+        if ( ip[b] != 0 && mdns_name_equal( start, end, name, NULL, record->service_name ) )
+          answers[b] |= MDNS_RR_BIT( MDNS_RR_PTR );
+      }
+      if ( ip[b] == 0 ) continue;
+      if ( ( type == RR_TYPE_SRV || type == RR_TYPE_TXT || type == RR_QTYPE_ANY )
+           && mdns_name_equal( start, end, name, record->instance_name, record->service_name ) ) {
+        if ( type != RR_TYPE_TXT )
+          answers[b] |= MDNS_RR_BIT( MDNS_RR_SRV );
+        if ( type != RR_TYPE_SRV )
+          answers[b] |= MDNS_RR_BIT( MDNS_RR_TXT );
       }
+      if ( ( type == RR_TYPE_A || type == RR_QTYPE_ANY )
+           && mdns_name_equal( start, end, name, NULL, record->hostname ) )
+        answers[b] |= MDNS_RR_BIT( MDNS_RR_A );
     }
   }
-  
-  return result;
+  if ( qu ) unicast = true;
+
+  /* Known answer suppression: drop what the querier already holds */
+  for ( a = 0; a < known_count && p != NULL; a++ )
+  {
+    name = p;
+    p = mdns_skip_name( p, end );
+    if ( p == NULL || p + 10 > end || p + 10 + mdns_read_uint16( p + 8 ) > end ) break;
+    for ( b = 0; b < available_service_count; b++ ) {
+      record = &available_services[b];
+      if ( !mdns_record_active( record ) ) continue;
+      for ( kind = 0; kind < MDNS_RR_KINDS; kind++ ) {
+        if ( mdns_known_answer( start, end, name, p, record, kind,
+                                ( kind == MDNS_RR_META ) ? SERVICE_QUERY_TTL : record->ttl, ip[b] ) )
+          known[b] |= MDNS_RR_BIT( kind );
+      }
+    }
+    p += 10 + mdns_read_uint16( p + 8 );
+  }
+
+  /* What goes along with the answers left: the SRV, TXT and A records of
+     a PTR, the A record of an SRV */
+  for ( b = 0; b < available_service_count; b++ ) {
+    answers[b] &= ~known[b];
+    additionals[b] = 0;
+    if ( answers[b] & MDNS_RR_BIT( MDNS_RR_PTR ) )
+      additionals[b] |= MDNS_RR_BIT( MDNS_RR_SRV ) | MDNS_RR_BIT( MDNS_RR_TXT ) | MDNS_RR_BIT( MDNS_RR_A );
+    if ( answers[b] & MDNS_RR_BIT( MDNS_RR_SRV ) )
+      additionals[b] |= MDNS_RR_BIT( MDNS_RR_A );
+    additionals[b] &= ~known[b];
+  }
+
+  /* Each record once, answers before additionals */
+  for ( b = 0; b < available_service_count; b++ ) {
+    additionals[b] &= ~answers[b];
+    for ( c = 0; c < b; c++ ) {
+      for ( kind = 0; kind < MDNS_RR_KINDS; kind++ ) {
+        if ( !( ( answers[b] | additionals[b] ) & MDNS_RR_BIT( kind ) ) ) continue;
+        if ( !( ( answers[c] | additionals[c] ) & MDNS_RR_BIT( kind ) ) ) continue;
+        if ( !mdns_same_record( &available_services[b], &available_services[c], kind, ip[b], ip[c] ) ) continue;
+        if ( answers[b] & MDNS_RR_BIT( kind ) ) {
+          additionals[c] &= ~MDNS_RR_BIT( kind );
+          answers[c] |= MDNS_RR_BIT( kind );
+        }
+        answers[b] &= ~MDNS_RR_BIT( kind );
+        additionals[b] &= ~MDNS_RR_BIT( kind );
+      }
+    }
+  }
+
+  /* Multicast each record no more than once a second */
+  for ( b = 0; b < available_service_count; b++ ) {
+    if ( !unicast ) {
+      for ( kind = 0; kind < MDNS_RR_KINDS; kind++ ) {
+        if ( now - available_services[b].last_multicast[kind] < MDNS_MULTICAST_INTERVAL ) {
+          answers[b] &= ~MDNS_RR_BIT( kind );
+          additionals[b] &= ~MDNS_RR_BIT( kind );
+        }
+      }
+    }
+    if ( answers[b] ) pending = true;
+  }
+  if ( !pending ) return;
+
+  if ( !mdns_create_message( &response, legacy ? ntohs( source->header->id ) : 0 ) ) return;
+
+  /* Legacy resolvers match the reply by its question section */
+  if ( legacy ) {
+    for ( a = 0, p = questions; a < question_count; a++ ) {
+      name = p;
+      p = mdns_skip_name( p, end ) + 4;
+      if ( !mdns_read_name( start, end, name, qname, sizeof(qname) )
+           || !mdns_write_name( &response, NULL, qname )
+           || !mdns_write_uint16( &response, mdns_read_uint16( p - 4 ) )
+           || !mdns_write_uint16( &response, mdns_read_uint16( p - 2 ) & ~MDNS_QU_BIT ) ) {
+        mdns_free_message( &response );
+        return;
+      }
+    }
+    response.question_count = question_count;
+  }
+
+  for ( section = 0; section < 2; section++ ) {
+    for ( b = 0; b < available_service_count; b++ ) {
+      record = &available_services[b];
+      for ( kind = 0; kind < MDNS_RR_KINDS; kind++ ) {
+        if ( !( ( section ? additionals[b] : answers[b] ) & MDNS_RR_BIT( kind ) ) ) continue;
+        ttl = ( kind == MDNS_RR_META ) ? SERVICE_QUERY_TTL : record->ttl;
+        if ( legacy && ttl > MDNS_LEGACY_UNICAST_TTL ) ttl = MDNS_LEGACY_UNICAST_TTL;
+
+        if ( !mdns_write_record( &response, record, kind, ttl, ip[b], !legacy ) ) {
+          /* Additionals are optional, answers continue in a new packet */
+          if ( section || response.answer_count == 0 ) continue;
+          mdns_send_message( fd, &response, unicast ? from : NULL );
+          response.iter = (uint8_t*) response.header + sizeof(dns_message_header_t);
+          response.question_count = response.answer_count = response.name_count = 0;
+          if ( !mdns_write_record( &response, record, kind, ttl, ip[b], !legacy ) ) continue;
+        }
+        if ( section ) response.additional_count++;
+        else response.answer_count++;
+        if ( !unicast ) record->last_multicast[kind] = now;
+      }
+    }
+  }
+  mdns_send_message( fd, &response, unicast ? from : NULL );
+  mdns_free_message( &response );
 }
 
-static int dns_create_message( dns_message_iterator_t* message, uint16_t size )
+
+/*************************************************************************************************************
+ * Querier: browse for and resolve the services of other hosts
+ *************************************************************************************************************/
+
+/* Records of other hosts, shared by all browses and resolves */
+#ifndef MDNS_CACHE_SIZE
+#define MDNS_CACHE_SIZE                16
+#endif
+
+#ifndef MDNS_BROWSE_MAX
+#define MDNS_BROWSE_MAX                4
+#endif
+
+#if MDNS_BROWSE_MAX > 8
+#error "MDNS_BROWSE_MAX is limited to the 8 bits of mdns_cache_entry_t.reported"
+#endif
+
+#ifndef MDNS_RESOLVE_MAX
+#define MDNS_RESOLVE_MAX               2
+#endif
+
+/* RFC 6762 5.2: continuous queries start one second apart, the interval
+ * doubles up to one hour */
+#define MDNS_QUERY_INTERVAL_MIN        1000
+#ifndef MDNS_QUERY_INTERVAL_MAX
+#define MDNS_QUERY_INTERVAL_MAX        3600000
+#endif
+
+/* RFC 6762 5.2: cached records are queried again at 80, 85, 90 and 95% of their TTL */
+#define MDNS_REFRESH_COUNT             4
+
+/* Queries for the SRV, TXT and A records missing from an instance */
+#define MDNS_RESOLVE_TRIES             3
+
+/* RFC 6762 10.1: a record is removed one second after its goodbye */
+#define MDNS_GOODBYE_TTL               1000
+
+/* TTLs are kept in ms, longer ones are cut to a day */
+#define MDNS_CACHE_TTL_MAX             86400
+
+#define MDNS_QUESTION_MAX              8
+
+#define MDNS_NAME_MAX                  128
+
+typedef struct
 {
-  message->header = (dns_message_header_t*) malloc( size );
-  if ( message->header == NULL )
-  {
-    return 0;
+  char*    name;          /* NULL for a free entry */
+  char*    data;          /* PTR and SRV target, TXT encoded as in mdns_init_t */
+  uint32_t ip;            /* A */
+  uint32_t received;
+  uint32_t ttl;           /* ms */
+  uint32_t queried;       /* PTR: last query for a missing SRV, TXT or A */
+  uint16_t type;
+  uint16_t port;
+  uint8_t  refresh;       /* refresh queries sent since received */
+  uint8_t  tries;         /* PTR: queries sent for a missing SRV, TXT or A */
+  uint8_t  reported;      /* PTR: browses told about the instance */
+  uint8_t  updated;       /* PTR: browses to be told about a change */
+  bool     removed;       /* PTR: expired, browses in reported are to be told */
+  bool     live;          /* needed by a browse, refreshed before it expires */
+} mdns_cache_entry_t;
+
+typedef struct
+{
+  char*                  service_name;  /* NULL for a free slot */
+  mdns_browse_callback_t callback;
+  void*                  arg;
+  uint32_t               next_query;
+  uint32_t               interval;
+} mdns_browse_t;
+
+typedef struct
+{
+  char*                  name;          /* instance.service, NULL for a free slot */
+  mico_semaphore_t       done;
+  uint32_t               next_query;
+  uint32_t               interval;
+  bool                   resolved;
+} mdns_resolve_t;
+
+typedef struct
+{
+  const char* name;
+  uint16_t    type;
+} mdns_question_t;
+
+static mdns_cache_entry_t mdns_cache[ MDNS_CACHE_SIZE ];
+static mdns_browse_t      mdns_browses[ MDNS_BROWSE_MAX ];
+static mdns_resolve_t     mdns_resolves[ MDNS_RESOLVE_MAX ];
+
+static mico_semaphore_t   query_sem = NULL;
+static int                query_fd = 0;
+
+static bool mdns_time_reached( uint32_t now, uint32_t time )
+{
+  return (int32_t)( now - time ) >= 0;
+}
+
+static void mdns_cache_free( mdns_cache_entry_t* entry )
+{
+  if ( entry->name ) free( entry->name );
+  if ( entry->data ) free( entry->data );
+  memset( entry, 0, sizeof(mdns_cache_entry_t) );
+}
+
+/* data tells shared PTR records of one name apart, NULL for the others */
+static mdns_cache_entry_t* mdns_cache_find( uint16_t type, const char* name, const char* data )
+{
+  mdns_cache_entry_t* entry;
+
+  for ( entry = mdns_cache; entry < mdns_cache + MDNS_CACHE_SIZE; entry++ ) {
+    if ( entry->name == NULL || entry->type != type || !mdns_string_equal( entry->name, name ) ) continue;
+    if ( data == NULL || mdns_string_equal( entry->data, data ) ) return entry;
   }
-  
-  message->iter = (uint8_t *) message->header + sizeof(dns_message_header_t);
-  return 1;
+  return NULL;
 }
 
-static void dns_free_message( dns_message_iterator_t* message )
+static mdns_cache_entry_t* mdns_cache_lookup( uint16_t type, const char* name )
 {
-  free(message->header);
-  message->header = NULL;
+  mdns_cache_entry_t* entry = mdns_cache_find( type, name, NULL );
+
+  return ( entry != NULL && !entry->removed ) ? entry : NULL;
 }
 
-static void dns_write_string( dns_message_iterator_t* iter, const char* src )
+/* A free entry, or the one closest to expiry that no browse needs */
+static mdns_cache_entry_t* mdns_cache_alloc( uint32_t now )
 {
-  uint8_t* segment_length_pointer;
-  uint8_t  segment_length;
-  
-  while ( *src != 0 && *src != 0xC0)
-  {
-    /* Remember where we need to store the segment length and reset the counter*/
-    segment_length_pointer = iter->iter++;
-    segment_length = 0;
-    
-    /* Copy bytes until '.' or end of string*/
-    while ( *src != '.' && *src != 0 && *src != 0xC0)
-    {
-      if (*src == '/')
-        src++; // skip '/'
-      
-      *iter->iter++ = *src++;
-      ++segment_length;
-    }
-    
-    /* Store the length of the segment*/
-    *segment_length_pointer = segment_length;
-    
-    /* Check if we stopped because of a '.', if so, skip it*/
-    if ( *src == '.' )
-    {
-      ++src;
+  mdns_cache_entry_t *entry, *victim = NULL;
+  uint32_t left, victim_left = 0xFFFFFFFF;
+
+  for ( entry = mdns_cache; entry < mdns_cache + MDNS_CACHE_SIZE; entry++ ) {
+    if ( entry->name == NULL ) return entry;
+    if ( entry->live || entry->reported ) continue;
+    left = entry->ttl - ( now - entry->received );
+    if ( left < victim_left ) {
+      victim = entry;
+      victim_left = left;
     }
-    
-  }
-  
-  if (*src == 0xC0) { // compress name
-    *iter->iter++ = *src++;
-    *iter->iter++ = *src++;
-  } else {
-    /* Add the ending null */
-    *iter->iter++ = 0;
   }
+  if ( victim ) mdns_cache_free( victim );
+  return victim;
 }
 
+static mdns_browse_t* mdns_browse_find( const char* service_name )
+{
+  int i;
+
+  for ( i = 0; i < MDNS_BROWSE_MAX; i++ )
+    if ( mdns_browses[i].service_name && mdns_string_equal( mdns_browses[i].service_name, service_name ) )
+      return &mdns_browses[i];
+  return NULL;
+}
 
-static void dns_write_header( dns_message_iterator_t* iter, uint16_t id, uint16_t flags, uint16_t question_count, uint16_t answer_count, uint16_t authorative_count )
+/* SRV and TXT records are kept for instances found by a browse or being resolved */
+static bool mdns_instance_wanted( const char* name )
 {
-  memset( iter->header, 0, sizeof(dns_message_header_t) );
-  iter->header->id				= htons(id);
-  iter->header->flags 			= htons(flags);
-  iter->header->question_count	= htons(question_count);
-  iter->header->name_server_count = htons(authorative_count);
-  iter->header->answer_count		= htons(answer_count);
+  int i;
+
+  for ( i = 0; i < MDNS_CACHE_SIZE; i++ )
+    if ( mdns_cache[i].name && mdns_cache[i].type == RR_TYPE_PTR && mdns_string_equal( mdns_cache[i].data, name ) )
+      return true;
+  for ( i = 0; i < MDNS_RESOLVE_MAX; i++ )
+    if ( mdns_resolves[i].name && mdns_string_equal( mdns_resolves[i].name, name ) )
+      return true;
+  return false;
 }
 
+static bool mdns_host_wanted( const char* name )
+{
+  int i;
+
+  for ( i = 0; i < MDNS_CACHE_SIZE; i++ )
+    if ( mdns_cache[i].name && mdns_cache[i].type == RR_TYPE_SRV && mdns_string_equal( mdns_cache[i].data, name ) )
+      return true;
+  return false;
+}
 
-static void dns_write_record( dns_message_iterator_t* iter, const char* name, uint16_t record_class, uint16_t record_type, uint32_t ttl, uint8_t* rdata )
+static bool mdns_instance_resolved( const char* name )
 {
-  uint8_t* rd_length;
-  uint8_t* temp_ptr;
-  
-  /* Write the name, type, class, TTL*/
-  dns_write_name	( iter, name );
-  dns_write_uint16( iter, record_type );
-  dns_write_uint16( iter, record_class );
-  dns_write_uint32( iter, ttl );
-  
-  /* Keep track of where we store the rdata length*/
-  rd_length	= iter->iter;
-  iter->iter += 2;
-  temp_ptr	= iter->iter;
-  
-  switch ( record_type )
-  {
-  case RR_TYPE_A:
-    dns_write_bytes( iter, rdata, 4 );
-    break;
-    
-  case RR_TYPE_PTR:
-  case RR_TYPE_TXT:
-    dns_write_name( iter, (const char*) rdata );
-    break;
-    
-  case RR_TYPE_SRV:
-    /* Set priority and weight to 0*/
-    dns_write_uint16( iter, 0 );
-    dns_write_uint16( iter, 0 );
-    
-    /* Write the port*/
-    dns_write_uint16( iter, ( (dns_sd_service_record_t*) rdata )->port );
-    
-    /* Write the hostname*/
-    dns_write_string( iter, ( (dns_sd_service_record_t*) rdata )->hostname );
-    break;
-  default:
-    break;
+  mdns_cache_entry_t* srv = mdns_cache_lookup( RR_TYPE_SRV, name );
+
+  return srv != NULL && mdns_cache_lookup( RR_TYPE_A, srv->data ) != NULL;
+}
+
+/* Browses that reported an instance are to be told that its SRV, TXT or A changed */
+static void mdns_cache_changed( mdns_cache_entry_t* changed )
+{
+  mdns_cache_entry_t* entry;
+
+  for ( entry = mdns_cache; entry < mdns_cache + MDNS_CACHE_SIZE; entry++ ) {
+    if ( entry->name == NULL || !mdns_string_equal( entry->data ? entry->data : "", changed->name ) ) continue;
+    if ( changed->type == RR_TYPE_A && entry->type == RR_TYPE_SRV )
+      mdns_cache_changed( entry );
+    else if ( changed->type != RR_TYPE_A && entry->type == RR_TYPE_PTR )
+      entry->updated |= entry->reported;
   }
-  // Write the rdata length
-  rd_length[0] = ( iter->iter - temp_ptr ) >> 8;
-  rd_length[1] = ( iter->iter - temp_ptr ) & 0xFF;
 }
 
-static void mdns_send_message(int fd, dns_message_iterator_t* message )
+static void mdns_cache_update( uint16_t type, const char* name, const char* data, uint16_t port,
+                               uint32_t ip, uint32_t ttl, uint32_t now )
 {
-  struct sockaddr_t addr;
-  
-  addr.s_ip = inet_addr("224.0.0.251");
-  addr.s_port = 5353;
-  sendto(fd, message->header, message->iter - (uint8_t*)message->header, 0, &addr, sizeof(addr));
-  addr.s_ip = inet_addr("255.255.255.255");
-  addr.s_port = 5353;
-  sendto(fd, message->header, message->iter - (uint8_t*)message->header, 0, &addr, sizeof(addr));
+  mdns_cache_entry_t* entry = mdns_cache_find( type, name, ( type == RR_TYPE_PTR ) ? data : NULL );
+  mdns_cache_entry_t* ptr;
+  bool added = ( entry == NULL ), changed = false;
+
+  if ( entry == NULL ) {
+    if ( ttl == 0 ) return;
+    entry = mdns_cache_alloc( now );
+    if ( entry == NULL ) return;
+    entry->name = __strdup( name );
+    entry->type = type;
+    if ( entry->name == NULL ) return;
+  } else if ( ttl == 0 ) {
+    entry->received = now;
+    entry->ttl = MDNS_GOODBYE_TTL;
+    entry->refresh = MDNS_REFRESH_COUNT;
+    return;
+  } else {
+    changed = ( entry->port != port || entry->ip != ip
+                || ( data != NULL && strcmp( entry->data, data ) != 0 ) );
+  }
+
+  if ( data != NULL && ( entry->data == NULL || strcmp( entry->data, data ) != 0 ) ) {
+    if ( entry->data ) free( entry->data );
+    entry->data = __strdup( data );
+    if ( entry->data == NULL ) {
+      mdns_cache_free( entry );
+      return;
+    }
+  }
+  entry->port = port;
+  entry->ip = ip;
+  entry->received = now;
+  entry->ttl = ( ttl > MDNS_CACHE_TTL_MAX ? MDNS_CACHE_TTL_MAX : ttl ) * 1000;
+  entry->refresh = 0;
+  entry->tries = 0;
+  entry->removed = false;
+  if ( changed ) mdns_cache_changed( entry );
+
+  /* A new host for an instance, ask for its address right away */
+  if ( type == RR_TYPE_SRV && ( added || changed ) ) {
+    for ( ptr = mdns_cache; ptr < mdns_cache + MDNS_CACHE_SIZE; ptr++ )
+      if ( ptr->name && ptr->type == RR_TYPE_PTR && mdns_string_equal( ptr->data, name ) )
+        ptr->tries = 0;
+  }
 }
 
-static void dns_write_uint16( dns_message_iterator_t* iter, uint16_t data )
+/* The reverse of mdns_encode_txt, '.' and '/' in a string are escaped */
+static char* mdns_decode_txt( const uint8_t* p, uint16_t len )
 {
-  // We cannot assume the u8 alignment of iter->iter so we can't just typecast and assign
-  iter->iter[0] = data >> 8;
-  iter->iter[1] = data & 0xFF;
-  iter->iter += 2;
+  const uint8_t* end = p + len;
+  char* txt = malloc( 2 * len + 1 );
+  int pos = 0;
+  uint8_t n;
+
+  if ( txt == NULL ) return NULL;
+  while ( p < end )
+  {
+    n = *p++;
+    if ( n > end - p ) break;
+    if ( n == 0 ) continue;
+    if ( pos ) txt[pos++] = '.';
+    while ( n-- ) {
+      if ( *p == '.' || *p == '/' ) txt[pos++] = '/';
+      txt[pos++] = *p++;
+    }
+  }
+  txt[pos] = '\0';
+  return txt;
 }
 
-static void dns_write_uint32( dns_message_iterator_t* iter, uint32_t data )
+/* Copy whole strings of an encoded TXT record only */
+static void mdns_copy_txt( char* out, int size, const char* txt )
 {
-  iter->iter[0] = data >> 24;
-  iter->iter[1] = data >> 16;
-  iter->iter[2] = data >> 8;
-  iter->iter[3] = data & 0xFF;
-  iter->iter += 4;
+  int pos = 0, keep = 0, n;
+
+  while ( 1 ) {
+    if ( *txt == '\0' ) {
+      keep = pos;
+      break;
+    }
+    if ( *txt == '.' ) keep = pos;
+    n = ( txt[0] == '/' && txt[1] != '\0' ) ? 2 : 1;
+    if ( pos + n > size - 1 ) break;
+    memcpy( out + pos, txt, n );
+    pos += n;
+    txt += n;
+  }
+  out[keep] = '\0';
 }
 
-static void dns_write_bytes( dns_message_iterator_t* iter, uint8_t* data, uint16_t length )
+/* Fill service with what the cache holds about instance name, true if it is resolved */
+static bool mdns_cache_fill( const char* name, const char* service_name, mdns_service_t* service )
 {
-  int a = 0;
-  
-  for ( a = 0; a < length; ++a )
-  {
-    iter->iter[a] = data[a];
+  mdns_cache_entry_t *srv, *txt, *a = NULL;
+  size_t len = strlen( name ), suffix = strlen( service_name );
+
+  memset( service, 0, sizeof(mdns_service_t) );
+  if ( len > suffix + 1 && name[len - suffix - 1] == '.' && mdns_string_equal( name + len - suffix, service_name ) )
+    len -= suffix + 1;
+  if ( len > sizeof(service->instance_name) - 1 ) len = sizeof(service->instance_name) - 1;
+  memcpy( service->instance_name, name, len );
+  strncpy( service->service_name, service_name, sizeof(service->service_name) - 1 );
+
+  srv = mdns_cache_lookup( RR_TYPE_SRV, name );
+  txt = mdns_cache_lookup( RR_TYPE_TXT, name );
+  if ( srv ) {
+    strncpy( service->host_name, srv->data, sizeof(service->host_name) - 1 );
+    service->service_port = srv->port;
+    a = mdns_cache_lookup( RR_TYPE_A, srv->data );
   }
-  iter->iter += length;
+  if ( a ) inet_ntoa( service->ip, a->ip );
+  if ( txt ) mdns_copy_txt( service->txt_record, sizeof(service->txt_record), txt->data );
+  return srv != NULL && a != NULL;
 }
 
-static uint16_t dns_read_uint16( dns_message_iterator_t* iter )
+static void mdns_resolve_check( void )
 {
-  uint16_t temp = (uint16_t) ( *iter->iter++ ) << 8;
-  temp += (uint16_t) ( *iter->iter++ );
-  return temp;
+  int i;
+
+  for ( i = 0; i < MDNS_RESOLVE_MAX; i++ ) {
+    if ( mdns_resolves[i].name == NULL || mdns_resolves[i].resolved ) continue;
+    if ( !mdns_instance_resolved( mdns_resolves[i].name ) ) continue;
+    mdns_resolves[i].resolved = true;
+    mico_rtos_set_semaphore( &mdns_resolves[i].done );
+  }
 }
 
-static void dns_skip_name( dns_message_iterator_t* iter )
+/* Cache the answers to our browses and resolves, PTR records first, then
+ * the SRV and TXT records of their instances, then the A records of their hosts */
+static void mdns_process_response( dns_message_iterator_t* source, struct sockaddr_t* from )
 {
-  while ( *iter->iter != 0 )
+  const uint8_t* start = (const uint8_t*) source->header;
+  const uint8_t* end = source->end;
+  const uint8_t* p = source->iter;
+  const uint8_t *records, *name, *rdata;
+  uint16_t question_count = ntohs( source->header->question_count );
+  uint16_t record_count = ntohs( source->header->answer_count ) + ntohs( source->header->name_server_count )
+                        + ntohs( source->header->additional_record_count );
+  static const uint16_t pass_types[3][2] = { { RR_TYPE_PTR, RR_TYPE_PTR }, { RR_TYPE_SRV, RR_TYPE_TXT }, { RR_TYPE_A, RR_TYPE_A } };
+  uint16_t type, record_class, rd_length;
+  uint32_t ttl, now = mico_get_time( );
+  char owner[MDNS_NAME_MAX], target[MDNS_NAME_MAX];
+  char* txt;
+  int a, pass;
+
+  /* RFC 6762 6: responses not sent from the mDNS port are not to be trusted */
+  if ( from != NULL && from->s_port != MDNS_PORT ) return;
+
+  for ( a = 0; a < question_count; a++ ) {
+    p = mdns_skip_name( p, end );
+    if ( p == NULL || p + 4 > end ) return;
+    p += 4;
+  }
+  records = p;
+
+  for ( pass = 0; pass < 3; pass++ )
   {
-    // Check if the name is compressed
-    if ( *iter->iter & 0xC0 )
+    for ( a = 0, p = records; a < record_count; a++ )
     {
-      iter->iter += 1; // Normally this should be 2, but we have a ++ outside the while loop
+      name = p;
+      p = mdns_skip_name( p, end );
+      if ( p == NULL || p + 10 > end ) break;
+      type = mdns_read_uint16( p );
+      record_class = mdns_read_uint16( p + 2 );
+      ttl = mdns_read_uint32( p + 4 );
+      rd_length = mdns_read_uint16( p + 8 );
+      rdata = p + 10;
+      p = rdata + rd_length;
+      if ( p > end ) break;
+
+      if ( ( record_class & ~RR_CACHE_FLUSH ) != RR_CLASS_IN ) continue;
+      if ( type != pass_types[pass][0] && type != pass_types[pass][1] ) continue;
+      if ( !mdns_read_name( start, end, name, owner, sizeof(owner) ) ) continue;
+
+      switch ( type ) {
+        case RR_TYPE_PTR:
+          if ( mdns_browse_find( owner ) && mdns_read_name( start, end, rdata, target, sizeof(target) ) )
+            mdns_cache_update( type, owner, target, 0, 0, ttl, now );
+          break;
+        case RR_TYPE_SRV:
+          if ( rd_length > 6 && mdns_instance_wanted( owner )
+               && mdns_read_name( start, end, rdata + 6, target, sizeof(target) ) )
+            mdns_cache_update( type, owner, target, mdns_read_uint16( rdata + 4 ), 0, ttl, now );
+          break;
+        case RR_TYPE_TXT:
+          if ( !mdns_instance_wanted( owner ) ) break;
+          txt = mdns_decode_txt( rdata, rd_length );
+          if ( txt == NULL ) break;
+          mdns_cache_update( type, owner, txt, 0, 0, ttl, now );
+          free( txt );
+          break;
+        case RR_TYPE_A:
+          if ( rd_length == 4 && mdns_host_wanted( owner ) )
+            mdns_cache_update( type, owner, NULL, 0, mdns_read_uint32( rdata ), ttl, now );
+          break;
+      }
+    }
+  }
+  mdns_resolve_check( );
+}
+
+static void mdns_add_question( mdns_question_t* questions, int* count, uint16_t type, const char* name )
+{
+  int i;
+
+  for ( i = 0; i < *count; i++ )
+    if ( questions[i].type == type && mdns_string_equal( questions[i].name, name ) ) return;
+  if ( *count == MDNS_QUESTION_MAX ) return;
+  questions[*count].type = type;
+  questions[*count].name = name;
+  (*count)++;
+}
+
+/* Ask for the records still missing to resolve instance name */
+static void mdns_ask_instance( mdns_question_t* questions, int* count, const char* name )
+{
+  mdns_cache_entry_t* srv = mdns_cache_lookup( RR_TYPE_SRV, name );
+
+  if ( srv == NULL ) {
+    mdns_add_question( questions, count, RR_TYPE_SRV, name );
+    mdns_add_question( questions, count, RR_TYPE_TXT, name );
+  } else
+    mdns_add_question( questions, count, RR_TYPE_A, srv->data );
+}
+
+static bool mdns_write_known_answer( mdns_message_t* msg, mdns_cache_entry_t* entry, uint32_t ttl )
+{
+  uint8_t* start = msg->iter;
+  uint8_t name_count = msg->name_count;
+  uint8_t* rd_length;
+  bool ok;
+
+  ok = mdns_write_name( msg, NULL, entry->name ) && mdns_write_uint16( msg, RR_TYPE_PTR )
+       && mdns_write_uint16( msg, RR_CLASS_IN ) && mdns_write_uint32( msg, ttl ) && mdns_write_uint16( msg, 0 );
+  rd_length = msg->iter;
+  ok = ok && mdns_write_name( msg, NULL, entry->data );
+  if ( !ok ) {
+    msg->iter = start;
+    msg->name_count = name_count;
+    return false;
+  }
+  rd_length[-2] = ( msg->iter - rd_length ) >> 8;
+  rd_length[-1] = ( msg->iter - rd_length ) & 0xFF;
+  return true;
+}
+
+static void mdns_send_query( int fd, mdns_question_t* questions, int count, uint32_t now )
+{
+  mdns_message_t query;
+  mdns_cache_entry_t* entry;
+  struct sockaddr_t addr;
+  uint8_t* start;
+  uint32_t left;
+  int i;
+
+  if ( !mdns_create_message( &query, 0 ) ) return;
+  query.header->flags = 0;
+
+  for ( i = 0; i < count; i++ ) {
+    start = query.iter;
+    if ( !mdns_write_name( &query, NULL, questions[i].name ) || !mdns_write_uint16( &query, questions[i].type )
+         || !mdns_write_uint16( &query, RR_CLASS_IN ) ) {
+      query.iter = start;
       break;
     }
+    query.question_count++;
+  }
+
+  /* RFC 6762 7.1: list the instances we hold with more than half of their TTL left,
+   * the answers that do not fit are simply left out */
+  for ( i = 0; i < query.question_count; i++ ) {
+    if ( questions[i].type != RR_TYPE_PTR ) continue;
+    for ( entry = mdns_cache; entry < mdns_cache + MDNS_CACHE_SIZE; entry++ ) {
+      if ( entry->name == NULL || entry->removed || entry->type != RR_TYPE_PTR
+           || !mdns_string_equal( entry->name, questions[i].name ) ) continue;
+      left = entry->ttl - ( now - entry->received );
+      if ( left <= entry->ttl / 2 ) continue;
+      if ( !mdns_write_known_answer( &query, entry, left / 1000 ) ) break;
+      query.answer_count++;
+    }
+  }
+
+  addr.s_ip = inet_addr( "224.0.0.251" );
+  addr.s_port = MDNS_PORT;
+  if ( query.question_count ) mdns_send_message( fd, &query, &addr );
+  mdns_free_message( &query );
+}
+
+static uint32_t mdns_refresh_time( mdns_cache_entry_t* entry )
+{
+  return entry->ttl / 100 * ( 80 + 5 * entry->refresh );
+}
+
+/* Expire the cache and send the queries that are due, returns the ms to the next one */
+static uint32_t mdns_query_poll( int fd, uint32_t now )
+{
+  mdns_question_t questions[MDNS_QUESTION_MAX];
+  mdns_cache_entry_t *entry, *other;
+  mdns_browse_t *browse, *same;
+  mdns_resolve_t* resolve;
+  uint32_t wait = MDNS_QUERY_INTERVAL_MIN, elapsed, interval;
+  int count = 0, pass;
+
+  /* PTR records stay until every browse was told that they are gone */
+  for ( entry = mdns_cache; entry < mdns_cache + MDNS_CACHE_SIZE; entry++ ) {
+    if ( entry->name == NULL ) continue;
+    elapsed = now - entry->received;
+    if ( elapsed < entry->ttl )
+      wait = Min( wait, entry->ttl - elapsed );
+    else if ( entry->type == RR_TYPE_PTR && entry->reported )
+      entry->removed = true;
     else
-    {
-      iter->iter += (uint32_t) *iter->iter + 1;
+      mdns_cache_free( entry );
+  }
+
+  /* Instances of the services browsed, their SRV and TXT records, then the A records of their hosts */
+  for ( pass = 0; pass < 3; pass++ ) {
+    for ( entry = mdns_cache; entry < mdns_cache + MDNS_CACHE_SIZE; entry++ ) {
+      if ( entry->name == NULL ) continue;
+      if ( pass == 0 && entry->type == RR_TYPE_PTR ) {
+        entry->live = !entry->removed && mdns_browse_find( entry->name ) != NULL;
+      } else if ( ( pass == 1 && ( entry->type == RR_TYPE_SRV || entry->type == RR_TYPE_TXT ) )
+                  || ( pass == 2 && entry->type == RR_TYPE_A ) ) {
+        entry->live = false;
+        for ( other = mdns_cache; other < mdns_cache + MDNS_CACHE_SIZE; other++ )
+          if ( other->name && other->live && other->type == ( pass == 1 ? RR_TYPE_PTR : RR_TYPE_SRV )
+               && mdns_string_equal( other->data, entry->name ) )
+            entry->live = true;
+      }
     }
-    if (iter->iter > iter->end)
-      break;
   }
-  // Skip the null u8
-  ++iter->iter;
+
+  /* Continuous browse queries, browses of one service share a schedule */
+  for ( browse = mdns_browses; browse < mdns_browses + MDNS_BROWSE_MAX; browse++ ) {
+    if ( browse->service_name == NULL ) continue;
+    if ( mdns_time_reached( now, browse->next_query ) ) {
+      mdns_add_question( questions, &count, RR_TYPE_PTR, browse->service_name );
+      interval = browse->interval;
+      for ( same = browse; same < mdns_browses + MDNS_BROWSE_MAX; same++ ) {
+        if ( same->service_name == NULL || !mdns_string_equal( same->service_name, browse->service_name ) ) continue;
+        same->next_query = now + interval;
+        same->interval = Min( interval * 2, MDNS_QUERY_INTERVAL_MAX );
+      }
+    }
+    wait = Min( wait, browse->next_query - now );
+  }
+
+  for ( entry = mdns_cache; entry < mdns_cache + MDNS_CACHE_SIZE; entry++ ) {
+    if ( entry->name == NULL || !entry->live ) continue;
+    elapsed = now - entry->received;
+
+    /* Refresh what the browses use before it expires */
+    if ( entry->refresh < MDNS_REFRESH_COUNT && elapsed >= mdns_refresh_time( entry ) ) {
+      mdns_add_question( questions, &count, entry->type, entry->name );
+      while ( entry->refresh < MDNS_REFRESH_COUNT && elapsed >= mdns_refresh_time( entry ) )
+        entry->refresh++;
+    }
+    if ( entry->refresh < MDNS_REFRESH_COUNT )
+      wait = Min( wait, mdns_refresh_time( entry ) - elapsed );
+
+    /* Instances announced without their SRV, TXT or A records */
+    if ( entry->type != RR_TYPE_PTR || entry->tries >= MDNS_RESOLVE_TRIES || mdns_instance_resolved( entry->data ) )
+      continue;
+    if ( entry->tries == 0 || mdns_time_reached( now, entry->queried + MDNS_QUERY_INTERVAL_MIN ) ) {
+      mdns_ask_instance( questions, &count, entry->data );
+      entry->queried = now;
+      entry->tries++;
+    }
+    wait = Min( wait, entry->queried + MDNS_QUERY_INTERVAL_MIN - now );
+  }
+
+  for ( resolve = mdns_resolves; resolve < mdns_resolves + MDNS_RESOLVE_MAX; resolve++ ) {
+    if ( resolve->name == NULL || resolve->resolved ) continue;
+    if ( mdns_time_reached( now, resolve->next_query ) ) {
+      mdns_ask_instance( questions, &count, resolve->name );
+      resolve->next_query = now + resolve->interval;
+      resolve->interval = Min( resolve->interval * 2, MDNS_QUERY_INTERVAL_MAX );
+    }
+    wait = Min( wait, resolve->next_query - now );
+  }
+
+  if ( count ) mdns_send_query( fd, questions, count, now );
+  return wait ? wait : 1;
+}
+
+/* Tell the browses about added, updated and removed instances, one at a
+ * time and with the mutex released, so the callback may use the mDNS API */
+static void mdns_browse_notify( void )
+{
+  static mdns_service_t service;
+  mdns_browse_callback_t callback = NULL;
+  mdns_service_event_t event = MDNS_SERVICE_ADDED;
+  mdns_cache_entry_t* entry;
+  mdns_browse_t* browse;
+  void* arg = NULL;
+  uint8_t bit;
+  bool found;
+  int i;
+
+  do {
+    found = false;
+    mico_rtos_lock_mutex( &bonjour_mutex );
+    for ( entry = mdns_cache; entry < mdns_cache + MDNS_CACHE_SIZE && !found; entry++ ) {
+      if ( entry->name == NULL || entry->type != RR_TYPE_PTR ) continue;
+      for ( i = 0; i < MDNS_BROWSE_MAX && !found; i++ ) {
+        browse = &mdns_browses[i];
+        bit = 1 << i;
+        if ( browse->service_name == NULL || !mdns_string_equal( browse->service_name, entry->name ) ) continue;
+
+        if ( entry->removed ) {
+          if ( !( entry->reported & bit ) ) continue;
+          mdns_cache_fill( entry->data, browse->service_name, &service );
+          event = MDNS_SERVICE_REMOVED;
+          entry->reported &= ~bit;
+        } else if ( !( entry->reported & bit ) || ( entry->updated & bit ) ) {
+          if ( !mdns_cache_fill( entry->data, browse->service_name, &service ) ) continue;
+          event = ( entry->reported & bit ) ? MDNS_SERVICE_UPDATED : MDNS_SERVICE_ADDED;
+          entry->reported |= bit;
+        } else
+          continue;
+        entry->updated &= ~bit;
+        callback = browse->callback;
+        arg = browse->arg;
+        found = true;
+      }
+    }
+    mico_rtos_unlock_mutex( &bonjour_mutex );
+    if ( found ) callback( event, &service, arg );
+  } while ( found );
+}
+
+OSStatus mdns_browse_start( char *service_name, mdns_browse_callback_t callback, void *arg )
+{
+  OSStatus err = kNoErr;
+  mdns_browse_t *browse = NULL, *same;
+  int i;
+
+  require_action( service_name && callback, exit, err = kParamErr );
+
+  if( bonjour_instance == false ){
+    err = start_bonjour_service( );
+    require_noerr(err, exit);
+  }
+
+  mico_rtos_lock_mutex( &bonjour_mutex );
+
+  for ( i = 0; i < MDNS_BROWSE_MAX && browse == NULL; i++ )
+    if ( mdns_browses[i].service_name == NULL ) browse = &mdns_browses[i];
+  require_action( browse, unlock, err = kNoResourcesErr );
+
+  browse->service_name = (char*)__strdup( service_name );
+  require_action( browse->service_name, unlock, err = kNoMemoryErr );
+  browse->callback = callback;
+  browse->arg = arg;
+  browse->next_query = mico_get_time( );
+  browse->interval = MDNS_QUERY_INTERVAL_MIN;
+
+  /* Join a browse of the same service: the instances it found are reported
+   * from the cache, the service is not queried any more often */
+  for ( same = mdns_browses; same < mdns_browses + MDNS_BROWSE_MAX; same++ ) {
+    if ( same == browse || same->service_name == NULL || !mdns_string_equal( same->service_name, service_name ) ) continue;
+    browse->next_query = same->next_query;
+    browse->interval = same->interval;
+    break;
+  }
+  mico_rtos_set_semaphore( &query_sem );
+
+unlock:
+  mico_rtos_unlock_mutex( &bonjour_mutex );
+exit:
+  return err;
+}
+
+OSStatus mdns_browse_stop( char *service_name, mdns_browse_callback_t callback, void *arg )
+{
+  OSStatus err = kNotFoundErr;
+  mdns_browse_t* browse;
+  int i, j;
+
+  if( bonjour_instance == false ) return err;
+
+  mico_rtos_lock_mutex( &bonjour_mutex );
+
+  for ( i = 0; i < MDNS_BROWSE_MAX; i++ ) {
+    browse = &mdns_browses[i];
+    if ( browse->service_name == NULL || browse->callback != callback || browse->arg != arg
+         || !mdns_string_equal( browse->service_name, service_name ) ) continue;
+    free( browse->service_name );
+    memset( browse, 0, sizeof(mdns_browse_t) );
+    /* Records only this browse needed stay cached until they expire */
+    for ( j = 0; j < MDNS_CACHE_SIZE; j++ ) {
+      mdns_cache[j].reported &= ~( 1 << i );
+      mdns_cache[j].updated &= ~( 1 << i );
+    }
+    err = kNoErr;
+    break;
+  }
+
+  mico_rtos_unlock_mutex( &bonjour_mutex );
+  return err;
 }
 
-static void dns_write_name( dns_message_iterator_t* iter, const char* src )
+OSStatus mdns_resolve( char *instance_name, char *service_name, mdns_service_t *service, uint32_t timeout_ms )
 {
-  dns_write_string( iter, src );
+  OSStatus err = kNoErr;
+  mdns_resolve_t* resolve = NULL;
+  char* name = NULL;
+  int i;
+
+  require_action( instance_name && service_name && service, exit, err = kParamErr );
+
+  if( bonjour_instance == false ){
+    err = start_bonjour_service( );
+    require_noerr(err, exit);
+  }
+
+  name = malloc( strlen( instance_name ) + strlen( service_name ) + 2 );
+  require_action( name, exit, err = kNoMemoryErr );
+  sprintf( name, "%s.%s", instance_name, service_name );
+
+  mico_rtos_lock_mutex( &bonjour_mutex );
+
+  /* Served from the cache, no query at all */
+  if ( mdns_cache_fill( name, service_name, service ) ) {
+    mico_rtos_unlock_mutex( &bonjour_mutex );
+    goto exit;
+  }
+
+  for ( i = 0; i < MDNS_RESOLVE_MAX && resolve == NULL; i++ )
+    if ( mdns_resolves[i].name == NULL ) resolve = &mdns_resolves[i];
+  if ( resolve == NULL || mico_rtos_init_semaphore( &resolve->done, 1 ) != kNoErr ) {
+    mico_rtos_unlock_mutex( &bonjour_mutex );
+    err = kNoResourcesErr;
+    goto exit;
+  }
+  resolve->name = name;
+  resolve->next_query = mico_get_time( );
+  resolve->interval = MDNS_QUERY_INTERVAL_MIN;
+  resolve->resolved = false;
+  name = NULL;
+  mico_rtos_set_semaphore( &query_sem );
+  mico_rtos_unlock_mutex( &bonjour_mutex );
+
+  mico_rtos_get_semaphore( &resolve->done, timeout_ms );
+
+  mico_rtos_lock_mutex( &bonjour_mutex );
+  if ( !mdns_cache_fill( resolve->name, service_name, service ) )
+    err = kTimeoutErr;
+  free( resolve->name );
+  resolve->name = NULL;
+  mico_rtos_deinit_semaphore( &resolve->done );
+  mico_rtos_unlock_mutex( &bonjour_mutex );
+
+exit:
+  if ( name ) free( name );
+  return err;
 }
 
 static bool is_service_match ( dns_sd_service_record_t *record, char *service_name, WiFi_Interface interface )
@@ -546,7 +1529,6 @@ static void _clean_record_resource( dns_sd_service_record_t *record )
 
 OSStatus mdns_add_record( mdns_init_t init, WiFi_Interface interface, uint32_t time_to_live )
 {
-  int len;
   OSStatus err = kNoErr;
   uint32_t insert_index = 0xFF;
 
@@ -569,13 +1551,7 @@ OSStatus mdns_add_record( mdns_init_t init, WiFi_Interface interface, uint32_t t
   available_services[insert_index].service_name = (char*)__strdup(init.service_name);
   available_services[insert_index].hostname = (char*)__strdup(init.host_name);
 
-  len = strlen(init.instance_name);
-  available_services[insert_index].instance_name = (char*)malloc(len+3);//// 0xc00c+\0
-  memcpy(available_services[insert_index].instance_name, init.instance_name, len);
-  available_services[insert_index].instance_name[len]= 0xc0;
-  available_services[insert_index].instance_name[len+1]= 0x0c;
-  available_services[insert_index].instance_name[len+2]= 0;
-  
+  available_services[insert_index].instance_name = (char*)__strdup(init.instance_name);
   available_services[insert_index].txt_att = (char*)__strdup(init.txt_record);
 
   available_services[insert_index].port = init.service_port;
@@ -680,10 +1656,13 @@ exit:
   return;
 }
 
-void mdns_handler(int fd, uint8_t* pkt, int pkt_len)
+void mdns_handler(int fd, uint8_t* pkt, int pkt_len, struct sockaddr_t* from)
 {
   dns_message_iterator_t iter;
   
+  if ( pkt_len < (int) sizeof(dns_message_header_t) )
+    return;
+
   iter.header = (dns_message_header_t*) pkt;
   iter.iter   = (uint8_t*) iter.header + sizeof(dns_message_header_t);
   iter.end = pkt+pkt_len;
@@ -691,47 +1670,50 @@ void mdns_handler(int fd, uint8_t* pkt, int pkt_len)
   // Check if the message is a response (otherwise its a query)
   if ( ntohs(iter.header->flags) & DNS_MESSAGE_IS_A_RESPONSE )
   {
+    mdns_process_response( &iter, from );
   }
   else
   {
-    process_dns_questions(fd, &iter );
+    mdns_process_query(fd, &iter, from );
   }
 }
 
+/* Announce or withdraw one service, all of its records in one packet */
 void bonjour_send_record(int record_index)
 {
-  dns_message_iterator_t response;
+  dns_sd_service_record_t* record = &available_services[record_index];
+  mdns_message_t response;
   uint32_t myip;
-  IPStatusTypedef para;
+  uint32_t now = mico_get_time( );
   int ttl  = 0;
+  int kind;
 
   /* Send service and a ttl > 0 for a working record*/
-  if( available_services[record_index].state == RECORD_NORMAL || available_services[record_index].state == RECORD_UPDATE ){
-    ttl = available_services[record_index].ttl;
-    
-    if(dns_create_message( &response, 512 )) {
-      dns_write_header(&response, 0x0, 0x8400, 0, available_service_count, 0 );          
-      dns_write_record( &response, SERVICE_QUERY_NAME, RR_CLASS_IN, RR_TYPE_PTR, 1500, (uint8_t*) available_services[record_index].service_name );
-      mdns_send_message(mDNS_fd, &response );
-      dns_free_message( &response );
-    }
-  }
-  micoWlanGetIPStatus(&para, available_services[record_index].interface);
-  myip = htonl(inet_addr(para.ip));
-  if( myip == 0 || myip == 0xFFFFFFFF) return;
+  if( mdns_record_active( record ) )
+    ttl = record->ttl;
 
+  myip = mdns_record_ip( record );
+  if( ttl == 0 && myip == 0 ) return;
 
-  if(dns_create_message( &response, 512 )){
-    mdns_utils_log( "TTL = %d",  ttl);
-    micoWlanGetIPStatus(&para, available_services[record_index].interface);
-    dns_write_header( &response, 0x0, 0x8400, 0, 4, 0 );
-    dns_write_record( &response, available_services[record_index].service_name, RR_CLASS_IN, RR_TYPE_PTR, ttl, (uint8_t*) available_services[record_index].instance_name );
-    dns_write_record( &response, available_services[record_index].instance_name, RR_CACHE_FLUSH|RR_CLASS_IN, RR_TYPE_TXT, ttl, (uint8_t*) available_services[record_index].txt_att );
-    dns_write_record( &response, available_services[record_index].instance_name, RR_CACHE_FLUSH|RR_CLASS_IN, RR_TYPE_SRV, ttl, (uint8_t*) &available_services[record_index]);
-    dns_write_record( &response, available_services[record_index].hostname, RR_CACHE_FLUSH|RR_CLASS_IN, RR_TYPE_A, ttl, (uint8_t*) &myip);
-    mdns_send_message(mDNS_fd, &response );
-    dns_free_message( &response );
+  if( !mdns_create_message( &response, 0 ) ) return;
+  mdns_utils_log( "TTL = %d",  ttl);
+
+  if( ttl && mdns_write_record( &response, record, MDNS_RR_META, SERVICE_QUERY_TTL, myip, true ) ){
+    response.answer_count++;
+    record->last_multicast[MDNS_RR_META] = now;
   }
+
+  if( myip != 0 ){
+    for( kind = MDNS_RR_PTR; kind < MDNS_RR_KINDS; kind++ ){
+      if( !mdns_write_record( &response, record, kind, ttl, myip, true ) ) break;
+      response.answer_count++;
+      record->last_multicast[kind] = now;
+    }
+  }
+
+  if( response.answer_count )
+    mdns_send_message( mDNS_fd, &response, NULL );
+  mdns_free_message( &response );
 }
 
 void BonjourNotify_WifiStatusHandler( WiFiEvent event, void *arg )
@@ -779,6 +1761,11 @@ static OSStatus start_bonjour_service(void)
 
   update_state_fd = mico_create_event_fd( update_state_sem );
 
+  if(query_sem == NULL)
+    mico_rtos_init_semaphore( &query_sem, 1 );
+
+  query_fd = mico_create_event_fd( query_sem );
+
   memset( available_services, 0x0, sizeof( available_services ) );
 
   
@@ -799,7 +1786,8 @@ static OSStatus start_bonjour_service(void)
   err = mico_system_notify_register( mico_notify_SYS_WILL_POWER_OFF, (void *)BonjourNotify_SYSWillPoerOffHandler, NULL );
   require_noerr( err, exit );
 
-  err = mico_rtos_create_thread(&mfi_bonjour_thread_handler, MICO_APPLICATION_PRIORITY, "Bonjour", _bonjour_thread, 0x500, NULL );
+  /* Browse callbacks run on this stack as well */
+  err = mico_rtos_create_thread(&mfi_bonjour_thread_handler, MICO_APPLICATION_PRIORITY, "Bonjour", _bonjour_thread, 0x800, NULL );
   require_noerr(err, exit);
 
   bonjour_instance = true;
@@ -811,6 +1799,7 @@ exit:
 void _bonjour_thread(void *arg)
 {
   int i, con = -1;
+  uint32_t wait;
   struct timeval_t t;
   fd_set readfds;
   struct sockaddr_t addr;
@@ -818,16 +1807,26 @@ void _bonjour_thread(void *arg)
   //OSStatus err = kNoErr;
   UNUSED_PARAMETER( arg );
 
-  t.tv_sec = 1;
-  t.tv_usec = 0;
-  
   while(1) {
+    /* Queries of the browses and resolves, and what they found */
+    mico_rtos_lock_mutex( &bonjour_mutex );
+    wait = mdns_query_poll( mDNS_fd, mico_get_time( ) );
+    mico_rtos_unlock_mutex( &bonjour_mutex );
+    mdns_browse_notify( );
+
+    t.tv_sec = wait / 1000;
+    t.tv_usec = ( wait % 1000 ) * 1000;
+
     /*Check status on erery sockets on bonjour query */
     FD_ZERO(&readfds);
     FD_SET(mDNS_fd, &readfds);
     FD_SET(update_state_fd, &readfds);
+    FD_SET(query_fd, &readfds);
     select(mDNS_fd + 1, &readfds, NULL, NULL, &t);
 
+    if ( FD_ISSET( query_fd, &readfds ) )
+      mico_rtos_get_semaphore( &query_sem, 0 );
+
     if ( FD_ISSET( update_state_fd, &readfds ) ){ 
       mdns_utils_log( "sem recved" );
       mico_rtos_get_semaphore( &update_state_sem, 0 );
@@ -867,9 +1866,11 @@ void _bonjour_thread(void *arg)
     
     /*Read data from udp and send data back */ 
     if (FD_ISSET(mDNS_fd, &readfds)) {
+      addrLen = sizeof(addr);
       con = recvfrom(mDNS_fd, buf, 1500, 0, &addr, &addrLen); 
+      if (con <= 0) continue;
       mico_rtos_lock_mutex( &bonjour_mutex );
-      mdns_handler(mDNS_fd, (uint8_t *)buf, con);
+      mdns_handler(mDNS_fd, (uint8_t *)buf, con, &addr);
       mico_rtos_unlock_mutex( &bonjour_mutex );
     }
   }
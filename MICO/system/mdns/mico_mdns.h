@@ -132,4 +132,7 @@ typedef struct
 
 
 
+/* Query fixtures against the responder and a loopback test of the querier, see mico_mdns_test.c */
+OSStatus mico_mdns_test( int print );
+
 #endif
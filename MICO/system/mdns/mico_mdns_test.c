@@ -0,0 +1,812 @@
+/**
+******************************************************************************
+* @file    mico_mdns_test.c
+* @version V1.0.0
+* @date    17-Oct-2026
+* @brief   Packet fixture test of the mDNS responder: queries as phones send
+*          them are fed to mdns_handler() and every packet sent back is
+*          decoded and checked. Then a loopback test of the querier and its
+*          cache: a simulated peer and our own responder share one virtual
+*          link with the browses and resolves. Built on the host together with
+*          libraries/utilities/StringUtils.c; it includes mico_mdns.c and
+*          stands in for the sockets, the RTOS and the Wi-Fi status below.
+*          Not part of the default build.
+******************************************************************************
+* @attention
+*
+* THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+* WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+* TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+* DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+* FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+* CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+*
+* <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+******************************************************************************
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mico_mdns.c"
+
+#define MDNS_TEST_SENT_MAX      16
+#define MDNS_TEST_RR_MAX        16
+#define MDNS_TEST_NAME_SIZE     128
+
+#define MDNS_TEST_IP            0xC0A80164  /* 192.168.1.100, our station address */
+#define MDNS_TEST_MULTICAST     0xE00000FB
+#define MDNS_TEST_INSTANCE      "MiCOKit#A1B2C3._easylink._tcp.local."
+
+/* A packet the responder sent */
+typedef struct
+{
+  uint32_t  src;        /* Sender on the loopback link */
+  uint32_t  ip;
+  uint16_t  port;
+  int       len;
+  uint8_t   data[MDNS_MESSAGE_SIZE];
+} mdns_test_packet_t;
+
+/* A packet read back, names as dotted strings */
+typedef struct
+{
+  uint16_t  id;
+  uint16_t  flags;
+  int       question_count;
+  int       answer_count;
+  int       rr_count;
+  char      question[MDNS_TEST_NAME_SIZE];
+  struct {
+    char      name[MDNS_TEST_NAME_SIZE];
+    uint16_t  type;
+    uint16_t  rr_class;
+    uint32_t  ttl;
+    char      data[MDNS_TEST_NAME_SIZE + 8];  /* SRV: port and target */
+  } rr[MDNS_TEST_RR_MAX];
+} mdns_test_message_t;
+
+static mdns_test_packet_t mdns_test_sent[MDNS_TEST_SENT_MAX];
+static int mdns_test_sent_count;
+static unsigned long mdns_test_packets, mdns_test_bytes;
+static uint32_t mdns_test_now = 100000;
+static uint32_t mdns_test_seed = 1;
+static int mdns_test_queries, mdns_test_known_answers;
+
+static void mdns_test_run( uint32_t ms );
+
+/* Stand-ins for the platform */
+
+uint32_t mico_get_time( void )
+{
+  return mdns_test_now;
+}
+
+OSStatus micoWlanGetIPStatus( IPStatusTypedef *outNetpara, WiFi_Interface inInterface )
+{
+  memset( outNetpara, 0x0, sizeof(IPStatusTypedef) );
+  strcpy( outNetpara->ip, ( inInterface == Station ) ? "192.168.1.100" : "0.0.0.0" );
+  return kNoErr;
+}
+
+uint32_t inet_addr( char *s )
+{
+  unsigned a, b, c, d;
+
+  if ( sscanf( s, "%u.%u.%u.%u", &a, &b, &c, &d ) != 4 ) return 0xFFFFFFFF;
+  return a << 24 | b << 16 | c << 8 | d;
+}
+
+char *inet_ntoa( char *s, uint32_t x )
+{
+  sprintf( s, "%u.%u.%u.%u", (unsigned)( x >> 24 ), (unsigned)( x >> 16 & 0xFF ),
+           (unsigned)( x >> 8 & 0xFF ), (unsigned)( x & 0xFF ) );
+  return s;
+}
+
+ssize_t sendto( int sockfd, const void *buf, size_t len, int flags, const struct sockaddr_t *dest_addr, socklen_t addrlen )
+{
+  mdns_test_packet_t *packet;
+
+  /* The broadcast copy of a multicast reaches the same phones */
+  if ( dest_addr->s_ip == 0xFFFFFFFF ) return len;
+  mdns_test_packets++;
+  mdns_test_bytes += len;
+  if ( mdns_test_sent_count == MDNS_TEST_SENT_MAX || len > MDNS_MESSAGE_SIZE ) return -1;
+  if ( !( mdns_read_uint16( (const uint8_t*)buf + 2 ) & DNS_MESSAGE_IS_A_RESPONSE ) ) {
+    mdns_test_queries++;
+    mdns_test_known_answers += mdns_read_uint16( (const uint8_t*)buf + 6 );
+  }
+  packet = &mdns_test_sent[mdns_test_sent_count++];
+  packet->src = MDNS_TEST_IP;
+  packet->ip = dest_addr->s_ip;
+  packet->port = dest_addr->s_port;
+  packet->len = len;
+  memcpy( packet->data, buf, len );
+  return len;
+}
+
+ssize_t recvfrom( int sockfd, void *buf, size_t len, int flags, struct sockaddr_t *src_addr, socklen_t *addrlen ) { return -1; }
+int socket( int domain, int type, int protocol ) { return 1; }
+int setsockopt( int sockfd, int level, int optname, const void *optval, socklen_t optlen ) { return 0; }
+int bind( int sockfd, const struct sockaddr_t *addr, socklen_t addrlen ) { return 0; }
+int select( int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval_t *timeout ) { return 0; }
+int mico_create_event_fd( mico_event handle ) { return 2; }
+OSStatus mico_system_notify_register( mico_notify_types_t notify_type, void* functionAddress, void* arg ) { return kNoErr; }
+OSStatus mico_rtos_create_thread( mico_thread_t* thread, uint8_t priority, const char* name, mico_thread_function_t function, uint32_t stack_size, void* arg ) { return kNoErr; }
+OSStatus mico_rtos_delete_thread( mico_thread_t* thread ) { return kNoErr; }
+void mico_thread_msleep( uint32_t milliseconds ) { mdns_test_now += milliseconds; }
+OSStatus mico_rtos_init_mutex( mico_mutex_t* mutex ) { return kNoErr; }
+OSStatus mico_rtos_lock_mutex( mico_mutex_t* mutex ) { return kNoErr; }
+OSStatus mico_rtos_unlock_mutex( mico_mutex_t* mutex ) { return kNoErr; }
+
+/* A semaphore is a count, waiting on it runs the bonjour thread until it is set */
+OSStatus mico_rtos_init_semaphore( mico_semaphore_t* semaphore, int count )
+{
+  *semaphore = calloc( 1, sizeof(int) );
+  return ( *semaphore ) ? kNoErr : kNoMemoryErr;
+}
+
+OSStatus mico_rtos_set_semaphore( mico_semaphore_t* semaphore )
+{
+  ( *(int*)*semaphore )++;
+  return kNoErr;
+}
+
+OSStatus mico_rtos_get_semaphore( mico_semaphore_t* semaphore, uint32_t timeout_ms )
+{
+  int *count = (int*)*semaphore;
+  uint32_t end = mdns_test_now + timeout_ms;
+
+  while ( *count == 0 && (int32_t)( end - mdns_test_now ) > 0 )
+    mdns_test_run( 10 );
+  if ( *count == 0 ) return kTimeoutErr;
+  ( *count )--;
+  return kNoErr;
+}
+
+OSStatus mico_rtos_deinit_semaphore( mico_semaphore_t* semaphore )
+{
+  free( *semaphore );
+  *semaphore = NULL;
+  return kNoErr;
+}
+
+/* Building queries */
+
+static uint8_t *mdns_test_put_name( uint8_t *p, const char *name )
+{
+  const char *dot;
+
+  while ( *name ) {
+    dot = strchr( name, '.' );
+    *p++ = dot - name;
+    memcpy( p, name, dot - name );
+    p += dot - name;
+    name = dot + 1;
+  }
+  *p++ = 0;
+  return p;
+}
+
+static uint8_t *mdns_test_put_uint16( uint8_t *p, uint16_t v )
+{
+  *p++ = v >> 8;
+  *p++ = v & 0xFF;
+  return p;
+}
+
+static uint8_t *mdns_test_put_question( uint8_t *p, const char *name, uint16_t type, uint16_t question_class )
+{
+  p = mdns_test_put_name( p, name );
+  p = mdns_test_put_uint16( p, type );
+  return mdns_test_put_uint16( p, question_class );
+}
+
+static uint8_t *mdns_test_put_rr( uint8_t *p, const char *name, uint16_t type, uint16_t rr_class, uint32_t ttl,
+                                  const void *rdata, int rd_length )
+{
+  p = mdns_test_put_name( p, name );
+  p = mdns_test_put_uint16( p, type );
+  p = mdns_test_put_uint16( p, rr_class );
+  p = mdns_test_put_uint16( p, ttl >> 16 );
+  p = mdns_test_put_uint16( p, ttl & 0xFFFF );
+  p = mdns_test_put_uint16( p, rd_length );
+  memcpy( p, rdata, rd_length );
+  return p + rd_length;
+}
+
+/* A known answer: a PTR record from name to target */
+static uint8_t *mdns_test_put_ptr( uint8_t *p, const char *name, const char *target, uint32_t ttl )
+{
+  uint8_t *rd_length;
+
+  p = mdns_test_put_name( p, name );
+  p = mdns_test_put_uint16( p, RR_TYPE_PTR );
+  p = mdns_test_put_uint16( p, RR_CLASS_IN );
+  p = mdns_test_put_uint16( p, ttl >> 16 );
+  p = mdns_test_put_uint16( p, ttl & 0xFFFF );
+  rd_length = p;
+  p = mdns_test_put_name( p + 2, target );
+  mdns_test_put_uint16( rd_length, p - rd_length - 2 );
+  return p;
+}
+
+static int mdns_test_header( uint8_t *packet, uint16_t id, int questions, int answers )
+{
+  memset( packet, 0x0, sizeof(dns_message_header_t) );
+  mdns_test_put_uint16( packet, id );
+  mdns_test_put_uint16( packet + 4, questions );
+  mdns_test_put_uint16( packet + 6, answers );
+  return sizeof(dns_message_header_t);
+}
+
+/* Deliver a query, the reply goes into mdns_test_sent */
+static void mdns_test_query( const uint8_t *packet, int len, uint32_t ip, uint16_t port )
+{
+  static uint8_t copy[1500];
+  struct sockaddr_t from;
+
+  memset( &from, 0x0, sizeof(from) );
+  from.s_ip = ip;
+  from.s_port = port;
+  memcpy( copy, packet, len );
+  mdns_test_sent_count = 0;
+  mdns_handler( 1, copy, len, &from );
+}
+
+/* Reading replies back */
+
+/* A name as a dotted string; compression pointers may only point back */
+static const uint8_t *mdns_test_get_name( const uint8_t *start, const uint8_t *end, const uint8_t *p, char *out )
+{
+  const uint8_t *next = NULL, *limit = p;
+  int pos = 0;
+
+  while ( p < end ) {
+    if ( ( *p & 0xC0 ) == 0xC0 ) {
+      if ( p + 1 >= end ) return NULL;
+      if ( next == NULL ) next = p + 2;
+      p = start + ( ( p[0] & 0x3F ) << 8 | p[1] );
+      if ( p >= limit ) return NULL;
+      limit = p;
+      continue;
+    }
+    if ( *p > 63 || p + 1 + *p > end || pos + *p + 2 > MDNS_TEST_NAME_SIZE ) return NULL;
+    if ( *p == 0 ) {
+      out[pos] = '\0';
+      return next ? next : p + 1;
+    }
+    memcpy( out + pos, p + 1, *p );
+    pos += *p;
+    out[pos++] = '.';
+    p += 1 + *p;
+  }
+  return NULL;
+}
+
+static OSStatus mdns_test_decode( const mdns_test_packet_t *packet, mdns_test_message_t *msg )
+{
+  const uint8_t *start = packet->data, *end = packet->data + packet->len, *p, *rdata;
+  uint16_t rd_length;
+  char name[MDNS_TEST_NAME_SIZE];
+  int i, k, pos;
+
+  memset( msg, 0x0, sizeof(mdns_test_message_t) );
+  if ( packet->len < (int)sizeof(dns_message_header_t) ) return kMalformedErr;
+  msg->id = mdns_read_uint16( start );
+  msg->flags = mdns_read_uint16( start + 2 );
+  msg->question_count = mdns_read_uint16( start + 4 );
+  msg->answer_count = mdns_read_uint16( start + 6 );
+  msg->rr_count = msg->answer_count + mdns_read_uint16( start + 10 );
+  if ( mdns_read_uint16( start + 8 ) != 0 || msg->rr_count > MDNS_TEST_RR_MAX ) return kMalformedErr;
+
+  p = start + sizeof(dns_message_header_t);
+  for ( i = 0; i < msg->question_count; i++ ) {
+    p = mdns_test_get_name( start, end, p, msg->question );
+    if ( p == NULL || p + 4 > end ) return kMalformedErr;
+    p += 4;
+  }
+  for ( i = 0; i < msg->rr_count; i++ ) {
+    p = mdns_test_get_name( start, end, p, msg->rr[i].name );
+    if ( p == NULL || p + 10 > end ) return kMalformedErr;
+    msg->rr[i].type = mdns_read_uint16( p );
+    msg->rr[i].rr_class = mdns_read_uint16( p + 2 );
+    msg->rr[i].ttl = mdns_read_uint32( p + 4 );
+    rd_length = mdns_read_uint16( p + 8 );
+    rdata = p + 10;
+    p = rdata + rd_length;
+    if ( p > end ) return kMalformedErr;
+
+    switch ( msg->rr[i].type ) {
+      case RR_TYPE_PTR:
+        if ( mdns_test_get_name( start, end, rdata, msg->rr[i].data ) != p ) return kMalformedErr;
+        break;
+      case RR_TYPE_SRV:
+        if ( rd_length < 7 || mdns_test_get_name( start, end, rdata + 6, name ) != p ) return kMalformedErr;
+        snprintf( msg->rr[i].data, sizeof(msg->rr[i].data), "%u %s", mdns_read_uint16( rdata + 4 ), name );
+        break;
+      case RR_TYPE_TXT:
+        /* Strings joined by '|' */
+        for ( k = 0, pos = 0; k < rd_length; k += 1 + rdata[k] ) {
+          if ( k + 1 + rdata[k] > rd_length || pos + rdata[k] + 2 > MDNS_TEST_NAME_SIZE ) return kMalformedErr;
+          if ( pos ) msg->rr[i].data[pos++] = '|';
+          memcpy( msg->rr[i].data + pos, rdata + k + 1, rdata[k] );
+          pos += rdata[k];
+        }
+        msg->rr[i].data[pos] = '\0';
+        break;
+      case RR_TYPE_A:
+        if ( rd_length != 4 ) return kMalformedErr;
+        sprintf( msg->rr[i].data, "%u.%u.%u.%u", rdata[0], rdata[1], rdata[2], rdata[3] );
+        break;
+      default:
+        return kMalformedErr;
+    }
+  }
+  return ( p == end ) ? kNoErr : kMalformedErr;
+}
+
+/* The record of type and name in the answers (or the additionals), NULL if absent */
+static const char *mdns_test_find( const mdns_test_message_t *msg, bool additional, uint16_t type, const char *name )
+{
+  int i;
+
+  for ( i = additional ? msg->answer_count : 0; i < ( additional ? msg->rr_count : msg->answer_count ); i++ )
+    if ( msg->rr[i].type == type && strcmp( msg->rr[i].name, name ) == 0 )
+      return msg->rr[i].data;
+  return NULL;
+}
+
+static bool mdns_test_has( const mdns_test_message_t *msg, bool additional, uint16_t type, const char *name, const char *data )
+{
+  const char *found = mdns_test_find( msg, additional, type, name );
+  return found != NULL && strcmp( found, data ) == 0;
+}
+
+/* The one packet the last query got, decoded, sent to ip:port */
+static bool mdns_test_reply( mdns_test_message_t *msg, uint32_t ip, uint16_t port )
+{
+  if ( mdns_test_sent_count != 1 ) return false;
+  if ( mdns_test_sent[0].ip != ip || mdns_test_sent[0].port != port ) return false;
+  if ( mdns_test_decode( &mdns_test_sent[0], msg ) != kNoErr ) return false;
+  return ( msg->flags & DNS_MESSAGE_IS_A_RESPONSE ) != 0;
+}
+
+#define mdns_test_check( cond, what ) \
+  do { if ( !( cond ) ) { if ( print ) printf( "%s\r\n", what ); err = kMismatchErr; goto exit; } } while ( 0 )
+
+/* Truncated and corrupted copies of a query must not upset the responder,
+   and whatever it sends must still decode */
+static bool mdns_test_damaged( const uint8_t *packet, int len )
+{
+  static uint8_t damaged[1500];
+  mdns_test_message_t msg;
+  int cut, i, k;
+
+  for ( cut = 0; cut < len; cut++ ) {
+    mdns_test_now += MDNS_MULTICAST_INTERVAL;
+    mdns_test_query( packet, cut, 0xC0A80132, MDNS_PORT );
+    for ( k = 0; k < mdns_test_sent_count; k++ )
+      if ( mdns_test_decode( &mdns_test_sent[k], &msg ) != kNoErr ) return false;
+  }
+  for ( i = 0; i < 200; i++ ) {
+    memcpy( damaged, packet, len );
+    for ( k = 0; k < 3; k++ ) {
+      mdns_test_seed = mdns_test_seed * 1103515245 + 12345;
+      damaged[( mdns_test_seed >> 16 ) % len] = mdns_test_seed >> 8;
+    }
+    mdns_test_now += MDNS_MULTICAST_INTERVAL;
+    mdns_test_query( damaged, len, 0xC0A80132, MDNS_PORT );
+    for ( k = 0; k < mdns_test_sent_count; k++ )
+      if ( mdns_test_decode( &mdns_test_sent[k], &msg ) != kNoErr ) return false;
+  }
+  return true;
+}
+
+/* The loopback link: a simulated peer announces Broker._mqtt._tcp.local.
+   on broker.local., 192.168.1.50:1883 */
+
+#define MDNS_TEST_PEER_IP       0xC0A80132
+#define MDNS_TEST_PEER_SERVICE  "_mqtt._tcp.local."
+#define MDNS_TEST_PEER_INSTANCE "Broker._mqtt._tcp.local."
+#define MDNS_TEST_PEER_HOST     "broker.local."
+
+static struct
+{
+  uint32_t    ttl;
+  bool        ptr_only;     /* A browse gets the PTR record alone */
+  bool        silent;
+  const char* txt;          /* TXT record data as sent */
+  int         responses;
+  int         suppressed;   /* Browses not answered for our known answer */
+} mdns_test_peer;
+
+static int mdns_test_events[2][3];
+static mdns_service_t mdns_test_found[2];
+
+static void mdns_test_peer_send( bool ptr, bool srv, bool txt, bool a, uint32_t ttl )
+{
+  static const uint8_t ip[4] = { 192, 168, 1, 50 };
+  mdns_test_packet_t *packet;
+  uint8_t rdata[MDNS_TEST_NAME_SIZE], *p;
+  int count = 0, len;
+
+  if ( mdns_test_sent_count == MDNS_TEST_SENT_MAX ) return;
+  packet = &mdns_test_sent[mdns_test_sent_count++];
+  mdns_test_header( packet->data, 0, 0, 0 );
+  mdns_test_put_uint16( packet->data + 2, DNS_MESSAGE_IS_A_RESPONSE | DNS_MESSAGE_AUTHORITATIVE );
+  p = packet->data + sizeof(dns_message_header_t);
+  if ( ptr ) {
+    len = mdns_test_put_name( rdata, MDNS_TEST_PEER_INSTANCE ) - rdata;
+    p = mdns_test_put_rr( p, MDNS_TEST_PEER_SERVICE, RR_TYPE_PTR, RR_CLASS_IN, ttl, rdata, len );
+    count++;
+  }
+  if ( srv ) {
+    memset( rdata, 0x0, 4 );
+    mdns_test_put_uint16( rdata + 4, 1883 );
+    len = mdns_test_put_name( rdata + 6, MDNS_TEST_PEER_HOST ) - rdata;
+    p = mdns_test_put_rr( p, MDNS_TEST_PEER_INSTANCE, RR_TYPE_SRV, RR_CLASS_IN | RR_CACHE_FLUSH, ttl, rdata, len );
+    count++;
+  }
+  if ( txt ) {
+    p = mdns_test_put_rr( p, MDNS_TEST_PEER_INSTANCE, RR_TYPE_TXT, RR_CLASS_IN | RR_CACHE_FLUSH, ttl,
+                          mdns_test_peer.txt, strlen( mdns_test_peer.txt ) );
+    count++;
+  }
+  if ( a ) {
+    p = mdns_test_put_rr( p, MDNS_TEST_PEER_HOST, RR_TYPE_A, RR_CLASS_IN | RR_CACHE_FLUSH, ttl, ip, sizeof(ip) );
+    count++;
+  }
+  mdns_test_put_uint16( packet->data + 6, count );
+  packet->len = p - packet->data;
+  packet->src = MDNS_TEST_PEER_IP;
+  mdns_test_peer.responses++;
+}
+
+/* The peer answers questions for its records, a browse only if our known
+   answer has less than half its TTL left */
+static void mdns_test_peer_query( const mdns_test_packet_t *packet )
+{
+  const uint8_t *start = packet->data, *end = packet->data + packet->len, *p, *name;
+  bool ptr = false, srv = false, txt = false, a = false;
+  uint16_t type;
+  int i;
+
+  if ( mdns_test_peer.silent || ( mdns_read_uint16( start + 2 ) & DNS_MESSAGE_IS_A_RESPONSE ) ) return;
+  p = start + sizeof(dns_message_header_t);
+  for ( i = 0; i < mdns_read_uint16( start + 4 ); i++ ) {
+    name = p;
+    p = mdns_skip_name( p, end );
+    if ( p == NULL || p + 4 > end ) return;
+    type = mdns_read_uint16( p );
+    p += 4;
+    if ( type == RR_TYPE_PTR && mdns_name_equal( start, end, name, NULL, MDNS_TEST_PEER_SERVICE ) ) ptr = true;
+    if ( type == RR_TYPE_SRV && mdns_name_equal( start, end, name, NULL, MDNS_TEST_PEER_INSTANCE ) ) srv = true;
+    if ( type == RR_TYPE_TXT && mdns_name_equal( start, end, name, NULL, MDNS_TEST_PEER_INSTANCE ) ) txt = true;
+    if ( type == RR_TYPE_A && mdns_name_equal( start, end, name, NULL, MDNS_TEST_PEER_HOST ) ) a = true;
+  }
+  for ( i = 0; i < mdns_read_uint16( start + 6 ) && ptr; i++ ) {
+    p = mdns_skip_name( p, end );
+    if ( p == NULL || p + 10 > end ) return;
+    if ( mdns_read_uint16( p ) == RR_TYPE_PTR && mdns_name_equal( start, end, p + 10, NULL, MDNS_TEST_PEER_INSTANCE )
+         && mdns_read_uint32( p + 4 ) >= mdns_test_peer.ttl / 2 ) {
+      ptr = false;
+      mdns_test_peer.suppressed++;
+    }
+    p += 10 + mdns_read_uint16( p + 8 );
+  }
+  if ( ptr || srv || txt || a )
+    mdns_test_peer_send( ptr, srv || ( ptr && !mdns_test_peer.ptr_only ), txt || ( ptr && !mdns_test_peer.ptr_only ),
+                         a || ( ptr && !mdns_test_peer.ptr_only ), mdns_test_peer.ttl );
+}
+
+/* Every packet on the link reaches the peer and our socket, our own as well */
+static void mdns_test_deliver( void )
+{
+  static mdns_test_packet_t packet;
+  struct sockaddr_t from;
+
+  while ( mdns_test_sent_count ) {
+    packet = mdns_test_sent[0];
+    memmove( mdns_test_sent, mdns_test_sent + 1, --mdns_test_sent_count * sizeof(mdns_test_packet_t) );
+    if ( packet.src != MDNS_TEST_PEER_IP ) mdns_test_peer_query( &packet );
+    memset( &from, 0x0, sizeof(from) );
+    from.s_ip = packet.src;
+    from.s_port = MDNS_PORT;
+    mdns_handler( 1, packet.data, packet.len, &from );
+  }
+}
+
+/* The bonjour thread, in steps of 10 ms */
+static void mdns_test_run( uint32_t ms )
+{
+  uint32_t end = mdns_test_now + ms;
+
+  do {
+    mdns_query_poll( 1, mdns_test_now );
+    mdns_test_deliver( );
+    mdns_browse_notify( );
+    mdns_test_deliver( );
+    mdns_test_now += 10;
+  } while ( (int32_t)( end - mdns_test_now ) > 0 );
+}
+
+static void mdns_test_browse_callback( mdns_service_event_t event, const mdns_service_t *service, void *arg )
+{
+  int browse = (int)(intptr_t)arg;
+
+  mdns_test_events[browse][event]++;
+  mdns_test_found[browse] = *service;
+}
+
+static OSStatus mdns_test_querier( int print )
+{
+  mdns_service_t service;
+  mdns_cache_entry_t *srv, *a;
+  int queries, responses, i;
+  OSStatus err = kNoErr;
+
+  mdns_test_sent_count = 0;
+  mdns_test_now += 2000;
+  mdns_test_peer.ttl = 120;
+  mdns_test_peer.ptr_only = true;
+  mdns_test_peer.txt = "\x09ver=3.1.1\x05tls=0";
+  mdns_test_queries = 0;
+
+  /* The peer answers the browse with its PTR alone: the SRV and TXT, then
+     the A record are asked for */
+  err = mdns_browse_start( MDNS_TEST_PEER_SERVICE, mdns_test_browse_callback, (void*)0 );
+  require_noerr( err, exit );
+  mdns_test_run( 500 );
+  mdns_test_check( mdns_test_events[0][MDNS_SERVICE_ADDED] == 1 && strcmp( mdns_test_found[0].ip, "192.168.1.50" ) == 0 &&
+                   mdns_test_found[0].service_port == 1883 && strcmp( mdns_test_found[0].instance_name, "Broker" ) == 0 &&
+                   strcmp( mdns_test_found[0].host_name, MDNS_TEST_PEER_HOST ) == 0 &&
+                   strcmp( mdns_test_found[0].txt_record, "ver=3/.1/.1.tls=0" ) == 0, "querier: browse did not resolve" );
+  mdns_test_check( mdns_test_queries == 3 && mdns_test_peer.responses == 3, "querier: not PTR, SRV and TXT, then A" );
+  if ( print ) printf( "Browse resolved the peer with %d queries\r\n", mdns_test_queries );
+
+  /* A second browse and a resolve of the same service come from the cache */
+  queries = mdns_test_queries;
+  err = mdns_browse_start( MDNS_TEST_PEER_SERVICE, mdns_test_browse_callback, (void*)1 );
+  require_noerr( err, exit );
+  mdns_test_run( 20 );
+  mdns_test_check( mdns_test_events[1][MDNS_SERVICE_ADDED] == 1 && mdns_test_queries == queries, "querier: second browse not from the cache" );
+  err = mdns_resolve( "Broker", MDNS_TEST_PEER_SERVICE, &service, 1000 );
+  require_noerr( err, exit );
+  mdns_test_check( mdns_test_queries == queries && strcmp( service.ip, "192.168.1.50" ) == 0 && service.service_port == 1883,
+                   "querier: resolve not from the cache" );
+
+  /* Continuous queries 1, 3, 7, 15 and 31 s after the first, each with the
+     PTR as a known answer that the peer does not answer again */
+  queries = mdns_test_queries;
+  responses = mdns_test_peer.responses;
+  mdns_test_known_answers = 0;
+  mdns_test_run( 60000 );
+  mdns_test_check( mdns_test_queries - queries == 5 && mdns_test_peer.suppressed == 5 && mdns_test_known_answers == 5 &&
+                   mdns_test_peer.responses == responses, "querier: no backoff or known answer" );
+  mdns_test_check( mdns_test_events[0][MDNS_SERVICE_ADDED] == 1 && mdns_test_events[1][MDNS_SERVICE_ADDED] == 1,
+                   "querier: added twice" );
+  if ( print ) printf( "%d queries in the next 60 s, the peer answered none\r\n", mdns_test_queries - queries );
+
+  /* A new TXT record announced by the peer reaches both browses */
+  mdns_test_peer.txt = "\x09ver=5.0.0\x05tls=1";
+  mdns_test_peer_send( false, false, true, false, mdns_test_peer.ttl );
+  mdns_test_run( 20 );
+  mdns_test_check( mdns_test_events[0][MDNS_SERVICE_UPDATED] == 1 && mdns_test_events[1][MDNS_SERVICE_UPDATED] == 1 &&
+                   strcmp( mdns_test_found[1].txt_record, "ver=5/.0/.0.tls=1" ) == 0, "querier: TXT update not reported" );
+
+  /* Refreshed at 80% of the TTL, the records never come close to expiry */
+  for ( i = 0; i < 120; i++ ) {
+    mdns_test_run( 1000 );
+    srv = mdns_cache_lookup( RR_TYPE_SRV, MDNS_TEST_PEER_INSTANCE );
+    a = mdns_cache_lookup( RR_TYPE_A, MDNS_TEST_PEER_HOST );
+    mdns_test_check( srv && a && mdns_test_now - srv->received < srv->ttl / 100 * 85 &&
+                     mdns_test_now - a->received < a->ttl / 100 * 85, "querier: records not refreshed" );
+  }
+  mdns_test_check( mdns_test_events[0][MDNS_SERVICE_REMOVED] == 0, "querier: refreshed instance removed" );
+
+  /* Expires once the peer is silent */
+  mdns_test_peer.silent = true;
+  mdns_test_run( 130000 );
+  mdns_test_check( mdns_test_events[0][MDNS_SERVICE_REMOVED] == 1 && mdns_test_events[1][MDNS_SERVICE_REMOVED] == 1,
+                   "querier: silent peer not removed" );
+  mdns_test_peer.silent = false;
+
+  /* Comes back with every record at once, then says goodbye: removed one second later */
+  mdns_test_peer.ptr_only = false;
+  mdns_test_peer_send( true, true, true, true, mdns_test_peer.ttl );
+  mdns_test_run( 20 );
+  mdns_test_check( mdns_test_events[0][MDNS_SERVICE_ADDED] == 2 && mdns_test_events[1][MDNS_SERVICE_ADDED] == 2,
+                   "querier: returning peer not added" );
+  mdns_test_peer_send( true, false, false, false, 0 );
+  mdns_test_run( 500 );
+  mdns_test_check( mdns_test_events[0][MDNS_SERVICE_REMOVED] == 1, "querier: goodbye acted on at once" );
+  mdns_test_run( 600 );
+  mdns_test_check( mdns_test_events[0][MDNS_SERVICE_REMOVED] == 2 && mdns_test_events[1][MDNS_SERVICE_REMOVED] == 2,
+                   "querier: goodbye not acted on" );
+
+  /* A stopped browse hears nothing more, the other one does */
+  mdns_test_check( mdns_browse_stop( MDNS_TEST_PEER_SERVICE, mdns_test_browse_callback, (void*)0 ) == kNoErr &&
+                   mdns_browse_stop( MDNS_TEST_PEER_SERVICE, mdns_test_browse_callback, (void*)0 ) == kNotFoundErr,
+                   "querier: browse not stopped once" );
+  mdns_test_peer_send( true, true, true, true, mdns_test_peer.ttl );
+  mdns_test_run( 20 );
+  mdns_test_check( mdns_test_events[0][MDNS_SERVICE_ADDED] == 2 && mdns_test_events[1][MDNS_SERVICE_ADDED] == 3,
+                   "querier: stopped browse still reported" );
+
+  /* Our own service, answered by our responder */
+  err = mdns_resolve( "MiCOKit#A1B2C3", "_easylink._tcp.local.", &service, 3000 );
+  require_noerr( err, exit );
+  mdns_test_check( strcmp( service.ip, "192.168.1.100" ) == 0 && service.service_port == 8000 &&
+                   strcmp( service.txt_record, "MAC=C8:93:46:A1:B2:C3.Firmware Rev=MICO_BASE_1/.0.Seed=42" ) == 0,
+                   "querier: own service resolved wrong" );
+  mdns_test_check( mdns_resolve( "Nobody", "_easylink._tcp.local.", &service, 2000 ) == kTimeoutErr,
+                   "querier: unknown instance resolved" );
+  err = mdns_browse_start( "_easylink._tcp.local.", mdns_test_browse_callback, (void*)0 );
+  require_noerr( err, exit );
+  mdns_test_run( 1500 );
+  mdns_test_check( mdns_test_events[0][MDNS_SERVICE_ADDED] == 3 && strcmp( mdns_test_found[0].instance_name, "MiCOKit#A1B2C3" ) == 0,
+                   "querier: own service not browsed" );
+
+exit:
+  return err;
+}
+
+OSStatus mico_mdns_test( int print )
+{
+  static uint8_t query[1500];
+  mdns_test_message_t msg;
+  mdns_init_t init;
+  uint8_t *p;
+  int i, len, count;
+  OSStatus err = kNoErr;
+
+  /* Two services on the station, one on the soft AP which has no address */
+  init.service_name = "_easylink._tcp.local.";
+  init.host_name = "MiCOKit#A1B2C3.local.";
+  init.instance_name = "MiCOKit#A1B2C3";
+  init.txt_record = "MAC=C8/:93/:46/:A1/:B2/:C3.Firmware Rev=MICO_BASE_1/.0.Seed=42.";
+  init.service_port = 8000;
+  err = mdns_add_record( init, Station, 1500 );
+  require_noerr( err, exit );
+  init.service_name = "_http._tcp.local.";
+  init.txt_record = "path=/.";
+  init.service_port = 80;
+  err = mdns_add_record( init, Station, 1500 );
+  require_noerr( err, exit );
+  init.service_name = "_ftp._tcp.local.";
+  err = mdns_add_record( init, Soft_AP, 1500 );
+  require_noerr( err, exit );
+
+  /* A phone browses: one multicast with the PTR, and the SRV, TXT (with its
+     closing empty string) and A it needs next; the service name is written
+     once and pointed to after */
+  len = mdns_test_header( query, 0, 1, 0 );
+  len = mdns_test_put_question( query + len, "_easylink._tcp.local.", RR_TYPE_PTR, RR_CLASS_IN ) - query;
+  mdns_test_query( query, len, 0xC0A80132, MDNS_PORT );
+  mdns_test_check( mdns_test_reply( &msg, MDNS_TEST_MULTICAST, MDNS_PORT ), "browse: no single multicast reply" );
+  mdns_test_check( msg.id == 0 && msg.flags == ( DNS_MESSAGE_IS_A_RESPONSE | DNS_MESSAGE_AUTHORITATIVE ) &&
+                   msg.question_count == 0 && msg.answer_count == 1 && msg.rr_count == 4, "browse: wrong header" );
+  mdns_test_check( mdns_test_has( &msg, false, RR_TYPE_PTR, "_easylink._tcp.local.", MDNS_TEST_INSTANCE ) &&
+                   mdns_test_has( &msg, true, RR_TYPE_SRV, MDNS_TEST_INSTANCE, "8000 MiCOKit#A1B2C3.local." ) &&
+                   mdns_test_has( &msg, true, RR_TYPE_TXT, MDNS_TEST_INSTANCE, "MAC=C8:93:46:A1:B2:C3|Firmware Rev=MICO_BASE_1.0|Seed=42|" ) &&
+                   mdns_test_has( &msg, true, RR_TYPE_A, "MiCOKit#A1B2C3.local.", "192.168.1.100" ), "browse: wrong records" );
+  for ( i = 0; i < msg.rr_count; i++ )
+    mdns_test_check( msg.rr[i].ttl == 1500 && ( msg.rr[i].rr_class == RR_CLASS_IN ) == ( msg.rr[i].type == RR_TYPE_PTR ) &&
+                     ( msg.rr[i].rr_class & ~RR_CACHE_FLUSH ) == RR_CLASS_IN, "browse: wrong TTL or cache flush bit" );
+  for ( i = 0, count = 0; i + 9 < mdns_test_sent[0].len; i++ )
+    if ( memcmp( mdns_test_sent[0].data + i, "\x09_easylink", 10 ) == 0 ) count++;
+  mdns_test_check( count == 1, "browse: names not compressed" );
+  if ( print ) printf( "Browse answered in one %d byte packet\r\n", mdns_test_sent[0].len );
+
+  /* A second phone 20 ms later gets nothing, it heard the first answer */
+  mdns_test_now += 20;
+  mdns_test_query( query, len, 0xC0A80133, MDNS_PORT );
+  mdns_test_check( mdns_test_sent_count == 0, "browse: multicast twice within a second" );
+
+  /* Known answer with at least half our TTL suppresses the PTR, and the
+     additionals are not sent alone */
+  mdns_test_now += MDNS_MULTICAST_INTERVAL;
+  len = mdns_test_header( query, 0, 1, 1 );
+  p = mdns_test_put_question( query + len, "_easylink._tcp.local.", RR_TYPE_PTR, RR_CLASS_IN );
+  len = mdns_test_put_ptr( p, "_easylink._tcp.local.", MDNS_TEST_INSTANCE, 750 ) - query;
+  mdns_test_query( query, len, 0xC0A80132, MDNS_PORT );
+  mdns_test_check( mdns_test_sent_count == 0, "known answer: not suppressed" );
+
+  /* With less than half left it is answered again */
+  len = mdns_test_put_ptr( p, "_easylink._tcp.local.", MDNS_TEST_INSTANCE, 749 ) - query;
+  mdns_test_query( query, len, 0xC0A80132, MDNS_PORT );
+  mdns_test_check( mdns_test_reply( &msg, MDNS_TEST_MULTICAST, MDNS_PORT ) && msg.answer_count == 1, "known answer: stale one suppressed" );
+
+  /* SRV and TXT for the instance, the A record goes along */
+  mdns_test_now += MDNS_MULTICAST_INTERVAL;
+  len = mdns_test_header( query, 0, 2, 0 );
+  p = mdns_test_put_question( query + len, MDNS_TEST_INSTANCE, RR_TYPE_SRV, RR_CLASS_IN );
+  len = mdns_test_put_question( p, MDNS_TEST_INSTANCE, RR_TYPE_TXT, RR_CLASS_IN ) - query;
+  mdns_test_query( query, len, 0xC0A80132, MDNS_PORT );
+  mdns_test_check( mdns_test_reply( &msg, MDNS_TEST_MULTICAST, MDNS_PORT ) && msg.answer_count == 2 && msg.rr_count == 3 &&
+                   mdns_test_find( &msg, false, RR_TYPE_SRV, MDNS_TEST_INSTANCE ) &&
+                   mdns_test_find( &msg, false, RR_TYPE_TXT, MDNS_TEST_INSTANCE ) &&
+                   mdns_test_find( &msg, true, RR_TYPE_A, "MiCOKit#A1B2C3.local." ), "resolve: wrong records" );
+
+  /* Service type enumeration lists every service type once */
+  mdns_test_now += MDNS_MULTICAST_INTERVAL;
+  len = mdns_test_header( query, 0, 1, 0 );
+  len = mdns_test_put_question( query + len, SERVICE_QUERY_NAME, RR_TYPE_PTR, RR_CLASS_IN ) - query;
+  mdns_test_query( query, len, 0xC0A80132, MDNS_PORT );
+  mdns_test_check( mdns_test_reply( &msg, MDNS_TEST_MULTICAST, MDNS_PORT ) &&
+                   mdns_test_has( &msg, false, RR_TYPE_PTR, SERVICE_QUERY_NAME, "_easylink._tcp.local." ), "enumeration: wrong records" );
+  for ( i = 0, count = 0; i < msg.answer_count; i++ )
+    if ( strcmp( msg.rr[i].data, "_http._tcp.local." ) == 0 ) count++;
+  mdns_test_check( count == 1, "enumeration: _http not listed once" );
+
+  /* ANY for the instance */
+  mdns_test_now += MDNS_MULTICAST_INTERVAL;
+  len = mdns_test_header( query, 0, 1, 0 );
+  len = mdns_test_put_question( query + len, MDNS_TEST_INSTANCE, RR_QTYPE_ANY, RR_CLASS_IN ) - query;
+  mdns_test_query( query, len, 0xC0A80134, MDNS_PORT );
+  mdns_test_check( mdns_test_reply( &msg, MDNS_TEST_MULTICAST, MDNS_PORT ) && msg.answer_count == 2 &&
+                   mdns_test_find( &msg, true, RR_TYPE_A, "MiCOKit#A1B2C3.local." ), "ANY: wrong records" );
+
+  /* A legacy resolver gets a unicast reply with its ID and question, short
+     TTLs and no cache flush bits, even right after a multicast */
+  len = mdns_test_header( query, 0x1234, 1, 0 );
+  len = mdns_test_put_question( query + len, "_easylink._tcp.local.", RR_TYPE_PTR, RR_CLASS_IN ) - query;
+  mdns_test_query( query, len, 0xC0A8013C, 40000 );
+  mdns_test_check( mdns_test_reply( &msg, 0xC0A8013C, 40000 ) && msg.id == 0x1234 && msg.question_count == 1 &&
+                   strcmp( msg.question, "_easylink._tcp.local." ) == 0 && msg.answer_count == 1, "legacy: wrong reply" );
+  for ( i = 0; i < msg.rr_count; i++ )
+    mdns_test_check( msg.rr[i].ttl <= MDNS_LEGACY_UNICAST_TTL && msg.rr[i].rr_class == RR_CLASS_IN, "legacy: wrong TTL or class" );
+
+  /* A QU question is answered to the asker only, also right after a multicast */
+  len = mdns_test_header( query, 0, 1, 0 );
+  len = mdns_test_put_question( query + len, "_easylink._tcp.local.", RR_TYPE_PTR, RR_CLASS_IN | MDNS_QU_BIT ) - query;
+  mdns_test_query( query, len, 0xC0A8013D, MDNS_PORT );
+  mdns_test_check( mdns_test_reply( &msg, 0xC0A8013D, MDNS_PORT ) && msg.id == 0 && msg.answer_count == 1, "QU: no unicast reply" );
+
+  /* Two service types, one of them known */
+  mdns_test_now += MDNS_MULTICAST_INTERVAL;
+  len = mdns_test_header( query, 0, 2, 1 );
+  p = mdns_test_put_question( query + len, "_easylink._tcp.local.", RR_TYPE_PTR, RR_CLASS_IN );
+  p = mdns_test_put_question( p, "_http._tcp.local.", RR_TYPE_PTR, RR_CLASS_IN );
+  len = mdns_test_put_ptr( p, "_http._tcp.local.", "MiCOKit#A1B2C3._http._tcp.local.", 1500 ) - query;
+  mdns_test_query( query, len, 0xC0A80135, MDNS_PORT );
+  mdns_test_check( mdns_test_reply( &msg, MDNS_TEST_MULTICAST, MDNS_PORT ) && msg.answer_count == 1 &&
+                   mdns_test_has( &msg, false, RR_TYPE_PTR, "_easylink._tcp.local.", MDNS_TEST_INSTANCE ) &&
+                   !mdns_test_find( &msg, true, RR_TYPE_SRV, "MiCOKit#A1B2C3._http._tcp.local." ), "two types: known one answered" );
+
+  /* Five phones within 200 ms get one packet between them */
+  mdns_test_now += MDNS_MULTICAST_INTERVAL;
+  len = mdns_test_header( query, 0, 1, 0 );
+  len = mdns_test_put_question( query + len, "_easylink._tcp.local.", RR_TYPE_PTR, RR_CLASS_IN ) - query;
+  for ( i = 0, count = 0; i < 5; i++, mdns_test_now += 50 ) {
+    mdns_test_query( query, len, 0xC0A80146 + i, MDNS_PORT );
+    count += mdns_test_sent_count;
+  }
+  mdns_test_check( count == 1, "burst: more than one packet" );
+
+  /* Nothing for a host that is not us, or for a soft AP service without an address */
+  mdns_test_now += MDNS_MULTICAST_INTERVAL;
+  len = mdns_test_header( query, 0, 2, 0 );
+  p = mdns_test_put_question( query + len, "Other.local.", RR_TYPE_A, RR_CLASS_IN );
+  len = mdns_test_put_question( p, "_ftp._tcp.local.", RR_TYPE_PTR, RR_CLASS_IN ) - query;
+  mdns_test_query( query, len, 0xC0A80132, MDNS_PORT );
+  mdns_test_check( mdns_test_sent_count == 0, "answered for someone else" );
+
+  if ( print ) printf( "%lu packets, %lu bytes sent for the fixtures\r\n", mdns_test_packets, mdns_test_bytes );
+
+  /* Damaged queries */
+  len = mdns_test_header( query, 0, 2, 1 );
+  p = mdns_test_put_question( query + len, "_easylink._tcp.local.", RR_TYPE_PTR, RR_CLASS_IN );
+  p = mdns_test_put_question( p, MDNS_TEST_INSTANCE, RR_QTYPE_ANY, RR_CLASS_IN );
+  len = mdns_test_put_ptr( p, "_http._tcp.local.", "MiCOKit#A1B2C3._http._tcp.local.", 1500 ) - query;
+  mdns_test_check( mdns_test_damaged( query, len ), "damaged query: reply does not decode" );
+
+  err = mdns_test_querier( print );
+
+exit:
+  if ( print ) printf( "mico_mdns_test: %s\r\n", err == kNoErr ? "PASSED" : "FAILED" );
+  return err;
+}
@@ -0,0 +1,182 @@
+#!/usr/bin/env python
+"""Decode the raw output of the deferred custom_log backend.
+
+With MICO_DEFERRED_LOG enabled and "micodebug raw" (or MICO_DEFERRED_LOG_RAW),
+the target sends each log record in binary, as laid out in
+MICO/system/mico_system_log.c, behind the sync bytes 0xA5 0x5A. Format, module
+name and file name are only sent as pointers, they are read back from the
+firmware ELF image. Anything outside a record is passed through as text.
+
+usage: mico_log_decode.py firmware.elf [capture.bin | /dev/ttyUSB0]
+       (reads stdin without a second argument; set the tty to raw first,
+        e.g. stty -F /dev/ttyUSB0 115200 raw)
+"""
+
+import os
+import re
+import struct
+import sys
+
+SYNC = b'\xa5\x5a'
+HEADER = struct.Struct('<HHIIII')   # len, line, time, name, file, format
+RECORD_MAX = 4096
+LINE_PAD = 0xFFFF
+
+SPEC = re.compile(r'%([-+ #0]*)(\*|\d*)(?:\.(\*|\d*))?(hh|h|ll|l|q|j|z|t|L)?([diuxXocsfFeEgGaApn%])')
+
+
+class Elf(object):
+    """Loadable sections of a 32 bit little endian ELF, by address."""
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            data = f.read()
+        if data[:4] != b'\x7fELF' or data[4:5] != b'\x01' or data[5:6] != b'\x01':
+            raise ValueError('%s: not a 32 bit little endian ELF file' % path)
+        shoff, = struct.unpack_from('<I', data, 0x20)
+        shentsize, shnum = struct.unpack_from('<HH', data, 0x2e)
+        self.sections = []
+        for i in range(shnum):
+            (_, sh_type, flags, addr, offset, size) = struct.unpack_from('<IIIIII', data, shoff + i * shentsize)
+            # SHF_ALLOC sections with contents, not SHT_NOBITS
+            if flags & 0x2 and sh_type != 8 and addr and size:
+                self.sections.append((addr, size, data[offset:offset + size]))
+
+    def string(self, addr):
+        if addr == 0:
+            return '(null)'
+        for base, size, content in self.sections:
+            if base <= addr < base + size:
+                end = content.find(b'\0', addr - base)
+                if end < 0:
+                    end = size
+                return content[addr - base:end].decode('latin-1')
+        return '<0x%08x>' % addr
+
+
+def c_format(fmt, args):
+    """printf fmt with the argument bytes of a record, the target's way."""
+    out = []
+    pos = [0]
+
+    def take(size, signed=False):
+        if pos[0] + size > len(args):
+            raise IndexError
+        code = {4: 'i', 8: 'q'}[size]
+        v, = struct.unpack_from('<' + (code if signed else code.upper()), args, pos[0])
+        pos[0] = (pos[0] + size + 3) & ~3
+        return v
+
+    def take_double():
+        if pos[0] + 8 > len(args):
+            raise IndexError
+        v, = struct.unpack_from('<d', args, pos[0])
+        pos[0] += 8
+        return v
+
+    def take_string():
+        end = args.find(b'\0', pos[0])
+        if end < 0:
+            raise IndexError
+        v = args[pos[0]:end].decode('latin-1')
+        pos[0] = (end + 1 + 3) & ~3
+        return v
+
+    last = 0
+    try:
+        for m in SPEC.finditer(fmt):
+            out.append(fmt[last:m.start()])
+            last = m.end()
+            flags, width, prec, length, conv = m.groups()
+            if conv == '%':
+                out.append('%')
+                continue
+            if width == '*':
+                width = str(take(4, True))
+            if prec == '*':
+                prec = str(take(4, True))
+            spec = '%' + flags + (width or '') + ('.' + prec if prec is not None else '')
+            wide = length in ('ll', 'q', 'j')
+            if conv in 'di':
+                out.append((spec + 'd') % take(8 if wide else 4, True))
+            elif conv in 'uxXo':
+                out.append((spec + (conv if conv != 'u' else 'd')) % take(8 if wide else 4))
+            elif conv == 'c':
+                out.append((spec + 'c') % chr(take(4) & 0xff))
+            elif conv == 's':
+                out.append((spec + 's') % take_string())
+            elif conv == 'p':
+                out.append((spec + 's') % ('0x%x' % take(4)))
+            elif conv in 'aA':
+                out.append((spec + 's') % float.hex(take_double()))
+            elif conv == 'n':
+                pass
+            else:
+                out.append((spec + conv) % take_double())
+    except IndexError:
+        out.append('...')
+        return ''.join(out)
+    out.append(fmt[last:])
+    return ''.join(out)
+
+
+def decode_record(elf, record):
+    length, line, time, name, path, fmt = HEADER.unpack_from(record)
+    args = record[HEADER.size:length]
+    if fmt == 0:
+        return '[%d][LOG] %d records dropped' % (time, struct.unpack_from('<I', args)[0])
+    path = elf.string(path)
+    path = path[max(path.rfind('\\'), path.rfind('/')) + 1:]
+    return '[%d][%s: %s:%4d] %s' % (time, elf.string(name), path, line, c_format(elf.string(fmt), args))
+
+
+def decode_stream(elf, stream, out):
+    buf = b''
+    while True:
+        # os.read returns what is there, a live UART is not held back
+        chunk = os.read(stream.fileno(), 4096)
+        if not chunk:
+            break
+        buf += chunk
+        while True:
+            i = buf.find(SYNC)
+            if i < 0:
+                # Keep a trailing 0xA5, it may start the next sync
+                keep = 1 if buf.endswith(SYNC[:1]) else 0
+                out.write(buf[:len(buf) - keep].decode('latin-1'))
+                buf = buf[len(buf) - keep:]
+                break
+            out.write(buf[:i].decode('latin-1'))
+            buf = buf[i:]
+            if len(buf) < 2 + HEADER.size:
+                break
+            length, line = struct.unpack_from('<HH', buf, 2)
+            if length < HEADER.size or length % 4 or length > RECORD_MAX or line == LINE_PAD:
+                # Not a record after all
+                out.write(buf[:1].decode('latin-1'))
+                buf = buf[1:]
+                continue
+            if len(buf) < 2 + length:
+                break
+            out.write(decode_record(elf, buf[2:2 + length]) + '\r\n')
+            buf = buf[2 + length:]
+        out.flush()
+    out.write(buf.decode('latin-1'))
+    out.flush()
+
+
+def main(argv):
+    if len(argv) < 2 or len(argv) > 3:
+        sys.stderr.write(__doc__)
+        return 2
+    elf = Elf(argv[1])
+    if len(argv) == 3:
+        stream = open(argv[2], 'rb', 0)
+    else:
+        stream = getattr(sys.stdin, 'buffer', sys.stdin)
+    decode_stream(elf, stream, sys.stdout)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
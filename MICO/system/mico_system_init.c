@@ -83,6 +83,12 @@ OSStatus mico_system_init( mico_Context_t* in_context )
 
   require_action( in_context, exit, err = kNotPreparedErr );
 
+#if DEBUG && MICO_DEFERRED_LOG && !defined(MICO_DISABLE_STDIO)
+  /* Print the log records deferred by custom_log */
+  err = mico_system_log_daemon_start( );
+  require_noerr( err, exit );
+#endif
+
   /* Initialize power management daemen */
   err = mico_system_power_daemon_start( in_context );
   require_noerr( err, exit ); 
@@ -0,0 +1,599 @@
+/**
+******************************************************************************
+* @file    mico_system_log.c
+* @version V1.0.0
+* @date    17-Oct-2026
+* @brief   Deferred backend for custom_log. Call sites only store a compact
+*          binary record in a lock-free ring, a low priority thread formats
+*          the records or streams them raw to the stdio UART.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#include <stdarg.h>
+
+#include "MICO.h"
+#include "system.h"
+
+#if DEBUG && MICO_DEFERRED_LOG && !defined(MICO_DISABLE_STDIO)
+
+/* Ring size in bytes, a power of two */
+#ifndef MICO_DEFERRED_LOG_BUFFER_SIZE
+#define MICO_DEFERRED_LOG_BUFFER_SIZE   (2048)
+#endif
+
+/* Largest record, header and arguments (strings included), in bytes */
+#ifndef MICO_DEFERRED_LOG_RECORD_MAX
+#define MICO_DEFERRED_LOG_RECORD_MAX    (128)
+#endif
+
+/* Longest formatted line, in text mode */
+#ifndef MICO_DEFERRED_LOG_LINE_MAX
+#define MICO_DEFERRED_LOG_LINE_MAX      (256)
+#endif
+
+#ifndef MICO_DEFERRED_LOG_PRIORITY
+#define MICO_DEFERRED_LOG_PRIORITY      (8)
+#endif
+
+/* Drain thread poll period while the ring is empty, in ms */
+#ifndef MICO_DEFERRED_LOG_PERIOD
+#define MICO_DEFERRED_LOG_PERIOD        (20)
+#endif
+
+/* Start in raw mode instead of formatting on the target */
+#ifndef MICO_DEFERRED_LOG_RAW
+#define MICO_DEFERRED_LOG_RAW           (0)
+#endif
+
+#if ( MICO_DEFERRED_LOG_BUFFER_SIZE & ( MICO_DEFERRED_LOG_BUFFER_SIZE - 1 ) ) || ( MICO_DEFERRED_LOG_BUFFER_SIZE > 0x8000 )
+#error "MICO_DEFERRED_LOG_BUFFER_SIZE must be a power of two, 32K at most"
+#endif
+
+/* Orders the record body against the commit word and the index updates */
+#if defined ( __GNUC__ )
+#define log_barrier()            __sync_synchronize()
+#define log_cas( p, o, n )       __sync_bool_compare_and_swap( p, o, n )
+#elif defined ( __ICCARM__ )
+#include <intrinsics.h>
+#define log_barrier()            __DMB()
+static int log_cas( volatile uint32_t *p, uint32_t o, uint32_t n )
+{
+  do {
+    if ( __LDREX( (unsigned long *)p ) != o ) {
+      __CLREX();
+      return 0;
+    }
+  } while ( __STREX( n, (unsigned long *)p ) );
+  return 1;
+}
+#elif defined ( __CC_ARM ) //KEIL
+#define log_barrier()            __dmb(0xF)
+static int log_cas( volatile uint32_t *p, uint32_t o, uint32_t n )
+{
+  do {
+    if ( __ldrex( p ) != o ) {
+      __clrex();
+      return 0;
+    }
+  } while ( __strex( n, p ) );
+  return 1;
+}
+#else
+#error "No atomic compare and swap for this compiler"
+#endif
+
+/* Record layout, shared with the host decoder (mico_log_decode.py). The
+ * first word is written last and commits the record; a zero first word
+ * means reserved but not yet written. Arguments follow the header, each
+ * one padded to 4 bytes, strings copied with their NUL. */
+typedef struct
+{
+  uint16_t    len;              /* whole record in bytes, multiple of 4 */
+  uint16_t    line;
+  uint32_t    time;
+  const char* name;
+  const char* file;
+  const char* format;           /* NULL: dropped notice, one word count */
+} mico_log_record_t;
+
+#define LOG_LINE_PAD            (0xFFFFUL) /* skip to the end of the ring */
+
+#define LOG_RAW_SYNC0           (0xA5)
+#define LOG_RAW_SYNC1           (0x5A)
+
+enum
+{
+  LOG_ARG_NONE,                 /* %% */
+  LOG_ARG_INT,
+  LOG_ARG_LONG,
+  LOG_ARG_LLONG,
+  LOG_ARG_PTR,
+  LOG_ARG_DOUBLE,
+  LOG_ARG_STR,
+  LOG_ARG_COUNT,                /* %n, consumed and ignored */
+};
+
+typedef struct
+{
+  const char* start;            /* the '%' */
+  const char* end;              /* behind the conversion character */
+  uint8_t     type;
+  uint8_t     width_star;
+  uint8_t     prec_star;
+  uint8_t     long_double;
+  int         prec;             /* literal precision, -1 if none */
+} log_spec_t;
+
+static struct
+{
+  volatile uint32_t head;       /* reserved by producers */
+  volatile uint32_t tail;       /* released by the consumer */
+  volatile uint32_t busy;       /* consumer lock */
+  volatile uint32_t dropped;
+  volatile uint32_t truncated;
+  volatile uint32_t reported;   /* dropped count already in a notice */
+  volatile uint32_t drop_at;    /* head when the first record after the last notice was lost */
+  volatile uint32_t drop_time;
+  uint32_t          written;
+  uint32_t          max_used;
+  bool              raw;
+  bool              started;
+  uint32_t          buffer[MICO_DEFERRED_LOG_BUFFER_SIZE / 4];
+} log_ring = { .raw = MICO_DEFERRED_LOG_RAW };
+
+static char log_line[MICO_DEFERRED_LOG_LINE_MAX];
+
+static void log_atomic_inc( volatile uint32_t *p )
+{
+  uint32_t v;
+  do {
+    v = *p;
+  } while ( !log_cas( p, v, v + 1 ) );
+}
+
+/* Parse the conversion starting at p, same grammar for producer and drain */
+static OSStatus log_parse_spec( const char *p, log_spec_t *spec )
+{
+  int longs = 0;
+
+  spec->start = p++;
+  spec->width_star = spec->prec_star = spec->long_double = 0;
+  spec->prec = -1;
+
+  while ( *p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0' ) p++;
+  if ( *p == '*' ) {
+    spec->width_star = 1;
+    p++;
+  } else {
+    while ( *p >= '0' && *p <= '9' ) p++;
+  }
+  if ( *p == '.' ) {
+    p++;
+    if ( *p == '*' ) {
+      spec->prec_star = 1;
+      p++;
+    } else {
+      spec->prec = 0;
+      while ( *p >= '0' && *p <= '9' ) spec->prec = spec->prec * 10 + ( *p++ - '0' );
+    }
+  }
+  switch ( *p ) {
+    case 'h': while ( *p == 'h' ) p++; break;
+    case 'l': while ( *p == 'l' ) { longs++; p++; } break;
+    case 'q':
+    case 'j': longs = 2; p++; break;
+    case 'z':
+    case 't': longs = 1; p++; break;
+    case 'L': spec->long_double = 1; p++; break;
+  }
+
+  switch ( *p ) {
+    case '%': spec->type = LOG_ARG_NONE; break;
+    case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+      spec->type = ( longs >= 2 ) ? LOG_ARG_LLONG : ( longs ? LOG_ARG_LONG : LOG_ARG_INT );
+      break;
+    case 'c':
+      if ( longs ) return kUnsupportedErr;
+      spec->type = LOG_ARG_INT;
+      break;
+    case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+      spec->type = LOG_ARG_DOUBLE;
+      break;
+    case 's':
+      if ( longs ) return kUnsupportedErr;
+      spec->type = LOG_ARG_STR;
+      break;
+    case 'p': spec->type = LOG_ARG_PTR; break;
+    case 'n': spec->type = LOG_ARG_COUNT; break;
+    default: return kUnsupportedErr;
+  }
+  spec->end = p + 1;
+  return kNoErr;
+}
+
+/* Append size bytes at *pos, each argument starting on a word boundary */
+static bool log_put( uint8_t *rec, uint32_t *pos, const void *data, uint32_t size )
+{
+  if ( *pos + size > MICO_DEFERRED_LOG_RECORD_MAX ) return false;
+  memcpy( rec + *pos, data, size );
+  *pos = ( *pos + size + 3 ) & ~3UL;
+  return true;
+}
+
+static bool log_put_str( uint8_t *rec, uint32_t *pos, const char *str, int prec, bool *cut )
+{
+  uint32_t room, n;
+
+  if ( *pos >= MICO_DEFERRED_LOG_RECORD_MAX ) return false;
+  if ( str == NULL ) str = "(null)";
+  room = MICO_DEFERRED_LOG_RECORD_MAX - *pos - 1;
+  for ( n = 0; ( prec < 0 || n < (uint32_t)prec ) && str[n] != '\0'; n++ ) {
+    if ( n == room ) {
+      *cut = true;
+      break;
+    }
+  }
+  memcpy( rec + *pos, str, n );
+  rec[*pos + n] = '\0';
+  *pos = ( *pos + n + 1 + 3 ) & ~3UL;
+  return true;
+}
+
+void mico_system_log_deferred( const char *name, const char *file, int line, const char *format, ... )
+{
+  uint32_t buf[MICO_DEFERRED_LOG_RECORD_MAX / 4];
+  uint8_t *rec = (uint8_t *)buf;
+  mico_log_record_t *hdr = (mico_log_record_t *)buf;
+  uint32_t pos = sizeof(mico_log_record_t);
+  uint32_t head, pad, slot, word0;
+  bool cut = false;
+  const char *p;
+  log_spec_t spec;
+  va_list ap;
+  int i;
+  long l;
+  long long ll;
+  void *ptr;
+  double d;
+
+  hdr->time = mico_get_time( );
+  hdr->name = name;
+  hdr->file = file;
+  hdr->format = format;
+
+  /* Only what the format consumes is stored, strings by value since the
+     caller's buffers are gone by the time the drain thread gets to them */
+  va_start( ap, format );
+  for ( p = strchr( format, '%' ); p != NULL && !cut; p = strchr( spec.end, '%' ) ) {
+    if ( log_parse_spec( p, &spec ) != kNoErr ) break;
+    if ( spec.width_star ) {
+      i = va_arg( ap, int );
+      if ( !log_put( rec, &pos, &i, sizeof(int) ) ) cut = true;
+    }
+    if ( spec.prec_star ) {
+      spec.prec = i = va_arg( ap, int );
+      if ( !log_put( rec, &pos, &i, sizeof(int) ) ) cut = true;
+    }
+    if ( cut ) break;
+    switch ( spec.type ) {
+      case LOG_ARG_INT:
+        i = va_arg( ap, int );
+        cut = !log_put( rec, &pos, &i, sizeof(int) );
+        break;
+      case LOG_ARG_LONG:
+        l = va_arg( ap, long );
+        cut = !log_put( rec, &pos, &l, sizeof(long) );
+        break;
+      case LOG_ARG_LLONG:
+        ll = va_arg( ap, long long );
+        cut = !log_put( rec, &pos, &ll, sizeof(long long) );
+        break;
+      case LOG_ARG_PTR:
+      case LOG_ARG_COUNT:
+        ptr = va_arg( ap, void * );
+        if ( spec.type == LOG_ARG_PTR ) cut = !log_put( rec, &pos, &ptr, sizeof(void *) );
+        break;
+      case LOG_ARG_DOUBLE:
+        if ( spec.long_double )
+          d = (double)va_arg( ap, long double );
+        else
+          d = va_arg( ap, double );
+        cut = !log_put( rec, &pos, &d, sizeof(double) );
+        break;
+      case LOG_ARG_STR:
+        if ( !log_put_str( rec, &pos, va_arg( ap, const char * ), spec.prec, &cut ) ) cut = true;
+        break;
+      default:
+        break;
+    }
+  }
+  va_end( ap );
+  if ( pos > MICO_DEFERRED_LOG_RECORD_MAX ) pos = MICO_DEFERRED_LOG_RECORD_MAX;
+  if ( cut ) log_atomic_inc( &log_ring.truncated );
+
+  /* Reserve contiguous space, padding out the end of the ring if needed */
+  do {
+    head = log_ring.head;
+    pad = MICO_DEFERRED_LOG_BUFFER_SIZE - ( head & ( MICO_DEFERRED_LOG_BUFFER_SIZE - 1 ) );
+    if ( pad >= pos ) pad = 0;
+    if ( head + pad + pos - log_ring.tail > MICO_DEFERRED_LOG_BUFFER_SIZE ) {
+      /* The notice goes out behind the records that were in the ring */
+      if ( log_ring.dropped == log_ring.reported ) {
+        log_ring.drop_at = head;
+        log_ring.drop_time = hdr->time;
+      }
+      log_atomic_inc( &log_ring.dropped );
+      return;
+    }
+  } while ( !log_cas( &log_ring.head, head, head + pad + pos ) );
+
+  if ( pad ) {
+    slot = ( head & ( MICO_DEFERRED_LOG_BUFFER_SIZE - 1 ) ) / 4;
+    log_ring.buffer[slot] = pad | ( LOG_LINE_PAD << 16 );
+    head += pad;
+  }
+  slot = ( head & ( MICO_DEFERRED_LOG_BUFFER_SIZE - 1 ) ) / 4;
+  memcpy( &log_ring.buffer[slot + 1], rec + 4, pos - 4 );
+  log_barrier( );
+  hdr->len = (uint16_t)pos;
+  /* LOG_LINE_PAD marks padding, a real line stops just below it */
+  hdr->line = (uint16_t)( ( (uint32_t)line < LOG_LINE_PAD ) ? (uint32_t)line : LOG_LINE_PAD - 1 );
+  memcpy( &word0, hdr, 4 );
+  log_ring.buffer[slot] = word0;
+}
+
+static const uint8_t *log_get( const mico_log_record_t *rec, uint32_t *pos, uint32_t size )
+{
+  const uint8_t *p = (const uint8_t *)rec + *pos;
+
+  if ( *pos + size > rec->len ) return NULL;
+  *pos = ( *pos + size + 3 ) & ~3UL;
+  return p;
+}
+
+/* Length of the output once snprintf() returned ret for it at n, which stops
+   at the last byte of size */
+static int log_append( int n, int size, int ret )
+{
+  if ( ret < 0 ) return n;
+  return ( ret >= size - n ) ? size - 1 : n + ret;
+}
+
+/* printf the record into out, the way the synchronous custom_log does */
+static int log_format_record( const mico_log_record_t *rec, char *out, int size )
+{
+  const char *file = rec->file, *p, *lit;
+  const uint8_t *v;
+  char spec_text[24];
+  uint32_t pos = sizeof(mico_log_record_t);
+  int star[2];
+  log_spec_t spec;
+  int n, k, s, stars, i;
+  long l;
+  long long ll;
+  void *ptr;
+  double d;
+
+  if ( strrchr( file, '\\' ) ) file = strrchr( file, '\\' ) + 1;
+  n = log_append( 0, size, snprintf( out, size, "[%d][%s: %s:%4d] ", (int)rec->time, rec->name, file, rec->line ) );
+
+  lit = rec->format;
+  for ( p = strchr( lit, '%' ); p != NULL; p = strchr( lit, '%' ) ) {
+    if ( log_parse_spec( p, &spec ) != kNoErr ) break;
+    n = log_append( n, size, snprintf( out + n, size - n, "%.*s", (int)( p - lit ), lit ) );
+    lit = spec.end;
+
+    stars = 0;
+    if ( spec.width_star ) {
+      if ( ( v = log_get( rec, &pos, sizeof(int) ) ) == NULL ) goto truncated;
+      memcpy( &star[stars++], v, sizeof(int) );
+    }
+    if ( spec.prec_star ) {
+      if ( ( v = log_get( rec, &pos, sizeof(int) ) ) == NULL ) goto truncated;
+      memcpy( &star[stars++], v, sizeof(int) );
+    }
+
+    /* Rebuild the conversion with the '*' values filled in, no 'L' */
+    for ( k = 0, s = 0, stars = 0; spec.start + k < spec.end && s < (int)sizeof(spec_text) - 12; k++ ) {
+      if ( spec.start[k] == '*' )
+        s += sprintf( spec_text + s, "%d", (int)star[stars++] );
+      else if ( spec.start[k] != 'L' )
+        spec_text[s++] = spec.start[k];
+    }
+    spec_text[s] = '\0';
+
+    switch ( spec.type ) {
+      case LOG_ARG_NONE:
+        n = log_append( n, size, snprintf( out + n, size - n, "%%" ) );
+        break;
+      case LOG_ARG_INT:
+        if ( ( v = log_get( rec, &pos, sizeof(int) ) ) == NULL ) goto truncated;
+        memcpy( &i, v, sizeof(int) );
+        n = log_append( n, size, snprintf( out + n, size - n, spec_text, i ) );
+        break;
+      case LOG_ARG_LONG:
+        if ( ( v = log_get( rec, &pos, sizeof(long) ) ) == NULL ) goto truncated;
+        memcpy( &l, v, sizeof(long) );
+        n = log_append( n, size, snprintf( out + n, size - n, spec_text, l ) );
+        break;
+      case LOG_ARG_LLONG:
+        if ( ( v = log_get( rec, &pos, sizeof(long long) ) ) == NULL ) goto truncated;
+        memcpy( &ll, v, sizeof(long long) );
+        n = log_append( n, size, snprintf( out + n, size - n, spec_text, ll ) );
+        break;
+      case LOG_ARG_PTR:
+        if ( ( v = log_get( rec, &pos, sizeof(void *) ) ) == NULL ) goto truncated;
+        memcpy( &ptr, v, sizeof(void *) );
+        n = log_append( n, size, snprintf( out + n, size - n, spec_text, ptr ) );
+        break;
+      case LOG_ARG_DOUBLE:
+        if ( ( v = log_get( rec, &pos, sizeof(double) ) ) == NULL ) goto truncated;
+        memcpy( &d, v, sizeof(double) );
+        n = log_append( n, size, snprintf( out + n, size - n, spec_text, d ) );
+        break;
+      case LOG_ARG_STR:
+        v = (const uint8_t *)rec + pos;
+        if ( pos >= rec->len || memchr( v, '\0', rec->len - pos ) == NULL ) goto truncated;
+        log_get( rec, &pos, strlen( (const char *)v ) + 1 );
+        n = log_append( n, size, snprintf( out + n, size - n, spec_text, (const char *)v ) );
+        break;
+      default:
+        break;
+    }
+  }
+  n = log_append( n, size, snprintf( out + n, size - n, "%s", lit ) );
+  return n;
+
+truncated:
+  return log_append( n, size, snprintf( out + n, size - n, "..." ) );
+}
+
+static void log_emit( const mico_log_record_t *rec )
+{
+  static const uint8_t sync[2] = { LOG_RAW_SYNC0, LOG_RAW_SYNC1 };
+  int n;
+
+  mico_rtos_lock_mutex( &stdio_tx_mutex );
+  if ( log_ring.raw ) {
+    MicoUartSend( STDIO_UART, sync, sizeof(sync) );
+    MicoUartSend( STDIO_UART, rec, rec->len );
+  } else if ( rec->format == NULL ) {
+    memcpy( &n, rec + 1, sizeof(int) );
+    printf( "[%d][LOG] %d records dropped\r\n", (int)rec->time, n );
+  } else {
+    n = log_format_record( rec, log_line, (int)sizeof(log_line) - 2 );
+    log_line[n++] = '\r';
+    log_line[n++] = '\n';
+    log_line[n] = '\0';
+    printf( "%s", log_line );
+  }
+  mico_rtos_unlock_mutex( &stdio_tx_mutex );
+}
+
+/* Emit the dropped notice once the drain is at the point where records were
+   lost, that is behind every record that was in the ring then */
+static void log_report_dropped( uint32_t tail )
+{
+  uint32_t notice[sizeof(mico_log_record_t) / 4 + 1];
+  mico_log_record_t *rec = (mico_log_record_t *)notice;
+  uint32_t dropped = log_ring.dropped;
+
+  if ( dropped == log_ring.reported ) return;
+  log_barrier( );
+  if ( (int32_t)( tail - log_ring.drop_at ) < 0 ) return;
+
+  memset( notice, 0, sizeof(notice) );
+  rec->len = sizeof(notice);
+  rec->time = log_ring.drop_time;
+  notice[sizeof(mico_log_record_t) / 4] = dropped - log_ring.reported;
+  log_ring.reported = dropped;
+  log_emit( rec );
+}
+
+/* Emit every committed record, returns how many */
+static int log_drain( void )
+{
+  mico_log_record_t *rec;
+  uint32_t tail, word0, len, used;
+  int count = 0;
+
+  if ( !log_cas( &log_ring.busy, 0, 1 ) ) return 0;
+
+  tail = log_ring.tail;
+  used = log_ring.head - tail;
+  if ( used > log_ring.max_used ) log_ring.max_used = used;
+
+  while ( 1 ) {
+    log_report_dropped( tail );
+    if ( tail == log_ring.head ) break;
+    rec = (mico_log_record_t *)&log_ring.buffer[( tail & ( MICO_DEFERRED_LOG_BUFFER_SIZE - 1 ) ) / 4];
+    word0 = *(volatile uint32_t *)rec;
+    if ( word0 == 0 ) break; /* reserved, producer not done yet */
+    log_barrier( );
+    len = word0 & 0xFFFF;
+    if ( ( word0 >> 16 ) != LOG_LINE_PAD ) {
+      log_emit( rec );
+      log_ring.written++;
+      count++;
+    }
+    /* Producers detect their commit word on zeroed memory only */
+    memset( rec, 0, len );
+    log_barrier( );
+    tail += len;
+    log_ring.tail = tail;
+  }
+
+  log_ring.busy = 0;
+  return count;
+}
+
+/* Returns once every record reserved before the call is out, the drain
+   thread may hold the ring or a producer may still be writing one */
+void mico_system_log_flush( void )
+{
+  uint32_t head = log_ring.head;
+
+  while ( (int32_t)( head - log_ring.tail ) > 0 ) {
+    if ( log_drain( ) == 0 && (int32_t)( head - log_ring.tail ) > 0 )
+      mico_thread_msleep( 1 );
+  }
+}
+
+static void log_drain_thread( void *arg )
+{
+  (void)arg;
+
+  while ( 1 ) {
+    if ( log_drain( ) == 0 )
+      mico_thread_msleep( MICO_DEFERRED_LOG_PERIOD );
+  }
+}
+
+OSStatus mico_system_log_daemon_start( void )
+{
+  OSStatus err = kNoErr;
+
+  require_quiet( log_ring.started == false, exit );
+  err = mico_rtos_create_thread( NULL, MICO_DEFERRED_LOG_PRIORITY, "LOG DRAIN", log_drain_thread, STACK_SIZE_mico_system_LOG_THREAD, NULL );
+  require_noerr( err, exit );
+  log_ring.started = true;
+
+exit:
+  return err;
+}
+
+void mico_system_log_set_raw( bool raw )
+{
+  log_ring.raw = raw;
+}
+
+void mico_system_log_get_stats( mico_system_log_stats_t *stats )
+{
+  stats->written   = log_ring.written;
+  stats->dropped   = log_ring.dropped;
+  stats->truncated = log_ring.truncated;
+  stats->max_used  = log_ring.max_used;
+}
+
+#endif
@@ -0,0 +1,240 @@
+/**
+******************************************************************************
+* @file    mico_system_log_test.c
+* @version V1.0.0
+* @date    17-Oct-2026
+* @brief   Overflow test of the deferred log ring: more records than it holds
+*          are logged ahead of the drain, and more while it runs. The text
+*          lines and the raw records that come out must be the records kept,
+*          in order, with one dropped notice, carrying the count, at the
+*          place where records were lost; and written plus dropped must add
+*          up. Built on the host on its own with DEBUG and MICO_DEFERRED_LOG
+*          set, it includes mico_system_log.c for the ring and captures what
+*          the drain prints and sends. Not part of the default build. On a
+*          64-bit host build it with -fno-sanitize=alignment, the records
+*          hold pointers but are laid out for 32-bit targets.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The drain prints its text lines with printf(), they are captured here */
+static int log_test_printf( const char *format, ... );
+#define printf log_test_printf
+#include "mico_system_log.c"
+#undef printf
+
+#if !( DEBUG && MICO_DEFERRED_LOG )
+#error "mico_system_log_test.c needs DEBUG and MICO_DEFERRED_LOG"
+#endif
+
+#define LOG_TEST_OLD            ( 3 * MICO_DEFERRED_LOG_BUFFER_SIZE / sizeof(mico_log_record_t) )
+#define LOG_TEST_NEW            ( 5 )
+#define LOG_TEST_NEW_AFTER      ( 9 )     /* Old records out when the new ones are logged */
+#define LOG_TEST_ENTRIES_MAX    ( 2 * LOG_TEST_OLD )
+#define LOG_TEST_RAW_MAX        ( 4 * MICO_DEFERRED_LOG_BUFFER_SIZE )
+
+static const char log_test_old_format[] = "old %d";
+static const char log_test_new_format[] = "new %d";
+
+/* What came out, in order: a record of either kind, or a dropped notice */
+typedef struct
+{
+  char      kind;               /* 'o'ld, 'n'ew or 'd'ropped */
+  int       value;              /* Record number, or the dropped count */
+  uint32_t  time;
+} log_test_entry_t;
+
+static log_test_entry_t log_test_entries[LOG_TEST_ENTRIES_MAX];
+static int log_test_count;
+static bool log_test_bad_line;
+static uint8_t log_test_raw[LOG_TEST_RAW_MAX];
+static uint32_t log_test_raw_len;
+static uint32_t log_test_now;
+static int log_test_inject;     /* Old record on whose way out the new ones are logged, -1: none */
+
+mico_mutex_t stdio_tx_mutex;
+int mico_debug_enabled = 1;
+
+OSStatus mico_rtos_lock_mutex( mico_mutex_t* mutex ) { return kNoErr; }
+OSStatus mico_rtos_unlock_mutex( mico_mutex_t* mutex ) { return kNoErr; }
+OSStatus mico_rtos_create_thread( mico_thread_t* thread, uint8_t priority, const char* name, mico_thread_function_t function, uint32_t stack_size, void* arg ) { return kNoErr; }
+void mico_thread_msleep( uint32_t milliseconds ) { log_test_now += milliseconds; }
+uint32_t mico_get_time( void ) { return log_test_now; }
+
+/* Records logged while the drain runs, as another thread would */
+static void log_test_new_records( void )
+{
+  int i;
+
+  for ( i = 0; i < LOG_TEST_NEW; i++ ) {
+    log_test_now++;
+    mico_system_log_deferred( "TEST", "MICO\\system\\log_test.c", 2, log_test_new_format, i );
+  }
+}
+
+static void log_test_add( char kind, int value, uint32_t time )
+{
+  if ( log_test_count == LOG_TEST_ENTRIES_MAX ) {
+    log_test_bad_line = true;
+    return;
+  }
+  log_test_entries[log_test_count].kind = kind;
+  log_test_entries[log_test_count].value = value;
+  log_test_entries[log_test_count].time = time;
+  log_test_count++;
+  if ( kind == 'o' && value == log_test_inject ) {
+    log_test_inject = -1;
+    log_test_new_records( );
+  }
+}
+
+static int log_test_printf( const char *format, ... )
+{
+  char line[MICO_DEFERRED_LOG_LINE_MAX + 64], kind[4];
+  unsigned time;
+  int value, n;
+  va_list ap;
+
+  va_start( ap, format );
+  n = vsnprintf( line, sizeof(line), format, ap );
+  va_end( ap );
+
+  if ( sscanf( line, "[%u][LOG] %d records dropped", &time, &value ) == 2 )
+    log_test_add( 'd', value, time );
+  else if ( sscanf( line, "[%u][TEST: log_test.c:%*d] %3s %d", &time, kind, &value ) == 3 &&
+            ( strcmp( kind, "old" ) == 0 || strcmp( kind, "new" ) == 0 ) )
+    log_test_add( kind[0], value, time );
+  else
+    log_test_bad_line = true;
+  return n;
+}
+
+/* Raw mode: the sync bytes, then the record */
+OSStatus MicoUartSend( mico_uart_t uart, const void* data, uint32_t size )
+{
+  const mico_log_record_t *rec = data;
+  int value;
+
+  if ( log_test_raw_len + size > LOG_TEST_RAW_MAX ) {
+    log_test_bad_line = true;
+    return kNoErr;
+  }
+  memcpy( log_test_raw + log_test_raw_len, data, size );
+  log_test_raw_len += size;
+  if ( size == 2 ) return kNoErr;
+
+  memcpy( &value, rec + 1, sizeof(int) );
+  if ( rec->len != size || log_test_raw_len < size + 2 ||
+       log_test_raw[log_test_raw_len - size - 2] != LOG_RAW_SYNC0 ||
+       log_test_raw[log_test_raw_len - size - 1] != LOG_RAW_SYNC1 )
+    log_test_bad_line = true;
+  else if ( rec->format == NULL )
+    log_test_add( 'd', value, rec->time );
+  else if ( rec->format == log_test_old_format )
+    log_test_add( 'o', value, rec->time );
+  else if ( rec->format == log_test_new_format )
+    log_test_add( 'n', value, rec->time );
+  else
+    log_test_bad_line = true;
+  return kNoErr;
+}
+
+/* Fill the ring past its end with the drain stopped, then drain it; new
+   records are logged while the drain is at old record LOG_TEST_NEW_AFTER */
+static int log_test_overflow( bool raw, int print )
+{
+  const char *mode = raw ? "raw" : "text";
+  mico_system_log_stats_t stats;
+  log_test_entry_t *e;
+  int i, kept, dropped, bad = 0;
+
+  memset( &log_ring, 0, sizeof(log_ring) );
+  log_ring.raw = raw;
+  log_test_count = 0;
+  log_test_raw_len = 0;
+  log_test_bad_line = false;
+  log_test_inject = LOG_TEST_NEW_AFTER;
+  log_test_now = 1000;
+
+  for ( i = 0; i < (int)LOG_TEST_OLD; i++ ) {
+    log_test_now++;
+    mico_system_log_deferred( "TEST", "MICO\\system\\log_test.c", 1, log_test_old_format, i );
+  }
+  mico_system_log_flush( );
+  mico_system_log_get_stats( &stats );
+
+  /* old 0 .. kept - 1, the notice, then the new records */
+  for ( kept = 0; kept < log_test_count && log_test_entries[kept].kind == 'o' &&
+        log_test_entries[kept].value == kept; kept++ );
+  dropped = (int)LOG_TEST_OLD - kept;
+  e = &log_test_entries[kept];
+  if ( log_test_bad_line || kept <= LOG_TEST_NEW_AFTER || kept == (int)LOG_TEST_OLD ) bad++;
+  else if ( log_test_count != kept + 1 + LOG_TEST_NEW ) bad++;
+  else if ( e->kind != 'd' || e->value != dropped || e->time != 1000 + (uint32_t)kept + 1 ) bad++;
+  for ( i = 0; bad == 0 && i < LOG_TEST_NEW; i++ ) {
+    e = &log_test_entries[kept + 1 + i];
+    if ( e->kind != 'n' || e->value != i ) bad++;
+  }
+  for ( i = 1; bad == 0 && i < log_test_count; i++ ) {
+    if ( log_test_entries[i].time < log_test_entries[i - 1].time ) bad++;
+  }
+  if ( stats.written != (uint32_t)( kept + LOG_TEST_NEW ) || stats.dropped != (uint32_t)dropped ) bad++;
+
+  if ( print )
+    printf( "%s: %d records logged ahead of the drain, %d kept, %d dropped, %d logged while draining: %s\r\n",
+            mode, (int)LOG_TEST_OLD, kept, (int)stats.dropped, LOG_TEST_NEW, bad ? "wrong order or count" : "ok" );
+
+  /* A second overflow gets a notice of its own */
+  if ( bad == 0 ) {
+    log_test_count = 0;
+    for ( i = 0; i < (int)LOG_TEST_OLD; i++ ) {
+      log_test_now++;
+      mico_system_log_deferred( "TEST", "MICO\\system\\log_test.c", 1, log_test_old_format, i );
+    }
+    mico_system_log_flush( );
+    mico_system_log_get_stats( &stats );
+    if ( log_test_bad_line || log_test_count != kept + 1 ||
+         log_test_entries[kept].kind != 'd' || log_test_entries[kept].value != dropped ||
+         stats.dropped != 2 * (uint32_t)dropped ) {
+      bad++;
+      if ( print ) printf( "%s: second overflow not reported in place\r\n", mode );
+    }
+  }
+  return bad;
+}
+
+OSStatus mico_system_log_test( int print )
+{
+  int bad = 0;
+
+  bad += log_test_overflow( false, print );
+  bad += log_test_overflow( true, print );
+
+  if ( print ) printf( "mico_system_log_test: %s\r\n", bad ? "FAILED" : "PASSED" );
+  return bad ? kGeneralErr : kNoErr;
+}
@@ -37,6 +37,7 @@
 /* Update seed number every time*/
 static int32_t seedNum = 0;
 
+/* Legacy layout: one full image in each partition, read for migration only */
 #define SYS_CONFIG_OFFSET   ( sizeof( boot_table_t ) )
 #define SYS_CONFIG_SIZE     ( sizeof( mico_sys_config_t ) )
 
@@ -45,6 +46,57 @@ static int32_t seedNum = 0;
 #define CRC_OFFSET    ( 0xE00 )
 #define CRC_SIZE      ( 2 )
 
+/*
+ * Log layout. PARAMETER_1 and PARAMETER_2 are two banks used in turn:
+ *   0x00  boot table, read by the bootloader (PARAMETER_1 only)
+ *   0x18  OTA_TEMP state, ota_state_t (PARAMETER_1 only)
+ *   0x20  bank header, written last when a compaction fills the bank
+ *   0x30  records, an 8 byte header and the data padded to 4 bytes
+ * An update appends the chunks that changed followed by a commit record,
+ * records after the last commit are ignored when reading back. When the
+ * active bank is full, the settings are compacted into the other bank,
+ * which takes over once its header carries the next sequence number.
+ */
+#define PARA_LOG_MAGIC          ( 0x474F4C50 )  /* "PLOG" */
+#define PARA_LOG_HDR_OFFSET     ( 0x20 )
+#define PARA_LOG_DATA_OFFSET    ( 0x30 )
+
+#ifndef PARA_LOG_CHUNK_SIZE
+#define PARA_LOG_CHUNK_SIZE     ( 32 )
+#endif
+
+#define PARA_KEY_USER           ( 0x8000 )  /* Offset in user config data, else in mico_sys_config_t */
+#define PARA_KEY_COMMIT         ( 0xFFFE )
+#define PARA_KEY_ERASED         ( 0xFFFF )
+
+#define PARA_ALIGN(x)           ( ( (x) + 3 ) & ~3 )
+#define PARA_SYS_CHUNKS         ( ( SYS_CONFIG_SIZE + PARA_LOG_CHUNK_SIZE - 1 ) / PARA_LOG_CHUNK_SIZE )
+
+typedef struct {
+  uint32_t magic;
+  uint32_t seq;
+  uint16_t crc;
+  uint16_t reserved;
+} para_log_bank_t;
+
+typedef struct {
+  uint16_t key;
+  uint16_t len;
+  uint16_t crc;       /* CRC16 over key, len and data */
+  uint16_t reserved;
+} para_log_record_t;
+
+static const mico_partition_t para_banks[2] = { MICO_PARTITION_PARAMETER_1, MICO_PARTITION_PARAMETER_2 };
+
+static struct {
+  int       active;         /* Index in para_banks, -1 before the first compaction */
+  uint32_t  seq;
+  uint32_t  write_offset;
+  bool      need_compact;   /* Torn or foreign records, do not append any more */
+  uint16_t *index;          /* Offset of the record holding each chunk, 0 if none */
+  uint32_t  index_count;
+} para_store = { -1, 0, 0, false, NULL, 0 };
+
 //#define para_log(M, ...) custom_log("MiCO Settting", M, ##__VA_ARGS__)
 
 #define para_log(M, ...)
@@ -65,61 +117,367 @@ static bool is_crc_match( uint16_t crc_1, uint16_t crc_2)
   return true;
 }
 
-static OSStatus internal_update_config( mico_Context_t * const inContext )
+static bool is_boot_table_empty( const boot_table_t *table )
+{
+  const uint8_t *p = (const uint8_t *)table;
+  uint32_t i;
+
+  /* The bootloader handles 0x00 and 0xFF filled tables alike */
+  for( i = 0; i < sizeof(boot_table_t); i++ )
+    if( p[i] != p[0] ) return false;
+  return p[0] == 0x00 || p[0] == 0xFF;
+}
+
+static bool para_flash_is_blank( mico_partition_t bank, uint32_t offset, uint32_t length )
+{
+  uint8_t buf[PARA_LOG_CHUNK_SIZE];
+  uint32_t i, n;
+
+  while( length ) {
+    n = ( length < sizeof(buf) ) ? length : sizeof(buf);
+    if( MicoFlashRead( bank, &offset, buf, n ) != kNoErr ) return false;
+    for( i = 0; i < n; i++ )
+      if( buf[i] != 0xFF ) return false;
+    length -= n;
+  }
+  return true;
+}
+
+static uint16_t para_log_bank_crc( const para_log_bank_t *hdr )
 {
-  OSStatus err = kNoErr;
-  uint32_t para_offset;
   CRC16_Context crc_context;
-  uint16_t crc_result;
-  
-  uint16_t crc_readback;;
+  uint16_t crc;
 
-  para_log("Flash write!");
+  CRC16_Init( &crc_context );
+  CRC16_Update( &crc_context, hdr, 8 );
+  CRC16_Final( &crc_context, &crc );
+  return crc;
+}
+
+static uint16_t para_log_record_crc( const para_log_record_t *rec, const uint8_t *data )
+{
+  CRC16_Context crc_context;
+  uint16_t crc;
 
   CRC16_Init( &crc_context );
-  CRC16_Update( &crc_context, &inContext->flashContentInRam.micoSystemConfig, SYS_CONFIG_SIZE );
-  CRC16_Update( &crc_context, inContext->user_config_data, inContext->user_config_data_size );
+  CRC16_Update( &crc_context, rec, 4 );
+  CRC16_Update( &crc_context, data, rec->len );
+  CRC16_Final( &crc_context, &crc );
+  return crc;
+}
+
+/* Position and record key of chunk i in RAM */
+static uint8_t *para_log_chunk( mico_Context_t * const inContext, uint32_t i, uint16_t *key, uint16_t *len )
+{
+  uint32_t offset, size;
+  uint8_t *base;
+
+  if( i < PARA_SYS_CHUNKS ) {
+    offset = i * PARA_LOG_CHUNK_SIZE;
+    size = SYS_CONFIG_SIZE;
+    base = (uint8_t *)&inContext->flashContentInRam.micoSystemConfig;
+    *key = offset;
+  } else {
+    offset = ( i - PARA_SYS_CHUNKS ) * PARA_LOG_CHUNK_SIZE;
+    size = inContext->user_config_data_size;
+    base = inContext->user_config_data;
+    *key = PARA_KEY_USER | offset;
+  }
+  *len = ( size - offset < PARA_LOG_CHUNK_SIZE ) ? size - offset : PARA_LOG_CHUNK_SIZE;
+  return base + offset;
+}
 
-  CRC16_Final( &crc_context, &crc_result );
+static OSStatus para_log_alloc_index( mico_Context_t * const inContext )
+{
+  uint32_t count = PARA_SYS_CHUNKS + ( inContext->user_config_data_size + PARA_LOG_CHUNK_SIZE - 1 ) / PARA_LOG_CHUNK_SIZE;
 
-  err = MicoFlashErase( MICO_PARTITION_PARAMETER_1, 0x0, sizeof(flash_content_t) );
-  require_noerr(err, exit);
+  if( para_store.index && para_store.index_count == count ) return kNoErr;
+  if( para_store.index ) free( para_store.index );
+  para_store.index = calloc( count, sizeof(uint16_t) );
+  para_store.index_count = para_store.index ? count : 0;
+  return para_store.index ? kNoErr : kNoMemoryErr;
+}
 
-  para_offset = 0x0;
-  err = MicoFlashWrite( MICO_PARTITION_PARAMETER_1, &para_offset, (uint8_t *)&inContext->flashContentInRam, sizeof(flash_content_t));
+static OSStatus para_log_write_record( mico_partition_t bank, uint32_t *offset, uint16_t key, const uint8_t *data, uint16_t len )
+{
+  struct {
+    para_log_record_t rec;
+    uint8_t data[PARA_ALIGN(PARA_LOG_CHUNK_SIZE)];
+  } buf;
+
+  /* Header and data go out in one write, a torn record fails its CRC */
+  buf.rec.key = key;
+  buf.rec.len = len;
+  buf.rec.reserved = 0x0;
+  if( len ) memcpy( buf.data, data, len );
+  memset( buf.data + len, 0xFF, PARA_ALIGN(len) - len );
+  buf.rec.crc = para_log_record_crc( &buf.rec, buf.data );
+  return MicoFlashWrite( bank, offset, (uint8_t *)&buf, sizeof(para_log_record_t) + PARA_ALIGN(len) );
+}
+
+/* Read the record at offset, 1 if it is valid, 0 at the end of the log, -1 if torn */
+static int para_log_read_record( mico_partition_t bank, uint32_t offset, uint32_t bank_length,
+                                 para_log_record_t *rec, uint8_t *data )
+{
+  uint32_t read_offset = offset;
+
+  if( offset + sizeof(para_log_record_t) > bank_length ) return 0;
+  if( MicoFlashRead( bank, &read_offset, (uint8_t *)rec, sizeof(para_log_record_t) ) != kNoErr ) return -1;
+  if( rec->key == PARA_KEY_ERASED && rec->len == 0xFFFF && rec->crc == 0xFFFF && rec->reserved == 0xFFFF )
+    return para_flash_is_blank( bank, read_offset, bank_length - read_offset ) ? 0 : -1;
+  if( rec->len > PARA_LOG_CHUNK_SIZE || offset + sizeof(para_log_record_t) + PARA_ALIGN(rec->len) > bank_length )
+    return -1;
+  if( MicoFlashRead( bank, &read_offset, data, rec->len ) != kNoErr ) return -1;
+  return ( para_log_record_crc( rec, data ) == rec->crc ) ? 1 : -1;
+}
+
+static OSStatus para_write_boot_table( mico_Context_t * const inContext )
+{
+  uint32_t para_offset = 0x0;
+
+  if( is_boot_table_empty( &inContext->flashContentInRam.bootTable ) ) return kNoErr;
+  return MicoFlashWrite( MICO_PARTITION_PARAMETER_1, &para_offset, (uint8_t *)&inContext->flashContentInRam.bootTable, sizeof(boot_table_t) );
+}
+
+/* Erase PARAMETER_1 if needed and write the boot table and the OTA_TEMP state
+   back. A dirty state is kept, an erased one is renewed as clean, a missing
+   one is left for the bootloader to write once it has checked the partition.
+   renew, if not NULL, is written instead. */
+static OSStatus para_reset_boot_bank( mico_Context_t * const inContext, const ota_state_t *renew )
+{
+  OSStatus err = kNoErr;
+  mico_logic_partition_t *partition = MicoFlashGetInfo( MICO_PARTITION_PARAMETER_1 );
+  uint32_t offset = OTA_STATE_OFFSET;
+  ota_state_t state;
+
+  err = MicoFlashRead( MICO_PARTITION_PARAMETER_1, &offset, (uint8_t *)&state, sizeof(ota_state_t) );
   require_noerr(err, exit);
+  if( renew ) {
+    state = *renew;
+  } else if( state.magic == OTA_STATE_MAGIC && ( state.dirty != 0x0 || state.erased == 0x0 ) ) {
+    memset( &state, 0xFF, sizeof(ota_state_t) );
+    state.magic = OTA_STATE_MAGIC;
+  }
 
-  para_offset = USER_CONFIG_OFFSET;
-  err = MicoFlashWrite( MICO_PARTITION_PARAMETER_1, &para_offset, inContext->user_config_data, inContext->user_config_data_size );
+  if( !para_flash_is_blank( MICO_PARTITION_PARAMETER_1, 0x0, partition->partition_length ) ) {
+    err = MicoFlashErase( MICO_PARTITION_PARAMETER_1, 0x0, partition->partition_length );
+    require_noerr(err, exit);
+  }
+  err = para_write_boot_table( inContext );
   require_noerr(err, exit);
+  if( state.magic == OTA_STATE_MAGIC ) {
+    offset = OTA_STATE_OFFSET;
+    err = MicoFlashWrite( MICO_PARTITION_PARAMETER_1, &offset, (uint8_t *)&state, sizeof(ota_state_t) );
+    require_noerr(err, exit);
+  }
+
+exit:
+  return err;
+}
+
+/* Write the whole configuration into the other bank and switch to it */
+static OSStatus para_log_compact( mico_Context_t * const inContext, int target )
+{
+  OSStatus err = kNoErr;
+  mico_partition_t bank = para_banks[target];
+  mico_logic_partition_t *partition = MicoFlashGetInfo( bank );
+  uint32_t i, offset, size;
+  uint16_t key, len;
+  uint8_t *data;
+  para_log_bank_t hdr, readback;
+
+  para_log("Compact into bank %d", target);
+
+  size = PARA_LOG_DATA_OFFSET + sizeof(para_log_record_t);
+  for( i = 0; i < para_store.index_count; i++ ) {
+    para_log_chunk( inContext, i, &key, &len );
+    size += sizeof(para_log_record_t) + PARA_ALIGN(len);
+  }
+  require_action( size <= partition->partition_length, exit, err = kNoSpaceErr );
+
+  if( bank == MICO_PARTITION_PARAMETER_1 ) {
+    err = para_reset_boot_bank( inContext, NULL );
+    require_noerr(err, exit);
+  } else if( !para_flash_is_blank( bank, 0x0, partition->partition_length ) ) {
+    err = MicoFlashErase( bank, 0x0, partition->partition_length );
+    require_noerr(err, exit);
+  }
 
-  para_offset = CRC_OFFSET;
-  err = MicoFlashWrite( MICO_PARTITION_PARAMETER_1, &para_offset, (uint8_t *)&crc_result, CRC_SIZE );
+  para_store.active = -1;
+  offset = PARA_LOG_DATA_OFFSET;
+  for( i = 0; i < para_store.index_count; i++ ) {
+    data = para_log_chunk( inContext, i, &key, &len );
+    para_store.index[i] = offset;
+    err = para_log_write_record( bank, &offset, key, data, len );
+    require_noerr(err, exit);
+  }
+  err = para_log_write_record( bank, &offset, PARA_KEY_COMMIT, NULL, 0 );
   require_noerr(err, exit);
-  
-  /* Read back*/
-  para_offset = CRC_OFFSET;
-  err = MicoFlashRead( MICO_PARTITION_PARAMETER_1, &para_offset, (uint8_t *)&crc_readback, CRC_SIZE );
-  para_log( "crc_readback = %d", crc_readback);
-  if( crc_readback == 0x0)
-    return kWriteErr;
-  
 
-  /* Write backup data*/
-  err = MicoFlashErase( MICO_PARTITION_PARAMETER_2, 0x0, sizeof(flash_content_t) );
+  /* The header makes the bank valid, so it goes last */
+  hdr.magic = PARA_LOG_MAGIC;
+  hdr.seq = para_store.seq + 1;
+  hdr.reserved = 0x0;
+  hdr.crc = para_log_bank_crc( &hdr );
+  i = PARA_LOG_HDR_OFFSET;
+  err = MicoFlashWrite( bank, &i, (uint8_t *)&hdr, sizeof(hdr) );
+  require_noerr(err, exit);
+  i = PARA_LOG_HDR_OFFSET;
+  err = MicoFlashRead( bank, &i, (uint8_t *)&readback, sizeof(readback) );
   require_noerr(err, exit);
+  require_action( memcmp( &hdr, &readback, sizeof(hdr) ) == 0, exit, err = kWriteErr );
 
-  para_offset = 0x0;
-  err = MicoFlashWrite( MICO_PARTITION_PARAMETER_2, &para_offset, (uint8_t *)&inContext->flashContentInRam, sizeof(flash_content_t));
+  para_store.active = target;
+  para_store.seq = hdr.seq;
+  para_store.write_offset = offset;
+  para_store.need_compact = false;
+
+exit:
+  return err;
+}
+
+/* Load the newest bank, returns kNotFoundErr if neither holds a log */
+static OSStatus para_log_mount( mico_Context_t * const inContext )
+{
+  OSStatus err = kNoErr;
+  mico_partition_t bank;
+  uint32_t bank_length, offset, commit_end, base_size, chunk;
+  para_log_bank_t hdr;
+  para_log_record_t rec;
+  uint8_t data[PARA_LOG_CHUNK_SIZE];
+  uint8_t *base;
+  int i, ret;
+
+  err = para_log_alloc_index( inContext );
   require_noerr(err, exit);
 
-  para_offset = USER_CONFIG_OFFSET;
-  err = MicoFlashWrite( MICO_PARTITION_PARAMETER_2, &para_offset, inContext->user_config_data, inContext->user_config_data_size );
+  para_store.active = -1;
+  for( i = 0; i < 2; i++ ) {
+    offset = PARA_LOG_HDR_OFFSET;
+    if( MicoFlashRead( para_banks[i], &offset, (uint8_t *)&hdr, sizeof(hdr) ) != kNoErr ) continue;
+    if( hdr.magic != PARA_LOG_MAGIC || hdr.crc != para_log_bank_crc( &hdr ) ) continue;
+    if( para_store.active < 0 || (int32_t)( hdr.seq - para_store.seq ) > 0 ) {
+      para_store.active = i;
+      para_store.seq = hdr.seq;
+    }
+  }
+  require_action_quiet( para_store.active >= 0, exit, err = kNotFoundErr );
+
+  bank = para_banks[para_store.active];
+  bank_length = MicoFlashGetInfo( bank )->partition_length;
+  para_store.need_compact = false;
+
+  /* First pass: find the end of the committed records and of the log */
+  offset = commit_end = PARA_LOG_DATA_OFFSET;
+  while( ( ret = para_log_read_record( bank, offset, bank_length, &rec, data ) ) > 0 ) {
+    offset += sizeof(para_log_record_t) + PARA_ALIGN(rec.len);
+    if( rec.key == PARA_KEY_COMMIT ) commit_end = offset;
+  }
+  /* A later commit would adopt an interrupted update, so never append after one */
+  if( ret < 0 || offset != commit_end ) para_store.need_compact = true;
+  para_store.write_offset = offset;
+
+  /* Second pass: replay committed records, later ones win */
+  memset( para_store.index, 0x0, para_store.index_count * sizeof(uint16_t) );
+  for( offset = PARA_LOG_DATA_OFFSET; offset < commit_end; offset += sizeof(para_log_record_t) + PARA_ALIGN(rec.len) ) {
+    if( para_log_read_record( bank, offset, bank_length, &rec, data ) <= 0 ) {
+      err = kReadErr;
+      goto exit;
+    }
+    if( rec.key == PARA_KEY_COMMIT ) continue;
+    if( rec.key & PARA_KEY_USER ) {
+      base = inContext->user_config_data;
+      base_size = inContext->user_config_data_size;
+      chunk = PARA_SYS_CHUNKS;
+    } else {
+      base = (uint8_t *)&inContext->flashContentInRam.micoSystemConfig;
+      base_size = SYS_CONFIG_SIZE;
+      chunk = 0;
+    }
+    rec.key &= ~PARA_KEY_USER;
+    if( rec.key >= base_size ) continue;
+    memcpy( base + rec.key, data, ( rec.len < base_size - rec.key ) ? rec.len : base_size - rec.key );
+
+    /* Index whole chunks only, anything else is rewritten at the next update */
+    chunk += rec.key / PARA_LOG_CHUNK_SIZE;
+    if( rec.key % PARA_LOG_CHUNK_SIZE == 0 &&
+        rec.len == ( ( base_size - rec.key < PARA_LOG_CHUNK_SIZE ) ? base_size - rec.key : PARA_LOG_CHUNK_SIZE ) ) {
+      para_store.index[chunk] = offset;
+    } else {
+      para_store.need_compact = true;
+      for( ; chunk < para_store.index_count && chunk * PARA_LOG_CHUNK_SIZE < rec.key + rec.len; chunk++ )
+        para_store.index[chunk] = 0;
+    }
+  }
+
+exit:
+  return err;
+}
+
+static OSStatus internal_update_config( mico_Context_t * const inContext )
+{
+  OSStatus err = kNoErr;
+  uint32_t para_offset, i, bank_length;
+  boot_table_t boot_table;
+  mico_partition_t bank;
+  para_log_record_t rec;
+  uint8_t data[PARA_LOG_CHUNK_SIZE];
+  uint8_t *chunk;
+  uint16_t key, len;
+
+  para_log("Flash write!");
+
+  err = para_log_alloc_index( inContext );
   require_noerr(err, exit);
 
-  para_offset = CRC_OFFSET;
-  err = MicoFlashWrite( MICO_PARTITION_PARAMETER_2, &para_offset, (uint8_t *)&crc_result, CRC_SIZE );
+  /* The bootloader reads the boot table in place at the start of PARAMETER_1 */
+  para_offset = 0x0;
+  err = MicoFlashRead( MICO_PARTITION_PARAMETER_1, &para_offset, (uint8_t *)&boot_table, sizeof(boot_table_t) );
   require_noerr(err, exit);
+  if( memcmp( &boot_table, &inContext->flashContentInRam.bootTable, sizeof(boot_table_t) ) != 0 &&
+      !( is_boot_table_empty( &boot_table ) && is_boot_table_empty( &inContext->flashContentInRam.bootTable ) ) ) {
+    if( para_flash_is_blank( MICO_PARTITION_PARAMETER_1, 0x0, sizeof(boot_table_t) ) ) {
+      err = para_write_boot_table( inContext );
+      require_noerr(err, exit);
+    } else if( para_store.active == 0 ) {
+      /* Move the log out of PARAMETER_1 before erasing it for the new table */
+      err = para_log_compact( inContext, 1 );
+      require_noerr(err, exit);
+      err = para_reset_boot_bank( inContext, NULL );
+      goto exit;
+    } else {
+      err = para_log_compact( inContext, 0 );
+      goto exit;
+    }
+  }
+
+  if( para_store.active < 0 || para_store.need_compact ) {
+    err = para_log_compact( inContext, ( para_store.active == 1 ) ? 0 : 1 );
+    goto exit;
+  }
+
+  bank = para_banks[para_store.active];
+  bank_length = MicoFlashGetInfo( bank )->partition_length;
+
+  for( i = 0; i < para_store.index_count; i++ ) {
+    chunk = para_log_chunk( inContext, i, &key, &len );
+    if( para_store.index[i] != 0 &&
+        para_log_read_record( bank, para_store.index[i], bank_length, &rec, data ) > 0 &&
+        rec.len == len && memcmp( data, chunk, len ) == 0 )
+      continue;
+
+    /* Leave room for the commit record, an unfinished update is simply dropped */
+    if( para_store.write_offset + 2 * sizeof(para_log_record_t) + PARA_ALIGN(len) > bank_length ) {
+      err = para_log_compact( inContext, 1 - para_store.active );
+      goto exit;
+    }
+    para_store.index[i] = para_store.write_offset;
+    err = para_log_write_record( bank, &para_store.write_offset, key, chunk, len );
+    require_noerr_action(err, exit, para_store.need_compact = true);
+  }
+
+  err = para_log_write_record( bank, &para_store.write_offset, PARA_KEY_COMMIT, NULL, 0 );
+  require_noerr_action(err, exit, para_store.need_compact = true);
 
 exit:
   return err;
@@ -175,115 +533,63 @@ exit:
 }
 #endif
 
-OSStatus MICOReadConfiguration(mico_Context_t *inContext)
+/* Read a configuration saved before the log format, kNotFoundErr if both copies are bad */
+static OSStatus para_legacy_read( mico_Context_t * const inContext )
 {
   uint32_t para_offset = 0x0;
-  //uint32_t config_offset = CONFIG_OFFSET;
   uint32_t crc_offset = CRC_OFFSET;
   CRC16_Context crc_context;
   uint16_t crc_result, crc_target;
-  uint16_t crc_backup_result, crc_backup_target;
-  mico_logic_partition_t *partition; 
-  uint8_t *sys_backup_data = NULL;
-  uint8_t *user_backup_data = NULL;
-
-  OSStatus err = kNoErr;
-
-  sys_backup_data = malloc( SYS_CONFIG_SIZE );
-  require_action( sys_backup_data, exit, err = kNoMemoryErr );
-
-  user_backup_data = malloc( inContext->user_config_data_size );
-  require_action( user_backup_data, exit, err = kNoMemoryErr );
-
-
-  /* Load data and crc from main partition */
-  para_offset = 0x0;
-  err = MicoFlashRead( MICO_PARTITION_PARAMETER_1, &para_offset, (uint8_t *)&inContext->flashContentInRam, sizeof( flash_content_t ) );
-  para_offset = USER_CONFIG_OFFSET;
-  err = MicoFlashRead( MICO_PARTITION_PARAMETER_1, &para_offset, (uint8_t *)inContext->user_config_data, inContext->user_config_data_size );
+  uint8_t *user_data = inContext->user_config_data;
+  int i;
+
+  OSStatus err = kNotFoundErr;
+
+  for( i = 0; i < 2 && err != kNoErr; i++ ) {
+    para_offset = SYS_CONFIG_OFFSET;
+    if( MicoFlashRead( para_banks[i], &para_offset, (uint8_t *)&inContext->flashContentInRam.micoSystemConfig, SYS_CONFIG_SIZE ) != kNoErr )
+      continue;
+    para_offset = USER_CONFIG_OFFSET;
+    if( MicoFlashRead( para_banks[i], &para_offset, user_data, inContext->user_config_data_size ) != kNoErr )
+      continue;
+
+    CRC16_Init( &crc_context );
+    CRC16_Update( &crc_context, (uint8_t *)&inContext->flashContentInRam.micoSystemConfig, SYS_CONFIG_SIZE );
+    CRC16_Update( &crc_context, user_data, inContext->user_config_data_size );
+    CRC16_Final( &crc_context, &crc_result );
+
+    crc_offset = CRC_OFFSET;
+    if( MicoFlashRead( para_banks[i], &crc_offset, (uint8_t *)&crc_target, CRC_SIZE ) != kNoErr )
+      continue;
+    para_log( "crc_result = %d, crc_target = %d", crc_result, crc_target);
+
+    if( is_crc_match( crc_result, crc_target ) == true ) err = kNoErr;
+  }
 
-  CRC16_Init( &crc_context );
-  CRC16_Update( &crc_context, (uint8_t *)&inContext->flashContentInRam.micoSystemConfig, SYS_CONFIG_SIZE );
-  CRC16_Update( &crc_context, inContext->user_config_data, inContext->user_config_data_size );
-  CRC16_Final( &crc_context, &crc_result );
-  para_log( "crc_result = %d", crc_result);
+  return err;
+}
 
-  crc_offset = CRC_OFFSET;
-  err = MicoFlashRead( MICO_PARTITION_PARAMETER_1, &crc_offset, (uint8_t *)&crc_target, CRC_SIZE );
-  para_log( "crc_target = %d", crc_target);
+OSStatus MICOReadConfiguration(mico_Context_t *inContext)
+{
+  uint32_t para_offset = 0x0;
+  OSStatus err = kNoErr;
 
-  /* Load data and crc from backup partition */
-  para_offset = SYS_CONFIG_OFFSET;
-  err = MicoFlashRead( MICO_PARTITION_PARAMETER_2, &para_offset, sys_backup_data, SYS_CONFIG_SIZE );
-  para_offset = USER_CONFIG_OFFSET;
-  err = MicoFlashRead( MICO_PARTITION_PARAMETER_2, &para_offset, user_backup_data, inContext->user_config_data_size );
+  err = MicoFlashRead( MICO_PARTITION_PARAMETER_1, &para_offset, (uint8_t *)&inContext->flashContentInRam.bootTable, sizeof(boot_table_t) );
+  require_noerr(err, exit);
 
-  CRC16_Init( &crc_context );
-  CRC16_Update( &crc_context, sys_backup_data,  SYS_CONFIG_SIZE );
-  CRC16_Update( &crc_context, user_backup_data, inContext->user_config_data_size );
-  CRC16_Final( &crc_context, &crc_backup_result );
-  para_log( "crc_backup_result = %d", crc_backup_result);
-
-  crc_offset = CRC_OFFSET;
-  err = MicoFlashRead( MICO_PARTITION_PARAMETER_2, &crc_offset, (uint8_t *)&crc_backup_target, CRC_SIZE );  
-  para_log( "crc_backup_target = %d", crc_backup_target);
-  
-  /* Data collapsed at main partition */
-  if( is_crc_match( crc_result, crc_target ) == false ){
-    /* Data collapsed at main partition and backup partition both, restore to default */
-    if( is_crc_match( crc_backup_result, crc_backup_target ) == false ){
+  err = para_log_mount( inContext );
+  if( err != kNoErr ) {
+    /* No log yet, convert a configuration in the legacy layout */
+    memset(&inContext->flashContentInRam.micoSystemConfig, 0x0, SYS_CONFIG_SIZE);
+    if( para_legacy_read( inContext ) == kNoErr ) {
+      para_log("Legacy config found, convert to log");
+      err = internal_update_config( inContext );
+      require_noerr(err, exit);
+    } else {
       para_log("Config failed on both partition, restore to default settings!");
       err = mico_system_context_restore( inContext );
       require_noerr(err, exit);
     }
-    /* main collapsed, backup correct, copy data from back up to main */
-    else {
-      para_log("Config failed on main, recover!");
-
-      memset(&inContext->flashContentInRam, 0x0, sizeof(inContext->flashContentInRam));
-      memcpy( (uint8_t *)&inContext->flashContentInRam.micoSystemConfig, sys_backup_data, SYS_CONFIG_SIZE);
-
-      partition = MicoFlashGetInfo( MICO_PARTITION_PARAMETER_1 );
-
-      err = MicoFlashErase( MICO_PARTITION_PARAMETER_1 ,0x0, partition->partition_length );
-      require_noerr(err, exit);
-
-      para_offset = 0x0;
-      err = MicoFlashWrite( MICO_PARTITION_PARAMETER_1, &para_offset, (uint8_t *)&inContext->flashContentInRam, sizeof(flash_content_t) );
-      require_noerr(err, exit);
-
-      para_offset = USER_CONFIG_OFFSET;
-      err = MicoFlashWrite( MICO_PARTITION_PARAMETER_1, &para_offset, inContext->user_config_data, inContext->user_config_data_size );
-      require_noerr(err, exit);
-
-      crc_offset = CRC_OFFSET;
-      err = MicoFlashWrite( MICO_PARTITION_PARAMETER_1, &crc_offset, (uint8_t *)&crc_backup_result, CRC_SIZE );
-      require_noerr(err, exit);
-    }
-  }   
-  /* main correct */
-  else { 
-      /* main correct , backup collapsed, or main!=backup, copy data from main to back up */
-    if( is_crc_match( crc_result, crc_backup_result ) == false || is_crc_match( crc_backup_result, crc_backup_target ) == false ){
-      para_log("Config failed on backup, recover!");
-
-      partition = MicoFlashGetInfo( MICO_PARTITION_PARAMETER_2 );
-
-      err = MicoFlashErase( MICO_PARTITION_PARAMETER_2 ,0x0, partition->partition_length );
-      require_noerr(err, exit);
-  
-      para_offset = 0x0;
-      err = MicoFlashWrite( MICO_PARTITION_PARAMETER_2, &para_offset, (uint8_t *)&inContext->flashContentInRam, sizeof(flash_content_t) );
-      require_noerr(err, exit);
-
-      para_offset = USER_CONFIG_OFFSET;
-      err = MicoFlashWrite( MICO_PARTITION_PARAMETER_2, &para_offset, inContext->user_config_data, inContext->user_config_data_size );
-      require_noerr(err, exit);
-
-      crc_offset = CRC_OFFSET;
-      err = MicoFlashWrite( MICO_PARTITION_PARAMETER_2, &crc_offset, (uint8_t *)&crc_target, CRC_SIZE );
-      require_noerr(err, exit);
-    }
   }
 
   para_log(" Config read, seed = %d!", inContext->flashContentInRam.micoSystemConfig.seed);
@@ -310,8 +616,6 @@ OSStatus MICOReadConfiguration(mico_Context_t *inContext)
   }
 
 exit: 
-  if( sys_backup_data!= NULL) free( sys_backup_data );
-  if( user_backup_data!= NULL) free( user_backup_data );
   return err;
 }
 
@@ -329,4 +633,106 @@ exit:
   return err;
 }
 
+OSStatus mico_system_ota_partition_dirty( mico_Context_t * const in_context, uint32_t length )
+{
+  OSStatus err = kNoErr;
+  uint32_t offset = OTA_STATE_OFFSET;
+  uint32_t whole = 0x0;
+  uint8_t written = 0x0;
+  ota_state_t state;
+
+  require_action( in_context, exit, err = kNotPreparedErr );
+
+  err = MicoFlashRead( MICO_PARTITION_PARAMETER_1, &offset, (uint8_t *)&state, sizeof(ota_state_t) );
+  require_noerr(err, exit);
+
+  /* No state yet, the bootloader checks the whole partition */
+  if( state.magic != OTA_STATE_MAGIC ) goto exit;
+
+  if( state.dirty != 0x0 ) {
+    /* The length goes first, so that a dirty state always covers what is written */
+    if( length ) {
+      offset = OTA_STATE_OFFSET + offsetof( ota_state_t, dirty_end );
+      err = MicoFlashWrite( MICO_PARTITION_PARAMETER_1, &offset, (uint8_t *)&length, sizeof(uint32_t) );
+      require_noerr(err, exit);
+    }
+    offset = OTA_STATE_OFFSET + offsetof( ota_state_t, dirty );
+    err = MicoFlashWrite( MICO_PARTITION_PARAMETER_1, &offset, &written, 1 );
+    require_noerr(err, exit);
+  } else if( state.erased != 0x0 ) {
+    /* Written before and not erased since, a longer download covers it all */
+    if( state.dirty_end != 0x0 && state.dirty_end != 0xFFFFFFFF && ( length == 0 || length > state.dirty_end ) ) {
+      offset = OTA_STATE_OFFSET + offsetof( ota_state_t, dirty_end );
+      err = MicoFlashWrite( MICO_PARTITION_PARAMETER_1, &offset, (uint8_t *)&whole, sizeof(uint32_t) );
+      require_noerr(err, exit);
+    }
+  } else {
+    /* Erased by the bootloader since the last download, start a new state */
+    state.dirty = 0x0;
+    state.erased = 0xFF;
+    state.dirty_end = length ? length : 0xFFFFFFFF;
+    if( para_store.active == 0 ) {
+      err = para_log_compact( in_context, 1 );
+      require_noerr(err, exit);
+    }
+    err = para_reset_boot_bank( in_context, &state );
+    require_noerr(err, exit);
+  }
 
+exit:
+  return err;
+}
+
+OSStatus mico_system_ota_partition_written( mico_Context_t * const in_context, uint32_t *length )
+{
+  OSStatus err = kNoErr;
+  uint32_t offset = OTA_STATE_OFFSET;
+  uint32_t partition_length = MicoFlashGetInfo( MICO_PARTITION_OTA_TEMP )->partition_length;
+  ota_state_t state;
+
+  require_action( in_context && length, exit, err = kNotPreparedErr );
+
+  err = MicoFlashRead( MICO_PARTITION_PARAMETER_1, &offset, (uint8_t *)&state, sizeof(ota_state_t) );
+  require_noerr(err, exit);
+
+  if( state.magic != OTA_STATE_MAGIC )
+    *length = partition_length;
+  else if( state.dirty != 0x0 || state.erased == 0x0 )
+    *length = 0;
+  else if( state.dirty_end == 0x0 || state.dirty_end > partition_length )
+    *length = partition_length;
+  else
+    *length = state.dirty_end;
+
+exit:
+  return err;
+}
+
+OSStatus mico_system_ota_download_progress( mico_Context_t * const in_context, uint32_t progress )
+{
+  OSStatus err = kNoErr;
+  uint32_t offset = 0x0, current;
+  boot_table_t boot_table;
+  boot_table_t *table;
+
+  require_action( in_context, exit, err = kNotPreparedErr );
+  table = &in_context->flashContentInRam.bootTable;
+
+  err = MicoFlashRead( MICO_PARTITION_PARAMETER_1, &offset, (uint8_t *)&boot_table, sizeof(boot_table_t) );
+  require_noerr(err, exit);
+  memcpy( &current, table->reserved, sizeof(uint32_t) );
+  memcpy( table->reserved, &progress, sizeof(uint32_t) );
+
+  /* Bits only cleared in the table in flash are written in place, sparing an
+     erase of PARAMETER_1 at each step */
+  if( memcmp( &boot_table, table, offsetof( boot_table_t, reserved ) ) == 0 &&
+      memcmp( boot_table.reserved, &current, sizeof(uint32_t) ) == 0 && ( progress & ~current ) == 0 ) {
+    offset = offsetof( boot_table_t, reserved );
+    err = MicoFlashWrite( MICO_PARTITION_PARAMETER_1, &offset, table->reserved, sizeof(uint32_t) );
+  } else {
+    err = internal_update_config( in_context );
+  }
+
+exit:
+  return err;
+}
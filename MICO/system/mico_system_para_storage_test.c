@@ -0,0 +1,340 @@
+/**
+******************************************************************************
+* @file    mico_system_para_storage_test.c
+* @version V1.0.0
+* @date    17-Oct-2026
+* @brief   Power-loss and compaction test of the parameter log. PARAMETER_1
+*          and PARAMETER_2 are simulated as two 4 KB NOR banks, and the power
+*          is cut at random flash writes and erases; after every restart the
+*          settings must be either the ones before or the ones after the
+*          interrupted update. Also converts a legacy image and counts the
+*          erases and bytes written by 1000 updates. Built on the host on its
+*          own, it includes mico_system_para_storage.c to reset the store
+*          after each simulated power cut; CheckSumUtils.c provides the CRC.
+*          Not part of the default build.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mico_system_para_storage.c"
+
+#define PARA_TEST_BANK_SIZE     ( 4096 )
+#define PARA_TEST_USER_SIZE     ( 200 )
+#define PARA_TEST_UPDATES       ( 1000 )
+#define PARA_TEST_ITERATIONS    ( 20000 )
+#define PARA_TEST_MAX_CUT       ( 600 )   /* Bytes written before a power cut, at most */
+
+/* The two banks, programming can only clear bits as on NOR flash */
+static uint8_t para_test_flash[2][PARA_TEST_BANK_SIZE];
+static mico_logic_partition_t para_test_partitions[2] = {
+  { MICO_FLASH_EMBEDDED, "PARAMETER1", 0x0, PARA_TEST_BANK_SIZE, 0 },
+  { MICO_FLASH_EMBEDDED, "PARAMETER2", PARA_TEST_BANK_SIZE, PARA_TEST_BANK_SIZE, 0 },
+};
+static unsigned long para_test_erases, para_test_bytes, para_test_reprogrammed;
+static long para_test_cut = -1;   /* Flash operations left before the power fails */
+static jmp_buf para_test_power_cut;
+static uint32_t para_test_seed = 1;
+static mico_Context_t *para_test_context;
+
+static uint32_t para_test_rand( uint32_t n )
+{
+  para_test_seed = para_test_seed * 1103515245 + 12345;
+  return ( para_test_seed >> 16 ) % n;
+}
+
+static int para_test_bank( mico_partition_t partition )
+{
+  return ( partition == MICO_PARTITION_PARAMETER_1 ) ? 0 : 1;
+}
+
+mico_logic_partition_t *MicoFlashGetInfo( mico_partition_t inPartition )
+{
+  return &para_test_partitions[para_test_bank( inPartition )];
+}
+
+OSStatus MicoFlashErase( mico_partition_t inPartition, uint32_t off_set, uint32_t size )
+{
+  uint8_t *bank = para_test_flash[para_test_bank( inPartition )];
+  uint32_t i;
+
+  if( off_set != 0 || size != PARA_TEST_BANK_SIZE ) return kParamErr;
+  para_test_erases++;
+  if( para_test_cut > 0 && --para_test_cut == 0 ) {
+    /* An interrupted erase leaves some bytes erased and some half cleared */
+    for( i = 0; i < PARA_TEST_BANK_SIZE; i++ )
+      bank[i] = para_test_rand( 2 ) ? 0xFF : bank[i] & para_test_rand( 256 );
+    longjmp( para_test_power_cut, 1 );
+  }
+  memset( bank, 0xFF, PARA_TEST_BANK_SIZE );
+  return kNoErr;
+}
+
+OSStatus MicoFlashWrite( mico_partition_t inPartition, volatile uint32_t* off_set, uint8_t* inBuffer, uint32_t inBufferLength )
+{
+  uint8_t *bank = para_test_flash[para_test_bank( inPartition )];
+  uint32_t i;
+
+  if( *off_set + inBufferLength > PARA_TEST_BANK_SIZE ) return kParamErr;
+  for( i = 0; i < inBufferLength; i++, (*off_set)++ ) {
+    if( para_test_cut > 0 && --para_test_cut == 0 ) longjmp( para_test_power_cut, 1 );
+    /* A byte may only be programmed once between erases */
+    if( bank[*off_set] != 0xFF && bank[*off_set] != inBuffer[i] ) para_test_reprogrammed++;
+    bank[*off_set] &= inBuffer[i];
+    para_test_bytes++;
+  }
+  return kNoErr;
+}
+
+OSStatus MicoFlashRead( mico_partition_t inPartition, volatile uint32_t* off_set, uint8_t* outBuffer, uint32_t inBufferLength )
+{
+  uint8_t *bank = para_test_flash[para_test_bank( inPartition )];
+
+  if( *off_set + inBufferLength > PARA_TEST_BANK_SIZE ) return kParamErr;
+  memcpy( outBuffer, &bank[*off_set], inBufferLength );
+  *off_set += inBufferLength;
+  return kNoErr;
+}
+
+mico_Context_t *mico_system_context_get( void )
+{
+  return para_test_context;
+}
+
+/* Forget everything held in RAM and read the settings back, as at boot */
+static OSStatus para_test_restart( void )
+{
+  if( para_store.index ) free( para_store.index );
+  memset( &para_store, 0x0, sizeof(para_store) );
+  para_store.active = -1;
+  seedNum = 0;
+
+  memset( &para_test_context->flashContentInRam, 0x0, sizeof(flash_content_t) );
+  memset( para_test_context->user_config_data, 0x0, PARA_TEST_USER_SIZE );
+  return MICOReadConfiguration( para_test_context );
+}
+
+static bool para_test_same( const mico_sys_config_t *config, const uint8_t *user )
+{
+  return memcmp( &para_test_context->flashContentInRam.micoSystemConfig, config, sizeof(mico_sys_config_t) ) == 0 &&
+         memcmp( para_test_context->user_config_data, user, PARA_TEST_USER_SIZE ) == 0;
+}
+
+/* The changes an application makes between two updates */
+static void para_test_change( void )
+{
+  mico_sys_config_t *config = &para_test_context->flashContentInRam.micoSystemConfig;
+  uint8_t *user = para_test_context->user_config_data;
+  int i;
+
+  switch( para_test_rand( 6 ) ) {
+    case 0:
+      sprintf( config->ssid, "net-%u", (unsigned)para_test_rand( 100000 ) );
+      break;
+    case 1:
+      sprintf( config->key, "pw-%u-%u", (unsigned)para_test_rand( 100000 ), (unsigned)para_test_rand( 100000 ) );
+      break;
+    case 2:
+      for( i = 0; i < PARA_TEST_USER_SIZE; i++ ) user[i] = para_test_rand( 256 );
+      break;
+    case 3:
+      user[para_test_rand( PARA_TEST_USER_SIZE )] = para_test_rand( 256 );
+      break;
+    case 4:
+      config->dhcpEnable = !config->dhcpEnable;
+      break;
+    default:
+      break;
+  }
+}
+
+/* A configuration saved by the former code, the same image in both banks,
+   is read and converted; a bad copy in PARAMETER_1 falls back to PARAMETER_2 */
+static OSStatus para_test_legacy( void )
+{
+  mico_sys_config_t config;
+  uint8_t user[PARA_TEST_USER_SIZE];
+  CRC16_Context crc_context;
+  uint16_t crc;
+  uint32_t offset;
+  int i;
+
+  memset( &config, 0x0, sizeof(config) );
+  config.magic_number = SYS_MAGIC_NUMBR;
+  config.seed = 41;
+  strcpy( config.ssid, "legacy" );
+  for( i = 0; i < PARA_TEST_USER_SIZE; i++ ) user[i] = i;
+  CRC16_Init( &crc_context );
+  CRC16_Update( &crc_context, (uint8_t *)&config, SYS_CONFIG_SIZE );
+  CRC16_Update( &crc_context, user, PARA_TEST_USER_SIZE );
+  CRC16_Final( &crc_context, &crc );
+
+  memset( para_test_flash, 0xFF, sizeof(para_test_flash) );
+  for( i = 0; i < 2; i++ ) {
+    offset = SYS_CONFIG_OFFSET;
+    MicoFlashWrite( para_banks[i], &offset, (uint8_t *)&config, SYS_CONFIG_SIZE );
+    offset = USER_CONFIG_OFFSET;
+    MicoFlashWrite( para_banks[i], &offset, user, PARA_TEST_USER_SIZE );
+    offset = CRC_OFFSET;
+    MicoFlashWrite( para_banks[i], &offset, (uint8_t *)&crc, CRC_SIZE );
+  }
+  para_test_flash[0][USER_CONFIG_OFFSET] ^= 0x1;
+
+  for( i = 0; i < 2; i++ ) {
+    if( para_test_restart( ) != kNoErr || !para_test_same( &config, user ) ) return kMismatchErr;
+    if( para_store.active < 0 ) return kMismatchErr;
+  }
+  return kNoErr;
+}
+
+OSStatus mico_system_para_storage_test( int print )
+{
+  mico_sys_config_t committed, pending;
+  uint8_t committed_user[PARA_TEST_USER_SIZE], pending_user[PARA_TEST_USER_SIZE];
+  boot_table_t *table, stored;
+  unsigned long erases, bytes;
+  volatile int iteration, cuts = 0, adopted = 0;
+  uint32_t offset;
+  OSStatus err = kNoErr;
+
+  para_test_context = calloc( 1, sizeof(mico_Context_t) );
+  require_action( para_test_context, exit, err = kNoMemoryErr );
+  para_test_context->user_config_data = calloc( 1, PARA_TEST_USER_SIZE );
+  para_test_context->user_config_data_size = PARA_TEST_USER_SIZE;
+  require_action( para_test_context->user_config_data, exit, err = kNoMemoryErr );
+  table = &para_test_context->flashContentInRam.bootTable;
+
+  err = para_test_legacy( );
+  if( err != kNoErr ) {
+    if( print ) printf( "Legacy configuration not converted\r\n" );
+    goto exit;
+  }
+
+  /* Blank flash restores the defaults, then one field changes at a time */
+  memset( para_test_flash, 0xFF, sizeof(para_test_flash) );
+  err = para_test_restart( );
+  require_noerr( err, exit );
+  erases = para_test_erases;
+  bytes = para_test_bytes;
+  for( iteration = 0; iteration < PARA_TEST_UPDATES; iteration++ ) {
+    sprintf( para_test_context->flashContentInRam.micoSystemConfig.ssid, "ssid%d", iteration );
+    err = mico_system_context_update( para_test_context );
+    require_noerr( err, exit );
+  }
+  erases = para_test_erases - erases;
+  bytes = para_test_bytes - bytes;
+  err = para_test_restart( );
+  require_noerr( err, exit );
+  if( strcmp( para_test_context->flashContentInRam.micoSystemConfig.ssid, "ssid999" ) ) {
+    if( print ) printf( "Last update lost on restart\r\n" );
+    err = kMismatchErr;
+    goto exit;
+  }
+  if( print )
+    printf( "%d updates of the SSID: %lu erases, %lu bytes written\r\n", PARA_TEST_UPDATES, erases, bytes );
+
+  /* Power cuts at random points of the updates, with OTA requests setting
+     the boot table and the bootloader clearing it in between */
+  committed = para_test_context->flashContentInRam.micoSystemConfig;
+  memcpy( committed_user, para_test_context->user_config_data, PARA_TEST_USER_SIZE );
+  for( iteration = 0; iteration < PARA_TEST_ITERATIONS; iteration++ ) {
+    para_test_change( );
+    if( para_test_rand( 50 ) == 0 ) {
+      memset( table, 0x0, sizeof(boot_table_t) );
+      table->upgrade_type = 'U';
+      table->type = 'A';
+      table->length = para_test_rand( 0x80000 );
+    }
+    if( para_test_rand( 80 ) == 0 ) {
+      memset( para_test_flash[0], 0xFF, sizeof(boot_table_t) );
+      memset( table, 0xFF, sizeof(boot_table_t) );
+      para_test_erases++;
+    }
+    pending = para_test_context->flashContentInRam.micoSystemConfig;
+    pending.seed = seedNum + 1;
+    memcpy( pending_user, para_test_context->user_config_data, PARA_TEST_USER_SIZE );
+
+    para_test_cut = para_test_rand( 3 ) ? -1 : 1 + (long)para_test_rand( PARA_TEST_MAX_CUT );
+    if( setjmp( para_test_power_cut ) ) {
+      para_test_cut = -1;
+      cuts++;
+      err = para_test_restart( );
+      require_noerr( err, exit );
+      if( para_test_same( &pending, pending_user ) ) {
+        adopted++;
+        committed = pending;
+        memcpy( committed_user, pending_user, PARA_TEST_USER_SIZE );
+      } else if( !para_test_same( &committed, committed_user ) ) {
+        if( print ) printf( "Iteration %d: settings neither the old nor the new ones\r\n", iteration );
+        err = kMismatchErr;
+        goto exit;
+      }
+      continue;
+    }
+    err = mico_system_context_update( para_test_context );
+    para_test_cut = -1;
+    require_noerr( err, exit );
+    committed = pending;
+    memcpy( committed_user, pending_user, PARA_TEST_USER_SIZE );
+
+    offset = 0x0;
+    MicoFlashRead( MICO_PARTITION_PARAMETER_1, &offset, (uint8_t *)&stored, sizeof(boot_table_t) );
+    if( memcmp( &stored, table, sizeof(boot_table_t) ) &&
+        !( is_boot_table_empty( &stored ) && is_boot_table_empty( table ) ) ) {
+      if( print ) printf( "Iteration %d: boot table not in place\r\n", iteration );
+      err = kMismatchErr;
+      goto exit;
+    }
+
+    if( para_test_rand( 10 ) == 0 ) {
+      err = para_test_restart( );
+      require_noerr( err, exit );
+      if( !para_test_same( &committed, committed_user ) ) {
+        if( print ) printf( "Iteration %d: settings changed by a clean restart\r\n", iteration );
+        err = kMismatchErr;
+        goto exit;
+      }
+    }
+  }
+
+  if( para_test_reprogrammed ) {
+    if( print ) printf( "%lu bytes programmed twice without an erase\r\n", para_test_reprogrammed );
+    err = kMismatchErr;
+    goto exit;
+  }
+  if( print )
+    printf( "%d updates, %d power cuts, %d of them after the commit\r\n", PARA_TEST_ITERATIONS, cuts, adopted );
+
+exit:
+  if( para_test_context ) {
+    free( para_test_context->user_config_data );
+    free( para_test_context );
+    para_test_context = NULL;
+  }
+  if( print ) printf( "mico_system_para_storage_test: %s\r\n", err == kNoErr ? "PASSED" : "FAILED" );
+  return err;
+}
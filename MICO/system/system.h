@@ -51,6 +51,7 @@ extern "C" {
 #define STACK_SIZE_LOCAL_CONFIG_CLIENT_THREAD   0x450
 #define STACK_SIZE_NTP_CLIENT_THREAD            0x450
 #define STACK_SIZE_mico_system_MONITOR_THREAD   0x300
+#define STACK_SIZE_mico_system_LOG_THREAD       0x500
 
 #define EASYLINK_BYPASS_NO                      (0)
 #define EASYLINK_BYPASS                         (1)
@@ -96,11 +97,40 @@ typedef struct  _boot_table_t {
   uint32_t length; // file real length
   uint8_t version[8];
   uint8_t type; // B:bootloader, P:boot_table, A:application, D: 8782 driver
-  uint8_t upgrade_type; //u:upgrade, 
+  uint8_t upgrade_type; //u:upgrade, R:download in progress
   uint16_t crc;
   uint8_t reserved[4];
 }boot_table_t;
 
+/* While a download into the OTA temporary partition goes on, the boot table
+ * has upgrade_type 'R', crc identifying the source and length the image
+ * length, 0 if not known. reserved holds the checkpoints, a bit cleared from
+ * bit 0 up each time a further step is written, 1/32 of the partition rounded
+ * up to whole erase sectors. The bootloader keeps the partition as it is, so
+ * that the download goes on from there after a reboot. */
+#define OTA_DOWNLOAD_CHECKPOINTS  ( 32 )
+
+/* State of the OTA temporary partition, stored in PARAMETER_1 right after the
+ * boot table, so that the bootloader knows without reading the partition
+ * whether it has to be erased:
+ *   clean   magic written, dirty not: the partition is blank
+ *   dirty   dirty written: the application wrote to it, up to dirty_end
+ *   staged  dirty, with a boot table asking for an update
+ *   erased  erased written: blank again, the record is renewed by the
+ *           application before the next download
+ * Fields go from blank to written once between erases of PARAMETER_1, bar
+ * dirty_end which may be cleared to 0 to cover the whole partition. Without
+ * the magic, the bootloader reads the whole partition as before. */
+#define OTA_STATE_OFFSET  ( sizeof( boot_table_t ) )
+#define OTA_STATE_MAGIC   ( 0xC35A )
+
+typedef struct  _ota_state_t {
+  uint16_t magic;     // OTA_STATE_MAGIC once the bootloader found the partition blank
+  uint8_t  dirty;     // 0x0 once the application started writing to the partition
+  uint8_t  erased;    // 0x0 once the bootloader erased what was written
+  uint32_t dirty_end; // Length written from the start, 0 or 0xFFFFFFFF for all of it
+}ota_state_t;
+
 typedef struct _mico_sys_config_t
 {
   /*Device identification*/
@@ -203,6 +233,15 @@ OSStatus MICORestoreMFG                 ( system_context_t * const inContext );
 
 OSStatus MICOReadConfiguration          ( system_context_t * const inContext );
 
+/* Power cuts against the parameter log on simulated flash, see mico_system_para_storage_test.c */
+OSStatus mico_system_para_storage_test  ( int print );
+
+/* Ring overflow and the dropped notice, see mico_system_log_test.c */
+OSStatus mico_system_log_test           ( int print );
+
+/* Downloads against ota_server.py with faults and power cuts, see ota_download_test.c */
+OSStatus ota_download_test              ( int print );
+
 void mico_mfg_test( system_context_t * const inContext );
 
 
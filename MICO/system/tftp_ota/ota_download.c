@@ -0,0 +1,785 @@
+/**
+******************************************************************************
+* @file    ota_download.c
+* @version V1.0.0
+* @date    17-Oct-2026
+* @brief   This file provides the download of an image into the OTA temporary
+*          partition from a TFTP or an HTTP server, written as it arrives and
+*          resumed where it was cut off.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2015 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#include "mico.h"
+#include "mico_system.h"
+#include "SocketUtils.h"
+#include "HTTPUtils.h"
+#include "StringUtils.h"
+#include "CheckSumUtils.h"
+
+#define ota_download_log(M, ...) custom_log("OTA download", M, ##__VA_ARGS__)
+#define ota_download_log_trace() custom_log_trace("OTA download")
+
+#ifndef OTA_DOWNLOAD_TFTP_PORT
+#define OTA_DOWNLOAD_TFTP_PORT        69
+#endif
+
+/* Data bytes per TFTP block asked for, a block fits in one Ethernet frame */
+#ifndef OTA_DOWNLOAD_TFTP_BLKSIZE
+#define OTA_DOWNLOAD_TFTP_BLKSIZE     1428
+#endif
+
+/* TFTP blocks sent by the server for each acknowledgement */
+#ifndef OTA_DOWNLOAD_TFTP_WINDOWSIZE
+#define OTA_DOWNLOAD_TFTP_WINDOWSIZE  8
+#endif
+
+#ifndef OTA_DOWNLOAD_TFTP_TIMEOUT_MS
+#define OTA_DOWNLOAD_TFTP_TIMEOUT_MS  1000
+#endif
+
+/* TFTP timeouts in a row, or HTTP connections that bring nothing, before giving up */
+#ifndef OTA_DOWNLOAD_RETRY
+#define OTA_DOWNLOAD_RETRY            5
+#endif
+
+/* Checkpoints fall on erase sector boundaries, so that what they keep is
+   never erased again. The OTA partition in internal flash is in the 128K
+   sectors of the STM32F2/F4 */
+#ifndef OTA_DOWNLOAD_SPI_SECTOR
+#define OTA_DOWNLOAD_SPI_SECTOR       0x1000
+#endif
+
+#ifndef OTA_DOWNLOAD_EMBEDDED_SECTOR
+#define OTA_DOWNLOAD_EMBEDDED_SECTOR  0x20000
+#endif
+
+#define OTA_DOWNLOAD_HTTP_HEADER_SIZE 1024
+
+/* An HTTP image is told from another one of the same length by its validator,
+   its strong ETag or else its Last-Modified date. Its CRC16 is kept in the
+   version of the boot table: after a reboot the rest of the image is taken
+   only from a response with the same validator, and ranges asked for later
+   carry it in If-Range */
+#define OTA_DOWNLOAD_VALIDATOR_MAX    96
+#define OTA_DOWNLOAD_VALIDATOR_TAG    'V'
+
+#define TFTP_RRQ          1
+#define TFTP_DATA         3
+#define TFTP_ACK          4
+#define TFTP_ERROR        5
+#define TFTP_OACK         6
+
+#define TFTP_HEADER_SIZE  4
+#define TFTP_BLKSIZE      512
+#define TFTP_ERR_DISK     3
+#define TFTP_ERR_OPTION   8
+
+typedef struct _ota_download_t {
+  mico_Context_t *context;
+  uint16_t        id;           // CRC16 of the source, crc of the boot table
+  uint32_t        start;        // Start address of the partition
+  uint32_t        partition_length;
+  uint32_t        step;         // Bytes per checkpoint
+  uint32_t        total;        // Image length, 0 if not known yet
+  uint32_t        kept;         // Written before, checked and not written again
+  uint32_t        received;     // Bytes from the start of the image in flash
+  uint32_t        erased;       // Blank from received up to there
+  uint32_t        blank;        // Blank from there to the end of the partition
+  uint32_t        checkpoints;  // Steps recorded in the boot table
+  bool            started;      // Boot table and partition state written
+  bool            body;         // HTTP: the body of the response started
+  OSStatus        err;          // HTTP: error while writing the body
+  bool            validated;    // HTTP: the validator of the image is known
+  uint16_t        validator_id; // HTTP: CRC16 of the validator
+  char            validator[OTA_DOWNLOAD_VALIDATOR_MAX];  // HTTP: for If-Range, empty after a reboot
+} ota_download_t;
+
+static uint32_t ota_download_progress_bits( uint32_t checkpoints )
+{
+  return ( checkpoints >= OTA_DOWNLOAD_CHECKPOINTS ) ? 0x0 : ( 0xFFFFFFFF << checkpoints );
+}
+
+static bool ota_download_is_blank( uint32_t offset, uint32_t length )
+{
+  uint8_t buf[128];
+  uint32_t i, n;
+
+  while( length ) {
+    n = ( length < sizeof(buf) ) ? length : sizeof(buf);
+    if( MicoFlashRead( MICO_PARTITION_OTA_TEMP, &offset, buf, n ) != kNoErr ) return false;
+    for( i = 0; i < n; i++ )
+      if( buf[i] != 0xFF ) return false;
+    length -= n;
+  }
+  return true;
+}
+
+/* Pick up the checkpoints of a download of the same source cut off before */
+static OSStatus ota_download_init( ota_download_t *d, const char *source )
+{
+  OSStatus err = kNoErr;
+  mico_logic_partition_t *ota_partition = MicoFlashGetInfo( MICO_PARTITION_OTA_TEMP );
+  boot_table_t *table;
+  CRC16_Context contex;
+  uint32_t sector, progress, written, offset;
+
+  memset( d, 0, sizeof(ota_download_t) );
+  require_action( ota_partition->partition_owner != MICO_FLASH_NONE, exit, err = kUnsupportedErr );
+
+  d->context = mico_system_context_get( );
+  d->start = ota_partition->partition_start_addr;
+  d->partition_length = ota_partition->partition_length;
+  sector = ( ota_partition->partition_owner == MICO_FLASH_EMBEDDED ) ? OTA_DOWNLOAD_EMBEDDED_SECTOR : OTA_DOWNLOAD_SPI_SECTOR;
+  d->step = ( d->partition_length / OTA_DOWNLOAD_CHECKPOINTS + sector - 1 ) / sector * sector;
+
+  CRC16_Init( &contex );
+  CRC16_Update( &contex, source, strlen( source ) );
+  CRC16_Final( &contex, &d->id );
+
+  mico_rtos_lock_mutex( &d->context->flashContentInRam_mutex );
+  table = &d->context->flashContentInRam.bootTable;
+  if( table->upgrade_type == 'R' && table->crc == d->id && table->start_address == d->start ) {
+    memcpy( &progress, table->reserved, sizeof(uint32_t) );
+    while( d->checkpoints < OTA_DOWNLOAD_CHECKPOINTS && !( progress & ( 1UL << d->checkpoints ) ) )
+      d->checkpoints++;
+    d->total = table->length;
+    if( table->version[0] == OTA_DOWNLOAD_VALIDATOR_TAG ) {
+      d->validated = true;
+      memcpy( &d->validator_id, &table->version[1], sizeof(uint16_t) );
+    }
+  }
+  err = mico_system_ota_partition_written( d->context, &written );
+  mico_rtos_unlock_mutex( &d->context->flashContentInRam_mutex );
+  require_noerr( err, exit );
+
+  d->kept = d->checkpoints * d->step;
+  if( d->kept > d->partition_length ) d->kept = d->partition_length;
+  /* Erased since, by a bootloader that did not know about downloads, or did
+     not clear the partition state when it erased it. A step all blank in the
+     image only costs a download from the start */
+  if( written < d->kept ) d->kept = 0;
+  for( offset = 0; offset < d->kept; offset += d->step ) {
+    if( ota_download_is_blank( offset, ( d->kept - offset < d->step ) ? d->kept - offset : d->step ) ) {
+      ota_download_log("Step at %d erased since", offset);
+      d->kept = 0;
+    }
+  }
+  if( d->kept == 0 ) d->checkpoints = 0;
+  d->erased = d->kept;
+  d->blank = written;
+  if( d->kept ) ota_download_log("Resume from %d bytes", d->kept);
+
+exit:
+  return err;
+}
+
+/* Another image: nothing written is kept, the boot table is renewed */
+static void ota_download_again( ota_download_t *d )
+{
+  d->kept = 0;
+  d->received = 0;
+  d->erased = 0;
+  d->checkpoints = 0;
+  d->started = false;
+  d->validated = false;
+  d->validator[0] = 0;
+}
+
+/* The image length is known: start again if it is not the one cut off */
+static OSStatus ota_download_size( ota_download_t *d, uint32_t total )
+{
+  OSStatus err = kNoErr;
+
+  require_action( total <= d->partition_length, exit, err = kSizeErr );
+  if( d->total != 0 && d->total != total && ( d->kept || d->received ) ) {
+    ota_download_log("Image length changed to %d, download again", total);
+    ota_download_again( d );
+  }
+  d->total = total;
+
+exit:
+  return err;
+}
+
+/* A new transfer from offset, what the previous one wrote is kept */
+static void ota_download_begin( ota_download_t *d, uint32_t offset )
+{
+  if( d->received > d->kept ) d->kept = d->received;
+  d->received = offset;
+}
+
+/* Before the first write: the boot table records the download, the partition
+   state covers it */
+static OSStatus ota_download_start( ota_download_t *d )
+{
+  OSStatus err = kNoErr;
+  boot_table_t *table = &d->context->flashContentInRam.bootTable;
+  bool renew = ( d->checkpoints == 0 );
+
+  mico_rtos_lock_mutex( &d->context->flashContentInRam_mutex );
+  if( renew ) {
+    memset( table, 0, sizeof(boot_table_t) );
+    table->start_address = d->start;
+    table->length = d->total;
+    table->upgrade_type = 'R';
+    table->crc = d->id;
+    if( d->validated ) {
+      table->version[0] = OTA_DOWNLOAD_VALIDATOR_TAG;
+      memcpy( &table->version[1], &d->validator_id, sizeof(uint16_t) );
+    }
+    memset( table->reserved, 0xFF, sizeof(table->reserved) );
+  }
+  err = mico_system_ota_partition_dirty( d->context, d->total );
+  require_noerr( err, exit );
+  if( renew ) {
+    err = mico_system_context_update( d->context );
+    require_noerr( err, exit );
+  }
+  d->started = true;
+
+exit:
+  mico_rtos_unlock_mutex( &d->context->flashContentInRam_mutex );
+  return err;
+}
+
+static OSStatus ota_download_compare( uint32_t offset, const uint8_t *data, uint32_t length )
+{
+  OSStatus err = kNoErr;
+  uint8_t buf[128];
+  uint32_t n;
+
+  while( length ) {
+    n = ( length < sizeof(buf) ) ? length : sizeof(buf);
+    err = MicoFlashRead( MICO_PARTITION_OTA_TEMP, &offset, buf, n );
+    require_noerr( err, exit );
+    require_action( memcmp( buf, data, n ) == 0, exit, err = kMismatchErr );
+    data += n;
+    length -= n;
+  }
+
+exit:
+  return err;
+}
+
+/* Erase ahead of the data a step at a time, unless it is blank already */
+static OSStatus ota_download_erase( ota_download_t *d, uint32_t end )
+{
+  OSStatus err = kNoErr;
+  uint32_t length;
+
+  while( d->erased < end ) {
+    length = d->partition_length - d->erased;
+    if( length > d->step ) length = d->step;
+    if( d->erased < d->blank && !ota_download_is_blank( d->erased, length ) ) {
+      err = MicoFlashErase( MICO_PARTITION_OTA_TEMP, d->erased, length );
+      require_noerr( err, exit );
+    }
+    d->erased += length;
+  }
+
+exit:
+  return err;
+}
+
+static OSStatus ota_download_write( ota_download_t *d, const uint8_t *data, uint32_t length )
+{
+  OSStatus err = kNoErr;
+  uint32_t offset, n, checkpoints;
+
+  require_action( d->received + length <= d->partition_length, exit, err = kSizeErr );
+
+  if( !d->started ) {
+    err = ota_download_start( d );
+    require_noerr( err, exit );
+  }
+
+  /* What a transfer cut off wrote before is checked only */
+  if( d->received < d->kept ) {
+    n = ( length < d->kept - d->received ) ? length : d->kept - d->received;
+    err = ota_download_compare( d->received, data, n );
+    require_noerr_action( err, exit, ota_download_log("Image differs at %d", d->received) );
+    d->received += n;
+    data += n;
+    length -= n;
+  }
+
+  if( length ) {
+    err = ota_download_erase( d, d->received + length );
+    require_noerr( err, exit );
+    offset = d->received;
+    err = MicoFlashWrite( MICO_PARTITION_OTA_TEMP, &offset, (uint8_t *)data, length );
+    require_noerr( err, exit );
+    d->received += length;
+    if( d->blank < d->received ) d->blank = d->received;
+  }
+
+  checkpoints = d->received / d->step;
+  if( checkpoints > OTA_DOWNLOAD_CHECKPOINTS ) checkpoints = OTA_DOWNLOAD_CHECKPOINTS;
+  if( checkpoints > d->checkpoints ) {
+    mico_rtos_lock_mutex( &d->context->flashContentInRam_mutex );
+    err = mico_system_ota_download_progress( d->context, ota_download_progress_bits( checkpoints ) );
+    mico_rtos_unlock_mutex( &d->context->flashContentInRam_mutex );
+    require_noerr( err, exit );
+    d->checkpoints = checkpoints;
+  }
+
+exit:
+  return err;
+}
+
+/* The download is complete when the length is known and all received */
+static OSStatus ota_download_finish( ota_download_t *d, uint32_t *length )
+{
+  OSStatus err = kNoErr;
+
+  require_action( d->total && d->received == d->total, exit, err = kUnderrunErr );
+  ota_download_log("Image downloaded, %d bytes", d->total);
+  if( length ) *length = d->total;
+
+exit:
+  return err;
+}
+
+static int tftp_request( uint8_t *buf, const char *filename, bool options )
+{
+  uint8_t *p = buf;
+
+  *p++ = 0;
+  *p++ = TFTP_RRQ;
+  p += sprintf( (char *)p, "%s", filename ) + 1;
+  p += sprintf( (char *)p, "octet" ) + 1;
+  if( !options ) return p - buf;
+  p += sprintf( (char *)p, "blksize" ) + 1;
+  p += sprintf( (char *)p, "%d", OTA_DOWNLOAD_TFTP_BLKSIZE ) + 1;
+  p += sprintf( (char *)p, "windowsize" ) + 1;
+  p += sprintf( (char *)p, "%d", OTA_DOWNLOAD_TFTP_WINDOWSIZE ) + 1;
+  p += sprintf( (char *)p, "tsize" ) + 1;
+  p += sprintf( (char *)p, "0" ) + 1;
+  return p - buf;
+}
+
+static void tftp_send( int fd, const struct sockaddr_t *addr, uint16_t opcode, uint16_t value )
+{
+  uint8_t packet[TFTP_HEADER_SIZE + 1];
+
+  packet[0] = opcode >> 8;
+  packet[1] = opcode & 0xFF;
+  packet[2] = value >> 8;
+  packet[3] = value & 0xFF;
+  packet[4] = 0;
+  sendto( fd, packet, ( opcode == TFTP_ERROR ) ? TFTP_HEADER_SIZE + 1 : TFTP_HEADER_SIZE, 0, addr, sizeof(struct sockaddr_t) );
+}
+
+/* Options the server accepted, from an OACK */
+static OSStatus tftp_options( ota_download_t *d, const uint8_t *p, int len, uint32_t *blksize, uint32_t *windowsize )
+{
+  OSStatus err = kNoErr;
+  const char *name, *value, *end = (const char *)p + len;
+  uint32_t n;
+
+  while( (const char *)p < end ) {
+    name = (const char *)p;
+    value = memchr( name, 0, end - name );
+    require_action( value && value + 1 < end, exit, err = kMalformedErr );
+    value++;
+    p = memchr( value, 0, end - value );
+    require_action( p, exit, err = kMalformedErr );
+    p++;
+    n = strtoul( value, NULL, 10 );
+
+    if( strnicmpx( name, strlen( name ), "blksize" ) == 0 ) {
+      require_action( n >= 8 && n <= OTA_DOWNLOAD_TFTP_BLKSIZE, exit, err = kMalformedErr );
+      *blksize = n;
+    } else if( strnicmpx( name, strlen( name ), "windowsize" ) == 0 ) {
+      require_action( n >= 1 && n <= OTA_DOWNLOAD_TFTP_WINDOWSIZE, exit, err = kMalformedErr );
+      *windowsize = n;
+    } else if( strnicmpx( name, strlen( name ), "tsize" ) == 0 ) {
+      err = ota_download_size( d, n );
+      require_noerr( err, exit );
+    }
+  }
+
+exit:
+  return err;
+}
+
+/* One transfer, from the first block. The server sends a window of blocks
+   for each acknowledgement: the last block of the window is acknowledged, and
+   so is the last one in order on a gap or a timeout, the server going on
+   from the block after it */
+static OSStatus tftp_get( ota_download_t *d, int fd, uint32_t server_ip, const char *filename, uint8_t *buf )
+{
+  OSStatus err = kNoErr;
+  struct sockaddr_t server, from;
+  socklen_t fromLen;
+  fd_set readfds;
+  struct timeval_t t;
+  uint32_t blksize = TFTP_BLKSIZE, windowsize = 1, inWindow = 0, length;
+  uint16_t block = 0, received, opcode;
+  int len, requestLen, timeouts = 0;
+  bool connected = false, gap = false, options = true;
+
+  ota_download_begin( d, 0 );
+
+  server.s_ip = server_ip;
+  server.s_port = OTA_DOWNLOAD_TFTP_PORT;
+  requestLen = tftp_request( buf, filename, options );
+  sendto( fd, buf, requestLen, 0, &server, sizeof(server) );
+
+  while( 1 ) {
+    FD_ZERO( &readfds );
+    FD_SET( fd, &readfds );
+    t.tv_sec = OTA_DOWNLOAD_TFTP_TIMEOUT_MS / 1000;
+    t.tv_usec = ( OTA_DOWNLOAD_TFTP_TIMEOUT_MS % 1000 ) * 1000;
+    if( select( fd + 1, &readfds, NULL, NULL, &t ) <= 0 ) {
+      require_action( ++timeouts <= OTA_DOWNLOAD_RETRY, exit, err = kTimeoutErr );
+      if( connected ) {
+        tftp_send( fd, &server, TFTP_ACK, block );
+      } else {
+        requestLen = tftp_request( buf, filename, options );
+        sendto( fd, buf, requestLen, 0, &server, sizeof(server) );
+      }
+      inWindow = 0;
+      continue;
+    }
+
+    fromLen = sizeof(from);
+    len = recvfrom( fd, buf, TFTP_HEADER_SIZE + OTA_DOWNLOAD_TFTP_BLKSIZE, 0, &from, &fromLen );
+    if( len < TFTP_HEADER_SIZE || from.s_ip != server_ip ) continue;
+    opcode = ( buf[0] << 8 ) | buf[1];
+    received = ( buf[2] << 8 ) | buf[3];
+
+    /* The server answers from a port of its own for the transfer, with the
+       options or the first block */
+    if( !connected ) {
+      if( opcode == TFTP_DATA && received != 1 ) continue;
+      server.s_port = from.s_port;
+      connected = true;
+    } else if( from.s_port != server.s_port ) {
+      continue;
+    }
+
+    switch( opcode ) {
+    case TFTP_OACK:
+      if( block != 0 ) break;
+      err = tftp_options( d, &buf[2], len - 2, &blksize, &windowsize );
+      require_noerr( err, exit );
+      ota_download_log("Block size %d, window %d blocks", blksize, windowsize);
+      timeouts = 0;
+      tftp_send( fd, &server, TFTP_ACK, 0 );
+      break;
+
+    case TFTP_DATA:
+      if( received != (uint16_t)( block + 1 ) ) {
+        /* Lost or late: acknowledge the last block in order, once per gap */
+        if( !gap && (uint16_t)( received - block - 1 ) < 0x8000 ) {
+          tftp_send( fd, &server, TFTP_ACK, block );
+          gap = true;
+          inWindow = 0;
+        }
+        break;
+      }
+      length = len - TFTP_HEADER_SIZE;
+      require_action( length <= blksize, exit, err = kMalformedErr );
+      err = ota_download_write( d, &buf[TFTP_HEADER_SIZE], length );
+      require_noerr_action( err, exit, tftp_send( fd, &server, TFTP_ERROR, TFTP_ERR_DISK ) );
+      block++;
+      gap = false;
+      timeouts = 0;
+      if( length < blksize || ++inWindow == windowsize ) {
+        tftp_send( fd, &server, TFTP_ACK, block );
+        inWindow = 0;
+      }
+      if( length < blksize ) {
+        if( d->total == 0 ) d->total = d->received;
+        require_action( d->received == d->total, exit, err = kSizeErr );
+        goto exit;
+      }
+      break;
+
+    case TFTP_ERROR:
+      /* A server refusing the options is asked again without them */
+      if( received == TFTP_ERR_OPTION && options && block == 0 ) {
+        options = false;
+        connected = false;
+        server.s_port = OTA_DOWNLOAD_TFTP_PORT;
+        requestLen = tftp_request( buf, filename, options );
+        sendto( fd, buf, requestLen, 0, &server, sizeof(server) );
+        break;
+      }
+      buf[len - 1] = 0;
+      ota_download_log("TFTP error %d: %s", received, &buf[TFTP_HEADER_SIZE]);
+      err = kNotFoundErr;
+      goto exit;
+
+    default:
+      break;
+    }
+  }
+
+exit:
+  return err;
+}
+
+OSStatus ota_download_tftp( uint32_t server_ip, const char *filename, uint32_t *length )
+{
+  OSStatus err = kNoErr;
+  ota_download_t download;
+  struct sockaddr_t addr;
+  uint8_t *buf = NULL;
+  int fd = -1, retry = OTA_DOWNLOAD_RETRY;
+
+  err = ota_download_init( &download, filename );
+  require_noerr( err, exit );
+
+  buf = malloc( TFTP_HEADER_SIZE + OTA_DOWNLOAD_TFTP_BLKSIZE );
+  require_action( buf, exit, err = kNoMemoryErr );
+
+  fd = socket( AF_INET, SOCK_DGRM, IPPROTO_UDP );
+  require_action( IsValidSocket( fd ), exit, err = kNoResourcesErr );
+  addr.s_ip = INADDR_ANY;
+  addr.s_port = 0;
+  err = bind( fd, &addr, sizeof(addr) );
+  require_noerr_action( err, exit, err = kNoResourcesErr );
+
+  /* A transfer cut off starts again from the first block, the blocks written
+     before are only checked */
+  while( 1 ) {
+    err = tftp_get( &download, fd, server_ip, filename, buf );
+    if( err == kNoErr || err == kNotFoundErr || err == kMismatchErr || err == kSizeErr || --retry <= 0 ) break;
+    ota_download_log("Transfer cut off at %d bytes, err %d", download.received, err);
+  }
+  require_noerr( err, exit );
+  err = ota_download_finish( &download, length );
+
+exit:
+  if( err == kMismatchErr ) ota_download_reset( );
+  if( err != kNoErr ) ota_download_log("TFTP download failed, err %d", err);
+  SocketClose( &fd );
+  if( buf ) free( buf );
+  return err;
+}
+
+/* The validator of the image in a response, a strong ETag or else the
+   Last-Modified date, false if there is none */
+static bool http_validator( struct _HTTPHeader_t * inHeader, char *validator, uint16_t *id )
+{
+  CRC16_Context contex;
+  const char *value;
+  size_t valueLen;
+
+  if( HTTPGetHeaderField( inHeader->buf, inHeader->len, "ETag", NULL, NULL, &value, &valueLen, NULL ) != kNoErr ||
+      ( valueLen >= 2 && strncmp( value, "W/", 2 ) == 0 ) ) {
+    if( HTTPGetHeaderField( inHeader->buf, inHeader->len, "Last-Modified", NULL, NULL, &value, &valueLen, NULL ) != kNoErr )
+      return false;
+  }
+  if( valueLen == 0 || valueLen >= OTA_DOWNLOAD_VALIDATOR_MAX ) return false;
+  memcpy( validator, value, valueLen );
+  validator[valueLen] = 0;
+
+  CRC16_Init( &contex );
+  CRC16_Update( &contex, validator, valueLen );
+  CRC16_Final( &contex, id );
+  return true;
+}
+
+static OSStatus http_received( struct _HTTPHeader_t * inHeader, uint32_t inPos, uint8_t * inData, size_t inLen, void * inUserContext )
+{
+  ota_download_t *d = inUserContext;
+  unsigned long first, last, total;
+  char validator[OTA_DOWNLOAD_VALIDATOR_MAX];
+  uint16_t validator_id = 0;
+  bool validated, changed;
+  OSStatus err = kNoErr;
+
+  UNUSED_PARAMETER( inPos );
+  require_noerr_action( d->err, exit, err = d->err );
+
+  /* A server that does not serve ranges, or whose image is not the one of the
+     If-Range, sends the image from the start */
+  if( !d->body ) {
+    d->body = true;
+    validated = http_validator( inHeader, validator, &validator_id );
+    changed = d->validated && ( !validated || validator_id != d->validator_id );
+    if( inHeader->statusCode == kStatusPartialContent ) {
+      require_action( HTTPScanFHeaderValue( inHeader->buf, inHeader->len, "Content-Range", "bytes %lu-%lu/%lu", &first, &last, &total ) == 3,
+                      exit, err = kMalformedErr );
+      require_action( first == d->received && last + 1 == total, exit, err = kResponseErr );
+      /* Another image: ask for it from the start */
+      if( changed ) {
+        ota_download_log("Image changed, download again");
+        ota_download_again( d );
+        err = kResponseErr;
+        goto exit;
+      }
+      if( d->total != 0 && d->total != total ) {
+        err = ota_download_size( d, total );
+        require_noerr( err, exit );
+        err = kResponseErr;
+        goto exit;
+      }
+      err = ota_download_size( d, total );
+      require_noerr( err, exit );
+      ota_download_begin( d, first );
+    } else if( inHeader->statusCode == kStatusOK ) {
+      if( changed ) {
+        ota_download_log("Image changed, download again");
+        ota_download_again( d );
+      }
+      err = ota_download_size( d, (uint32_t)inHeader->contentLength );
+      require_noerr( err, exit );
+      ota_download_begin( d, 0 );
+    } else {
+      ota_download_log("HTTP status %d", inHeader->statusCode);
+      err = kNotFoundErr;
+      goto exit;
+    }
+
+    /* The boot table records it on a new download */
+    d->validated = validated;
+    d->validator_id = validator_id;
+    strcpy( d->validator, validated ? validator : "" );
+  }
+
+  err = ota_download_write( d, inData, inLen );
+
+exit:
+  d->err = err;
+  return err;
+}
+
+static OSStatus http_get( ota_download_t *d, uint32_t ip, const char *host, uint16_t port, const char *path )
+{
+  OSStatus err = kNoErr;
+  HTTPHeader_t *httpHeader = NULL;
+  struct sockaddr_t addr;
+  char *request = NULL;
+  int fd = -1;
+
+  request = malloc( strlen( path ) + strlen( host ) + OTA_DOWNLOAD_VALIDATOR_MAX + 100 );
+  require_action( request, exit, err = kNoMemoryErr );
+  if( d->received && d->validator[0] )
+    sprintf( request, "GET %s HTTP/1.1\r\nHost: %s:%d\r\nRange: bytes=%lu-\r\nIf-Range: %s\r\n\r\n",
+             path, host, port, (unsigned long)d->received, d->validator );
+  else
+    sprintf( request, "GET %s HTTP/1.1\r\nHost: %s:%d\r\nRange: bytes=%lu-\r\n\r\n", path, host, port, (unsigned long)d->received );
+
+  httpHeader = HTTPHeaderCreateWithCallback( OTA_DOWNLOAD_HTTP_HEADER_SIZE, http_received, NULL, d );
+  require_action( httpHeader, exit, err = kNoMemoryErr );
+  d->body = false;
+  d->err = kNoErr;
+
+  fd = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+  require_action( IsValidSocket( fd ), exit, err = kNoResourcesErr );
+  addr.s_ip = ip;
+  addr.s_port = port;
+  err = connect( fd, &addr, sizeof(addr) );
+  require_noerr_action( err, exit, err = kConnectionErr );
+  err = SocketSend( fd, (uint8_t *)request, strlen( request ) );
+  require_noerr( err, exit );
+
+  /* The body goes to http_received() once the header is read */
+  err = SocketReadHTTPHeader( fd, httpHeader );
+  if( d->err != kNoErr ) err = d->err;
+  require_noerr( err, exit );
+  require_action( httpHeader->statusCode == kStatusOK || httpHeader->statusCode == kStatusPartialContent, exit, err = kNotFoundErr );
+  err = SocketReadHTTPBody( fd, httpHeader );
+  if( d->err != kNoErr ) err = d->err;
+
+exit:
+  SocketClose( &fd );
+  HTTPHeaderDestory( &httpHeader );
+  if( request ) free( request );
+  return err;
+}
+
+OSStatus ota_download_http( const char *url, uint32_t *length )
+{
+  OSStatus err = kNoErr;
+  ota_download_t download;
+  const char *path;
+  char *host = NULL, *p;
+  char ipstr[16];
+  uint32_t ip, last;
+  uint16_t port = 80;
+  int retry = OTA_DOWNLOAD_RETRY;
+
+  require_action( strncmp( url, "http://", 7 ) == 0, exit, err = kParamErr );
+  host = malloc( strlen( url ) );
+  require_action( host, exit, err = kNoMemoryErr );
+  strcpy( host, url + 7 );
+  path = strchr( url + 7, '/' );
+  if( path ) host[path - ( url + 7 )] = 0;
+  else path = "/";
+  p = strchr( host, ':' );
+  if( p ) {
+    *p++ = 0;
+    port = (uint16_t)atoi( p );
+  }
+
+  err = gethostbyname( host, (uint8_t *)ipstr, sizeof(ipstr) );
+  require_noerr( err, exit );
+  ip = inet_addr( ipstr );
+
+  err = ota_download_init( &download, url );
+  require_noerr( err, exit );
+  /* Go on from the last checkpoint */
+  download.received = download.kept;
+
+  /* A connection cut off goes on from where it stopped, as long as each one
+     brings something. Without a validator the image is asked for from the
+     start, what was written is checked against it */
+  while( download.total == 0 || download.received < download.total ) {
+    if( !download.validated ) ota_download_begin( &download, 0 );
+    last = ( download.received > download.kept ) ? download.received : download.kept;
+    err = http_get( &download, ip, host, port, path );
+    if( err == kNoErr ) break;
+    if( err == kNotFoundErr || err == kMismatchErr || err == kSizeErr || err == kMalformedErr ) break;
+    if( download.received > last ) retry = OTA_DOWNLOAD_RETRY;
+    else if( --retry <= 0 ) break;
+    ota_download_log("Connection cut off at %d bytes, err %d", download.received, err);
+  }
+  require_noerr( err, exit );
+  err = ota_download_finish( &download, length );
+
+exit:
+  if( err == kMismatchErr ) ota_download_reset( );
+  if( err != kNoErr ) ota_download_log("HTTP download failed, err %d", err);
+  if( host ) free( host );
+  return err;
+}
+
+OSStatus ota_download_reset( void )
+{
+  OSStatus err = kNoErr;
+  mico_Context_t *context = mico_system_context_get( );
+
+  mico_rtos_lock_mutex( &context->flashContentInRam_mutex );
+  if( context->flashContentInRam.bootTable.upgrade_type == 'R' ) {
+    memset( &context->flashContentInRam.bootTable, 0, sizeof(boot_table_t) );
+    err = mico_system_context_update( context );
+  }
+  mico_rtos_unlock_mutex( &context->flashContentInRam_mutex );
+  return err;
+}
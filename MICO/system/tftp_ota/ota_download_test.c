@@ -0,0 +1,376 @@
+/**
+******************************************************************************
+* @file    ota_download_test.c
+* @version V1.0.0
+* @date    17-Oct-2026
+* @brief   Download test of ota_download.c against ota_server.py, on
+*          simulated flash. Over TFTP the server loses packets, and the lost
+*          blocks of a window must be sent again; over HTTP it cuts
+*          responses short, and the download must go on with a range. Then
+*          the power is cut in the middle of each, the application and the
+*          bootloader boot again, and the download must go on from the last
+*          checkpoint, writing only the rest. An HTTP file replaced by
+*          another of the same length after the power cut must be downloaded
+*          whole, and so must an image whose kept steps a bootloader erased
+*          without clearing the partition state. Start the server first, on
+*          the directory the test writes its images to, from the repository
+*          root:
+*            python MICO/system/tftp_ota/ota_server.py -d /tmp -t 6969
+*                   -p 8089 -l 0.05 -c 0.5
+*          Built on the host on its own, it includes
+*          mico_system_para_storage.c and Update_for_OTA.c for the boot, and
+*          ota_download.c, SocketUtils.c and HTTPUtils.c with their socket
+*          calls renamed to the ones of ota_download_test_net.c; StringUtils.c,
+*          URLUtils.c, CheckSumUtils.c, ota_lz.c and ota_delta.c are linked
+*          with it. The power cuts leave the buffers of the download
+*          behind, run it with ASAN_OPTIONS=detect_leaks=0 when built with
+*          the address sanitizer. Not part of the default build.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The socket calls of the code included below, see ota_download_test_net.c */
+#define socket                  ota_download_test_socket
+#define bind                    ota_download_test_bind
+#define connect                 ota_download_test_connect
+#define select                  ota_download_test_select
+#define send                    ota_download_test_send
+#define write                   ota_download_test_write
+#define sendto                  ota_download_test_sendto
+#define recv                    ota_download_test_recv
+#define read                    ota_download_test_read
+#define recvfrom                ota_download_test_recvfrom
+#define close                   ota_download_test_close
+#define inet_addr               ota_download_test_inet_addr
+#define gethostbyname           ota_download_test_gethostbyname
+
+/* Port 69 is for root on the host */
+#ifndef OTA_DOWNLOAD_TFTP_PORT
+#define OTA_DOWNLOAD_TFTP_PORT  6969
+#endif
+
+#include "mico_system_para_storage.c"
+#include "Update_for_OTA.c"
+#include "ota_download.c"
+#include "SocketUtils.c"
+#include "HTTPUtils.c"
+
+#ifndef OTA_DOWNLOAD_TEST_DIR
+#define OTA_DOWNLOAD_TEST_DIR   "/tmp"      /* Served by ota_server.py -d */
+#endif
+#ifndef OTA_DOWNLOAD_TEST_HTTP_PORT
+#define OTA_DOWNLOAD_TEST_HTTP_PORT 8089
+#endif
+#define DOWNLOAD_TEST_FILE      "ota_download_test.bin"
+#define DOWNLOAD_TEST_LENGTH    ( 300001 )
+#define DOWNLOAD_TEST_CUT       ( 200000 )  /* Bytes written to the OTA partition before the power cut */
+#define DOWNLOAD_TEST_SECTOR    ( 4096 )
+#define DOWNLOAD_TEST_USER_SIZE ( 200 )
+
+enum { DOWNLOAD_TEST_APP, DOWNLOAD_TEST_OTA, DOWNLOAD_TEST_PARA1, DOWNLOAD_TEST_PARA2, DOWNLOAD_TEST_BANKS };
+
+/* The OTA temporary partition in SPI flash, checkpoints of 16 KB */
+static mico_logic_partition_t download_test_partitions[DOWNLOAD_TEST_BANKS] = {
+  { MICO_FLASH_EMBEDDED, "Application", 0x13000, 0x70000, 0 },
+  { MICO_FLASH_SPI,      "OTA Storage", 0x40000, 0x70000, 0 },
+  { MICO_FLASH_EMBEDDED, "PARAMETER1",  0x0,     0x1000,  0 },
+  { MICO_FLASH_EMBEDDED, "PARAMETER2",  0x1000,  0x1000,  0 },
+};
+static uint8_t *download_test_flash[DOWNLOAD_TEST_BANKS];
+static unsigned long download_test_written;   /* Bytes written to the OTA partition */
+static unsigned long download_test_reprogrammed;
+static long download_test_cut = -1;           /* Bytes written before the power fails */
+static jmp_buf download_test_power_cut;
+static mico_Context_t *download_test_context;
+static uint8_t download_test_image[DOWNLOAD_TEST_LENGTH];
+static int download_test_print;
+
+extern unsigned long ota_download_test_datagrams;
+void ota_download_test_net_reboot( void );
+
+static int download_test_bank( mico_partition_t partition )
+{
+  switch( partition ) {
+    case MICO_PARTITION_APPLICATION:  return DOWNLOAD_TEST_APP;
+    case MICO_PARTITION_OTA_TEMP:     return DOWNLOAD_TEST_OTA;
+    case MICO_PARTITION_PARAMETER_1:  return DOWNLOAD_TEST_PARA1;
+    default:                          return DOWNLOAD_TEST_PARA2;
+  }
+}
+
+mico_logic_partition_t *MicoFlashGetInfo( mico_partition_t inPartition )
+{
+  return &download_test_partitions[download_test_bank( inPartition )];
+}
+
+OSStatus MicoFlashDisableSecurity( mico_partition_t partition, uint32_t off_set, uint32_t size )
+{
+  return kNoErr;
+}
+
+OSStatus MicoFlashErase( mico_partition_t inPartition, uint32_t off_set, uint32_t size )
+{
+  int bank = download_test_bank( inPartition );
+  uint32_t start = off_set - off_set % DOWNLOAD_TEST_SECTOR, end = off_set + size;
+
+  if( size == 0 ) return kNoErr;
+  end += ( DOWNLOAD_TEST_SECTOR - end % DOWNLOAD_TEST_SECTOR ) % DOWNLOAD_TEST_SECTOR;
+  if( end > download_test_partitions[bank].partition_length ) return kParamErr;
+  memset( &download_test_flash[bank][start], 0xFF, end - start );
+  return kNoErr;
+}
+
+OSStatus MicoFlashWrite( mico_partition_t inPartition, volatile uint32_t* off_set, uint8_t* inBuffer, uint32_t inBufferLength )
+{
+  int bank = download_test_bank( inPartition );
+  uint8_t *flash = download_test_flash[bank];
+  uint32_t i;
+
+  if( *off_set + inBufferLength > download_test_partitions[bank].partition_length ) return kParamErr;
+  for( i = 0; i < inBufferLength; i++, (*off_set)++ ) {
+    if( bank == DOWNLOAD_TEST_OTA ) {
+      if( download_test_cut > 0 && --download_test_cut == 0 ) longjmp( download_test_power_cut, 1 );
+      download_test_written++;
+    }
+    /* Programming can only clear bits */
+    if( ( flash[*off_set] & inBuffer[i] ) != inBuffer[i] ) download_test_reprogrammed++;
+    flash[*off_set] &= inBuffer[i];
+  }
+  return kNoErr;
+}
+
+OSStatus MicoFlashRead( mico_partition_t inPartition, volatile uint32_t* off_set, uint8_t* outBuffer, uint32_t inBufferLength )
+{
+  int bank = download_test_bank( inPartition );
+
+  if( *off_set + inBufferLength > download_test_partitions[bank].partition_length ) return kParamErr;
+  memcpy( outBuffer, &download_test_flash[bank][*off_set], inBufferLength );
+  *off_set += inBufferLength;
+  return kNoErr;
+}
+
+mico_Context_t *mico_system_context_get( void )
+{
+  return download_test_context;
+}
+
+uint32_t mico_get_time( void )
+{
+  return 0;
+}
+
+OSStatus mico_rtos_lock_mutex( mico_mutex_t* mutex )
+{
+  return kNoErr;
+}
+
+OSStatus mico_rtos_unlock_mutex( mico_mutex_t* mutex )
+{
+  return kNoErr;
+}
+
+int mico_delete_event_fd( int fd )
+{
+  return kNoErr;
+}
+
+int ssl_recv( mico_ssl_t ssl, void *data, size_t len )
+{
+  return -1;
+}
+
+int CyaSSL_get_fd( mico_ssl_t ssl )
+{
+  return -1;
+}
+
+/* The application starts: forget everything held in RAM and read the
+   settings back */
+static OSStatus download_test_app_boot( void )
+{
+  if( para_store.index ) free( para_store.index );
+  memset( &para_store, 0x0, sizeof(para_store) );
+  para_store.active = -1;
+  seedNum = 0;
+
+  memset( &download_test_context->flashContentInRam, 0x0, sizeof(flash_content_t) );
+  memset( download_test_context->user_config_data, 0x0, DOWNLOAD_TEST_USER_SIZE );
+  return MICOReadConfiguration( download_test_context );
+}
+
+/* After a power cut: the sockets are gone, the bootloader runs, then the
+   application */
+static OSStatus download_test_reboot( void )
+{
+  OSStatus err;
+
+  ota_download_test_net_reboot( );
+  err = download_test_app_boot( );
+  if( err == kNoErr ) err = update( );
+  if( err == kNoErr ) err = download_test_app_boot( );
+  return err;
+}
+
+/* The image on the server, one for each seed */
+static bool download_test_serve( uint32_t seed )
+{
+  FILE *f = fopen( OTA_DOWNLOAD_TEST_DIR "/" DOWNLOAD_TEST_FILE, "wb" );
+  uint32_t i;
+  bool ok;
+
+  for( i = 0; i < DOWNLOAD_TEST_LENGTH; i++ ) {
+    seed = seed * 1103515245 + 12345;
+    download_test_image[i] = seed >> 16;
+  }
+  if( f == NULL ) return false;
+  ok = fwrite( download_test_image, 1, DOWNLOAD_TEST_LENGTH, f ) == DOWNLOAD_TEST_LENGTH;
+  return ( fclose( f ) == 0 ) && ok;
+}
+
+static OSStatus download_test_get( bool http, uint32_t *length )
+{
+  char url[64];
+
+  *length = 0;
+  download_test_written = 0;
+  if( !http ) return ota_download_tftp( IPADDR_LOOPBACK, DOWNLOAD_TEST_FILE, length );
+  sprintf( url, "http://127.0.0.1:%d/" DOWNLOAD_TEST_FILE, OTA_DOWNLOAD_TEST_HTTP_PORT );
+  return ota_download_http( url, length );
+}
+
+static bool download_test_downloaded( OSStatus err, uint32_t length )
+{
+  return err == kNoErr && length == DOWNLOAD_TEST_LENGTH &&
+         memcmp( download_test_flash[DOWNLOAD_TEST_OTA], download_test_image, DOWNLOAD_TEST_LENGTH ) == 0;
+}
+
+static int download_test_check( bool ok, const char *mode, const char *what )
+{
+  if( !ok && download_test_print ) printf( "ota_download_test: %s: %s\r\n", mode, what );
+  return ok ? 0 : 1;
+}
+
+/* A new download, the power cut after DOWNLOAD_TEST_CUT bytes written, then
+   the reboot. True if it was cut off where expected and recorded */
+static bool download_test_power_cut_at( bool http )
+{
+  uint32_t length;
+  bool cut = false;
+
+  ota_download_reset( );
+  download_test_cut = DOWNLOAD_TEST_CUT;
+  if( setjmp( download_test_power_cut ) == 0 )
+    download_test_get( http, &length );
+  else
+    cut = true;
+  download_test_cut = -1;
+  return cut && download_test_reboot( ) == kNoErr &&
+         download_test_context->flashContentInRam.bootTable.upgrade_type == 'R';
+}
+
+static int download_test_mode( bool http )
+{
+  const char *mode = http ? "HTTP" : "TFTP";
+  uint32_t blocks = DOWNLOAD_TEST_LENGTH / OTA_DOWNLOAD_TFTP_BLKSIZE + 1, step = 0x4000, length;
+  unsigned long datagrams;
+  OSStatus err;
+  int bad = 0;
+
+  /* Whole, with the faults of the server */
+  ota_download_reset( );
+  bad += download_test_check( download_test_serve( 1 ), mode, "image not written to " OTA_DOWNLOAD_TEST_DIR );
+  ota_download_test_datagrams = 0;
+  err = download_test_get( http, &length );
+  datagrams = ota_download_test_datagrams;
+  if( !http && err == kTimeoutErr && download_test_print )
+    printf( "ota_download_test: no answer, start ota_server.py -d " OTA_DOWNLOAD_TEST_DIR " -t %d -p %d -l 0.05 -c 0.5\r\n",
+            OTA_DOWNLOAD_TFTP_PORT, OTA_DOWNLOAD_TEST_HTTP_PORT );
+  bad += download_test_check( download_test_downloaded( err, length ), mode, "image not downloaded" );
+  if( !http ) {
+    /* The blocks lost by the server are sent again, the OACK is one more */
+    bad += download_test_check( datagrams > blocks + 1, mode, "no block sent again, run ota_server.py with -l" );
+    if( download_test_print ) printf( "%s: %d blocks of %d bytes, %lu datagrams received\r\n", mode,
+                                      (int)blocks, OTA_DOWNLOAD_TFTP_BLKSIZE, datagrams );
+  }
+  if( bad ) return bad;
+
+  /* Power cut: the checkpoints written before are kept, the rest written once */
+  bad += download_test_check( download_test_power_cut_at( http ), mode, "download not recorded across the power cut" );
+  bad += download_test_check( !http || download_test_context->flashContentInRam.bootTable.version[0] == OTA_DOWNLOAD_VALIDATOR_TAG,
+                              mode, "validator not recorded" );
+  err = download_test_get( http, &length );
+  bad += download_test_check( download_test_downloaded( err, length ), mode, "image not downloaded after the power cut" );
+  bad += download_test_check( download_test_written == DOWNLOAD_TEST_LENGTH - DOWNLOAD_TEST_CUT / step * step,
+                              mode, "not resumed from the last checkpoint" );
+  if( download_test_print ) printf( "%s: power cut after %d bytes, %lu bytes written after it\r\n", mode,
+                                    DOWNLOAD_TEST_CUT, download_test_written );
+
+  /* Power cut, then a bootloader erases the partition and leaves its state */
+  bad += download_test_check( download_test_power_cut_at( http ), mode, "download not recorded across the power cut" );
+  memset( download_test_flash[DOWNLOAD_TEST_OTA], 0xFF, download_test_partitions[DOWNLOAD_TEST_OTA].partition_length );
+  err = download_test_get( http, &length );
+  bad += download_test_check( download_test_downloaded( err, length ) && download_test_written == DOWNLOAD_TEST_LENGTH,
+                              mode, "image erased since not downloaded from the start" );
+
+  /* Power cut, then another file of the same length on the server */
+  if( http ) {
+    bad += download_test_check( download_test_power_cut_at( http ), mode, "download not recorded across the power cut" );
+    bad += download_test_check( download_test_serve( 2 ), mode, "image not written to " OTA_DOWNLOAD_TEST_DIR );
+    err = download_test_get( http, &length );
+    bad += download_test_check( download_test_downloaded( err, length ), mode, "file replaced not downloaded from the start" );
+  }
+  return bad;
+}
+
+OSStatus ota_download_test( int print )
+{
+  int bank, bad;
+
+  download_test_print = print;
+  for( bank = 0; bank < DOWNLOAD_TEST_BANKS; bank++ ) {
+    download_test_flash[bank] = malloc( download_test_partitions[bank].partition_length );
+    memset( download_test_flash[bank], 0xFF, download_test_partitions[bank].partition_length );
+  }
+  download_test_context = calloc( 1, sizeof(mico_Context_t) );
+  download_test_context->user_config_data = calloc( 1, DOWNLOAD_TEST_USER_SIZE );
+  download_test_context->user_config_data_size = DOWNLOAD_TEST_USER_SIZE;
+
+  bad = download_test_check( download_test_reboot( ) == kNoErr, "boot", "first boot failed" );
+  bad += download_test_mode( false );
+  bad += download_test_mode( true );
+  bad += download_test_check( download_test_reprogrammed == 0, "flash", "programmed a byte that was not erased" );
+  remove( OTA_DOWNLOAD_TEST_DIR "/" DOWNLOAD_TEST_FILE );
+
+  free( download_test_context->user_config_data );
+  free( download_test_context );
+  for( bank = 0; bank < DOWNLOAD_TEST_BANKS; bank++ )
+    free( download_test_flash[bank] );
+
+  if( print ) printf( "ota_download_test: %s\r\n", bad ? "FAILED" : "PASSED" );
+  return bad ? kGeneralErr : kNoErr;
+}
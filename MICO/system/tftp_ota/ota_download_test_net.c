@@ -0,0 +1,214 @@
+/**
+******************************************************************************
+* @file    ota_download_test_net.c
+* @version V1.0.0
+* @date    17-Oct-2026
+* @brief   The MICO socket calls of ota_download_test.c, made on the sockets
+*          of the host. ota_download_test.c renames the calls of the code it
+*          includes to the ota_download_test_ ones here, this file sees only
+*          the headers of the host, so the layouts of sockaddr_t, fd_set and
+*          timeval_t in mico_socket.h are repeated below. Counts the
+*          datagrams received, and closes every socket left open on a
+*          simulated reboot. Not part of the default build.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#define _DEFAULT_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+#define NET_TEST_SOCKETS        ( 24 )    /* FD_SETSIZE in mico_socket.h */
+
+/* As in mico_socket.h */
+struct net_test_sockaddr_t {
+  uint16_t        s_type;
+  uint16_t        s_port;
+  uint32_t        s_ip;
+  uint16_t        s_spares[6];
+};
+
+struct net_test_timeval_t {
+  unsigned long   tv_sec;
+  unsigned long   tv_usec;
+};
+
+typedef struct {
+  unsigned long   fds_bits[1];
+} net_test_fd_set;
+
+static uint8_t net_test_open[NET_TEST_SOCKETS];
+unsigned long ota_download_test_datagrams;
+
+static void net_test_to_host( const struct net_test_sockaddr_t *addr, struct sockaddr_in *host )
+{
+  memset( host, 0, sizeof(struct sockaddr_in) );
+  host->sin_family = AF_INET;
+  host->sin_port = htons( addr->s_port );
+  host->sin_addr.s_addr = htonl( addr->s_ip );
+}
+
+int ota_download_test_socket( int domain, int type, int protocol )
+{
+  int fd = socket( AF_INET, ( type == 1 ) ? SOCK_STREAM : SOCK_DGRAM, 0 );
+
+  (void)domain;
+  (void)protocol;
+  if( fd >= NET_TEST_SOCKETS ) {
+    close( fd );
+    return -1;
+  }
+  if( fd >= 0 ) net_test_open[fd] = 1;
+  return fd;
+}
+
+int ota_download_test_bind( int sockfd, const struct net_test_sockaddr_t *addr, int addrlen )
+{
+  struct sockaddr_in host;
+
+  (void)addrlen;
+  net_test_to_host( addr, &host );
+  return bind( sockfd, (struct sockaddr *)&host, sizeof(host) );
+}
+
+int ota_download_test_connect( int sockfd, const struct net_test_sockaddr_t *addr, int addrlen )
+{
+  struct sockaddr_in host;
+
+  (void)addrlen;
+  net_test_to_host( addr, &host );
+  return connect( sockfd, (struct sockaddr *)&host, sizeof(host) );
+}
+
+int ota_download_test_select( int nfds, net_test_fd_set *readfds, net_test_fd_set *writefds,
+                              net_test_fd_set *exceptfds, struct net_test_timeval_t *timeout )
+{
+  net_test_fd_set *sets[3] = { readfds, writefds, exceptfds };
+  fd_set host[3];
+  struct timeval t;
+  int i, fd, n;
+
+  for( i = 0; i < 3; i++ ) {
+    FD_ZERO( &host[i] );
+    for( fd = 0; sets[i] && fd < nfds; fd++ )
+      if( sets[i]->fds_bits[0] & ( 1UL << fd ) ) FD_SET( fd, &host[i] );
+  }
+  if( timeout ) {
+    t.tv_sec = timeout->tv_sec;
+    t.tv_usec = timeout->tv_usec;
+  }
+  n = select( nfds, &host[0], &host[1], &host[2], timeout ? &t : NULL );
+  for( i = 0; i < 3; i++ )
+    for( fd = 0; sets[i] && fd < nfds; fd++ )
+      if( !FD_ISSET( fd, &host[i] ) ) sets[i]->fds_bits[0] &= ~( 1UL << fd );
+  return n;
+}
+
+ssize_t ota_download_test_send( int sockfd, const void *buf, size_t len, int flags )
+{
+  (void)flags;
+  return send( sockfd, buf, len, MSG_NOSIGNAL );
+}
+
+int ota_download_test_write( int sockfd, void *buf, size_t len )
+{
+  return (int)send( sockfd, buf, len, MSG_NOSIGNAL );
+}
+
+ssize_t ota_download_test_sendto( int sockfd, const void *buf, size_t len, int flags,
+                                  const struct net_test_sockaddr_t *dest_addr, int addrlen )
+{
+  struct sockaddr_in host;
+
+  (void)flags;
+  (void)addrlen;
+  net_test_to_host( dest_addr, &host );
+  return sendto( sockfd, buf, len, 0, (struct sockaddr *)&host, sizeof(host) );
+}
+
+ssize_t ota_download_test_recv( int sockfd, void *buf, size_t len, int flags )
+{
+  (void)flags;
+  return recv( sockfd, buf, len, 0 );
+}
+
+int ota_download_test_read( int sockfd, void *buf, size_t len )
+{
+  return (int)recv( sockfd, buf, len, 0 );
+}
+
+ssize_t ota_download_test_recvfrom( int sockfd, void *buf, size_t len, int flags,
+                                    struct net_test_sockaddr_t *src_addr, int *addrlen )
+{
+  struct sockaddr_in host;
+  socklen_t hostLen = sizeof(host);
+  ssize_t n;
+
+  (void)flags;
+  n = recvfrom( sockfd, buf, len, 0, (struct sockaddr *)&host, &hostLen );
+  if( n >= 0 ) ota_download_test_datagrams++;
+  if( src_addr ) {
+    memset( src_addr, 0, sizeof(struct net_test_sockaddr_t) );
+    src_addr->s_port = ntohs( host.sin_port );
+    src_addr->s_ip = ntohl( host.sin_addr.s_addr );
+  }
+  if( addrlen ) *addrlen = sizeof(struct net_test_sockaddr_t);
+  return n;
+}
+
+int ota_download_test_close( int fd )
+{
+  if( fd >= 0 && fd < NET_TEST_SOCKETS ) net_test_open[fd] = 0;
+  return close( fd );
+}
+
+uint32_t ota_download_test_inet_addr( char *s )
+{
+  return ntohl( inet_addr( s ) );
+}
+
+int ota_download_test_gethostbyname( const char *name, uint8_t *addr, uint8_t addrLen )
+{
+  struct hostent *host = gethostbyname( name );
+
+  if( host == NULL || host->h_addrtype != AF_INET ) return -1;
+  snprintf( (char *)addr, addrLen, "%s", inet_ntoa( *(struct in_addr *)host->h_addr ) );
+  return 0;
+}
+
+/* The reboot closes the sockets of a download cut off by the power */
+void ota_download_test_net_reboot( void )
+{
+  int fd;
+
+  for( fd = 0; fd < NET_TEST_SOCKETS; fd++ )
+    if( net_test_open[fd] ) ota_download_test_close( fd );
+}
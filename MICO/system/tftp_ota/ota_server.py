@@ -0,0 +1,275 @@
+#!/usr/bin/env python
+"""Serve OTA images over TFTP and HTTP, as ota_download.c fetches them.
+
+The TFTP server takes the blksize, tsize and windowsize options (RFC 2348,
+2349, 7440) and sends a window of blocks for each acknowledgement, going on
+from the block after the one acknowledged. The HTTP server answers Range
+requests with 206 Partial Content, sends an ETag, the MD5 of the file, and
+its Last-Modified date, and honours If-Range with either. For tftp_ota(),
+run it on 10.0.0.2 with mico_ota.bin, the image followed by its MD5, in the
+directory.
+
+Faults can be injected to check that downloads go on after them: each TFTP
+packet, sent or received, is dropped with the given probability, and each
+HTTP response is cut off after a random length with the other.
+
+usage: ota_server.py [-d dir] [-t tftp_port] [-p http_port]
+                     [-l tftp_loss] [-c http_cut] [-r] [-n]
+       (-r ignores HTTP ranges, answering 200 with all the file,
+        -n sends no ETag or Last-Modified)
+"""
+
+import email.utils
+import getopt
+import hashlib
+import os
+import random
+import re
+import socket
+import struct
+import sys
+import threading
+
+try:
+    from http.server import BaseHTTPRequestHandler, HTTPServer
+    from socketserver import ThreadingMixIn
+except ImportError:
+    from BaseHTTPServer import BaseHTTPRequestHandler, HTTPServer
+    from SocketServer import ThreadingMixIn
+
+RRQ, DATA, ACK, ERROR, OACK = 1, 3, 4, 5, 6
+ERR_NOT_FOUND, ERR_ILLEGAL = 1, 4
+BLKSIZE = 512
+BLKSIZE_MAX = 65464
+WINDOW_MAX = 64
+TIMEOUT = 1.0
+RETRIES = 5
+
+
+class Lossy(object):
+    """A UDP socket losing packets both ways."""
+
+    def __init__(self, sock, loss):
+        self.sock = sock
+        self.loss = loss
+
+    def sendto(self, data, addr):
+        if random.random() >= self.loss:
+            self.sock.sendto(data, addr)
+
+    def recvfrom(self):
+        while True:
+            data, addr = self.sock.recvfrom(65536)
+            if random.random() >= self.loss:
+                return data, addr
+
+
+def _error(sock, addr, code, text):
+    sock.sendto(struct.pack('!HH', ERROR, code) + text.encode() + b'\0', addr)
+
+
+def _parse_request(packet):
+    fields = packet[2:].split(b'\0')
+    if len(fields) < 3:
+        raise ValueError('malformed request')
+    options = {}
+    for k in range(2, len(fields) - 1, 2):
+        options[fields[k].decode().lower()] = fields[k + 1].decode()
+    return fields[0].decode(), fields[1].decode().lower(), options
+
+
+def tftp_transfer(directory, packet, client, loss, cancel):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(('', 0))
+    sock.settimeout(TIMEOUT)
+    lossy = Lossy(sock, loss)
+    try:
+        try:
+            name, mode, options = _parse_request(packet)
+        except (ValueError, UnicodeDecodeError):
+            _error(sock, client, ERR_ILLEGAL, 'Malformed request')
+            return
+        path = os.path.join(directory, os.path.basename(name))
+        if mode != 'octet' or not os.path.isfile(path):
+            _error(sock, client, ERR_NOT_FOUND, 'File not found')
+            return
+        with open(path, 'rb') as f:
+            image = f.read()
+
+        blksize, window, accepted = BLKSIZE, 1, []
+        if 'blksize' in options:
+            blksize = max(8, min(int(options['blksize']), BLKSIZE_MAX))
+            accepted += [b'blksize', str(blksize).encode()]
+        if 'windowsize' in options:
+            window = max(1, min(int(options['windowsize']), WINDOW_MAX))
+            accepted += [b'windowsize', str(window).encode()]
+        if 'tsize' in options:
+            accepted += [b'tsize', str(len(image)).encode()]
+        blocks = len(image) // blksize + 1
+        print('TFTP %s:%d %s, %d bytes, block %d, window %d' % (client + (name, len(image), blksize, window)))
+
+        def acked(expect_oack, base):
+            """The block acknowledged from base, or None on a timeout."""
+            try:
+                while True:
+                    data, addr = lossy.recvfrom()
+                    if addr != client or len(data) < 4:
+                        continue
+                    opcode, block = struct.unpack('!HH', data[:4])
+                    if opcode == ERROR:
+                        raise EOFError
+                    if opcode != ACK:
+                        continue
+                    if expect_oack:
+                        if block == 0:
+                            return 0
+                        continue
+                    ahead = (block - base) & 0xFFFF
+                    if ahead <= window:
+                        return base + ahead
+            except socket.timeout:
+                return None
+
+        if accepted:
+            oack = struct.pack('!H', OACK) + b'\0'.join(accepted) + b'\0'
+            for _ in range(RETRIES):
+                lossy.sendto(oack, client)
+                if acked(True, 0) is not None:
+                    break
+            else:
+                return
+
+        base, tries = 0, 0
+        while base < blocks and not cancel.is_set():
+            for n in range(base + 1, min(base + window, blocks) + 1):
+                data = image[(n - 1) * blksize:n * blksize]
+                lossy.sendto(struct.pack('!HH', DATA, n & 0xFFFF) + data, client)
+            n = acked(False, base)
+            if n is None or n == base:
+                tries += 1
+                if tries > RETRIES:
+                    print('TFTP %s:%d gave up at block %d' % (client + (base,)))
+                    return
+                continue
+            base, tries = n, 0
+        print('TFTP %s:%d %s' % (client + ('cancelled' if cancel.is_set() else 'done',)))
+    except EOFError:
+        print('TFTP %s:%d aborted by the client' % client)
+    finally:
+        sock.close()
+
+
+def tftp_serve(directory, port, loss):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind(('', port))
+    transfers = {}
+    while True:
+        packet, client = sock.recvfrom(65536)
+        if len(packet) < 2 or struct.unpack('!H', packet[:2])[0] != RRQ or random.random() < loss:
+            continue
+        # A request sent again is served from another port, the client keeps
+        # to the first one that answers; an earlier transfer stops its window
+        if client in transfers:
+            transfers[client].set()
+        transfers[client] = threading.Event()
+        t = threading.Thread(target=tftp_transfer, args=(directory, packet, client, loss, transfers[client]))
+        t.daemon = True
+        t.start()
+
+
+class ThreadingHTTPServer(ThreadingMixIn, HTTPServer):
+    daemon_threads = True
+
+
+def http_handler(directory, cut, ranges, validators):
+    class Handler(BaseHTTPRequestHandler):
+        protocol_version = 'HTTP/1.1'
+
+        def do_GET(self):
+            path = os.path.join(directory, os.path.basename(self.path.split('?')[0]))
+            if not os.path.isfile(path):
+                self.send_error(404)
+                return
+            with open(path, 'rb') as f:
+                image = f.read()
+            etag = '"%s"' % hashlib.md5(image).hexdigest()
+            modified = email.utils.formatdate(os.path.getmtime(path), usegmt=True)
+            first = 0
+            match = re.match(r'bytes=(\d+)-$', self.headers.get('Range', ''))
+            if_range = self.headers.get('If-Range')
+            if if_range is not None and (not validators or if_range not in (etag, modified)):
+                match = None
+            if match and ranges:
+                first = int(match.group(1))
+                if first >= len(image):
+                    self.send_response(416)
+                    self.send_header('Content-Range', 'bytes */%d' % len(image))
+                    self.send_header('Content-Length', '0')
+                    self.end_headers()
+                    return
+                self.send_response(206)
+                self.send_header('Content-Range', 'bytes %d-%d/%d' % (first, len(image) - 1, len(image)))
+            else:
+                self.send_response(200)
+            self.send_header('Content-Type', 'application/octet-stream')
+            if validators:
+                self.send_header('ETag', etag)
+                self.send_header('Last-Modified', modified)
+            self.send_header('Content-Length', str(len(image) - first))
+            self.end_headers()
+
+            end = len(image)
+            if random.random() < cut:
+                end = random.randint(first, len(image) - 1)
+            for pos in range(first, end, 1024):
+                self.wfile.write(image[pos:min(pos + 1024, end)])
+            if end < len(image):
+                self.close_connection = True
+                self.wfile.flush()
+                self.connection.shutdown(socket.SHUT_RDWR)
+
+        def log_message(self, fmt, *args):
+            sys.stdout.write('HTTP %s %s\n' % (self.address_string(), fmt % args))
+
+    return Handler
+
+
+def main(argv):
+    directory, tftp_port, http_port = '.', 69, 8080
+    loss, cut, ranges, validators = 0.0, 0.0, True, True
+    opts, args = getopt.getopt(argv[1:], 'd:t:p:l:c:rn')
+    for opt, value in opts:
+        if opt == '-d':
+            directory = value
+        elif opt == '-t':
+            tftp_port = int(value)
+        elif opt == '-p':
+            http_port = int(value)
+        elif opt == '-l':
+            loss = float(value)
+        elif opt == '-c':
+            cut = float(value)
+        elif opt == '-r':
+            ranges = False
+        elif opt == '-n':
+            validators = False
+    if args or not 0 <= loss < 1 or not 0 <= cut <= 1:
+        sys.stderr.write(__doc__)
+        return 2
+
+    if tftp_port:
+        t = threading.Thread(target=tftp_serve, args=(directory, tftp_port, loss))
+        t.daemon = True
+        t.start()
+    print('Serving %s: TFTP port %d, HTTP port %d, TFTP loss %.0f%%, HTTP cuts %.0f%%' % (
+        directory, tftp_port, http_port, loss * 100, cut * 100))
+    if http_port:
+        ThreadingHTTPServer(('', http_port), http_handler(directory, cut, ranges, validators)).serve_forever()
+    else:
+        t.join()
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -1,5 +1,4 @@
 #include "mico.h"
-#include "tftp.h"
 #include "CheckSumUtils.h"
 #include "mico_system.h"
 
@@ -75,9 +74,8 @@ static void FOTA_WifiStatusHandler(WiFiEvent event, void * arg)
 void tftp_ota(void)
 {
     network_InitTypeDef_st conf;
-    tftp_file_info_t fileinfo;
-    uint32_t ipaddr = inet_addr(DEFAULT_OTA_SERVER), flashaddr;
-    int filelen, maxretry = 5, len, left, i = 0;
+    uint32_t ipaddr = inet_addr(DEFAULT_OTA_SERVER), flashaddr, filelen;
+    int maxretry = 5, len, left, i = 0;
     uint8_t md5_recv[16];
     uint8_t md5_calc[16];
     uint8_t *tmpbuf;
@@ -140,13 +138,11 @@ void tftp_ota(void)
     }
     fota_log("AP connected, tftp download image...");
 
-    fileinfo.filelen = ota_partition->partition_length;
-    fileinfo.flashaddr = 0;
-    fileinfo.flashtype = MICO_PARTITION_OTA_TEMP;
-    strcpy(fileinfo.filename, "mico_ota.bin");
+    context = mico_system_context_get( );
 
-    while((filelen = tget (&fileinfo, ipaddr)) < 0) {
-        fota_log("tget return filelen %d, maxretry %d", filelen, maxretry);
+    /* Each try goes on from what the previous ones wrote */
+    while(ota_download_tftp(ipaddr, "mico_ota.bin", &filelen) != kNoErr || filelen < 16) {
+        fota_log("tftp download failed, maxretry %d", maxretry);
         maxretry--;
         if (maxretry < 0) {
             fota_log("ERROR!! Can't get OTA image.");
@@ -190,13 +186,14 @@ void tftp_ota(void)
                  md5_calc[4],md5_calc[5],md5_calc[6],md5_calc[7],
                  md5_calc[8],md5_calc[9],md5_calc[10],md5_calc[11],
                  md5_calc[12],md5_calc[13],md5_calc[14],md5_calc[15]);
+        ota_download_reset();
+        free(tmpbuf);
         mico_ota_finished(OTA_MD5_FAIL, NULL);
         return;
     }
 
     fota_log("OTA bin md5 check success, CRC %x. upgrading...", crc);
 
-    context = mico_system_context_get( );
     memset(&context->flashContentInRam.bootTable, 0, sizeof(boot_table_t));
     context->flashContentInRam.bootTable.length = filelen;
     context->flashContentInRam.bootTable.start_address = ota_partition->partition_start_addr;
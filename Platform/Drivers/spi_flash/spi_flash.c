@@ -37,6 +37,12 @@
 
 #define sFLASH_SPI_PAGESIZE       0x100
 
+/* One DMA transfer moves at most 65535 bytes on the STM32 parts, so long
+   reads are split into data segments of this size, up to SFLASH_READ_SEGMENTS
+   of them under each read command. */
+#define SFLASH_READ_SEGMENT_SIZE  ( 32 * 1024 )
+#define SFLASH_READ_SEGMENTS      ( 4 )
+
 int sflash_read_ID( const sflash_handle_t* const handle, void* const data_addr )
 {
     return generic_sflash_command( handle, SFLASH_READ_JEDEC_ID, 0, NULL, 3, NULL, data_addr );
@@ -118,13 +124,51 @@ int sflash_read_status_register( const sflash_handle_t* const handle, void* cons
 
 
 
+/* The flash streams consecutive addresses for as long as chip select stays
+   low, so one command reads any length and the data lands in data_addr
+   directly, whatever its alignment. */
 int sflash_read( const sflash_handle_t* const handle, unsigned long device_address, void* const data_addr, unsigned int size )
 {
-    char device_address_array[3] =  { ( ( device_address & 0x00FF0000 ) >> 16 ),
-                                      ( ( device_address & 0x0000FF00 ) >>  8 ),
-                                      ( ( device_address & 0x000000FF ) >>  0 ) };
+    sflash_command_t cmd = SFLASH_READ;
+    char device_address_array[3];
+    sflash_platform_message_segment_t segments[2 + SFLASH_READ_SEGMENTS];
+    unsigned char* data = (unsigned char*) data_addr;
+    unsigned int num_segments;
+    unsigned long length;
+    int status;
 
-    return generic_sflash_command( handle, SFLASH_READ, 3, device_address_array, size, NULL, data_addr );
+    do
+    {
+        device_address_array[0] = (char) ( ( device_address & 0x00FF0000 ) >> 16 );
+        device_address_array[1] = (char) ( ( device_address & 0x0000FF00 ) >>  8 );
+        device_address_array[2] = (char) ( ( device_address & 0x000000FF ) >>  0 );
+
+        segments[0].tx_buffer = &cmd;
+        segments[0].rx_buffer = NULL;
+        segments[0].length    = 1;
+        segments[1].tx_buffer = device_address_array;
+        segments[1].rx_buffer = NULL;
+        segments[1].length    = 3;
+
+        for ( num_segments = 2; num_segments < 2 + SFLASH_READ_SEGMENTS && size > 0; num_segments++ )
+        {
+            length = ( size > SFLASH_READ_SEGMENT_SIZE ) ? SFLASH_READ_SEGMENT_SIZE : size;
+            segments[num_segments].tx_buffer = NULL;
+            segments[num_segments].rx_buffer = data;
+            segments[num_segments].length    = length;
+            data           += length;
+            device_address += length;
+            size           -= length;
+        }
+
+        status = sflash_platform_send_recv( handle->platform_peripheral, segments, num_segments );
+        if ( status != 0 )
+        {
+            return status;
+        }
+    } while ( size > 0 );
+
+    return 0;
 }
 
 
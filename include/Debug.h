@@ -32,12 +32,32 @@
 
 #define YesOrNo(x) (x ? "YES" : "NO")
 
+// Deferred logging: custom_log only stores the format pointer, a timestamp
+// and the arguments in a ring, the "LOG DRAIN" thread prints them later,
+// see MICO/system/mico_system_log.c. Asserts and traces stay synchronous.
+#ifndef MICO_DEFERRED_LOG
+#define MICO_DEFERRED_LOG 0
+#endif
+
 #if DEBUG
 #ifndef MICO_DISABLE_STDIO
 #ifndef NO_MICO_RTOS
    extern int mico_debug_enabled;
    extern mico_mutex_t stdio_tx_mutex;
 
+#if MICO_DEFERRED_LOG
+   void mico_system_log_deferred( const char *name, const char *file, int line, const char *format, ... );
+   void mico_system_log_flush( void );
+
+    #define custom_log(N, M, ...) do {if (mico_debug_enabled==0)break;\
+                                      mico_system_log_deferred(N, __FILE__, __LINE__, M, ##__VA_ARGS__);}while(0==1)
+
+    #define debug_print_assert(A,B,C,D,E,F) do {if (mico_debug_enabled==0)break;\
+                                                     mico_system_log_flush();\
+                                                     mico_rtos_lock_mutex( &stdio_tx_mutex );\
+                                                     printf("[%d][MICO:%s:%s:%4d] **ASSERT** %s""\r\n", mico_get_time(), D, F, E, (C!=NULL) ? C : "" );\
+                                                     mico_rtos_unlock_mutex( &stdio_tx_mutex );}while(0==1)
+#else
     #define custom_log(N, M, ...) do {if (mico_debug_enabled==0)break;\
                                       mico_rtos_lock_mutex( &stdio_tx_mutex );\
                                       printf("[%d][%s: %s:%4d] " M "\r\n", mico_get_time(), N, SHORT_FILE, __LINE__, ##__VA_ARGS__);\
@@ -47,6 +67,7 @@
                                                      mico_rtos_lock_mutex( &stdio_tx_mutex );\
                                                      printf("[%d][MICO:%s:%s:%4d] **ASSERT** %s""\r\n", mico_get_time(), D, F, E, (C!=NULL) ? C : "" );\
                                                      mico_rtos_unlock_mutex( &stdio_tx_mutex );}while(0==1)
+#endif // MICO_DEFERRED_LOG
     #if TRACE
         #define custom_log_trace(N) do {if (mico_debug_enabled==0)break;\
                                         mico_rtos_lock_mutex( &stdio_tx_mutex );\
@@ -127,6 +127,42 @@ void appRestoreDefault_callback(void * const user_config_data, uint32_t size);
   */
 OSStatus mico_system_context_update( mico_Context_t* const in_context );
 
+/**
+  * @brief  Record that the OTA temporary partition is about to be written, so
+  *         that the bootloader erases it again if no update is staged. Call it
+  *         with flashContentInRam_mutex held before the first write.
+  * @note   Every writer of MICO_PARTITION_OTA_TEMP must call it. Data written
+  *         without it leaves the state clean, the bootloader then takes the
+  *         partition as blank without reading it: what was written is
+  *         neither erased nor looked at, and is reported as 0 bytes by
+  *         mico_system_ota_partition_written.
+  * @param  in_context: The address of the core data.
+  * @param  length: Bytes that will be written from the start of the partition,
+  *         0 if not known.
+  * @retval kNoErr is returned on success, otherwise, kXXXErr is returned.
+  */
+OSStatus mico_system_ota_partition_dirty( mico_Context_t* const in_context, uint32_t length );
+
+/**
+  * @brief  Tell how much of the OTA temporary partition may hold data, from
+  *         its start. Call it with flashContentInRam_mutex held.
+  * @param  in_context: The address of the core data.
+  * @param  length: Receives the length, 0 if the partition is blank.
+  * @retval kNoErr is returned on success, otherwise, kXXXErr is returned.
+  */
+OSStatus mico_system_ota_partition_written( mico_Context_t* const in_context, uint32_t *length );
+
+/**
+  * @brief  Record the progress of a download in the reserved field of the boot
+  *         table, in place when it only clears bits, otherwise as
+  *         mico_system_context_update does. Call it with flashContentInRam_mutex
+  *         held.
+  * @param  in_context: The address of the core data.
+  * @param  progress: The new value of the reserved field.
+  * @retval kNoErr is returned on success, otherwise, kXXXErr is returned.
+  */
+OSStatus mico_system_ota_download_progress( mico_Context_t* const in_context, uint32_t progress );
+
 /** @} */
 /*****************************************************************************/
 /** \defgroup system System Framework Functions
@@ -244,6 +280,49 @@ OSStatus mico_system_monitor_register( mico_system_monitor_t* system_monitor, ui
   */
 OSStatus mico_system_monitor_update ( mico_system_monitor_t* system_monitor, uint32_t permitted_delay );
 
+/** @} */
+/*****************************************************************************/
+/** \defgroup system_log Deferred Log Functions
+  * @brief Control the deferred custom_log backend, available when DEBUG and
+  *        MICO_DEFERRED_LOG are both enabled.
+  * @{
+  */
+/*****************************************************************************/
+
+/** @brief Counters of the deferred log ring
+  */
+typedef struct _mico_system_log_stats_t
+{
+    uint32_t written;                  /**< Records printed or sent by the drain thread */
+    uint32_t dropped;                  /**< Records lost because the ring was full */
+    uint32_t truncated;                /**< Records whose arguments did not fit into one record */
+    uint32_t max_used;                 /**< Highest ring fill level seen, in bytes */
+} mico_system_log_stats_t;
+
+/**
+  * @brief  Start the thread that prints deferred log records
+  * @note   This function is called automatically by mico_system_init( ).
+  *         Records logged before are kept in the ring until it runs.
+  * @retval kNoErr is returned on success, otherwise, kXXXErr is returned.
+  */
+OSStatus mico_system_log_daemon_start( void );
+
+/**
+  * @brief  Select the output of the drain thread
+  * @param  raw: false prints text lines as custom_log always did, true
+  *         sends the binary records to STDIO_UART, each behind the sync
+  *         bytes 0xA5 0x5A, to be decoded on the host by mico_log_decode.py
+  * @retval None
+  */
+void mico_system_log_set_raw( bool raw );
+
+/**
+  * @brief  Read the deferred log counters
+  * @param  stats: Receives the counters
+  * @retval None
+  */
+void mico_system_log_get_stats( mico_system_log_stats_t *stats );
+
 
 /** @} */
 /*****************************************************************************/
@@ -510,9 +589,69 @@ void mdns_resume_record( char *service_name, WiFi_Interface interface );
   */
 void mdns_update_txt_record( char *service_name, WiFi_Interface interface, char *txt_record );
 
+#ifndef MDNS_TXT_RECORD_MAX
+#define MDNS_TXT_RECORD_MAX 128
+#endif
+
+/** @brief A service found on the network by mdns_browse_start or mdns_resolve
+  */
+typedef struct _mdns_service_t
+{
+  char instance_name[64];                   /**< The instance name, example: "device_name"  */
+  char service_name[64];                    /**< The service name, example: "_easylink._tcp.local."  */
+  char host_name[64];                       /**< The host name, example: "device_name.local."  */
+  char ip[16];                              /**< IPv4 address of the host, example: "192.168.1.100"  */
+  uint16_t service_port;                    /**< Service port */
+  char txt_record[MDNS_TXT_RECORD_MAX];     /**< Txt record, encoded as in mdns_init_t, truncated between two strings */
+} mdns_service_t;
+
+typedef enum
+{
+  MDNS_SERVICE_ADDED,     /**< A new instance is found and resolved */
+  MDNS_SERVICE_UPDATED,   /**< Address, port or txt record of a known instance changed */
+  MDNS_SERVICE_REMOVED,   /**< The instance said goodbye or its record expired */
+} mdns_service_event_t;
+
+typedef void (*mdns_browse_callback_t)( mdns_service_event_t event, const mdns_service_t *service, void *arg );
+
+/**
+  * @brief  Browse for instances of a service, a mDNS service daemon will be start if necessary.
+  *         The service is queried with an exponential backoff, 1 second up to one hour,
+  *         and the records found are kept in a cache shared by all browses and resolves.
+  *         A browse started for a service that is already browsed is served from that
+  *         cache first, and does not add queries of its own.
+  * @note   The callback runs in the mDNS thread, service is only valid during the call.
+  * @param  service_name: The service name to browse for, example: "_easylink._tcp.local."
+  * @param  callback: Called when an instance is added, updated or removed.
+  * @param  arg: Passed to callback.
+  * @retval kNoErr is returned on success, otherwise, kXXXErr is returned.
+  */
+OSStatus mdns_browse_start( char *service_name, mdns_browse_callback_t callback, void *arg );
+
+/**
+  * @brief  Stop a browse started by mdns_browse_start with the same parameters.
+  * @param  service_name: The service name of the browse.
+  * @param  callback: The callback of the browse.
+  * @param  arg: The arg of the browse.
+  * @retval kNoErr is returned on success, kNotFoundErr if there is no such browse.
+  */
+OSStatus mdns_browse_stop( char *service_name, mdns_browse_callback_t callback, void *arg );
+
+/**
+  * @brief  Look up host, address, port and txt record of a service instance, from the
+  *         cache if it holds them, otherwise by querying for them until timeout.
+  * @param  instance_name: The instance name, example: "device_name"
+  * @param  service_name: The service name, example: "_easylink._tcp.local."
+  * @param  service: Receives the result.
+  * @param  timeout_ms: How long to wait for the answers.
+  * @retval kNoErr is returned on success, kTimeoutErr if the instance did not answer in time,
+  *         otherwise, kXXXErr is returned.
+  */
+OSStatus mdns_resolve( char *instance_name, char *service_name, mdns_service_t *service, uint32_t timeout_ms );
+
 /** @} */
 /*****************************************************************************/
-/** \defgroup tftp_ota Firmware Update From a TFTP Server
+/** \defgroup tftp_ota Firmware Update From a TFTP or HTTP Server
   * @brief Provide an easy way to download firmware from tftp server, use a 
   *        predefined wlan and server address. It is used under factory environment
   * @{
@@ -525,6 +664,42 @@ void mdns_update_txt_record( char *service_name, WiFi_Interface interface, char
   */
 void tftp_ota(void);
 
+/**
+  * @brief  Download an image from a TFTP server into the OTA temporary
+  *         partition, with larger blocks and several blocks per acknowledgement
+  *         when the server accepts them (RFC 2348, RFC 7440). A download cut
+  *         off, even by a reboot, goes on from the last checkpoint kept in the
+  *         boot table: what is already in flash is checked, not written again.
+  * @param  server_ip: Address of the server, as returned by inet_addr.
+  * @param  filename: The file to get.
+  * @param  length: Receives the length of the image.
+  * @retval kNoErr is returned on success, otherwise, kXXXErr is returned.
+  */
+OSStatus ota_download_tftp( uint32_t server_ip, const char *filename, uint32_t *length );
+
+/**
+  * @brief  Download an image from an HTTP server into the OTA temporary
+  *         partition. A download cut off goes on with a Range request from
+  *         where it stopped, or from the last checkpoint kept in the boot table
+  *         after a reboot, as long as the ETag or Last-Modified date of the
+  *         file is still the one it had: a file replaced by another one is
+  *         downloaded again from the start. A file served with neither is
+  *         asked for from the start on each resume, what is in flash checked
+  *         against it; the download fails if it differs, and the next one
+  *         starts over.
+  * @param  url: "http://host[:port]/path".
+  * @param  length: Receives the length of the image.
+  * @retval kNoErr is returned on success, otherwise, kXXXErr is returned.
+  */
+OSStatus ota_download_http( const char *url, uint32_t *length );
+
+/**
+  * @brief  Forget the progress of a download, so that the next one starts
+  *         from the beginning, for an image found to be wrong once downloaded.
+  * @retval kNoErr is returned on success, otherwise, kXXXErr is returned.
+  */
+OSStatus ota_download_reset( void );
+
 /** @} */
 
 /** @} */
@@ -82,9 +82,24 @@ static bool httpd_stop_req;
 */
 #define HTTPD_MAX_BACKLOG_CONN 5
 
+/** Maximum number of client connections served at the same time
+*
+*  All client sockets are multiplexed by the single httpd thread in one
+*  select() loop, so a keep-alive connection that is idle does not block
+*  other clients.  Every connection costs one socket of the TCP/IP stack
+*  (FD_SETSIZE is shared by the whole system).  When all slots are in use,
+*  a new connection replaces the connection that has been idle longest.
+*  Can be overridden in mico_config.h.
+*/
+#ifndef HTTPD_MAX_CLIENT_CONN
+#define HTTPD_MAX_CLIENT_CONN 4
+#endif
+
 static int http_sockfd;
 
-int client_sockfd;
+static httpd_conn_t httpd_conns[HTTPD_MAX_CLIENT_CONN];
+/* Connection served first in the next round, rotated for fairness */
+static int httpd_conn_next;
 static bool https_active;
 
 bool httpd_is_https_active()
@@ -97,9 +112,40 @@ static int net_get_sock_error( int sock)
   return -kInProgressErr;
 }
 
-static int httpd_close_sockets()
+httpd_conn_t *httpd_get_conn(int sock)
+{
+  int i;
+
+  if (sock < 0)
+    return NULL;
+
+  for (i = 0; i < HTTPD_MAX_CLIENT_CONN; i++) {
+    if (httpd_conns[i].sockfd == sock)
+      return &httpd_conns[i];
+  }
+  return NULL;
+}
+
+static int httpd_close_client(httpd_conn_t *conn)
 {
   int ret, status = kNoErr;
+
+  if (conn->sockfd == -1)
+    return kNoErr;
+
+  ret = close(conn->sockfd);
+  if (ret != 0) {
+    httpd_d("Failed to close client socket: %d", net_get_sock_error(conn->sockfd));
+    status = -kInProgressErr;
+  }
+  conn->sockfd = -1;
+  conn->rx_start = conn->rx_end = 0;
+  return status;
+}
+
+static int httpd_close_sockets()
+{
+  int i, ret, status = kNoErr;
   
   if (http_sockfd != -1) {
     ret = close(http_sockfd);
@@ -110,13 +156,9 @@ static int httpd_close_sockets()
   http_sockfd = -1;
   }
   
-  if (client_sockfd != -1) {
-    ret = close(client_sockfd);
-    if (ret != 0) {
-      httpd_d("Failed to close client socket: %d", net_get_sock_error(client_sockfd));
+  for (i = 0; i < HTTPD_MAX_CLIENT_CONN; i++) {
+    if (httpd_close_client(&httpd_conns[i]) != kNoErr)
       status = -kInProgressErr;
-    }
-    client_sockfd = -1;
   }
   
   return status;
@@ -134,6 +176,15 @@ static void httpd_suspend_thread(bool warn)
   mico_rtos_suspend_thread(NULL);
 }
 
+static void httpd_check_stop_req(void)
+{
+  if (httpd_stop_req) {
+    httpd_d("HTTPD stop request received");
+    httpd_stop_req = FALSE;
+    httpd_suspend_thread(false);
+  }
+}
+
 static int httpd_setup_new_socket(int port)
 {
   int one = 1;
@@ -184,31 +235,28 @@ static int httpd_setup_main_sockets()
 }
 
 static int httpd_select(int max_sock, const fd_set *readfds,
-                        fd_set *active_readfds, int timeout_secs)
+                        fd_set *active_readfds, int timeout_ms)
 {
   int activefds_cnt;
   struct timeval_t timeout;
   
   fd_set local_readfds;
   
-  if (timeout_secs >= 0)
-    timeout.tv_sec = timeout_secs;
-  timeout.tv_usec = 0;
+  if (timeout_ms >= 0) {
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_usec = (timeout_ms % 1000) * 1000;
+  }
   
   memcpy(&local_readfds, readfds, sizeof(fd_set));
   httpd_d("WAITING for activity");
   
-  activefds_cnt = select(1, &local_readfds, NULL, NULL, timeout_secs >= 0 ? &timeout : NULL);
+  activefds_cnt = select(max_sock + 1, &local_readfds, NULL, NULL, timeout_ms >= 0 ? &timeout : NULL);
   if (activefds_cnt < 0) {
-    httpd_d("Select failed: %d", timeout_secs);
+    httpd_d("Select failed: %d", timeout_ms);
     httpd_suspend_thread(true);
   }
   
-  if (httpd_stop_req) {
-    httpd_d("HTTPD stop request received");
-    httpd_stop_req = FALSE;
-    httpd_suspend_thread(false);
-  }
+  httpd_check_stop_req();
   
   if (activefds_cnt) {
     /* Update users copy of fd_set only if he wants */
@@ -222,9 +270,29 @@ static int httpd_select(int max_sock, const fd_set *readfds,
   return HTTPD_TIMEOUT_EVENT;
 }
 
-static int  httpd_accept_client_socket(const fd_set *active_readfds)
+/* Pick a slot for a new client: a free one, or else the one idle longest */
+static httpd_conn_t *httpd_get_free_conn(void)
+{
+  int i;
+  httpd_conn_t *oldest = &httpd_conns[0];
+  
+  for (i = 0; i < HTTPD_MAX_CLIENT_CONN; i++) {
+    if (httpd_conns[i].sockfd == -1)
+      return &httpd_conns[i];
+    if ((int32_t)(httpd_conns[i].last_active_ms - oldest->last_active_ms) < 0)
+      oldest = &httpd_conns[i];
+  }
+  
+  httpd_d("Connection limit reached, dropping idle client %d", oldest->sockfd);
+  httpd_close_client(oldest);
+  return oldest;
+}
+
+static int httpd_accept_client_socket(const fd_set *active_readfds)
 {
   int main_sockfd = -1;
+  int client_sockfd;
+  httpd_conn_t *conn;
   struct sockaddr_t addr_from;
   int addr_from_len;
   
@@ -281,111 +349,120 @@ static int  httpd_accept_client_socket(const fd_set *active_readfds)
   
   httpd_d("connecting %d to %d.", client_sockfd, addr_from.s_port);
   
+  conn = httpd_get_free_conn();
+  conn->sockfd = client_sockfd;
+  conn->last_active_ms = mico_get_time();
+  conn->rx_start = conn->rx_end = 0;
+  
   return kNoErr;
 }
 
-static void httpd_handle_client_connection(const fd_set *active_readfds)
+/* Serve one request on a readable client connection */
+static void httpd_handle_client_connection(httpd_conn_t *conn)
 {
-  int activefds_cnt, status;
-  fd_set readfds;
+  int status;
   
-  if (httpd_stop_req) {
-    httpd_d("HTTPD stop request received");
-    httpd_stop_req = FALSE;
-    httpd_suspend_thread(false);
-  }
+  httpd_d("Handling %d", conn->sockfd);
+  /* Note:
+  * Connection will be handled with call to
+  * httpd_handle_message twice, first for
+  * handling request (kNoErr) and second
+  * time as there is no more data to receive
+  * (client closed connection) and hence
+  * will return with status HTTPD_DONE
+  * closing socket.
+  */
+  status = httpd_handle_message(conn->sockfd);
   
-  status = httpd_accept_client_socket(active_readfds);
-  if (status != kNoErr)
+  httpd_check_stop_req();
+  
+  if (status == kNoErr) {
+    /* The handlers are expected more data on the
+    socket */
+    conn->last_active_ms = mico_get_time();
     return;
+  }
   
-  httpd_d("Client socket accepted: %d", client_sockfd);
-  FD_ZERO(&readfds);
-  FD_SET(client_sockfd, &readfds);
+  /* Either there was some error or everything went well */
+  httpd_d("Close socket %d.  %s: %d", conn->sockfd, status == HTTPD_DONE ? "Handler done" : "Handler failed", status);
   
-  while (1) {
-    if (httpd_stop_req) {
-      httpd_d("HTTPD stop request received");
-      httpd_stop_req = FALSE;
-      httpd_suspend_thread(false);
-    }
-    
-    httpd_d("Waiting on client socket");
-    activefds_cnt = httpd_select(client_sockfd, &readfds, NULL, HTTPD_CLIENT_SOCK_TIMEOUT);
-    
-    if (httpd_stop_req) {
-      httpd_d("HTTPD stop request received");
-      httpd_stop_req = FALSE;
-      httpd_suspend_thread(false);
-    }
+  if (httpd_close_client(conn) != kNoErr)
+    httpd_suspend_thread(true);
+}
+
+/* Close idle clients, return the time in ms until the next one expires or
+ * -1 if there are no clients */
+static int httpd_expire_idle_clients(void)
+{
+  int i, wait_ms = -1;
+  uint32_t idle_ms, left_ms, now = mico_get_time();
+  
+  for (i = 0; i < HTTPD_MAX_CLIENT_CONN; i++) {
+    if (httpd_conns[i].sockfd == -1)
+      continue;
     
-    if (activefds_cnt == HTTPD_TIMEOUT_EVENT) {
+    idle_ms = now - httpd_conns[i].last_active_ms;
+    if (idle_ms >= HTTPD_CLIENT_SOCK_TIMEOUT * 1000UL) {
       /* Timeout has occured */
-      httpd_d("Client socket timeout occurred. " "Force closing socket");
-
-      status = close(client_sockfd);
-      if (status != kNoErr) {
-        status = net_get_sock_error(client_sockfd);
-        httpd_d("Failed to close socket %d", status);
+      httpd_d("Client socket %d timeout occurred. " "Force closing socket", httpd_conns[i].sockfd);
+      if (httpd_close_client(&httpd_conns[i]) != kNoErr)
         httpd_suspend_thread(true);
-      }
-      
-      client_sockfd = -1;
-      break;
-    }
-    
-    httpd_d("Handling %d", client_sockfd);
-    /* Note:
-    * Connection will be handled with call to
-    * httpd_handle_message twice, first for
-    * handling request (kNoErr) and second
-    * time as there is no more data to receive
-    * (client closed connection) and hence
-    * will return with status HTTPD_DONE
-    * closing socket.
-    */
-    /* FIXME: remove this memset if all is working well */
-    /* memset(&httpd_message_in[0], 0, sizeof(httpd_message_in)); */
-    status = httpd_handle_message(client_sockfd);
-    if (status == kNoErr) {
-      /* The handlers are expected more data on the
-      socket */
       continue;
     }
     
-    /* Either there was some error or everything went well */
-    httpd_d("Close socket %d.  %s: %d", client_sockfd, status == HTTPD_DONE ? "Handler done" : "Handler failed", status);
-    
-    status = close(client_sockfd);
-    if (status != kNoErr) {
-      status = net_get_sock_error(client_sockfd);
-      httpd_d("Failed to close socket %d", status);
-      httpd_suspend_thread(true);
-    }
-    client_sockfd = -1;
-    
-    break;
+    left_ms = HTTPD_CLIENT_SOCK_TIMEOUT * 1000UL - idle_ms;
+    if (wait_ms == -1 || left_ms < (uint32_t)wait_ms)
+      wait_ms = left_ms;
   }
+  
+  return wait_ms;
 }
 
 static void httpd_main(void *arg)
 {
-  int status, max_sockfd = -1;
+  int i, status, max_sockfd, timeout_ms;
+  httpd_conn_t *conn;
   fd_set readfds, active_readfds;
   
   status = httpd_setup_main_sockets();
   if (status != kNoErr)
     httpd_suspend_thread(true);
   
-  FD_ZERO(&readfds);
-  
-  FD_SET(http_sockfd, &readfds);
-  max_sockfd = http_sockfd;
-  
   while (1) {
-    httpd_d("Waiting on main socket");
-    httpd_select(max_sockfd, &readfds, &active_readfds, -1);
-    httpd_handle_client_connection(&active_readfds);
+    timeout_ms = httpd_expire_idle_clients();
+    
+    FD_ZERO(&readfds);
+    FD_SET(http_sockfd, &readfds);
+    max_sockfd = http_sockfd;
+    for (i = 0; i < HTTPD_MAX_CLIENT_CONN; i++) {
+      if (httpd_conns[i].sockfd == -1)
+        continue;
+      FD_SET(httpd_conns[i].sockfd, &readfds);
+      if (httpd_conns[i].sockfd > max_sockfd)
+        max_sockfd = httpd_conns[i].sockfd;
+      /* A pipelined request is already buffered, don't wait for the socket */
+      if (httpd_conn_rx_pending(&httpd_conns[i]))
+        timeout_ms = 0;
+    }
+    
+    httpd_d("Waiting on main socket and %d clients", max_sockfd);
+    if (httpd_select(max_sockfd, &readfds, &active_readfds, timeout_ms) == HTTPD_TIMEOUT_EVENT)
+      FD_ZERO(&active_readfds);
+    
+    /* Serve at most one request per ready client in each round, starting
+     * from a different client every time so that none can starve the
+     * others */
+    for (i = 0; i < HTTPD_MAX_CLIENT_CONN; i++) {
+      conn = &httpd_conns[(httpd_conn_next + i) % HTTPD_MAX_CLIENT_CONN];
+      if (conn->sockfd != -1 &&
+          (FD_ISSET(conn->sockfd, &active_readfds) || httpd_conn_rx_pending(conn)))
+        httpd_handle_client_connection(conn);
+    }
+    httpd_conn_next = (httpd_conn_next + 1) % HTTPD_MAX_CLIENT_CONN;
+    
+    /* Accept after serving, a full table evicts the oldest idle client */
+    if (FD_ISSET(http_sockfd, &active_readfds))
+      httpd_accept_client_socket(&active_readfds);
   }
   
   /*
@@ -553,14 +630,16 @@ int httpd_shutdown(void)
 /* This pairs with httpd_shutdown() */
 int httpd_init()
 {
-  int status;
+  int i, status;
   
   if (httpd_state != HTTPD_INACTIVE)
     return kNoErr;
   
   httpd_d("Initializing");
   
-  client_sockfd = -1;
+  for (i = 0; i < HTTPD_MAX_CLIENT_CONN; i++)
+    httpd_conns[i].sockfd = -1;
+  httpd_conn_next = 0;
   http_sockfd  = -1;
   
   status = httpd_wsgi_init();
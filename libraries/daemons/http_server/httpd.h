@@ -1001,6 +1001,28 @@ int httpd_recv(int sock, void *buf, size_t n, int flags);
 int httpd_send_response(httpd_request_t *req, const char *first_line,
 		char *content, int length, const char *content_type);
 
+struct json_object;
+
+/** Send the entire HTTP response with a JSON body
+ *
+ *  Same as httpd_send_response() with content type application/json, but
+ *  the body is serialized straight from the json_object tree into the
+ *  socket through a HTTPD_JSON_CHUNK_SIZE byte stack buffer instead of
+ *  being built as one string first. With chunked encoding every full
+ *  buffer is sent as one chunk; otherwise the tree is walked twice, once
+ *  to compute Content-Length and once to send it.
+ *
+ *  \param[in] req The incoming HTTP request \ref httpd_request_t
+ *  \param[in] first_line First line of the response. for e.g.: To send 200 OK
+ *  it will be: "HTTP/1.1 200 OK\r\n"
+ *  \param[in] obj The JSON document to be sent
+ *
+ *  \return WM_SUCCESS if successful
+ *  \return -WM_FAIL otherwise
+ */
+int httpd_send_response_json(httpd_request_t *req, const char *first_line,
+		struct json_object *obj);
+
 /** Send HTTP response 301: Moved Permanently
  *
  *  This is a helper function which can be used by the WSGI handlers to send
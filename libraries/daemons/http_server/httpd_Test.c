@@ -0,0 +1,395 @@
+/**
+******************************************************************************
+* @file    httpd_Test.c
+* @version V1.0.0
+* @date    17-Oct-2026
+* @brief   Runs the httpd main loop against simulated clients on a simulated
+*          clock: an idle keep-alive client while another one is served, busy
+*          clients that must be served in turn, more clients than
+*          HTTPD_MAX_CLIENT_CONN, and the idle timeout across a wrap of
+*          mico_get_time(). Built on the host on its own, it includes httpd.c
+*          for its statics and supplies the sockets, the clock and
+*          httpd_handle_message(); not part of the default build.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#include <setjmp.h>
+#include <stdio.h>
+
+#include "httpd.c"
+
+#define HTTPD_TEST_LISTEN_SOCK	1
+#define HTTPD_TEST_CLIENTS_MAX	8
+#define HTTPD_TEST_END_MS	60000
+#define HTTPD_TEST_SELECTS_MAX	10000	/* In one run, for a loop that spins */
+#define HTTPD_TEST_TIMEOUT_MS	(HTTPD_CLIENT_SOCK_TIMEOUT * 1000)
+
+/* A simulated client: it connects, sends count requests gap ms apart (all at
+ * once for 0), then closes its end or stays connected.
+ */
+typedef struct {
+	uint32_t connect_at;
+	uint32_t first_request;
+	int count;
+	uint32_t gap;
+	bool hangup;
+
+	/* Results */
+	int sockfd;
+	bool closed;
+	int served;
+	int skipped;		/* Requests of others served since its last one */
+	uint32_t closed_at;
+	uint32_t worst_wait;
+} httpd_test_client_t;
+
+typedef struct {
+	const char *name;
+	uint32_t start;		/* mico_get_time() at the start */
+	int clients;
+	httpd_test_client_t client[HTTPD_TEST_CLIENTS_MAX];
+} httpd_test_run_t;
+
+static httpd_test_run_t *httpd_test_run;
+static uint32_t httpd_test_now;
+static unsigned long httpd_test_selects;
+static unsigned long httpd_test_run_selects;
+static int httpd_test_skipped;	/* Most requests of others served while a client waited */
+static jmp_buf httpd_test_stop;
+
+static uint32_t httpd_test_ms(uint32_t at)
+{
+	return httpd_test_run->start + at;
+}
+
+static httpd_test_client_t *httpd_test_client(int sock)
+{
+	int i;
+
+	for (i = 0; i < httpd_test_run->clients; i++) {
+		if (httpd_test_run->client[i].sockfd == sock)
+			return &httpd_test_run->client[i];
+	}
+	return NULL;
+}
+
+/* When the next request of a client is due */
+static uint32_t httpd_test_request_at(const httpd_test_client_t *c)
+{
+	return httpd_test_ms(c->first_request + c->served * c->gap);
+}
+
+/* The client has a request or its hangup waiting to be read */
+static bool httpd_test_readable(const httpd_test_client_t *c)
+{
+	if (c->sockfd == -1 || c->closed)
+		return false;
+	if (c->served < c->count)
+		return (int32_t)(httpd_test_now - httpd_test_request_at(c)) >= 0;
+	return c->hangup;
+}
+
+static bool httpd_test_pending_accept(void)
+{
+	int i;
+	httpd_test_client_t *c;
+
+	for (i = 0; i < httpd_test_run->clients; i++) {
+		c = &httpd_test_run->client[i];
+		if (c->sockfd == -1 &&
+		    (int32_t)(httpd_test_now - httpd_test_ms(c->connect_at)) >= 0)
+			return true;
+	}
+	return false;
+}
+
+/* Time of the next thing a client does, far in the future if none */
+static uint32_t httpd_test_next_event(void)
+{
+	uint32_t next = httpd_test_ms(HTTPD_TEST_END_MS), at;
+	httpd_test_client_t *c;
+	int i;
+
+	for (i = 0; i < httpd_test_run->clients; i++) {
+		c = &httpd_test_run->client[i];
+		if (c->sockfd == -1)
+			at = httpd_test_ms(c->connect_at);
+		else if (!c->closed && c->served < c->count)
+			at = httpd_test_request_at(c);
+		else
+			continue;
+		if ((int32_t)(at - next) < 0)
+			next = at;
+	}
+	return next;
+}
+
+uint32_t mico_get_time(void)
+{
+	return httpd_test_now;
+}
+
+int socket(int domain, int type, int protocol) { return HTTPD_TEST_LISTEN_SOCK; }
+int setsockopt(int sockfd, int level, int optname, const void *optval, socklen_t optlen) { return 0; }
+int bind(int sockfd, const struct sockaddr_t *addr, socklen_t addrlen) { return 0; }
+int listen(int sockfd, int backlog) { return 0; }
+int connect(int sockfd, const struct sockaddr_t *addr, socklen_t addrlen) { return -1; }
+uint32_t inet_addr(char *s) { return 0; }
+OSStatus mico_rtos_create_thread(mico_thread_t *thread, uint8_t priority, const char *name, mico_thread_function_t function, uint32_t stack_size, void *arg) { return kNoErr; }
+OSStatus mico_rtos_delete_thread(mico_thread_t *thread) { return kNoErr; }
+void mico_thread_msleep(uint32_t milliseconds) { httpd_test_now += milliseconds; }
+int httpd_wsgi_init(void) { return kNoErr; }
+int httpd_ssi_init(void) { return kNoErr; }
+
+/* The loop ends by suspending its thread */
+void mico_rtos_suspend_thread(mico_thread_t *thread)
+{
+	longjmp(httpd_test_stop, 1);
+}
+
+int accept(int sockfd, struct sockaddr_t *addr, socklen_t *addrlen)
+{
+	static int next_sock;
+	httpd_test_client_t *c;
+	int i;
+
+	for (i = 0; i < httpd_test_run->clients; i++) {
+		c = &httpd_test_run->client[i];
+		if (c->sockfd == -1 &&
+		    (int32_t)(httpd_test_now - httpd_test_ms(c->connect_at)) >= 0) {
+			/* Socket numbers are reused as on the target */
+			next_sock = next_sock % (FD_SETSIZE - 2) + 1;
+			c->sockfd = HTTPD_TEST_LISTEN_SOCK + next_sock;
+			return c->sockfd;
+		}
+	}
+	return -1;
+}
+
+int close(int fd)
+{
+	httpd_test_client_t *c = httpd_test_client(fd);
+
+	if (c != NULL && !c->closed) {
+		c->closed = true;
+		c->closed_at = httpd_test_now - httpd_test_run->start;
+	}
+	return 0;
+}
+
+/* Wait for the clients, or until the timeout the loop asked for; the run
+ * stops once nothing is left to happen.
+ */
+int select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval_t *timeout)
+{
+	uint32_t next, wake;
+	httpd_test_client_t *c;
+	fd_set ready;
+	int i, count = 0;
+
+	httpd_test_selects++;
+	if (++httpd_test_run_selects > HTTPD_TEST_SELECTS_MAX) {
+		httpd_stop_req = TRUE;
+		return 0;
+	}
+	next = httpd_test_next_event();
+	if (!httpd_test_pending_accept()) {
+		for (i = 0; i < httpd_test_run->clients; i++) {
+			if (httpd_test_readable(&httpd_test_run->client[i]))
+				break;
+		}
+		if (i == httpd_test_run->clients) {
+			wake = next;
+			if (timeout != NULL &&
+			    timeout->tv_sec * 1000 + timeout->tv_usec / 1000 < next - httpd_test_now)
+				wake = httpd_test_now + timeout->tv_sec * 1000 + timeout->tv_usec / 1000;
+			httpd_test_now = wake;
+		}
+	}
+
+	if ((int32_t)(httpd_test_now - httpd_test_ms(HTTPD_TEST_END_MS)) >= 0) {
+		httpd_stop_req = TRUE;
+		return 0;
+	}
+
+	FD_ZERO(&ready);
+	if (FD_ISSET(HTTPD_TEST_LISTEN_SOCK, readfds) && httpd_test_pending_accept()) {
+		FD_SET(HTTPD_TEST_LISTEN_SOCK, &ready);
+		count++;
+	}
+	for (i = 0; i < httpd_test_run->clients; i++) {
+		c = &httpd_test_run->client[i];
+		if (httpd_test_readable(c) && FD_ISSET(c->sockfd, readfds)) {
+			FD_SET(c->sockfd, &ready);
+			count++;
+		}
+	}
+	memcpy(readfds, &ready, sizeof(fd_set));
+	return count;
+}
+
+/* One request of a client, or its hangup */
+int httpd_handle_message(int conn)
+{
+	httpd_test_client_t *c = httpd_test_client(conn), *other;
+	uint32_t wait;
+	int i;
+
+	if (c == NULL || !httpd_test_readable(c))
+		return -kInProgressErr;
+	if (c->served == c->count)
+		return HTTPD_DONE;
+
+	wait = httpd_test_now - httpd_test_request_at(c);
+	if (wait > c->worst_wait)
+		c->worst_wait = wait;
+	c->served++;
+
+	/* Counted for each client waiting, the fairness check is on the most */
+	c->skipped = 0;
+	for (i = 0; i < httpd_test_run->clients; i++) {
+		other = &httpd_test_run->client[i];
+		if (other != c && httpd_test_readable(other) &&
+		    ++other->skipped > httpd_test_skipped)
+			httpd_test_skipped = other->skipped;
+	}
+	return kNoErr;
+}
+
+static OSStatus httpd_test_go(httpd_test_run_t *run)
+{
+	int i;
+
+	httpd_test_run = run;
+	httpd_test_now = run->start;
+	httpd_test_skipped = 0;
+	httpd_test_run_selects = 0;
+	for (i = 0; i < run->clients; i++) {
+		run->client[i].sockfd = -1;
+		run->client[i].closed = false;
+		run->client[i].served = 0;
+		run->client[i].skipped = 0;
+		run->client[i].worst_wait = 0;
+	}
+
+	httpd_state = HTTPD_INACTIVE;
+	httpd_stop_req = FALSE;
+	if (httpd_init() != kNoErr)
+		return kGeneralErr;
+	if (setjmp(httpd_test_stop) == 0)
+		httpd_main(NULL);
+	return httpd_test_run_selects > HTTPD_TEST_SELECTS_MAX ? kGeneralErr : kNoErr;
+}
+
+static int httpd_test_check(bool ok, const char *name, const char *what, int print)
+{
+	if (!ok && print)
+		printf("%s: %s\r\n", name, what);
+	return ok ? 0 : 1;
+}
+
+OSStatus httpd_Test(int print)
+{
+	/* connect  first request  count  gap  hangup */
+	static httpd_test_run_t idle = {
+		"idle keep-alive client", 0, 2, {
+			{ 0, 0, 1, 0, false },
+			{ 100, 100, 3, 500, true },
+		}
+	};
+	static httpd_test_run_t busy = {
+		"busy clients", 0, 3, {
+			{ 0, 0, 50, 0, true },
+			{ 0, 0, 50, 0, true },
+			{ 0, 0, 50, 0, true },
+		}
+	};
+	static httpd_test_run_t full = {
+		"more clients than slots", 0, HTTPD_MAX_CLIENT_CONN + 1, {
+			{ 0, 0, 1, 0, false },
+			{ 100, 100, 1, 0, false },
+			{ 200, 200, 1, 0, false },
+			{ 300, 300, 1, 0, false },
+			{ 400, 400, 1, 0, false },
+		}
+	};
+	static httpd_test_run_t wrap = {
+		"mico_get_time() wraps", 0xFFFFF000, 2, {
+			{ 0, 0, 2, 3000, false },
+			{ 1000, 1000, 1, 0, false },
+		}
+	};
+	httpd_test_client_t *c;
+	int i, skipped, bad = 0;
+
+	if (HTTPD_MAX_CLIENT_CONN + 1 > HTTPD_TEST_CLIENTS_MAX)
+		return kGeneralErr;
+
+	/* The idle client neither delays the other one nor outlives its timeout */
+	bad += httpd_test_go(&idle) != kNoErr;
+	bad += httpd_test_check(idle.client[1].served == 3 && idle.client[1].worst_wait == 0,
+				idle.name, "second client kept waiting", print);
+	bad += httpd_test_check(idle.client[1].closed && idle.client[1].closed_at == 1100,
+				idle.name, "second client not closed on its hangup", print);
+	bad += httpd_test_check(idle.client[0].closed && idle.client[0].closed_at == HTTPD_TEST_TIMEOUT_MS,
+				idle.name, "idle client not closed at its timeout", print);
+
+	/* At most one request of each client in a round, and the round starts
+	 * one slot further each time: a waiting client sees every other one
+	 * served twice at most, at the end of a round and at the start of the
+	 * next */
+	bad += httpd_test_go(&busy) != kNoErr;
+	for (i = 0; i < busy.clients; i++)
+		bad += httpd_test_check(busy.client[i].served == 50 && busy.client[i].closed,
+					busy.name, "requests left unserved", print);
+	skipped = httpd_test_skipped;
+	bad += httpd_test_check(skipped <= 2 * (busy.clients - 1), busy.name,
+				"a client served ahead of one that waited", print);
+
+	/* A full table drops the client idle longest, the others run to their timeout */
+	bad += httpd_test_go(&full) != kNoErr;
+	bad += httpd_test_check(full.client[0].closed && full.client[0].closed_at == 400,
+				full.name, "client idle longest not dropped", print);
+	for (i = 1; i < full.clients; i++) {
+		c = &full.client[i];
+		bad += httpd_test_check(c->served == 1 && c->worst_wait == 0 && c->closed &&
+					c->closed_at == c->connect_at + HTTPD_TEST_TIMEOUT_MS,
+					full.name, "client not served, or not closed at its timeout", print);
+	}
+
+	/* The timeout counts from the last request, across the wrap */
+	bad += httpd_test_go(&wrap) != kNoErr;
+	bad += httpd_test_check(wrap.client[0].served == 2 && wrap.client[0].worst_wait == 0 &&
+				wrap.client[0].closed_at == 3000 + HTTPD_TEST_TIMEOUT_MS,
+				wrap.name, "first client timed out wrongly", print);
+	bad += httpd_test_check(wrap.client[1].served == 1 &&
+				wrap.client[1].closed_at == 1000 + HTTPD_TEST_TIMEOUT_MS,
+				wrap.name, "second client timed out wrongly", print);
+
+	if (print)
+		printf("httpd_Test: %lu select() calls, most requests served while a "
+		       "busy client waited %d, %s\r\n", httpd_test_selects,
+		       skipped, bad == 0 ? "PASSED" : "FAILED");
+	return bad == 0 ? kNoErr : kGeneralErr;
+}
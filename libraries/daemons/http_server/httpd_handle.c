@@ -153,7 +153,7 @@ int httpd_send(int conn, const char *buf, int len)
 	return kNoErr;
 }
 
-int httpd_recv(int fd, void *buf, size_t n, int flags)
+static int httpd_sock_recv(int fd, void *buf, size_t n, int flags)
 {
 #ifdef CONFIG_ENABLE_HTTPS
 	if (httpd_is_https_active())
@@ -163,6 +163,38 @@ int httpd_recv(int fd, void *buf, size_t n, int flags)
 		return recv(fd, buf, n, flags);
 }
 
+int httpd_conn_rx_fill(httpd_conn_t *conn)
+{
+	int ret;
+
+	conn->rx_start = conn->rx_end = 0;
+	ret = httpd_sock_recv(conn->sockfd, conn->rx_buf,
+			      sizeof(conn->rx_buf), 0);
+	if (ret > 0)
+		conn->rx_end = ret;
+	return ret;
+}
+
+/* Bytes already read into the connection receive buffer by the header
+ * parser are returned first, only then is the socket read again.
+ */
+int httpd_recv(int fd, void *buf, size_t n, int flags)
+{
+	httpd_conn_t *conn = httpd_get_conn(fd);
+	size_t pending;
+
+	if (conn && httpd_conn_rx_pending(conn)) {
+		pending = httpd_conn_rx_pending(conn);
+		if (n > pending)
+			n = pending;
+		memcpy(buf, &conn->rx_buf[conn->rx_start], n);
+		conn->rx_start += n;
+		return n;
+	}
+
+	return httpd_sock_recv(fd, buf, n, flags);
+}
+
 int httpd_send_hdr_from_code(int sock, int stat_code,
 			     enum http_content_type content_type)
 {
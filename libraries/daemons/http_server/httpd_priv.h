@@ -69,6 +69,9 @@ int handle_message(char *msg_in, int msg_in_len, int conn);
 int httpd_parse_hdr_main(const char *data_p, httpd_request_t *req_p);
 int httpd_handle_message(int conn);
 
+/* Main loop against simulated clients and a simulated clock, see httpd_Test.c */
+OSStatus httpd_Test(int print);
+
 /* Various Defines */
 #ifndef NULL
 #define NULL 0
@@ -76,10 +79,57 @@ int httpd_handle_message(int conn);
 
 int httpd_wsgi(httpd_request_t *req_p);
 
+/* Route index against a linear scan of the handlers, see httpd_wsgi_Test.c */
+OSStatus httpd_wsgi_Test(int print);
+
+/** Size of the per-connection receive buffer
+ *
+ * Request and header lines are scanned from this buffer instead of being
+ * received one byte at a time.  Bytes left over after the headers stay in
+ * the buffer and are returned first by httpd_recv().  Lines longer than the
+ * buffer are still handled, they just take more than one recv().
+ */
+#ifndef HTTPD_RECV_BUF_SIZE
+#define HTTPD_RECV_BUF_SIZE 256
+#endif
+
+/* Size of the stack buffer httpd_send_response_json() serializes into.
+ * Each time it fills up it goes out as one HTTP chunk (or one send() when
+ * the WSGI is not chunked), so this bounds the RAM a JSON response needs.
+ */
+#ifndef HTTPD_JSON_CHUNK_SIZE
+#define HTTPD_JSON_CHUNK_SIZE 256
+#endif
+
+/* One accepted client connection */
+typedef struct {
+	/* Client socket, -1 if the slot is free */
+	int sockfd;
+	/* mico_get_time() of the last activity, used for the idle timeout */
+	uint32_t last_active_ms;
+	/* Received but unconsumed bytes are rx_buf[rx_start..rx_end) */
+	uint16_t rx_start;
+	uint16_t rx_end;
+	char rx_buf[HTTPD_RECV_BUF_SIZE];
+} httpd_conn_t;
+
+/* Find the connection of a client socket, NULL if it is not one */
+httpd_conn_t *httpd_get_conn(int sock);
+
+/* Number of received bytes waiting in the connection receive buffer */
+#define httpd_conn_rx_pending(_conn_) ((_conn_)->rx_end - (_conn_)->rx_start)
+
+/* Refill an empty connection receive buffer from the socket, returns the
+ * recv() result */
+int httpd_conn_rx_fill(httpd_conn_t *conn);
+
 httpd_ssifunction httpd_ssi(char *);
 int httpd_ssi_init(void);
 int htsys_getln_soc(int sd, char *data_p, int buflen);
 
+/* Replay of captured requests through the line reader, see httpd_sys_Test.c */
+OSStatus httpd_sys_Test(int print);
+
 void httpd_parse_useragent(char *hdrline, httpd_useragent_t *agent);
 
 int httpd_send_last_chunk(int conn);
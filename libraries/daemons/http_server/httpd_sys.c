@@ -35,7 +35,62 @@
 
 #include "httpd_priv.h"
 
-int htsys_getln_soc(int sd, char *data_p, int buflen)
+/* Copy one line from the connection receive buffer into data_p, refilling
+ * the buffer as needed.  The line ends at CR LF, a bare LF or a bare CR; the
+ * terminator is consumed but not copied.  Whatever follows the line stays in
+ * the buffer for the next call or for httpd_recv().
+ */
+static int htsys_getln_buf(httpd_conn_t *conn, char *data_p, int buflen)
+{
+	int len = 0;
+	int result;
+	char c;
+	bool cr_found = false;
+
+	while (1) {
+		if (!httpd_conn_rx_pending(conn)) {
+			result = httpd_conn_rx_fill(conn);
+			if (result == 0)
+				break;
+			/* error on recv */
+			if (result < 0) {
+				data_p[len] = 0;
+				httpd_d("recv failed len: %d", len);
+				return -kInProgressErr;
+			}
+		}
+
+		c = conn->rx_buf[conn->rx_start];
+		if (cr_found) {
+			/* Swallow the LF of a CR LF pair */
+			if (c == ISO_nl)
+				conn->rx_start++;
+			break;
+		}
+		conn->rx_start++;
+
+		/* If new line... */
+		if (c == ISO_nl)
+			break;
+		if (c == ISO_cr) {
+			cr_found = true;
+			continue;
+		}
+
+		data_p[len++] = c;
+
+		/* give up here, the rest of the line stays in the buffer */
+		if (len >= buflen - 1) {
+			httpd_d("buf full: recv didn't read complete line.");
+			break;
+		}
+	}
+
+	data_p[len] = 0;
+	return len;
+}
+
+static int htsys_getln_soc_unbuffered(int sd, char *data_p, int buflen)
 {
 	int len = 0;
 	char *c_p;
@@ -76,3 +131,13 @@ int htsys_getln_soc(int sd, char *data_p, int buflen)
 	*c_p = 0;
 	return len;
 }
+
+int htsys_getln_soc(int sd, char *data_p, int buflen)
+{
+	httpd_conn_t *conn = httpd_get_conn(sd);
+
+	if (conn)
+		return htsys_getln_buf(conn, data_p, buflen);
+
+	return htsys_getln_soc_unbuffered(sd, data_p, buflen);
+}
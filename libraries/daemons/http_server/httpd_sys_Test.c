@@ -0,0 +1,257 @@
+/**
+******************************************************************************
+* @file    httpd_sys_Test.c
+* @version V1.0.0
+* @date    17-Oct-2026
+* @brief   Replays captured HTTP requests through htsys_getln_soc() with the
+*          stream cut at arbitrary recv() boundaries, and counts the recv()
+*          calls of the buffered and of the byte-at-a-time line reader. Built
+*          on the host together with httpd_sys.c, httpd_handle.c,
+*          http_parse.c and http-strings.c; this file supplies the socket
+*          calls and the few server calls they make outside. Not part of the
+*          default build.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "httpd.h"
+#include "httpd_priv.h"
+
+#define HTTPD_TEST_SOCK_BUFFERED	1
+#define HTTPD_TEST_SOCK_UNBUFFERED	2
+#define HTTPD_TEST_LINE_SIZE		512
+#define HTTPD_TEST_RUNS			2000
+
+/* A captured request: the header lines it must split into, and the bytes
+ * that must be left over for the body (or the next pipelined request).
+ */
+typedef struct {
+	const char *name;
+	const char *data;
+	const char *lines;	/* Expected lines, each followed by '\n' */
+	const char *rest;
+	/* The byte-at-a-time reader swallows the byte after a bare LF */
+	bool unbuffered_ok;
+} httpd_test_request_t;
+
+static const httpd_test_request_t httpd_test_requests[] = {
+	{
+		"browser GET",
+		"GET /index.html?ssid=MXCHIP HTTP/1.1\r\n"
+		"Host: 192.168.0.1\r\n"
+		"User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) "
+		"AppleWebKit/537.36 (KHTML, like Gecko) Chrome/91.0 Safari/537.36\r\n"
+		"Accept: text/html,application/xhtml+xml,application/xml;q=0.9,"
+		"image/webp,*/*;q=0.8\r\n"
+		"Cookie: session=0123456789abcdef0123456789abcdef0123456789abcdef"
+		"0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef"
+		"0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef"
+		"0123456789abcdef0123456789abcdef0123456789abcdef\r\n"
+		"Connection: keep-alive\r\n"
+		"\r\n",
+		"GET /index.html?ssid=MXCHIP HTTP/1.1\n"
+		"Host: 192.168.0.1\n"
+		"User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) "
+		"AppleWebKit/537.36 (KHTML, like Gecko) Chrome/91.0 Safari/537.36\n"
+		"Accept: text/html,application/xhtml+xml,application/xml;q=0.9,"
+		"image/webp,*/*;q=0.8\n"
+		"Cookie: session=0123456789abcdef0123456789abcdef0123456789abcdef"
+		"0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef"
+		"0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef"
+		"0123456789abcdef0123456789abcdef0123456789abcdef\n"
+		"Connection: keep-alive\n"
+		"\n",
+		"",
+		true
+	},
+	{
+		"POST with body",
+		"POST /config-write HTTP/1.1\r\n"
+		"Host: 192.168.0.1\r\n"
+		"Content-Type: application/json\r\n"
+		"Content-Length: 41\r\n"
+		"\r\n"
+		"{\"SSID\":\"MXCHIP_Office\",\"PASSWORD\":\"abc\"}",
+		"POST /config-write HTTP/1.1\n"
+		"Host: 192.168.0.1\n"
+		"Content-Type: application/json\n"
+		"Content-Length: 41\n"
+		"\n",
+		"{\"SSID\":\"MXCHIP_Office\",\"PASSWORD\":\"abc\"}",
+		true
+	},
+	{
+		"pipelined GETs",
+		"GET /a HTTP/1.1\r\nHost: 192.168.0.1\r\n\r\n"
+		"GET /b HTTP/1.1\r\nHost: 192.168.0.1\r\n\r\n",
+		"GET /a HTTP/1.1\n"
+		"Host: 192.168.0.1\n"
+		"\n",
+		"GET /b HTTP/1.1\r\nHost: 192.168.0.1\r\n\r\n",
+		true
+	},
+	{
+		"bare LF",
+		"GET /b HTTP/1.0\nHost: 192.168.0.1\nAccept: */*\n\nbody",
+		"GET /b HTTP/1.0\n"
+		"Host: 192.168.0.1\n"
+		"Accept: */*\n"
+		"\n",
+		"body",
+		false
+	},
+};
+
+/* The simulated socket: the request being replayed, cut into segments of
+ * 1 to httpd_test_segment bytes.
+ */
+static const char *httpd_test_data;
+static size_t httpd_test_len;
+static size_t httpd_test_pos;
+static int httpd_test_segment;
+static unsigned long httpd_test_recv_calls;
+static uint32_t httpd_test_seed = 1;
+static httpd_conn_t httpd_test_conn;
+
+static int httpd_test_sock_recv(void *buf, size_t n)
+{
+	size_t segment;
+
+	httpd_test_recv_calls++;
+	httpd_test_seed = httpd_test_seed * 1103515245 + 12345;
+	segment = (httpd_test_seed >> 16) % httpd_test_segment + 1;
+	if (n > segment)
+		n = segment;
+	if (n > httpd_test_len - httpd_test_pos)
+		n = httpd_test_len - httpd_test_pos;
+	memcpy(buf, httpd_test_data + httpd_test_pos, n);
+	httpd_test_pos += n;
+	return n;
+}
+
+httpd_conn_t *httpd_get_conn(int sock)
+{
+	return sock == HTTPD_TEST_SOCK_BUFFERED ? &httpd_test_conn : NULL;
+}
+
+ssize_t recv(int sockfd, void *buf, size_t len, int flags)
+{
+	return httpd_test_sock_recv(buf, len);
+}
+
+/* The rest of the server, which httpd_handle.c and http_parse.c call into */
+ssize_t send(int sockfd, const void *buf, size_t len, int flags) { return len; }
+int httpd_wsgi(httpd_request_t *req_p) { return -WM_E_HTTPD_NO_HANDLER; }
+int httpd_purge_headers(int sock) { return kNoErr; }
+
+/* Read the header lines of one request and then everything left, as
+ * httpd_handle_message() and httpd_get_data() would.
+ */
+static OSStatus httpd_test_replay(const httpd_test_request_t *request,
+				  int sock, int segment)
+{
+	char line[HTTPD_TEST_LINE_SIZE];
+	static char lines[2048], rest[512];
+	size_t lines_len = 0, rest_len = 0;
+	int len;
+
+	httpd_test_data = request->data;
+	httpd_test_len = strlen(request->data);
+	httpd_test_pos = 0;
+	httpd_test_segment = segment;
+	memset(&httpd_test_conn, 0, sizeof(httpd_test_conn));
+	httpd_test_conn.sockfd = HTTPD_TEST_SOCK_BUFFERED;
+
+	do {
+		len = htsys_getln_soc(sock, line, sizeof(line));
+		if (len < 0 || lines_len + len + 1 >= sizeof(lines))
+			return kMismatchErr;
+		memcpy(lines + lines_len, line, len);
+		lines_len += len;
+		lines[lines_len++] = '\n';
+	} while (len > 0);
+	lines[lines_len] = 0;
+
+	while ((len = httpd_recv(sock, rest + rest_len,
+				 sizeof(rest) - 1 - rest_len, 0)) > 0)
+		rest_len += len;
+	rest[rest_len] = 0;
+
+	if (strcmp(lines, request->lines) || strcmp(rest, request->rest))
+		return kMismatchErr;
+	return kNoErr;
+}
+
+OSStatus httpd_sys_Test(int print)
+{
+	const httpd_test_request_t *request;
+	unsigned long buffered, unbuffered;
+	unsigned i;
+	int run;
+	OSStatus err = kNoErr;
+
+	for (i = 0; i < sizeof(httpd_test_requests) /
+		     sizeof(httpd_test_requests[0]); i++) {
+		request = &httpd_test_requests[i];
+		for (run = 0; run < HTTPD_TEST_RUNS; run++) {
+			/* Segments of at most 1 to HTTPD_RECV_BUF_SIZE + 19
+			 * bytes */
+			err = httpd_test_replay(request,
+						HTTPD_TEST_SOCK_BUFFERED,
+						run % (HTTPD_RECV_BUF_SIZE + 19) + 1);
+			if (err == kNoErr && request->unbuffered_ok)
+				err = httpd_test_replay(request,
+						HTTPD_TEST_SOCK_UNBUFFERED,
+						run % 20 + 1);
+			if (err != kNoErr) {
+				if (print)
+					printf("%s: mismatch, segments of up to %d bytes\r\n",
+					       request->name, httpd_test_segment);
+				goto exit;
+			}
+		}
+
+		if (!print || !request->unbuffered_ok)
+			continue;
+
+		/* Whole request in one segment, as it usually arrives */
+		httpd_test_recv_calls = 0;
+		httpd_test_replay(request, HTTPD_TEST_SOCK_BUFFERED, 1460);
+		buffered = httpd_test_recv_calls;
+		httpd_test_recv_calls = 0;
+		httpd_test_replay(request, HTTPD_TEST_SOCK_UNBUFFERED, 1460);
+		unbuffered = httpd_test_recv_calls;
+		printf("%s, %u bytes: %lu recv() calls, byte at a time %lu\r\n",
+		       request->name, (unsigned)strlen(request->data),
+		       buffered, unbuffered);
+	}
+
+exit:
+	if (print)
+		printf("httpd_sys_Test: %s\r\n", err == kNoErr ? "PASSED" : "FAILED");
+	return err;
+}
@@ -40,47 +40,287 @@
 
 #include "httpd_priv.h"
 
-#define MAX_WSGI_HANDLERS 32
-
-static struct httpd_wsgi_call *calls[MAX_WSGI_HANDLERS];
+#include "json_c/json_writer.h"
+
+/* Route index
+ *
+ * Handlers that need an exact match live in a hash table keyed by the URI
+ * with its trailing slashes stripped, so that "/a", "/a/" and "/a//" can be
+ * found with one lookup.  Before a query string the slashes must be exactly
+ * those of the registered URI.  Entries with the same key are chained in
+ * registration order, the first one that fits wins.
+ *
+ * APP_HTTP_FLAGS_NO_EXACT_MATCH handlers live in a radix tree keyed by the
+ * whole URI, the longest registered prefix of the request wins.
+ *
+ * Both are built at registration time and a request is matched with a
+ * single pass over its path.
+ */
+struct wsgi_uri_entry {
+	struct httpd_wsgi_call *call;
+	struct wsgi_uri_entry *next;
+	uint32_t hash;
+	/* Length of the URI without its trailing slashes */
+	uint16_t key_len;
+	uint16_t uri_len;
+};
+
+struct wsgi_prefix_node {
+	struct httpd_wsgi_call *call;
+	struct wsgi_prefix_node *child;
+	struct wsgi_prefix_node *sibling;
+	uint16_t label_len;
+	char label[1];
+};
+
+#define WSGI_HASH_MIN_BUCKETS 8
+
+static struct wsgi_uri_entry **uri_buckets;
+static unsigned uri_bucket_cnt;
+static unsigned uri_entry_cnt;
+
+static struct wsgi_prefix_node prefix_root;
 
 /** This is the maximum size of a POST response */
 #define MAX_HTTP_POST_RESPONSE 256
 char http_response[MAX_HTTP_POST_RESPONSE];
 
-/* Register a WSGI call in the list of handlers */
-int httpd_register_wsgi_handler(struct httpd_wsgi_call *wsgi_call)
+#define WSGI_FNV_OFFSET 2166136261UL
+#define WSGI_FNV_PRIME  16777619UL
+
+/* FNV-1a of the uri up to its trailing slashes, returns the key length */
+static int wsgi_uri_key(const char *uri, int uri_len, uint32_t *hash)
 {
-	int i, store_index = -1;
+	uint32_t h = WSGI_FNV_OFFSET;
+	int i, key_len = uri_len;
 
-	if (!wsgi_call->uri)
-		return kNoErr;
+	while (key_len && uri[key_len - 1] == '/')
+		key_len--;
+
+	for (i = 0; i < key_len; i++)
+		h = (h ^ (unsigned char)uri[i]) * WSGI_FNV_PRIME;
 
-	for (i = 0; i < MAX_WSGI_HANDLERS; i++) {
-		/*Find the first empty location in the calls array */
-		if (!calls[i] && store_index == -1) {
-			httpd_d("Found empty location %d", i);
-			store_index = i;
-			continue;
+	*hash = h;
+	return key_len;
+}
+
+static int wsgi_uri_table_grow(void)
+{
+	struct wsgi_uri_entry **buckets, *e, *next, **tail;
+	unsigned i, cnt = uri_bucket_cnt ? uri_bucket_cnt * 2 :
+		WSGI_HASH_MIN_BUCKETS;
+
+	buckets = calloc(cnt, sizeof(*buckets));
+	if (!buckets)
+		return kNoMemoryErr;
+
+	/* Re-link every chain, keeping registration order */
+	for (i = 0; i < uri_bucket_cnt; i++) {
+		for (e = uri_buckets[i]; e; e = next) {
+			next = e->next;
+			e->next = NULL;
+			tail = &buckets[e->hash & (cnt - 1)];
+			while (*tail)
+				tail = &(*tail)->next;
+			*tail = e;
 		}
-		if (strcmp(calls[i]->uri, wsgi_call->uri) == 0) {
-			httpd_d("Found wsgi %s at slot %d",
-			      wsgi_call->uri, i);
+	}
+
+	free(uri_buckets);
+	uri_buckets = buckets;
+	uri_bucket_cnt = cnt;
+	return kNoErr;
+}
+
+static struct wsgi_uri_entry *wsgi_uri_find(const char *uri)
+{
+	struct wsgi_uri_entry *e;
+	uint32_t hash;
+	int uri_len = strlen(uri);
+
+	if (!uri_bucket_cnt)
+		return NULL;
+
+	wsgi_uri_key(uri, uri_len, &hash);
+	for (e = uri_buckets[hash & (uri_bucket_cnt - 1)]; e; e = e->next) {
+		if (e->hash == hash && e->uri_len == uri_len &&
+		    !memcmp(e->call->uri, uri, uri_len))
+			return e;
+	}
+	return NULL;
+}
+
+static int wsgi_uri_insert(struct httpd_wsgi_call *wsgi_call)
+{
+	struct wsgi_uri_entry *e, **tail;
+	int uri_len = strlen(wsgi_call->uri);
+
+	if (uri_entry_cnt >= uri_bucket_cnt && wsgi_uri_table_grow() != kNoErr)
+		return kNoMemoryErr;
+
+	e = malloc(sizeof(*e));
+	if (!e)
+		return kNoMemoryErr;
+
+	e->call = wsgi_call;
+	e->next = NULL;
+	e->uri_len = uri_len;
+	e->key_len = wsgi_uri_key(wsgi_call->uri, uri_len, &e->hash);
+
+	tail = &uri_buckets[e->hash & (uri_bucket_cnt - 1)];
+	while (*tail)
+		tail = &(*tail)->next;
+	*tail = e;
+	uri_entry_cnt++;
+	return kNoErr;
+}
+
+static int wsgi_uri_remove(struct httpd_wsgi_call *wsgi_call)
+{
+	struct wsgi_uri_entry *e, **link;
+	uint32_t hash;
+
+	if (!uri_bucket_cnt)
+		return kNotFoundErr;
+
+	wsgi_uri_key(wsgi_call->uri, strlen(wsgi_call->uri), &hash);
+	for (link = &uri_buckets[hash & (uri_bucket_cnt - 1)]; (e = *link);
+	     link = &e->next) {
+		if (e->call == wsgi_call) {
+			*link = e->next;
+			free(e);
+			uri_entry_cnt--;
 			return kNoErr;
 		}
 	}
-	if (store_index == -1) {
-		httpd_d("Array full.. Cannot register wsgi %s", wsgi_call->uri);
-		return -kInProgressErr;
+	return kNotFoundErr;
+}
+
+static struct wsgi_prefix_node *wsgi_prefix_new_node(const char *label,
+						     int label_len)
+{
+	struct wsgi_prefix_node *node;
+
+	node = malloc(sizeof(*node) + label_len);
+	if (!node)
+		return NULL;
+
+	memset(node, 0, sizeof(*node));
+	memcpy(node->label, label, label_len);
+	node->label[label_len] = '\0';
+	node->label_len = label_len;
+	return node;
+}
+
+static struct wsgi_prefix_node *wsgi_prefix_find_child(
+	struct wsgi_prefix_node *node, char c)
+{
+	for (node = node->child; node; node = node->sibling) {
+		if (node->label[0] == c)
+			return node;
+	}
+	return NULL;
+}
+
+/* Node whose path from the root spells exactly uri, NULL if there is none */
+static struct wsgi_prefix_node *wsgi_prefix_find(const char *uri)
+{
+	struct wsgi_prefix_node *node = &prefix_root;
+
+	while (*uri) {
+		node = wsgi_prefix_find_child(node, *uri);
+		if (!node || strncmp(node->label, uri, node->label_len))
+			return NULL;
+		uri += node->label_len;
 	}
+	return node;
+}
+
+static int wsgi_prefix_insert(struct httpd_wsgi_call *wsgi_call)
+{
+	struct wsgi_prefix_node *node = &prefix_root, *child, *rest;
+	const char *uri = wsgi_call->uri;
+	int n;
+
+	while (*uri) {
+		child = wsgi_prefix_find_child(node, *uri);
+		if (!child) {
+			child = wsgi_prefix_new_node(uri, strlen(uri));
+			if (!child)
+				return kNoMemoryErr;
+			child->call = wsgi_call;
+			child->sibling = node->child;
+			node->child = child;
+			return kNoErr;
+		}
 
-	httpd_d("Register wsgi %s at %d", wsgi_call->uri,
-	      store_index);
+		for (n = 1; n < child->label_len && child->label[n] == uri[n];
+		     n++)
+			;
+
+		if (n < child->label_len) {
+			/* Split: child keeps the common part, the rest of its
+			 * label moves to a new node below it */
+			rest = wsgi_prefix_new_node(&child->label[n],
+						    child->label_len - n);
+			if (!rest)
+				return kNoMemoryErr;
+			rest->call = child->call;
+			rest->child = child->child;
+			child->call = NULL;
+			child->child = rest;
+			child->label_len = n;
+			child->label[n] = '\0';
+		}
 
-	calls[store_index] = wsgi_call;
+		node = child;
+		uri += n;
+	}
+
+	node->call = wsgi_call;
 	return kNoErr;
 }
 
+static void wsgi_prefix_free(struct wsgi_prefix_node *node)
+{
+	struct wsgi_prefix_node *next;
+
+	while (node) {
+		next = node->sibling;
+		wsgi_prefix_free(node->child);
+		free(node);
+		node = next;
+	}
+}
+
+/* Register a WSGI call in the route index */
+int httpd_register_wsgi_handler(struct httpd_wsgi_call *wsgi_call)
+{
+	struct wsgi_prefix_node *node;
+	int ret;
+
+	if (!wsgi_call->uri)
+		return kNoErr;
+
+	node = wsgi_prefix_find(wsgi_call->uri);
+	if (wsgi_uri_find(wsgi_call->uri) || (node && node->call)) {
+		httpd_d("Found wsgi %s", wsgi_call->uri);
+		return kNoErr;
+	}
+
+	if (wsgi_call->http_flags & APP_HTTP_FLAGS_NO_EXACT_MATCH)
+		ret = wsgi_prefix_insert(wsgi_call);
+	else
+		ret = wsgi_uri_insert(wsgi_call);
+
+	if (ret != kNoErr) {
+		httpd_d("No memory.. Cannot register wsgi %s", wsgi_call->uri);
+		return -kInProgressErr;
+	}
+
+	httpd_d("Register wsgi %s", wsgi_call->uri);
+	return kNoErr;
+}
 
 int httpd_register_wsgi_handlers(struct httpd_wsgi_call *wsgi_call_list, int
 					handlers_no)
@@ -104,13 +344,18 @@ int httpd_register_wsgi_handlers(struct httpd_wsgi_call *wsgi_call_list, int
 /* Unregister a WSGI call */
 int httpd_unregister_wsgi_handler(struct httpd_wsgi_call *wsgi_call)
 {
-	int i;
+	struct wsgi_prefix_node *node;
 
-	for (i = 0; i < MAX_WSGI_HANDLERS; i++) {
-		if (calls[i] && (calls[i] == wsgi_call)) {
-			calls[i] = NULL;
-			return 0;
-		}
+	if (!wsgi_call->uri)
+		return 0;
+
+	if (wsgi_call->http_flags & APP_HTTP_FLAGS_NO_EXACT_MATCH) {
+		/* The node is kept, it is reused if the URI comes back */
+		node = wsgi_prefix_find(wsgi_call->uri);
+		if (node && node->call == wsgi_call)
+			node->call = NULL;
+	} else {
+		wsgi_uri_remove(wsgi_call);
 	}
 
 	return 0;
@@ -422,8 +667,9 @@ int httpd_send_all_header(httpd_request_t *req, const char *first_line, int body
   return ret;
 }
 
-int httpd_send_response(httpd_request_t *req, const char *first_line,
-			char *content, int length, const char *content_type)
+/* Everything httpd_send_response() sends before the content */
+static int httpd_send_response_hdr(httpd_request_t *req, const char *first_line,
+				   int length, const char *content_type)
 {
 	int ret;
 
@@ -473,7 +719,17 @@ int httpd_send_response(httpd_request_t *req, const char *first_line,
 		}
 	}
 
-	httpd_send_crlf(req->sock);
+	return httpd_send_crlf(req->sock);
+}
+
+int httpd_send_response(httpd_request_t *req, const char *first_line,
+			char *content, int length, const char *content_type)
+{
+	int ret;
+
+	ret = httpd_send_response_hdr(req, first_line, length, content_type);
+	if (ret != kNoErr)
+		return ret;
 
 	/* HTTP Head response does not require any content. It should
 	 * contain identical headers as per the corresponding GET request */
@@ -497,6 +753,56 @@ int httpd_send_response(httpd_request_t *req, const char *first_line,
 	}
 	return ret;
 }
+
+static int httpd_json_chunk_sink(void *ctx, const char *buf, int len)
+{
+	return httpd_send_chunk(((httpd_request_t *)ctx)->sock, buf, len);
+}
+
+static int httpd_json_send_sink(void *ctx, const char *buf, int len)
+{
+	return httpd_send(((httpd_request_t *)ctx)->sock, buf, len);
+}
+
+int httpd_send_response_json(httpd_request_t *req, const char *first_line,
+			     struct json_object *obj)
+{
+	char buf[HTTPD_JSON_CHUNK_SIZE];
+	int ret, length = 0;
+
+	/* Without chunked encoding Content-Length has to be known up front,
+	 * so the document is walked once to measure it */
+	if (!chunked_encoding(req)) {
+		length = json_object_to_json_length(obj);
+		if (length < 0)
+			return -kInProgressErr;
+	}
+
+	ret = httpd_send_response_hdr(req, first_line, length,
+				      HTTP_CONTENT_JSON_STR);
+	if (ret != kNoErr || req->type == HTTPD_REQ_TYPE_HEAD)
+		return ret;
+
+	if (chunked_encoding(req)) {
+		ret = json_object_to_sink(obj, buf, sizeof(buf),
+					  httpd_json_chunk_sink, req);
+		if (ret != kNoErr) {
+			httpd_d("Error in sending response content");
+			return ret;
+		}
+
+		ret = httpd_send_chunk(req->sock, NULL, 0);
+		if (ret != kNoErr)
+			httpd_d("Error in sending last chunk");
+	} else {
+		ret = json_object_to_sink(obj, buf, sizeof(buf),
+					  httpd_json_send_sink, req);
+		if (ret != kNoErr)
+			httpd_d("Error sending response");
+	}
+	return ret;
+}
+
 int httpd_get_data(httpd_request_t *req, char *content, int length)
 {
 	int ret;
@@ -506,55 +812,42 @@ int httpd_get_data(httpd_request_t *req, char *content, int length)
 	if (req->body_nbytes >= HTTPD_MAX_MESSAGE - 2)
 		return -kInProgressErr;
 
-
-	buf = malloc(HTTPD_MAX_MESSAGE);
-	if (!buf) {
-		httpd_d("Failed to allocate memory for buffer");
-		return -kInProgressErr;
-	}
-
 	if (!req->hdr_parsed) {
+		buf = malloc(HTTPD_MAX_MESSAGE);
+		if (!buf) {
+			httpd_d("Failed to allocate memory for buffer");
+			return -kInProgressErr;
+		}
+
 		ret = httpd_parse_hdr_tags(req, req->sock, buf,
 			HTTPD_MAX_MESSAGE);
+		free(buf);
 
 		if (ret != kNoErr) {
 			httpd_d("Unable to parse header tags");
-			goto out;
+			return req->remaining_bytes;
 		} else {
 			httpd_d("Headers parsed successfully\r\n");
 			req->hdr_parsed = 1;
 		}
 	}
 
-	/* handle here */
+	/* Body bytes that arrived with the headers come from the connection
+	 * receive buffer, the rest from the socket */
 	ret = httpd_recv(req->sock, content,
 			length, 0);
 	if (ret == -1) {
 		httpd_d("Failed to read POST data");
-		goto out;
+		return req->remaining_bytes;
 	}
 	/* scratch will now have the JSON data */
 	content[ret] = '\0';
 	req->remaining_bytes -= ret;
 	httpd_d("Read %d bytes and remaining %d bytes",
 		ret, req->remaining_bytes);
-out:
-	free(buf);
 	return req->remaining_bytes;
 }
 
-static int get_matching_chars(const char *s1, const char *s2)
-{
-	int match = 0;
-
-	if (s1 != NULL && s2 != NULL) {
-		while (*s1++ == *s2++)
-			match++;
-	}
-	return match;
-
-}
-
 /* Function to skip the initial ipaddress/hostname path in a URL */
 char *httpd_skip_absolute_http_path(char *request)
 {
@@ -617,87 +910,104 @@ int httpd_validate_uri(char *req, const char *api, int flags)
 }
 
 
+/* Exact match: the request path is a registered URI followed either by a
+ * query string or by any number of slashes, so "/a?q" and "/a//" match "/a"
+ * but "/a/?q" does not. */
+static struct httpd_wsgi_call *wsgi_match_exact(const char *request)
+{
+	struct wsgi_uri_entry *e;
+	uint32_t h = WSGI_FNV_OFFSET, key_hash = WSGI_FNV_OFFSET;
+	int len, key_len = 0;
+
+	if (!uri_entry_cnt)
+		return NULL;
+
+	/* One pass: find the end of the path and hash it without its
+	 * trailing slashes */
+	for (len = 0; request[len] && request[len] != '?'; len++) {
+		if (request[len] != '/') {
+			h = (h ^ (unsigned char)request[len]) * WSGI_FNV_PRIME;
+			key_hash = h;
+			key_len = len + 1;
+		} else {
+			h = (h ^ '/') * WSGI_FNV_PRIME;
+		}
+	}
+
+	for (e = uri_buckets[key_hash & (uri_bucket_cnt - 1)]; e; e = e->next) {
+		/* The registered URI may end in slashes, the request must
+		 * have at least as many, and exactly as many before a '?' */
+		if (e->hash == key_hash && e->key_len == key_len &&
+		    (request[len] == '?' ? e->uri_len == len :
+		     e->uri_len <= len) &&
+		    !memcmp(e->call->uri, request, key_len)) {
+			httpd_d("Anchored pattern match: %s", e->call->uri);
+			return e->call;
+		}
+	}
+	return NULL;
+}
+
+/* Prefix match: the longest APP_HTTP_FLAGS_NO_EXACT_MATCH URI that the
+ * request starts with. */
+static struct httpd_wsgi_call *wsgi_match_prefix(const char *request)
+{
+	struct wsgi_prefix_node *node = &prefix_root;
+	struct httpd_wsgi_call *best = prefix_root.call;
+
+	while (*request) {
+		node = wsgi_prefix_find_child(node, *request);
+		if (!node || strncmp(node->label, request, node->label_len))
+			break;
+		request += node->label_len;
+		if (node->call)
+			best = node->call;
+	}
+	return best;
+}
+
 /* Check if there are any matching WSGI calls, and if so, execute them. */
 int httpd_wsgi(httpd_request_t *req_p)
 {
 	struct httpd_wsgi_call *f;
 	int err = -WM_E_HTTPD_NO_HANDLER;
-	int index, ret = 0;
-	int match_index = -1, cur_char_match = 0;
-	bool found;
 
-	char *ptr, *request = httpd_skip_absolute_http_path(req_p->filename);
+	char *request = httpd_skip_absolute_http_path(req_p->filename);
 
 	httpd_d("httpd_wsgi: looking for %s", request);
-        
-	/* IMP: fixme: Need to check for ? at the end or any forward slashes /
-	 * httpd_validate URI? */
-	for (index = 0; index < MAX_WSGI_HANDLERS; index++) {
-		f = calls[index];
-		if (f == NULL)
-			continue;
-		if (f->http_flags & APP_HTTP_FLAGS_NO_EXACT_MATCH) {
-			ret = get_matching_chars(request,
-						f->uri);
-			if (ret > cur_char_match) {
-				cur_char_match = ret;
-				match_index = index;
-			}
-		} else {
-			if (!strncmp(request, f->uri, strlen(f->uri))) {
-				found = 0;
-				ptr = request;
-				ptr += strlen(f->uri);
-				/* '?' terminates a filename */
-				if (*ptr == '?')
-					found = 1;
-				else {
-					/* Check for any number of
-					 * forward slashes */
-					while (*ptr && (*ptr == '/')) {
-						ptr++;
-					}
-					if (!*ptr)
-						found = 1;
-				}
-				if (found) {
-					httpd_d("Anchored pattern match: %s",
-						f->uri);
-					match_index = index;
-					/* Break if there is an exact match */
-					break;
-				}
-			}
-		}
-	}
-	if (match_index == -1)
+
+	/* An exact match has priority over any prefix match */
+	f = wsgi_match_exact(request);
+	if (f == NULL)
+		f = wsgi_match_prefix(request);
+	if (f == NULL)
 		return err;
 
 	/* Match found. So map the wsgi to this request */
-	req_p->wsgi = calls[match_index];
+	req_p->wsgi = f;
 	switch (req_p->type) {
 	case HTTPD_REQ_TYPE_HEAD:
 	case HTTPD_REQ_TYPE_GET:
-		if (calls[match_index]->get_handler)
-			err = calls[match_index]->get_handler(req_p);
+		if (f->get_handler)
+			err = f->get_handler(req_p);
 		else
 			return err;
 		break;
 	case HTTPD_REQ_TYPE_POST:
-		if (calls[match_index]->set_handler)
-			err = calls[match_index]->set_handler(req_p);
+		if (f->set_handler)
+			err = f->set_handler(req_p);
 		else
 			return err;
 		break;
 	case HTTPD_REQ_TYPE_PUT:
-		if (calls[match_index]->put_handler)
-			err = calls[match_index]->put_handler(req_p);
+		if (f->put_handler)
+			err = f->put_handler(req_p);
 		else
 			return err;
 		break;
 	case HTTPD_REQ_TYPE_DELETE:
-		if (calls[match_index]->delete_handler)
-			err = calls[match_index]->delete_handler(req_p);
+		if (f->delete_handler)
+			err = f->delete_handler(req_p);
 		else
 			return err;
 		break;
@@ -715,7 +1025,22 @@ int httpd_wsgi(httpd_request_t *req_p)
 /* Initialise the WSGI handler data structures */
 int httpd_wsgi_init(void)
 {
-	memset(calls, 0, sizeof(calls));
+	struct wsgi_uri_entry *e, *next;
+	unsigned i;
+
+	for (i = 0; i < uri_bucket_cnt; i++) {
+		for (e = uri_buckets[i]; e; e = next) {
+			next = e->next;
+			free(e);
+		}
+	}
+	free(uri_buckets);
+	uri_buckets = NULL;
+	uri_bucket_cnt = 0;
+	uri_entry_cnt = 0;
+
+	wsgi_prefix_free(prefix_root.child);
+	memset(&prefix_root, 0, sizeof(prefix_root));
 
 	return kNoErr;
 }
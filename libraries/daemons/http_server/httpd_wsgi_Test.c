@@ -0,0 +1,268 @@
+/**
+******************************************************************************
+* @file    httpd_wsgi_Test.c
+* @version V1.0.0
+* @date    17-Oct-2026
+* @brief   Checks the WSGI route index against a linear scan of the handlers
+*          with the matching rules of the former 32-slot table, and times both
+*          over 136 routes. Built on the host together with httpd_wsgi.c and
+*          http-strings.c; the few server calls httpd_wsgi.c makes outside the
+*          route index are stubbed below. Not part of the default build.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "httpd.h"
+#include "httpd_priv.h"
+
+#define WSGI_TEST_EXACT_ROUTES	96
+#define WSGI_TEST_PREFIX_ROUTES	40
+#define WSGI_TEST_ROUTES	(WSGI_TEST_EXACT_ROUTES + WSGI_TEST_PREFIX_ROUTES)
+#define WSGI_TEST_URI_SIZE	48
+#define WSGI_TEST_SECONDS	1
+
+/* Stand-ins for the rest of the server, never reached by GET handlers that
+ * do not send anything */
+int httpd_send(int sock, const char *buf, int len) { return kNoErr; }
+int httpd_send_chunk(int sock, const char *buf, int len) { return kNoErr; }
+int httpd_recv(int sock, void *buf, size_t n, int flags) { return 0; }
+int httpd_parse_hdr_tags(httpd_request_t *req, int sock, char *buffer,
+			 int len) { return kNoErr; }
+int json_object_to_sink(struct json_object *jso, char *buf, int size,
+			json_writer_sink_fn *sink, void *ctx) { return -1; }
+int json_object_to_json_length(struct json_object *jso) { return -1; }
+
+static int wsgi_test_handler(httpd_request_t *req)
+{
+	return kNoErr;
+}
+
+static struct httpd_wsgi_call wsgi_test_calls[WSGI_TEST_ROUTES];
+static char wsgi_test_uris[WSGI_TEST_ROUTES][WSGI_TEST_URI_SIZE];
+/* Registered routes in registration order */
+static int wsgi_test_order[WSGI_TEST_ROUTES];
+static int wsgi_test_count;
+
+/* The former lookup: every registered handler in turn, the first exact
+ * match wins, otherwise the longest prefix */
+static const struct httpd_wsgi_call *wsgi_test_linear(const char *request)
+{
+	const struct httpd_wsgi_call *f, *best = NULL;
+	const char *ptr;
+	size_t len, best_len = 0;
+	int i;
+
+	for (i = 0; i < wsgi_test_count; i++) {
+		f = &wsgi_test_calls[wsgi_test_order[i]];
+		len = strlen(f->uri);
+		if (strncmp(request, f->uri, len))
+			continue;
+		if (f->http_flags & APP_HTTP_FLAGS_NO_EXACT_MATCH) {
+			if (len > best_len) {
+				best_len = len;
+				best = f;
+			}
+			continue;
+		}
+		/* '?' terminates a filename, otherwise any number of
+		 * forward slashes may follow */
+		ptr = request + len;
+		if (*ptr != '?') {
+			while (*ptr == '/')
+				ptr++;
+			if (*ptr)
+				continue;
+		}
+		return f;
+	}
+	return best;
+}
+
+/* Register with the index and with the linear list, which refuses a URI
+ * that is already there just as the index does */
+static void wsgi_test_register(int route)
+{
+	int i;
+
+	httpd_register_wsgi_handler(&wsgi_test_calls[route]);
+	for (i = 0; i < wsgi_test_count; i++)
+		if (!strcmp(wsgi_test_uris[wsgi_test_order[i]],
+			    wsgi_test_uris[route]))
+			return;
+	wsgi_test_order[wsgi_test_count++] = route;
+}
+
+static void wsgi_test_unregister(int route)
+{
+	int i;
+
+	httpd_unregister_wsgi_handler(&wsgi_test_calls[route]);
+	for (i = 0; i < wsgi_test_count; i++) {
+		if (wsgi_test_order[i] == route) {
+			memmove(&wsgi_test_order[i], &wsgi_test_order[i + 1],
+				(--wsgi_test_count - i) * sizeof(int));
+			break;
+		}
+	}
+}
+
+static const struct httpd_wsgi_call *wsgi_test_lookup(const char *request)
+{
+	static httpd_request_t req;
+
+	snprintf(req.filename, sizeof(req.filename), "%s", request);
+	req.type = HTTPD_REQ_TYPE_GET;
+	req.wsgi = NULL;
+	if (httpd_wsgi(&req) != HTTPD_DONE)
+		return NULL;
+	return req.wsgi;
+}
+
+/* Every route and the ways a request can differ from it */
+static OSStatus wsgi_test_compare(void)
+{
+	static const char *suffixes[] = {
+		"", "/", "//", "?q=1", "/?q=1", "//?q=1", "x", "/x", "/x?q=1",
+	};
+	char request[WSGI_TEST_URI_SIZE + 16];
+	unsigned i, k;
+	size_t len;
+
+	for (i = 0; i < WSGI_TEST_ROUTES; i++) {
+		for (k = 0; k < sizeof(suffixes) / sizeof(suffixes[0]); k++) {
+			strcpy(request, wsgi_test_uris[i]);
+			strcat(request, suffixes[k]);
+			if (wsgi_test_lookup(request) !=
+			    wsgi_test_linear(request))
+				goto mismatch;
+		}
+		/* Cut short at every length */
+		for (len = 0; len < strlen(wsgi_test_uris[i]); len++) {
+			snprintf(request, sizeof(request), "%.*s", (int)len,
+				 wsgi_test_uris[i]);
+			if (wsgi_test_lookup(request) !=
+			    wsgi_test_linear(request))
+				goto mismatch;
+		}
+	}
+	return kNoErr;
+
+mismatch:
+	printf("%s: index %s, linear scan %s\r\n", request,
+	       wsgi_test_lookup(request) ? wsgi_test_lookup(request)->uri : "none",
+	       wsgi_test_linear(request) ? wsgi_test_linear(request)->uri : "none");
+	return kMismatchErr;
+}
+
+/* Lookups per second of the index, or of the linear scan */
+static unsigned long wsgi_test_rate(bool linear)
+{
+	static httpd_request_t reqs[WSGI_TEST_ROUTES];
+	unsigned long lookups = 0;
+	clock_t start, elapsed;
+	unsigned i;
+
+	for (i = 0; i < WSGI_TEST_ROUTES; i++) {
+		snprintf(reqs[i].filename, sizeof(reqs[i].filename), "%s?q=1",
+			 wsgi_test_uris[(i * 37) % WSGI_TEST_ROUTES]);
+		reqs[i].type = HTTPD_REQ_TYPE_GET;
+	}
+
+	start = clock();
+	do {
+		for (i = 0; i < WSGI_TEST_ROUTES; i++) {
+			if (linear)
+				wsgi_test_linear(reqs[i].filename);
+			else
+				httpd_wsgi(&reqs[i]);
+		}
+		lookups += WSGI_TEST_ROUTES;
+		elapsed = clock() - start;
+	} while (elapsed < WSGI_TEST_SECONDS * CLOCKS_PER_SEC);
+
+	return (unsigned long)((double)lookups * CLOCKS_PER_SEC / elapsed);
+}
+
+OSStatus httpd_wsgi_Test(int print)
+{
+	struct httpd_wsgi_call *call;
+	int i;
+	OSStatus err;
+
+	httpd_wsgi_init();
+
+	/* Exact routes that share prefixes with each other and with the
+	 * prefix routes, some registered with a trailing slash */
+	for (i = 0; i < WSGI_TEST_ROUTES; i++) {
+		if (i < WSGI_TEST_EXACT_ROUTES)
+			snprintf(wsgi_test_uris[i], WSGI_TEST_URI_SIZE,
+				 "/api/dev%d/%s%s", i / 8,
+				 i % 2 ? "status" : "config", i % 3 ? "" : "/");
+		else
+			snprintf(wsgi_test_uris[i], WSGI_TEST_URI_SIZE,
+				 "/%s/dev%d%s", i % 2 ? "api" : "files",
+				 i % 12, i % 4 ? "/" : "");
+		call = &wsgi_test_calls[i];
+		memset(call, 0, sizeof(*call));
+		call->uri = wsgi_test_uris[i];
+		call->get_handler = wsgi_test_handler;
+		if (i >= WSGI_TEST_EXACT_ROUTES)
+			call->http_flags = APP_HTTP_FLAGS_NO_EXACT_MATCH;
+	}
+
+	/* Duplicate URIs are generated on purpose, the first one stays */
+	wsgi_test_count = 0;
+	for (i = 0; i < WSGI_TEST_ROUTES; i++)
+		wsgi_test_register(i);
+	err = wsgi_test_compare();
+	if (err != kNoErr)
+		goto exit;
+
+	/* Drop every third route, then bring them back */
+	for (i = 0; i < WSGI_TEST_ROUTES; i += 3)
+		wsgi_test_unregister(i);
+	err = wsgi_test_compare();
+	if (err != kNoErr)
+		goto exit;
+	for (i = 0; i < WSGI_TEST_ROUTES; i += 3)
+		wsgi_test_register(i);
+	err = wsgi_test_compare();
+	if (err != kNoErr)
+		goto exit;
+
+	if (print)
+		printf("%d routes: %lu lookups/s, linear scan %lu lookups/s\r\n",
+		       WSGI_TEST_ROUTES, wsgi_test_rate(false),
+		       wsgi_test_rate(true));
+
+exit:
+	httpd_wsgi_init();
+	if (print)
+		printf("httpd_wsgi_Test: %s\r\n", err == kNoErr ? "PASSED" : "FAILED");
+	return err;
+}
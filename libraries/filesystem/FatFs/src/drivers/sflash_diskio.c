@@ -32,8 +32,18 @@
 /* Includes ------------------------------------------------------------------*/
 #include <string.h>
 #include "ff_gen_drv.h"
+#include "sflash_diskio.h"
 
 /* Private typedef -----------------------------------------------------------*/
+typedef struct
+{
+  uint32_t block;                 /* Erase block number */
+  uint32_t used;                  /* Access count at the last use, for LRU eviction */
+  uint8_t  present;               /* Sectors held in data, none if the line is free */
+  uint8_t  dirty;                 /* Sectors in data not written to the flash yet */
+  uint8_t  data[4096];
+} sflash_cache_line_t;
+
 /* Private define ------------------------------------------------------------*/
 /* Block Size in Bytes */
 #define BLOCK_SIZE                8
@@ -41,12 +51,29 @@
 //#define SECTOR_COUNT              2048
 #define FLASH_SECTOR              4096
 
+#define CHECK_SIZE                64    /* Bytes compared with the flash at a time */
+
+#if SFLASHDISK_CACHE_BLOCKS > 0
+#define CACHE_LINES               SFLASHDISK_CACHE_BLOCKS
+#else
+#define CACHE_LINES               1
+#endif
+
 /* Private variables ---------------------------------------------------------*/
 /* Disk status */
 static volatile DSTATUS Stat = STA_NOINIT;
-static void MicoFlashEraseWrite( mico_partition_t partition, volatile uint32_t* off_set, uint8_t* data_addr ,uint32_t size );
 mico_logic_partition_t *fatfs_partition;
 
+static uint32_t disk_size;
+static sflash_cache_line_t cache[CACHE_LINES];
+static uint32_t cache_used;
+static sflash_disk_stats_t stats;
+
+#if SFLASHDISK_SIMULATOR
+static uint8_t sim_flash[SFLASHDISK_SIMULATOR_SIZE];
+static bool sim_flash_init = false;
+#endif
+
 /* Private function prototypes -----------------------------------------------*/
 DSTATUS SFLASHDISK_initialize (void);
 DSTATUS SFLASHDISK_status (void);
@@ -73,6 +100,254 @@ Diskio_drvTypeDef  SFLASHDISK_Driver =
 
 /* Private functions ---------------------------------------------------------*/
 
+/* Flash access, the only place the partition or the simulator is touched */
+static OSStatus flash_read( uint32_t offset, uint8_t *buff, uint32_t size )
+{
+  stats.reads++;
+  stats.bytes_read += size;
+#if SFLASHDISK_SIMULATOR
+  if( offset + size > SFLASHDISK_SIMULATOR_SIZE ) return kParamErr;
+  memcpy( buff, &sim_flash[offset], size );
+  return kNoErr;
+#else
+  return MicoFlashRead( MICO_PARTITION_FILESYS, &offset, buff, size );
+#endif
+}
+
+static OSStatus flash_write( uint32_t offset, uint8_t *buff, uint32_t size )
+{
+  stats.bytes_programmed += size;
+#if SFLASHDISK_SIMULATOR
+  uint32_t i;
+  if( offset + size > SFLASHDISK_SIMULATOR_SIZE ) return kParamErr;
+  /* Programming only clears bits */
+  for( i = 0; i < size; i++ )
+    sim_flash[offset + i] &= buff[i];
+  return kNoErr;
+#else
+  return MicoFlashWrite( MICO_PARTITION_FILESYS, &offset, buff, size );
+#endif
+}
+
+static OSStatus flash_erase( uint32_t block )
+{
+  stats.erases++;
+#if SFLASHDISK_SIMULATOR
+  if( ( block + 1 ) * FLASH_SECTOR > SFLASHDISK_SIMULATOR_SIZE ) return kParamErr;
+  memset( &sim_flash[block * FLASH_SECTOR], 0xFF, FLASH_SECTOR );
+  return kNoErr;
+#else
+  return MicoFlashErase( MICO_PARTITION_FILESYS, block * FLASH_SECTOR, FLASH_SECTOR );
+#endif
+}
+
+static bool is_blank( const uint8_t *data, uint32_t size )
+{
+  uint32_t i;
+  for( i = 0; i < size; i++ )
+    if( data[i] != 0xFF ) return false;
+  return true;
+}
+
+/* Compares size bytes of data with the flash at offset. The bytes that differ
+   are first to last - 1, none if first == last; erase is set if one of them
+   is not blank in the flash, so that programming cannot change it. */
+static OSStatus flash_compare( uint32_t offset, const uint8_t *data, uint32_t size,
+                               uint32_t *first, uint32_t *last, bool *erase )
+{
+  OSStatus err;
+  uint8_t buf[CHECK_SIZE];
+  uint32_t pos, i;
+
+  *first = *last = 0;
+  *erase = false;
+  for( pos = 0; pos < size; pos += CHECK_SIZE )
+  {
+    err = flash_read( offset + pos, buf, CHECK_SIZE );
+    if( err != kNoErr ) return err;
+    for( i = 0; i < CHECK_SIZE; i++ )
+    {
+      if( buf[i] == data[pos + i] ) continue;
+      if( *first == *last ) *first = pos + i;
+      *last = pos + i + 1;
+      if( buf[i] != 0xFF )
+      {
+        *erase = true;
+        return kNoErr;
+      }
+    }
+  }
+  return kNoErr;
+}
+
+static OSStatus flash_blank( uint32_t offset, uint32_t size, bool *blank )
+{
+  OSStatus err;
+  uint8_t buf[CHECK_SIZE];
+  uint32_t pos;
+
+  *blank = true;
+  for( pos = 0; pos < size && *blank; pos += CHECK_SIZE )
+  {
+    err = flash_read( offset + pos, buf, CHECK_SIZE );
+    if( err != kNoErr ) return err;
+    *blank = is_blank( buf, CHECK_SIZE );
+  }
+  return kNoErr;
+}
+
+/* Programs the sectors in mask from the line, consecutive ones in one call */
+static OSStatus cache_program( sflash_cache_line_t *line, uint8_t mask )
+{
+  OSStatus err;
+  int first, last;
+
+  for( first = 0; first < BLOCK_SIZE; first = last )
+  {
+    if( !( mask & ( 1 << first ) ) ) { last = first + 1; continue; }
+    for( last = first + 1; last < BLOCK_SIZE && ( mask & ( 1 << last ) ); last++ );
+    err = flash_write( line->block * FLASH_SECTOR + first * SECTOR_SIZE, &line->data[first * SECTOR_SIZE],
+                       ( last - first ) * SECTOR_SIZE );
+    if( err != kNoErr ) return err;
+  }
+  return kNoErr;
+}
+
+/* Writes the dirty sectors of a line back. When every byte that changed is
+   blank in the flash, only the changed bytes are programmed. Otherwise the
+   sectors the line does not hold are read, the block is erased and the
+   sectors that are not blank are programmed. */
+static OSStatus cache_flush( sflash_cache_line_t *line )
+{
+  OSStatus err;
+  uint32_t first[BLOCK_SIZE], last[BLOCK_SIZE];
+  bool erase = false;
+  uint8_t program;
+  int i;
+
+  if( line->dirty == 0 ) return kNoErr;
+
+  for( i = 0; i < BLOCK_SIZE && !erase; i++ )
+  {
+    first[i] = last[i] = 0;
+    if( !( line->dirty & ( 1 << i ) ) ) continue;
+    err = flash_compare( line->block * FLASH_SECTOR + i * SECTOR_SIZE, &line->data[i * SECTOR_SIZE], SECTOR_SIZE,
+                         &first[i], &last[i], &erase );
+    if( err != kNoErr ) return err;
+  }
+
+  if( !erase )
+  {
+    for( i = 0; i < BLOCK_SIZE; i++ )
+    {
+      if( first[i] == last[i] ) continue;
+      err = flash_write( line->block * FLASH_SECTOR + i * SECTOR_SIZE + first[i],
+                         &line->data[i * SECTOR_SIZE + first[i]], last[i] - first[i] );
+      if( err != kNoErr ) return err;
+    }
+    line->dirty = 0;
+    return kNoErr;
+  }
+
+  for( i = 0; i < BLOCK_SIZE; i++ )
+  {
+    if( line->present & ( 1 << i ) ) continue;
+    err = flash_read( line->block * FLASH_SECTOR + i * SECTOR_SIZE, &line->data[i * SECTOR_SIZE], SECTOR_SIZE );
+    if( err != kNoErr ) return err;
+  }
+  line->present = 0xFF;
+
+  err = flash_erase( line->block );
+  if( err != kNoErr ) return err;
+
+  program = 0;
+  for( i = 0; i < BLOCK_SIZE; i++ )
+    if( !is_blank( &line->data[i * SECTOR_SIZE], SECTOR_SIZE ) ) program |= 1 << i;
+
+  err = cache_program( line, program );
+  if( err != kNoErr ) return err;
+  line->dirty = 0;
+  return kNoErr;
+}
+
+static sflash_cache_line_t *cache_find( uint32_t block )
+{
+  int i;
+  for( i = 0; i < CACHE_LINES; i++ )
+    if( cache[i].present && cache[i].block == block ) return &cache[i];
+  return NULL;
+}
+
+/* Line holding block, a free or the least recently used one if none does */
+static sflash_cache_line_t *cache_get( uint32_t block )
+{
+  sflash_cache_line_t *line = cache_find( block );
+  int i;
+
+  if( line == NULL )
+  {
+    line = &cache[0];
+    for( i = 0; i < CACHE_LINES && line->present; i++ )
+      if( !cache[i].present || cache[i].used < line->used ) line = &cache[i];
+    if( cache_flush( line ) != kNoErr ) return NULL;
+    line->block = block;
+    line->present = 0;
+  }
+  line->used = ++cache_used;
+  return line;
+}
+
+static OSStatus cache_sync( void )
+{
+  OSStatus err;
+  int i;
+  for( i = 0; i < CACHE_LINES; i++ )
+  {
+    err = cache_flush( &cache[i] );
+    if( err != kNoErr ) return err;
+  }
+  return kNoErr;
+}
+
+/* Sectors first to last are unused. Blocks wholly inside are erased now, if
+   they are not blank, so the next writes there program without erasing;
+   trimmed sectors of other cached blocks are no longer written back. */
+static OSStatus cache_trim( DWORD first, DWORD last )
+{
+  OSStatus err;
+  sflash_cache_line_t *line;
+  uint32_t block;
+  bool blank;
+  DWORD sector;
+
+  if( last >= disk_size / SECTOR_SIZE ) last = disk_size / SECTOR_SIZE - 1;
+
+  for( sector = first; sector <= last; sector++ )
+  {
+    block = sector / BLOCK_SIZE;
+    line = cache_find( block );
+
+    if( sector % BLOCK_SIZE == 0 && sector + BLOCK_SIZE - 1 <= last )
+    {
+      if( line ) line->present = line->dirty = 0;
+      err = flash_blank( block * FLASH_SECTOR, FLASH_SECTOR, &blank );
+      if( err != kNoErr ) return err;
+      if( !blank )
+      {
+        err = flash_erase( block );
+        if( err != kNoErr ) return err;
+      }
+      sector += BLOCK_SIZE - 1;
+    }
+    else if( line )
+    {
+      line->present &= ~( 1 << ( sector % BLOCK_SIZE ) );
+      line->dirty &= ~( 1 << ( sector % BLOCK_SIZE ) );
+    }
+  }
+  return kNoErr;
+}
+
 /**
   * @brief  Initializes a Drive
   * @param  None
@@ -81,7 +356,20 @@ Diskio_drvTypeDef  SFLASHDISK_Driver =
 DSTATUS SFLASHDISK_initialize(void)
 {
   Stat = STA_NOINIT;
+#if SFLASHDISK_SIMULATOR
+  if( !sim_flash_init )
+  {
+    memset( sim_flash, 0xFF, sizeof(sim_flash) );
+    sim_flash_init = true;
+  }
+  disk_size = SFLASHDISK_SIMULATOR_SIZE;
+#else
   fatfs_partition = MicoFlashGetInfo( MICO_PARTITION_FILESYS );
+  disk_size = fatfs_partition->partition_length;
+#endif
+  /* Blocks cached before a remount may have been changed behind the cache */
+  if( cache_sync() != kNoErr ) return STA_NOINIT;
+  memset( cache, 0, sizeof(cache) );
   Stat &= ~STA_NOINIT;
   return RES_OK;
 }
@@ -109,17 +397,33 @@ DSTATUS SFLASHDISK_status(void)
   */
 DRESULT SFLASHDISK_read(BYTE *buff, DWORD sector, BYTE count)
 {
-  DRESULT res = RES_OK;
-  uint32_t offset;
+  sflash_cache_line_t *line;
+  BYTE run;
 
-  for(; count>0; count--)
+  while( count > 0 )
   {
-    offset = (uint32_t)sector*SECTOR_SIZE;
-    MicoFlashRead( MICO_PARTITION_FILESYS, &offset, (uint8_t *)buff, SECTOR_SIZE);
-    sector++;
-    buff += SECTOR_SIZE;
+    line = cache_find( sector / BLOCK_SIZE );
+    if( line && ( line->present & ( 1 << ( sector % BLOCK_SIZE ) ) ) )
+    {
+      memcpy( buff, &line->data[( sector % BLOCK_SIZE ) * SECTOR_SIZE], SECTOR_SIZE );
+      run = 1;
+    }
+    else
+    {
+      /* Read the sectors up to the next cached one in one go, straight into
+         the caller's buffer */
+      for( run = 1; run < count; run++ )
+      {
+        line = cache_find( ( sector + run ) / BLOCK_SIZE );
+        if( line && ( line->present & ( 1 << ( ( sector + run ) % BLOCK_SIZE ) ) ) ) break;
+      }
+      if( flash_read( sector * SECTOR_SIZE, buff, run * SECTOR_SIZE ) != kNoErr ) return RES_ERROR;
+    }
+    sector += run;
+    buff += run * SECTOR_SIZE;
+    count -= run;
   }
-  return res;
+  return RES_OK;
 }
 
 /**
@@ -132,18 +436,24 @@ DRESULT SFLASHDISK_read(BYTE *buff, DWORD sector, BYTE count)
 #if _USE_WRITE == 1
 DRESULT SFLASHDISK_write(const BYTE *buff, DWORD sector, BYTE count)
 { 
-  DRESULT res = RES_OK;
-  uint32_t offset;
+  sflash_cache_line_t *line;
 
   for(; count>0; count--)
   {
-    offset = (uint32_t)sector*SECTOR_SIZE;
-    MicoFlashEraseWrite( MICO_PARTITION_FILESYS, &offset, (uint8_t *)buff, SECTOR_SIZE);
+    line = cache_get( sector / BLOCK_SIZE );
+    if( line == NULL ) return RES_ERROR;
+    memcpy( &line->data[( sector % BLOCK_SIZE ) * SECTOR_SIZE], buff, SECTOR_SIZE );
+    line->present |= 1 << ( sector % BLOCK_SIZE );
+    line->dirty |= 1 << ( sector % BLOCK_SIZE );
+    stats.sectors_written++;
     sector++;
     buff += SECTOR_SIZE;
   }
-  
-  return res;
+
+#if SFLASHDISK_CACHE_BLOCKS == 0
+  if( cache_sync() != kNoErr ) return RES_ERROR;
+#endif
+  return RES_OK;
 }
 #endif /* _USE_WRITE == 1 */
 
@@ -157,31 +467,24 @@ DRESULT SFLASHDISK_write(const BYTE *buff, DWORD sector, BYTE count)
 DRESULT SFLASHDISK_ioctl(BYTE cmd, void *buff)
 {
   DRESULT res = RES_OK;
-  DWORD nFrom,nTo;
-  int i;
   
   if (Stat & STA_NOINIT) return RES_NOTRDY;
-//  char *buf = buff;
   
   switch (cmd)
   {
     /* Make sure that no pending write process */
     case CTRL_SYNC :
-      res = RES_OK;
+      res = ( cache_sync() == kNoErr ) ? RES_OK : RES_ERROR;
       break;
 
     case CTRL_TRIM:
-      nFrom = *((DWORD*)buff);
-      nTo = *(((DWORD*)buff)+1);
-      for(i = nFrom;i <= nTo;i ++){
-      }
-      res = RES_OK;
+      res = ( cache_trim( ((DWORD*)buff)[0], ((DWORD*)buff)[1] ) == kNoErr ) ? RES_OK : RES_ERROR;
       break;
     
     /* Get number of sectors on the disk (DWORD) */
     case GET_SECTOR_COUNT :
 //      *(DWORD*)buff = SECTOR_COUNT;  
-      *(DWORD*)buff = (fatfs_partition->partition_length)/SECTOR_SIZE;
+      *(DWORD*)buff = disk_size/SECTOR_SIZE;
       res = RES_OK;
       break;
     
@@ -205,45 +508,10 @@ DRESULT SFLASHDISK_ioctl(BYTE cmd, void *buff)
 }
 #endif /* _USE_IOCTL == 1 */
 
-void MicoFlashEraseWrite( mico_partition_t partition, volatile uint32_t* off_set, uint8_t* data_addr ,uint32_t size )
+void SFLASHDISK_GetStats( sflash_disk_stats_t *out, int reset )
 {
-  uint32_t f_sector;
-  uint32_t f_addr;
-  uint8_t *f_sector_buf = NULL;
-  uint32_t pos = 0;
-  
-  uint16_t s_sector;
-  
-  f_sector = (*off_set) >> 12;
-  f_addr = f_sector << 12; 
-  
-  s_sector = (*off_set) & 0x0F00; 
-  
-  f_sector_buf = malloc(FLASH_SECTOR); 
-  
-  MicoFlashRead( partition, &f_addr, f_sector_buf, FLASH_SECTOR); 
-  
-  for(pos=0; pos<size; pos++)
-  {
-    if( f_sector_buf[s_sector + pos] != 0xFF )
-      break; 
-  }
-  
-  if(pos != size){ 
-    f_addr -= FLASH_SECTOR;
-    MicoFlashErase(partition, f_addr, size); 
-    
-    for( pos=0; pos<size; pos++ )
-    {
-      f_sector_buf[s_sector + pos] = data_addr[pos];
-    } 
-    MicoFlashWrite( partition, &f_addr, f_sector_buf, FLASH_SECTOR);
-  } else { 
-    MicoFlashWrite( partition, off_set, data_addr, size ); 
-  } 
-  
-  free(f_sector_buf);   
+  if( out ) *out = stats;
+  if( reset ) memset( &stats, 0, sizeof(stats) );
 }
   
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
-
@@ -34,11 +34,51 @@
 #define __SFLASH_DISKIO_H
 
 /* Includes ------------------------------------------------------------------*/
-/* Exported types ------------------------------------------------------------*/
+#include "ff_gen_drv.h"
+
 /* Exported constants --------------------------------------------------------*/
+/* Number of 4 KB erase blocks held in RAM. Sector writes are gathered there
+   and reach the flash on CTRL_SYNC (f_sync, f_close) or when the block is
+   evicted, so the FAT, directory and data blocks a file write touches are
+   erased once per sync instead of once per sector. 0 writes every call
+   through, through a single block buffer. */
+#ifndef SFLASHDISK_CACHE_BLOCKS
+#define SFLASHDISK_CACHE_BLOCKS     2
+#endif
+
+/* 1 keeps the disk in a RAM array with the bit clearing program and block
+   erase of a NOR flash, instead of MICO_PARTITION_FILESYS. */
+#ifndef SFLASHDISK_SIMULATOR
+#define SFLASHDISK_SIMULATOR        0
+#endif
+
+#ifndef SFLASHDISK_SIMULATOR_SIZE
+#define SFLASHDISK_SIMULATOR_SIZE   ( 128 * 1024 )
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct
+{
+  uint32_t sectors_written;   /* Sectors written by FatFs */
+  uint32_t erases;            /* Blocks erased */
+  uint32_t bytes_programmed;  /* Bytes written to the flash */
+  uint32_t bytes_read;        /* Bytes read from the flash */
+  uint32_t reads;             /* Flash read calls */
+} sflash_disk_stats_t;
+
 /* Exported functions ------------------------------------------------------- */
 extern Diskio_drvTypeDef  SFLASHDISK_Driver;
 
+/* Flash traffic since the last reset, reset it if reset is non zero */
+void SFLASHDISK_GetStats( sflash_disk_stats_t *stats, int reset );
+
+/* Formats the disk, reports erases and bytes programmed per MB written by
+   FatFs for a few write patterns, then f_read throughput and flash read calls
+   per MB for a few read sizes. The FatFs volume on the partition is lost,
+   build with SFLASHDISK_SIMULATOR to run it in RAM. Not part of any project,
+   add sflash_diskio_bench.c to use it. */
+OSStatus SFLASHDISK_Bench( int inPrint );
+
 #endif /* __SDRAM_DISKIO_H */
 
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
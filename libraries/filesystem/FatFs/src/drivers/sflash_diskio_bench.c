@@ -0,0 +1,182 @@
+/**
+******************************************************************************
+* @file    sflash_diskio_bench.c
+* @version V1.0.0
+* @date    17-Oct-2026
+* @brief   Flash erases and bytes programmed per MB written through FatFs on
+*          the SPI flash disk, for the cache size the image is built with.
+*          Add this file to a project and call SFLASHDISK_Bench().
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#include <string.h>
+#include "sflash_diskio.h"
+
+#define BENCH_FILE              "bench.bin"
+#define BENCH_MAX_SIZE          ( 1024 * 1024 )
+#define BENCH_BUFFER_SIZE       ( 16 * 1024 )
+
+typedef struct
+{
+  const char *name;
+  uint32_t    chunk;        /* Bytes per f_write */
+  bool        sync;         /* f_sync after every f_write */
+  bool        in_place;     /* Rewrite the file instead of truncating it */
+} sflash_bench_pattern_t;
+
+static const sflash_bench_pattern_t patterns[] =
+{
+  { "512 B writes",           512,  false, false },
+  { "512 B writes, in place", 512,  false, true  },
+  { "4 KB writes, overwrite", 4096, false, false },
+  { "128 B writes, f_sync",   128,  true,  false },
+};
+
+static const uint32_t read_sizes[] = { 512, 4096, 16 * 1024 };
+
+static uint32_t per_mb( uint32_t count, uint32_t size )
+{
+  return (uint32_t)( (uint64_t)count * 1024 * 1024 / size );
+}
+
+static FRESULT bench_pattern( const char *path, const sflash_bench_pattern_t *pattern, uint8_t fill, uint8_t *buf, uint32_t size )
+{
+  FRESULT res;
+  FIL file;
+  UINT written;
+  uint32_t pos;
+
+  res = f_open( &file, path, ( pattern->in_place ? FA_OPEN_ALWAYS : FA_CREATE_ALWAYS ) | FA_WRITE );
+  if( res != FR_OK ) return res;
+
+  for( pos = 0; pos < size && res == FR_OK; pos += pattern->chunk )
+  {
+    memset( buf, (uint8_t)( fill + pos / pattern->chunk ), pattern->chunk );
+    res = f_write( &file, buf, pattern->chunk, &written );
+    if( res == FR_OK && written != pattern->chunk ) res = FR_DENIED;
+    if( res == FR_OK && pattern->sync ) res = f_sync( &file );
+  }
+
+  if( res == FR_OK ) res = f_close( &file );
+  else f_close( &file );
+  return res;
+}
+
+static FRESULT bench_read( const char *path, uint32_t chunk, uint8_t *buf, uint32_t size )
+{
+  FRESULT res;
+  FIL file;
+  UINT read;
+  uint32_t pos;
+
+  res = f_open( &file, path, FA_READ );
+  if( res != FR_OK ) return res;
+
+  for( pos = 0; pos < size && res == FR_OK; pos += chunk )
+  {
+    res = f_read( &file, buf, chunk, &read );
+    if( res == FR_OK && read != chunk ) res = FR_DENIED;
+  }
+
+  f_close( &file );
+  return res;
+}
+
+OSStatus SFLASHDISK_Bench( int inPrint )
+{
+  OSStatus err = kNoErr;
+  FATFS *fs = NULL;
+  uint8_t *buf = NULL;
+  char drive[4], path[16];
+  DWORD free_clusters;
+  FATFS *free_fs;
+  uint32_t size, start, elapsed, i;
+  sflash_disk_stats_t stats;
+  bool linked = false;
+
+  fs = malloc( sizeof(FATFS) );
+  buf = malloc( BENCH_BUFFER_SIZE );
+  require_action( fs && buf, exit, err = kNoMemoryErr );
+
+  require_action( FATFS_LinkDriver( &SFLASHDISK_Driver, drive ) == 0, exit, err = kNoResourcesErr );
+  linked = true;
+  strcpy( path, drive );
+  strcat( path, BENCH_FILE );
+
+  /* 4 KB clusters, so that clusters freed by a delete are trimmed as whole blocks */
+  require_action( f_mount( fs, drive, 0 ) == FR_OK, exit, err = kReadErr );
+  require_action( f_mkfs( drive, 1, 4096 ) == FR_OK, exit, err = kWriteErr );
+  require_action( f_getfree( drive, &free_clusters, &free_fs ) == FR_OK, exit, err = kReadErr );
+
+  size = free_clusters * free_fs->csize * _MAX_SS / 2;
+  size -= size % BENCH_BUFFER_SIZE;
+  if( size > BENCH_MAX_SIZE ) size = BENCH_MAX_SIZE;
+  require_action( size > 0, exit, err = kSizeErr );
+
+  if( inPrint )
+    printf( "SPI flash disk, %d cache blocks, %u KB file\r\n", SFLASHDISK_CACHE_BLOCKS, (unsigned int)( size / 1024 ) );
+
+  /* The first pattern writes to a blank volume, the others rewrite the file
+     the one before wrote, or truncate it first, which trims its clusters */
+  for( i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++ )
+  {
+    SFLASHDISK_GetStats( NULL, 1 );
+    start = mico_get_time();
+
+    require_action( bench_pattern( path, &patterns[i], (uint8_t)( i * 0x55 ), buf, size ) == FR_OK, exit, err = kWriteErr );
+
+    elapsed = mico_get_time() - start;
+    SFLASHDISK_GetStats( &stats, 0 );
+    if( inPrint )
+      printf( "%-22s %6u erases/MB %9u bytes programmed/MB %6u ms\r\n", patterns[i].name,
+              (unsigned int) per_mb( stats.erases, size ), (unsigned int) per_mb( stats.bytes_programmed, size ),
+              (unsigned int) elapsed );
+  }
+
+  /* FatFs reads whole sectors of a cluster straight into the caller's buffer,
+     which the driver passes to a single flash read */
+  for( i = 0; i < sizeof(read_sizes) / sizeof(read_sizes[0]); i++ )
+  {
+    SFLASHDISK_GetStats( NULL, 1 );
+    start = mico_get_time();
+
+    require_action( bench_read( path, read_sizes[i], buf, size ) == FR_OK, exit, err = kReadErr );
+
+    elapsed = mico_get_time() - start;
+    SFLASHDISK_GetStats( &stats, 0 );
+    if( inPrint )
+      printf( "f_read %5u B          %6u reads/MB  %9u bytes/s\r\n", (unsigned int) read_sizes[i],
+              (unsigned int) per_mb( stats.reads, size ), (unsigned int)( (uint64_t)size * 1000 / ( elapsed ? elapsed : 1 ) ) );
+  }
+
+exit:
+  if( linked )
+  {
+    f_mount( NULL, drive, 0 );
+    FATFS_UnLinkDriver( drive );
+  }
+  if( buf ) free( buf );
+  if( fs ) free( fs );
+  return err;
+}
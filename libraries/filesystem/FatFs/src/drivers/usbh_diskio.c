@@ -107,18 +107,27 @@ DRESULT USBH_read(BYTE *buff, DWORD sector, BYTE count)
   USBH_StatusTypeDef  status = USBH_OK;
   DWORD scratch [_MAX_SS / 4];
   
-  if ((DWORD)buff & 3) /* DMA Alignment issue, do single up to aligned buffer */
+  if ((DWORD)buff & 3) /* DMA Alignment issue */
   {
-    while ((count--)&&(status == USBH_OK))
+    /* Read all but the last sector in one transfer to the first aligned
+       address in buff, which they still fit above, and move them down into
+       place. Only the last sector goes through the scratch buffer. */
+    BYTE *aligned = buff + 4 - ((DWORD)buff & 3);
+    
+    if (count > 1)
     {
-      status = USBH_MSC_Read(&HOST_HANDLE, 0, sector + count, (uint8_t *)scratch, 1);
+      status = USBH_MSC_Read(&HOST_HANDLE, 0, sector, aligned, count - 1);
       if(status == USBH_OK)
       {
-        memcpy (&buff[count * _MAX_SS] ,scratch, _MAX_SS);
+        memmove (buff, aligned, (count - 1) * _MAX_SS);
       }
-      else
+    }
+    if(status == USBH_OK)
+    {
+      status = USBH_MSC_Read(&HOST_HANDLE, 0, sector + count - 1, (uint8_t *)scratch, 1);
+      if(status == USBH_OK)
       {
-        break;
+        memcpy (&buff[(count - 1) * _MAX_SS], scratch, _MAX_SS);
       }
     }
   }
@@ -32,13 +32,16 @@
 
 #include "mico.h"
 #include "SocketUtils.h"
+#include "sntp.h"
+#include "sntp_clock.h"
 
 
 #define ntp_log(M, ...) custom_log("NTP client", M, ##__VA_ARGS__)
 #define ntp_log_trace() custom_log_trace("NTP client")
 
 
-#define UNIX_OFFSET 		         2208960000U
+#define NTP_UNIX_OFFSET          2208988800U   // Seconds from 1900 to 1970
+#define NTP_RTC_TIME_ZONE        ( 8 * 3600 )  // The RTC keeps China Standard Time
 #define NTP_Server               "time.asia.apple.com"
 #define NTP_Port                 123
 #define NTP_Flags                0xdb 
@@ -48,9 +51,21 @@
 #define NTP_Root_Delay           0x8000
 #define NTP_Root_Dispersion      0xa00b0000
 
+#define NTP_Mode_Server          4
+#define NTP_LI_Alarm             3
+#define NTP_Stratum_Max          15
+
+#define NTP_Timeout_ms           2000   // Wait for each reply.
+#define NTP_Burst_Interval_ms    2000   // Between the exchanges of a burst.
+#define NTP_Resolve_Failures     3      // Polls without reply before resolving the server name again.
+
 static volatile bool _wifiConnected = false;
 static mico_semaphore_t  _wifiConnected_sem = NULL;
 
+static mico_mutex_t _clock_mutex = NULL;
+static sntp_clock_t _clock;
+static uint32_t     _server_ip = 0;      // Kept across restarts of the client.
+
 
 struct NtpPacket
 {
@@ -60,7 +75,7 @@ struct NtpPacket
 	uint8_t precision;
 	uint32_t root_delay;
 	uint32_t root_dispersion;
-	uint8_t referenceID;
+	uint32_t referenceID;
 	uint32_t ref_ts_sec;
 	uint32_t ref_ts_frac;
 	uint32_t origin_ts_sec;
@@ -89,6 +104,113 @@ void ntpNotify_WifiStatusHandler(int event, void *arg)
   return;
 }
 
+/* NTP timestamps wrap in 2036, Unix time in seconds as uint32_t in 2106: the
+   difference taken modulo 2^32 is right in both NTP eras. */
+static int64_t _ntp_to_unix_us( uint32_t sec, uint32_t frac )
+{
+  return (int64_t)(uint32_t)( sec - NTP_UNIX_OFFSET ) * 1000000 + (int64_t)( ( (uint64_t)frac * 1000000 ) >> 32 );
+}
+
+static void _unix_us_to_ntp( int64_t us, uint32_t *sec, uint32_t *frac )
+{
+  *sec = (uint32_t)( us / 1000000 ) + NTP_UNIX_OFFSET;
+  *frac = (uint32_t)( ( (uint64_t)( us % 1000000 ) << 32 ) / 1000000 );
+}
+
+/* One request and reply, t1 to t4 in RFC 5905, fed to the clock filter. */
+static OSStatus _ntp_exchange( int fd, struct sockaddr_t *server, sntp_clock_update_t *update )
+{
+  OSStatus err = kNoErr;
+  struct NtpPacket packet;
+  fd_set readfds;
+  struct timeval_t t;
+  struct sockaddr_t addr;
+  socklen_t addrLen = sizeof(addr);
+  uint32_t send_ms, recv_ms, tx_sec, tx_frac;
+  int len;
+
+  memset(&packet, 0x0, sizeof(packet));
+  packet.flags = NTP_Flags;
+  packet.stratum = NTP_Stratum;
+  packet.poll = NTP_Poll;
+  packet.precision = NTP_Precision;
+  packet.root_delay = NTP_Root_Delay;
+  packet.root_dispersion = NTP_Root_Dispersion;
+
+  /* The server echoes the transmit timestamp, which tells its reply from late
+     replies to earlier requests. */
+  mico_rtos_lock_mutex(&_clock_mutex);
+  send_ms = mico_get_time();
+  _unix_us_to_ntp( sntp_clock_target_us( &_clock, send_ms ), &tx_sec, &tx_frac );
+  mico_rtos_unlock_mutex(&_clock_mutex);
+  packet.trans_ts_sec = htonl(tx_sec);
+  packet.trans_ts_frac = htonl(tx_frac);
+
+  len = sendto(fd, &packet, sizeof(packet), 0, server, sizeof(struct sockaddr_t));
+  require_action(len == sizeof(packet), exit, err = kNotWritableErr);
+
+  while(1) {
+    FD_ZERO(&readfds);
+    FD_SET(fd, &readfds);
+    t.tv_sec = NTP_Timeout_ms / 1000;
+    t.tv_usec = ( NTP_Timeout_ms % 1000 ) * 1000;
+    require_action(select(fd + 1, &readfds, NULL, NULL, &t) > 0, exit, err = kTimeoutErr);
+
+    len = recvfrom(fd, &packet, sizeof(packet), 0, &addr, &addrLen);
+    recv_ms = mico_get_time();
+    require_action(len >= 0, exit, err = kNotReadableErr);
+
+    if( len == sizeof(packet) && packet.origin_ts_sec == htonl(tx_sec) && packet.origin_ts_frac == htonl(tx_frac) )
+      break;
+  }
+
+  /* Stratum 0 is a kiss-o'-death, alarm means the server is not synchronised */
+  require_action((packet.flags & 0x07) == NTP_Mode_Server, exit, err = kResponseErr);
+  require_action((packet.flags >> 6) != NTP_LI_Alarm, exit, err = kResponseErr);
+  require_action(packet.stratum != 0 && packet.stratum <= NTP_Stratum_Max, exit, err = kResponseErr);
+  require_action(packet.recv_ts_sec != 0 && packet.trans_ts_sec != 0, exit, err = kResponseErr);
+
+  mico_rtos_lock_mutex(&_clock_mutex);
+  *update = sntp_clock_sample( &_clock, send_ms, recv_ms,
+                               _ntp_to_unix_us( ntohl(packet.recv_ts_sec), ntohl(packet.recv_ts_frac) ),
+                               _ntp_to_unix_us( ntohl(packet.trans_ts_sec), ntohl(packet.trans_ts_frac) ) );
+  mico_rtos_unlock_mutex(&_clock_mutex);
+
+exit:
+  return err;
+}
+
+/* Write the RTC at the start of a second, it only keeps whole seconds. */
+static void _ntp_rtc_update( void )
+{
+  int64_t now_us;
+  time_t current;
+  struct tm *currentTime;
+  mico_rtc_time_t time;
+
+  mico_rtos_lock_mutex(&_clock_mutex);
+  now_us = sntp_clock_now_us( &_clock, mico_get_time() );
+  mico_rtos_unlock_mutex(&_clock_mutex);
+  mico_thread_msleep( (uint32_t)( 1000 - ( now_us % 1000000 ) / 1000 ) );
+
+  mico_rtos_lock_mutex(&_clock_mutex);
+  now_us = sntp_clock_now_us( &_clock, mico_get_time() ) + 500;
+  mico_rtos_unlock_mutex(&_clock_mutex);
+
+  current = (time_t)( now_us / 1000000 ) + NTP_RTC_TIME_ZONE;
+  currentTime = localtime(&current);
+  time.sec = currentTime->tm_sec;
+  time.min = currentTime->tm_min ;
+  time.hr = currentTime->tm_hour;
+
+  time.date = currentTime->tm_mday;
+  time.weekday = currentTime->tm_wday;
+  time.month = currentTime->tm_mon + 1;
+  time.year = (currentTime->tm_year + 1900)%100;
+
+  MicoRtcSetTime( &time );
+}
+
 void NTPClient_thread(void *arg)
 {
   ntp_log_trace();
@@ -96,31 +218,18 @@ void NTPClient_thread(void *arg)
   UNUSED_PARAMETER( arg );
   
   int  Ntp_fd = -1;
-  fd_set readfds;
-  struct timeval_t t ;
   struct sockaddr_t addr;
-  socklen_t addrLen;	
   char ipstr[16];
-  unsigned int trans_sec, current;
-  struct NtpPacket outpacket ,inpacket;
-  struct tm *currentTime;
-  mico_rtc_time_t time;
+  uint8_t burst, i, failures = 0;
+  bool replied, stepped;
+  uint32_t interval;
+  sntp_clock_update_t update;
   LinkStatusTypeDef wifi_link;
   
   /* Regisist notifications */
   err = mico_system_notify_register( mico_notify_WIFI_STATUS_CHANGED, (void *)ntpNotify_WifiStatusHandler, NULL );
   require_noerr( err, exit ); 
  
-  memset(&outpacket,0x0,sizeof(outpacket));
-  memset(&inpacket,0x0,sizeof(inpacket));
-
-  outpacket.flags = NTP_Flags;
-  outpacket.stratum = NTP_Stratum;
-  outpacket.poll = NTP_Poll;
-  outpacket.precision = NTP_Precision;
-  outpacket.root_delay = NTP_Root_Delay;
-  outpacket.root_dispersion = NTP_Root_Dispersion;
-  
   err = micoWlanGetLinkStatus( &wifi_link );
   require_noerr( err, exit );
 
@@ -138,53 +247,54 @@ void NTPClient_thread(void *arg)
   err = kNoErr;
   require_noerr(err, exit);
 
-   while(1) {
-     err = gethostbyname(NTP_Server, (uint8_t *)ipstr, 16);
-     require_noerr(err, ReConnWithDelay);
-     ntp_log("NTP server address: %s",ipstr);
-     break;
+  while(1) {
+    /* The address is only looked up again when the server stops answering */
+    while(_server_ip == 0) {
+      err = gethostbyname(NTP_Server, (uint8_t *)ipstr, 16);
+      require_noerr(err, ReConnWithDelay);
+      ntp_log("NTP server address: %s",ipstr);
+      _server_ip = inet_addr(ipstr);
+      break;
+
+    ReConnWithDelay:
+      mico_thread_sleep(5);
+    }
 
-   ReConnWithDelay:
-     mico_thread_sleep(5);
-   }
+    addr.s_ip = _server_ip;
+    addr.s_port = NTP_Port;
 
-  addr.s_ip = inet_addr(ipstr);
-  addr.s_port = NTP_Port;
+    mico_rtos_lock_mutex(&_clock_mutex);
+    burst = sntp_clock_burst( &_clock );
+    mico_rtos_unlock_mutex(&_clock_mutex);
 
-  t.tv_sec = 5;
-  t.tv_usec = 0;
-  
-  while(1) {
-    require_action(sendto(Ntp_fd, &outpacket,sizeof(outpacket), 0, &addr, sizeof(addr)), exit, err = kNotWritableErr);
+    replied = stepped = false;
+    for( i = 0; i < burst; i++ ) {
+      if( i ) mico_thread_msleep( NTP_Burst_Interval_ms );
+      if( _ntp_exchange( Ntp_fd, &addr, &update ) != kNoErr ) continue;
+      replied = true;
+      if( update == SNTP_CLOCK_STEPPED ) stepped = true;
+    }
 
-    FD_ZERO(&readfds);
-    FD_SET(Ntp_fd, &readfds);
-
-    select(1, &readfds, NULL, NULL, &t);
-    
-    if(FD_ISSET(Ntp_fd, &readfds))
-    {
-      require_action(recvfrom(Ntp_fd, &inpacket, sizeof(struct NtpPacket), 0, &addr, &addrLen)>=0, exit, err = kNotReadableErr);
-
-      trans_sec = inpacket.trans_ts_sec;
-      trans_sec = ntohl(trans_sec);
-      current = trans_sec - UNIX_OFFSET;
-      ntp_log("Time Synchronoused, %s",asctime(localtime(&current)));
-
-      currentTime = localtime(&current);
-      time.sec = currentTime->tm_sec;
-      time.min = currentTime->tm_min ;
-      time.hr = currentTime->tm_hour;
-
-      time.date = currentTime->tm_mday;
-      time.weekday = currentTime->tm_wday;
-      time.month = currentTime->tm_mon + 1;
-      time.year = (currentTime->tm_year + 1900)%100;
-
-      MicoRtcSetTime( &time );
-      goto exit;
+    if( replied ) {
+      failures = 0;
+      if( stepped ) {
+        _ntp_rtc_update( );
+        ntp_log("Time Synchronoused");
+      }
+    } else if( ++failures >= NTP_Resolve_Failures ) {
+      _server_ip = 0;
+      failures = 0;
     }
+
+    /* Keep the clock anchored near the local time, which wraps */
+    mico_rtos_lock_mutex(&_clock_mutex);
+    sntp_clock_rebase( &_clock, mico_get_time() );
+    interval = sntp_clock_poll_interval_ms( &_clock );
+    mico_rtos_unlock_mutex(&_clock_mutex);
+
+    mico_thread_msleep( interval );
   }
+  
 exit:
     if( err!=kNoErr )ntp_log("Exit: NTP client exit with err = %d", err);
     mico_system_notify_remove( mico_notify_WIFI_STATUS_CHANGED, (void *)ntpNotify_WifiStatusHandler );
@@ -196,11 +306,30 @@ exit:
 
 OSStatus sntp_client_start( void )
 {
+  if( _clock_mutex == NULL ) {
+    sntp_clock_init( &_clock );
+    mico_rtos_init_mutex( &_clock_mutex );
+  }
   mico_rtos_init_semaphore(&_wifiConnected_sem, 1);
   return mico_rtos_create_thread(NULL, MICO_APPLICATION_PRIORITY, "NTP Client", NTPClient_thread, STACK_SIZE_NTP_CLIENT_THREAD, NULL );
 }
 
+OSStatus sntp_current_utc_ms_get( int64_t* utc_ms )
+{
+  OSStatus err = kNoErr;
+
+  require_action( _clock_mutex, exit, err = kNotPreparedErr );
 
+  mico_rtos_lock_mutex(&_clock_mutex);
+  if( _clock.synced )
+    *utc_ms = sntp_clock_now_us( &_clock, mico_get_time() ) / 1000;
+  else
+    err = kNotPreparedErr;
+  mico_rtos_unlock_mutex(&_clock_mutex);
+
+exit:
+  return err;
+}
 
 OSStatus sntp_current_time_get( struct tm* time )
 {
@@ -33,8 +33,16 @@
 
 #include "common.h"
 
+/* sntp.c keeps its time in the clock of sntp_clock.c, a project that builds
+   the client must build sntp_clock.c with it. */
 
 OSStatus sntp_client_start( void );
 
 OSStatus sntp_current_time_get( struct tm* time );
 
+/* UTC time from the clock disciplined by the NTP client, milliseconds since
+   1970. Monotonic once synchronised, except when an offset above
+   SNTP_STEP_THRESHOLD_MS steps it. Returns kNotPreparedErr until the first
+   reply from the server. */
+OSStatus sntp_current_utc_ms_get( int64_t* utc_ms );
+
@@ -0,0 +1,281 @@
+/**
+******************************************************************************
+* @file    sntp_clock.c
+* @version V1.0.0
+* @date    17-Oct-2026
+* @brief   Disciplined UTC clock: NTP sample filter, offset slewing, frequency
+*          correction and poll interval adaptation. No RTOS or network calls,
+*          the SNTP client thread feeds it and serialises access.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#include <string.h>
+
+#include "sntp_clock.h"
+
+/* Aging of samples in the filter, as in NTP's dispersion: twice 15 ppm, as
+   the filter compares round trip delays rather than half delays. */
+#define SNTP_AGE_PPM                30
+
+/* The frequency error is measured over at least this many seconds, and at
+   least four poll intervals, so that offset noise hardly moves it. */
+#define SNTP_FLL_MIN_INTERVAL       256
+
+/* Signed, so that a time read just before a rebase still converts */
+static int64_t _sntp_clock_elapsed_us( const sntp_clock_t *clock, uint32_t local_ms )
+{
+  return (int64_t)(int32_t)( local_ms - clock->base_ms ) * 1000;
+}
+
+/* Part of slew_us not yet applied to the displayed time at local_ms */
+static int64_t _sntp_clock_slew_left_us( const sntp_clock_t *clock, uint32_t local_ms )
+{
+  int64_t done = _sntp_clock_elapsed_us( clock, local_ms ) * SNTP_SLEW_PPM / 1000000;
+
+  if( clock->slew_us > 0 )
+    return ( clock->slew_us > done ) ? clock->slew_us - done : 0;
+  else
+    return ( -clock->slew_us > done ) ? clock->slew_us + done : 0;
+}
+
+static int64_t _sntp_abs( int64_t x )
+{
+  return ( x < 0 ) ? -x : x;
+}
+
+static uint32_t _sntp_sqrt( uint64_t x )
+{
+  uint64_t r = 0, bit = (uint64_t)1 << 62;
+
+  while( bit > x ) bit >>= 2;
+  while( bit != 0 )
+  {
+    if( x >= r + bit )
+    {
+      x -= r + bit;
+      r = ( r >> 1 ) + bit;
+    }
+    else
+      r >>= 1;
+    bit >>= 2;
+  }
+  return (uint32_t)r;
+}
+
+void sntp_clock_init( sntp_clock_t *clock )
+{
+  memset( clock, 0, sizeof(sntp_clock_t) );
+  clock->poll = SNTP_POLL_MIN;
+}
+
+int64_t sntp_clock_target_us( const sntp_clock_t *clock, uint32_t local_ms )
+{
+  int64_t elapsed = _sntp_clock_elapsed_us( clock, local_ms );
+
+  return clock->base_us + elapsed + elapsed * clock->freq_ppb / 1000000000;
+}
+
+int64_t sntp_clock_now_us( const sntp_clock_t *clock, uint32_t local_ms )
+{
+  return sntp_clock_target_us( clock, local_ms ) - _sntp_clock_slew_left_us( clock, local_ms );
+}
+
+void sntp_clock_rebase( sntp_clock_t *clock, uint32_t local_ms )
+{
+  clock->base_us = sntp_clock_target_us( clock, local_ms );
+  clock->slew_us = _sntp_clock_slew_left_us( clock, local_ms );
+  clock->base_ms = local_ms;
+}
+
+/* Offset of a sample against the target time as corrected since */
+static int64_t _sntp_clock_sample_offset( const sntp_clock_t *clock, const sntp_sample_t *sample )
+{
+  return sample->offset_us - ( clock->correction_us - sample->correction_us );
+}
+
+/* Sample with the lowest delay once aged to recv_ms, or NULL. Also sets the
+   jitter: a sample's offset is off by at most half its delay above the
+   lowest, so the RMS of that is taken rather than of the offsets, which
+   would include the frequency error. */
+static const sntp_sample_t * _sntp_clock_select( sntp_clock_t *clock, uint32_t recv_ms )
+{
+  const sntp_sample_t *best = NULL;
+  uint64_t best_distance = 0, distance, sum = 0;
+  int64_t diff;
+  int i, n = 0;
+
+  for( i = 0; i < SNTP_FILTER_SIZE; i++ )
+  {
+    const sntp_sample_t *sample = &clock->samples[i];
+    if( !sample->valid ) continue;
+
+    distance = sample->delay_us + (uint64_t)(uint32_t)( recv_ms - sample->local_ms ) * SNTP_AGE_PPM / 1000;
+    if( best == NULL || distance < best_distance )
+    {
+      best = sample;
+      best_distance = distance;
+    }
+  }
+  if( best == NULL ) return NULL;
+
+  for( i = 0; i < SNTP_FILTER_SIZE; i++ )
+  {
+    const sntp_sample_t *sample = &clock->samples[i];
+    if( !sample->valid || sample == best ) continue;
+
+    diff = ( (int64_t)sample->delay_us - (int64_t)best->delay_us ) / 2;
+    if( diff > 1000000 || diff < -1000000 ) diff = 1000000;
+    sum += (uint64_t)( diff * diff );
+    n++;
+  }
+  if( n > 0 ) clock->jitter_us = _sntp_sqrt( sum / n );
+  return best;
+}
+
+static void _sntp_clock_measure_freq( sntp_clock_t *clock, uint32_t update_ms, bool force );
+
+static void _sntp_clock_step( sntp_clock_t *clock, int64_t offset_us, uint32_t update_ms )
+{
+  clock->correction_us += offset_us;
+  if( clock->synced ) _sntp_clock_measure_freq( clock, update_ms, true );
+  clock->correction_us -= offset_us;
+
+  clock->base_us += offset_us;
+  clock->slew_us = 0;
+  clock->correction_us += offset_us;
+  clock->update_ms = update_ms;
+  clock->offset_us = 0;
+  clock->fll_ms = update_ms;
+  clock->fll_correction_us = clock->correction_us;
+  clock->poll = SNTP_POLL_MIN;
+  clock->poll_count = 0;
+  clock->synced = true;
+  memset( clock->samples, 0, sizeof(clock->samples) );
+}
+
+/* The frequency has not changed since fll_ms, so the corrections made since
+   then add up to its error times the interval, with only the noise of the
+   first and last offsets on top. Once the interval is long enough, or when
+   stepping, correct the frequency by that and start a new interval. */
+static void _sntp_clock_measure_freq( sntp_clock_t *clock, uint32_t update_ms, bool force )
+{
+  uint32_t interval_s = (uint32_t)( update_ms - clock->fll_ms ) / 1000;
+  int64_t freq;
+
+  if( interval_s == 0 ) return;
+  if( !force && ( interval_s < SNTP_FLL_MIN_INTERVAL || interval_s < ( 4UL << clock->poll ) ) ) return;
+
+  freq = clock->freq_ppb + ( clock->correction_us - clock->fll_correction_us ) * 1000 / interval_s;
+  if( freq > SNTP_FREQ_MAX_PPM * 1000 ) freq = SNTP_FREQ_MAX_PPM * 1000;
+  if( freq < -SNTP_FREQ_MAX_PPM * 1000 ) freq = -SNTP_FREQ_MAX_PPM * 1000;
+  clock->freq_ppb = (int32_t)freq;
+  clock->fll_ms = update_ms;
+  clock->fll_correction_us = clock->correction_us;
+}
+
+static void _sntp_clock_adapt_poll( sntp_clock_t *clock, int64_t offset_us )
+{
+  /* Residual offsets are the frequency error left over the last interval
+     plus the measurement noise, which polling more often does not reduce:
+     poll less often while they stay well inside the accuracy wanted or the
+     noise, and more often as soon as they go beyond either. */
+  if( _sntp_abs( offset_us ) > SNTP_ACCURACY_US + 4 * (int64_t)clock->jitter_us )
+  {
+    if( clock->poll > SNTP_POLL_MIN ) clock->poll--;
+    clock->poll_count = 0;
+  }
+  else if( _sntp_abs( offset_us ) <= SNTP_ACCURACY_US / 2 + 2 * (int64_t)clock->jitter_us )
+  {
+    if( ++clock->poll_count >= 2 )
+    {
+      if( clock->poll < SNTP_POLL_MAX ) clock->poll++;
+      clock->poll_count = 0;
+    }
+  }
+}
+
+sntp_clock_update_t sntp_clock_sample( sntp_clock_t *clock, uint32_t send_ms, uint32_t recv_ms,
+                                       int64_t server_rx_us, int64_t server_tx_us )
+{
+  int64_t t1 = sntp_clock_target_us( clock, send_ms );
+  int64_t t4 = sntp_clock_target_us( clock, recv_ms );
+  int64_t delay, offset;
+  sntp_sample_t *sample;
+  const sntp_sample_t *best;
+
+  /* RFC 5905 section 8 */
+  offset = ( ( server_rx_us - t1 ) + ( server_tx_us - t4 ) ) / 2;
+  delay = ( t4 - t1 ) - ( server_tx_us - server_rx_us );
+  if( delay < 0 ) delay = 0;
+
+  sample = &clock->samples[clock->sample_next];
+  clock->sample_next = ( clock->sample_next + 1 ) % SNTP_FILTER_SIZE;
+  sample->local_ms = recv_ms;
+  sample->delay_us = ( delay > UINT32_MAX ) ? UINT32_MAX : (uint32_t)delay;
+  sample->offset_us = offset;
+  sample->correction_us = clock->correction_us;
+  sample->valid = true;
+
+  sntp_clock_rebase( clock, recv_ms );
+
+  if( !clock->synced )
+  {
+    _sntp_clock_step( clock, offset, recv_ms );
+    return SNTP_CLOCK_STEPPED;
+  }
+
+  /* Only use samples newer than the last one used, each sample is used once */
+  best = _sntp_clock_select( clock, recv_ms );
+  if( best == NULL || (int32_t)( best->local_ms - clock->update_ms ) <= 0 )
+    return SNTP_CLOCK_IGNORED;
+
+  offset = _sntp_clock_sample_offset( clock, best );
+  if( _sntp_abs( offset ) > (int64_t)SNTP_STEP_THRESHOLD_MS * 1000 )
+  {
+    _sntp_clock_step( clock, offset, best->local_ms );
+    return SNTP_CLOCK_STEPPED;
+  }
+
+  clock->base_us += offset;
+  clock->slew_us += offset;
+  clock->correction_us += offset;
+  clock->update_ms = best->local_ms;
+  clock->offset_us = offset;
+
+  _sntp_clock_measure_freq( clock, best->local_ms, false );
+  _sntp_clock_adapt_poll( clock, offset );
+  return SNTP_CLOCK_SLEWED;
+}
+
+uint32_t sntp_clock_poll_interval_ms( const sntp_clock_t *clock )
+{
+  return 1000UL << clock->poll;
+}
+
+uint8_t sntp_clock_burst( const sntp_clock_t *clock )
+{
+  if( !clock->synced || clock->jitter_us > SNTP_ACCURACY_US )
+    return SNTP_BURST;
+  return 1;
+}
@@ -0,0 +1,171 @@
+/**
+******************************************************************************
+* @file    sntp_clock.h
+* @version V1.0.0
+* @date    17-Oct-2026
+* @brief   Disciplined UTC clock on top of the monotonic mico_get_time(),
+*          steered by the NTP samples taken by the SNTP client.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#pragma once
+
+#include "common.h"
+
+/*
+ * The clock keeps two times. The target time is the best estimate of UTC: it
+ * runs at the local tick rate corrected by the measured frequency error and
+ * jumps by each offset correction. The displayed time, returned to
+ * applications, follows the target by slewing at SNTP_SLEW_PPM, so it never
+ * jumps or runs backwards except when the offset is above
+ * SNTP_STEP_THRESHOLD_MS and the clock is stepped.
+ *
+ * Offsets are measured against the target time, and every sample remembers
+ * the total correction made before it was taken, so the filter can compare
+ * samples taken across corrections.
+ */
+
+#ifndef SNTP_FILTER_SIZE
+#define SNTP_FILTER_SIZE            8       // Samples kept; the one with the lowest delay after aging is used.
+#endif
+
+#ifndef SNTP_STEP_THRESHOLD_MS
+#define SNTP_STEP_THRESHOLD_MS      128     // Larger offsets step the clock instead of slewing it.
+#endif
+
+#ifndef SNTP_SLEW_PPM
+#define SNTP_SLEW_PPM               500     // Rate the displayed time catches up with the target time.
+#endif
+
+#ifndef SNTP_FREQ_MAX_PPM
+#define SNTP_FREQ_MAX_PPM           500     // Largest frequency correction accepted.
+#endif
+
+#ifndef SNTP_ACCURACY_US
+#define SNTP_ACCURACY_US            1000    // Offset the poll interval is adapted to stay within.
+#endif
+
+#ifndef SNTP_BURST
+#define SNTP_BURST                  4       // Exchanges per poll until synchronised, or while the jitter is above SNTP_ACCURACY_US.
+#endif
+
+#ifndef SNTP_POLL_MIN
+#define SNTP_POLL_MIN               4       // log2 of the shortest poll interval, in seconds.
+#endif
+
+#ifndef SNTP_POLL_MAX
+#define SNTP_POLL_MAX               10      // log2 of the longest poll interval, in seconds.
+#endif
+
+typedef struct
+{
+  uint32_t    local_ms;       // mico_get_time() when the reply arrived.
+  uint32_t    delay_us;       // Round trip delay, less the server's processing time.
+  int64_t     offset_us;      // Server time minus target time.
+  int64_t     correction_us;  // sntp_clock_t.correction_us when the sample was taken.
+  bool        valid;
+} sntp_sample_t;
+
+typedef enum
+{
+  SNTP_CLOCK_IGNORED,         // No sample newer than the last update passed the filter.
+  SNTP_CLOCK_SLEWED,          // Offset corrected by slewing.
+  SNTP_CLOCK_STEPPED,         // Clock set, first sample or offset too large.
+} sntp_clock_update_t;
+
+typedef struct
+{
+  uint32_t        base_ms;          // Local time the model below is anchored to.
+  int64_t         base_us;          // Target time at base_ms, microseconds since 1970.
+  int64_t         slew_us;          // Target minus displayed time at base_ms.
+  int32_t         freq_ppb;         // Frequency correction, parts per billion.
+  int64_t         correction_us;    // Sum of all offset corrections.
+  uint32_t        update_ms;        // Local time of the sample last used.
+  int64_t         offset_us;        // Offset of the sample last used.
+  uint32_t        jitter_us;        // RMS offset difference of the samples in the filter.
+  uint32_t        fll_ms;           // Local time freq_ppb was last changed.
+  int64_t         fll_correction_us;// correction_us at fll_ms.
+  uint8_t         poll;             // log2 of the poll interval, in seconds.
+  int8_t          poll_count;       // Hysteresis for poll changes.
+  bool            synced;
+  uint8_t         sample_next;
+  sntp_sample_t   samples[ SNTP_FILTER_SIZE ];
+} sntp_clock_t;
+
+/**
+ * @brief  Resets the clock to unsynchronised, with no frequency correction.
+ */
+void sntp_clock_init( sntp_clock_t *clock );
+
+/**
+ * @brief  Returns the displayed UTC time, in microseconds since 1970.
+ *
+ * @param  clock: The clock.
+ * @param  local_ms: mico_get_time() of the instant to convert. The clock must
+ *         have been updated or rebased within the last 24 days.
+ */
+int64_t sntp_clock_now_us( const sntp_clock_t *clock, uint32_t local_ms );
+
+/**
+ * @brief  Returns the target UTC time, used to timestamp NTP requests.
+ */
+int64_t sntp_clock_target_us( const sntp_clock_t *clock, uint32_t local_ms );
+
+/**
+ * @brief  Moves the anchor of the clock to local_ms without changing the
+ *         time it returns. Called at every poll so that local time wrapping
+ *         never reaches the anchor.
+ */
+void sntp_clock_rebase( sntp_clock_t *clock, uint32_t local_ms );
+
+/**
+ * @brief  Adds one NTP exchange to the filter and corrects the clock.
+ *
+ * @param  clock: The clock.
+ * @param  send_ms: mico_get_time() when the request was sent.
+ * @param  recv_ms: mico_get_time() when the reply arrived.
+ * @param  server_rx_us: Server receive timestamp, microseconds since 1970.
+ * @param  server_tx_us: Server transmit timestamp, microseconds since 1970.
+ *
+ * @return What was done to the clock.
+ */
+sntp_clock_update_t sntp_clock_sample( sntp_clock_t *clock, uint32_t send_ms, uint32_t recv_ms,
+                                       int64_t server_rx_us, int64_t server_tx_us );
+
+/**
+ * @brief  Returns the interval until the next poll, in milliseconds.
+ */
+uint32_t sntp_clock_poll_interval_ms( const sntp_clock_t *clock );
+
+/**
+ * @brief  Returns the number of exchanges to make at the next poll: a burst
+ *         gives the filter low delay samples to choose from when the clock is
+ *         not set yet or the network delay varies a lot, one is enough
+ *         otherwise.
+ */
+uint8_t sntp_clock_burst( const sntp_clock_t *clock );
+
+/* A day against a simulated NTP server with delay jitter, see sntp_clock_test.c */
+OSStatus sntp_clock_test( int print );
+
@@ -0,0 +1,211 @@
+/**
+******************************************************************************
+* @file    sntp_clock_test.c
+* @version V1.0.0
+* @date    17-Oct-2026
+* @brief   Simulated NTP server for sntp_clock.c: a day of polls against a
+*          server behind a network with skewed delay jitter and lost
+*          replies, from a local clock that drifts and whose mico_get_time()
+*          wraps. Checks the error of the displayed time, the frequency
+*          found and the packets sent, that the time never runs backwards,
+*          and that samples which do not step it only change its rate.
+*          Built on the host with sntp_clock.c; not part of the default build.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sntp_clock.h"
+
+#define SNTP_TEST_START_US          1.7e15          // True time at the start, microseconds since 1970.
+#define SNTP_TEST_START_MS          4294000000UL    // mico_get_time() at the start, wraps after 967 s.
+#define SNTP_TEST_STEP_US           100000.0        // Simulation step.
+#define SNTP_TEST_CHECK_US          500000.0        // Displayed time checked this often.
+#define SNTP_TEST_SETTLE_US         1800e6          // Errors counted from 30 minutes after the start,
+#define SNTP_TEST_JUMP_SETTLE_US    3600e6          // and from an hour after a jump, which a slewed one also
+                                                    // leaves in the frequency until the next measurement.
+#define SNTP_TEST_BURST_GAP_US      2e6             // Between the exchanges of a burst, as in sntp.c.
+#define SNTP_TEST_MIN_DELAY_US      2000.0          // One way, without jitter.
+#define SNTP_TEST_SERVER_US         100.0           // Server processing time.
+#define SNTP_TEST_LOSS              20              // One reply in this many is lost.
+
+typedef struct
+{
+  const char *name;
+  double      drift_ppm;      // Local clock rate error.
+  double      jitter_us;      // Mean delay jitter, each way.
+  double      jump_us;        // Server time jump half way through, 0 for none.
+
+  /* Limits */
+  int         max_packets;
+  int         steps;
+  double      max_freq_error_ppm;
+  double      max_rms_us;
+  double      max_error_us;
+
+  /* Results */
+  int         packets;
+  int         stepped;
+  int         jumped;         // Samples that moved the displayed time without a step.
+  int         backwards;
+  double      freq_ppm;
+  double      rms_us;
+  double      worst_us;
+} sntp_test_run_t;
+
+static uint32_t sntp_test_seed = 1;
+
+/* Uniform in (0, 1) */
+static double _sntp_test_random( void )
+{
+  sntp_test_seed = sntp_test_seed * 1103515245 + 12345;
+  return ( ( sntp_test_seed >> 8 ) + 1.0 ) / ( ( 1UL << 24 ) + 2.0 );
+}
+
+/* One way delay: mostly close to the minimum, with a long tail; the mean
+   jitter is a quarter of the largest */
+static double _sntp_test_delay( double jitter_us )
+{
+  double u = _sntp_test_random( );
+
+  return SNTP_TEST_MIN_DELAY_US + u * u * u * 4 * jitter_us;
+}
+
+/* mico_get_time() at true time t */
+static uint32_t _sntp_test_local_ms( const sntp_test_run_t *run, double t )
+{
+  double ms = ( t - SNTP_TEST_START_US ) * ( 1 + run->drift_ppm * 1e-6 ) / 1000;
+
+  return (uint32_t)( SNTP_TEST_START_MS + (uint64_t)ms );
+}
+
+static void _sntp_test_run( sntp_test_run_t *run )
+{
+  sntp_clock_t clock;
+  double t = SNTP_TEST_START_US + 3e6, end = SNTP_TEST_START_US + 24 * 3600e6, jump_at = SNTP_TEST_START_US + 12 * 3600e6;
+  double next_poll = t, next_check = t, settled = SNTP_TEST_START_US + SNTP_TEST_SETTLE_US;
+  double server_offset = 0, out, back, server_rx, error, sum = 0;
+  int64_t shown, last_shown = 0;
+  uint32_t send_ms, recv_ms;
+  double mean, root;
+  long checks = 0;
+  int burst = 0, i;
+
+  sntp_clock_init( &clock );
+  run->packets = run->stepped = run->jumped = run->backwards = 0;
+  run->worst_us = 0;
+
+  for( ; t < end; t += SNTP_TEST_STEP_US )
+  {
+    if( run->jump_us != 0 && server_offset == 0 && t >= jump_at )
+    {
+      server_offset = run->jump_us;
+      settled = t + SNTP_TEST_JUMP_SETTLE_US;
+    }
+
+    if( t >= next_poll )
+    {
+      if( burst <= 0 ) burst = sntp_clock_burst( &clock );
+      run->packets++;
+      send_ms = _sntp_test_local_ms( run, t );
+      out = _sntp_test_delay( run->jitter_us );
+      back = _sntp_test_delay( run->jitter_us );
+      if( _sntp_test_random( ) * SNTP_TEST_LOSS >= 1 )
+      {
+        /* Unless it steps, a sample only changes the rate of the displayed time */
+        server_rx = t + out + server_offset;
+        recv_ms = _sntp_test_local_ms( run, t + out + SNTP_TEST_SERVER_US + back );
+        shown = sntp_clock_now_us( &clock, recv_ms );
+        if( sntp_clock_sample( &clock, send_ms, recv_ms, (int64_t)server_rx,
+                               (int64_t)( server_rx + SNTP_TEST_SERVER_US ) ) == SNTP_CLOCK_STEPPED )
+          run->stepped++;
+        else if( sntp_clock_now_us( &clock, recv_ms ) != shown )
+          run->jumped++;
+      }
+      burst--;
+      next_poll = t + ( ( burst > 0 ) ? SNTP_TEST_BURST_GAP_US
+                        : sntp_clock_poll_interval_ms( &clock ) * 1000.0 / ( 1 + run->drift_ppm * 1e-6 ) );
+      sntp_clock_rebase( &clock, _sntp_test_local_ms( run, t ) );
+    }
+
+    /* The displayed time against the server's, to the tick */
+    for( ; next_check <= t; next_check += SNTP_TEST_CHECK_US )
+    {
+      shown = sntp_clock_now_us( &clock, _sntp_test_local_ms( run, next_check ) );
+      if( clock.synced && shown < last_shown ) run->backwards++;
+      last_shown = shown;
+      if( next_check < settled || !clock.synced ) continue;
+      error = shown - ( next_check + server_offset );
+      if( error < 0 ) error = -error;
+      if( error > run->worst_us ) run->worst_us = error;
+      sum += error * error;
+      checks++;
+    }
+  }
+
+  /* Square root by Newton's method, to need no libm */
+  run->freq_ppm = clock.freq_ppb / 1000.0;
+  mean = checks ? sum / checks : 0;
+  for( root = ( mean > 1 ) ? mean : 1, i = 0; i < 64; i++ )
+    root = ( root + mean / root ) / 2;
+  run->rms_us = root;
+}
+
+OSStatus sntp_clock_test( int print )
+{
+  static sntp_test_run_t runs[] =
+  {
+    /* name                      drift   jitter  jump      packets steps freq  rms    max */
+    { "5 ppm, no jitter",        5,      0,      0,        150,    1,    0.5,  800,   3000 },
+    { "200 ppm, 1 ms jitter",    200,    1000,   0,        400,    1,    2,    1500,  8000 },
+    { "-80 ppm, 10 ms jitter",   -80,    10000,  0,        500,    1,    5,    7000,  30000 },
+    { "35 ppm, server +2 s",     35,     1000,   2e6,      400,    2,    2,    1500,  6000 },
+    { "35 ppm, server +50 ms",   35,     1000,   50e3,     400,    1,    2,    1500,  6000 },
+  };
+  sntp_test_run_t *run;
+  double freq_error;
+  OSStatus err = kNoErr;
+  int i;
+
+  for( i = 0; i < (int)( sizeof(runs) / sizeof(runs[0]) ); i++ )
+  {
+    run = &runs[i];
+    _sntp_test_run( run );
+    freq_error = run->freq_ppm + run->drift_ppm;
+    if( freq_error < 0 ) freq_error = -freq_error;
+    if( print )
+      printf( "%-22s %4d packets, %d steps, freq %8.3f ppm, error %5.0f us RMS %6.0f us max\r\n",
+              run->name, run->packets, run->stepped, run->freq_ppm, run->rms_us, run->worst_us );
+    if( run->packets > run->max_packets || run->stepped != run->steps || run->jumped != 0 || run->backwards != 0
+        || freq_error > run->max_freq_error_ppm || run->rms_us > run->max_rms_us || run->worst_us > run->max_error_us )
+    {
+      if( print ) printf( "sntp_clock_test: %s out of limits\r\n", run->name );
+      err = kRangeErr;
+    }
+  }
+
+  if( print ) printf( "sntp_clock_test: %s\r\n", ( err == kNoErr ) ? "PASSED" : "FAILED" );
+  return err;
+}
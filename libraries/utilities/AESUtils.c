@@ -192,6 +192,33 @@ exit:
     return( err );
 }
 
+//===========================================================================================================================
+//  AES_CTR_UpdateV
+//===========================================================================================================================
+
+OSStatus    AES_CTR_UpdateV( AES_CTR_Context *inContext, const ring_buffer_span_t *inSpans, size_t inCount )
+{
+    OSStatus        err = kNoErr;
+    Boolean         legacy;
+    size_t          i;
+    
+    // Key material left over at the end of one span is used for the start of the next. Legacy mode only drops it 
+    // after the last span, the same as a single AES_CTR_Update over all of them.
+    
+    legacy = inContext->legacy;
+    inContext->legacy = false;
+    for( i = 0; i < inCount; ++i )
+    {
+        err = AES_CTR_Update( inContext, inSpans[ i ].data, inSpans[ i ].length, inSpans[ i ].data );
+        require_noerr( err, exit );
+    }
+    if( legacy ) inContext->used = 0;
+    
+exit:
+    inContext->legacy = legacy;
+    return( err );
+}
+
 //===========================================================================================================================
 //  AES_CTR_Final
 //===========================================================================================================================
@@ -856,6 +883,46 @@ exit:
     return( err );
 }
 #endif
+
+//===========================================================================================================================
+//  AES_GCM_EncryptV
+//===========================================================================================================================
+
+OSStatus    AES_GCM_EncryptV( AES_GCM_Context *inContext, const ring_buffer_span_t *inSpans, size_t inCount )
+{
+    OSStatus        err = kNoErr;
+    size_t          i;
+    
+    // GCM keeps its own partial block state, so spans can be any length and are encrypted where they are.
+    
+    for( i = 0; i < inCount; ++i )
+    {
+        err = AES_GCM_Encrypt( inContext, inSpans[ i ].data, inSpans[ i ].length, inSpans[ i ].data );
+        require_noerr( err, exit );
+    }
+    
+exit:
+    return( err );
+}
+
+//===========================================================================================================================
+//  AES_GCM_DecryptV
+//===========================================================================================================================
+
+OSStatus    AES_GCM_DecryptV( AES_GCM_Context *inContext, const ring_buffer_span_t *inSpans, size_t inCount )
+{
+    OSStatus        err = kNoErr;
+    size_t          i;
+    
+    for( i = 0; i < inCount; ++i )
+    {
+        err = AES_GCM_Decrypt( inContext, inSpans[ i ].data, inSpans[ i ].length, inSpans[ i ].data );
+        require_noerr( err, exit );
+    }
+    
+exit:
+    return( err );
+}
 #endif
 
 
@@ -27,7 +27,18 @@
 #include "Debug.h"
 
 #include "SecurityUtils.h"
-#define AES_UTILS_USE_MICO_AES 1
+#include "RingBufferUtils.h"
+
+// AES-CTR, CBC and ECB run on MicoCrypto unless the target builds GladmanAES and defines AES_UTILS_USE_GLADMAN_AES.
+// The Gladman table sizes are picked by AES_PROFILE, see aes_profile.h.
+
+#if( !defined( AES_UTILS_USE_GLADMAN_AES ) )
+    #define AES_UTILS_USE_GLADMAN_AES       0
+#endif
+
+#if( !defined( AES_UTILS_USE_MICO_AES ) )
+    #define AES_UTILS_USE_MICO_AES          ( !AES_UTILS_USE_GLADMAN_AES )
+#endif
 
 #if( !defined( AES_UTILS_HAS_GLADMAN_GCM ) )
 //    #if( __has_include( "gcm.h" ) )
@@ -50,7 +61,7 @@
 #if( AES_UTILS_USE_COMMON_CRYPTO )
     #include <CommonCrypto/CommonCryptor.h>
 #elif( AES_UTILS_USE_GLADMAN_AES )
-    #include "External/GladmanAES/aes.h"
+    #include "aes.h"
 #elif( AES_UTILS_USE_MICO_AES )
     #include "MICOAES.h"
 #elif( !TARGET_NO_OPENSSL )
@@ -118,6 +129,9 @@
     
     Call AES_CTR_Init to initialize the context. Don't use the context until it has been initialized.
     Call AES_CTR_Update to encrypt or decrypt N bytes of input and generate N bytes of output.
+    Call AES_CTR_UpdateV instead to encrypt or decrypt a list of spans in place (e.g. a header buffer followed by the 
+    two spans from spsc_ring_buffer_read_peek). The result is the same as one AES_CTR_Update over the concatenated 
+    spans, so spans don't need to be block-sized.
     Call AES_CTR_Final to finalize the context. After finalizing, you must call AES_CTR_Init to use it again.
     
 */
@@ -151,6 +165,7 @@ OSStatus
         const uint8_t       inKey[ kAES_CTR_Size ], 
         const uint8_t       inNonce[ kAES_CTR_Size ] );
 OSStatus    AES_CTR_Update( AES_CTR_Context *inContext, const void *inSrc, size_t inSrcLen, void *inDst );
+OSStatus    AES_CTR_UpdateV( AES_CTR_Context *inContext, const ring_buffer_span_t *inSpans, size_t inCount );
 void        AES_CTR_Final( AES_CTR_Context *inContext );
 
 #if 0
@@ -300,6 +315,7 @@ void        AES_ECB_Final( AES_ECB_Context *inContext );
         AES_GCM_InitMessage (provide per-message nonce or use kAES_CGM_Nonce_Auto to increment the nonce from AES_GCM_Init).
         AES_GCM_AddAAD (may repeat as many times as necessary to add each chunk of AAD).
         AES_GCM_Encrypt (may repeat as many times as necessary to add each chunk of data to encrypt).
+            or AES_GCM_EncryptV (encrypts a list of spans in place, same result as AES_GCM_Encrypt over their concatenation).
         AES_GCM_FinalizeMessage (outputs a auth tag to send along with the message so it can be verified by the receiver).
     
     The general flow for receiving a message:
@@ -307,6 +323,7 @@ void        AES_ECB_Final( AES_ECB_Context *inContext );
         AES_GCM_InitMessage (provide per-message nonce or use kAES_CGM_Nonce_Auto to increment the nonce from AES_GCM_Init).
         AES_GCM_AddAAD (may repeat as many times as necessary to add each chunk of AAD).
         AES_GCM_Decrypt (may repeat as many times as necessary to add each chunk of data to encrypt).
+            or AES_GCM_DecryptV (decrypts a list of spans in place, same result as AES_GCM_Decrypt over their concatenation).
         AES_GCM_VerifyMessage (if this fails, reject the message).
     
     See <http://en.wikipedia.org/wiki/Galois/Counter_Mode> for more information.
@@ -346,9 +363,25 @@ OSStatus    AES_GCM_VerifyMessage( AES_GCM_Context *inContext, const uint8_t inA
 OSStatus    AES_GCM_AddAAD( AES_GCM_Context *inContext, const void *inPtr, size_t inLen );
 OSStatus    AES_GCM_Encrypt( AES_GCM_Context *inContext, const void *inSrc, size_t inLen, void *inDst );
 OSStatus    AES_GCM_Decrypt( AES_GCM_Context *inContext, const void *inSrc, size_t inLen, void *inDst );
+OSStatus    AES_GCM_EncryptV( AES_GCM_Context *inContext, const ring_buffer_span_t *inSpans, size_t inCount );
+OSStatus    AES_GCM_DecryptV( AES_GCM_Context *inContext, const ring_buffer_span_t *inSpans, size_t inCount );
 
 #endif // AES_UTILS_HAS_GCM
 
+//---------------------------------------------------------------------------------------------------------------------------
+/*! @function   AESUtils_Bench
+    @abstract   Prints bytes/s and context size of AES_CTR_Update, AES_CBCFrame_Update and AES_GCM_Encrypt (if built).
+    @discussion Numbers are for the AES backend and AES_PROFILE this image is built with, see AESUtils_Bench.c.
+*/
+OSStatus    AESUtils_Bench( int inPrint );
+
+//---------------------------------------------------------------------------------------------------------------------------
+/*! @function   AESUtils_Test
+    @abstract   Checks the span calls (AES_CTR_UpdateV, AES_GCM_EncryptV/DecryptV) against the single buffer calls.
+    @discussion Returns kNoErr if every result matched, see AESUtils_Test.c.
+*/
+OSStatus    AESUtils_Test( int inPrint );
+
 #ifdef  __cplusplus
     }
 #endif
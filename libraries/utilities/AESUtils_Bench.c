@@ -0,0 +1,196 @@
+/**
+******************************************************************************
+* @file    AESUtils_Bench.c
+* @version V1.0.0
+* @date    17-Oct-2026
+* @brief   Throughput of the AESUtils modes for the AES backend and table
+*          profile the image is built with. Add this file to a project and
+*          call AESUtils_Bench() to compare AES_PROFILE settings on a board.
+******************************************************************************
+* @attention
+*
+* THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+* WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+* TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+* DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+* FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+* CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+*
+* <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+******************************************************************************
+*/
+
+#include "AESUtils.h"
+
+#include "Common.h"
+#include "Debug.h"
+
+#if( AES_UTILS_USE_GLADMAN_AES || AES_UTILS_HAS_GLADMAN_GCM )
+    #include "aes_profile.h"
+#endif
+
+#define kAESBench_BufferSize    1024    // Bytes per call, about one TLS or HomeKit frame.
+#define kAESBench_Time          1000    // Milliseconds spent on each mode.
+
+static const uint8_t        kAESBench_Key[ 16 ] =
+    { 0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c, 0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08 };
+static const uint8_t        kAESBench_IV[ 16 ] =
+    { 0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad, 0xde, 0xca, 0xf8, 0x88, 0x00, 0x00, 0x00, 0x01 };
+
+//===========================================================================================================================
+//  _AESBench_Rate
+//===========================================================================================================================
+
+static uint32_t _AESBench_Rate( uint64_t inBytes, uint32_t inMs )
+{
+    if( inMs == 0 ) inMs = 1;
+    return( (uint32_t)( ( inBytes * 1000 ) / inMs ) );
+}
+
+//===========================================================================================================================
+//  _AESBench_CTR
+//===========================================================================================================================
+
+static OSStatus _AESBench_CTR( uint8_t *inBuf, uint32_t *outRate )
+{
+    OSStatus            err;
+    AES_CTR_Context     ctx;
+    uint64_t            bytes = 0;
+    uint32_t            start, elapsed;
+    Boolean             initialized = false;
+
+    err = AES_CTR_Init( &ctx, kAESBench_Key, kAESBench_IV );
+    require_noerr( err, exit );
+    initialized = true;
+
+    start = mico_get_time();
+    do
+    {
+        err = AES_CTR_Update( &ctx, inBuf, kAESBench_BufferSize, inBuf );
+        require_noerr( err, exit );
+        bytes += kAESBench_BufferSize;
+        elapsed = mico_get_time() - start;
+    }   while( elapsed < kAESBench_Time );
+    *outRate = _AESBench_Rate( bytes, elapsed );
+
+exit:
+    if( initialized ) AES_CTR_Final( &ctx );
+    return( err );
+}
+
+//===========================================================================================================================
+//  _AESBench_CBCFrame
+//===========================================================================================================================
+
+static OSStatus _AESBench_CBCFrame( uint8_t *inBuf, uint32_t *outRate )
+{
+    OSStatus                err;
+    AES_CBCFrame_Context    ctx;
+    uint64_t                bytes = 0;
+    uint32_t                start, elapsed;
+    Boolean                 initialized = false;
+
+    err = AES_CBCFrame_Init( &ctx, kAESBench_Key, kAESBench_IV, true );
+    require_noerr( err, exit );
+    initialized = true;
+
+    start = mico_get_time();
+    do
+    {
+        err = AES_CBCFrame_Update( &ctx, inBuf, kAESBench_BufferSize, inBuf );
+        require_noerr( err, exit );
+        bytes += kAESBench_BufferSize;
+        elapsed = mico_get_time() - start;
+    }   while( elapsed < kAESBench_Time );
+    *outRate = _AESBench_Rate( bytes, elapsed );
+
+exit:
+    if( initialized ) AES_CBCFrame_Final( &ctx );
+    return( err );
+}
+
+//===========================================================================================================================
+//  _AESBench_GCM
+//===========================================================================================================================
+
+#if( AES_UTILS_HAS_GCM )
+static OSStatus _AESBench_GCM( uint8_t *inBuf, uint32_t *outRate )
+{
+    OSStatus            err;
+    AES_GCM_Context     ctx;
+    uint8_t             tag[ kAES_CGM_Size ];
+    uint64_t            bytes = 0;
+    uint32_t            start, elapsed;
+    Boolean             initialized = false;
+
+    err = AES_GCM_Init( &ctx, kAESBench_Key, kAESBench_IV );
+    require_noerr( err, exit );
+    initialized = true;
+
+    // Each buffer is sent as its own message, the way the frame based protocols use GCM.
+
+    start = mico_get_time();
+    do
+    {
+        err = AES_GCM_InitMessage( &ctx, kAES_CGM_Nonce_Auto );
+        require_noerr( err, exit );
+        err = AES_GCM_Encrypt( &ctx, inBuf, kAESBench_BufferSize, inBuf );
+        require_noerr( err, exit );
+        err = AES_GCM_FinalizeMessage( &ctx, tag );
+        require_noerr( err, exit );
+        bytes += kAESBench_BufferSize;
+        elapsed = mico_get_time() - start;
+    }   while( elapsed < kAESBench_Time );
+    *outRate = _AESBench_Rate( bytes, elapsed );
+
+exit:
+    if( initialized ) AES_GCM_Final( &ctx );
+    return( err );
+}
+#endif
+
+//===========================================================================================================================
+//  AESUtils_Bench
+//===========================================================================================================================
+
+OSStatus    AESUtils_Bench( int inPrint )
+{
+    OSStatus        err;
+    uint8_t *       buf;
+    uint32_t        rate;
+
+    buf = (uint8_t *) calloc( 1, kAESBench_BufferSize );
+    require_action( buf, exit, err = kNoMemoryErr );
+
+    if( inPrint )
+    {
+    #if( AES_UTILS_USE_GLADMAN_AES || AES_UTILS_HAS_GLADMAN_GCM )
+        printf( "GladmanAES profile %d: %d round tables, unroll %d, %d bytes GHASH table\r\n",
+            AES_PROFILE, AES_ROUND_TABLES, AES_UNROLL, GCM_TABLE_SIZE );
+    #endif
+        printf( "AES-CTR, CBC and ECB on %s\r\n", AES_UTILS_USE_GLADMAN_AES ? "GladmanAES" : "MicoCrypto" );
+    }
+
+    err = _AESBench_CTR( buf, &rate );
+    require_noerr( err, exit );
+    if( inPrint ) printf( "AES_CTR_Update      %9u bytes/s  %5u bytes context\r\n",
+        (unsigned int) rate, (unsigned int) sizeof( AES_CTR_Context ) );
+
+    err = _AESBench_CBCFrame( buf, &rate );
+    require_noerr( err, exit );
+    if( inPrint ) printf( "AES_CBCFrame_Update %9u bytes/s  %5u bytes context\r\n",
+        (unsigned int) rate, (unsigned int) sizeof( AES_CBCFrame_Context ) );
+
+#if( AES_UTILS_HAS_GCM )
+    err = _AESBench_GCM( buf, &rate );
+    require_noerr( err, exit );
+    if( inPrint ) printf( "AES_GCM_Encrypt     %9u bytes/s  %5u bytes context\r\n",
+        (unsigned int) rate, (unsigned int) sizeof( AES_GCM_Context ) );
+#else
+    if( inPrint ) printf( "AES_GCM_Encrypt     skipped, built without AES_UTILS_HAS_GLADMAN_GCM\r\n" );
+#endif
+
+exit:
+    if( buf ) free( buf );
+    return( err );
+}
@@ -0,0 +1,304 @@
+/**
+******************************************************************************
+* @file    AESUtils_Test.c
+* @version V1.0.0
+* @date    17-Oct-2026
+* @brief   Checks of AES_CTR_UpdateV, AES_GCM_EncryptV and AES_GCM_DecryptV
+*          against AES_CTR_Update, AES_GCM_Encrypt and AES_GCM_Decrypt over
+*          the same bytes in one buffer. Random frames are split into random
+*          spans, some of them empty, and one frame wraps round the end of an
+*          SPSC ring. Built on the host with GladmanAES and RingBufferUtils.c;
+*          not part of the default build.
+******************************************************************************
+* @attention
+*
+* THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+* WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+* TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+* DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+* FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+* CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+*
+* <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+******************************************************************************
+*/
+
+#include "AESUtils.h"
+
+#include "Common.h"
+#include "Debug.h"
+
+#define kAESTest_Frames         5000    // Random frames per mode.
+#define kAESTest_MaxLength      600     // Bytes per frame, up to a few blocks more than one MTU payload.
+#define kAESTest_MaxSpans       8
+#define kAESTest_TailLength     17      // Keystream read after a frame, not a whole block.
+
+static const uint8_t        kAESTest_Key[ 16 ] =
+    { 0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c, 0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08 };
+static const uint8_t        kAESTest_IV[ 16 ] =
+    { 0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad, 0xde, 0xca, 0xf8, 0x88, 0x00, 0x00, 0x00, 0x01 };
+static const uint8_t        kAESTest_AAD[] = { 0x00, 0x01, 0x02, 0x03, 0x04 };
+
+static uint32_t             gAESTest_Seed = 1;
+
+//===========================================================================================================================
+//  _AESTest_Random
+//===========================================================================================================================
+
+static uint32_t _AESTest_Random( uint32_t inLimit )
+{
+    gAESTest_Seed = gAESTest_Seed * 1103515245 + 12345;
+    return( ( gAESTest_Seed >> 8 ) % inLimit );
+}
+
+//===========================================================================================================================
+//  _AESTest_Split
+//
+//  Splits inLen bytes at inBuf into up to kAESTest_MaxSpans spans of random length, a quarter of them empty.
+//===========================================================================================================================
+
+static size_t _AESTest_Split( uint8_t *inBuf, size_t inLen, ring_buffer_span_t *outSpans )
+{
+    size_t      count = 0, pos = 0, len;
+
+    while( ( pos < inLen ) && ( count < kAESTest_MaxSpans - 1 ) )
+    {
+        len = _AESTest_Random( inLen - pos + 1 );
+        if( _AESTest_Random( 4 ) == 0 ) len = 0;
+        outSpans[ count ].data   = inBuf + pos;
+        outSpans[ count ].length = len;
+        pos += len;
+        ++count;
+    }
+    outSpans[ count ].data   = inBuf + pos;
+    outSpans[ count ].length = inLen - pos;
+    return( count + 1 );
+}
+
+//===========================================================================================================================
+//  _AESTest_CTR
+//
+//  One frame through AES_CTR_Update and through AES_CTR_UpdateV, after inSkip bytes of keystream so that it starts
+//  inside a block. The bytes must match and so must the keystream that follows.
+//===========================================================================================================================
+
+static OSStatus _AESTest_CTR( const uint8_t *inPlain, size_t inLen, size_t inSkip, Boolean inLegacy,
+                              uint8_t *inRef, uint8_t *inWork )
+{
+    OSStatus                err;
+    AES_CTR_Context         ref, work;
+    ring_buffer_span_t      spans[ kAESTest_MaxSpans ];
+    uint8_t                 skip[ kAES_CTR_Size ], refTail[ kAESTest_TailLength ], workTail[ kAESTest_TailLength ];
+    size_t                  count;
+
+    AES_CTR_Init( &ref, kAESTest_Key, kAESTest_IV );
+    AES_CTR_Init( &work, kAESTest_Key, kAESTest_IV );
+    ref.legacy  = inLegacy;
+    work.legacy = inLegacy;
+
+    memset( skip, 0, sizeof( skip ) );
+    err = AES_CTR_Update( &ref, skip, inSkip, skip );
+    require_noerr( err, exit );
+    err = AES_CTR_Update( &work, skip, inSkip, skip );
+    require_noerr( err, exit );
+
+    memcpy( inRef, inPlain, inLen );
+    err = AES_CTR_Update( &ref, inRef, inLen, inRef );
+    require_noerr( err, exit );
+    memcpy( inWork, inPlain, inLen );
+    count = _AESTest_Split( inWork, inLen, spans );
+    err = AES_CTR_UpdateV( &work, spans, count );
+    require_noerr( err, exit );
+    require_action( memcmp( inRef, inWork, inLen ) == 0, exit, err = kMismatchErr );
+
+    memset( refTail, 0, sizeof( refTail ) );
+    memset( workTail, 0, sizeof( workTail ) );
+    err = AES_CTR_Update( &ref, refTail, sizeof( refTail ), refTail );
+    require_noerr( err, exit );
+    err = AES_CTR_Update( &work, workTail, sizeof( workTail ), workTail );
+    require_noerr( err, exit );
+    require_action( memcmp( refTail, workTail, sizeof( refTail ) ) == 0, exit, err = kMismatchErr );
+    require_action( work.legacy == inLegacy, exit, err = kMismatchErr );
+
+exit:
+    AES_CTR_Final( &ref );
+    AES_CTR_Final( &work );
+    return( err );
+}
+
+#if( AES_UTILS_HAS_GCM )
+//===========================================================================================================================
+//  _AESTest_GCM
+//
+//  One message through AES_GCM_Encrypt and through AES_GCM_EncryptV: same ciphertext and tag. AES_GCM_DecryptV must
+//  give the plaintext back and verify, and must not verify once a byte of the ciphertext was changed.
+//===========================================================================================================================
+
+static OSStatus _AESTest_GCM( AES_GCM_Context *inContext, const uint8_t *inPlain, size_t inLen,
+                              uint8_t *inRef, uint8_t *inWork )
+{
+    OSStatus                err;
+    ring_buffer_span_t      spans[ kAESTest_MaxSpans ];
+    uint8_t                 refTag[ kAES_CGM_Size ], workTag[ kAES_CGM_Size ];
+    size_t                  count, pos;
+
+    err = AES_GCM_InitMessage( inContext, kAESTest_IV );
+    require_noerr( err, exit );
+    err = AES_GCM_AddAAD( inContext, kAESTest_AAD, sizeof( kAESTest_AAD ) );
+    require_noerr( err, exit );
+    memcpy( inRef, inPlain, inLen );
+    err = AES_GCM_Encrypt( inContext, inRef, inLen, inRef );
+    require_noerr( err, exit );
+    err = AES_GCM_FinalizeMessage( inContext, refTag );
+    require_noerr( err, exit );
+
+    err = AES_GCM_InitMessage( inContext, kAESTest_IV );
+    require_noerr( err, exit );
+    err = AES_GCM_AddAAD( inContext, kAESTest_AAD, sizeof( kAESTest_AAD ) );
+    require_noerr( err, exit );
+    memcpy( inWork, inPlain, inLen );
+    count = _AESTest_Split( inWork, inLen, spans );
+    err = AES_GCM_EncryptV( inContext, spans, count );
+    require_noerr( err, exit );
+    err = AES_GCM_FinalizeMessage( inContext, workTag );
+    require_noerr( err, exit );
+    require_action( memcmp( inRef, inWork, inLen ) == 0, exit, err = kMismatchErr );
+    require_action( memcmp( refTag, workTag, kAES_CGM_Size ) == 0, exit, err = kMismatchErr );
+
+    // Decrypt in place through a different split.
+
+    err = AES_GCM_InitMessage( inContext, kAESTest_IV );
+    require_noerr( err, exit );
+    err = AES_GCM_AddAAD( inContext, kAESTest_AAD, sizeof( kAESTest_AAD ) );
+    require_noerr( err, exit );
+    count = _AESTest_Split( inWork, inLen, spans );
+    err = AES_GCM_DecryptV( inContext, spans, count );
+    require_noerr( err, exit );
+    err = AES_GCM_VerifyMessage( inContext, refTag );
+    require_noerr( err, exit );
+    require_action( memcmp( inPlain, inWork, inLen ) == 0, exit, err = kMismatchErr );
+
+    if( inLen > 0 )
+    {
+        memcpy( inWork, inRef, inLen );
+        pos = _AESTest_Random( inLen );
+        inWork[ pos ] ^= 1 << _AESTest_Random( 8 );
+        err = AES_GCM_InitMessage( inContext, kAESTest_IV );
+        require_noerr( err, exit );
+        err = AES_GCM_AddAAD( inContext, kAESTest_AAD, sizeof( kAESTest_AAD ) );
+        require_noerr( err, exit );
+        count = _AESTest_Split( inWork, inLen, spans );
+        err = AES_GCM_DecryptV( inContext, spans, count );
+        require_noerr( err, exit );
+        require_action( AES_GCM_VerifyMessage( inContext, refTag ) != kNoErr, exit, err = kMismatchErr );
+    }
+
+exit:
+    return( err );
+}
+
+//===========================================================================================================================
+//  _AESTest_Ring
+//
+//  A frame that wraps round the end of an SPSC ring is encrypted straight from the two peeked spans.
+//===========================================================================================================================
+
+static OSStatus _AESTest_Ring( AES_GCM_Context *inContext, const uint8_t *inPlain, uint8_t *inRef, uint8_t *inWork )
+{
+    OSStatus                err;
+    spsc_ring_buffer_t      ring;
+    ring_buffer_span_t      spans[ 2 ];
+    uint8_t                 storage[ 256 ];
+    uint8_t                 refTag[ kAES_CGM_Size ], workTag[ kAES_CGM_Size ];
+    uint32_t                len;
+
+    err = spsc_ring_buffer_init( &ring, storage, sizeof( storage ) );
+    require_noerr( err, exit );
+    require_action( spsc_ring_buffer_write( &ring, inWork, 200 ) == 200, exit, err = kInternalErr );
+    require_action( spsc_ring_buffer_read( &ring, inWork, 200 ) == 200, exit, err = kInternalErr );
+    require_action( spsc_ring_buffer_write( &ring, inPlain, 150 ) == 150, exit, err = kInternalErr );
+
+    len = spsc_ring_buffer_read_peek( &ring, spans, 150 );
+    require_action( ( len == 150 ) && ( spans[ 0 ].length == 56 ) && ( spans[ 1 ].length == 94 ), exit, err = kInternalErr );
+    err = AES_GCM_InitMessage( inContext, kAESTest_IV );
+    require_noerr( err, exit );
+    err = AES_GCM_EncryptV( inContext, spans, 2 );
+    require_noerr( err, exit );
+    err = AES_GCM_FinalizeMessage( inContext, workTag );
+    require_noerr( err, exit );
+    spsc_ring_buffer_read_consume( &ring, len );
+
+    err = AES_GCM_InitMessage( inContext, kAESTest_IV );
+    require_noerr( err, exit );
+    memcpy( inRef, inPlain, 150 );
+    err = AES_GCM_Encrypt( inContext, inRef, 150, inRef );
+    require_noerr( err, exit );
+    err = AES_GCM_FinalizeMessage( inContext, refTag );
+    require_noerr( err, exit );
+
+    memcpy( inWork, spans[ 0 ].data, spans[ 0 ].length );
+    memcpy( inWork + spans[ 0 ].length, spans[ 1 ].data, spans[ 1 ].length );
+    require_action( memcmp( inRef, inWork, 150 ) == 0, exit, err = kMismatchErr );
+    require_action( memcmp( refTag, workTag, kAES_CGM_Size ) == 0, exit, err = kMismatchErr );
+
+exit:
+    return( err );
+}
+#endif
+
+//===========================================================================================================================
+//  AESUtils_Test
+//===========================================================================================================================
+
+OSStatus    AESUtils_Test( int inPrint )
+{
+    OSStatus            err;
+    uint8_t *           buf;
+    uint8_t *           plain;
+    uint8_t *           ref;
+    uint8_t *           work;
+    size_t              len, i;
+    int                 frame;
+#if( AES_UTILS_HAS_GCM )
+    AES_GCM_Context     gcm;
+    Boolean             gcmInited = false;
+#endif
+
+    buf = (uint8_t *) calloc( 3, kAESTest_MaxLength );
+    require_action( buf, exit, err = kNoMemoryErr );
+    plain = buf;
+    ref   = buf + kAESTest_MaxLength;
+    work  = buf + 2 * kAESTest_MaxLength;
+
+#if( AES_UTILS_HAS_GCM )
+    err = AES_GCM_Init( &gcm, kAESTest_Key, kAES_CGM_Nonce_None );
+    require_noerr( err, exit );
+    gcmInited = true;
+#endif
+
+    for( frame = 0; frame < kAESTest_Frames; ++frame )
+    {
+        len = _AESTest_Random( kAESTest_MaxLength + 1 );
+        for( i = 0; i < len; ++i ) plain[ i ] = (uint8_t) _AESTest_Random( 256 );
+
+        err = _AESTest_CTR( plain, len, _AESTest_Random( kAES_CTR_Size ), frame & 1, ref, work );
+        require_noerr_action( err, exit, if( inPrint ) printf( "AES_CTR_UpdateV: frame %d differs\r\n", frame ) );
+    #if( AES_UTILS_HAS_GCM )
+        err = _AESTest_GCM( &gcm, plain, len, ref, work );
+        require_noerr_action( err, exit, if( inPrint ) printf( "AES_GCM_EncryptV/DecryptV: frame %d differs\r\n", frame ) );
+    #endif
+    }
+
+#if( AES_UTILS_HAS_GCM )
+    err = _AESTest_Ring( &gcm, plain, ref, work );
+    require_noerr_action( err, exit, if( inPrint ) printf( "AES_GCM_EncryptV: wrapped ring frame differs\r\n" ) );
+#endif
+
+exit:
+#if( AES_UTILS_HAS_GCM )
+    if( gcmInited ) AES_GCM_Final( &gcm );
+#endif
+    if( buf ) free( buf );
+    if( inPrint ) printf( "AESUtils_Test: %s\r\n", ( err == kNoErr ) ? "PASSED" : "FAILED" );
+    return( err );
+}
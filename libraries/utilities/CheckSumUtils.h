@@ -25,6 +25,22 @@
 
 #include "Common.h"
 
+/**
+ * Number of 256-entry lookup tables used by the CRC8 and CRC16 engines,
+ * trading ROM for speed:
+ *   0 - bitwise, no tables (smallest code, ~8 loop iterations per byte)
+ *   1 - one table per CRC, one lookup per byte (CRC8: 256B, CRC16: 512B ROM)
+ *   4 - slice-by-4, one lookup per byte but 4 bytes per step (CRC8: 1KB, CRC16: 2KB ROM)
+ *   8 - slice-by-8, 8 bytes per step (CRC8: 2KB, CRC16: 4KB ROM)
+ * Results are identical for every setting.
+ */
+#ifndef CRC_TABLE_SLICES
+#define CRC_TABLE_SLICES  4
+#endif
+
+#if (CRC_TABLE_SLICES != 0) && (CRC_TABLE_SLICES != 1) && (CRC_TABLE_SLICES != 4) && (CRC_TABLE_SLICES != 8)
+#error "CRC_TABLE_SLICES must be 0, 1, 4 or 8"
+#endif
 
 
 /*********************  CRC8 MiCO Check **************************************
@@ -110,6 +126,16 @@ void CRC16_Update( CRC16_Context *inContext, const void *inSrc, size_t inLen );
 void CRC16_Final( CRC16_Context*inContext, uint16_t *outResult );
 
 
+/**
+ * @brief  Check the CRC8 and CRC16 engines against the bitwise reference and
+ *         measure them, see CheckSumUtils_Test.c.
+ *
+ * @param  print        print the throughput and the result if non-zero
+ * @retval              kNoErr, or kMismatchErr if a CRC differs
+ */
+OSStatus CheckSumUtils_Test( int print );
+
+
 #endif //__CheckSumUtils_h__
 
 
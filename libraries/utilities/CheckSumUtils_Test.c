@@ -0,0 +1,158 @@
+/**
+  ******************************************************************************
+  * @file    CheckSumUtils_Test.c
+  * @version V1.0.0
+  * @date    17-Oct-2026
+  * @brief   Checks the CRC8 and CRC16 table engines against the bitwise
+  *          reference and measures both, for the CRC_TABLE_SLICES setting
+  *          the file is built with. Built on the host, or on a target whose C
+  *          library implements clock(); not part of the default build.
+  ******************************************************************************
+  * @attention
+  *
+  * THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+  * WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+  * TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+  * DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+  * FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+  * CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+  *
+  * <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+  ******************************************************************************
+  */
+
+#include "CheckSumUtils.h"
+#include <time.h>
+
+#define CRC_TEST_BUFFER_SIZE    1024    /* Bytes per update in the benchmark */
+#define CRC_TEST_MAX_LENGTH     64      /* Lengths checked at each alignment */
+#define CRC_TEST_SECONDS        1       /* Time spent on each measurement */
+
+uint8_t UpdateCRC8( uint8_t crcIn, uint8_t byte );
+uint16_t UpdateCRC16( uint16_t crcIn, uint8_t byte );
+
+static uint8_t crc8_reference( const uint8_t *src, size_t len )
+{
+  uint8_t crc = 0;
+
+  while( len-- )
+    crc = UpdateCRC8( crc, *src++ );
+  return crc;
+}
+
+static uint16_t crc16_reference( const uint8_t *src, size_t len )
+{
+  uint16_t crc = 0;
+
+  while( len-- )
+    crc = UpdateCRC16( crc, *src++ );
+  crc = UpdateCRC16( crc, 0 );
+  return UpdateCRC16( crc, 0 );
+}
+
+/* One message at a given alignment, in one update and split in two */
+static OSStatus crc_check( const uint8_t *src, size_t len, size_t split )
+{
+  CRC8_Context crc8;
+  CRC16_Context crc16;
+  uint8_t result8;
+  uint16_t result16;
+
+  CRC8_Init( &crc8 );
+  CRC8_Update( &crc8, src, len );
+  CRC8_Final( &crc8, &result8 );
+  if( result8 != crc8_reference( src, len ) ) return kMismatchErr;
+
+  CRC8_Init( &crc8 );
+  CRC8_Update( &crc8, src, split );
+  CRC8_Update( &crc8, src + split, len - split );
+  CRC8_Final( &crc8, &result8 );
+  if( result8 != crc8_reference( src, len ) ) return kMismatchErr;
+
+  CRC16_Init( &crc16 );
+  CRC16_Update( &crc16, src, len );
+  CRC16_Final( &crc16, &result16 );
+  if( result16 != crc16_reference( src, len ) ) return kMismatchErr;
+
+  CRC16_Init( &crc16 );
+  CRC16_Update( &crc16, src, split );
+  CRC16_Update( &crc16, src + split, len - split );
+  CRC16_Final( &crc16, &result16 );
+  if( result16 != crc16_reference( src, len ) ) return kMismatchErr;
+
+  return kNoErr;
+}
+
+/* Bytes per second of CRC16_Update, or of the bitwise reference */
+static unsigned long crc_rate( const uint8_t *buf, bool reference )
+{
+  CRC16_Context crc16;
+  unsigned long bytes = 0;
+  clock_t start = clock( ), elapsed;
+  uint16_t crc = 0;
+  size_t i;
+
+  CRC16_Init( &crc16 );
+  do {
+    if( reference ) {
+      for( i = 0; i < CRC_TEST_BUFFER_SIZE; i++ )
+        crc = UpdateCRC16( crc, buf[i] );
+    } else {
+      CRC16_Update( &crc16, buf, CRC_TEST_BUFFER_SIZE );
+    }
+    bytes += CRC_TEST_BUFFER_SIZE;
+    elapsed = clock( ) - start;
+  } while( elapsed < CRC_TEST_SECONDS * CLOCKS_PER_SEC );
+
+  CRC16_Final( &crc16, &crc );
+  return (unsigned long)( (double)bytes * CLOCKS_PER_SEC / elapsed );
+}
+
+OSStatus CheckSumUtils_Test( int print )
+{
+  static const uint8_t check[] = "123456789";
+  static uint8_t buf[CRC_TEST_BUFFER_SIZE + 8];
+  CRC8_Context crc8;
+  CRC16_Context crc16;
+  uint8_t result8;
+  uint16_t result16;
+  uint32_t seed = 1;
+  size_t i, offset, len;
+  OSStatus err = kNoErr;
+
+  /* Catalogue check values: CRC-8/MAXIM (the reflected 0x31) and CRC-16/XMODEM */
+  CRC8_Init( &crc8 );
+  CRC8_Update( &crc8, check, 9 );
+  CRC8_Final( &crc8, &result8 );
+  CRC16_Init( &crc16 );
+  CRC16_Update( &crc16, check, 9 );
+  CRC16_Final( &crc16, &result16 );
+  if( result8 != 0xA1 || result16 != 0x31C3 ) {
+    err = kMismatchErr;
+    goto exit;
+  }
+
+  for( i = 0; i < sizeof(buf); i++ ) {
+    seed = seed * 1103515245 + 12345;
+    buf[i] = (uint8_t)( seed >> 16 );
+  }
+
+  /* Every alignment, lengths across the word and slice boundaries */
+  for( offset = 0; offset < 8; offset++ ) {
+    for( len = 0; len <= CRC_TEST_MAX_LENGTH; len++ ) {
+      err = crc_check( buf + offset, len, len / 3 );
+      if( err != kNoErr ) goto exit;
+    }
+    err = crc_check( buf + offset, CRC_TEST_BUFFER_SIZE, CRC_TEST_BUFFER_SIZE / 2 + 1 );
+    if( err != kNoErr ) goto exit;
+  }
+
+  if( print ) {
+    printf( "CRC16, %d table slices: %lu bytes/s, bitwise %lu bytes/s\r\n", CRC_TABLE_SLICES,
+            crc_rate( buf, false ), crc_rate( buf, true ) );
+  }
+
+exit:
+  if( print ) printf( "CheckSumUtils_Test: %s\r\n", err == kNoErr ? "PASSED" : "FAILED" );
+  return err;
+}
@@ -26,6 +26,18 @@
 #define ring_buffer_utils_log(M, ...) custom_log("RingBufferUtils", M, ##__VA_ARGS__)
 #define ring_buffer_utils_log_trace() custom_log_trace("RingBufferUtils")
 
+/* Orders buffer accesses against head/tail updates between ISR and thread */
+#if defined ( __GNUC__ )
+#define ring_buffer_barrier()  __sync_synchronize()
+#elif defined ( __ICCARM__ )
+#include <intrinsics.h>
+#define ring_buffer_barrier()  __DMB()
+#elif defined ( __CC_ARM ) //KEIL
+#define ring_buffer_barrier()  __dmb(0xF)
+#else
+#define ring_buffer_barrier()
+#endif
+
 OSStatus ring_buffer_init( ring_buffer_t* ring_buffer, uint8_t* buffer, uint32_t size )
 {
     ring_buffer->buffer     = (uint8_t*)buffer;
@@ -90,3 +102,99 @@ uint32_t ring_buffer_write( ring_buffer_t* ring_buffer, const uint8_t* data, uin
   
   return amount_to_copy;
 }
+
+
+/*****************  Single-producer/single-consumer ring buffer  ****************/
+
+OSStatus spsc_ring_buffer_init( spsc_ring_buffer_t* ring_buffer, uint8_t* buffer, uint32_t size )
+{
+  if ( buffer == NULL || size == 0 || ( size & ( size - 1 ) ) != 0 || size > 0x80000000UL )
+    return kParamErr;
+
+  ring_buffer->buffer     = buffer;
+  ring_buffer->size       = size;
+  ring_buffer->mask       = size - 1;
+  ring_buffer->head       = 0;
+  ring_buffer->tail       = 0;
+  return kNoErr;
+}
+
+uint32_t spsc_ring_buffer_used_space( spsc_ring_buffer_t* ring_buffer )
+{
+  return ring_buffer->tail - ring_buffer->head;
+}
+
+uint32_t spsc_ring_buffer_free_space( spsc_ring_buffer_t* ring_buffer )
+{
+  return ring_buffer->size - ( ring_buffer->tail - ring_buffer->head );
+}
+
+/* Split [offset, offset + length) of the buffer into at most two spans */
+static uint32_t spsc_ring_buffer_fill_spans( spsc_ring_buffer_t* ring_buffer, ring_buffer_span_t spans[2], uint32_t offset, uint32_t length )
+{
+  uint32_t to_end = ring_buffer->size - offset;
+
+  spans[0].data   = &ring_buffer->buffer[offset];
+  spans[0].length = MIN( length, to_end );
+  spans[1].data   = ring_buffer->buffer;
+  spans[1].length = length - spans[0].length;
+  return length;
+}
+
+uint32_t spsc_ring_buffer_write_reserve( spsc_ring_buffer_t* ring_buffer, ring_buffer_span_t spans[2], uint32_t max_length )
+{
+  uint32_t tail = ring_buffer->tail;
+  /* Acquire: the consumer has finished reading everything before head */
+  uint32_t head = ring_buffer->head;
+  ring_buffer_barrier();
+
+  return spsc_ring_buffer_fill_spans( ring_buffer, spans, tail & ring_buffer->mask,
+                                      MIN( max_length, ring_buffer->size - ( tail - head ) ) );
+}
+
+void spsc_ring_buffer_write_commit( spsc_ring_buffer_t* ring_buffer, uint32_t length )
+{
+  /* Release: data must be visible before the consumer sees the new tail */
+  ring_buffer_barrier();
+  ring_buffer->tail = ring_buffer->tail + length;
+}
+
+uint32_t spsc_ring_buffer_read_peek( spsc_ring_buffer_t* ring_buffer, ring_buffer_span_t spans[2], uint32_t max_length )
+{
+  uint32_t head = ring_buffer->head;
+  /* Acquire: data written before tail was published is visible after this */
+  uint32_t tail = ring_buffer->tail;
+  ring_buffer_barrier();
+
+  return spsc_ring_buffer_fill_spans( ring_buffer, spans, head & ring_buffer->mask,
+                                      MIN( max_length, tail - head ) );
+}
+
+void spsc_ring_buffer_read_consume( spsc_ring_buffer_t* ring_buffer, uint32_t length )
+{
+  /* Release: finish reading before the producer may overwrite the space */
+  ring_buffer_barrier();
+  ring_buffer->head = ring_buffer->head + length;
+}
+
+uint32_t spsc_ring_buffer_write( spsc_ring_buffer_t* ring_buffer, const uint8_t* data, uint32_t data_length )
+{
+  ring_buffer_span_t spans[2];
+  uint32_t amount_to_copy = spsc_ring_buffer_write_reserve( ring_buffer, spans, data_length );
+
+  memcpy( spans[0].data, data, spans[0].length );
+  memcpy( spans[1].data, data + spans[0].length, spans[1].length );
+  spsc_ring_buffer_write_commit( ring_buffer, amount_to_copy );
+  return amount_to_copy;
+}
+
+uint32_t spsc_ring_buffer_read( spsc_ring_buffer_t* ring_buffer, uint8_t* data, uint32_t data_length )
+{
+  ring_buffer_span_t spans[2];
+  uint32_t amount_to_copy = spsc_ring_buffer_read_peek( ring_buffer, spans, data_length );
+
+  memcpy( data, spans[0].data, spans[0].length );
+  memcpy( data + spans[0].length, spans[1].data, spans[1].length );
+  spsc_ring_buffer_read_consume( ring_buffer, amount_to_copy );
+  return amount_to_copy;
+}
@@ -51,6 +51,91 @@ uint8_t ring_buffer_consume( ring_buffer_t* ring_buffer, uint32_t bytes_consumed
 
 uint32_t ring_buffer_write( ring_buffer_t* ring_buffer, const uint8_t* data, uint32_t data_length );
 
+
+/*****************  Single-producer/single-consumer ring buffer  ****************
+
+  Lock-free variant for one writer (e.g. a UART ISR or DMA completion) and one
+  reader (a thread). head and tail are free-running counters that are masked
+  into the buffer, so the size must be a power of two and every byte of the
+  buffer is usable. Only the producer writes tail and only the consumer writes
+  head; the data accesses are ordered against them with memory barriers.
+
+  Data is moved without extra copies through spans: reserve/commit on the
+  write side and peek/consume on the read side. A span set has at most two
+  entries, the second one exists only when the region wraps round the end.
+
+*******************************************************************************/
+
+typedef struct
+{
+  uint8_t*  data;
+  uint32_t  length;
+} ring_buffer_span_t;
+
+typedef struct
+{
+  uint32_t           size;
+  uint32_t           mask;
+  volatile uint32_t  head;
+  volatile uint32_t  tail;
+  uint8_t*           buffer;
+} spsc_ring_buffer_t;
+
+/**
+ * @brief  Initialize a SPSC ring buffer.
+ * @param  ring_buffer  ring buffer to be initialized
+ * @param  buffer       storage, size bytes long
+ * @param  size         storage size, must be a power of two
+ * @retval kNoErr on success, kParamErr if size is not a power of two.
+ */
+OSStatus spsc_ring_buffer_init( spsc_ring_buffer_t* ring_buffer, uint8_t* buffer, uint32_t size );
+
+uint32_t spsc_ring_buffer_free_space( spsc_ring_buffer_t* ring_buffer );
+
+uint32_t spsc_ring_buffer_used_space( spsc_ring_buffer_t* ring_buffer );
+
+/**
+ * @brief  Producer: get the free region of the buffer without copying.
+ * @param  ring_buffer  ring buffer
+ * @param  spans        two spans to receive the free region, unused spans get length 0
+ * @param  max_length   upper limit of bytes to reserve
+ * @retval Total bytes described by spans.
+ */
+uint32_t spsc_ring_buffer_write_reserve( spsc_ring_buffer_t* ring_buffer, ring_buffer_span_t spans[2], uint32_t max_length );
+
+/**
+ * @brief  Producer: publish bytes filled into the spans from spsc_ring_buffer_write_reserve.
+ * @param  ring_buffer  ring buffer
+ * @param  length       bytes to publish, not more than was reserved
+ * @retval None
+ */
+void spsc_ring_buffer_write_commit( spsc_ring_buffer_t* ring_buffer, uint32_t length );
+
+/**
+ * @brief  Consumer: get the readable region of the buffer without copying.
+ * @param  ring_buffer  ring buffer
+ * @param  spans        two spans to receive the readable region, unused spans get length 0
+ * @param  max_length   upper limit of bytes to peek
+ * @retval Total bytes described by spans.
+ */
+uint32_t spsc_ring_buffer_read_peek( spsc_ring_buffer_t* ring_buffer, ring_buffer_span_t spans[2], uint32_t max_length );
+
+/**
+ * @brief  Consumer: release bytes returned by spsc_ring_buffer_read_peek.
+ * @param  ring_buffer  ring buffer
+ * @param  length       bytes to release, not more than was peeked
+ * @retval None
+ */
+void spsc_ring_buffer_read_consume( spsc_ring_buffer_t* ring_buffer, uint32_t length );
+
+/* Copying helpers built on the span API, return the number of bytes moved */
+uint32_t spsc_ring_buffer_write( spsc_ring_buffer_t* ring_buffer, const uint8_t* data, uint32_t data_length );
+
+uint32_t spsc_ring_buffer_read( spsc_ring_buffer_t* ring_buffer, uint8_t* data, uint32_t data_length );
+
+/* Producer/consumer stress test and throughput, see RingBufferUtils_Test.c */
+OSStatus RingBufferUtils_Test( int print );
+
 #endif // __RingBufferUtils_h__
 
 
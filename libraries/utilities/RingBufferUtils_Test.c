@@ -0,0 +1,187 @@
+/**
+******************************************************************************
+* @file    RingBufferUtils_Test.c
+* @version V1.0.0
+* @date    17-Oct-2026
+* @brief   Stress test and throughput of the SPSC ring buffer: a producer
+*          thread and a consumer thread move sequenced data through it, with
+*          the span API and with the copying helpers. Built on the host with
+*          pthreads; not part of the default build.
+******************************************************************************
+* @attention
+*
+* THE PRESENT FIRMWARE WHICH IS FOR GUIDANCE ONLY AIMS AT PROVIDING CUSTOMERS
+* WITH CODING INFORMATION REGARDING THEIR PRODUCTS IN ORDER FOR THEM TO SAVE
+* TIME. AS A RESULT, MXCHIP Inc. SHALL NOT BE HELD LIABLE FOR ANY
+* DIRECT, INDIRECT OR CONSEQUENTIAL DAMAGES WITH RESPECT TO ANY CLAIMS ARISING
+* FROM THE CONTENT OF SUCH FIRMWARE AND/OR THE USE MADE BY CUSTOMERS OF THE
+* CODING INFORMATION CONTAINED HEREIN IN CONNECTION WITH THEIR PRODUCTS.
+*
+* <h2><center>&copy; COPYRIGHT 2014 MXCHIP Inc.</center></h2>
+******************************************************************************
+*/
+
+#include "RingBufferUtils.h"
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#define RING_TEST_BUFFER_SIZE   1024                /* Must be a power of two */
+#define RING_TEST_BYTES         ( 16 * 1024 * 1024 ) /* Moved in each run */
+#define RING_TEST_CHUNK         256                 /* Bytes per call in the single thread benchmark */
+
+typedef struct
+{
+  spsc_ring_buffer_t  ring;
+  bool                spans;    /* Span API, or the copying helpers */
+} ring_test_t;
+
+/* Byte n of the stream, so that lost, repeated or reordered bytes show */
+static uint8_t ring_test_byte( uint32_t n )
+{
+  return (uint8_t)( ( n * 7 ) ^ ( n >> 8 ) );
+}
+
+/* Request sizes vary with the position, so the spans wrap at every offset */
+static uint32_t ring_test_length( uint32_t n, uint32_t modulo )
+{
+  return ( n * 2654435761u >> 20 ) % modulo + 1;
+}
+
+static double ring_test_seconds( const struct timespec *start )
+{
+  struct timespec now;
+
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  return ( now.tv_sec - start->tv_sec ) + ( now.tv_nsec - start->tv_nsec ) / 1e9;
+}
+
+static void *ring_test_producer( void *arg )
+{
+  ring_test_t *test = arg;
+  ring_buffer_span_t spans[2];
+  uint8_t chunk[RING_TEST_BUFFER_SIZE];
+  uint32_t n = 0, length, i, k;
+
+  while( n < RING_TEST_BYTES ) {
+    length = MIN( ring_test_length( n, 300 ), RING_TEST_BYTES - n );
+    if( test->spans ) {
+      length = spsc_ring_buffer_write_reserve( &test->ring, spans, length );
+      for( k = 0; k < 2; k++ )
+        for( i = 0; i < spans[k].length; i++ )
+          spans[k].data[i] = ring_test_byte( n++ );
+      if( length ) spsc_ring_buffer_write_commit( &test->ring, length );
+    } else {
+      for( i = 0; i < length; i++ )
+        chunk[i] = ring_test_byte( n + i );
+      length = spsc_ring_buffer_write( &test->ring, chunk, length );
+      n += length;
+    }
+    if( !length ) sched_yield( );
+  }
+  return NULL;
+}
+
+/* Consumer side of one run, returns kNoErr if every byte came in order */
+static OSStatus ring_test_consumer( ring_test_t *test )
+{
+  ring_buffer_span_t spans[2];
+  uint8_t chunk[RING_TEST_BUFFER_SIZE];
+  uint32_t n = 0, length, i, k;
+
+  while( n < RING_TEST_BYTES ) {
+    length = ring_test_length( n, 200 );
+    if( test->spans ) {
+      length = spsc_ring_buffer_read_peek( &test->ring, spans, length );
+      for( k = 0; k < 2; k++ )
+        for( i = 0; i < spans[k].length; i++ )
+          if( spans[k].data[i] != ring_test_byte( n++ ) ) return kMismatchErr;
+      if( length ) spsc_ring_buffer_read_consume( &test->ring, length );
+    } else {
+      length = spsc_ring_buffer_read( &test->ring, chunk, length );
+      for( i = 0; i < length; i++ )
+        if( chunk[i] != ring_test_byte( n++ ) ) return kMismatchErr;
+    }
+    if( !length ) sched_yield( );
+  }
+  return spsc_ring_buffer_used_space( &test->ring ) == 0 ? kNoErr : kOverrunErr;
+}
+
+static OSStatus ring_test_run( bool spans, int print )
+{
+  static uint8_t storage[RING_TEST_BUFFER_SIZE];
+  ring_test_t test;
+  pthread_t producer;
+  struct timespec start;
+  OSStatus err;
+
+  test.spans = spans;
+  err = spsc_ring_buffer_init( &test.ring, storage, sizeof(storage) );
+  if( err != kNoErr ) return err;
+
+  clock_gettime( CLOCK_MONOTONIC, &start );
+  if( pthread_create( &producer, NULL, ring_test_producer, &test ) != 0 ) return kNoResourcesErr;
+  err = ring_test_consumer( &test );
+  pthread_join( producer, NULL );
+
+  if( print && err == kNoErr )
+    printf( "SPSC, two threads, %s: %.0f bytes/s\r\n", spans ? "spans" : "copies",
+            RING_TEST_BYTES / ring_test_seconds( &start ) );
+  return err;
+}
+
+/* One thread writing and reading RING_TEST_CHUNK at a time: the cost of the
+   calls without contention, against ring_buffer_t */
+static void ring_test_bench( void )
+{
+  static uint8_t storage[RING_TEST_BUFFER_SIZE];
+  uint8_t chunk[RING_TEST_CHUNK], *data;
+  ring_buffer_t ring;
+  spsc_ring_buffer_t spsc;
+  struct timespec start;
+  uint32_t n, got, contiguous;
+
+  memset( chunk, 0x5A, sizeof(chunk) );
+
+  ring_buffer_init( &ring, storage, sizeof(storage) );
+  clock_gettime( CLOCK_MONOTONIC, &start );
+  for( n = 0; n < RING_TEST_BYTES; n += RING_TEST_CHUNK ) {
+    ring_buffer_write( &ring, chunk, RING_TEST_CHUNK );
+    for( got = 0; got < RING_TEST_CHUNK; got += contiguous ) {
+      ring_buffer_get_data( &ring, &data, &contiguous );
+      contiguous = MIN( contiguous, RING_TEST_CHUNK - got );
+      memcpy( chunk + got, data, contiguous );
+      ring_buffer_consume( &ring, contiguous );
+    }
+  }
+  printf( "ring_buffer_t, one thread:  %.0f bytes/s\r\n", RING_TEST_BYTES / ring_test_seconds( &start ) );
+
+  spsc_ring_buffer_init( &spsc, storage, sizeof(storage) );
+  clock_gettime( CLOCK_MONOTONIC, &start );
+  for( n = 0; n < RING_TEST_BYTES; n += RING_TEST_CHUNK ) {
+    spsc_ring_buffer_write( &spsc, chunk, RING_TEST_CHUNK );
+    spsc_ring_buffer_read( &spsc, chunk, RING_TEST_CHUNK );
+  }
+  printf( "SPSC copies, one thread:    %.0f bytes/s\r\n", RING_TEST_BYTES / ring_test_seconds( &start ) );
+}
+
+OSStatus RingBufferUtils_Test( int print )
+{
+  static uint8_t storage[RING_TEST_BUFFER_SIZE];
+  spsc_ring_buffer_t ring;
+  OSStatus err;
+
+  err = ( spsc_ring_buffer_init( &ring, storage, 1000 ) == kParamErr ) ? kNoErr : kParamErr;
+  if( err != kNoErr ) goto exit;
+
+  err = ring_test_run( true, print );
+  if( err != kNoErr ) goto exit;
+  err = ring_test_run( false, print );
+  if( err != kNoErr ) goto exit;
+
+  if( print ) ring_test_bench( );
+
+exit:
+  if( print ) printf( "RingBufferUtils_Test: %s\r\n", err == kNoErr ? "PASSED" : "FAILED" );
+  return err;
+}
@@ -20,17 +20,23 @@ extern "C" {
 
 typedef void (array_list_free_fn) (void *data);
 
+struct json_arena;
+
 struct array_list
 {
   void **array;
   int length;
   int size;
   array_list_free_fn *free_fn;
+  struct json_arena *arena;
 };
 
 extern struct array_list*
 array_list_new(array_list_free_fn *free_fn);
 
+extern struct array_list*
+array_list_new_in(struct json_arena *arena, array_list_free_fn *free_fn);
+
 extern void
 array_list_free(struct array_list *al);
 
@@ -20,9 +20,12 @@ extern "C" {
 #include "debug.h"
 #include "linkhash.h"
 #include "arraylist.h"
+#include "json_arena.h"
 #include "json_util.h"
 #include "json_object.h"
 #include "json_tokener.h"
+#include "json_writer.h"
+#include "json_pull.h"
 
 #ifdef __cplusplus
 }
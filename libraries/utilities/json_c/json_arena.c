@@ -0,0 +1,220 @@
+/*
+ * Per-document arena allocator for json_object trees.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "json_arena.h"
+
+#include "StringUtils.h"
+
+#define JSON_ARENA_ROUND(x) \
+  (((x) + JSON_ARENA_ALIGN - 1) & ~((size_t)JSON_ARENA_ALIGN - 1))
+#define JSON_ARENA_BLOCK_HDR JSON_ARENA_ROUND(sizeof(struct json_arena_block))
+#define JSON_ARENA_HDR JSON_ARENA_ROUND(sizeof(struct json_arena))
+#define JSON_ARENA_BLOCK_DATA(b) ((char*)(b) + JSON_ARENA_BLOCK_HDR)
+
+static struct json_arena_stats json_arena_last_stats;
+static struct json_arena_stats json_arena_max_stats;
+
+struct json_arena* json_arena_new(size_t block_size)
+{
+  struct json_arena *arena;
+  struct json_arena_block *b;
+
+  if(!block_size) block_size = JSON_ARENA_DEFAULT_BLOCK_SIZE;
+  block_size = JSON_ARENA_ROUND(block_size);
+
+  /* The arena header and its first block share one heap allocation */
+  arena = (struct json_arena*)malloc(JSON_ARENA_HDR + JSON_ARENA_BLOCK_HDR + block_size);
+  if(!arena) return NULL;
+  memset(arena, 0, sizeof(struct json_arena));
+  b = (struct json_arena_block*)((char*)arena + JSON_ARENA_HDR);
+  b->next = NULL;
+  b->size = block_size;
+  b->used = 0;
+  arena->blocks = b;
+  arena->block_size = block_size;
+  arena->reserved = JSON_ARENA_HDR + JSON_ARENA_BLOCK_HDR + block_size;
+  arena->block_count = 1;
+  return arena;
+}
+
+void json_arena_free(struct json_arena *arena)
+{
+  struct json_arena_block *b, *next;
+  struct json_arena_cleanup *c;
+  struct json_arena_stats stats;
+
+  if(!arena) return;
+
+  /* Cleanups may put objects that live in other arenas, never this one */
+  arena->root = NULL;
+  for(c = arena->cleanups; c != NULL; c = c->next)
+    c->fn(c->ptr);
+
+  json_arena_get_stats(arena, &stats);
+  MC_DEBUG("json_arena_free: %lu bytes used, %lu reserved in %u blocks\n",
+	   (unsigned long)stats.used, (unsigned long)stats.reserved, stats.blocks);
+  json_arena_last_stats = stats;
+  if(stats.reserved > json_arena_max_stats.reserved)
+    json_arena_max_stats = stats;
+
+  /* The first block is freed with the header */
+  for(b = arena->blocks; b != NULL; b = next) {
+    next = b->next;
+    if((char*)b != (char*)arena + JSON_ARENA_HDR) free(b);
+  }
+  free(arena);
+}
+
+static struct json_arena_block* json_arena_add_block(struct json_arena *arena,
+						      size_t size)
+{
+  struct json_arena_block *b;
+
+  if(size < arena->block_size) size = arena->block_size;
+  b = (struct json_arena_block*)malloc(JSON_ARENA_BLOCK_HDR + size);
+  if(!b) return NULL;
+  b->size = size;
+  b->used = 0;
+  if(size > arena->block_size) {
+    /* Oversized request, keep allocating from the current block afterwards */
+    b->next = arena->blocks->next;
+    arena->blocks->next = b;
+  } else {
+    b->next = arena->blocks;
+    arena->blocks = b;
+  }
+  arena->reserved += JSON_ARENA_BLOCK_HDR + size;
+  arena->block_count++;
+  return b;
+}
+
+void* json_arena_alloc(struct json_arena *arena, size_t size)
+{
+  struct json_arena_block *b;
+  void *p;
+
+  if(!arena) return malloc(size);
+
+  size = JSON_ARENA_ROUND(size ? size : 1);
+  b = arena->blocks;
+  if(b->size - b->used < size) {
+    if(!(b = json_arena_add_block(arena, size))) return NULL;
+  }
+  p = JSON_ARENA_BLOCK_DATA(b) + b->used;
+  b->used += size;
+  arena->used += size;
+  return p;
+}
+
+void* json_arena_calloc(struct json_arena *arena, size_t nmemb, size_t size)
+{
+  void *p;
+
+  if(!arena) return calloc(nmemb, size);
+  if(!(p = json_arena_alloc(arena, nmemb * size))) return NULL;
+  memset(p, 0, nmemb * size);
+  return p;
+}
+
+void* json_arena_realloc(struct json_arena *arena, void *ptr,
+			 size_t old_size, size_t new_size)
+{
+  struct json_arena_block *b;
+  size_t old_round, new_round;
+  void *p;
+
+  if(!arena) return realloc(ptr, new_size);
+  if(!ptr) return json_arena_alloc(arena, new_size);
+
+  old_round = JSON_ARENA_ROUND(old_size ? old_size : 1);
+  new_round = JSON_ARENA_ROUND(new_size ? new_size : 1);
+  if(new_round <= old_round) return ptr;
+
+  /* Grow in place when ptr is the most recent allocation of the block */
+  b = arena->blocks;
+  if((char*)ptr + old_round == JSON_ARENA_BLOCK_DATA(b) + b->used &&
+     b->size - b->used >= new_round - old_round) {
+    b->used += new_round - old_round;
+    arena->used += new_round - old_round;
+    return ptr;
+  }
+
+  if(!(p = json_arena_alloc(arena, new_size))) return NULL;
+  memcpy(p, ptr, old_size);
+  return p;
+}
+
+char* json_arena_strdup(struct json_arena *arena, const char *str)
+{
+  if(!arena) return strdup(str);
+  return json_arena_memdup(arena, str, strlen(str));
+}
+
+char* json_arena_memdup(struct json_arena *arena, const char *str, size_t len)
+{
+  char *p;
+
+  if(!(p = (char*)json_arena_alloc(arena, len + 1))) return NULL;
+  memcpy(p, str, len);
+  p[len] = '\0';
+  return p;
+}
+
+void json_arena_release(struct json_arena *arena, void *ptr)
+{
+  if(!arena) free(ptr);
+}
+
+int json_arena_add_cleanup(struct json_arena *arena,
+			   json_arena_cleanup_fn *fn, void *ptr)
+{
+  struct json_arena_cleanup *c;
+
+  c = (struct json_arena_cleanup*)json_arena_alloc(arena, sizeof(struct json_arena_cleanup));
+  if(!c) return -1;
+  c->fn = fn;
+  c->ptr = ptr;
+  c->next = arena->cleanups;
+  arena->cleanups = c;
+  return 0;
+}
+
+int json_arena_remove_cleanup(struct json_arena *arena,
+			      json_arena_cleanup_fn *fn, void *ptr)
+{
+  struct json_arena_cleanup **pc;
+
+  for(pc = &arena->cleanups; *pc != NULL; pc = &(*pc)->next) {
+    if((*pc)->fn == fn && (*pc)->ptr == ptr) {
+      *pc = (*pc)->next;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+void json_arena_get_stats(struct json_arena *arena,
+			  struct json_arena_stats *stats)
+{
+  stats->used = arena->used;
+  stats->reserved = arena->reserved;
+  stats->blocks = arena->block_count;
+}
+
+void json_arena_get_released_stats(struct json_arena_stats *last,
+				   struct json_arena_stats *max)
+{
+  if(last) *last = json_arena_last_stats;
+  if(max) *max = json_arena_max_stats;
+}
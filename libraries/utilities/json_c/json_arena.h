@@ -0,0 +1,145 @@
+/*
+ * Per-document arena allocator for json_object trees.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+#ifndef _json_arena_h_
+#define _json_arena_h_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Default size of one arena block, used when 0 is passed to json_arena_new.
+ * Requests larger than a block get a dedicated block of their own.
+ */
+#ifndef JSON_ARENA_DEFAULT_BLOCK_SIZE
+#define JSON_ARENA_DEFAULT_BLOCK_SIZE 512
+#endif
+
+/**
+ * Alignment of every arena allocation, large enough for int64_t and double.
+ */
+#ifndef JSON_ARENA_ALIGN
+#define JSON_ARENA_ALIGN 8
+#endif
+
+struct json_object;
+
+typedef void (json_arena_cleanup_fn) (void *ptr);
+
+struct json_arena_block {
+  struct json_arena_block *next;
+  size_t size;
+  size_t used;
+};
+
+struct json_arena_cleanup {
+  struct json_arena_cleanup *next;
+  json_arena_cleanup_fn *fn;
+  void *ptr;
+};
+
+/**
+ * A chain of blocks that every json_object, linkhash, array_list and string
+ * of one document is carved from. Nothing is returned to the heap until the
+ * whole arena is released, which happens when the root object is put.
+ */
+struct json_arena {
+  /**
+   * Block currently allocated from, older blocks follow through next.
+   */
+  struct json_arena_block *blocks;
+  size_t block_size;
+  /**
+   * First object created in the arena, owns the arena.
+   */
+  struct json_object *root;
+  /**
+   * Heap resources referenced by arena objects, run on release.
+   */
+  struct json_arena_cleanup *cleanups;
+  /**
+   * Bytes handed out, bytes taken from the heap and number of blocks.
+   */
+  size_t used;
+  size_t reserved;
+  unsigned int block_count;
+};
+
+struct json_arena_stats {
+  size_t used;
+  size_t reserved;
+  unsigned int blocks;
+};
+
+/**
+ * Create a new arena.
+ * @param block_size size of each block, 0 for JSON_ARENA_DEFAULT_BLOCK_SIZE
+ * @returns the arena, or NULL when out of memory
+ */
+extern struct json_arena* json_arena_new(size_t block_size);
+
+/**
+ * Run the registered cleanups and give every block back to the heap.
+ * Normally called through json_object_put on the arena root.
+ */
+extern void json_arena_free(struct json_arena *arena);
+
+/**
+ * Allocation helpers. A NULL arena falls back to the system heap so callers
+ * can use one code path for heap and arena objects.
+ */
+extern void* json_arena_alloc(struct json_arena *arena, size_t size);
+extern void* json_arena_calloc(struct json_arena *arena, size_t nmemb, size_t size);
+extern void* json_arena_realloc(struct json_arena *arena, void *ptr,
+				size_t old_size, size_t new_size);
+extern char* json_arena_strdup(struct json_arena *arena, const char *str);
+extern char* json_arena_memdup(struct json_arena *arena, const char *str, size_t len);
+
+/**
+ * Free memory obtained from the helpers above. This is free() for a NULL
+ * arena and a no-op otherwise, the memory goes away with the arena.
+ */
+extern void json_arena_release(struct json_arena *arena, void *ptr);
+
+/**
+ * Register a heap resource to be released together with the arena.
+ * @returns 0 on success, -1 when out of memory
+ */
+extern int json_arena_add_cleanup(struct json_arena *arena,
+				  json_arena_cleanup_fn *fn, void *ptr);
+
+/**
+ * Drop one cleanup previously registered with the same fn and ptr.
+ * @returns 0 on success, -1 if no such cleanup is registered
+ */
+extern int json_arena_remove_cleanup(struct json_arena *arena,
+				     json_arena_cleanup_fn *fn, void *ptr);
+
+/**
+ * Memory use of a live arena. used only grows, so it is also the peak.
+ */
+extern void json_arena_get_stats(struct json_arena *arena,
+				 struct json_arena_stats *stats);
+
+/**
+ * Footprint of the most recently released arena and the largest one
+ * released so far, i.e. the peak cost of the last and of the biggest
+ * document. Useful to size JSON_ARENA_DEFAULT_BLOCK_SIZE. Either pointer
+ * may be NULL.
+ */
+extern void json_arena_get_released_stats(struct json_arena_stats *last,
+					  struct json_arena_stats *max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -24,6 +24,7 @@
 #include "json_object.h"
 #include "json_object_private.h"
 #include "json_util.h"
+#include "json_arena.h"
 
 #include "StringUtils.h"
 
@@ -37,7 +38,8 @@ const char *json_number_chars = "0123456789.+-eE";
 const char *json_hex_chars = "0123456789abcdef";
 
 static void json_object_generic_delete(struct json_object* jso);
-static struct json_object* json_object_new(enum json_type o_type);
+static struct json_object* json_object_new(struct json_arena *arena,
+					   enum json_type o_type);
 
 
 /* ref count debugging */
@@ -129,10 +131,20 @@ extern void json_object_put(struct json_object *jso)
 {
   if(jso) {
     jso->_ref_count--;
-    if(!jso->_ref_count) jso->_delete(jso);
+    if(!jso->_ref_count) {
+      /* Arena objects are only reclaimed all at once, through their root */
+      if(!jso->_arena) jso->_delete(jso);
+      else if(jso->_arena->root == jso) json_arena_free(jso->_arena);
+    }
   }
 }
 
+struct json_arena* json_object_get_arena(struct json_object *jso)
+{
+  if(!jso) return NULL;
+  return jso->_arena;
+}
+
 
 /* generic object construction and destruction parts */
 
@@ -147,15 +159,21 @@ static void json_object_generic_delete(struct json_object* jso)
   free(jso);
 }
 
-static struct json_object* json_object_new(enum json_type o_type)
+static struct json_object* json_object_new(struct json_arena *arena,
+					   enum json_type o_type)
 {
   struct json_object *jso;
 
-  jso = (struct json_object*)calloc(sizeof(struct json_object), 1);
+  jso = (struct json_object*)json_arena_calloc(arena, sizeof(struct json_object), 1);
   if(!jso) return NULL;
   jso->o_type = o_type;
   jso->_ref_count = 1;
   jso->_delete = &json_object_generic_delete;
+  jso->_arena = arena;
+  if(arena) {
+    if(!arena->root) arena->root = jso;
+    return jso;
+  }
 #ifdef REFCOUNT_DEBUG
   lh_table_insert(json_object_table, jso, jso);
   MC_DEBUG("json_object_new_%s: %p\n", json_type_to_name(jso->o_type), jso);
@@ -164,6 +182,35 @@ static struct json_object* json_object_new(enum json_type o_type)
 }
 
 
+/* arena ownership of heap resources */
+
+static void json_object_arena_put(void *ptr)
+{
+  json_object_put((struct json_object*)ptr);
+}
+
+static void json_object_arena_printbuf_free(void *ptr)
+{
+  printbuf_free((struct printbuf*)ptr);
+}
+
+/* A child from outside the container's arena keeps the reference the
+ * container took, and gives it back when the arena is released. */
+static int json_object_arena_link(struct json_object *jso,
+				  struct json_object *val)
+{
+  if(!jso->_arena || !val || val->_arena == jso->_arena) return 0;
+  return json_arena_add_cleanup(jso->_arena, &json_object_arena_put, val);
+}
+
+static void json_object_arena_unlink(struct json_object *jso,
+				     struct json_object *val)
+{
+  if(!jso->_arena || !val || val->_arena == jso->_arena) return;
+  json_arena_remove_cleanup(jso->_arena, &json_object_arena_put, val);
+}
+
+
 /* type checking functions */
 
 int json_object_is_type(struct json_object *jso, enum json_type type)
@@ -183,6 +230,12 @@ const char* json_object_to_json_string(struct json_object *jso)
   if(!jso) return "null";
   if(!jso->_pb) {
     if(!(jso->_pb = printbuf_new())) return NULL;
+    if(jso->_arena &&
+       json_arena_add_cleanup(jso->_arena, &json_object_arena_printbuf_free, jso->_pb) < 0) {
+      printbuf_free(jso->_pb);
+      jso->_pb = NULL;
+      return NULL;
+    }
   } else {
     printbuf_reset(jso->_pb);
   }
@@ -232,6 +285,11 @@ static void json_object_lh_entry_free(struct lh_entry *ent)
   json_object_put((struct json_object*)ent->v);
 }
 
+static void json_object_arena_lh_entry_free(struct lh_entry *ent)
+{
+  json_object_put((struct json_object*)ent->v);
+}
+
 static void json_object_object_delete(struct json_object* jso)
 {
   lh_table_free(jso->o.c_object);
@@ -240,12 +298,18 @@ static void json_object_object_delete(struct json_object* jso)
 
 struct json_object* json_object_new_object(void)
 {
-  struct json_object *jso = json_object_new(json_type_object);
+  return json_object_new_object_in(NULL);
+}
+
+struct json_object* json_object_new_object_in(struct json_arena *arena)
+{
+  struct json_object *jso = json_object_new(arena, json_type_object);
   if(!jso) return NULL;
   jso->_delete = &json_object_object_delete;
   jso->_to_json_string = &json_object_object_to_json_string;
-  jso->o.c_object = lh_kchar_table_new(JSON_OBJECT_DEF_HASH_ENTRIES,
-					NULL, &json_object_lh_entry_free);
+  jso->o.c_object = lh_kchar_table_new_in(arena, JSON_OBJECT_DEF_HASH_ENTRIES, NULL,
+					   arena ? &json_object_arena_lh_entry_free
+						 : &json_object_lh_entry_free);
   return jso;
 }
 
@@ -263,8 +327,14 @@ struct lh_table* json_object_get_object(struct json_object *jso)
 void json_object_object_add(struct json_object* jso, const char *key,
 			    struct json_object *val)
 {
+  if(jso->_arena)
+    json_object_arena_unlink(jso, (struct json_object*)lh_table_lookup(jso->o.c_object, key));
   lh_table_delete(jso->o.c_object, key);
-  lh_table_insert(jso->o.c_object, strdup(key), val);
+  if(json_object_arena_link(jso, val) < 0) {
+    json_object_put(val);
+    return;
+  }
+  lh_table_insert(jso->o.c_object, json_arena_strdup(jso->_arena, key), val);
 }
 
 struct json_object* json_object_object_get(struct json_object* jso, const char *key)
@@ -275,6 +345,8 @@ struct json_object* json_object_object_get(struct json_object* jso, const char *
 
 void json_object_object_del(struct json_object* jso, const char *key)
 {
+  if(jso->_arena)
+    json_object_arena_unlink(jso, (struct json_object*)lh_table_lookup(jso->o.c_object, key));
   lh_table_delete(jso->o.c_object, key);
 }
 
@@ -290,7 +362,12 @@ static int json_object_boolean_to_json_string(struct json_object* jso,
 
 struct json_object* json_object_new_boolean(boolean b)
 {
-  struct json_object *jso = json_object_new(json_type_boolean);
+  return json_object_new_boolean_in(NULL, b);
+}
+
+struct json_object* json_object_new_boolean_in(struct json_arena *arena, boolean b)
+{
+  struct json_object *jso = json_object_new(arena, json_type_boolean);
   if(!jso) return NULL;
   jso->_to_json_string = &json_object_boolean_to_json_string;
   jso->o.c_boolean = b;
@@ -325,7 +402,12 @@ static int json_object_int_to_json_string(struct json_object* jso,
 
 struct json_object* json_object_new_int(int32_t i)
 {
-  struct json_object *jso = json_object_new(json_type_int);
+  return json_object_new_int_in(NULL, i);
+}
+
+struct json_object* json_object_new_int_in(struct json_arena *arena, int32_t i)
+{
+  struct json_object *jso = json_object_new(arena, json_type_int);
   if(!jso) return NULL;
   jso->_to_json_string = &json_object_int_to_json_string;
   jso->o.c_int64 = i;
@@ -370,7 +452,12 @@ int32_t json_object_get_int(struct json_object *jso)
 
 struct json_object* json_object_new_int64(int64_t i)
 {
-  struct json_object *jso = json_object_new(json_type_int);
+  return json_object_new_int64_in(NULL, i);
+}
+
+struct json_object* json_object_new_int64_in(struct json_arena *arena, int64_t i)
+{
+  struct json_object *jso = json_object_new(arena, json_type_int);
   if(!jso) return NULL;
   jso->_to_json_string = &json_object_int_to_json_string;
   jso->o.c_int64 = i;
@@ -407,7 +494,12 @@ static int json_object_double_to_json_string(struct json_object* jso,
 
 struct json_object* json_object_new_double(double d)
 {
-  struct json_object *jso = json_object_new(json_type_double);
+  return json_object_new_double_in(NULL, d);
+}
+
+struct json_object* json_object_new_double_in(struct json_arena *arena, double d)
+{
+  struct json_object *jso = json_object_new(arena, json_type_double);
   if(!jso) return NULL;
   jso->_to_json_string = &json_object_double_to_json_string;
   jso->o.c_double = d;
@@ -453,23 +545,32 @@ static void json_object_string_delete(struct json_object* jso)
 
 struct json_object* json_object_new_string(const char *s)
 {
-  struct json_object *jso = json_object_new(json_type_string);
+  return json_object_new_string_in(NULL, s);
+}
+
+struct json_object* json_object_new_string_in(struct json_arena *arena, const char *s)
+{
+  struct json_object *jso = json_object_new(arena, json_type_string);
   if(!jso) return NULL;
   jso->_delete = &json_object_string_delete;
   jso->_to_json_string = &json_object_string_to_json_string;
-  jso->o.c_string.str = strdup(s);
+  jso->o.c_string.str = json_arena_strdup(arena, s);
   jso->o.c_string.len = strlen(s);
   return jso;
 }
 
 struct json_object* json_object_new_string_len(const char *s, int len)
 {
-  struct json_object *jso = json_object_new(json_type_string);
+  return json_object_new_string_len_in(NULL, s, len);
+}
+
+struct json_object* json_object_new_string_len_in(struct json_arena *arena, const char *s, int len)
+{
+  struct json_object *jso = json_object_new(arena, json_type_string);
   if(!jso) return NULL;
   jso->_delete = &json_object_string_delete;
   jso->_to_json_string = &json_object_string_to_json_string;
-  jso->o.c_string.str = malloc(len);
-  memcpy(jso->o.c_string.str, (void *)s, len);
+  jso->o.c_string.str = json_arena_memdup(arena, s, len);
   jso->o.c_string.len = len;
   return jso;
 }
@@ -528,11 +629,16 @@ static void json_object_array_delete(struct json_object* jso)
 
 struct json_object* json_object_new_array(void)
 {
-  struct json_object *jso = json_object_new(json_type_array);
+  return json_object_new_array_in(NULL);
+}
+
+struct json_object* json_object_new_array_in(struct json_arena *arena)
+{
+  struct json_object *jso = json_object_new(arena, json_type_array);
   if(!jso) return NULL;
   jso->_delete = &json_object_array_delete;
   jso->_to_json_string = &json_object_array_to_json_string;
-  jso->o.c_array = array_list_new(&json_object_array_entry_free);
+  jso->o.c_array = array_list_new_in(arena, &json_object_array_entry_free);
   return jso;
 }
 
@@ -554,13 +660,26 @@ int json_object_array_length(struct json_object *jso)
 
 int json_object_array_add(struct json_object *jso,struct json_object *val)
 {
-  return array_list_add(jso->o.c_array, val);
+  if(json_object_arena_link(jso, val) < 0) return -1;
+  if(array_list_add(jso->o.c_array, val) < 0) {
+    json_object_arena_unlink(jso, val);
+    return -1;
+  }
+  return 0;
 }
 
 int json_object_array_put_idx(struct json_object *jso, int idx,
 			      struct json_object *val)
 {
-  return array_list_put_idx(jso->o.c_array, idx, val);
+  struct json_object *old = json_object_array_get_idx(jso, idx);
+
+  if(json_object_arena_link(jso, val) < 0) return -1;
+  if(array_list_put_idx(jso->o.c_array, idx, val) < 0) {
+    json_object_arena_unlink(jso, val);
+    return -1;
+  }
+  json_object_arena_unlink(jso, old);
+  return 0;
 }
 
 struct json_object* json_object_array_get_idx(struct json_object *jso,
@@ -52,6 +52,7 @@ typedef struct array_list array_list;
 typedef struct json_object json_object;
 typedef struct json_object_iter json_object_iter;
 typedef struct json_tokener json_tokener;
+struct json_arena;
 
 /* supported object types */
 
@@ -81,6 +82,37 @@ extern struct json_object* json_object_get(struct json_object *obj);
 extern void json_object_put(struct json_object *obj);
 
 
+/* arena allocation */
+
+/**
+ * Every constructor has an _in variant that carves the object, and the
+ * strings, tables and arrays it owns, from an arena (see json_arena.h).
+ * A NULL arena means the system heap, exactly like the plain constructor.
+ *
+ * The first object created in an arena becomes its root. Putting the root
+ * releases the whole arena at once, putting any other arena object does
+ * nothing, so arena objects must not be used once their root is gone.
+ * Heap objects added to an arena container are put when the arena goes.
+ */
+
+/**
+ * Get the arena a json_object was allocated from
+ * @param obj the json_object instance
+ * @returns the arena, or NULL for heap objects
+ */
+extern struct json_arena* json_object_get_arena(struct json_object *obj);
+
+extern struct json_object* json_object_new_object_in(struct json_arena *arena);
+extern struct json_object* json_object_new_array_in(struct json_arena *arena);
+extern struct json_object* json_object_new_boolean_in(struct json_arena *arena, boolean b);
+extern struct json_object* json_object_new_int_in(struct json_arena *arena, int32_t i);
+extern struct json_object* json_object_new_int64_in(struct json_arena *arena, int64_t i);
+extern struct json_object* json_object_new_double_in(struct json_arena *arena, double d);
+extern struct json_object* json_object_new_string_in(struct json_arena *arena, const char *s);
+extern struct json_object* json_object_new_string_len_in(struct json_arena *arena,
+							 const char *s, int len);
+
+
 /**
  * Check if the json_object is of a given type
  * @param obj the json_object instance
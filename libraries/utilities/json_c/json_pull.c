@@ -0,0 +1,492 @@
+/*
+ * Event (pull) mode JSON tokenizer, no json_object tree and no heap.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_inttypes.h"
+#include "json_object.h"
+#include "json_pull.h"
+
+/* What the grammar accepts next */
+enum {
+  JSON_PULL_EXP_VALUE,
+  JSON_PULL_EXP_VALUE_OR_END,   /* right after '[' */
+  JSON_PULL_EXP_KEY,
+  JSON_PULL_EXP_KEY_OR_END,     /* right after '{' */
+  JSON_PULL_EXP_COLON,
+  JSON_PULL_EXP_COMMA_OR_END,
+  JSON_PULL_EXP_DONE
+};
+
+/* Token being scanned, possibly across fed buffers */
+enum {
+  JSON_PULL_LEX_NONE,
+  JSON_PULL_LEX_STRING,
+  JSON_PULL_LEX_NUMBER,
+  JSON_PULL_LEX_LITERAL
+};
+
+#ifndef INT64_MAX
+#define INT64_MAX ((int64_t)0x7FFFFFFFFFFFFFFFLL)
+#endif
+#ifndef INT64_MIN
+#define INT64_MIN (-INT64_MAX - 1)
+#endif
+
+#define JSON_PULL_IN_OBJECT 1
+#define JSON_PULL_IN_ARRAY  2
+
+#define json_pull_is_space(c) \
+  ((c) == ' ' || (c) == '\t' || (c) == '\n' || (c) == '\r' || (c) == '\f' || (c) == '\v')
+#define json_pull_is_num_char(c) \
+  (((c) >= '0' && (c) <= '9') || (c) == '.' || (c) == '-' || (c) == '+' || \
+   (c) == 'e' || (c) == 'E')
+
+void json_pull_init(struct json_pull *p)
+{
+  memset(p, 0, sizeof(struct json_pull));
+  p->expect = JSON_PULL_EXP_VALUE;
+}
+
+void json_pull_feed(struct json_pull *p, const char *buf, int len)
+{
+  p->offset += p->in_pos;
+  p->in = buf;
+  p->in_len = buf ? len : 0;
+  p->in_pos = 0;
+  if(!p->in_len) p->eof = 1;
+}
+
+static enum json_pull_event json_pull_fail(struct json_pull *p)
+{
+  p->event = json_pull_error;
+  return json_pull_error;
+}
+
+/* Keep the part of a split token that is in the current buffer */
+static int json_pull_save(struct json_pull *p, const char *s, int len)
+{
+  if(p->scratch_len + len > JSON_PULL_TOKEN_MAX) return -1;
+  memcpy(p->scratch + p->scratch_len, s, len);
+  p->scratch_len += len;
+  return 0;
+}
+
+/* Finish a token ending at in[end): point into the buffer when it was
+ * not split, into scratch otherwise */
+static int json_pull_token(struct json_pull *p, int start, int end)
+{
+  if(!p->scratch_len) {
+    p->tok = p->in + start;
+    p->tok_len = end - start;
+    return 0;
+  }
+  if(json_pull_save(p, p->in + start, end - start) < 0) return -1;
+  p->tok = p->scratch;
+  p->tok_len = p->scratch_len;
+  p->scratch_len = 0;
+  return 0;
+}
+
+/* Scan towards the end of the current token.
+ * Returns 1 when it is complete, 0 if more input is needed, -1 on error. */
+static int json_pull_lex(struct json_pull *p)
+{
+  int start = p->in_pos, pos = p->in_pos;
+  char c;
+
+  switch(p->lex) {
+  case JSON_PULL_LEX_STRING:
+    for(; pos < p->in_len; pos++) {
+      c = p->in[pos];
+      if(p->esc) {
+	p->esc = 0;
+      } else if(c == '\\') {
+	p->esc = 1;
+	p->tok_flags |= JSON_PULL_ESCAPED;
+      } else if(c == p->quote) {
+	if(json_pull_token(p, start, pos) < 0) return -1;
+	p->in_pos = pos + 1;
+	return 1;
+      }
+    }
+    break;
+
+  case JSON_PULL_LEX_NUMBER:
+    for(; pos < p->in_len; pos++) {
+      c = p->in[pos];
+      if(!json_pull_is_num_char(c)) {
+	if(json_pull_token(p, start, pos) < 0) return -1;
+	p->in_pos = pos;
+	return 1;
+      }
+      if(c == '.' || c == 'e' || c == 'E') p->tok_flags |= JSON_PULL_DOUBLE;
+    }
+    if(p->eof) {
+      p->tok = p->scratch;
+      p->tok_len = p->scratch_len;
+      p->scratch_len = 0;
+      return 1;
+    }
+    break;
+
+  case JSON_PULL_LEX_LITERAL:
+    for(; pos < p->in_len && p->lit[p->lit_pos]; pos++, p->lit_pos++) {
+      if(p->in[pos] != p->lit[p->lit_pos]) return -1;
+    }
+    p->in_pos = pos;
+    if(!p->lit[p->lit_pos]) return 1;
+    return p->eof ? -1 : 0;
+  }
+
+  if(p->eof) return -1;
+  if(json_pull_save(p, p->in + start, pos - start) < 0) return -1;
+  p->in_pos = pos;
+  return 0;
+}
+
+/* Strict number syntax: -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)? */
+static int json_pull_check_number(const char *s, int len)
+{
+  int i = 0, digits;
+
+  if(i < len && s[i] == '-') i++;
+  if(i < len && s[i] == '0') {
+    i++;
+  } else {
+    for(digits = 0; i < len && s[i] >= '0' && s[i] <= '9'; i++) digits++;
+    if(!digits) return -1;
+  }
+  if(i < len && s[i] == '.') {
+    for(i++, digits = 0; i < len && s[i] >= '0' && s[i] <= '9'; i++) digits++;
+    if(!digits) return -1;
+  }
+  if(i < len && (s[i] == 'e' || s[i] == 'E')) {
+    i++;
+    if(i < len && (s[i] == '+' || s[i] == '-')) i++;
+    for(digits = 0; i < len && s[i] >= '0' && s[i] <= '9'; i++) digits++;
+    if(!digits) return -1;
+  }
+  return i == len ? 0 : -1;
+}
+
+static void json_pull_after_value(struct json_pull *p)
+{
+  p->expect = p->depth ? JSON_PULL_EXP_COMMA_OR_END : JSON_PULL_EXP_DONE;
+}
+
+/* Event for the token json_pull_lex just completed */
+static enum json_pull_event json_pull_emit(struct json_pull *p)
+{
+  int lex = p->lex;
+
+  p->lex = JSON_PULL_LEX_NONE;
+  switch(lex) {
+  case JSON_PULL_LEX_STRING:
+    if(p->is_key) {
+      p->expect = JSON_PULL_EXP_COLON;
+      return p->event = json_pull_key;
+    }
+    json_pull_after_value(p);
+    return p->event = json_pull_string;
+  case JSON_PULL_LEX_NUMBER:
+    if(json_pull_check_number(p->tok, p->tok_len) < 0) return json_pull_fail(p);
+    json_pull_after_value(p);
+    return p->event = json_pull_number;
+  default:
+    json_pull_after_value(p);
+    if(p->lit[0] == 't') return p->event = json_pull_true;
+    if(p->lit[0] == 'f') return p->event = json_pull_false;
+    return p->event = json_pull_null;
+  }
+}
+
+enum json_pull_event json_pull_next(struct json_pull *p)
+{
+  int r;
+  char c;
+
+  if(p->event == json_pull_error) return json_pull_error;
+
+  for(;;) {
+    if(p->lex != JSON_PULL_LEX_NONE) {
+      r = json_pull_lex(p);
+      if(r < 0) return json_pull_fail(p);
+      if(r == 0) return p->event = json_pull_need_more;
+      return json_pull_emit(p);
+    }
+
+    if(p->expect == JSON_PULL_EXP_DONE) return p->event = json_pull_end;
+
+    while(p->in_pos < p->in_len && json_pull_is_space(p->in[p->in_pos]))
+      p->in_pos++;
+    if(p->in_pos == p->in_len) {
+      if(p->eof) return json_pull_fail(p);
+      return p->event = json_pull_need_more;
+    }
+
+    c = p->in[p->in_pos++];
+    switch(c) {
+    case '{':
+    case '[':
+      if(p->expect != JSON_PULL_EXP_VALUE && p->expect != JSON_PULL_EXP_VALUE_OR_END)
+	return json_pull_fail(p);
+      if(p->depth == JSON_PULL_MAX_DEPTH) return json_pull_fail(p);
+      if(c == '{') {
+	p->stack[p->depth++] = JSON_PULL_IN_OBJECT;
+	p->expect = JSON_PULL_EXP_KEY_OR_END;
+	return p->event = json_pull_object_begin;
+      }
+      p->stack[p->depth++] = JSON_PULL_IN_ARRAY;
+      p->expect = JSON_PULL_EXP_VALUE_OR_END;
+      return p->event = json_pull_array_begin;
+
+    case '}':
+      if((p->expect != JSON_PULL_EXP_KEY_OR_END && p->expect != JSON_PULL_EXP_COMMA_OR_END) ||
+	 p->stack[p->depth - 1] != JSON_PULL_IN_OBJECT)
+	return json_pull_fail(p);
+      p->depth--;
+      json_pull_after_value(p);
+      return p->event = json_pull_object_end;
+
+    case ']':
+      if((p->expect != JSON_PULL_EXP_VALUE_OR_END && p->expect != JSON_PULL_EXP_COMMA_OR_END) ||
+	 p->stack[p->depth - 1] != JSON_PULL_IN_ARRAY)
+	return json_pull_fail(p);
+      p->depth--;
+      json_pull_after_value(p);
+      return p->event = json_pull_array_end;
+
+    case ',':
+      if(p->expect != JSON_PULL_EXP_COMMA_OR_END) return json_pull_fail(p);
+      p->expect = (p->stack[p->depth - 1] == JSON_PULL_IN_OBJECT) ?
+	JSON_PULL_EXP_KEY : JSON_PULL_EXP_VALUE;
+      break;
+
+    case ':':
+      if(p->expect != JSON_PULL_EXP_COLON) return json_pull_fail(p);
+      p->expect = JSON_PULL_EXP_VALUE;
+      break;
+
+    case '"':
+    case '\'':
+      if(p->expect == JSON_PULL_EXP_KEY || p->expect == JSON_PULL_EXP_KEY_OR_END)
+	p->is_key = 1;
+      else if(p->expect == JSON_PULL_EXP_VALUE || p->expect == JSON_PULL_EXP_VALUE_OR_END)
+	p->is_key = 0;
+      else
+	return json_pull_fail(p);
+      p->lex = JSON_PULL_LEX_STRING;
+      p->quote = c;
+      p->esc = 0;
+      p->tok_flags = 0;
+      break;
+
+    default:
+      if(p->expect != JSON_PULL_EXP_VALUE && p->expect != JSON_PULL_EXP_VALUE_OR_END)
+	return json_pull_fail(p);
+      if(c == '-' || (c >= '0' && c <= '9')) {
+	/* Rescan the first character as part of the number */
+	p->in_pos--;
+	p->lex = JSON_PULL_LEX_NUMBER;
+	p->tok_flags = 0;
+      } else if(c == 't' || c == 'f' || c == 'n') {
+	p->lex = JSON_PULL_LEX_LITERAL;
+	p->lit = (c == 't') ? "true" : (c == 'f') ? "false" : "null";
+	p->lit_pos = 1;
+      } else {
+	return json_pull_fail(p);
+      }
+    }
+  }
+}
+
+int json_pull_token_equals(struct json_pull *p, const char *s)
+{
+  return (int)strlen(s) == p->tok_len && memcmp(p->tok, s, p->tok_len) == 0;
+}
+
+static int json_pull_hex(const char *s, unsigned int *val)
+{
+  int i;
+  char c;
+
+  *val = 0;
+  for(i = 0; i < 4; i++) {
+    c = s[i];
+    if(c >= '0' && c <= '9') *val = (*val << 4) | (c - '0');
+    else if(c >= 'a' && c <= 'f') *val = (*val << 4) | (c - 'a' + 10);
+    else if(c >= 'A' && c <= 'F') *val = (*val << 4) | (c - 'A' + 10);
+    else return -1;
+  }
+  return 0;
+}
+
+static int json_pull_put_utf8(char *out, unsigned int uc)
+{
+  if(uc < 0x80) {
+    out[0] = (char)uc;
+    return 1;
+  }
+  if(uc < 0x800) {
+    out[0] = (char)(0xC0 | (uc >> 6));
+    out[1] = (char)(0x80 | (uc & 0x3F));
+    return 2;
+  }
+  if(uc < 0x10000) {
+    out[0] = (char)(0xE0 | (uc >> 12));
+    out[1] = (char)(0x80 | ((uc >> 6) & 0x3F));
+    out[2] = (char)(0x80 | (uc & 0x3F));
+    return 3;
+  }
+  out[0] = (char)(0xF0 | (uc >> 18));
+  out[1] = (char)(0x80 | ((uc >> 12) & 0x3F));
+  out[2] = (char)(0x80 | ((uc >> 6) & 0x3F));
+  out[3] = (char)(0x80 | (uc & 0x3F));
+  return 4;
+}
+
+int json_pull_get_string(struct json_pull *p, char *dst, int size)
+{
+  const char *s = p->tok, *end = p->tok + p->tok_len;
+  char out[4];
+  unsigned int uc, lo;
+  int n, i, len = 0;
+
+  while(s < end) {
+    n = 1;
+    if(*s != '\\' || s + 1 == end) {
+      out[0] = *s++;
+    } else {
+      s++;
+      switch(*s) {
+      case 'b': out[0] = '\b'; break;
+      case 'f': out[0] = '\f'; break;
+      case 'n': out[0] = '\n'; break;
+      case 'r': out[0] = '\r'; break;
+      case 't': out[0] = '\t'; break;
+      case 'u':
+	if(end - s < 5 || json_pull_hex(s + 1, &uc) < 0) {
+	  out[0] = 'u';
+	  break;
+	}
+	s += 4;
+	if((uc & 0xFC00) == 0xD800 && end - s >= 7 && s[1] == '\\' && s[2] == 'u' &&
+	   json_pull_hex(s + 3, &lo) == 0 && (lo & 0xFC00) == 0xDC00) {
+	  uc = (((uc & 0x3FF) << 10) | (lo & 0x3FF)) + 0x10000;
+	  s += 6;
+	} else if((uc & 0xF800) == 0xD800) {
+	  uc = 0xFFFD;
+	}
+	n = json_pull_put_utf8(out, uc);
+	break;
+      default: out[0] = *s; break;
+      }
+      s++;
+    }
+    for(i = 0; i < n; i++, len++)
+      if(len < size - 1) dst[len] = out[i];
+  }
+  if(size > 0) dst[len < size - 1 ? len : size - 1] = '\0';
+  return len;
+}
+
+/* Number token of a number event, or of a string holding a plain number */
+static int json_pull_numeric(struct json_pull *p, int *is_double)
+{
+  int i;
+
+  if(p->event == json_pull_number) {
+    *is_double = p->tok_flags & JSON_PULL_DOUBLE;
+    return 1;
+  }
+  if(p->event != json_pull_string || (p->tok_flags & JSON_PULL_ESCAPED) ||
+     json_pull_check_number(p->tok, p->tok_len) < 0)
+    return 0;
+  *is_double = 0;
+  for(i = 0; i < p->tok_len; i++)
+    if(p->tok[i] == '.' || p->tok[i] == 'e' || p->tok[i] == 'E') *is_double = 1;
+  return 1;
+}
+
+int64_t json_pull_get_int64(struct json_pull *p)
+{
+  const char *s = p->tok, *end = p->tok + p->tok_len;
+  uint64_t v = 0;
+  int neg = 0, is_double;
+
+  if(p->event == json_pull_true) return 1;
+  if(!json_pull_numeric(p, &is_double)) return 0;
+  if(is_double) return (int64_t)json_pull_get_double(p);
+  if(s < end && *s == '-') {
+    neg = 1;
+    s++;
+  }
+  /* Saturate like json_parse_int64 */
+  for(; s < end; s++) {
+    if(v > (uint64_t)(INT64_MAX - (*s - '0')) / 10)
+      return neg ? INT64_MIN : INT64_MAX;
+    v = v * 10 + (*s - '0');
+  }
+  return neg ? -(int64_t)v : (int64_t)v;
+}
+
+double json_pull_get_double(struct json_pull *p)
+{
+  char num[JSON_PULL_TOKEN_MAX + 1];
+  int len, is_double;
+
+  if(p->event == json_pull_true) return 1.0;
+  if(!json_pull_numeric(p, &is_double)) return 0.0;
+  if(!is_double) return (double)json_pull_get_int64(p);
+  /* strtod needs a terminated copy, the token is followed by more input */
+  len = p->tok_len < JSON_PULL_TOKEN_MAX ? p->tok_len : JSON_PULL_TOKEN_MAX;
+  memcpy(num, p->tok, len);
+  num[len] = '\0';
+  return strtod(num, NULL);
+}
+
+boolean json_pull_get_boolean(struct json_pull *p)
+{
+  const char *s;
+
+  switch(p->event) {
+  case json_pull_true:
+    return TRUE;
+  case json_pull_number:
+    /* Non zero if any significant digit is non zero */
+    for(s = p->tok; s < p->tok + p->tok_len; s++) {
+      if(*s == 'e' || *s == 'E') break;
+      if(*s >= '1' && *s <= '9') return TRUE;
+    }
+    return FALSE;
+  case json_pull_string:
+    return p->tok_len != 0;
+  default:
+    return FALSE;
+  }
+}
+
+int json_pull_parse(struct json_pull *p, const char *buf, int len,
+		    json_pull_callback_fn *cb, void *ctx)
+{
+  enum json_pull_event ev;
+  int ret;
+
+  json_pull_feed(p, buf, len);
+  for(;;) {
+    ev = json_pull_next(p);
+    if(ev == json_pull_need_more) return 0;
+    if(ev == json_pull_error) return -1;
+    if(ev == json_pull_end) return 1;
+    if((ret = cb(ctx, p, ev)) != 0) return ret;
+  }
+}
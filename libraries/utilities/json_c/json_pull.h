@@ -0,0 +1,161 @@
+/*
+ * Event (pull) mode JSON tokenizer, no json_object tree and no heap.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+#ifndef _json_pull_h_
+#define _json_pull_h_
+
+#include "json_inttypes.h"
+#include "json_object.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Maximum nesting of arrays and objects.
+ */
+#ifndef JSON_PULL_MAX_DEPTH
+#define JSON_PULL_MAX_DEPTH 32
+#endif
+
+/**
+ * Longest key, string or number that may be split across two fed
+ * buffers. Tokens that are complete within one buffer have no limit.
+ */
+#ifndef JSON_PULL_TOKEN_MAX
+#define JSON_PULL_TOKEN_MAX 128
+#endif
+
+enum json_pull_event {
+  json_pull_need_more,   /* buffer exhausted, feed the next one */
+  json_pull_error,
+  json_pull_end,         /* top level value complete */
+  json_pull_object_begin,
+  json_pull_object_end,
+  json_pull_array_begin,
+  json_pull_array_end,
+  json_pull_key,
+  json_pull_string,
+  json_pull_number,
+  json_pull_true,
+  json_pull_false,
+  json_pull_null
+};
+
+/* tok_flags */
+#define JSON_PULL_ESCAPED 0x01  /* string contains '\' escapes */
+#define JSON_PULL_DOUBLE  0x02  /* number has a fraction or exponent */
+
+struct json_pull {
+  /**
+   * Current key, string or number: pointer and length. This points into
+   * the fed buffer whenever the token lies entirely inside it, into
+   * scratch otherwise, and is valid until the next call to json_pull_next.
+   * Strings are reported raw, without the quotes and with escapes as in
+   * the input; use json_pull_get_string to decode them.
+   */
+  const char *tok;
+  int tok_len;
+  int tok_flags;
+
+  /* private */
+  enum json_pull_event event;
+  const char *in;
+  int in_len;
+  int in_pos;
+  int offset;
+  int eof;
+  int depth;
+  int expect;
+  int lex;
+  int is_key;
+  int esc;
+  char quote;
+  const char *lit;
+  int lit_pos;
+  int scratch_len;
+  unsigned char stack[JSON_PULL_MAX_DEPTH];
+  char scratch[JSON_PULL_TOKEN_MAX];
+};
+
+extern void json_pull_init(struct json_pull *p);
+
+/**
+ * Hand the next piece of input to the tokenizer. The buffer has to stay
+ * untouched until json_pull_next returns json_pull_need_more. Feeding a
+ * NULL buffer (or len 0) marks the end of the input.
+ */
+extern void json_pull_feed(struct json_pull *p, const char *buf, int len);
+
+/**
+ * Advance to the next event. After json_pull_end the remaining input,
+ * if any, starts at json_pull_consumed() bytes into the last buffer.
+ */
+extern enum json_pull_event json_pull_next(struct json_pull *p);
+
+/**
+ * Nesting level of the event just returned, the top level object or
+ * array being 1 for its keys and values.
+ */
+#define json_pull_depth(p) ((p)->depth)
+
+/**
+ * Number of bytes of the last fed buffer consumed so far.
+ */
+#define json_pull_consumed(p) ((p)->in_pos)
+
+/**
+ * Offset of the error from the start of the document.
+ */
+#define json_pull_offset(p) ((p)->offset + (p)->in_pos)
+
+/**
+ * Compare the current key or string with a C string, escapes included.
+ */
+extern int json_pull_token_equals(struct json_pull *p, const char *s);
+
+/**
+ * Decode the current key or string into dst and NUL terminate it,
+ * truncating like snprintf.
+ * @returns the decoded length, which may exceed size - 1
+ */
+extern int json_pull_get_string(struct json_pull *p, char *dst, int size);
+
+/**
+ * Value of the current number, true or false event, with the same
+ * coercion rules as the json_object_get_* functions. Strings holding
+ * a plain number are converted too.
+ */
+extern int64_t json_pull_get_int64(struct json_pull *p);
+extern double json_pull_get_double(struct json_pull *p);
+extern boolean json_pull_get_boolean(struct json_pull *p);
+
+/**
+ * SAX style driver: feed buf and pass every event to cb until the input
+ * is used up, the document ends or cb returns non zero.
+ * @returns 0 when more input is needed, 1 at the end of the document,
+ * -1 on a syntax error, or the non zero value returned by cb
+ */
+typedef int (json_pull_callback_fn)(void *ctx, struct json_pull *p,
+				    enum json_pull_event ev);
+
+extern int json_pull_parse(struct json_pull *p, const char *buf, int len,
+			   json_pull_callback_fn *cb, void *ctx);
+
+/**
+ * Checks of the tokenizer fed in pieces and against the tree parser, see
+ * json_pull_test.c.
+ * @returns 0 if they all pass
+ */
+extern int json_pull_test(int print);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
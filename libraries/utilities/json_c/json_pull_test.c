@@ -0,0 +1,241 @@
+/*
+ * Checks of the pull tokenizer fed in pieces of every size, against
+ * itself fed whole and against the tree parser, and a comparison of
+ * their speed on config payloads. Built on the host with the rest of
+ * json_c; not part of the default build.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "json.h"
+
+#define JSON_PULL_TEST_TRACE_SIZE 2048
+#define JSON_PULL_TEST_SECONDS 1
+
+/* An EasyLink config object as sent by the phone app */
+static const char json_pull_test_easylink[] =
+  "{\"SSID\":\"MXCHIP_Office\",\"PASSWORD\":\"12345678\",\"DHCP\":true,"
+  "\"IP\":\"192.168.1.100\",\"NETMASK\":\"255.255.255.0\","
+  "\"GATEWAY\":\"192.168.1.1\",\"DNS1\":\"192.168.1.1\","
+  "\"IDENTIFIER\":1234567890,\"Device Name\":\"MiCOKit-3165(ABCDEF)\"}";
+
+/* A config server write, nested and with escapes */
+static const char json_pull_test_config[] =
+  "{ \"Device Name\": \"Kitchen \\\"light\\\"\", \"RF power save\": false,"
+  " \"MCU power save\": true, \"Bonjour\": { \"port\": 8000, \"name\": \"mico\\/01\" },"
+  " \"Cloud\": [ 1, -2.5e3, null, \"\\u00e9\\ud83d\\ude00\" ], \"Version\": 0.25 }";
+
+static const char *json_pull_test_valid[] = {
+  json_pull_test_easylink,
+  json_pull_test_config,
+  "[]",
+  "{}",
+  "[ [ [ { \"a\": [ { } ] } ] ] ]",
+  "{ 'single': 'quoted' }",
+  "  \"top level string\"  ",
+  "-0.5e-3",
+};
+
+static const char *json_pull_test_malformed[] = {
+  "{ \"a\" 1 }",
+  "{ \"a\": 1, }",
+  "[ 1 2 ]",
+  "{ \"a\": tru }",
+  "[ 01 ]",
+  "{ \"a\": 1 ]",
+  "[ \"unterminated ]",
+  "{ \"a\": -. }",
+};
+
+/* Every event of doc fed in pieces of chunk bytes, one line each, with
+ * keys and strings decoded. Returns the last event: json_pull_end or
+ * json_pull_error. */
+static enum json_pull_event json_pull_test_trace(const char *doc, int chunk,
+						 char *trace, int size)
+{
+  static const char codes[] = "-!.{}[]ksntfz";
+  struct json_pull p;
+  enum json_pull_event ev;
+  int len = strlen(doc), fed = 0, n = 0;
+
+  trace[0] = '\0';
+  json_pull_init(&p);
+  while(1) {
+    ev = json_pull_next(&p);
+    if(ev == json_pull_need_more) {
+      if(fed < len) {
+	json_pull_feed(&p, doc + fed, chunk < len - fed ? chunk : len - fed);
+	fed += chunk < len - fed ? chunk : len - fed;
+      } else {
+	json_pull_feed(&p, NULL, 0);
+      }
+      continue;
+    }
+    if(ev == json_pull_end || ev == json_pull_error) return ev;
+    if(n + 80 >= size) return json_pull_error;
+    trace[n++] = codes[ev];
+    if(ev == json_pull_key || ev == json_pull_string) {
+      n += snprintf(trace + n, size - n, "%d:", json_pull_depth(&p));
+      json_pull_get_string(&p, trace + n, size - n);
+      n += strlen(trace + n);
+    } else if(ev == json_pull_number) {
+      n += snprintf(trace + n, size - n, "%.*s", p.tok_len, p.tok);
+    }
+    trace[n++] = '\n';
+    trace[n] = '\0';
+  }
+}
+
+/* The top level values of an object, read through the pull getters, must
+ * be what the tree parser gives for the same keys */
+static int json_pull_test_against_tree(const char *doc)
+{
+  struct json_object *tree = json_tokener_parse(doc), *val;
+  struct json_pull p;
+  enum json_pull_event ev;
+  char key[64], value[64];
+  int err = 0;
+
+  if(!tree) return -1;
+  json_pull_init(&p);
+  json_pull_feed(&p, doc, strlen(doc));
+  while(!err && (ev = json_pull_next(&p)) != json_pull_end) {
+    if(ev == json_pull_need_more) {
+      json_pull_feed(&p, NULL, 0);
+      continue;
+    }
+    if(ev == json_pull_error) err = -1;
+    if(json_pull_depth(&p) != 1 || ev < json_pull_key) continue;
+    if(ev == json_pull_key) {
+      json_pull_get_string(&p, key, sizeof(key));
+      continue;
+    }
+    if(!(val = json_object_object_get(tree, key))) {
+      err = ev == json_pull_null ? 0 : -1;
+    } else if(ev == json_pull_string) {
+      json_pull_get_string(&p, value, sizeof(value));
+      err = strcmp(value, json_object_get_string(val)) ? -1 : 0;
+    } else if(ev == json_pull_number || ev == json_pull_true || ev == json_pull_false) {
+      err = json_pull_get_int64(&p) != json_object_get_int64(val) ||
+	    json_pull_get_double(&p) != json_object_get_double(val) ||
+	    json_pull_get_boolean(&p) != json_object_get_boolean(val) ? -1 : 0;
+    }
+  }
+  json_object_put(tree);
+  return err;
+}
+
+/* The EasyLink keys read the way ConfigIncommingJsonMessageUAP does */
+static int json_pull_test_walk(const char *doc, int len)
+{
+  struct json_pull p;
+  enum json_pull_event ev;
+  char key[16], value[65];
+  int found = 0;
+
+  json_pull_init(&p);
+  json_pull_feed(&p, doc, len);
+  while((ev = json_pull_next(&p)) != json_pull_end) {
+    if(ev == json_pull_need_more) {
+      json_pull_feed(&p, NULL, 0);
+      continue;
+    }
+    if(ev == json_pull_error) return -1;
+    if(json_pull_depth(&p) != 1 || ev < json_pull_key) continue;
+    if(ev == json_pull_key) {
+      json_pull_get_string(&p, key, sizeof(key));
+      continue;
+    }
+    json_pull_get_string(&p, value, sizeof(value));
+    found++;
+  }
+  return found;
+}
+
+static int json_pull_test_tree(const char *doc, int len)
+{
+  struct json_object *tree;
+  int found = 0;
+
+  if(!(tree = json_tokener_parse(doc))) return -1;
+  json_object_object_foreach(tree, key, val) {
+    if(key[0] && json_object_get_string(val)) found++;
+  }
+  json_object_put(tree);
+  return found;
+}
+
+/* Microseconds per parse of doc with fn */
+static double json_pull_test_time(int (*fn)(const char *, int), const char *doc)
+{
+  unsigned long n = 0;
+  int len = strlen(doc);
+  clock_t start = clock(), elapsed;
+
+  do {
+    fn(doc, len);
+    n++;
+    elapsed = clock() - start;
+  } while(elapsed < JSON_PULL_TEST_SECONDS * CLOCKS_PER_SEC);
+
+  return (double)elapsed / CLOCKS_PER_SEC * 1e6 / n;
+}
+
+int json_pull_test(int print)
+{
+  static char whole[JSON_PULL_TEST_TRACE_SIZE], split[JSON_PULL_TEST_TRACE_SIZE];
+  unsigned i;
+  int chunk, len, err = 0;
+
+  for(i = 0; i < sizeof(json_pull_test_valid) / sizeof(json_pull_test_valid[0]); i++) {
+    len = strlen(json_pull_test_valid[i]);
+    if(json_pull_test_trace(json_pull_test_valid[i], len, whole, sizeof(whole)) != json_pull_end)
+      err = -1;
+    for(chunk = 1; !err && chunk < len; chunk++) {
+      if(json_pull_test_trace(json_pull_test_valid[i], chunk, split, sizeof(split)) != json_pull_end ||
+	 strcmp(whole, split)) err = -1;
+    }
+    if(!err && json_pull_test_valid[i][0] == '{' &&
+       json_pull_test_against_tree(json_pull_test_valid[i]) < 0) err = -1;
+    if(err) {
+      if(print) printf("json_pull_test: wrong events for %s\r\n", json_pull_test_valid[i]);
+      goto out;
+    }
+  }
+
+  for(i = 0; i < sizeof(json_pull_test_malformed) / sizeof(json_pull_test_malformed[0]); i++) {
+    len = strlen(json_pull_test_malformed[i]);
+    for(chunk = 1; !err && chunk <= len; chunk++) {
+      if(json_pull_test_trace(json_pull_test_malformed[i], chunk, split, sizeof(split)) != json_pull_error)
+	err = -1;
+    }
+    if(err) {
+      if(print) printf("json_pull_test: accepted %s\r\n", json_pull_test_malformed[i]);
+      goto out;
+    }
+  }
+
+  if(print) {
+    printf("%d byte EasyLink object: tree %.2f us, pull %.2f us\r\n",
+	   (int)strlen(json_pull_test_easylink),
+	   json_pull_test_time(json_pull_test_tree, json_pull_test_easylink),
+	   json_pull_test_time(json_pull_test_walk, json_pull_test_easylink));
+    printf("%d byte config object: tree %.2f us, pull %.2f us\r\n",
+	   (int)strlen(json_pull_test_config),
+	   json_pull_test_time(json_pull_test_tree, json_pull_test_config),
+	   json_pull_test_time(json_pull_test_walk, json_pull_test_config));
+  }
+
+out:
+  if(print) printf("json_pull_test: %s\r\n", err ? "FAILED" : "PASSED");
+  return err;
+}
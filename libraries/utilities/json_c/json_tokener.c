@@ -30,6 +30,7 @@
 #include "json_object.h"
 #include "json_tokener.h"
 #include "json_util.h"
+#include "json_arena.h"
 
 #include "StringUtils.h"
 
@@ -103,6 +104,10 @@ void json_tokener_reset(struct json_tokener *tok)
   if (!tok)
     return;
 
+  /* Once a root exists, putting it below releases the arena */
+  if(tok->arena && !tok->arena->root)
+    json_arena_free(tok->arena);
+  tok->arena = NULL;
   for(i = tok->depth; i >= 0; i--)
     json_tokener_reset_level(tok, i);
   tok->depth = 0;
@@ -122,6 +127,35 @@ struct json_object* json_tokener_parse(const char *str)
   return obj;
 }
 
+void json_tokener_set_arena_size(struct json_tokener *tok, size_t arena_size)
+{
+  tok->arena_size = arena_size;
+}
+
+struct json_object* json_tokener_parse_arena(const char *str, size_t arena_size)
+{
+  struct json_tokener* tok;
+  struct json_object* obj;
+
+  tok = json_tokener_new();
+  if(!tok) return NULL;
+  json_tokener_set_arena_size(tok, arena_size);
+  obj = json_tokener_parse_ex(tok, str, -1);
+  if(tok->err != json_tokener_success)
+    obj = NULL;
+  json_tokener_free(tok);
+  return obj;
+}
+
+/* Arena for the next object of the current document, created on demand.
+ * Falls back to the heap when the arena cannot be allocated. */
+static struct json_arena* json_tokener_arena(struct json_tokener *tok)
+{
+  if(tok->arena_size && !tok->arena)
+    tok->arena = json_arena_new(tok->arena_size);
+  return tok->arena;
+}
+
 struct json_object* json_tokener_parse_verbose(const char *str, enum json_tokener_error *error)
 {
     struct json_tokener* tok;
@@ -241,12 +275,12 @@ struct json_object* json_tokener_parse_ex(struct json_tokener *tok,
       case '{':
 	state = json_tokener_state_eatws;
 	saved_state = json_tokener_state_object_field_start;
-	current = json_object_new_object();
+	current = json_object_new_object_in(json_tokener_arena(tok));
 	break;
       case '[':
 	state = json_tokener_state_eatws;
 	saved_state = json_tokener_state_array;
-	current = json_object_new_array();
+	current = json_object_new_array_in(json_tokener_arena(tok));
 	break;
       case 'N':
       case 'n':
@@ -377,7 +411,7 @@ struct json_object* json_tokener_parse_ex(struct json_tokener *tok,
 	while(1) {
 	  if(c == tok->quote_char) {
 	    printbuf_memappend_fast(tok->pb, case_start, str-case_start);
-	    current = json_object_new_string(tok->pb->buf);
+	    current = json_object_new_string_in(json_tokener_arena(tok), tok->pb->buf);
 	    saved_state = json_tokener_state_finish;
 	    state = json_tokener_state_eatws;
 	    break;
@@ -525,7 +559,7 @@ struct json_object* json_tokener_parse_ex(struct json_tokener *tok,
       if(strncasecmp(json_true_str, tok->pb->buf,
 		     json_min(tok->st_pos+1, strlen(json_true_str))) == 0) {
 	if(tok->st_pos == strlen(json_true_str)) {
-	  current = json_object_new_boolean(1);
+	  current = json_object_new_boolean_in(json_tokener_arena(tok), 1);
 	  saved_state = json_tokener_state_finish;
 	  state = json_tokener_state_eatws;
 	  goto redo_char;
@@ -533,7 +567,7 @@ struct json_object* json_tokener_parse_ex(struct json_tokener *tok,
       } else if(strncasecmp(json_false_str, tok->pb->buf,
 			    json_min(tok->st_pos+1, strlen(json_false_str))) == 0) {
 	if(tok->st_pos == strlen(json_false_str)) {
-	  current = json_object_new_boolean(0);
+	  current = json_object_new_boolean_in(json_tokener_arena(tok), 0);
 	  saved_state = json_tokener_state_finish;
 	  state = json_tokener_state_eatws;
 	  goto redo_char;
@@ -565,9 +599,9 @@ struct json_object* json_tokener_parse_ex(struct json_tokener *tok,
 	int64_t num64;
 	double  numd;
 	if (!tok->is_double && json_parse_int64(tok->pb->buf, &num64) == 0) {
-		current = json_object_new_int64(num64);
+		current = json_object_new_int64_in(json_tokener_arena(tok), num64);
 	} else if(tok->is_double && sscanf(tok->pb->buf, "%lf", &numd) == 1) {
-          current = json_object_new_double(numd);
+          current = json_object_new_double_in(json_tokener_arena(tok), numd);
         } else {
           tok->err = json_tokener_error_parse_number;
           goto out;
@@ -704,7 +738,11 @@ struct json_object* json_tokener_parse_ex(struct json_tokener *tok,
       tok->err = json_tokener_error_parse_eof;
   }
 
-  if(tok->err == json_tokener_success) return json_object_get(current);
+  if(tok->err == json_tokener_success) {
+    /* The document now owns its arena through the root */
+    tok->arena = NULL;
+    return json_object_get(current);
+  }
   MC_DEBUG("json_tokener_parse_ex: error %s at offset %d\n",
 	   json_tokener_errors[tok->err], tok->char_offset);
   return NULL;
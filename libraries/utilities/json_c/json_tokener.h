@@ -80,6 +80,10 @@ struct json_tokener
   unsigned int ucs_char;
   char quote_char;
   struct json_tokener_srec stack[JSON_TOKENER_MAX_DEPTH];
+  /* Block size of the per-document arena, 0 to parse onto the heap */
+  size_t arena_size;
+  /* Arena of the document being parsed, handed to its root on success */
+  struct json_arena *arena;
 };
 
 extern const char* json_tokener_errors[];
@@ -92,6 +96,19 @@ extern struct json_object* json_tokener_parse_verbose(const char *str, enum json
 extern struct json_object* json_tokener_parse_ex(struct json_tokener *tok,
 						 const char *str, int len);
 
+/**
+ * Allocate every document parsed by tok from its own arena made of
+ * arena_size byte blocks, 0 restores heap allocation. Putting the
+ * returned root releases the whole document at once.
+ */
+extern void json_tokener_set_arena_size(struct json_tokener *tok, size_t arena_size);
+
+/**
+ * json_tokener_parse using a per-document arena, see
+ * json_tokener_set_arena_size.
+ */
+extern struct json_object* json_tokener_parse_arena(const char *str, size_t arena_size);
+
 #ifdef __cplusplus
 }
 #endif
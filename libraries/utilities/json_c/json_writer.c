@@ -0,0 +1,332 @@
+/*
+ * Streaming JSON emitter writing through a fixed size buffer.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "linkhash.h"
+#include "json_inttypes.h"
+#include "json_object.h"
+#include "json_writer.h"
+
+/* Per level state: container type and whether it already holds a value */
+#define JSON_WRITER_OBJECT   0x01
+#define JSON_WRITER_NONEMPTY 0x02
+
+void json_writer_init(struct json_writer *w, char *buf, int size,
+		      json_writer_sink_fn *sink, void *ctx)
+{
+  memset(w, 0, sizeof(struct json_writer));
+  w->sink = sink;
+  w->ctx = ctx;
+  w->buf = buf;
+  w->size = buf ? size : 0;
+}
+
+static void json_writer_put(struct json_writer *w, const char *s, int len)
+{
+  int n;
+
+  if(w->err) return;
+  w->length += len;
+  if(!w->buf) return;
+  while(len > 0) {
+    if(w->pos == w->size) {
+      if(!w->sink) {
+	w->err = -1;
+	return;
+      }
+      if((n = w->sink(w->ctx, w->buf, w->pos)) != 0) {
+	w->err = n;
+	return;
+      }
+      w->pos = 0;
+    }
+    n = w->size - w->pos;
+    if(n > len) n = len;
+    memcpy(w->buf + w->pos, s, n);
+    w->pos += n;
+    s += n;
+    len -= n;
+  }
+}
+
+/* Same escaping as json_escape_str in json_object.c */
+static void json_writer_escape(struct json_writer *w, const char *str, int len)
+{
+  static const char hex[] = "0123456789abcdef";
+  int pos = 0, start_offset = 0;
+  unsigned char c;
+  char esc[6];
+
+  while(pos < len) {
+    c = str[pos];
+    switch(c) {
+    case '\b': esc[1] = 'b'; break;
+    case '\n': esc[1] = 'n'; break;
+    case '\r': esc[1] = 'r'; break;
+    case '\t': esc[1] = 't'; break;
+    case '"':
+    case '\\':
+    case '/':  esc[1] = c; break;
+    default:
+      if(c >= ' ') {
+	pos++;
+	continue;
+      }
+      esc[1] = 'u';
+    }
+    if(pos > start_offset)
+      json_writer_put(w, str + start_offset, pos - start_offset);
+    esc[0] = '\\';
+    if(esc[1] == 'u') {
+      esc[2] = '0';
+      esc[3] = '0';
+      esc[4] = hex[c >> 4];
+      esc[5] = hex[c & 0xf];
+      json_writer_put(w, esc, 6);
+    } else {
+      json_writer_put(w, esc, 2);
+    }
+    start_offset = ++pos;
+  }
+  if(pos > start_offset)
+    json_writer_put(w, str + start_offset, pos - start_offset);
+}
+
+/* Emit whatever separates this value from the previous one */
+static void json_writer_sep(struct json_writer *w)
+{
+  unsigned char *st;
+
+  if(w->after_key) {
+    w->after_key = 0;
+    return;
+  }
+  if(!w->depth) return;
+  st = &w->state[w->depth - 1];
+  if(*st & JSON_WRITER_OBJECT) {
+    /* A value inside an object needs a key first */
+    if(!w->err) w->err = -1;
+    return;
+  }
+  if(*st & JSON_WRITER_NONEMPTY) json_writer_put(w, ", ", 2);
+  else json_writer_put(w, " ", 1);
+  *st |= JSON_WRITER_NONEMPTY;
+}
+
+static int json_writer_begin(struct json_writer *w, unsigned char type,
+			     const char *open)
+{
+  json_writer_sep(w);
+  if(w->depth == JSON_WRITER_MAX_DEPTH && !w->err) w->err = -1;
+  if(w->err) return w->err;
+  w->state[w->depth++] = type;
+  json_writer_put(w, open, 1);
+  return w->err;
+}
+
+static int json_writer_end(struct json_writer *w, unsigned char type,
+			   const char *close)
+{
+  if(!w->err && (!w->depth || w->after_key ||
+		 (w->state[w->depth - 1] & JSON_WRITER_OBJECT) != type))
+    w->err = -1;
+  if(w->err) return w->err;
+  w->depth--;
+  json_writer_put(w, close, 2);
+  return w->err;
+}
+
+int json_writer_begin_object(struct json_writer *w)
+{
+  return json_writer_begin(w, JSON_WRITER_OBJECT, "{");
+}
+
+int json_writer_end_object(struct json_writer *w)
+{
+  return json_writer_end(w, JSON_WRITER_OBJECT, " }");
+}
+
+int json_writer_begin_array(struct json_writer *w)
+{
+  return json_writer_begin(w, 0, "[");
+}
+
+int json_writer_end_array(struct json_writer *w)
+{
+  return json_writer_end(w, 0, " ]");
+}
+
+int json_writer_key(struct json_writer *w, const char *key)
+{
+  unsigned char *st;
+
+  if(!w->err && (!w->depth || w->after_key ||
+		 !(w->state[w->depth - 1] & JSON_WRITER_OBJECT)))
+    w->err = -1;
+  if(w->err) return w->err;
+  st = &w->state[w->depth - 1];
+  if(*st & JSON_WRITER_NONEMPTY) json_writer_put(w, ", \"", 3);
+  else json_writer_put(w, " \"", 2);
+  *st |= JSON_WRITER_NONEMPTY;
+  json_writer_escape(w, key, strlen(key));
+  json_writer_put(w, "\": ", 3);
+  w->after_key = 1;
+  return w->err;
+}
+
+int json_writer_string(struct json_writer *w, const char *s)
+{
+  return json_writer_string_len(w, s, strlen(s));
+}
+
+int json_writer_string_len(struct json_writer *w, const char *s, int len)
+{
+  json_writer_sep(w);
+  json_writer_put(w, "\"", 1);
+  json_writer_escape(w, s, len);
+  json_writer_put(w, "\"", 1);
+  return w->err;
+}
+
+int json_writer_int64(struct json_writer *w, int64_t i)
+{
+  char digits[21];
+  int pos = sizeof(digits);
+  uint64_t v = (i < 0) ? 0 - (uint64_t)i : (uint64_t)i;
+
+  do {
+    digits[--pos] = '0' + (char)(v % 10);
+    v /= 10;
+  } while(v);
+  if(i < 0) digits[--pos] = '-';
+  json_writer_sep(w);
+  json_writer_put(w, digits + pos, sizeof(digits) - pos);
+  return w->err;
+}
+
+int json_writer_double(struct json_writer *w, double d)
+{
+  char num[32];
+  int len;
+
+  len = snprintf(num, sizeof(num), "%g", d);
+  if(len < 0 || len >= (int)sizeof(num)) {
+    if(!w->err) w->err = -1;
+    return w->err;
+  }
+  json_writer_sep(w);
+  json_writer_put(w, num, len);
+  return w->err;
+}
+
+int json_writer_boolean(struct json_writer *w, boolean b)
+{
+  json_writer_sep(w);
+  if(b) json_writer_put(w, "true", 4);
+  else json_writer_put(w, "false", 5);
+  return w->err;
+}
+
+int json_writer_null(struct json_writer *w)
+{
+  json_writer_sep(w);
+  json_writer_put(w, "null", 4);
+  return w->err;
+}
+
+int json_writer_value(struct json_writer *w, struct json_object *jso)
+{
+  struct json_object_iter iter;
+  int i, n;
+
+  if(!jso) return json_writer_null(w);
+
+  switch(json_object_get_type(jso)) {
+  case json_type_boolean:
+    return json_writer_boolean(w, json_object_get_boolean(jso));
+  case json_type_double:
+    return json_writer_double(w, json_object_get_double(jso));
+  case json_type_int:
+    return json_writer_int64(w, json_object_get_int64(jso));
+  case json_type_string:
+    return json_writer_string_len(w, json_object_get_string(jso),
+				  json_object_get_string_len(jso));
+  case json_type_object:
+    json_writer_begin_object(w);
+    json_object_object_foreachC(jso, iter) {
+      if(w->err) break;
+      json_writer_key(w, iter.key);
+      json_writer_value(w, iter.val);
+    }
+    return json_writer_end_object(w);
+  case json_type_array:
+    json_writer_begin_array(w);
+    n = json_object_array_length(jso);
+    for(i = 0; i < n && !w->err; i++)
+      json_writer_value(w, json_object_array_get_idx(jso, i));
+    return json_writer_end_array(w);
+  default:
+    return json_writer_null(w);
+  }
+}
+
+int json_writer_finish(struct json_writer *w)
+{
+  int err;
+
+  if(!w->err && (w->depth || w->after_key)) w->err = -1;
+  if(w->err || !w->buf) return w->err;
+  if(w->sink) {
+    if(w->pos && (err = w->sink(w->ctx, w->buf, w->pos)) != 0) {
+      w->err = err;
+      return err;
+    }
+    w->pos = 0;
+  } else {
+    if(w->pos == w->size) {
+      w->err = -1;
+      return w->err;
+    }
+    w->buf[w->pos] = '\0';
+  }
+  return 0;
+}
+
+int json_object_to_sink(struct json_object *jso, char *buf, int size,
+			json_writer_sink_fn *sink, void *ctx)
+{
+  struct json_writer w;
+
+  json_writer_init(&w, buf, size, sink, ctx);
+  json_writer_value(&w, jso);
+  return json_writer_finish(&w);
+}
+
+int json_object_to_json_length(struct json_object *jso)
+{
+  struct json_writer w;
+
+  json_writer_init(&w, NULL, 0, NULL, NULL);
+  json_writer_value(&w, jso);
+  if(json_writer_finish(&w) != 0) return -1;
+  return w.length;
+}
+
+int json_object_to_buffer(struct json_object *jso, char *buf, int size)
+{
+  struct json_writer w;
+
+  json_writer_init(&w, buf, size, NULL, NULL);
+  json_writer_value(&w, jso);
+  if(json_writer_finish(&w) != 0) return -1;
+  return w.length;
+}
@@ -0,0 +1,120 @@
+/*
+ * Streaming JSON emitter writing through a fixed size buffer.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+#ifndef _json_writer_h_
+#define _json_writer_h_
+
+#include "json_inttypes.h"
+#include "json_object.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Maximum nesting of arrays and objects the writer accepts.
+ */
+#ifndef JSON_WRITER_MAX_DEPTH
+#define JSON_WRITER_MAX_DEPTH 32
+#endif
+
+/**
+ * Sink receiving the output whenever the writer buffer is full, and once
+ * more from json_writer_finish for the remainder.
+ * @returns 0 on success, any other value aborts the writer and is
+ * returned by json_writer_finish
+ */
+typedef int (json_writer_sink_fn)(void *ctx, const char *buf, int len);
+
+/**
+ * The writer produces exactly the text of json_object_to_json_string, but
+ * never holds more than one buffer of it. Three modes are supported:
+ * - buf and sink: buf is flushed to the sink each time it fills up
+ * - buf only: the document must fit into buf, it is NUL terminated
+ * - neither: nothing is written, only the length is counted
+ */
+struct json_writer {
+  json_writer_sink_fn *sink;
+  void *ctx;
+  char *buf;
+  int size;
+  int pos;
+  /**
+   * Length of the document emitted so far, flushed or not.
+   */
+  int length;
+  int depth;
+  int after_key;
+  int err;
+  unsigned char state[JSON_WRITER_MAX_DEPTH];
+};
+
+extern void json_writer_init(struct json_writer *w, char *buf, int size,
+			     json_writer_sink_fn *sink, void *ctx);
+
+/**
+ * Explicit emitter calls. Inside an object every value must be preceded
+ * by json_writer_key. Each call returns 0, or the error that stopped the
+ * writer; once stopped all further calls are ignored.
+ */
+extern int json_writer_begin_object(struct json_writer *w);
+extern int json_writer_end_object(struct json_writer *w);
+extern int json_writer_begin_array(struct json_writer *w);
+extern int json_writer_end_array(struct json_writer *w);
+extern int json_writer_key(struct json_writer *w, const char *key);
+extern int json_writer_string(struct json_writer *w, const char *s);
+extern int json_writer_string_len(struct json_writer *w, const char *s, int len);
+extern int json_writer_int64(struct json_writer *w, int64_t i);
+extern int json_writer_double(struct json_writer *w, double d);
+extern int json_writer_boolean(struct json_writer *w, boolean b);
+extern int json_writer_null(struct json_writer *w);
+
+/**
+ * Emit a whole json_object tree as one value.
+ */
+extern int json_writer_value(struct json_writer *w, struct json_object *jso);
+
+/**
+ * Hand the buffered remainder to the sink, or NUL terminate it.
+ * @returns 0 on success, -1 if the document was malformed or did not fit
+ * into buf, or the error returned by the sink
+ */
+extern int json_writer_finish(struct json_writer *w);
+
+/**
+ * Serialize jso through sink using buf as the chunk buffer.
+ * @returns as json_writer_finish
+ */
+extern int json_object_to_sink(struct json_object *jso, char *buf, int size,
+			       json_writer_sink_fn *sink, void *ctx);
+
+/**
+ * Length of the JSON text of jso, without the terminating NUL. Lets
+ * callers that need the size up front (Content-Length, MQTT payloads)
+ * allocate exactly once.
+ */
+extern int json_object_to_json_length(struct json_object *jso);
+
+/**
+ * Serialize jso into buf and NUL terminate it.
+ * @returns the length of the text, or -1 if it does not fit
+ */
+extern int json_object_to_buffer(struct json_object *jso, char *buf, int size);
+
+/**
+ * Checks of the writer against json_object_to_json_string, see
+ * json_writer_test.c.
+ * @returns 0 if they all pass
+ */
+extern int json_writer_test(int print);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
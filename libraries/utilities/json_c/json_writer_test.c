@@ -0,0 +1,230 @@
+/*
+ * Checks of the streaming JSON writer against json_object_to_json_string,
+ * and a comparison of their speed and peak memory. Built on the host with
+ * the rest of json_c; not part of the default build.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "json.h"
+#include "json_object_private.h"
+#include "printbuf.h"
+
+#define JSON_TEST_TREES 3000
+#define JSON_TEST_MAX_CHUNK 64
+#define JSON_TEST_OUT_SIZE (1 << 16)
+#define JSON_TEST_SECONDS 1
+
+struct json_test_sink {
+  char *out;
+  int len;
+  int calls;
+  int max_len;
+  int fail_after; /* Sink calls before it fails, 0 for never */
+};
+
+static int json_test_sink(void *ctx, const char *buf, int len)
+{
+  struct json_test_sink *s = (struct json_test_sink*)ctx;
+
+  if(len <= 0 || s->len + len > JSON_TEST_OUT_SIZE) return -1;
+  if(s->fail_after && ++s->calls >= s->fail_after) return -42;
+  memcpy(s->out + s->len, buf, len);
+  s->len += len;
+  if(len > s->max_len) s->max_len = len;
+  return 0;
+}
+
+static int json_test_discard(void *ctx, const char *buf, int len)
+{
+  return 0;
+}
+
+static unsigned long json_test_seed = 1;
+
+static int json_test_rand(int n)
+{
+  json_test_seed = json_test_seed * 1103515245 + 12345;
+  return (int)((json_test_seed >> 16) % n);
+}
+
+/* A random tree with every value type and strings that need escaping */
+static struct json_object* json_test_tree(int depth)
+{
+  static const char chars[] = "ab\"\\/\n\t\x01xyz";
+  struct json_object *o;
+  char s[16];
+  int i, n;
+
+  switch(json_test_rand(depth > 4 ? 5 : 8)) {
+  case 0: return json_object_new_int(json_test_rand(2000000) - 1000000);
+  case 1: return json_object_new_double(json_test_rand(1000) / 7.0);
+  case 2: return json_object_new_boolean(json_test_rand(2));
+  case 3:
+    for(i = 0; i < 15; i++) s[i] = chars[json_test_rand(sizeof(chars) - 1)];
+    s[15] = '\0';
+    return json_object_new_string(s);
+  case 4: return NULL;
+  case 5: case 6:
+    o = json_object_new_object();
+    n = json_test_rand(6);
+    for(i = 0; i < n; i++) {
+      sprintf(s, "k%d\"/", i);
+      json_object_object_add(o, s, json_test_tree(depth + 1));
+    }
+    return o;
+  default:
+    o = json_object_new_array();
+    n = json_test_rand(6);
+    for(i = 0; i < n; i++) json_object_array_add(o, json_test_tree(depth + 1));
+    return o;
+  }
+}
+
+/* One tree through every output mode of the writer */
+static int json_test_check_tree(struct json_object *o, struct json_test_sink *s)
+{
+  static char fixed[JSON_TEST_OUT_SIZE];
+  char chunk[JSON_TEST_MAX_CHUNK];
+  const char *ref = json_object_to_json_string(o);
+  int ref_len = strlen(ref), size = 1 + json_test_rand(JSON_TEST_MAX_CHUNK);
+
+  s->len = s->calls = s->max_len = s->fail_after = 0;
+  if(json_object_to_sink(o, chunk, size, json_test_sink, s) != 0) return -1;
+  if(s->len != ref_len || memcmp(s->out, ref, ref_len)) return -1;
+  if(s->max_len > size) return -1;
+
+  if(json_object_to_json_length(o) != ref_len) return -1;
+  if(json_object_to_buffer(o, fixed, sizeof(fixed)) != ref_len ||
+     strcmp(fixed, ref)) return -1;
+  if(ref_len > 1 && json_object_to_buffer(o, fixed, ref_len) != -1) return -1;
+
+  /* A sink error stops the writer and comes back from it */
+  if(ref_len > 8) {
+    s->len = s->calls = 0;
+    s->fail_after = 1;
+    if(json_object_to_sink(o, chunk, 4, json_test_sink, s) != -42) return -1;
+  }
+  return 0;
+}
+
+/* The explicit calls, and the sequences the writer must refuse */
+static int json_test_check_calls(struct json_test_sink *s)
+{
+  static const char expect[] =
+    "{ \"a\": -9223372036854775808, \"b\": [ null, \"x\\/y\" ], \"c\": { } }";
+  struct json_writer w;
+  char chunk[8];
+
+  s->len = s->calls = s->max_len = s->fail_after = 0;
+  json_writer_init(&w, chunk, sizeof(chunk), json_test_sink, s);
+  json_writer_begin_object(&w);
+  json_writer_key(&w, "a");
+  json_writer_int64(&w, -9223372036854775807LL - 1);
+  json_writer_key(&w, "b");
+  json_writer_begin_array(&w);
+  json_writer_null(&w);
+  json_writer_string(&w, "x/y");
+  json_writer_end_array(&w);
+  json_writer_key(&w, "c");
+  json_writer_begin_object(&w);
+  json_writer_end_object(&w);
+  json_writer_end_object(&w);
+  if(json_writer_finish(&w) != 0) return -1;
+  if(s->len != (int)strlen(expect) || memcmp(s->out, expect, s->len)) return -1;
+
+  /* Value without a key, then an unclosed array */
+  json_writer_init(&w, chunk, sizeof(chunk), json_test_sink, s);
+  json_writer_begin_object(&w);
+  json_writer_int64(&w, 1);
+  if(json_writer_finish(&w) != -1) return -1;
+  json_writer_init(&w, chunk, sizeof(chunk), json_test_sink, s);
+  json_writer_begin_array(&w);
+  if(json_writer_finish(&w) != -1) return -1;
+  return 0;
+}
+
+/* A device report of nested objects, about 4.5 KB of JSON */
+static struct json_object* json_test_report(void)
+{
+  struct json_object *report = json_object_new_object(), *list, *item;
+  char name[32];
+  int i;
+
+  list = json_object_new_array();
+  for(i = 0; i < 64; i++) {
+    item = json_object_new_object();
+    sprintf(name, "Sensor %d", i);
+    json_object_object_add(item, "name", json_object_new_string(name));
+    json_object_object_add(item, "value", json_object_new_double(i * 1.25));
+    json_object_object_add(item, "enabled", json_object_new_boolean(i & 1));
+    json_object_object_add(item, "id", json_object_new_int(1000 + i));
+    json_object_array_add(list, item);
+  }
+  json_object_object_add(report, "Device Name", json_object_new_string("MiCOKit"));
+  json_object_object_add(report, "sensors", list);
+  return report;
+}
+
+/* Reports per second through the writer with chunk bytes of buffer, or
+ * through json_object_to_json_string with chunk 0 */
+static unsigned long json_test_rate(struct json_object *report, int chunk)
+{
+  char buf[1024];
+  unsigned long n = 0;
+  clock_t start = clock(), elapsed;
+
+  do {
+    if(chunk) {
+      json_object_to_sink(report, buf, chunk, json_test_discard, NULL);
+    } else {
+      /* A fresh printbuf each time, as for a newly built document */
+      printbuf_free(report->_pb);
+      report->_pb = NULL;
+      json_object_to_json_string(report);
+    }
+    n++;
+    elapsed = clock() - start;
+  } while(elapsed < JSON_TEST_SECONDS * CLOCKS_PER_SEC);
+
+  return (unsigned long)((double)n * CLOCKS_PER_SEC / elapsed);
+}
+
+int json_writer_test(int print)
+{
+  struct json_test_sink s;
+  struct json_object *o;
+  int i, err = 0;
+
+  s.out = (char*)malloc(JSON_TEST_OUT_SIZE);
+  if(!s.out) return -1;
+
+  for(i = 0; i < JSON_TEST_TREES && !err; i++) {
+    o = json_test_tree(0);
+    err = json_test_check_tree(o, &s);
+    json_object_put(o);
+  }
+  if(!err) err = json_test_check_calls(&s);
+
+  if(!err && print) {
+    o = json_test_report();
+    printf("%d byte report: printbuf %lu/s", json_object_to_json_length(o),
+	   json_test_rate(o, 0));
+    printf(" in %d bytes, writer %lu/s in 256 bytes, %lu/s in 1024 bytes\r\n",
+	   o->_pb->size, json_test_rate(o, 256), json_test_rate(o, 1024));
+    json_object_put(o);
+  }
+
+  free(s.out);
+  if(print) printf("json_writer_test: %s\r\n", err ? "FAILED" : "PASSED");
+  return err;
+}
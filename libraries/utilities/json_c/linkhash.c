@@ -19,6 +19,7 @@
 #include "common.h"
 
 #include "linkhash.h"
+#include "json_arena.h"
 
 void lh_abort(const char *msg, ...)
 {
@@ -40,16 +41,44 @@ int lh_ptr_equal(const void *k1, const void *k2)
 	return (k1 == k2);
 }
 
-unsigned long lh_char_hash(const void *k)
+/*
+ * One multiply per 32 bit word, in the style of MurmurHash2. Words are
+ * loaded with memcpy, which compiles to a single unaligned load on the
+ * Cortex-M3/M4 parts.
+ */
+static unsigned long lh_char_hash_len(const char *data, size_t len)
 {
-	unsigned int h = 0;
-	const char* data = (const char*)k;
- 
-	while( *data!=0 ) h = h*129 + (unsigned int)(*data++) + LH_PRIME;
-
+	unsigned int h = (unsigned int)(LH_PRIME ^ len);
+	unsigned int w;
+
+	while(len >= 4) {
+		memcpy(&w, data, 4);
+		w *= 0x5bd1e995;
+		w ^= w >> 24;
+		w *= 0x5bd1e995;
+		h = (h * 0x5bd1e995) ^ w;
+		data += 4;
+		len -= 4;
+	}
+	switch(len) {
+	case 3: h ^= (unsigned int)(unsigned char)data[2] << 16;
+		/* fall through */
+	case 2: h ^= (unsigned int)(unsigned char)data[1] << 8;
+		/* fall through */
+	case 1: h ^= (unsigned int)(unsigned char)data[0];
+		h *= 0x5bd1e995;
+	}
+	h ^= h >> 13;
+	h *= 0x5bd1e995;
+	h ^= h >> 15;
 	return h;
 }
 
+unsigned long lh_char_hash(const void *k)
+{
+	return lh_char_hash_len((const char*)k, strlen((const char*)k));
+}
+
 int lh_char_equal(const void *k1, const void *k2)
 {
 	return (strcmp((const char*)k1, (const char*)k2) == 0);
@@ -60,19 +89,28 @@ struct lh_table* lh_table_new(int size, const char *name,
 			      lh_hash_fn *hash_fn,
 			      lh_equal_fn *equal_fn)
 {
-	int i;
+	return lh_table_new_in(NULL, size, name, free_fn, hash_fn, equal_fn);
+}
+
+struct lh_table* lh_table_new_in(struct json_arena *arena,
+				 int size, const char *name,
+				 lh_entry_free_fn *free_fn,
+				 lh_hash_fn *hash_fn,
+				 lh_equal_fn *equal_fn)
+{
 	struct lh_table *t;
 
-	t = (struct lh_table*)calloc(1, sizeof(struct lh_table));
+	if(size < 1) size = 1;
+	t = (struct lh_table*)json_arena_calloc(arena, 1, sizeof(struct lh_table));
 	if(!t) lh_abort("lh_table_new: calloc failed 1, size = %d\n", sizeof(struct lh_table));
-	t->count = 0;
 	t->size = size;
-	t->table = (struct lh_entry*)calloc(size, sizeof(struct lh_entry));
+	t->table = (struct lh_entry*)json_arena_alloc(arena, size * sizeof(struct lh_entry));
 	if(!t->table) lh_abort("lh_table_new: calloc failed 2, size = %d\n", sizeof(struct lh_table));
 	t->free_fn = free_fn;
 	t->hash_fn = hash_fn;
 	t->equal_fn = equal_fn;
-	for(i = 0; i < size; i++) t->table[i].k = LH_EMPTY;
+	t->arena = arena;
+	t->kchar = (hash_fn == lh_char_hash && equal_fn == lh_char_equal);
 	return t;
 }
 
@@ -82,29 +120,112 @@ struct lh_table* lh_kchar_table_new(int size, const char *name,
 	return lh_table_new(size, name, free_fn, lh_char_hash, lh_char_equal);
 }
 
+struct lh_table* lh_kchar_table_new_in(struct json_arena *arena,
+				       int size, const char *name,
+				       lh_entry_free_fn *free_fn)
+{
+	return lh_table_new_in(arena, size, name, free_fn, lh_char_hash, lh_char_equal);
+}
+
 struct lh_table* lh_kptr_table_new(int size, const char *name,
 				   lh_entry_free_fn *free_fn)
 {
 	return lh_table_new(size, name, free_fn, lh_ptr_hash, lh_ptr_equal);
 }
 
-void lh_table_resize(struct lh_table *t, int new_size)
+static unsigned long lh_table_hash(struct lh_table *t, const void *k,
+				   unsigned short *klen)
 {
-	struct lh_table *new_t;
-	struct lh_entry *ent;
+	size_t len;
 
-	new_t = lh_table_new(new_size, NULL, NULL, t->hash_fn, t->equal_fn);
-	ent = t->head;
-	while(ent) {
-		lh_table_insert(new_t, ent->k, ent->v);
-		ent = ent->next;
+	if(!t->kchar) {
+		*klen = 0;
+		return t->hash_fn(k);
 	}
-	free(t->table);
-	t->table = new_t->table;
-	t->size = new_size;
-	t->head = new_t->head;
-	t->tail = new_t->tail;
-	free(new_t);
+	len = strlen((const char*)k);
+	*klen = len > USHRT_MAX ? USHRT_MAX : (unsigned short)len;
+	return lh_char_hash_len((const char*)k, len);
+}
+
+static int lh_table_key_equal(struct lh_table *t, struct lh_entry *e,
+			      const void *k, unsigned long h,
+			      unsigned short klen)
+{
+	if(e->k == LH_FREED || e->hash != h) return 0;
+	if(!t->kchar) return t->equal_fn(e->k, k);
+	if(e->klen != klen) return 0;
+	if(klen < USHRT_MAX) return memcmp(e->k, k, klen) == 0;
+	return strcmp((const char*)e->k, (const char*)k) == 0;
+}
+
+static void lh_table_index_put(struct lh_table *t, int pos)
+{
+	unsigned long n = t->table[pos].hash & t->index_mask;
+
+	while(t->index[n]) n = (n + 1) & t->index_mask;
+	t->index[n] = (unsigned short)(pos + 1);
+}
+
+/* (Re)build the index for the current entries, or drop it for small tables */
+static void lh_table_reindex(struct lh_table *t)
+{
+	unsigned long slots;
+	int i;
+
+	json_arena_release(t->arena, t->index);
+	t->index = NULL;
+	t->index_mask = 0;
+	if(t->used <= LH_INLINE_MAX) return;
+
+	/* Keep the load factor below 3/4 with room for the slots still free */
+	for(slots = 16; slots * 3 <= (unsigned long)t->size * 4; slots <<= 1);
+	t->index = (unsigned short*)json_arena_calloc(t->arena, slots, sizeof(unsigned short));
+	if(!t->index) lh_abort("lh_table_reindex: calloc failed, slots = %d\n", slots);
+	t->index_mask = (unsigned short)(slots - 1);
+	for(i = 0; i < t->used; i++)
+		if(t->table[i].k != LH_FREED) lh_table_index_put(t, i);
+}
+
+/* Squeeze out deleted entries and relink the list over the array */
+static void lh_table_relink(struct lh_table *t)
+{
+	struct lh_entry *e;
+	int i, n;
+
+	for(i = 0, n = 0; i < t->used; i++) {
+		if(t->table[i].k == LH_FREED) continue;
+		if(i != n) t->table[n] = t->table[i];
+		n++;
+	}
+	t->used = n;
+	t->head = t->tail = NULL;
+	for(i = 0; i < n; i++) {
+		e = &t->table[i];
+		e->next = NULL;
+		if(t->tail) t->tail->next = e;
+		else t->head = e;
+		t->tail = e;
+	}
+}
+
+void lh_table_resize(struct lh_table *t, int new_size)
+{
+	struct lh_entry *table;
+
+	lh_table_relink(t);
+	if(new_size < t->used) new_size = t->used;
+	if(new_size > USHRT_MAX) new_size = USHRT_MAX;
+	if(new_size < 1) new_size = 1;
+	if(new_size != t->size) {
+		table = (struct lh_entry*)json_arena_realloc(t->arena, t->table,
+							      t->size * sizeof(struct lh_entry),
+							      new_size * sizeof(struct lh_entry));
+		if(!table) lh_abort("lh_table_resize: realloc failed, size = %d\n", new_size);
+		t->table = table;
+		t->size = new_size;
+		lh_table_relink(t);
+	}
+	lh_table_reindex(t);
 }
 
 void lh_table_free(struct lh_table *t)
@@ -115,39 +236,46 @@ void lh_table_free(struct lh_table *t)
 			t->free_fn(c);
 		}
 	}
-	free(t->table);
-	free(t);
+	json_arena_release(t->arena, t->index);
+	json_arena_release(t->arena, t->table);
+	json_arena_release(t->arena, t);
 }
 
 
 int lh_table_insert(struct lh_table *t, void *k, const void *v)
 {
-	unsigned long h, n;
-
-	//if(t->count > t->size * 0.66) lh_table_resize(t, t->size * 2); 
-	if(t->count >= t->size) lh_table_resize(t, t->size + 1); 
-
-	h = t->hash_fn(k);
-	n = h % t->size;
-
-	while( 1 ) {
-		if(t->table[n].k == LH_EMPTY || t->table[n].k == LH_FREED) break;
-		if(++n == t->size) n = 0;
+	struct lh_entry *e;
+	int grow;
+
+	if(t->used == t->size) {
+		if(t->count < t->used) {
+			/* Reuse the slots of deleted entries first */
+			lh_table_resize(t, t->size);
+		} else if(t->size == USHRT_MAX) {
+			return -1;
+		} else {
+			/* Small heap tables stay exactly sized, everything else grows
+			 * geometrically so inserts do not copy the table each time */
+			if(t->arena) grow = t->size;
+			else if(t->size < LH_INLINE_MAX) grow = 1;
+			else grow = t->size / 2;
+			lh_table_resize(t, t->size + grow);
+		}
 	}
 
-	t->table[n].k = k;
-	t->table[n].v = v;
+	e = &t->table[t->used];
+	e->k = k;
+	e->v = v;
+	e->hash = lh_table_hash(t, k, &e->klen);
+	e->next = NULL;
+	if(t->tail) t->tail->next = e;
+	else t->head = e;
+	t->tail = e;
+	t->used++;
 	t->count++;
 
-	if(t->head == NULL) {
-		t->head = t->tail = &t->table[n];
-		t->table[n].next = t->table[n].prev = NULL;
-	} else {
-		t->tail->next = &t->table[n];
-		t->table[n].prev = t->tail;
-		t->table[n].next = NULL;
-		t->tail = &t->table[n];
-	}
+	if(t->index) lh_table_index_put(t, t->used - 1);
+	else if(t->used > LH_INLINE_MAX) lh_table_reindex(t);
 
 	return 0;
 }
@@ -155,17 +283,18 @@ int lh_table_insert(struct lh_table *t, void *k, const void *v)
 
 struct lh_entry* lh_table_lookup_entry(struct lh_table *t, const void *k)
 {
-	unsigned long h = t->hash_fn(k);
-	unsigned long n = h % t->size;
-	int count = 0;
+	unsigned short klen, pos;
+	unsigned long h = lh_table_hash(t, k, &klen);
+	unsigned long n;
+	int i;
 
-	while( count < t->size ) {
-		if(t->table[n].k == LH_EMPTY) return NULL;
-		if(t->table[n].k != LH_FREED &&
-		   t->equal_fn(t->table[n].k, k)) return &t->table[n];
-		if(++n == t->size) n = 0;
-		count++;
+	if(!t->index) {
+		for(i = 0; i < t->used; i++)
+			if(lh_table_key_equal(t, &t->table[i], k, h, klen)) return &t->table[i];
+		return NULL;
 	}
+	for(n = h & t->index_mask; (pos = t->index[n]) != 0; n = (n + 1) & t->index_mask)
+		if(lh_table_key_equal(t, &t->table[pos - 1], k, h, klen)) return &t->table[pos - 1];
 	return NULL;
 }
 
@@ -181,28 +310,31 @@ const void* lh_table_lookup(struct lh_table *t, const void *k)
 int lh_table_delete_entry(struct lh_table *t, struct lh_entry *e)
 {
 	ptrdiff_t n = (ptrdiff_t)(e - t->table); /* CAW: fixed to be 64bit nice, still need the crazy negative case... */
+	struct lh_entry *prev = NULL;
+	ptrdiff_t i;
 
 	/* CAW: this is bad, really bad, maybe stack goes other direction on this machine... */
-	if(n < 0) { return -2; }
+	if(n < 0 || n >= t->used) { return -2; }
 
-	if(t->table[n].k == LH_EMPTY || t->table[n].k == LH_FREED) return -1;
+	if(t->table[n].k == LH_FREED) return -1;
 	t->count--;
 	if(t->free_fn) t->free_fn(e);
-	t->table[n].v = NULL;
-	t->table[n].k = LH_FREED;
-	if(t->tail == &t->table[n] && t->head == &t->table[n]) {
-		t->head = t->tail = NULL;
-	} else if (t->head == &t->table[n]) {
-		t->head->next->prev = NULL;
-		t->head = t->head->next;
-	} else if (t->tail == &t->table[n]) {
-		t->tail->prev->next = NULL;
-		t->tail = t->tail->prev;
-	} else {
-		t->table[n].prev->next = t->table[n].next;
-		t->table[n].next->prev = t->table[n].prev;
+
+	/* Entries are in list order, the previous live one is just below */
+	for(i = n - 1; i >= 0; i--) {
+		if(t->table[i].k != LH_FREED) {
+			prev = &t->table[i];
+			break;
+		}
 	}
-	t->table[n].next = t->table[n].prev = NULL;
+	if(prev) prev->next = e->next;
+	else t->head = e->next;
+	if(t->tail == e) t->tail = prev;
+
+	/* The slot stays in the index as a tombstone until the next resize */
+	e->v = NULL;
+	e->k = LH_FREED;
+	e->next = NULL;
 	return 0;
 }
 
@@ -213,5 +345,3 @@ int lh_table_delete(struct lh_table *t, const void *k)
 	if(!e) return -1;
 	return lh_table_delete_entry(t, e);
 }
-
-
@@ -26,12 +26,22 @@ extern "C" {
  */
 #define LH_EMPTY (void*)-1
 
+/**
+ * Tables with at most this many entries are searched linearly, comparing
+ * the cached hashes, and carry no index. Larger tables add an open
+ * addressing index over the entry array.
+ */
+#ifndef LH_INLINE_MAX
+#define LH_INLINE_MAX 8
+#endif
+
 /**
  * sentinel pointer value for freed slots
  */
 #define LH_FREED (void*)-2
 
 struct lh_entry;
+struct json_arena;
 
 /**
  * callback function prototypes
@@ -63,9 +73,13 @@ struct lh_entry {
 	 */
 	struct lh_entry *next;
 	/**
-	 * The previous entry.
+	 * Cached hash of the key.
 	 */
-	struct lh_entry *prev;
+	unsigned long hash;
+	/**
+	 * Cached length of the key for tables with char keys.
+	 */
+	unsigned short klen;
 };
 
 
@@ -76,11 +90,19 @@ struct lh_table {
 	/**
 	 * Size of our hash.
 	 */
-	unsigned char size;
+	unsigned short size;
 	/**
 	 * Numbers of entries.
 	 */
-	unsigned char count;
+	unsigned short count;
+	/**
+	 * Slots of the entry array in use, deleted entries included.
+	 */
+	unsigned short used;
+	/**
+	 * Index size - 1, 0 while the table has no index.
+	 */
+	unsigned short index_mask;
 
 	/**
 	 * The first entry.
@@ -92,14 +114,32 @@ struct lh_table {
 	 */
 	struct lh_entry *tail;
 
+	/**
+	 * Entries in insertion order.
+	 */
 	struct lh_entry *table;
 
+	/**
+	 * Open addressing index, each slot 0 or 1 + the entry position.
+	 */
+	unsigned short *index;
+
 	/**
 	 * A pointer onto the function responsible for freeing an entry.
 	 */
 	lh_entry_free_fn *free_fn;
 	lh_hash_fn *hash_fn;
 	lh_equal_fn *equal_fn;
+
+	/**
+	 * Arena the table and its entries live in, NULL for the heap.
+	 */
+	struct json_arena *arena;
+
+	/**
+	 * Keys are C strings, compared by cached length and memcmp.
+	 */
+	int kchar;
 };
 
 
@@ -149,6 +189,19 @@ extern struct lh_table* lh_table_new(int size, const char *name,
 				     lh_hash_fn *hash_fn,
 				     lh_equal_fn *equal_fn);
 
+/**
+ * Create a new linkhash table inside an arena. The table doubles in size
+ * when full, since the memory of the old entry array is only reclaimed
+ * with the arena. Heap tables grow one slot at a time up to LH_INLINE_MAX
+ * entries and by half their size after that.
+ * @param arena the arena to allocate from, NULL for the heap.
+ */
+extern struct lh_table* lh_table_new_in(struct json_arena *arena,
+					int size, const char *name,
+					lh_entry_free_fn *free_fn,
+					lh_hash_fn *hash_fn,
+					lh_equal_fn *equal_fn);
+
 /**
  * Convenience function to create a new linkhash
  * table with char keys.
@@ -160,6 +213,13 @@ extern struct lh_table* lh_table_new(int size, const char *name,
 extern struct lh_table* lh_kchar_table_new(int size, const char *name,
 					   lh_entry_free_fn *free_fn);
 
+/**
+ * Arena variant of lh_kchar_table_new.
+ */
+extern struct lh_table* lh_kchar_table_new_in(struct json_arena *arena,
+					      int size, const char *name,
+					      lh_entry_free_fn *free_fn);
+
 
 /**
  * Convenience function to create a new linkhash
@@ -235,6 +295,12 @@ extern int lh_table_delete(struct lh_table *t, const void *k);
 void lh_abort(const char *msg, ...);
 void lh_table_resize(struct lh_table *t, int new_size);
 
+/**
+ * Checks of the table against a plain array model, see linkhash_test.c.
+ * @return 0 if they all pass.
+ */
+extern int linkhash_test(int print);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,168 @@
+/*
+ * Checks of linkhash against a plain array model, for heap and arena
+ * tables, and the cost of building a table and of a lookup that hits or
+ * misses. Built on the host with the rest of json_c; not part of the
+ * default build.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "json.h"
+
+#define LH_TEST_KEYS 400
+#define LH_TEST_ROUNDS 400
+#define LH_TEST_OPS 2000
+#define LH_TEST_BENCH_KEYS 2000000	/* Keys inserted or looked up per size */
+
+/* Key names of the config and report objects */
+static const char *lh_test_names[] = {
+	"SSID", "PASSWORD", "DHCP", "IP", "NETMASK", "GATEWAY", "DNS1",
+	"IDENTIFIER", "Device Name", "Firmware", "Hardware", "Protocol",
+	"RF version", "Model", "Manufacturer", "Seed", "Bonjour", "Wi-Fi",
+	"Network", "Cloud info", "Apple TV", "Version", "Port", "localIp",
+	"netMask", "gateWay", "dnsServer", "mac", "bssid", "channel",
+	"security", "key"
+};
+
+static unsigned long lh_test_seed = 1;
+
+static int lh_test_rand(int n)
+{
+	lh_test_seed = lh_test_seed * 1103515245 + 12345;
+	return (int)((lh_test_seed >> 16) % n);
+}
+
+/* Random inserts, deletes and lookups on one table, mirrored in order[],
+ * the keys present in insertion order. Returns the number of mismatches. */
+static int lh_test_round(struct json_arena *arena, char keys[][24], int nkeys)
+{
+	struct lh_table *t = lh_kchar_table_new_in(arena, 1 + lh_test_rand(3),
+						   NULL, NULL);
+	struct lh_entry *e;
+	int order[LH_TEST_KEYS], present[LH_TEST_KEYS];
+	int n = 0, bad = 0, op, k, r, j;
+	const void *v;
+
+	memset(present, 0, sizeof(present));
+	for(op = 0; op < LH_TEST_OPS; op++) {
+		k = lh_test_rand(nkeys);
+		r = lh_test_rand(10);
+		if(r < 5) {
+			if(present[k]) continue;
+			lh_table_insert(t, keys[k], (void*)(long)(k + 1));
+			present[k] = 1;
+			order[n++] = k;
+		} else if(r < 7) {
+			if((lh_table_delete(t, keys[k]) == 0) != present[k])
+				bad++;
+			if(!present[k]) continue;
+			present[k] = 0;
+			for(j = 0; order[j] != k; j++)
+				;
+			memmove(&order[j], &order[j + 1], (n - j - 1) * sizeof(int));
+			n--;
+		} else {
+			v = lh_table_lookup(t, keys[k]);
+			if(present[k] ? v != (void*)(long)(k + 1) : v != NULL)
+				bad++;
+		}
+		if(t->count != n)
+			bad++;
+	}
+
+	/* Iteration must follow insertion order */
+	j = 0;
+	lh_foreach(t, e) {
+		if(j >= n || strcmp((const char*)e->k, keys[order[j]]))
+			bad++;
+		j++;
+	}
+	if(j != n || (n && strcmp((const char*)t->tail->k, keys[order[n - 1]])))
+		bad++;
+
+	lh_table_free(t);
+	return bad;
+}
+
+/* Nanoseconds per key to build a table of n keys, and per lookup of a
+ * key that is in it or is not */
+static void lh_test_bench(int n)
+{
+	static char keys[64][32], miss[64][32];
+	struct lh_table *t;
+	volatile long sink = 0;
+	int rounds = LH_TEST_BENCH_KEYS / n, r, i;
+	double build, hit, fail;
+	clock_t start;
+
+	for(i = 0; i < n; i++) {
+		snprintf(keys[i], sizeof(keys[i]), "%s%s", lh_test_names[i % 32],
+			 i >= 32 ? "_2" : "");
+		snprintf(miss[i], sizeof(miss[i]), "%s_x", keys[i]);
+	}
+
+	start = clock();
+	for(r = 0; r < rounds; r++) {
+		t = lh_kchar_table_new(1, NULL, NULL);
+		for(i = 0; i < n; i++)
+			lh_table_insert(t, keys[i], keys[i]);
+		sink += t->count;
+		lh_table_free(t);
+	}
+	build = (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / LH_TEST_BENCH_KEYS;
+
+	t = lh_kchar_table_new(1, NULL, NULL);
+	for(i = 0; i < n; i++)
+		lh_table_insert(t, keys[i], keys[i]);
+	start = clock();
+	for(r = 0; r < rounds; r++)
+		for(i = 0; i < n; i++)
+			sink += lh_table_lookup(t, keys[i]) != NULL;
+	hit = (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / LH_TEST_BENCH_KEYS;
+	start = clock();
+	for(r = 0; r < rounds; r++)
+		for(i = 0; i < n; i++)
+			sink += lh_table_lookup(t, miss[i]) != NULL;
+	fail = (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / LH_TEST_BENCH_KEYS;
+	lh_table_free(t);
+
+	printf("%2d keys: build %.1f ns/key, hit %.1f ns, miss %.1f ns\r\n",
+	       n, build, hit, fail);
+}
+
+int linkhash_test(int print)
+{
+	static char keys[LH_TEST_KEYS][24];
+	struct json_arena *arena;
+	int round, nkeys, i, bad = 0;
+
+	for(i = 0; i < LH_TEST_KEYS; i++)
+		snprintf(keys[i], sizeof(keys[i]),
+			 i % 3 ? "key_%d" : "k%dlonger_name", i);
+
+	/* Small tables that stay inline, then ones that need the index and
+	 * compaction; every other round lives in an arena */
+	for(round = 0; round < LH_TEST_ROUNDS && !bad; round++) {
+		arena = (round & 1) ? json_arena_new(256) : NULL;
+		nkeys = 1 + lh_test_rand(round < LH_TEST_ROUNDS / 2 ? 20 : LH_TEST_KEYS);
+		bad = lh_test_round(arena, keys, nkeys);
+		json_arena_free(arena);
+	}
+
+	if(!bad && print) {
+		for(i = 4; i <= 64; i *= 2)
+			lh_test_bench(i);
+	}
+
+	if(print) printf("linkhash_test: %s\r\n", bad ? "FAILED" : "PASSED");
+	return bad ? -1 : 0;
+}